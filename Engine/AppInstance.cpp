@@ -204,6 +204,15 @@ public:
     void getSequenceNameFromWriter(const OutputEffectInstance* writer, QString* sequenceName);
 
     void startRenderingFullSequence(bool blocking, const RenderQueueItem& writerWork);
+
+    void getRenderWorkFromNames(bool enableRenderStats,
+                                const std::list<std::string>& writers,
+                                const std::list<std::pair<int, std::pair<int, int> > >& frameRanges,
+                                std::list<AppInstance::RenderWork>* renderers);
+
+    void startRenderFarm(const CLArgs& cl, const std::list<AppInstance::RenderWork>& writers);
+
+    void renderFarmWorkerLoop(const CLArgs& cl);
 };
 
 AppInstance::AppInstance(int appID)
@@ -605,7 +614,7 @@ AppInstance::loadInternal(const CLArgs& cl,
         std::list<AppInstance::RenderWork> writersWork;
 
 
-        if ( info.suffix() == QString::fromUtf8(NATRON_PROJECT_FILE_EXT) ) {
+        if ( ( info.suffix() == QString::fromUtf8(NATRON_PROJECT_FILE_EXT) ) || ( info.suffix() == QString::fromUtf8(NATRON_PROJECT_BINARY_FILE_EXT) ) ) {
             ///Load the project
             if ( !_imp->_currentProject->loadProject( info.path(), info.fileName() ) ) {
                 throw std::invalid_argument( tr("Project file loading failed.").toStdString() );
@@ -660,7 +669,14 @@ AppInstance::loadInternal(const CLArgs& cl,
         }
 
         ///launch renders
-        if ( !writersWork.empty() ) {
+        if ( !cl.getRenderWorkerServerName().isEmpty() ) {
+            _imp->renderFarmWorkerLoop(cl);
+        } else if (cl.getRenderWorkersCount() > 0) {
+            if ( writersWork.empty() ) {
+                _imp->getRenderWorkFromNames( cl.areRenderStatsEnabled(), std::list<std::string>(), cl.getFrameRanges(), &writersWork );
+            }
+            _imp->startRenderFarm(cl, writersWork);
+        } else if ( !writersWork.empty() ) {
             startWritersRendering(false, writersWork);
         } else {
             std::list<std::string> writers;
@@ -671,7 +687,7 @@ AppInstance::loadInternal(const CLArgs& cl,
         if ( info.exists() ) {
             if ( info.suffix() == QString::fromUtf8("py") ) {
                 loadPythonScript(info);
-            } else if ( info.suffix() == QString::fromUtf8(NATRON_PROJECT_FILE_EXT) ) {
+            } else if ( ( info.suffix() == QString::fromUtf8(NATRON_PROJECT_FILE_EXT) ) || ( info.suffix() == QString::fromUtf8(NATRON_PROJECT_BINARY_FILE_EXT) ) ) {
                 if ( !_imp->_currentProject->loadProject( info.path(), info.fileName() ) ) {
                     throw std::invalid_argument( tr("Project file loading failed.").toStdString() );
                 }
@@ -1690,10 +1706,22 @@ AppInstance::startWritersRenderingFromNames(bool enableRenderStats,
 {
     std::list<RenderWork> renderers;
 
+    _imp->getRenderWorkFromNames(enableRenderStats, writers, frameRanges, &renderers);
+    startWritersRendering(doBlockingRender, renderers);
+} // AppInstance::startWritersRenderingFromNames
+
+void
+AppInstancePrivate::getRenderWorkFromNames(bool enableRenderStats,
+                                           const std::list<std::string>& writers,
+                                           const std::list<std::pair<int, std::pair<int, int> > >& frameRanges,
+                                           std::list<AppInstance::RenderWork>* renderers)
+{
+    typedef AppInstance::RenderWork RenderWork;
+
     if ( !writers.empty() ) {
         for (std::list<std::string>::const_iterator it = writers.begin(); it != writers.end(); ++it) {
             const std::string& writerName = *it;
-            NodePtr node = getNodeByFullySpecifiedName(writerName);
+            NodePtr node = _publicInterface->getNodeByFullySpecifiedName(writerName);
 
             if (!node) {
                 std::string exc(writerName);
@@ -1718,19 +1746,19 @@ AppInstance::startWritersRenderingFromNames(bool enableRenderStats,
 
                 for (std::list<std::pair<int, std::pair<int, int> > >::const_iterator it2 = frameRanges.begin(); it2 != frameRanges.end(); ++it2) {
                     RenderWork w(effect, it2->second.first, it2->second.second, it2->first, enableRenderStats);
-                    renderers.push_back(w);
+                    renderers->push_back(w);
                 }
 
                 if ( frameRanges.empty() ) {
                     RenderWork r(effect, INT_MIN, INT_MAX, INT_MIN, enableRenderStats);
-                    renderers.push_back(r);
+                    renderers->push_back(r);
                 }
             }
         }
     } else {
         //start rendering for all writers found in the project
         std::list<OutputEffectInstance*> writers;
-        getProject()->getWriters(&writers);
+        _currentProject->getWriters(&writers);
 
         for (std::list<OutputEffectInstance*>::const_iterator it2 = writers.begin(); it2 != writers.end(); ++it2) {
             assert(*it2);
@@ -1742,24 +1770,96 @@ AppInstance::startWritersRenderingFromNames(bool enableRenderStats,
 
                 for (std::list<std::pair<int, std::pair<int, int> > >::const_iterator it3 = frameRanges.begin(); it3 != frameRanges.end(); ++it3) {
                     RenderWork w(*it2, it3->second.first, it3->second.second, it3->first, enableRenderStats);
-                    renderers.push_back(w);
+                    renderers->push_back(w);
                 }
 
                 if ( frameRanges.empty() ) {
                     RenderWork r(*it2, INT_MIN, INT_MAX, INT_MIN, enableRenderStats);
-                    renderers.push_back(r);
+                    renderers->push_back(r);
                 }
             }
         }
     }
 
 
-    if ( renderers.empty() ) {
+    if ( renderers->empty() ) {
         throw std::invalid_argument("Project file is missing a writer node. This project cannot render anything.");
     }
+} // AppInstancePrivate::getRenderWorkFromNames
 
-    startWritersRendering(doBlockingRender, renderers);
-} // AppInstance::startWritersRenderingFromNames
+void
+AppInstancePrivate::startRenderFarm(const CLArgs& cl,
+                                    const std::list<AppInstance::RenderWork>& writers)
+{
+    // Workers are started with the same command-line, minus the options that only make sense for this process
+    QStringList workerArgs = QCoreApplication::arguments();
+    if ( !workerArgs.isEmpty() ) {
+        workerArgs.removeFirst();
+    }
+    {
+        QStringList optionsWithValue;
+        optionsWithValue << QString::fromUtf8("--workers") << QString::fromUtf8("--IPCpipe")
+                         << QString::fromUtf8("--" NATRON_BREAKPAD_PROCESS_EXEC) << QString::fromUtf8("--" NATRON_BREAKPAD_PROCESS_PID)
+                         << QString::fromUtf8("--" NATRON_BREAKPAD_CLIENT_FD_ARG) << QString::fromUtf8("--" NATRON_BREAKPAD_PIPE_ARG)
+                         << QString::fromUtf8("--" NATRON_BREAKPAD_COM_PIPE_ARG);
+        QStringList::iterator it = workerArgs.begin();
+        while ( it != workerArgs.end() ) {
+            if ( optionsWithValue.contains(*it) ) {
+                it = workerArgs.erase(it);
+                if ( it != workerArgs.end() ) {
+                    it = workerArgs.erase(it);
+                }
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    RenderFarmCoordinator coordinator( workerArgs, cl.getRenderWorkersCount() );
+    for (std::list<AppInstance::RenderWork>::const_iterator it = writers.begin(); it != writers.end(); ++it) {
+        NodePtr node = it->writer->getNode();
+        if ( node->isNodeDisabled() || !node->isActivated() ) {
+            continue;
+        }
+        int firstFrame, lastFrame, frameStep;
+        if ( !validateRenderOptions(*it, &firstFrame, &lastFrame, &frameStep) ) {
+            continue;
+        }
+        // A video file cannot be written by several processes
+        coordinator.addWork(QString::fromUtf8( node->getFullyQualifiedName().c_str() ), firstFrame, lastFrame, frameStep, !it->writer->isVideoWriter());
+    }
+
+    int framesFailed = coordinator.exec();
+    if (framesFailed > 0) {
+        throw std::runtime_error( tr("%1 frames could not be rendered.").arg(framesFailed).toStdString() );
+    }
+} // AppInstancePrivate::startRenderFarm
+
+void
+AppInstancePrivate::renderFarmWorkerLoop(const CLArgs& cl)
+{
+    RenderFarmWorkerChannel channel( cl.getRenderWorkerServerName() );
+    QString writerName;
+    int firstFrame, lastFrame, frameStep;
+
+    while ( channel.requestNextChunk(&writerName, &firstFrame, &lastFrame, &frameStep) ) {
+        bool ok = false;
+        try {
+            NodePtr node = _publicInterface->getNodeByFullySpecifiedName( writerName.toStdString() );
+            OutputEffectInstance* effect = node ? dynamic_cast<OutputEffectInstance*>( node->getEffectInstance().get() ) : 0;
+            if (!effect) {
+                throw std::invalid_argument( tr("%1 does not belong to the project file.").arg(writerName).toStdString() );
+            }
+            std::list<AppInstance::RenderWork> work;
+            work.push_back( AppInstance::RenderWork( effect, firstFrame, lastFrame, frameStep, cl.areRenderStatsEnabled() ) );
+            _publicInterface->startWritersRendering(true, work);
+            ok = true;
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+        }
+        channel.notifyChunkFinished(ok);
+    }
+}
 
 void
 AppInstance::startWritersRendering(bool doBlockingRender,
@@ -113,6 +113,7 @@
 #include "Engine/FileSystemModel.h"
 #include "Engine/GroupInput.h"
 #include "Engine/GroupOutput.h"
+#include "Engine/ImageStatistics.h"
 #include "Engine/JoinViewsNode.h"
 #include "Engine/LibraryBinary.h"
 #include "Engine/Log.h"
@@ -126,12 +127,14 @@
 #include "Engine/ProcessHandler.h" // ProcessInputChannel
 #include "Engine/Project.h"
 #include "Engine/PrecompNode.h"
+#include "Engine/RamBufferPool.h"
 #include "Engine/ReadNode.h"
 #include "Engine/RotoPaint.h"
 #include "Engine/RotoSmear.h"
 #include "Engine/StandardPaths.h"
 #include "Engine/TrackerNode.h"
 #include "Engine/ThreadPool.h"
+#include "Engine/TileScheduler.h"
 #include "Engine/Utils.h"
 #include "Engine/ViewIdx.h"
 #include "Engine/ViewerInstance.h" // RenderStatsMap
@@ -382,7 +385,7 @@ oom:
 void
 AppManager::saveCaches() const
 {
-    _imp->saveCaches();
+    _imp->saveCaches(true);
 }
 
 int
@@ -505,6 +508,7 @@ AppManager::loadFromArgs(const CLArgs& cl)
     }
 
     _imp->idealThreadCount = QThread::idealThreadCount();
+    _imp->tileScheduler->setWorkersCount(_imp->idealThreadCount);
 
 
     QThreadPool::globalInstance()->setExpiryTimeout(-1); //< make threads never exit on their own
@@ -586,11 +590,13 @@ AppManager::~AppManager()
     _imp->_backgroundIPC.reset();
 
     try {
-        _imp->saveCaches();
+        _imp->saveCaches(false);
     } catch (std::runtime_error&) {
         // ignore errors
     }
 
+    _imp->tileScheduler->quitWorkers();
+
     ///Caches may have launched some threads to delete images, wait for them to be done
     QThreadPool::globalInstance()->waitForDone();
 
@@ -1075,6 +1081,11 @@ AppManager::loadInternalAfterInitGui(const CLArgs& cl)
         _imp->_nodeCache = boost::make_shared<Cache<Image> >("NodeCache", NATRON_CACHE_VERSION, maxCacheRAM, 1.);
         _imp->_diskCache = boost::make_shared<Cache<Image> >("DiskCache", NATRON_CACHE_VERSION, maxDiskCacheNode, 0.);
         _imp->_viewerCache = boost::make_shared<Cache<FrameEntry> >("ViewerCache", NATRON_CACHE_VERSION, viewerCacheSize, 0.);
+
+        // Shards must be set before anything is inserted in the caches, i.e: before restoring them
+        int nCacheShards = _imp->_settings->getCacheShardsCount();
+        _imp->_nodeCache->setShardsCount(nCacheShards);
+        _imp->_viewerCache->setShardsCount(nCacheShards);
         _imp->setViewerCacheTileSize();
     } catch (std::logic_error&) {
         // ignore
@@ -1407,6 +1418,8 @@ AppManager::clearAllCaches()
 
     clearDiskCache();
     clearNodeCache();
+    RamBufferPool::clear();
+    ImageStatistics::clearCache();
 
 
     ///for each app instance clear all its nodes cache
@@ -2576,6 +2589,12 @@ AppManager::isAggressiveCachingEnabled() const
     return _imp->_settings->isAggressiveCachingEnabled();
 }
 
+bool
+AppManager::isMipMapPyramidCacheEnabled() const
+{
+    return _imp->_settings->isMipMapPyramidCacheEnabled();
+}
+
 U64
 AppManager::getCachesTotalMemorySize() const
 {
@@ -2588,6 +2607,41 @@ AppManager::getCachesTotalDiskSize() const
     return  _imp->_diskCache->getDiskCacheSize() + _imp->_viewerCache->getDiskCacheSize();
 }
 
+void
+AppManager::reportViewerCacheTileCompressed(std::size_t rawSize,
+                                            std::size_t compressedSize)
+{
+    QMutexLocker k(&_imp->viewerCacheCompressionMutex);
+
+    _imp->viewerCacheCompressedTilesRawSize += rawSize;
+    _imp->viewerCacheCompressedTilesSize += compressedSize;
+}
+
+void
+AppManager::reportViewerCacheTilesDecompressed(int nTiles,
+                                               double time)
+{
+    QMutexLocker k(&_imp->viewerCacheCompressionMutex);
+
+    _imp->viewerCacheDecompressedTilesCount += nTiles;
+    _imp->viewerCacheDecompressionTime += time;
+}
+
+bool
+AppManager::getViewerCacheCompressionStats(double* compressionRatio,
+                                           double* decompressionTimePerTileMS) const
+{
+    QMutexLocker k(&_imp->viewerCacheCompressionMutex);
+
+    if (_imp->viewerCacheCompressedTilesSize == 0) {
+        return false;
+    }
+    *compressionRatio = (double)_imp->viewerCacheCompressedTilesRawSize / _imp->viewerCacheCompressedTilesSize;
+    *decompressionTimePerTileMS = _imp->viewerCacheDecompressedTilesCount == 0 ? 0. : _imp->viewerCacheDecompressionTime * 1000. / _imp->viewerCacheDecompressedTilesCount;
+
+    return true;
+}
+
 CacheSignalEmitterPtr
 AppManager::getOrActivateViewerCacheSignalEmitter() const
 {
@@ -2625,6 +2679,7 @@ AppManager::registerEngineMetaTypes() const
     qRegisterMetaType<RectD>("RectD");
     qRegisterMetaType<RenderStatsPtr>("RenderStatsPtr");
     qRegisterMetaType<RenderStatsMap>("RenderStatsMap");
+    qRegisterMetaType<RamBufferPoolStats>("RamBufferPoolStats");
     qRegisterMetaType<ViewIdx>("ViewIdx");
     qRegisterMetaType<ViewSpec>("ViewSpec");
     qRegisterMetaType<NodePtr>("NodePtr");
@@ -2893,6 +2948,12 @@ AppManager::checkCacheFreeMemoryIsGoodEnough()
     size_t systemRAMToKeepFree = getSystemTotalRAM() * appPTR->getCurrentSettings()->getUnreachableRamPercent();
     size_t totalFreeRAM = getAmountFreePhysicalRAM();
 
+    if (totalFreeRAM <= systemRAMToKeepFree) {
+        // Recycled buffers are not accounted in the caches, release them first
+        RamBufferPool::clear();
+        totalFreeRAM = getAmountFreePhysicalRAM();
+    }
+
     while (totalFreeRAM <= systemRAMToKeepFree) {
 #ifdef NATRON_DEBUG_CACHE
         qDebug() << "Total system free RAM is below the threshold:" << printAsRAM(totalFreeRAM)
@@ -3717,6 +3778,12 @@ AppManager::getAppTLS() const
     return &_imp->globalTLS;
 }
 
+TileScheduler*
+AppManager::getTileScheduler() const
+{
+    return _imp->tileScheduler.get();
+}
+
 
 QString
 AppManager::getBoostVersion() const
@@ -4261,6 +4328,32 @@ PythonGILLocker::~PythonGILLocker()
     PyGILState_Release(state);
 }
 
+PythonGILUnlocker::PythonGILUnlocker()
+    : gilState(PyGILState_UNLOCKED)
+    , threadState(0)
+{
+#ifndef USE_NATRON_GIL
+    // With the Natron GIL, the calling thread may hold it and releasing only the Python GIL could deadlock
+    // with a thread waiting for the Natron GIL in PythonGILLocker, so keep both locked in that case.
+    if ( !Py_IsInitialized() ) {
+        return;
+    }
+    // Make sure this thread owns the GIL (this is a no-op when called from a Python binding) before
+    // saving its thread state, which releases the GIL whatever its PyGILState recursion count is.
+    gilState = PyGILState_Ensure();
+    threadState = PyEval_SaveThread();
+#endif
+}
+
+PythonGILUnlocker::~PythonGILUnlocker()
+{
+    if (!threadState) {
+        return;
+    }
+    PyEval_RestoreThread(threadState);
+    PyGILState_Release(gilState);
+}
+
 static bool
 getGroupInfosInternal(const std::string& modulePath,
                       const std::string& pythonModule,
@@ -222,6 +222,22 @@ public:
 
     U64 getCachesTotalMemorySize() const;
     U64 getCachesTotalDiskSize() const;
+
+    /**
+     * @brief Called when a viewer tile was compressed in the viewer cache from rawSize to compressedSize bytes.
+     **/
+    void reportViewerCacheTileCompressed(std::size_t rawSize, std::size_t compressedSize);
+
+    /**
+     * @brief Called when nTiles compressed viewer tiles were decompressed in the given time (in seconds).
+     **/
+    void reportViewerCacheTilesDecompressed(int nTiles, double time);
+
+    /**
+     * @brief Returns the average compression ratio of the viewer tiles compressed so far and the average time
+     * to decompress a tile (in milliseconds). Returns false if no tile was compressed yet.
+     **/
+    bool getViewerCacheCompressionStats(double* compressionRatio, double* decompressionTimePerTileMS) const;
     CacheSignalEmitterPtr getOrActivateViewerCacheSignalEmitter() const;
 
     void setApplicationsCachesMaximumMemoryPercent(double p);
@@ -457,6 +473,8 @@ public:
 
     bool isAggressiveCachingEnabled() const;
 
+    bool isMipMapPyramidCacheEnabled() const;
+
     void refreshDiskCacheLocation();
     const QString& getDiskCacheLocation() const;
 
@@ -498,6 +516,8 @@ public:
     OFX::Host::ImageEffect::Descriptor* getPluginContextAndDescribe(OFX::Host::ImageEffect::ImageEffectPlugin* plugin,
                                                                     ContextEnum* ctx);
     AppTLS* getAppTLS() const;
+
+    TileScheduler* getTileScheduler() const;
     const OfxHost* getOFXHost() const;
     GPUContextPool* getGPUContextPool() const;
 
@@ -823,6 +843,23 @@ public:
     ~PythonGILLocker();
 };
 
+/**
+ * @brief Small helper class to use as RAII to release the GIL around a blocking engine call made from Python
+ * (rendering, node creation, project loading...), so that other Python threads can run meanwhile.
+ * Python code called by the engine during that call (callbacks, expressions) takes the GIL back with a PythonGILLocker.
+ * This does nothing if Python is not initialized.
+ **/
+class PythonGILUnlocker
+{
+    PyGILState_STATE gilState;
+    PyThreadState* threadState;
+
+public:
+    PythonGILUnlocker();
+
+    ~PythonGILUnlocker();
+};
+
 NATRON_NAMESPACE_EXIT
 
 
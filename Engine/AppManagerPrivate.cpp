@@ -99,6 +99,11 @@ AppManagerPrivate::AppManagerPrivate()
     , _nodeCache()
     , _diskCache()
     , _viewerCache()
+    , viewerCacheCompressionMutex()
+    , viewerCacheCompressedTilesRawSize(0)
+    , viewerCacheCompressedTilesSize(0)
+    , viewerCacheDecompressedTilesCount(0)
+    , viewerCacheDecompressionTime(0.)
     , diskCachesLocationMutex()
     , diskCachesLocation()
     , _backgroundIPC()
@@ -116,6 +121,7 @@ AppManagerPrivate::AppManagerPrivate()
     , useThreadPool(true)
     , nThreadsMutex()
     , runningThreadsCount()
+    , tileScheduler( new TileScheduler() )
     , lastProjectLoadedCreatedDuringRC2Or3(false)
     , commandLineArgsUtf8()
     , nArgs(0)
@@ -314,38 +320,23 @@ AppManagerPrivate::declareSettingsToPython()
 
 template <typename T>
 void
-saveCache(Cache<T>* cache)
+saveCache(Cache<T>* cache,
+          bool keepIndexOpened)
 {
-    std::string cacheRestoreFilePath = cache->getRestoreFilePath();
-    FStreamsSupport::ofstream ofile;
-    FStreamsSupport::open(&ofile, cacheRestoreFilePath);
-
-    if (!ofile) {
-        std::cerr << "Failed to save cache to " << cacheRestoreFilePath.c_str() << std::endl;
-
-        return;
-    }
-
-
-    typename Cache<T>::CacheTOC toc;
-    cache->save(&toc);
-    unsigned int version = cache->cacheVersion();
     try {
-        boost::archive::binary_oarchive oArchive(ofile);
-        oArchive << version;
-        oArchive << toc;
+        cache->save(keepIndexOpened);
     } catch (const std::exception & e) {
-        qDebug() << "Failed to serialize the cache table of contents:" << e.what();
+        qDebug() << "Failed to write the cache index:" << e.what();
     }
 }
 
 void
-AppManagerPrivate::saveCaches()
+AppManagerPrivate::saveCaches(bool keepIndexOpened)
 {
     if (!appPTR->isBackground()) {
-        saveCache<FrameEntry>( _viewerCache.get() );
+        saveCache<FrameEntry>( _viewerCache.get(), keepIndexOpened );
     }
-    saveCache<Image>( _diskCache.get() );
+    saveCache<Image>( _diskCache.get(), keepIndexOpened );
 } // saveCaches
 
 template <typename T>
@@ -354,38 +345,17 @@ restoreCache(AppManagerPrivate* p,
              Cache<T>* cache)
 {
     if ( p->checkForCacheDiskStructure( cache->getCachePath(), cache->isTileCache() ) ) {
-        std::string settingsFilePath = cache->getRestoreFilePath();
-        FStreamsSupport::ifstream ifile;
-        FStreamsSupport::open(&ifile, settingsFilePath);
-        if (!ifile) {
-            std::cerr << "Failure to open cache restore file at: " << settingsFilePath << std::endl;
-
-            return;
-        }
-        typename Cache<T>::CacheTOC tableOfContents;
-        unsigned int cacheVersion = 0x1; //< default to 1 before NATRON_CACHE_VERSION was introduced
+        bool restored = false;
         try {
-            boost::archive::binary_iarchive iArchive(ifile);
-            if (cache->cacheVersion() >= NATRON_CACHE_VERSION) {
-                iArchive >> cacheVersion;
-            }
-            //Only load caches with same version, otherwise wipe it!
-            if ( cacheVersion == cache->cacheVersion() ) {
-                iArchive >> tableOfContents;
-            } else {
-                p->cleanUpCacheDiskStructure( cache->getCachePath(), cache->isTileCache() );
-            }
+            restored = cache->restore();
         } catch (const std::exception & e) {
-            qDebug() << "Exception when reading disk cache TOC:" << e.what();
+            qDebug() << "Exception when reading disk cache index:" << e.what();
+        }
+        // Only load caches with same version and that were closed properly, otherwise wipe it!
+        if (!restored) {
+            std::cerr << "Failure to open cache index at: " << cache->getRestoreFilePath() << std::endl;
             p->cleanUpCacheDiskStructure( cache->getCachePath(), cache->isTileCache() );
-
-            return;
         }
-
-        QFile restoreFile( QString::fromUtf8( settingsFilePath.c_str() ) );
-        restoreFile.remove();
-
-        cache->restore(tableOfContents);
     }
 }
 
@@ -417,9 +387,8 @@ AppManagerPrivate::checkForCacheDiskStructure(const QString & cachePath, bool is
         QStringList files = directory.entryList(QDir::AllDirs);
 
 
-        /*Now counting actual data files in the cache*/
         /*check if there's 256 subfolders, otherwise reset cache.*/
-        int count = 0; // -1 because of the restoreFile
+        /*the files they contain are not listed: it would make launching slow with a large cache*/
         int subFolderCount = 0;
         Q_FOREACH(const QString &file, files) {
             QString subFolder(cachePath);
@@ -432,12 +401,6 @@ AppManagerPrivate::checkForCacheDiskStructure(const QString & cachePath, bool is
             QDir d(subFolder);
             if ( d.exists() ) {
                 ++subFolderCount;
-                QStringList items = d.entryList();
-                for (int j = 0; j < items.size(); ++j) {
-                    if ( ( items[j] != QString::fromUtf8(".") ) && ( items[j] != QString::fromUtf8("..") ) ) {
-                        ++count;
-                    }
-                }
             }
         }
         if (subFolderCount < 256) {
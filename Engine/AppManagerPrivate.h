@@ -60,6 +60,7 @@
 #include "Engine/GPUContextPool.h"
 #include "Engine/GenericSchedulerThreadWatcher.h"
 #include "Engine/TLSHolder.h"
+#include "Engine/TileScheduler.h"
 
 // include breakpad after Engine, because it includes /usr/include/AssertMacros.h on OS X which defines a check(x) macro, which conflicts with boost
 #ifdef NATRON_USE_BREAKPAD
@@ -106,6 +107,11 @@ public:
     ImageCachePtr _nodeCache; //< Images cache
     ImageCachePtr _diskCache; //< Images disk cache (used by DiskCache nodes)
     FrameEntryCachePtr _viewerCache; //< Viewer textures cache
+    mutable QMutex viewerCacheCompressionMutex; //< protects the 4 fields below
+    U64 viewerCacheCompressedTilesRawSize; //< the total size of the viewer tiles compressed so far before compression
+    U64 viewerCacheCompressedTilesSize; //< the total size of the viewer tiles compressed so far after compression
+    U64 viewerCacheDecompressedTilesCount; //< the number of viewer tiles decompressed so far
+    double viewerCacheDecompressionTime; //< the time spent decompressing viewer tiles so far, in seconds
     mutable QMutex diskCachesLocationMutex;
     QString diskCachesLocation;
     boost::scoped_ptr<ProcessInputChannel> _backgroundIPC; //< object used to communicate with the main app
@@ -138,6 +144,9 @@ public:
     // Another method could be to analyse all cores running, but this is way more expensive and would impair performances.
     QAtomicInt runningThreadsCount;
 
+    // Executor of the tiles of renderRoI, its workers count follows the number of render threads
+    boost::scoped_ptr<TileScheduler> tileScheduler;
+
     //To by-pass a bug introduced in RC2 / RC3 with the serialization of bezier curves
     bool lastProjectLoadedCreatedDuringRC2Or3;
 
@@ -216,7 +225,7 @@ public:
 
     void loadBuiltinFormats();
 
-    void saveCaches();
+    void saveCaches(bool keepIndexOpened);
 
     void restoreCaches();
 
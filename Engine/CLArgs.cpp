@@ -62,6 +62,8 @@ public:
     bool useDefaultSettings;
     bool clearCacheOnLaunch;
     QString ipcPipe;
+    int renderWorkersCount;
+    QString renderWorkerServerName;
     int error;
     bool isInterpreterMode;
     std::list<std::pair<int, std::pair<int, int> > > frameRanges;
@@ -89,6 +91,8 @@ public:
         , useDefaultSettings(false)
         , clearCacheOnLaunch(false)
         , ipcPipe()
+        , renderWorkersCount(0)
+        , renderWorkerServerName()
         , error(0)
         , isInterpreterMode(false)
         , frameRanges()
@@ -225,6 +229,8 @@ CLArgs::operator=(const CLArgs& other)
     _imp->settingCommands = other._imp->settingCommands;
     _imp->isBackground = other._imp->isBackground;
     _imp->ipcPipe = other._imp->ipcPipe;
+    _imp->renderWorkersCount = other._imp->renderWorkersCount;
+    _imp->renderWorkerServerName = other._imp->renderWorkerServerName;
     _imp->error = other._imp->error;
     _imp->isInterpreterMode = other._imp->isInterpreterMode;
     _imp->frameRanges = other._imp->frameRanges;
@@ -339,7 +345,14 @@ CLArgs::printUsage(const std::string& programName)
         "     breakdown contains information about each nodes, render times etc...\n"
         "     This option is useful for debugging purposes or to control that a render\n"
         "     is working correctly.\n"
-        "     **Please note** that it does not work when writing video files."
+        "     **Please note** that it does not work when writing video files.\n"
+        "  --workers <number of processes>\n"
+        "     Split the frames to render across the given number of %1Renderer\n"
+        "     processes. Each process renders a chunk of frames and asks for the\n"
+        "     next one when done, so that faster processes render more frames. If a\n"
+        "     process crashes, its frames are given to the other processes.\n"
+        "     This has no effect on video files, which are rendered by a single\n"
+        "     process.\n"
         "Sample uses:\n"
         "  %1 /Users/Me/MyNatronProjects/MyProject.ntp\n"
         "  %1 -b -w MyWriter /Users/Me/MyNatronProjects/MyProject.ntp\n"
@@ -347,6 +360,7 @@ CLArgs::printUsage(const std::string& programName)
         "  %1Renderer -w MyWriter /FastDisk/Pictures/sequence'###'.exr 1-100 /Users/Me/MyNatronProjects/MyProject.ntp\n"
         "  %1Renderer -w MyWriter -w MySecondWriter 1-10 /Users/Me/MyNatronProjects/MyProject.ntp\n"
         "  %1Renderer -w MyWriter 1-10 -l /Users/Me/Scripts/onProjectLoaded.py /Users/Me/MyNatronProjects/MyProject.ntp\n"
+        "  %1Renderer --workers 4 -w MyWriter 1-1000 /Users/Me/MyNatronProjects/MyProject.ntp\n"
         "\n"
         /* Text must hold in 80 columns ************************************************/
         "Options for the execution of Python scripts:\n"
@@ -512,6 +526,18 @@ CLArgs::getIPCPipeName() const
     return _imp->ipcPipe;
 }
 
+int
+CLArgs::getRenderWorkersCount() const
+{
+    return _imp->renderWorkersCount;
+}
+
+const QString&
+CLArgs::getRenderWorkerServerName() const
+{
+    return _imp->renderWorkerServerName;
+}
+
 bool
 CLArgs::areRenderStatsEnabled() const
 {
@@ -911,6 +937,51 @@ CLArgsPrivate::parse()
         }
     }
 
+    // Must be parsed before the frame range, which would otherwise take the number of workers for a frame
+    {
+        QStringList::iterator it = hasToken( QString::fromUtf8("workers"), QString() );
+        if ( it != args.end() ) {
+            QStringList::iterator next = it;
+            ++next;
+            bool ok = false;
+            if ( next != args.end() ) {
+                renderWorkersCount = next->toInt(&ok);
+            }
+            if ( !ok || (renderWorkersCount < 1) ) {
+                std::cout << tr("You must specify a positive number of processes when using the --workers option").toStdString() << std::endl;
+                error = 1;
+
+                return;
+            }
+            if (!isBackground || isInterpreterMode) {
+                std::cout << tr("You cannot use the --workers option in interactive or interpreter mode").toStdString() << std::endl;
+                error = 1;
+
+                return;
+            }
+            ++next;
+            args.erase(it, next);
+        }
+    }
+
+    {
+        QStringList::iterator it = hasToken( QString::fromUtf8("render-worker"), QString() );
+        if ( it != args.end() ) {
+            QStringList::iterator next = it;
+            ++next;
+            if ( next != args.end() ) {
+                renderWorkerServerName = *next;
+                ++next;
+                args.erase(it, next);
+            } else {
+                std::cout << tr("You must specify the render coordinator server name").toStdString() << std::endl;
+                error = 1;
+
+                return;
+            }
+        }
+    }
+
     {
         QStringList::iterator it = hasToken( QString::fromUtf8("onload"), QString::fromUtf8("l") );
         if ( it != args.end() ) {
@@ -946,6 +1017,9 @@ CLArgsPrivate::parse()
 
     {
         QStringList::iterator it = findFileNameWithExtension( QString::fromUtf8(NATRON_PROJECT_FILE_EXT) );
+        if ( it == args.end() ) {
+            it = findFileNameWithExtension( QString::fromUtf8(NATRON_PROJECT_BINARY_FILE_EXT) );
+        }
         if ( it == args.end() ) {
             it = findFileNameWithExtension( QString::fromUtf8("py") );
             if ( ( it == args.end() ) && !isInterpreterMode && isBackground ) {
@@ -135,6 +135,17 @@ public:
     const QString& getDefaultOnProjectLoadedScript() const;
     const QString& getIPCPipeName() const;
 
+    /*
+     * @brief The number of worker processes the frames to render are dispatched to, or 0 to render in this process.
+     */
+    int getRenderWorkersCount() const;
+
+    /*
+     * @brief If this process is a worker of a render split with --workers, the name of the local server
+     * of the coordinator process where to pull the frames to render.
+     */
+    const QString& getRenderWorkerServerName() const;
+
     bool isPythonScript() const;
 
     bool areRenderStatsEnabled() const;
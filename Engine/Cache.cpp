@@ -28,7 +28,32 @@
 #include <cassert>
 #include <stdexcept>
 
+#include <QtCore/QDir>
+#include <QtCore/QFileInfo>
+
 NATRON_NAMESPACE_ENTER
+
+void
+removeUnreferencedCacheFiles(const QString& cachePath,
+                             const std::set<QString>& usedFilePaths,
+                             const QDateTime& olderThan)
+{
+    for (U32 i = 0x00; i <= 0xF; ++i) {
+        for (U32 j = 0x00; j <= 0xF; ++j) {
+            QString subFolder = QString::number(i, 16) + QString::number(j, 16);
+            QDir cacheFolder( cachePath + QLatin1Char('/') + subFolder );
+            QString absolutePath = cacheFolder.absolutePath();
+            QFileInfoList etr = cacheFolder.entryInfoList(QDir::Files | QDir::NoDotAndDotDot);
+            for (QFileInfoList::const_iterator it = etr.begin(); it != etr.end(); ++it) {
+                QString entryFilePath = absolutePath + QLatin1Char('/') + it->fileName();
+                if ( ( usedFilePaths.find(entryFilePath) == usedFilePaths.end() ) && (it->lastModified() < olderThan) ) {
+                    cacheFolder.remove( it->fileName() );
+                }
+            }
+        }
+    }
+}
+
 NATRON_NAMESPACE_EXIT
 
 NATRON_NAMESPACE_USING
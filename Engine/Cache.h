@@ -51,14 +51,18 @@ GCC_DIAG_OFF(deprecated)
 #include <QtCore/QObject>
 #include <QtCore/QBuffer>
 #include <QtCore/QRunnable>
+#include <QtCore/QAtomicInt>
+#include <QtCore/QDateTime>
 GCC_DIAG_ON(deprecated)
 #if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
 #include <boost/shared_ptr.hpp>
 #include <boost/make_shared.hpp>
+#include <boost/scoped_ptr.hpp>
 #endif
 
 #include "Engine/AppManager.h" //for access to settings
 #include "Engine/CacheEntry.h"
+#include "Engine/CacheIndex.h"
 #include "Engine/ImageLocker.h"
 #include "Engine/LRUHashTable.h"
 #include "Engine/MemoryInfo.h" // getSystemTotalRAM
@@ -324,6 +328,15 @@ private:
     }
 };
 
+/**
+ * @brief Removes from the 256 subfolders of a non-tiled cache the files that are not in usedFilePaths.
+ * Only the files last modified before olderThan are removed, so that this can run on a background thread
+ * while new entries are created.
+ **/
+void removeUnreferencedCacheFiles(const QString& cachePath,
+                                  const std::set<QString>& usedFilePaths,
+                                  const QDateTime& olderThan);
+
 
 class CacheSignalEmitter
     : public QObject
@@ -396,10 +409,6 @@ public:
     typedef boost::shared_ptr<param_t> ParamsTypePtr;
     typedef boost::shared_ptr<EntryType> EntryTypePtr;
 
-    struct SerializedEntry;
-
-    typedef std::list<SerializedEntry> CacheTOC;
-
 public:
 
 
@@ -463,8 +472,41 @@ public:
 
 #endif // USE_VARIADIC_TEMPLATES
 
+
 private:
 
+    /**
+     * @brief A shard owns a hash-partition of the entries of the cache. Each shard has its own
+     * LRU tables and locks so that threads looking up entries with different hashes do not contend.
+     * When the cache has a single shard, this is exactly the legacy global cache.
+     **/
+    struct CacheShard
+    {
+        mutable QMutex lock; //protects memoryCache & diskCache & memoryBytes & diskBytes
+        mutable QMutex getLock;  //prevents get() and getOrCreate() to be called simultaneously on this shard
+
+        /*These 2 are mutable because we need to modify the LRU list even
+             when we call get() and we want this function to be const.*/
+        mutable CacheContainer memoryCache;
+        mutable CacheContainer diskCache;
+
+        // Size in bytes (computed from the entries params) of the entries held by each container.
+        // This is only used to pick which shard to evict from, hence it does not need to be exact.
+        mutable std::size_t memoryBytes;
+        mutable std::size_t diskBytes;
+
+        CacheShard()
+            : lock()
+            , getLock()
+            , memoryCache()
+            , diskCache()
+            , memoryBytes(0)
+            , diskBytes(0)
+        {
+        }
+    };
+
+    typedef boost::shared_ptr<CacheShard> CacheShardPtr;
 
     std::size_t _maximumInMemorySize;     // the maximum size of the in-memory portion of the cache.(in % of the maximum cache size)
     std::size_t _maximumCacheSize;     // maximum size allowed for the cache
@@ -475,14 +517,13 @@ private:
     mutable std::size_t _memoryCacheSize;     // current size of the cache in bytes
     mutable std::size_t _diskCacheSize;
     mutable QMutex _sizeLock; // protects _memoryCacheSize & _diskCacheSize & _maximumInMemorySize & _maximumCacheSize
-    mutable QMutex _lock; //protects _memoryCache & _diskCache
-    mutable QMutex _getLock;  //prevents get() and getOrCreate() to be called simultaneously
 
+    // The hash-partitions of the cache. The number of shards can only be changed while the cache is empty,
+    // see setShardsCount()
+    std::vector<CacheShardPtr> _shards;
 
-    /*These 2 are mutable because we need to modify the LRU list even
-         when we call get() and we want this function to be const.*/
-    mutable CacheContainer _memoryCache;
-    mutable CacheContainer _diskCache;
+    // Rotates the shard at which eviction starts when several shards are equally loaded
+    mutable QAtomicInt _nextEvictionShard;
     const std::string _cacheName;
     const unsigned int _version;
 
@@ -512,6 +553,15 @@ private:
     // When set these are used for fast search of a free tile
     TileCacheFileWPtr _nextAvailableCacheFile;
     int _nextAvailableCacheFileIndex;
+
+    // The entries of the previous session that were not looked-up yet. They are only accounted in _diskCacheSize
+    // and get inserted in the disk portion by getOrRestoreInternal() the first time they are asked for.
+    boost::scoped_ptr<CacheIndex> _index;
+
+    // Set by restore(): creates an entry from a record of the index, defined in CacheSerialization.h
+    // so that only the code restoring the cache depends on the serialization of the keys and params
+    typedef EntryType* (*IndexRecordDecoder)(const CacheIndex::Record& record, const Cache* cache);
+    IndexRecordDecoder _indexRecordDecoder;
 public:
 
 
@@ -526,10 +576,8 @@ public:
         , _memoryCacheSize(0)
         , _diskCacheSize(0)
         , _sizeLock()
-        , _lock()
-        , _getLock()
-        , _memoryCache()
-        , _diskCache()
+        , _shards()
+        , _nextEvictionShard()
         , _cacheName(cacheName)
         , _version(version)
         , _signalEmitter()
@@ -545,17 +593,21 @@ public:
         , _cacheFiles()
         , _nextAvailableCacheFile()
         , _nextAvailableCacheFileIndex(-1)
+        , _index( new CacheIndex() )
+        , _indexRecordDecoder(0)
     {
         _signalEmitter = boost::make_shared<CacheSignalEmitter>();
+        _shards.push_back( boost::make_shared<CacheShard>() );
     }
 
     virtual ~Cache()
     {
-        QMutexLocker locker(&_lock);
-
         _tearingDown = true;
-        _memoryCache.clear();
-        _diskCache.clear();
+        for (std::size_t i = 0; i < _shards.size(); ++i) {
+            QMutexLocker locker(&_shards[i]->lock);
+            _shards[i]->memoryCache.clear();
+            _shards[i]->diskCache.clear();
+        }
     }
 
     virtual bool isTileCache() const OVERRIDE FINAL
@@ -582,6 +634,36 @@ public:
         _tileByteSize = tileByteSize;
     }
 
+    /**
+     * @brief Split the cache in nShards hash-partitioned shards, each with its own LRU tables and locks.
+     * Look-ups of entries in different shards no longer contend on the same mutex. Eviction remains global
+     * but approximate: it picks the least recently used entry of the shard holding the most memory.
+     * A value of 1 gives the legacy behavior of a single global LRU cache.
+     * This must be called before any entry is inserted in the cache, e.g: right after construction.
+     **/
+    void setShardsCount(int nShards)
+    {
+        nShards = std::max(1, nShards);
+        if ( (int)_shards.size() == nShards ) {
+            return;
+        }
+#ifdef DEBUG
+        for (std::size_t i = 0; i < _shards.size(); ++i) {
+            QMutexLocker locker(&_shards[i]->lock);
+            assert(_shards[i]->memoryCache.size() == 0 && _shards[i]->diskCache.size() == 0);
+        }
+#endif
+        std::vector<CacheShardPtr> shards(nShards);
+        for (int i = 0; i < nShards; ++i) {
+            shards[i] = boost::make_shared<CacheShard>();
+        }
+        _shards.swap(shards);
+    }
+
+    int getShardsCount() const
+    {
+        return (int)_shards.size();
+    }
 
     void waitForDeleterThread()
     {
@@ -603,17 +685,45 @@ public:
     bool get(const typename EntryType::key_type & key,
              std::list<EntryTypePtr>* returnValue) const
     {
-        ///Be atomic, so it cannot be created by another thread in the meantime
-        QMutexLocker getlocker(&_getLock);
+        CacheShard& shard = getShard( key.getHash() );
 
-        ///lock the cache before reading it.
-        QMutexLocker locker(&_lock);
+        ///Be atomic, so it cannot be created by another thread in the meantime
+        QMutexLocker getlocker(&shard.getLock);
 
-        return getInternal(key, returnValue);
+        return getOrRestoreInternal(shard, key, returnValue);
     } // get
 
 private:
 
+    /**
+     * @brief Returns the shard owning the entries with the given hash.
+     **/
+    CacheShard& getShard(hash_type hash) const
+    {
+        if (_shards.size() == 1) {
+            return *_shards.front();
+        }
+        // The hash is already well distributed, but fold the high bits in since
+        // the low bits alone are not guaranteed to be uniform for every key type
+        U64 h = (U64)hash;
+        h ^= (h >> 32);
+        h ^= (h >> 16);
+
+        return *_shards[h % _shards.size()];
+    }
+
+    static std::size_t getEntryBytes(const EntryTypePtr& entry)
+    {
+        return entry->getSizeInBytesFromParams();
+    }
+
+    static void decreaseBytes(std::size_t* bytes,
+                              std::size_t size)
+    {
+        *bytes = size > *bytes ? 0 : *bytes - size;
+    }
+
+
 
 
     virtual TileCacheFilePtr getTileCacheFile(const std::string& filepath, std::size_t dataOffset) OVERRIDE FINAL WARN_UNUSED_RETURN
@@ -629,7 +739,7 @@ private:
 
                 // The dataOffset should be a multiple of the tile size
                 assert(_tileByteSize * index == dataOffset);
-                assert(!(*it)->usedTiles[index]);
+                // The tile may already be marked used if the file was restored from the index
                 (*it)->usedTiles[index] = true;
                 return *it;
             }
@@ -772,12 +882,13 @@ private:
     }
 
 
-    void createInternal(const typename EntryType::key_type & key,
+    void createInternal(CacheShard& shard,
+                        const typename EntryType::key_type & key,
                         const ParamsTypePtr & params,
                         ImageLockerHelper<EntryType>* entryLocker,
                         EntryTypePtr* returnValue) const
     {
-        //_lock must not be taken here
+        //shard.lock must not be taken here
 
         ///Before allocating the memory check that there's enough space to fit in memory
         appPTR->checkCacheFreeMemoryIsGoodEnough();
@@ -803,14 +914,13 @@ private:
             maximumInMemorySize = std::max( (std::size_t)1, _maximumInMemorySize );
         }
         {
-            QMutexLocker locker(&_lock);
             std::list<EntryTypePtr> entriesToBeDeleted;
             double occupationPercentage = (double)memoryCacheSize / maximumInMemorySize;
             ///While the current cache size can't fit the new entry, erase the last recently used entries.
             ///Also if the total free RAM is under the limit of the system free RAM to keep free, erase LRU entries.
             while (occupationPercentage > NATRON_CACHE_LIMIT_PERCENT) {
                 std::list<EntryTypePtr> deleted;
-                if ( !tryEvictInMemoryEntry(deleted) ) {
+                if ( !tryEvictInMemoryEntryFromAnyShard(deleted) ) {
                     break;
                 }
 
@@ -845,7 +955,6 @@ private:
         }
         if (_isTiled) {
 
-            QMutexLocker locker(&_lock);
             // For tiled caches, we insert directly into the disk cache, so make sure there is room for it
             std::list<EntryTypePtr> entriesToBeDeleted;
             U64 diskCacheSize, maximumDiskCacheSize;
@@ -855,9 +964,12 @@ private:
                 maximumDiskCacheSize = std::max( (std::size_t)1, _maximumCacheSize - _maximumInMemorySize );
             }
             double diskPercentage = (double)diskCacheSize / maximumDiskCacheSize;
+            while ( (diskPercentage >= NATRON_CACHE_LIMIT_PERCENT) && evictOldestIndexedEntry(&diskCacheSize) ) {
+                diskPercentage = (double)diskCacheSize / maximumDiskCacheSize;
+            }
             while (diskPercentage >= NATRON_CACHE_LIMIT_PERCENT) {
                 std::list<EntryTypePtr> deleted;
-                if ( !tryEvictDiskEntry(deleted) ) {
+                if ( !tryEvictDiskEntryFromAnyShard(deleted) ) {
                     break;
                 }
 
@@ -878,7 +990,7 @@ private:
 
         }
         {
-            QMutexLocker locker(&_lock);
+            QMutexLocker locker(&shard.lock);
 
             try {
                 returnValue->reset( new EntryType(key, params, this ) );
@@ -897,7 +1009,7 @@ private:
                 if (entryLocker) {
                     entryLocker->lock(*returnValue);
                 }
-                sealEntry(*returnValue, _isTiled ? false : true);
+                sealEntry(shard, *returnValue, _isTiled ? false : true);
             }
         }
     } // createInternal
@@ -907,16 +1019,18 @@ public:
     void swapOrInsert(const EntryTypePtr& entryToBeEvicted,
                       const EntryTypePtr& newEntry)
     {
-        QMutexLocker locker(&_lock);
+        typename EntryType::hash_type hash = entryToBeEvicted->getHashKey();
+        CacheShard& shard = getShard(hash);
+        QMutexLocker locker(&shard.lock);
 
         const typename EntryType::key_type& key = entryToBeEvicted->getKey();
-        typename EntryType::hash_type hash = entryToBeEvicted->getHashKey();
         ///find a matching value in the internal memory container
-        CacheIterator memoryCached = _memoryCache(hash);
-        if ( memoryCached != _memoryCache.end() ) {
+        CacheIterator memoryCached = shard.memoryCache(hash);
+        if ( memoryCached != shard.memoryCache.end() ) {
             std::list<EntryTypePtr> & ret = getValueFromIterator(memoryCached);
             for (typename std::list<EntryTypePtr>::iterator it = ret.begin(); it != ret.end(); ++it) {
                 if ( ( (*it)->getKey() == key ) && ( (*it)->getParams() == entryToBeEvicted->getParams() ) ) {
+                    decreaseBytes( &shard.memoryBytes, getEntryBytes(*it) );
                     ret.erase(it);
                     break;
                 }
@@ -925,20 +1039,22 @@ public:
             ret.push_back(newEntry);
         } else {
             ///Look in disk cache
-            CacheIterator diskCached = _diskCache(hash);
-            if ( diskCached != _diskCache.end() ) {
+            CacheIterator diskCached = shard.diskCache(hash);
+            if ( diskCached != shard.diskCache.end() ) {
                 ///Remove the old entry
                 std::list<EntryTypePtr> & ret = getValueFromIterator(diskCached);
                 for (typename std::list<EntryTypePtr>::iterator it = ret.begin(); it != ret.end(); ++it) {
                     if ( ( (*it)->getKey() == key ) && ( (*it)->getParams() == entryToBeEvicted->getParams() ) ) {
+                        decreaseBytes( &shard.diskBytes, getEntryBytes(*it) );
                         ret.erase(it);
                         break;
                     }
                 }
             }
             ///Insert in mem cache
-            _memoryCache.insert(hash, newEntry);
+            shard.memoryCache.insert(hash, newEntry);
         }
+        shard.memoryBytes += getEntryBytes(newEntry);
     }
 
     /**
@@ -976,15 +1092,12 @@ public:
         ///Make sure the shared_ptrs live in this list and are destroyed not while under the lock
         ///so that the memory freeing (which might be expensive for large images) doesn't happen while under the lock
 
+        CacheShard& shard = getShard( key.getHash() );
         {
             ///Be atomic, so it cannot be created by another thread in the meantime
-            QMutexLocker getlocker(&_getLock);
+            QMutexLocker getlocker(&shard.getLock);
             std::list<EntryTypePtr> entries;
-            bool didGetSucceed;
-            {
-                QMutexLocker locker(&_lock);
-                didGetSucceed = getInternal(key, &entries);
-            }
+            bool didGetSucceed = getOrRestoreInternal(shard, key, &entries);
             if (didGetSucceed) {
                 for (typename std::list<EntryTypePtr>::iterator it = entries.begin(); it != entries.end(); ++it) {
                     if (*(*it)->getParams() == *params) {
@@ -995,7 +1108,7 @@ public:
                 }
             }
 
-            createInternal(key, params, locker, returnValue);
+            createInternal(shard, key, params, locker, returnValue);
 
             return false;
         } // getlocker
@@ -1017,13 +1130,17 @@ public:
             ///block signals otherwise the we would be spammed of notifications
             _signalEmitter->blockSignals(true);
         }
-        QMutexLocker locker(&_lock);
-        std::pair<hash_type, EntryTypePtr> evictedFromMemory = _memoryCache.evict();
-        while (evictedFromMemory.second) {
-            if ( !_isTiled && evictedFromMemory.second->isStoredOnDisk() ) {
-                evictedFromMemory.second->removeAnyBackingFile();
+        for (std::size_t i = 0; i < _shards.size(); ++i) {
+            CacheShard& shard = *_shards[i];
+            QMutexLocker locker(&shard.lock);
+            std::pair<hash_type, EntryTypePtr> evictedFromMemory = shard.memoryCache.evict();
+            while (evictedFromMemory.second) {
+                decreaseBytes( &shard.memoryBytes, getEntryBytes(evictedFromMemory.second) );
+                if ( !_isTiled && evictedFromMemory.second->isStoredOnDisk() ) {
+                    evictedFromMemory.second->removeAnyBackingFile();
+                }
+                evictedFromMemory = shard.memoryCache.evict();
             }
-            evictedFromMemory = _memoryCache.evict();
         }
 
         if (_signalEmitter) {
@@ -1043,23 +1160,29 @@ public:
      **/
     void clearDiskPortion()
     {
+        clearIndexedEntries();
+
         if (_signalEmitter) {
             ///block signals otherwise the we would be spammed of notifications
             _signalEmitter->blockSignals(true);
         }
-        QMutexLocker locker(&_lock);
-
-        /// An entry which has a use_count greater than 1 is not removable:
-        /// The backing file must not be removed because it might be read/written to
-        /// at the same time. The best we can do is just let it here in the cache.
-        std::pair<hash_type, EntryTypePtr> evictedFromDisk = _diskCache.evict();
-        //if the cache couldn't evict that means all entries are used somewhere and we shall not remove them!
-        //we'll let the user of these entries purge the extra entries left in the cache later on
-        while (evictedFromDisk.second) {
-            if (!_isTiled) {
-                evictedFromDisk.second->removeAnyBackingFile();
+        for (std::size_t i = 0; i < _shards.size(); ++i) {
+            CacheShard& shard = *_shards[i];
+            QMutexLocker locker(&shard.lock);
+
+            /// An entry which has a use_count greater than 1 is not removable:
+            /// The backing file must not be removed because it might be read/written to
+            /// at the same time. The best we can do is just let it here in the cache.
+            std::pair<hash_type, EntryTypePtr> evictedFromDisk = shard.diskCache.evict();
+            //if the cache couldn't evict that means all entries are used somewhere and we shall not remove them!
+            //we'll let the user of these entries purge the extra entries left in the cache later on
+            while (evictedFromDisk.second) {
+                decreaseBytes( &shard.diskBytes, getEntryBytes(evictedFromDisk.second) );
+                if (!_isTiled) {
+                    evictedFromDisk.second->removeAnyBackingFile();
+                }
+                evictedFromDisk = shard.diskCache.evict();
             }
-            evictedFromDisk = _diskCache.evict();
         }
 
 
@@ -1076,51 +1199,57 @@ public:
             ///block signals otherwise the we would be spammed of notifications
             _signalEmitter->blockSignals(true);
         }
-        QMutexLocker locker(&_lock);
-        std::pair<hash_type, EntryTypePtr> evictedFromMemory = _memoryCache.evict();
-        while (evictedFromMemory.second) {
-            // Move back the entry on disk if it can be store on disk
-            // For tiled caches, the tile is sharing the same file with other entries
-            // so we cannot close it, just remove the entry
-            if ( evictedFromMemory.second->isStoredOnDisk() && !_isTiled) {
-                evictedFromMemory.second->deallocate();
-                /*insert it back into the disk portion */
-
-                U64 diskCacheSize, maximumCacheSize;
-                {
-                    QMutexLocker k(&_sizeLock);
-                    diskCacheSize = _diskCacheSize;
-                    maximumCacheSize = _maximumCacheSize;
-                }
-
-                /*before that we need to clear the disk cache if it exceeds the maximum size allowed*/
-                while (diskCacheSize + evictedFromMemory.second->size() >= maximumCacheSize) {
-                    {
-                        std::pair<hash_type, EntryTypePtr> evictedFromDisk = _diskCache.evict();
-                        //if the cache couldn't evict that means all entries are used somewhere and we shall not remove them!
-                        //we'll let the user of these entries purge the extra entries left in the cache later on
-                        if (!evictedFromDisk.second) {
-                            break;
-                        }
-                        ///Erase the file from the disk if we reach the limit.
-                        evictedFromDisk.second->removeAnyBackingFile();
-                    }
+        for (std::size_t i = 0; i < _shards.size(); ++i) {
+            CacheShard& shard = *_shards[i];
+            QMutexLocker locker(&shard.lock);
+            std::pair<hash_type, EntryTypePtr> evictedFromMemory = shard.memoryCache.evict();
+            while (evictedFromMemory.second) {
+                decreaseBytes( &shard.memoryBytes, getEntryBytes(evictedFromMemory.second) );
+                // Move back the entry on disk if it can be store on disk
+                // For tiled caches, the tile is sharing the same file with other entries
+                // so we cannot close it, just remove the entry
+                if ( evictedFromMemory.second->isStoredOnDisk() && !_isTiled) {
+                    evictedFromMemory.second->deallocate();
+                    /*insert it back into the disk portion */
+
+                    U64 diskCacheSize, maximumCacheSize;
                     {
                         QMutexLocker k(&_sizeLock);
                         diskCacheSize = _diskCacheSize;
                         maximumCacheSize = _maximumCacheSize;
                     }
-                }
 
-                /*update the disk cache size*/
-                CacheIterator existingDiskCacheEntry = _diskCache( evictedFromMemory.second->getHashKey() );
-                /*if the entry doesn't exist on the disk cache,make a new list and insert it*/
-                if ( existingDiskCacheEntry == _diskCache.end() ) {
-                    _diskCache.insert(evictedFromMemory.second->getHashKey(), evictedFromMemory.second);
+                    /*before that we need to clear the disk cache if it exceeds the maximum size allowed*/
+                    while (diskCacheSize + evictedFromMemory.second->size() >= maximumCacheSize) {
+                        {
+                            std::pair<hash_type, EntryTypePtr> evictedFromDisk = shard.diskCache.evict();
+                            //if the cache couldn't evict that means all entries are used somewhere and we shall not remove them!
+                            //we'll let the user of these entries purge the extra entries left in the cache later on
+                            if (!evictedFromDisk.second) {
+                                break;
+                            }
+                            decreaseBytes( &shard.diskBytes, getEntryBytes(evictedFromDisk.second) );
+                            ///Erase the file from the disk if we reach the limit.
+                            evictedFromDisk.second->removeAnyBackingFile();
+                        }
+                        {
+                            QMutexLocker k(&_sizeLock);
+                            diskCacheSize = _diskCacheSize;
+                            maximumCacheSize = _maximumCacheSize;
+                        }
+                    }
+
+                    /*update the disk cache size*/
+                    CacheIterator existingDiskCacheEntry = shard.diskCache( evictedFromMemory.second->getHashKey() );
+                    /*if the entry doesn't exist on the disk cache,make a new list and insert it*/
+                    if ( existingDiskCacheEntry == shard.diskCache.end() ) {
+                        shard.diskCache.insert(evictedFromMemory.second->getHashKey(), evictedFromMemory.second);
+                        shard.diskBytes += getEntryBytes(evictedFromMemory.second);
+                    }
                 }
-            }
 
-            evictedFromMemory = _memoryCache.evict();
+                evictedFromMemory = shard.memoryCache.evict();
+            }
         }
 
         _signalEmitter->blockSignals(false);
@@ -1136,7 +1265,6 @@ public:
         std::list<EntryTypePtr> entriesToBeDeleted;
 
         {
-            QMutexLocker locker(&_lock);
             U64 memoryCacheSize, maximumInMemorySize;
             {
                 QMutexLocker k(&_sizeLock);
@@ -1146,7 +1274,7 @@ public:
             double occupationPercentage = (double)memoryCacheSize / maximumInMemorySize;
             while (occupationPercentage >= NATRON_CACHE_LIMIT_PERCENT) {
                 std::list<EntryTypePtr> deleted;
-                if ( !tryEvictInMemoryEntry(deleted) ) {
+                if ( !tryEvictInMemoryEntryFromAnyShard(deleted) ) {
                     break;
                 }
 
@@ -1166,9 +1294,12 @@ public:
                 maximumDiskCacheSize = std::max( (std::size_t)1, _maximumCacheSize - _maximumInMemorySize );
             }
             double diskPercentage = (double)diskCacheSize / maximumDiskCacheSize;
+            while ( (diskPercentage >= NATRON_CACHE_LIMIT_PERCENT) && evictOldestIndexedEntry(&diskCacheSize) ) {
+                diskPercentage = (double)diskCacheSize / maximumDiskCacheSize;
+            }
             while (diskPercentage >= NATRON_CACHE_LIMIT_PERCENT) {
                 std::list<EntryTypePtr> deleted;
-                if ( !tryEvictDiskEntry(deleted) ) {
+                if ( !tryEvictDiskEntryFromAnyShard(deleted) ) {
                     break;
                 }
 
@@ -1190,15 +1321,18 @@ public:
      **/
     void getCopy(std::list<EntryTypePtr>* copy) const
     {
-        QMutexLocker locker(&_lock);
+        for (std::size_t i = 0; i < _shards.size(); ++i) {
+            const CacheShard& shard = *_shards[i];
+            QMutexLocker locker(&shard.lock);
 
-        for (CacheIterator it = _memoryCache.begin(); it != _memoryCache.end(); ++it) {
-            const std::list<EntryTypePtr> & entries = getValueFromIterator(it);
-            copy->insert( copy->end(), entries.begin(), entries.end() );
-        }
-        for (CacheIterator it = _diskCache.begin(); it != _diskCache.end(); ++it) {
-            const std::list<EntryTypePtr> & entries = getValueFromIterator(it);
-            copy->insert( copy->end(), entries.begin(), entries.end() );
+            for (CacheIterator it = shard.memoryCache.begin(); it != shard.memoryCache.end(); ++it) {
+                const std::list<EntryTypePtr> & entries = getValueFromIterator(it);
+                copy->insert( copy->end(), entries.begin(), entries.end() );
+            }
+            for (CacheIterator it = shard.diskCache.begin(); it != shard.diskCache.end(); ++it) {
+                const std::list<EntryTypePtr> & entries = getValueFromIterator(it);
+                copy->insert( copy->end(), entries.begin(), entries.end() );
+            }
         }
     }
 
@@ -1212,13 +1346,8 @@ public:
         ///Make sure the shared_ptrs live in this list and are destroyed not while under the lock
         ///so that the memory freeing (which might be expensive for large images) doesn't happen while under the lock
         std::list<EntryTypePtr> entriesToBeDeleted;
-        bool ret;
-        {
-            QMutexLocker locker(&_lock);
-            ret = tryEvictInMemoryEntry(entriesToBeDeleted);
-        }
 
-        return ret;
+        return tryEvictInMemoryEntryFromAnyShard(entriesToBeDeleted);
     }
 
     /**
@@ -1228,12 +1357,12 @@ public:
      **/
     bool evictLRUDiskEntry() const
     {
-
-        QMutexLocker locker(&_lock);
         std::list<EntryTypePtr> entriesToBeDeleted;
-        return tryEvictDiskEntry(entriesToBeDeleted);
+
+        return tryEvictDiskEntryFromAnyShard(entriesToBeDeleted);
     }
 
+
     /**
      * @brief To be called by a CacheEntry whenever it's size changes.
      * This way the cache can keep track of the real memory footprint.
@@ -1471,37 +1600,40 @@ public:
         std::list<EntryTypePtr> toRemove;
 
         {
-            QMutexLocker l(&_lock);
-            CacheIterator existingEntry = _memoryCache( entry->getHashKey() );
-            if ( existingEntry != _memoryCache.end() ) {
+            CacheShard& shard = getShard( entry->getHashKey() );
+            QMutexLocker l(&shard.lock);
+            CacheIterator existingEntry = shard.memoryCache( entry->getHashKey() );
+            if ( existingEntry != shard.memoryCache.end() ) {
                 std::list<EntryTypePtr> & ret = getValueFromIterator(existingEntry);
                 for (typename std::list<EntryTypePtr>::iterator it = ret.begin(); it != ret.end(); ++it) {
                     if ( (*it)->getKey() == entry->getKey() ) {
+                        decreaseBytes( &shard.memoryBytes, getEntryBytes(*it) );
                         toRemove.push_back(*it);
                         ret.erase(it);
                         break;
                     }
                 }
                 if ( ret.empty() ) {
-                    _memoryCache.erase(existingEntry);
+                    shard.memoryCache.erase(existingEntry);
                 }
             } else {
-                existingEntry = _diskCache( entry->getHashKey() );
-                if ( existingEntry != _diskCache.end() ) {
+                existingEntry = shard.diskCache( entry->getHashKey() );
+                if ( existingEntry != shard.diskCache.end() ) {
                     std::list<EntryTypePtr> & ret = getValueFromIterator(existingEntry);
                     for (typename std::list<EntryTypePtr>::iterator it = ret.begin(); it != ret.end(); ++it) {
                         if ( (*it)->getKey() == entry->getKey() ) {
+                            decreaseBytes( &shard.diskBytes, getEntryBytes(*it) );
                             toRemove.push_back(*it);
                             ret.erase(it);
                             break;
                         }
                     }
                     if ( ret.empty() ) {
-                        _diskCache.erase(existingEntry);
+                        shard.diskCache.erase(existingEntry);
                     }
                 }
             }
-        } // QMutexLocker l(&_lock);
+        } // QMutexLocker l(&shard.lock);
         if ( !toRemove.empty() ) {
             _deleterThread.appendToQueue(toRemove);
 
@@ -1515,25 +1647,38 @@ public:
     {
         std::list<EntryTypePtr> toRemove;
         {
-            QMutexLocker l(&_lock);
-            CacheIterator existingEntry = _memoryCache( hash);
-            if ( existingEntry != _memoryCache.end() ) {
+            CacheShard& shard = getShard(hash);
+            QMutexLocker l(&shard.lock);
+            CacheIterator existingEntry = shard.memoryCache( hash);
+            if ( existingEntry != shard.memoryCache.end() ) {
                 std::list<EntryTypePtr> & ret = getValueFromIterator(existingEntry);
                 for (typename std::list<EntryTypePtr>::iterator it = ret.begin(); it != ret.end(); ++it) {
+                    decreaseBytes( &shard.memoryBytes, getEntryBytes(*it) );
                     toRemove.push_back(*it);
                 }
-                _memoryCache.erase(existingEntry);
+                shard.memoryCache.erase(existingEntry);
             } else {
-                existingEntry = _diskCache( hash );
-                if ( existingEntry != _diskCache.end() ) {
+                existingEntry = shard.diskCache( hash );
+                if ( existingEntry != shard.diskCache.end() ) {
                     std::list<EntryTypePtr> & ret = getValueFromIterator(existingEntry);
                     for (typename std::list<EntryTypePtr>::iterator it = ret.begin(); it != ret.end(); ++it) {
+                        decreaseBytes( &shard.diskBytes, getEntryBytes(*it) );
                         toRemove.push_back(*it);
                     }
-                    _diskCache.erase(existingEntry);
+                    shard.diskCache.erase(existingEntry);
                 }
             }
-        } // QMutexLocker l(&_lock);
+        } // QMutexLocker l(&shard.lock);
+
+        {
+            std::list<CacheIndex::Record> records;
+            _index->takeRecords(hash, &records);
+            for (std::list<CacheIndex::Record>::const_iterator it = records.begin(); it != records.end(); ++it) {
+                freeIndexedRecordData(*it);
+                QMutexLocker k(&_sizeLock);
+                decreaseBytes(&_diskCacheSize, it->dataSize);
+            }
+        }
 
         if ( !toRemove.empty() ) {
             _deleterThread.appendToQueue(toRemove);
@@ -1544,13 +1689,20 @@ public:
         }
     }
 
-    /*Saves cache to disk as a settings file.
-     */
-    void save(CacheTOC* tableOfContents);
+    /**
+     * @brief Writes the index of the entries stored on disk, so that they can be restored by the next session.
+     * The entries that were not looked-up since the cache was restored are written back as they were.
+     * If keepIndexOpened is false the index is closed: this should only be done when the application exits.
+     **/
+    void save(bool keepIndexOpened);
 
 
-    /*Restores the cache from disk.*/
-    void restore(const CacheTOC & tableOfContents);
+    /**
+     * @brief Opens the index written by save() in a previous session. Only the header of the index is read:
+     * the entries are created the first time get() asks for them.
+     * @returns False if the index could not be opened, in which case the disk structure of the cache should be reset.
+     **/
+    bool restore();
 
 
     void removeAllEntriesWithDifferentNodeHashForHolderPublic(const CacheEntryHolder* holder,
@@ -1577,29 +1729,32 @@ public:
         *diskOccupied = 0;
 
         std::string holderID = holder->getCacheID();
-        QMutexLocker locker(&_lock);
+        for (std::size_t i = 0; i < _shards.size(); ++i) {
+            const CacheShard& shard = *_shards[i];
+            QMutexLocker locker(&shard.lock);
 
-        for (CacheIterator memIt = _memoryCache.begin(); memIt != _memoryCache.end(); ++memIt) {
-            std::list<EntryTypePtr> & entries = getValueFromIterator(memIt);
-            if ( !entries.empty() ) {
-                const EntryTypePtr & front = entries.front();
+            for (CacheIterator memIt = shard.memoryCache.begin(); memIt != shard.memoryCache.end(); ++memIt) {
+                std::list<EntryTypePtr> & entries = getValueFromIterator(memIt);
+                if ( !entries.empty() ) {
+                    const EntryTypePtr & front = entries.front();
 
-                if (front->getKey().getCacheHolderID() == holderID) {
-                    for (typename std::list<EntryTypePtr>::iterator it = entries.begin(); it != entries.end(); ++it) {
-                        *ramOccupied += (*it)->size();
+                    if (front->getKey().getCacheHolderID() == holderID) {
+                        for (typename std::list<EntryTypePtr>::iterator it = entries.begin(); it != entries.end(); ++it) {
+                            *ramOccupied += (*it)->size();
+                        }
                     }
                 }
             }
-        }
 
-        for (CacheIterator memIt = _diskCache.begin(); memIt != _diskCache.end(); ++memIt) {
-            std::list<EntryTypePtr> & entries = getValueFromIterator(memIt);
-            if ( !entries.empty() ) {
-                const EntryTypePtr & front = entries.front();
+            for (CacheIterator memIt = shard.diskCache.begin(); memIt != shard.diskCache.end(); ++memIt) {
+                std::list<EntryTypePtr> & entries = getValueFromIterator(memIt);
+                if ( !entries.empty() ) {
+                    const EntryTypePtr & front = entries.front();
 
-                if (front->getKey().getCacheHolderID() == holderID) {
-                    for (typename std::list<EntryTypePtr>::iterator it = entries.begin(); it != entries.end(); ++it) {
-                        *diskOccupied += (*it)->size();
+                    if (front->getKey().getCacheHolderID() == holderID) {
+                        for (typename std::list<EntryTypePtr>::iterator it = entries.begin(); it != entries.end(); ++it) {
+                            *diskOccupied += (*it)->size();
+                        }
                     }
                 }
             }
@@ -1613,11 +1768,13 @@ private:
                                                                        bool removeAll) OVERRIDE FINAL
     {
         std::list<EntryTypePtr> toDelete;
-        CacheContainer newMemCache, newDiskCache;
-        {
-            QMutexLocker locker(&_lock);
+        for (std::size_t i = 0; i < _shards.size(); ++i) {
+            CacheShard& shard = *_shards[i];
+            CacheContainer newMemCache, newDiskCache;
+            std::size_t newMemBytes = 0, newDiskBytes = 0;
+            QMutexLocker locker(&shard.lock);
 
-            for (CacheIterator memIt = _memoryCache.begin(); memIt != _memoryCache.end(); ++memIt) {
+            for (CacheIterator memIt = shard.memoryCache.begin(); memIt != shard.memoryCache.end(); ++memIt) {
                 std::list<EntryTypePtr> & entries = getValueFromIterator(memIt);
                 if ( !entries.empty() ) {
                     const EntryTypePtr & front = entries.front();
@@ -1630,11 +1787,14 @@ private:
                     } else {
                         typename EntryType::hash_type hash = front->getHashKey();
                         newMemCache.insert(hash, entries);
+                        for (typename std::list<EntryTypePtr>::iterator it = entries.begin(); it != entries.end(); ++it) {
+                            newMemBytes += getEntryBytes(*it);
+                        }
                     }
                 }
             }
 
-            for (CacheIterator dIt = _diskCache.begin(); dIt != _diskCache.end(); ++dIt) {
+            for (CacheIterator dIt = shard.diskCache.begin(); dIt != shard.diskCache.end(); ++dIt) {
                 std::list<EntryTypePtr> & entries = getValueFromIterator(dIt);
                 if ( !entries.empty() ) {
                     const EntryTypePtr & front = entries.front();
@@ -1647,13 +1807,18 @@ private:
                     } else {
                         typename EntryType::hash_type hash = front->getHashKey();
                         newDiskCache.insert(hash, entries);
+                        for (typename std::list<EntryTypePtr>::iterator it = entries.begin(); it != entries.end(); ++it) {
+                            newDiskBytes += getEntryBytes(*it);
+                        }
                     }
                 }
             }
 
-            _memoryCache = newMemCache;
-            _diskCache = newDiskCache;
-        } // QMutexLocker locker(&_lock);
+            shard.memoryCache = newMemCache;
+            shard.diskCache = newDiskCache;
+            shard.memoryBytes = newMemBytes;
+            shard.diskBytes = newDiskBytes;
+        } // for each shard
 
         if ( !toDelete.empty() ) {
             _deleterThread.appendToQueue(toDelete);
@@ -1664,16 +1829,40 @@ private:
         }
     } // removeAllEntriesWithDifferentNodeHashForHolderPrivate
 
-    bool getInternal(const typename EntryType::key_type & key,
+    /**
+     * @brief Same as getInternal() but the entries of the previous session with the same hash are inserted
+     * in the disk portion first. The shard getLock must be held but not the shard lock.
+     **/
+    bool getOrRestoreInternal(CacheShard& shard,
+                              const typename EntryType::key_type & key,
+                              std::list<EntryTypePtr>* returnValue) const
+    {
+        assert( !shard.getLock.tryLock() );   // must be locked
+        {
+            QMutexLocker locker(&shard.lock);
+            if ( shard.memoryCache( key.getHash() ) != shard.memoryCache.end() ) {
+                return getInternal(shard, key, returnValue);
+            }
+        }
+
+        restoreIndexedEntries( shard, key.getHash() );
+
+        QMutexLocker locker(&shard.lock);
+
+        return getInternal(shard, key, returnValue);
+    }
+
+    bool getInternal(CacheShard& shard,
+                     const typename EntryType::key_type & key,
                      std::list<EntryTypePtr>* returnValue) const
     {
         ///Private should be locked
-        assert( !_lock.tryLock() );
+        assert( !shard.lock.tryLock() );
 
         ///find a matching value in the internal memory container
-        CacheIterator memoryCached = _memoryCache( key.getHash() );
+        CacheIterator memoryCached = shard.memoryCache( key.getHash() );
 
-        if ( memoryCached != _memoryCache.end() ) {
+        if ( memoryCached != shard.memoryCache.end() ) {
             ///we found something with a matching hash key. There may be several entries linked to
             ///this key, we need to find one with matching params
             std::list<EntryTypePtr> & ret = getValueFromIterator(memoryCached);
@@ -1692,9 +1881,9 @@ private:
             return returnValue->size() > 0;
         } else {
             ///fallback on the disk cache internal container
-            CacheIterator diskCached = _diskCache( key.getHash() );
+            CacheIterator diskCached = shard.diskCache( key.getHash() );
 
-            if ( diskCached == _diskCache.end() ) {
+            if ( diskCached == shard.diskCache.end() ) {
                 /*the entry was neither in memory or disk, just allocate a new one*/
                 return false;
             } else {
@@ -1715,18 +1904,21 @@ private:
                                 (*it)->reOpenFileMapping();
                             } catch (const std::exception & e) {
                                 qDebug() << "Error while reopening cache file: " << e.what();
+                                decreaseBytes( &shard.diskBytes, getEntryBytes(*it) );
                                 ret.erase(it);
 
                                 return false;
                             } catch (...) {
                                 qDebug() << "Error while reopening cache file";
+                                decreaseBytes( &shard.diskBytes, getEntryBytes(*it) );
                                 ret.erase(it);
 
                                 return false;
                             }
 
                             //put it back into the RAM
-                            _memoryCache.insert( (*it)->getHashKey(), *it );
+                            shard.memoryCache.insert( (*it)->getHashKey(), *it );
+                            shard.memoryBytes += getEntryBytes(*it);
 
 
                             U64 memoryCacheSize, maximumInMemorySize;
@@ -1738,8 +1930,10 @@ private:
                             std::list<EntryTypePtr> entriesToBeDeleted;
 
                             //now clear extra entries from the disk cache so it doesn't exceed the RAM limit.
+                            //Only this shard is locked here: we must not lock another shard to avoid lock-order inversions,
+                            //so evict from this shard only.
                             while (memoryCacheSize > maximumInMemorySize) {
-                                if ( !tryEvictInMemoryEntry(entriesToBeDeleted) ) {
+                                if ( !tryEvictInMemoryEntry(shard, entriesToBeDeleted) ) {
                                     break;
                                 }
 
@@ -1760,10 +1954,11 @@ private:
 
                         if (!_isTiled) {
 
+                            decreaseBytes( &shard.diskBytes, getEntryBytes(*it) );
                             ret.erase(it);
 
                             ///Remove it from the disk cache
-                            _diskCache.erase(diskCached);
+                            shard.diskCache.erase(diskCached);
                         }
 
                         return true;
@@ -1780,41 +1975,250 @@ private:
     /** @brief Inserts into the cache an entry that was previously allocated by the createInternal()
      * function. This is called directly by createInternal() if the allocation was successful
      **/
-    void sealEntry(const EntryTypePtr & entry,
+    void sealEntry(CacheShard& shard,
+                   const EntryTypePtr & entry,
                    bool inMemory) const
     {
-        assert( !_lock.tryLock() );   // must be locked
+        assert( !shard.lock.tryLock() );   // must be locked
         typename EntryType::hash_type hash = entry->getHashKey();
 
         if (inMemory) {
             /*if the entry doesn't exist on the memory cache,make a new list and insert it*/
-            CacheIterator existingEntry = _memoryCache(hash);
-            if ( existingEntry == _memoryCache.end() ) {
-                _memoryCache.insert(hash, entry);
+            CacheIterator existingEntry = shard.memoryCache(hash);
+            if ( existingEntry == shard.memoryCache.end() ) {
+                shard.memoryCache.insert(hash, entry);
             } else {
                 /*append to the existing list*/
                 getValueFromIterator(existingEntry).push_back(entry);
             }
+            shard.memoryBytes += getEntryBytes(entry);
         } else {
-            CacheIterator existingEntry = _diskCache(hash);
-            if ( existingEntry == _diskCache.end() ) {
-                _diskCache.insert(hash, entry);
+            CacheIterator existingEntry = shard.diskCache(hash);
+            if ( existingEntry == shard.diskCache.end() ) {
+                shard.diskCache.insert(hash, entry);
             } else {
                 /*append to the existing list*/
                 getValueFromIterator(existingEntry).push_back(entry);
             }
+            shard.diskBytes += getEntryBytes(entry);
+        }
+    }
+
+    /**
+     * @brief Inserts into the disk portion the entries of the index with the given hash, if any.
+     * The records are removed from the index.
+     * The shard getLock must be held, so that the records cannot be taken by another thread, but not the shard lock:
+     * decoding the records and freeing the data of those that cannot be restored (which locks the tile cache)
+     * must not block the other threads using the shard.
+     **/
+    void restoreIndexedEntries(CacheShard& shard,
+                               hash_type hash) const
+    {
+        assert( !shard.getLock.tryLock() );   // must be locked
+        if (!_indexRecordDecoder) {
+            return;
+        }
+
+        std::list<CacheIndex::Record> records;
+        _index->takeRecords(hash, &records);
+        if ( records.empty() ) {
+            return;
+        }
+
+        std::list<EntryTypePtr> entries;
+        for (std::list<CacheIndex::Record>::const_iterator it = records.begin(); it != records.end(); ++it) {
+            {
+                // Restoring the entry accounts for it again
+                QMutexLocker k(&_sizeLock);
+                decreaseBytes(&_diskCacheSize, it->dataSize);
+            }
+
+            EntryType* value = 0;
+            try {
+                if ( it->dataSize == getTileSizeBytes() ) {
+                    value = _indexRecordDecoder(*it, this);
+                }
+                if (value) {
+                    ///This will not put the entry back into RAM, instead we just insert back the entry into the disk cache
+                    value->restoreMetadataFromFile(it->dataSize, it->filePath, it->dataOffset);
+                }
+            } catch (const std::exception & e) {
+                qDebug() << e.what();
+                delete value;
+                value = 0;
+            }
+            if (!value) {
+                freeIndexedRecordData(*it);
+                continue;
+            }
+            entries.push_back( EntryTypePtr(value) );
+        }
+
+        QMutexLocker locker(&shard.lock);
+        for (typename std::list<EntryTypePtr>::const_iterator it = entries.begin(); it != entries.end(); ++it) {
+            sealEntry(shard, *it, false /*inMemory*/);
+        }
+    }
+
+    /**
+     * @brief Releases the storage of an entry of the index that will not be restored.
+     **/
+    void freeIndexedRecordData(const CacheIndex::Record& record) const
+    {
+        if ( !isTileCache() ) {
+            QFile::remove( QString::fromUtf8( record.filePath.c_str() ) );
+
+            return;
+        }
+        TileCacheFilePtr file;
+        {
+            QMutexLocker k(&_tileCacheMutex);
+            for (std::set<TileCacheFilePtr>::const_iterator it = _cacheFiles.begin(); it != _cacheFiles.end(); ++it) {
+                if ( (*it)->file->path() == record.filePath ) {
+                    file = *it;
+                    break;
+                }
+            }
         }
+        if (file) {
+            const_cast<Cache*>(this)->freeTile(file, record.dataOffset);
+        }
+    }
+
+    /**
+     * @brief Evicts the oldest entry of the index. These were not looked-up since the cache was restored, hence
+     * they are older than any entry of the disk portion.
+     * @returns False if the index is empty.
+     **/
+    bool evictOldestIndexedEntry(U64* diskCacheSize) const
+    {
+        CacheIndex::Record record;
+
+        if ( !_index->takeOldestRecord(&record) ) {
+            return false;
+        }
+        freeIndexedRecordData(record);
+        {
+            QMutexLocker k(&_sizeLock);
+            decreaseBytes(&_diskCacheSize, record.dataSize);
+        }
+        *diskCacheSize = record.dataSize > *diskCacheSize ? 0 : *diskCacheSize - record.dataSize;
+
+        return true;
+    }
+
+    /**
+     * @brief Removes all the entries of the index.
+     **/
+    void clearIndexedEntries()
+    {
+        std::list<CacheIndex::Record> records;
+
+        _index->getRecords(&records);
+        _index->clear();
+        std::size_t bytes = 0;
+        for (std::list<CacheIndex::Record>::const_iterator it = records.begin(); it != records.end(); ++it) {
+            freeIndexedRecordData(*it);
+            bytes += it->dataSize;
+        }
+        QMutexLocker k(&_sizeLock);
+        decreaseBytes(&_diskCacheSize, bytes);
+    }
+
+    /**
+     * @brief Returns the shards indices sorted by decreasing number of bytes held in memory (or on disk).
+     * Shards are visited starting at a rotating index so that equally loaded shards are evicted in turn.
+     * The sizes are read shard after shard, hence the order is only approximate.
+     **/
+    void getShardsEvictionOrder(bool inMemory,
+                                std::vector<std::size_t>* order) const
+    {
+        std::size_t nShards = _shards.size();
+        std::size_t start = (unsigned int)_nextEvictionShard.fetchAndAddRelaxed(1) % nShards;
+        std::vector<std::pair<std::size_t, std::size_t> > bytesPerShard(nShards);
+
+        for (std::size_t i = 0; i < nShards; ++i) {
+            std::size_t index = (start + i) % nShards;
+            const CacheShard& shard = *_shards[index];
+            QMutexLocker locker(&shard.lock);
+            bytesPerShard[i].first = inMemory ? shard.memoryBytes : shard.diskBytes;
+            bytesPerShard[i].second = index;
+        }
+        // Stable so that ties keep the rotating order
+        std::stable_sort( bytesPerShard.begin(), bytesPerShard.end(), ShardBytesGreater() );
+        order->resize(nShards);
+        for (std::size_t i = 0; i < nShards; ++i) {
+            (*order)[i] = bytesPerShard[i].second;
+        }
+    }
+
+    struct ShardBytesGreater
+    {
+        bool operator()(const std::pair<std::size_t, std::size_t>& lhs,
+                        const std::pair<std::size_t, std::size_t>& rhs) const
+        {
+            return lhs.first > rhs.first;
+        }
+    };
+
+    /**
+     * @brief Evicts the LRU in-memory entry of the most loaded shard that has an evictable entry.
+     * No shard lock must be held by the caller: shards are locked one at a time.
+     **/
+    bool tryEvictInMemoryEntryFromAnyShard(std::list<EntryTypePtr> & entriesToBeDeleted) const
+    {
+        if (_shards.size() == 1) {
+            QMutexLocker locker(&_shards.front()->lock);
+
+            return tryEvictInMemoryEntry(*_shards.front(), entriesToBeDeleted);
+        }
+        std::vector<std::size_t> order;
+        getShardsEvictionOrder(true, &order);
+        for (std::size_t i = 0; i < order.size(); ++i) {
+            CacheShard& shard = *_shards[order[i]];
+            QMutexLocker locker(&shard.lock);
+            if ( tryEvictInMemoryEntry(shard, entriesToBeDeleted) ) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    /**
+     * @brief Same as tryEvictInMemoryEntryFromAnyShard() but for the disk portion.
+     **/
+    bool tryEvictDiskEntryFromAnyShard(std::list<EntryTypePtr> & entriesToBeDeleted) const
+    {
+        if (_shards.size() == 1) {
+            QMutexLocker locker(&_shards.front()->lock);
+
+            return tryEvictDiskEntry(*_shards.front(), entriesToBeDeleted);
+        }
+        std::vector<std::size_t> order;
+        getShardsEvictionOrder(false, &order);
+        for (std::size_t i = 0; i < order.size(); ++i) {
+            CacheShard& shard = *_shards[order[i]];
+            QMutexLocker locker(&shard.lock);
+            if ( tryEvictDiskEntry(shard, entriesToBeDeleted) ) {
+                return true;
+            }
+        }
+
+        return false;
     }
 
-    bool tryEvictInMemoryEntry(std::list<EntryTypePtr> & entriesToBeDeleted) const
+    bool tryEvictInMemoryEntry(CacheShard& shard,
+                               std::list<EntryTypePtr> & entriesToBeDeleted) const
     {
-        assert( !_lock.tryLock() );
-        std::pair<hash_type, EntryTypePtr> evicted = _memoryCache.evict();
+        assert( !shard.lock.tryLock() );
+        std::pair<hash_type, EntryTypePtr> evicted = shard.memoryCache.evict();
         //if the cache couldn't evict that means all entries are used somewhere and we shall not remove them!
         //we'll let the user of these entries purge the extra entries left in the cache later on
         if (!evicted.second) {
             return false;
         }
+        decreaseBytes( &shard.memoryBytes, getEntryBytes(evicted.second) );
 
         // If it is stored on disk, remove it from memory
         // If the cache is tiled, the entry is sharing the same file with other entries so we cannot close the file.
@@ -1840,12 +2244,13 @@ private:
 
             /*before that we need to clear the disk cache if it exceeds the maximum size allowed*/
             while ( ( diskCacheSize  + evicted.second->size() ) >= (maximumCacheSize - maximumInMemorySize) ) {
-                std::pair<hash_type, EntryTypePtr> evictedFromDisk = _diskCache.evict();
+                std::pair<hash_type, EntryTypePtr> evictedFromDisk = shard.diskCache.evict();
                 //if the cache couldn't evict that means all entries are used somewhere and we shall not remove them!
                 //we'll let the user of these entries purge the extra entries left in the cache later on
                 if (!evictedFromDisk.second) {
                     break;
                 }
+                decreaseBytes( &shard.diskBytes, getEntryBytes(evictedFromDisk.second) );
 
                 ///Erase the file from the disk if we reach the limit.
                 evictedFromDisk.second->removeAnyBackingFile();
@@ -1864,28 +2269,31 @@ private:
                 diskCacheSize -= fsize;
             }
 
-            CacheIterator existingDiskCacheEntry = _diskCache(evicted.first);
+            CacheIterator existingDiskCacheEntry = shard.diskCache(evicted.first);
             /*if the entry doesn't exist on the disk cache,make a new list and insert it*/
-            if ( existingDiskCacheEntry == _diskCache.end() ) {
-                _diskCache.insert(evicted.first, evicted.second);
+            if ( existingDiskCacheEntry == shard.diskCache.end() ) {
+                shard.diskCache.insert(evicted.first, evicted.second);
             } else {   /*append to the existing list*/
                 getValueFromIterator(existingDiskCacheEntry).push_back(evicted.second);
             }
+            shard.diskBytes += getEntryBytes(evicted.second);
         } // if (!evicted.second->isStoredOnDisk())
 
         return true;
     } // tryEvictEntry
 
-    bool tryEvictDiskEntry(std::list<EntryTypePtr> & entriesToBeDeleted) const
+    bool tryEvictDiskEntry(CacheShard& shard,
+                           std::list<EntryTypePtr> & entriesToBeDeleted) const
     {
 
-        assert( !_lock.tryLock() );
-        std::pair<hash_type, EntryTypePtr> evicted = _diskCache.evict();
+        assert( !shard.lock.tryLock() );
+        std::pair<hash_type, EntryTypePtr> evicted = shard.diskCache.evict();
         //if the cache couldn't evict that means all entries are used somewhere and we shall not remove them!
         //we'll let the user of these entries purge the extra entries left in the cache later on
         if (!evicted.second) {
             return false;
         }
+        decreaseBytes( &shard.diskBytes, getEntryBytes(evicted.second) );
         if (!_isTiled) {
             // Erase the file from the disk if we reach the limit.
             evicted.second->removeAnyBackingFile();
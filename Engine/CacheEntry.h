@@ -56,6 +56,7 @@
 #include <QtCore/QReadWriteLock>
 #include <QtCore/QDir>
 #include <QtCore/QDebug>
+#include <QtCore/QFileInfo>
 
 #ifdef DEBUG
 #include <SequenceParsing.h> // for removePath
@@ -65,6 +66,7 @@
 #include "Engine/CacheEntryHolder.h"
 #include "Engine/MemoryFile.h"
 #include "Engine/NonKeyParams.h"
+#include "Engine/RamBufferPool.h"
 #include "Engine/Texture.h"
 #include "Engine/EngineFwd.h"
 #include "Global/GlobalDefines.h"
@@ -75,6 +77,10 @@ NATRON_NAMESPACE_ENTER
 /////////////////////////////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////BUFFER////////////////////////////////////////////////////
 
+/**
+ * @brief A plain RAM buffer. The memory is recycled through the RamBufferPool
+ * so that images of the same size do not go back to malloc/free each time.
+ **/
 template <typename T>
 class RamBuffer
 {
@@ -115,33 +121,34 @@ public:
         if (size == 0) {
             return;
         }
-        count = size;
         if (data) {
-            free(data);
+            RamBufferPool::release( data, count * sizeof(T) );
             data = 0;
         }
+        count = size;
         if (count == 0) {
             return;
         }
-        data = (T*)malloc( size * sizeof(T) );
+        data = (T*)RamBufferPool::allocate( size * sizeof(T) );
         if (!data) {
+            count = 0;
             throw std::bad_alloc();
         }
     }
 
     void clear()
     {
-        count = 0;
         if (data) {
-            free(data);
+            RamBufferPool::release( data, count * sizeof(T) );
             data = 0;
         }
+        count = 0;
     }
 
     ~RamBuffer()
     {
         if (data) {
-            free(data);
+            RamBufferPool::release( data, count * sizeof(T) );
             data = 0;
         }
     }
@@ -443,6 +450,21 @@ public:
         }
     }
 
+    /**
+     * @brief Changes the number of elements of an allocated RAM or memory mapped buffer.
+     * The content of the buffer is not preserved.
+     **/
+    void resize(U64 count)
+    {
+        if (_storageMode == eStorageModeRAM) {
+            assert(_buffer);
+            _buffer->resize(count);
+        } else if (_storageMode == eStorageModeDisk) {
+            assert(_backingFile && !_cacheFile);
+            _backingFile->resize( count * sizeof(DataType) );
+        }
+    }
+
     void allocateGLTexture(const RectI& rectangle,
                            U32 target)
     {
@@ -1054,21 +1076,25 @@ public:
 
         bool isAlloc;
         bool hasRemovedFile;
+        std::size_t sz;
         {
             QWriteLocker k(&_entryLock);
             isAlloc = _data.isAllocated();
+            if (isAlloc) {
+                sz = _data.size();
+            } else {
+                ///size() will return 0 at this point, we have to recompute it. The entry may have been
+                ///resized since it was allocated (@see resizeBuffer), so prefer the actual size of the file
+                QFileInfo info( QString::fromUtf8( _data.getFilePath().c_str() ) );
+                sz = info.exists() ? (std::size_t)info.size() : getSizeInBytesFromParams();
+            }
             hasRemovedFile = _data.removeAnyBackingFile();
         }
 
         if (hasRemovedFile) {
             _cache->backingFileClosed();
         }
-        if (isAlloc) {
-            _cache->notifyEntryDestroyed(getTime(), getElementsCountFromParams(), eStorageModeRAM);
-        } else {
-            ///size() will return 0 at this point, we have to recompute it
-            _cache->notifyEntryDestroyed(getTime(), getElementsCountFromParams(), eStorageModeDisk);
-        }
+        _cache->notifyEntryDestroyed(getTime(), sz, isAlloc ? eStorageModeRAM : eStorageModeDisk);
     }
 
     /**
@@ -1147,6 +1173,21 @@ protected:
         }
     }
 
+    /**
+     * @brief Changes the number of elements of the buffer and notifies the cache of the new size.
+     * The content of the buffer is not preserved. The entry must be allocated and the _entryLock
+     * must be locked for writing.
+     **/
+    void resizeBuffer(U64 count)
+    {
+        size_t oldSize = size();
+
+        _data.resize(count);
+        if (_cache) {
+            _cache->notifyEntrySizeChanged( oldSize, size() );
+        }
+    }
+
 private:
 
     virtual TileCacheFilePtr allocTile(std::size_t *dataOffset) OVERRIDE FINAL
@@ -0,0 +1,563 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ * Copyright (C) 2018-2020 The Natron developers
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "CacheIndex.h"
+
+#include <algorithm> // std::max
+#include <cassert>
+#include <cstring> // memcpy
+#include <stdexcept>
+
+#include <QtCore/QMutex>
+
+#include "Engine/MemoryFile.h"
+
+// "NtrCIdx1" in little-endian
+#define NATRON_CACHE_INDEX_MAGIC 0x317864494372744eULL
+#define NATRON_CACHE_INDEX_FORMAT_VERSION 1
+
+// The index file is grown by this factor so that appending records does not remap the file every time
+#define NATRON_CACHE_INDEX_GROWTH_FACTOR 2
+#define NATRON_CACHE_INDEX_MIN_BUCKETS 1024
+
+NATRON_NAMESPACE_ENTER
+
+namespace {
+enum IndexFlagsEnum
+{
+    eIndexFlagInUse = 0x1
+};
+
+enum RecordFlagsEnum
+{
+    eRecordFlagRemoved = 0x1
+};
+
+struct IndexHeader
+{
+    U64 magic;
+    U32 formatVersion;
+    U32 cacheVersion;
+    U32 flags;
+    U32 bucketsCount;
+    U64 recordsBegin; //< offset of the first record
+    U64 recordsEnd; //< offset past the last record
+    U64 recordsCount; //< live records
+    U64 recordsBytes; //< data size of the live records
+    U64 oldestRecord; //< no live record is before this offset
+    U64 tileFilesOffset; //< 0 if there is no tile files section
+    U64 tileFilesSize;
+};
+
+struct RecordHeader
+{
+    U64 next; //< previous record of the same bucket, 0 if none
+    U64 hash;
+    U64 dataSize;
+    U64 dataOffset;
+    U32 flags;
+    U32 pathLength;
+    U32 payloadLength;
+    U32 padding;
+};
+
+inline U64
+align8(U64 v)
+{
+    return (v + 7) & ~(U64)7;
+}
+
+inline U64
+getRecordSize(const RecordHeader& r)
+{
+    return align8( sizeof(RecordHeader) + r.pathLength + r.payloadLength );
+}
+} // anon namespace
+
+struct CacheIndexPrivate
+{
+    mutable QMutex lock;
+    boost::scoped_ptr<MemoryFile> file;
+
+    CacheIndexPrivate()
+        : lock()
+        , file()
+    {
+    }
+
+    IndexHeader* header() const
+    {
+        return reinterpret_cast<IndexHeader*>( file->data() );
+    }
+
+    U64* buckets() const
+    {
+        return reinterpret_cast<U64*>( file->data() + sizeof(IndexHeader) );
+    }
+
+    RecordHeader* recordAt(U64 location) const
+    {
+        return reinterpret_cast<RecordHeader*>( file->data() + location );
+    }
+
+    U64& bucketFor(U64 hash) const
+    {
+        // The hashes are well distributed, but fold the high bits since the buckets count is a power of 2
+        return buckets()[(hash ^ (hash >> 32)) & (header()->bucketsCount - 1)];
+    }
+
+    void readRecord(U64 location, CacheIndex::Record* record) const
+    {
+        const RecordHeader* r = recordAt(location);
+        const char* data = reinterpret_cast<const char*>(r) + sizeof(RecordHeader);
+
+        record->hash = r->hash;
+        record->dataSize = r->dataSize;
+        record->dataOffset = r->dataOffset;
+        record->filePath.assign(data, r->pathLength);
+        record->payload.assign(data + r->pathLength, r->payloadLength);
+        record->location = location;
+    }
+
+    void removeRecordAt(U64 location)
+    {
+        RecordHeader* r = recordAt(location);
+
+        if (r->flags & eRecordFlagRemoved) {
+            return;
+        }
+        r->flags |= eRecordFlagRemoved;
+        IndexHeader* h = header();
+        assert(h->recordsCount > 0);
+        --h->recordsCount;
+        h->recordsBytes = r->dataSize > h->recordsBytes ? 0 : h->recordsBytes - r->dataSize;
+    }
+
+    void ensureSize(U64 size)
+    {
+        if ( size <= file->size() ) {
+            return;
+        }
+        file->resize( std::max( (std::size_t)size, file->size() * NATRON_CACHE_INDEX_GROWTH_FACTOR ) );
+    }
+
+    void checkOpened() const
+    {
+        if ( !file || !file->data() ) {
+            throw std::logic_error("CacheIndex: the index is not opened");
+        }
+    }
+};
+
+CacheIndex::CacheIndex()
+    : _imp( new CacheIndexPrivate() )
+{
+}
+
+CacheIndex::~CacheIndex()
+{
+    // An index that is not closed explicitly stays marked in use
+    _imp->file.reset();
+}
+
+void
+CacheIndex::create(const std::string& filePath,
+                   unsigned int cacheVersion,
+                   std::size_t expectedRecordsCount)
+{
+    QMutexLocker k(&_imp->lock);
+    U32 bucketsCount = NATRON_CACHE_INDEX_MIN_BUCKETS;
+
+    while ( bucketsCount < expectedRecordsCount && bucketsCount < (1u << 30) ) {
+        bucketsCount *= 2;
+    }
+
+    _imp->file.reset( new MemoryFile(filePath, MemoryFile::eFileOpenModeEnumIfExistsTruncateElseCreate) );
+
+    U64 recordsBegin = align8( sizeof(IndexHeader) + bucketsCount * sizeof(U64) );
+    // Reserve room for an average record of 256 bytes
+    _imp->file->resize( recordsBegin + (U64)expectedRecordsCount * 256 );
+    std::memset( _imp->file->data(), 0, recordsBegin );
+
+    IndexHeader* h = _imp->header();
+    h->magic = NATRON_CACHE_INDEX_MAGIC;
+    h->formatVersion = NATRON_CACHE_INDEX_FORMAT_VERSION;
+    h->cacheVersion = cacheVersion;
+    h->flags = eIndexFlagInUse;
+    h->bucketsCount = bucketsCount;
+    h->recordsBegin = recordsBegin;
+    h->recordsEnd = recordsBegin;
+    h->recordsCount = 0;
+    h->recordsBytes = 0;
+    h->oldestRecord = recordsBegin;
+    h->tileFilesOffset = 0;
+    h->tileFilesSize = 0;
+}
+
+bool
+CacheIndex::open(const std::string& filePath,
+                 unsigned int cacheVersion)
+{
+    QMutexLocker k(&_imp->lock);
+
+    _imp->file.reset();
+    try {
+        _imp->file.reset( new MemoryFile(filePath, MemoryFile::eFileOpenModeEnumIfExistsKeepElseFail) );
+    } catch (const std::exception&) {
+        _imp->file.reset();
+
+        return false;
+    }
+    if ( !_imp->file->data() || (_imp->file->size() < sizeof(IndexHeader)) ) {
+        _imp->file.reset();
+
+        return false;
+    }
+
+    IndexHeader* h = _imp->header();
+    std::size_t fileSize = _imp->file->size();
+    bool valid = h->magic == NATRON_CACHE_INDEX_MAGIC &&
+                 h->formatVersion == NATRON_CACHE_INDEX_FORMAT_VERSION &&
+                 h->cacheVersion == cacheVersion &&
+                 !(h->flags & eIndexFlagInUse) &&
+                 h->bucketsCount > 0 && (h->bucketsCount & (h->bucketsCount - 1)) == 0 &&
+                 h->recordsBegin == align8( sizeof(IndexHeader) + (U64)h->bucketsCount * sizeof(U64) ) &&
+                 h->recordsBegin <= h->oldestRecord && h->oldestRecord <= h->recordsEnd && h->recordsEnd <= fileSize &&
+                 h->tileFilesOffset + h->tileFilesSize <= fileSize;
+    if (!valid) {
+        _imp->file.reset();
+
+        return false;
+    }
+
+    h->flags |= eIndexFlagInUse;
+    _imp->file->flush( MemoryFile::eFlushTypeSync, _imp->file->data(), sizeof(IndexHeader) );
+
+    return true;
+}
+
+void
+CacheIndex::close()
+{
+    QMutexLocker k(&_imp->lock);
+
+    if ( !_imp->file || !_imp->file->data() ) {
+        _imp->file.reset();
+
+        return;
+    }
+
+    IndexHeader* h = _imp->header();
+    U64 end = std::max(h->recordsEnd, h->tileFilesOffset + h->tileFilesSize);
+
+    // Make sure all records are on disk before flagging the index as closed
+    _imp->file->resize(end);
+    _imp->file->flush(MemoryFile::eFlushTypeSync, 0, 0);
+    _imp->header()->flags &= ~eIndexFlagInUse;
+    _imp->file->flush( MemoryFile::eFlushTypeSync, _imp->file->data(), sizeof(IndexHeader) );
+    _imp->file.reset();
+}
+
+void
+CacheIndex::remove()
+{
+    QMutexLocker k(&_imp->lock);
+
+    if (_imp->file) {
+        _imp->file->remove();
+        _imp->file.reset();
+    }
+}
+
+bool
+CacheIndex::isOpened() const
+{
+    QMutexLocker k(&_imp->lock);
+
+    return _imp->file && _imp->file->data();
+}
+
+U64
+CacheIndex::append(const Record& record)
+{
+    QMutexLocker k(&_imp->lock);
+
+    _imp->checkOpened();
+    if (_imp->header()->tileFilesOffset != 0) {
+        throw std::logic_error("CacheIndex::append: records cannot be appended after the tile files");
+    }
+
+    RecordHeader r;
+    std::memset( &r, 0, sizeof(RecordHeader) );
+    r.hash = record.hash;
+    r.dataSize = record.dataSize;
+    r.dataOffset = record.dataOffset;
+    r.pathLength = (U32)record.filePath.size();
+    r.payloadLength = (U32)record.payload.size();
+
+    U64 location = _imp->header()->recordsEnd;
+    U64 recordSize = getRecordSize(r);
+    _imp->ensureSize(location + recordSize);
+
+    // The file may have been remapped
+    IndexHeader* h = _imp->header();
+    U64& bucket = _imp->bucketFor(record.hash);
+    r.next = bucket;
+
+    char* dst = _imp->file->data() + location;
+    std::memcpy( dst, &r, sizeof(RecordHeader) );
+    std::memcpy( dst + sizeof(RecordHeader), record.filePath.data(), r.pathLength );
+    std::memcpy( dst + sizeof(RecordHeader) + r.pathLength, record.payload.data(), r.payloadLength );
+
+    bucket = location;
+    h->recordsEnd = location + recordSize;
+    ++h->recordsCount;
+    h->recordsBytes += record.dataSize;
+
+    return location;
+}
+
+void
+CacheIndex::takeRecords(U64 hash,
+                        std::list<Record>* records)
+{
+    QMutexLocker k(&_imp->lock);
+
+    if ( !_imp->file || !_imp->file->data() ) {
+        return;
+    }
+    U64 location = _imp->bucketFor(hash);
+    while (location != 0) {
+        const RecordHeader* r = _imp->recordAt(location);
+        if ( (r->hash == hash) && !(r->flags & eRecordFlagRemoved) ) {
+            Record record;
+            _imp->readRecord(location, &record);
+            _imp->removeRecordAt(location);
+            records->push_back(record);
+        }
+        location = r->next;
+    }
+}
+
+void
+CacheIndex::removeRecord(U64 location)
+{
+    QMutexLocker k(&_imp->lock);
+
+    _imp->checkOpened();
+    IndexHeader* h = _imp->header();
+    if ( (location < h->recordsBegin) || (location >= h->recordsEnd) ) {
+        return;
+    }
+    _imp->removeRecordAt(location);
+}
+
+bool
+CacheIndex::takeOldestRecord(Record* record)
+{
+    QMutexLocker k(&_imp->lock);
+
+    if ( !_imp->file || !_imp->file->data() ) {
+        return false;
+    }
+    IndexHeader* h = _imp->header();
+    // The cursor only moves forward, so that evicting all records is linear in the index size
+    while (h->oldestRecord < h->recordsEnd) {
+        U64 location = h->oldestRecord;
+        const RecordHeader* r = _imp->recordAt(location);
+        h->oldestRecord += getRecordSize(*r);
+        if ( !(r->flags & eRecordFlagRemoved) ) {
+            _imp->readRecord(location, record);
+            _imp->removeRecordAt(location);
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void
+CacheIndex::getRecords(std::list<Record>* records) const
+{
+    QMutexLocker k(&_imp->lock);
+
+    if ( !_imp->file || !_imp->file->data() ) {
+        return;
+    }
+    const IndexHeader* h = _imp->header();
+    U64 location = h->oldestRecord;
+    while (location < h->recordsEnd) {
+        const RecordHeader* r = _imp->recordAt(location);
+        if ( !(r->flags & eRecordFlagRemoved) ) {
+            Record record;
+            _imp->readRecord(location, &record);
+            records->push_back(record);
+        }
+        location += getRecordSize(*r);
+    }
+}
+
+void
+CacheIndex::getFilePaths(std::set<std::string>* filePaths) const
+{
+    QMutexLocker k(&_imp->lock);
+
+    if ( !_imp->file || !_imp->file->data() ) {
+        return;
+    }
+    const IndexHeader* h = _imp->header();
+    U64 location = h->oldestRecord;
+    while (location < h->recordsEnd) {
+        const RecordHeader* r = _imp->recordAt(location);
+        if ( !(r->flags & eRecordFlagRemoved) ) {
+            filePaths->insert( std::string(reinterpret_cast<const char*>(r) + sizeof(RecordHeader), r->pathLength) );
+        }
+        location += getRecordSize(*r);
+    }
+}
+
+void
+CacheIndex::clear()
+{
+    QMutexLocker k(&_imp->lock);
+
+    if ( !_imp->file || !_imp->file->data() ) {
+        return;
+    }
+    IndexHeader* h = _imp->header();
+    std::memset( _imp->buckets(), 0, h->bucketsCount * sizeof(U64) );
+    h->recordsEnd = h->recordsBegin;
+    h->oldestRecord = h->recordsBegin;
+    h->recordsCount = 0;
+    h->recordsBytes = 0;
+    h->tileFilesOffset = 0;
+    h->tileFilesSize = 0;
+}
+
+std::size_t
+CacheIndex::getRecordsCount() const
+{
+    QMutexLocker k(&_imp->lock);
+
+    if ( !_imp->file || !_imp->file->data() ) {
+        return 0;
+    }
+
+    return _imp->header()->recordsCount;
+}
+
+std::size_t
+CacheIndex::getRecordsBytes() const
+{
+    QMutexLocker k(&_imp->lock);
+
+    if ( !_imp->file || !_imp->file->data() ) {
+        return 0;
+    }
+
+    return _imp->header()->recordsBytes;
+}
+
+void
+CacheIndex::setTileFiles(const std::list<TileFileUsage>& files)
+{
+    QMutexLocker k(&_imp->lock);
+
+    _imp->checkOpened();
+
+    // Layout: U32 files count, then for each file: U32 path length, U32 tiles count, the path, 1 bit per tile
+    std::string section;
+    U32 filesCount = (U32)files.size();
+    section.append( reinterpret_cast<const char*>(&filesCount), sizeof(U32) );
+    for (std::list<TileFileUsage>::const_iterator it = files.begin(); it != files.end(); ++it) {
+        U32 pathLength = (U32)it->filePath.size();
+        U32 tilesCount = (U32)it->usedTiles.size();
+        section.append( reinterpret_cast<const char*>(&pathLength), sizeof(U32) );
+        section.append( reinterpret_cast<const char*>(&tilesCount), sizeof(U32) );
+        section.append(it->filePath);
+        std::string bits( (tilesCount + 7) / 8, '\0' );
+        for (U32 i = 0; i < tilesCount; ++i) {
+            if (it->usedTiles[i]) {
+                bits[i / 8] |= (char)(1 << (i % 8));
+            }
+        }
+        section.append(bits);
+    }
+
+    U64 offset = _imp->header()->recordsEnd;
+    _imp->ensureSize( offset + section.size() );
+    std::memcpy( _imp->file->data() + offset, section.data(), section.size() );
+    IndexHeader* h = _imp->header();
+    h->tileFilesOffset = offset;
+    h->tileFilesSize = section.size();
+}
+
+void
+CacheIndex::getTileFiles(std::list<TileFileUsage>* files) const
+{
+    QMutexLocker k(&_imp->lock);
+
+    if ( !_imp->file || !_imp->file->data() ) {
+        return;
+    }
+    const IndexHeader* h = _imp->header();
+    if (h->tileFilesOffset == 0) {
+        return;
+    }
+
+    const char* data = _imp->file->data() + h->tileFilesOffset;
+    const char* end = data + h->tileFilesSize;
+    U32 filesCount;
+    if ( data + sizeof(U32) > end ) {
+        return;
+    }
+    std::memcpy( &filesCount, data, sizeof(U32) );
+    data += sizeof(U32);
+    for (U32 f = 0; f < filesCount; ++f) {
+        U32 pathLength, tilesCount;
+        if ( data + 2 * sizeof(U32) > end ) {
+            return;
+        }
+        std::memcpy( &pathLength, data, sizeof(U32) );
+        std::memcpy( &tilesCount, data + sizeof(U32), sizeof(U32) );
+        data += 2 * sizeof(U32);
+        std::size_t bitsSize = (tilesCount + 7) / 8;
+        if ( data + pathLength + bitsSize > end ) {
+            return;
+        }
+        TileFileUsage usage;
+        usage.filePath.assign(data, pathLength);
+        data += pathLength;
+        usage.usedTiles.resize(tilesCount);
+        for (U32 i = 0; i < tilesCount; ++i) {
+            usage.usedTiles[i] = ( data[i / 8] & (1 << (i % 8)) ) != 0;
+        }
+        data += bitsSize;
+        files->push_back(usage);
+    }
+}
+
+NATRON_NAMESPACE_EXIT
@@ -0,0 +1,191 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ * Copyright (C) 2018-2020 The Natron developers
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_CACHEINDEX_H
+#define NATRON_ENGINE_CACHEINDEX_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <list>
+#include <set>
+#include <string>
+#include <vector>
+#include <cstddef>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/scoped_ptr.hpp>
+#endif
+
+#include "Global/GlobalDefines.h"
+#include "Engine/EngineFwd.h"
+
+NATRON_NAMESPACE_ENTER
+
+struct CacheIndexPrivate;
+
+/**
+ * @brief The on-disk table of contents of a Cache, used to restore the cache of the previous session.
+ *
+ * The index is a memory-mapped file made of a header, a table of hash buckets and a log of records appended
+ * one after another. Each record holds where the data of an entry lives (file, offset, size) along with
+ * an opaque payload (the serialized key and params of the entry) and is chained to the previous record
+ * of the same bucket. Opening the index only reads the header: records are looked up by hash when the cache
+ * is first asked for them, hence restoring the cache costs the same whatever its size.
+ *
+ * Records are never moved nor rewritten: removing a record just flags it. The index is compacted
+ * by writing a new one from the live records when the cache is saved.
+ *
+ * The header tells whether the index is in use: an index that was not closed properly (e.g: the application
+ * crashed) cannot be opened, because the entries it references may have been overwritten since.
+ * The file uses the byte order of the machine, it is not meant to be shared.
+ *
+ * All functions are thread-safe.
+ **/
+class CacheIndex
+{
+public:
+
+    struct Record
+    {
+        U64 hash;
+        std::size_t dataSize; //< the data size in bytes
+        std::size_t dataOffset; //< offset of the data in the file
+        std::string filePath;
+        std::string payload;
+        U64 location; //< where the record is in the index, set by the index
+
+        Record()
+            : hash(0)
+            , dataSize(0)
+            , dataOffset(0)
+            , filePath()
+            , payload()
+            , location(0)
+        {
+        }
+    };
+
+    /**
+     * @brief The tiles of a tiled cache file that are used by an entry.
+     **/
+    struct TileFileUsage
+    {
+        std::string filePath;
+        std::vector<bool> usedTiles;
+    };
+
+    CacheIndex();
+
+    ~CacheIndex();
+
+    /**
+     * @brief Creates an empty index at the given path, replacing any existing file.
+     * expectedRecordsCount is used to size the hash table.
+     * This function may throw exceptions in case of failure.
+     **/
+    void create(const std::string& filePath,
+                unsigned int cacheVersion,
+                std::size_t expectedRecordsCount);
+
+    /**
+     * @brief Opens an index previously written with create() and then close(). Only the header is read.
+     * @returns False if the file does not exist, is not an index of the given cache version or was not closed properly.
+     * The index is then marked in use until close() is called.
+     **/
+    bool open(const std::string& filePath,
+              unsigned int cacheVersion);
+
+    /**
+     * @brief Flushes the index and marks it as properly closed, so that it can be opened again.
+     **/
+    void close();
+
+    /**
+     * @brief Closes the index and removes its file.
+     **/
+    void remove();
+
+    bool isOpened() const;
+
+    /**
+     * @brief Appends a record to the index and returns its location.
+     * This function may throw exceptions in case of failure.
+     **/
+    U64 append(const Record& record);
+
+    /**
+     * @brief Removes the live records with the given hash from the index and returns them.
+     **/
+    void takeRecords(U64 hash, std::list<Record>* records);
+
+    /**
+     * @brief Removes the record at the given location, if it is still alive.
+     **/
+    void removeRecord(U64 location);
+
+    /**
+     * @brief Removes the oldest live record from the index and returns it.
+     * @returns False if there is no record left.
+     **/
+    bool takeOldestRecord(Record* record);
+
+    /**
+     * @brief Returns all live records, oldest first.
+     **/
+    void getRecords(std::list<Record>* records) const;
+
+    /**
+     * @brief Returns the file paths of all live records, without reading their payload.
+     **/
+    void getFilePaths(std::set<std::string>* filePaths) const;
+
+    /**
+     * @brief Removes all records.
+     **/
+    void clear();
+
+    std::size_t getRecordsCount() const;
+
+    /**
+     * @brief Returns the sum of the data size of all live records.
+     **/
+    std::size_t getRecordsBytes() const;
+
+    /**
+     * @brief Stores the tiles usage of the files of a tiled cache. It is written after the records,
+     * hence no record can be appended afterwards.
+     **/
+    void setTileFiles(const std::list<TileFileUsage>& files);
+
+    void getTileFiles(std::list<TileFileUsage>* files) const;
+
+private:
+
+    boost::scoped_ptr<CacheIndexPrivate> _imp;
+};
+
+NATRON_NAMESPACE_EXIT
+
+#endif // NATRON_ENGINE_CACHEINDEX_H
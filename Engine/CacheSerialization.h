@@ -28,11 +28,16 @@
 
 #include "Global/Macros.h"
 
+#include <cmath> // std::floor
 #include <list>
 #include <set>
 #include <cstddef>
+#include <sstream>
 #include <stdexcept>
 
+#include <QtCore/QDateTime>
+#include <QtConcurrentRun> // QtCore on Qt4, QtConcurrent on Qt5
+
 #if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
 #include <boost/shared_ptr.hpp>
 GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_OFF
@@ -51,16 +56,13 @@ GCC_DIAG_ON(unused-parameter)
 #endif
 
 #include "Engine/Cache.h"
+#include "Engine/CacheIndex.h"
 #include "Engine/ImageSerialization.h"
 #include "Engine/ImageParamsSerialization.h"
 #include "Engine/FrameEntrySerialization.h"
 #include "Engine/FrameParamsSerialization.h"
 #include "Engine/EngineFwd.h"
 
-// Note: these classes are used for cache serialization and do not have to maintain backward compatibility
-#define SERIALIZED_ENTRY_INTRODUCES_SIZE 2
-#define SERIALIZED_ENTRY_VERSION SERIALIZED_ENTRY_INTRODUCES_SIZE
-
 //Beyond that percentage of occupation, the cache will start evicting LRU entries
 #define NATRON_CACHE_LIMIT_PERCENT 0.9
 
@@ -69,33 +71,112 @@ GCC_DIAG_ON(unused-parameter)
 
 NATRON_NAMESPACE_ENTER
 
-/*Saves cache to disk as a settings file.
- */
+/**
+ * @brief Serializes the key and params of an entry in the payload of a record of the CacheIndex.
+ **/
+template<typename EntryType>
+std::string
+serializeCacheIndexPayload(const typename EntryType::key_type & key,
+                           const typename Cache<EntryType>::ParamsTypePtr & params)
+{
+    std::ostringstream ss(std::ios_base::out | std::ios_base::binary);
+    {
+        boost::archive::binary_oarchive oArchive(ss, boost::archive::no_header);
+        oArchive << key;
+        oArchive << params;
+    }
+
+    return ss.str();
+}
+
+/**
+ * @brief Creates the entry described by a record of the CacheIndex, or returns NULL if the record is invalid.
+ **/
+template<typename EntryType>
+EntryType*
+createCacheEntryFromIndexRecord(const CacheIndex::Record& record,
+                                const Cache<EntryType>* cache)
+{
+    typename EntryType::key_type key;
+    typename Cache<EntryType>::ParamsTypePtr params;
+
+    try {
+        std::istringstream ss(record.payload, std::ios_base::in | std::ios_base::binary);
+        boost::archive::binary_iarchive iArchive(ss, boost::archive::no_header);
+        iArchive >> key;
+        iArchive >> params;
+    } catch (const std::exception & e) {
+        qDebug() << "Exception when reading cache index record:" << e.what();
+
+        return 0;
+    }
+
+    if ( record.hash != key.getHash() ) {
+        /*
+         * If this warning is printed this means that the value computed by key.getHash()
+         * is different than the value stored prior to serialiazing this entry. In other words there're
+         * 2 possibilities:
+         * 1) The key has changed since it has been added to the cache: maybe you forgot to serialize some
+         * members of the key or you didn't save them correctly.
+         * 2) The hash key computation is unreliable and is depending upon changing or non-deterministic
+         * parameters which is wrong.
+         */
+        qDebug() << "WARNING: serialized hash key different than the restored one";
+
+        return 0;
+    }
+
+#ifdef DEBUG
+    if ( !cache->isTileCache() && !CacheAPI::checkFileNameMatchesHash(record.filePath, record.hash) ) {
+        qDebug() << "WARNING: Cache entry filename is not the same as the serialized hash key";
+    }
+#endif
+
+    return new EntryType(key, params, cache);
+}
+
 template<typename EntryType>
 void
-Cache<EntryType>::save(CacheTOC* tableOfContents)
+Cache<EntryType>::save(bool keepIndexOpened)
 {
     clearInMemoryPortion(false);
+
+    // Entries of the previous session that were never looked-up are written back first: they are the oldest.
+    // Taking them one by one lets get() restore them concurrently.
+    std::list<CacheIndex::Record> records;
     {
-        QMutexLocker l(&_lock);     // must be locked
+        CacheIndex::Record record;
+        while ( _index->takeOldestRecord(&record) ) {
+            records.push_back(record);
+        }
+    }
+    std::size_t indexedRecordsCount = records.size();
 
-        for (CacheIterator it = _diskCache.begin(); it != _diskCache.end(); ++it) {
+    for (std::size_t i = 0; i < _shards.size(); ++i) {
+        CacheShard& shard = *_shards[i];
+        QMutexLocker l(&shard.lock);     // must be locked
+
+        for (CacheIterator it = shard.diskCache.begin(); it != shard.diskCache.end(); ++it) {
             std::list<EntryTypePtr> & listOfValues  = getValueFromIterator(it);
             for (typename std::list<EntryTypePtr>::const_iterator it2 = listOfValues.begin(); it2 != listOfValues.end(); ++it2) {
                 if ( (*it2)->isStoredOnDisk() ) {
-                    SerializedEntry serialization;
-                    serialization.hash = (*it2)->getHashKey();
-                    serialization.params = (*it2)->getParams();
-                    serialization.key = (*it2)->getKey();
-                    serialization.size = (*it2)->dataSize();
-                    serialization.filePath = (*it2)->getFilePath();
-                    serialization.dataOffsetInFile = (*it2)->getOffsetInFile();
+                    CacheIndex::Record record;
+                    record.hash = (*it2)->getHashKey();
+                    record.dataSize = (*it2)->dataSize();
+                    record.filePath = (*it2)->getFilePath();
+                    record.dataOffset = (*it2)->getOffsetInFile();
+                    try {
+                        record.payload = serializeCacheIndexPayload<EntryType>( (*it2)->getKey(), (*it2)->getParams() );
+                    } catch (const std::exception & e) {
+                        qDebug() << "Failed to serialize cache entry:" << e.what();
+                        continue;
+                    }
 
                     (*it2)->syncBackingFile();
-                    
-                    tableOfContents->push_back(serialization);
+
+                    records.push_back(record);
 #ifdef DEBUG
-                    if ( !_isTiled && !CacheAPI::checkFileNameMatchesHash(serialization.filePath, serialization.hash) ) {
+                    if ( !_isTiled && !CacheAPI::checkFileNameMatchesHash(record.filePath, record.hash) ) {
                         qDebug() << "WARNING: Cache entry filename is not the same as the serialized hash key";
                     }
 #endif
@@ -103,66 +184,81 @@ Cache<EntryType>::save(CacheTOC* tableOfContents)
             }
         }
     }
-}
 
-/*Restores the cache from disk.*/
-template<typename EntryType>
-void
-Cache<EntryType>::restore(const CacheTOC & tableOfContents)
-{
-    ///Make sure the shared_ptrs live in this list and are destroyed not while under the lock
-    ///so that the memory freeing (which might be expensive for large images) doesn't happen while under the lock
-    std::list<EntryTypePtr> entriesToBeDeleted;
-
-    std::set<QString> usedFilePaths;
-    for (typename CacheTOC::const_iterator it =
-             tableOfContents.begin(); it != tableOfContents.end(); ++it) {
-        if ( it->hash != it->key.getHash() ) {
-            /*
-             * If this warning is printed this means that the value computed by it->key()
-             * is different than the value stored prior to serialiazing this entry. In other words there're
-             * 2 possibilities:
-             * 1) The key has changed since it has been added to the cache: maybe you forgot to serialize some
-             * members of the key or you didn't save them correctly.
-             * 2) The hash key computation is unreliable and is depending upon changing or non-deterministic
-             * parameters which is wrong.
-             */
-            qDebug() << "WARNING: serialized hash key different than the restored one";
-        }
+    // Write a new index rather than appending to the current one: this compacts it
+    _index->remove();
+    _index->create( getRestoreFilePath(), cacheVersion(), records.size() );
 
-#ifdef DEBUG
-        if ( !_isTiled && !checkFileNameMatchesHash(it->filePath, it->hash) ) {
-            qDebug() << "WARNING: Cache entry filename is not the same as the serialized hash key";
+    std::list<U64> diskPortionRecords;
+    std::size_t recordIndex = 0;
+    for (std::list<CacheIndex::Record>::const_iterator it = records.begin(); it != records.end(); ++it, ++recordIndex) {
+        U64 location = _index->append(*it);
+        if (recordIndex >= indexedRecordsCount) {
+            diskPortionRecords.push_back(location);
         }
-#endif
+    }
 
-        EntryType* value = NULL;
+    if ( isTileCache() ) {
+        std::list<CacheIndex::TileFileUsage> tileFiles;
+        QMutexLocker k(&_tileCacheMutex);
+        for (std::set<TileCacheFilePtr>::const_iterator it = _cacheFiles.begin(); it != _cacheFiles.end(); ++it) {
+            CacheIndex::TileFileUsage usage;
+            usage.filePath = (*it)->file->path();
+            usage.usedTiles = (*it)->usedTiles;
+            tileFiles.push_back(usage);
+        }
+        _index->setTileFiles(tileFiles);
+    }
 
-        try {
-            value = new EntryType(it->key, it->params, this);
-            if (it->size != getTileSizeBytes()) {
-                delete value;
-                continue;
-            }
-            ///This will not put the entry back into RAM, instead we just insert back the entry into the disk cache
-            value->restoreMetadataFromFile(it->size, it->filePath, it->dataOffsetInFile);
-        } catch (const std::exception & e) {
-            qDebug() << e.what();
-            delete value;
-            continue;
+    if (keepIndexOpened) {
+        // The entries of the disk portion are still alive in this session: remove them from the index
+        // so that they can only be found in the disk portion. The index will be written again when exiting.
+        for (std::list<U64>::const_iterator it = diskPortionRecords.begin(); it != diskPortionRecords.end(); ++it) {
+            _index->removeRecord(*it);
         }
-        const std::string& filePath = value->getFilePath();
-        usedFilePaths.insert(QString::fromUtf8(filePath.c_str()));
+    } else {
+        _index->close();
+    }
+} // save
+
+template<typename EntryType>
+bool
+Cache<EntryType>::restore()
+{
+    if ( !_index->open( getRestoreFilePath(), cacheVersion() ) ) {
+        return false;
+    }
+
+    if ( isTileCache() ) {
+        // Re-open the tile files with the tiles used by the entries of the index
+        std::list<CacheIndex::TileFileUsage> tileFiles;
+        _index->getTileFiles(&tileFiles);
+
+        std::set<QString> usedFilePaths;
+        usedFilePaths.insert( QString::fromUtf8( getRestoreFilePath().c_str() ) );
         {
-            QMutexLocker locker(&_lock);
-            sealEntry(EntryTypePtr(value), false /*inMemory*/);
+            QMutexLocker k(&_tileCacheMutex);
+            std::size_t nTilesPerFile = std::floor( ( (double)NATRON_TILE_CACHE_FILE_SIZE_BYTES ) / _tileByteSize );
+            for (std::list<CacheIndex::TileFileUsage>::const_iterator it = tileFiles.begin(); it != tileFiles.end(); ++it) {
+                // The tile size may have changed since the previous session
+                if ( (it->usedTiles.size() != nTilesPerFile) || !fileExists(it->filePath) ) {
+                    continue;
+                }
+                TileCacheFilePtr tileFile = boost::make_shared<TileCacheFile>();
+                try {
+                    tileFile->file = boost::make_shared<MemoryFile>(it->filePath, MemoryFile::eFileOpenModeEnumIfExistsKeepElseFail);
+                } catch (const std::exception & e) {
+                    qDebug() << e.what();
+                    continue;
+                }
+                tileFile->usedTiles = it->usedTiles;
+                _cacheFiles.insert(tileFile);
+                usedFilePaths.insert( QString::fromUtf8( it->filePath.c_str() ) );
+            }
         }
-    }
 
-    // Remove from the cache all files that are not referenced by the table of contents
-    QString cachePath = getCachePath();
-    if (isTileCache()) {
-        QDir cacheFolder(cachePath);
+        // Remove from the cache all files that are not referenced by the index
+        QDir cacheFolder( getCachePath() );
         QString absolutePath = cacheFolder.absolutePath();
         QStringList etr = cacheFolder.entryList(QDir::NoDotAndDotDot);
         for (QStringList::iterator it = etr.begin(); it!=etr.end(); ++it) {
@@ -174,61 +270,29 @@ Cache<EntryType>::restore(const CacheTOC & tableOfContents)
             }
         }
     } else {
-        for (U32 i = 0x00; i <= 0xF; ++i) {
-            for (U32 j = 0x00; j <= 0xF; ++j) {
-                char str[3] = { '0', '0', 0 };
-                str[0] += i;
-                str[1] += j;
-
-                QDir cacheFolder(cachePath + QLatin1Char('/') + QString::fromUtf8(str));
-                QString absolutePath = cacheFolder.absolutePath();
-                QStringList etr = cacheFolder.entryList(QDir::NoDotAndDotDot);
-                for (QStringList::iterator it = etr.begin(); it!=etr.end(); ++it) {
-                    QString entryFilePath = absolutePath + QLatin1Char('/') + *it;
-
-                    std::set<QString>::iterator foundUsed = usedFilePaths.find(entryFilePath);
-                    if (foundUsed == usedFilePaths.end()) {
-                        cacheFolder.remove(*it);
-                    }
-                }
-            }
+        // Remove the files that are not referenced by the index, e.g. those of the entries that were still
+        // being deleted when the previous session ended. Listing the files of the 256 subfolders would make
+        // launching slow with a large cache, hence this is done on a background thread: the files that were
+        // created since the cache was restored are not removed.
+        std::set<std::string> indexedFilePaths;
+        _index->getFilePaths(&indexedFilePaths);
+        std::set<QString> usedFilePaths;
+        for (std::set<std::string>::const_iterator it = indexedFilePaths.begin(); it != indexedFilePaths.end(); ++it) {
+            usedFilePaths.insert( QString::fromUtf8( it->c_str() ) );
         }
-
+        QtConcurrent::run( removeUnreferencedCacheFiles, getCachePath(), usedFilePaths, QDateTime::currentDateTime() );
     }
-}
 
-template<typename EntryType>
-struct Cache<EntryType>::SerializedEntry
-{
-    hash_type hash;
-    typename EntryType::key_type key;
-    ParamsTypePtr params;
-    std::size_t size; //< the data size in bytes
-    std::string filePath; //< we need to serialize it as several entries can have the same hash, hence we index them
-    std::size_t dataOffsetInFile;
-
-    SerializedEntry()
-        : hash(0)
-          , key()
-          , params()
-          , size(0)
-          , filePath()
-          , dataOffsetInFile(0)
+    // Entries are only created when get() asks for them, but they are accounted for right away
+    // so that the oldest ones get evicted if the cache is full
     {
+        QMutexLocker k(&_sizeLock);
+        _diskCacheSize += _index->getRecordsBytes();
     }
+    _indexRecordDecoder = &createCacheEntryFromIndexRecord<EntryType>;
 
-    template<class Archive>
-    void serialize(Archive & ar,
-                   const unsigned int /*version*/)
-    {
-        ar & ::boost::serialization::make_nvp("Hash", hash);
-        ar & ::boost::serialization::make_nvp("Key", key);
-        ar & ::boost::serialization::make_nvp("Params", params);
-        ar & ::boost::serialization::make_nvp("Size", size);
-        ar & ::boost::serialization::make_nvp("Filename", filePath);
-        ar & ::boost::serialization::make_nvp("Offset", dataOffsetInFile);
-    }
-};
+    return true;
+} // restore
 
 NATRON_NAMESPACE_EXIT
 
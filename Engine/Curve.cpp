@@ -27,6 +27,8 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <limits>
 #include <stdexcept>
 
 #if !defined(SBK_RUN) && !defined(Q_MOC_RUN)
@@ -975,6 +977,120 @@ Curve::getValueAt(double t,
     }
 } // getValueAt
 
+void
+Curve::getValuesAt(const double* times,
+                   double* values,
+                   int n,
+                   bool doClamp) const
+{
+    if (n <= 0) {
+        return;
+    }
+    assert(times && values);
+
+    QMutexLocker l(&_imp->_lock);
+
+    if ( _imp->keyFrames.empty() ) {
+        // A curve with no control points is considered to be 0, @see getValueAt()
+        std::fill(values, values + n, 0.);
+
+        return;
+    }
+
+    const KeyFrameSet& keyFrames = _imp->keyFrames;
+    const double inf = std::numeric_limits<double>::infinity();
+    KeyFrameSet::const_iterator itup = keyFrames.end();
+    // times in [segmentStart, segmentEnd) share the same upper keyframe 'itup'
+    double segmentStart = inf;
+    double segmentEnd = inf;
+    int i = 0;
+    while (i < n) {
+        double t = times[i];
+
+        // Find the first keyframe with time greater than t. When the times are sorted, this
+        // is the previous segment's upper keyframe or one of the few following it.
+        if ( _imp->isPeriodic || !(t >= segmentStart) ) {
+            itup = keyFrames.upper_bound( KeyFrame(t, 0.) );
+        } else {
+            while ( itup != keyFrames.end() && itup->getTime() <= t ) {
+                ++itup;
+            }
+        }
+
+        double tcur, tnext;
+        double vcurDerivRight, vnextDerivLeft, vcur, vnext;
+        KeyframeTypeEnum interp, interpNext;
+        interParams(keyFrames,
+                    _imp->isPeriodic,
+                    _imp->xMin,
+                    _imp->xMax,
+                    &t,
+                    itup,
+                    &tcur,
+                    &vcur,
+                    &vcurDerivRight,
+                    &interp,
+                    &tnext,
+                    &vnext,
+                    &vnextDerivLeft,
+                    &interpNext);
+
+        if (_imp->isPeriodic) {
+            // t was brought back in the keyframes range: evaluate it alone
+            Interpolation::interpolateN(tcur, vcur, vcurDerivRight, vnextDerivLeft, tnext, vnext,
+                                        &t, 1, interp, interpNext, values + i);
+            ++i;
+            continue;
+        }
+
+        // All the following times that fall on the same segment are evaluated at once
+        if ( itup == keyFrames.begin() ) {
+            segmentStart = -inf;
+        } else {
+            KeyFrameSet::const_iterator itcur = itup;
+            --itcur;
+            segmentStart = itcur->getTime();
+        }
+        segmentEnd = ( itup == keyFrames.end() ) ? inf : itup->getTime();
+        int end = i + 1;
+        while ( end < n && times[end] >= segmentStart && times[end] < segmentEnd ) {
+            ++end;
+        }
+        Interpolation::interpolateN(tcur, vcur, vcurDerivRight, vnextDerivLeft, tnext, vnext,
+                                    times + i, end - i, interp, interpNext, values + i);
+        i = end;
+    }
+
+    if ( doClamp && mustClamp() ) {
+        // the range may come from the owner knob: fetch it once for all the samples
+        const YRange minmax = getCurveYRange();
+        for (int j = 0; j < n; ++j) {
+            if (values[j] > minmax.max) {
+                values[j] = minmax.max;
+            } else if (values[j] < minmax.min) {
+                values[j] = minmax.min;
+            }
+        }
+    }
+
+    switch (_imp->type) {
+    case CurvePrivate::eCurveTypeString:
+    case CurvePrivate::eCurveTypeInt:
+        for (int j = 0; j < n; ++j) {
+            values[j] = std::floor(values[j] + 0.5);
+        }
+        break;
+    case CurvePrivate::eCurveTypeBool:
+        for (int j = 0; j < n; ++j) {
+            values[j] = values[j] >= 0.5 ? 1. : 0.;
+        }
+        break;
+    case CurvePrivate::eCurveTypeDouble:
+    default:
+        break;
+    }
+} // getValuesAt
+
 double
 Curve::getDerivativeAt(double t) const
 {
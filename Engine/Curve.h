@@ -256,6 +256,13 @@ public:
      */
     double getValueAt(double t, bool clamp = true) const WARN_UNUSED_RETURN;
 
+    /*
+     * Same as getValueAt() for the n times in 'times', written to 'values'.
+     * The curve is locked once, keyframes are walked linearly when the times are
+     * sorted and each segment is evaluated with SIMD. Results are identical to getValueAt().
+     */
+    void getValuesAt(const double* times, double* values, int n, bool clamp = true) const;
+
     double getDerivativeAt(double t) const WARN_UNUSED_RETURN;
 
     double getIntegrateFromTo(double t1, double t2) const WARN_UNUSED_RETURN;
@@ -47,6 +47,7 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 
 #include <QtCore/QReadWriteLock>
 #include <QtCore/QCoreApplication>
+#include <QtCore/QThreadStorage>
 #include <QtConcurrentMap> // QtCore on Qt4, QtConcurrent on Qt5
 #include <QtConcurrentRun> // QtCore on Qt4, QtConcurrent on Qt5
 
@@ -61,6 +62,7 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 #include "Engine/ImageParams.h"
 #include "Engine/KnobFile.h"
 #include "Engine/KnobTypes.h"
+#include "Engine/KnobValuesSnapshot.h"
 #include "Engine/Log.h"
 #include "Engine/MemoryInfo.h" // printAsRAM
 #include "Engine/Node.h"
@@ -85,6 +87,9 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 
 //#define NATRON_ALWAYS_ALLOCATE_FULL_IMAGE_BOUNDS
 
+// The coarsest mipmap level cached by cacheMipMapPyramid (1/32 of the full resolution)
+#define NATRON_MIPMAP_PYRAMID_MAX_LEVEL 5
+
 
 NATRON_NAMESPACE_ENTER
 
@@ -328,6 +333,19 @@ EffectInstance::setParallelRenderArgsTLS(double time,
     args->stats = stats;
     args->openGLContext = glContext;
     argsList.push_back(args);
+
+    // Capture the knob values once for all the render threads of this frame. On the main thread,
+    // knobs are read from the gui curves and values, which the render threads never use.
+    if ( QThread::currentThread() != qApp->thread() ) {
+        // The node hash changes whenever a knob changes: reuse the values captured by the previous render of the same frame
+        QMutexLocker k(&_imp->knobValuesSnapshotMutex);
+        if ( !_imp->knobValuesSnapshot || (args->nodeHash == 0) || (_imp->knobValuesSnapshotHash != args->nodeHash) ||
+             (_imp->knobValuesSnapshot->getTime() != time) ) {
+            _imp->knobValuesSnapshot = boost::make_shared<KnobValuesSnapshot>(this, time);
+            _imp->knobValuesSnapshotHash = args->nodeHash;
+        }
+        args->knobValues = _imp->knobValuesSnapshot;
+    }
 }
 
 bool
@@ -1023,7 +1041,7 @@ EffectInstance::getImage(int inputNb,
                 }
 
                 inputImg = attachedStroke->renderMaskFromStroke(components,
-                                                                time, view, depth, mipMapLevel, rotoSrcRod);
+                                                                time, view, depth, mipMapLevel, rotoSrcRod, roi);
 
                 if ( roto->isDoingNeatRender() ) {
                     getApp()->updateStrokeImage(inputImg, 0, false);
@@ -1621,6 +1639,61 @@ EffectInstance::convertRAMImageToOpenGLTexture(const ImagePtr& image)
     return gpuImage;
 } // convertRAMImageToOpenGLTexture
 
+void
+EffectInstance::cacheMipMapPyramid(const ImagePtr& fullScaleImage,
+                                   const RectI& roi)
+{
+    assert(fullScaleImage->getMipMapLevel() == 0);
+    if ( (fullScaleImage->getStorageMode() != eStorageModeRAM) || !fullScaleImage->usesBitMap() ||
+         ( fullScaleImage->getBitDepth() == eImageBitDepthHalf) ) {
+        return;
+    }
+
+    const ImageKey& key = fullScaleImage->getKey();
+    ImageParamsPtr params = fullScaleImage->getParams();
+    const RectD& rod = params->getRoD();
+    ImagePtr srcImage = fullScaleImage;
+
+    // Halve the even-aligned roi so that the pixels of the next level straddling 2 renders get updated too
+    RectI srcRoI;
+    if ( !roi.roundPowerOfTwoSmallestEnclosing(1).intersect(fullScaleImage->getBounds(), &srcRoI) ) {
+        return;
+    }
+    for (unsigned int level = 1; level <= NATRON_MIPMAP_PYRAMID_MAX_LEVEL; ++level) {
+        if ( (srcRoI.width() < 2) || (srcRoI.height() < 2) ) {
+            break;
+        }
+
+        // Use the bounds a render at this level would use, so that the lookup of the next render finds this image
+        RectI levelBounds;
+        rod.toPixelEnclosing(level, params->getPixelAspectRatio(), &levelBounds);
+        levelBounds.merge( srcImage->getBounds().downscalePowerOfTwoSmallestEnclosing(1) );
+
+        ImageParamsPtr levelParams = Image::makeParams(rod,
+                                                       levelBounds,
+                                                       params->getPixelAspectRatio(),
+                                                       level,
+                                                       params->isRodProjectFormat(),
+                                                       params->getComponents(),
+                                                       params->getBitDepth(),
+                                                       params->getPremultiplication(),
+                                                       params->getFieldingOrder(),
+                                                       eStorageModeRAM);
+        ImagePtr levelImage;
+        getOrCreateFromCacheInternal(key, levelParams, true /*useCache*/, &levelImage);
+        if (!levelImage) {
+            return;
+        }
+
+        srcImage->halveToNextMipMapLevel(srcRoI, levelImage.get());
+
+        srcImage = levelImage;
+        if ( !srcRoI.downscalePowerOfTwoSmallestEnclosing(1).roundPowerOfTwoSmallestEnclosing(1).intersect(levelImage->getBounds(), &srcRoI) ) {
+            break;
+        }
+    }
+} // cacheMipMapPyramid
+
 void
 EffectInstance::getImageFromCacheAndConvertIfNeeded(bool /*useCache*/,
                                                     StorageModeEnum storage,
@@ -1868,6 +1941,56 @@ EffectInstance::getImageFromCacheAndConvertIfNeeded(bool /*useCache*/,
     } // isCached
 } // EffectInstance::getImageFromCacheAndConvertIfNeeded
 
+/**
+ * @brief If effect does not modify the image of one of its inputs at the same time and view (e.g: a Dot or a node with a mix of 0),
+ * returns the index of this input, -1 otherwise. A transform can then be concatenated through the effect.
+ * The effect must be identity over the whole image of its input: a Crop is identity inside its region of definition,
+ * but concatenating through it would drop the pixels it removes outside.
+ **/
+static int
+getIdentityInputForConcatenation(const EffectInstancePtr& effect,
+                                 double time,
+                                 ViewIdx view,
+                                 const RenderScale & scale)
+{
+    U64 hash = effect->getRenderHash();
+    RectD rod;
+    bool isProjectFormat;
+    StatusEnum stat = effect->getRegionOfDefinition_public(hash, time, scale, view, &rod, &isProjectFormat);
+
+    if ( (stat == eStatusFailed) || rod.isNull() ) {
+        return -1;
+    }
+    RectI pixelRod;
+    rod.toPixelEnclosing(scale, effect->getAspectRatio(-1), &pixelRod);
+
+    double identityTime;
+    ViewIdx identityView;
+    int identityInputNb = -1;
+    bool isIdentity;
+    try {
+        isIdentity = effect->isIdentity_public(true, hash, time, scale, pixelRod, view, &identityTime, &identityView, &identityInputNb);
+    } catch (...) {
+        return -1;
+    }
+    // A transform fetched at another time or view cannot be concatenated with the transforms of this time and view
+    if ( !isIdentity || (identityInputNb < 0) || (identityTime != time) || (identityView != view) || effect->isInputMask(identityInputNb) ) {
+        return -1;
+    }
+
+    EffectInstancePtr identityInput = effect->getInput(identityInputNb);
+    if (!identityInput) {
+        return -1;
+    }
+    RectD inputRod;
+    stat = identityInput->getRegionOfDefinition_public(identityInput->getRenderHash(), time, scale, view, &inputRod, &isProjectFormat);
+    if ( (stat == eStatusFailed) || !rod.contains(inputRod) ) {
+        return -1;
+    }
+
+    return identityInputNb;
+}
+
 void
 EffectInstance::tryConcatenateTransforms(double time,
                                          bool draftRender,
@@ -1913,13 +2036,17 @@ EffectInstance::tryConcatenateTransforms(double time,
             // recursion upstream
             bool inputCanTransform = false;
             bool inputIsDisabled  =  input->getNode()->isNodeDisabled();
+            int inputIdentityInputNb = -1;
 
             if (!inputIsDisabled) {
                 inputCanTransform = input->getNode()->getCurrentCanTransform();
+                if (!inputCanTransform) {
+                    inputIdentityInputNb = getIdentityInputForConcatenation(input, time, view, scale);
+                }
             }
 
 
-            while ( input && (inputCanTransform || inputIsDisabled) ) {
+            while ( input && (inputCanTransform || inputIsDisabled || inputIdentityInputNb >= 0) ) {
                 //input is either disabled, or identity or can concatenate a transform too
                 if (inputIsDisabled) {
                     int prefInput;
@@ -1947,14 +2074,24 @@ EffectInstance::tryConcatenateTransforms(double time,
                     } else {
                         break;
                     }
+                } else if (inputIdentityInputNb >= 0) {
+                    ///The input does not modify its image (e.g: a Dot), fetch directly from its identity input so that
+                    ///the transforms upstream are concatenated with the ones downstream
+                    im.newInputNbToFetchFrom = inputIdentityInputNb;
+                    im.newInputEffect = input;
+                    input = input->getInput(inputIdentityInputNb);
                 } else {
                     assert(false);
                 }
 
                 if (input) {
                     inputIsDisabled = input->getNode()->isNodeDisabled();
+                    inputIdentityInputNb = -1;
                     if (!inputIsDisabled) {
                         inputCanTransform = input->getNode()->getCurrentCanTransform();
+                        if (!inputCanTransform) {
+                            inputIdentityInputNb = getIdentityInputForConcatenation(input, time, view, scale);
+                        }
                     }
                 }
             }
@@ -2144,7 +2281,8 @@ EffectInstance::renderInputImagesForRoI(const FrameViewRequest* request,
 EffectInstance::RenderingFunctorRetEnum
 EffectInstance::Implementation::tiledRenderingFunctor(EffectInstance::Implementation::TiledRenderingFunctorArgs & args,
                                                       const RectToRender & specificData,
-                                                      QThread* callingThread)
+                                                      QThread* callingThread,
+                                                      const TLSSnapshot* callerTLS)
 {
     ///Make the thread-storage live as long as the render action is called if we're in a newly launched thread in eRenderSafetyFullySafeFrame mode
     QThread* curThread = QThread::currentThread();
@@ -2152,37 +2290,94 @@ EffectInstance::Implementation::tiledRenderingFunctor(EffectInstance::Implementa
     if (callingThread != curThread) {
         ///We are in the case of host frame threading, see kOfxImageEffectPluginPropHostFrameThreading
         ///We know that in the renderAction, TLS will be needed, so we do a deep copy of the TLS from the caller thread
-        ///to this thread
-        appPTR->getAppTLS()->copyTLS(callingThread, curThread);
-    }
-
-
-    EffectInstance::RenderingFunctorRetEnum ret = tiledRenderingFunctor(specificData,
-                                                                        args.renderFullScaleThenDownscale,
-                                                                        args.isSequentialRender,
-                                                                        args.isRenderResponseToUserInteraction,
-                                                                        args.firstFrame,
-                                                                        args.lastFrame,
-                                                                        args.preferredInput,
-                                                                        args.mipMapLevel,
-                                                                        args.renderMappedMipMapLevel,
-                                                                        args.rod,
-                                                                        args.time,
-                                                                        args.view,
-                                                                        args.par,
-                                                                        args.byPassCache,
-                                                                        args.outputClipPrefDepth,
-                                                                        args.outputClipPrefsComps,
-                                                                        args.compsNeeded,
-                                                                        args.processChannels,
-                                                                        args.planes);
-
-    //Exit of the host frame threading thread
-    appPTR->getAppTLS()->cleanupTLSForThread();
+        ///to this thread. The calling thread may be rendering another rectangle meanwhile, so copy from a snapshot
+        ///of its TLS taken before the rectangles were handed out.
+        assert(callerTLS);
+        callerTLS->copyTo(curThread);
+    }
+
+
+    EffectInstance::RenderingFunctorRetEnum ret;
+
+    // The abort info was copied along with the TLS: do not start a tile of a render that was aborted
+    if ( _publicInterface->aborted() ) {
+        ret = eRenderingFunctorRetAborted;
+    } else {
+        ret = tiledRenderingFunctor(specificData,
+                                    args.renderFullScaleThenDownscale,
+                                    args.isSequentialRender,
+                                    args.isRenderResponseToUserInteraction,
+                                    args.firstFrame,
+                                    args.lastFrame,
+                                    args.preferredInput,
+                                    args.mipMapLevel,
+                                    args.renderMappedMipMapLevel,
+                                    args.rod,
+                                    args.time,
+                                    args.view,
+                                    args.par,
+                                    args.byPassCache,
+                                    args.outputClipPrefDepth,
+                                    args.outputClipPrefsComps,
+                                    args.compsNeeded,
+                                    args.processChannels,
+                                    args.planes);
+    }
+
+    //Exit of the host frame threading thread. The calling thread may also run tiles while it waits
+    //for the others, its TLS must be kept since it is in the middle of renderRoI.
+    if (callingThread != curThread) {
+        appPTR->getAppTLS()->cleanupTLSForThread();
+    }
 
     return ret;
 }
 
+static bool
+rectToRenderScanLineLess(const EffectInstance::RectToRender& a,
+                         const EffectInstance::RectToRender& b)
+{
+    if (a.rect.y1 != b.rect.y1) {
+        return a.rect.y1 < b.rect.y1;
+    }
+
+    return a.rect.x1 < b.rect.x1;
+}
+
+EffectInstance::Implementation::TiledRenderingJob::TiledRenderingJob(EffectInstance::Implementation* imp,
+                                                                     const TiledRenderingFunctorArgs& args,
+                                                                     const std::list<RectToRender>& rectsToRender,
+                                                                     QThread* callingThread)
+    : TileSchedulerJob()
+    , _imp(imp)
+    , _args(args)
+    , _rects( rectsToRender.begin(), rectsToRender.end() )
+    , _callingThread(callingThread)
+    , _callerTLS(callingThread)
+    , _results(rectsToRender.size(), eRenderingFunctorRetOK)
+{
+    // The TileScheduler hands out contiguous ranges of tasks to each worker: neighbouring rectangles
+    // must be next to each other so that a worker reuses the input tiles it just fetched.
+    std::stable_sort(_rects.begin(), _rects.end(), rectToRenderScanLineLess);
+}
+
+int
+EffectInstance::Implementation::TiledRenderingJob::getTasksCount() const
+{
+    return (int)_rects.size();
+}
+
+bool
+EffectInstance::Implementation::TiledRenderingJob::runTask(int taskIndex)
+{
+    RenderingFunctorRetEnum ret = _imp->tiledRenderingFunctor(_args, _rects[taskIndex], _callingThread, &_callerTLS);
+
+    _results[taskIndex] = ret;
+
+    // Do not start the other rectangles if this one failed or was aborted
+    return ret == eRenderingFunctorRetOK;
+}
+
 EffectInstance::RenderingFunctorRetEnum
 EffectInstance::Implementation::tiledRenderingFunctor(const RectToRender & rectToRender,
                                                       const bool renderFullScaleThenDownscale,
@@ -2381,6 +2576,23 @@ EffectInstance::Implementation::tiledRenderingFunctor(const RectToRender & rectT
     }
 } // EffectInstance::tiledRenderingFunctor
 
+/**
+ * @brief Returns true if the plug-in can render directly in the cached image instead of a temporary image: the
+ * plug-in must render in the format of the image, the render window must cover the whole image and this render
+ * must have marked all the pixels of the image as being rendered by itself (ownsCachedImages), so that no other
+ * thread renders in the image concurrently.
+ **/
+static bool
+canRenderInCachedImage(const ImagePtr& image,
+                       const RectI& renderWindow,
+                       const ImagePlaneDesc& pluginComps,
+                       ImageBitDepthEnum pluginDepth,
+                       bool ownsCachedImages)
+{
+    return ownsCachedImages && ( pluginComps == image->getComponents() ) && ( pluginDepth == image->getBitDepth() ) &&
+           ( image->getBounds() == renderWindow );
+}
+
 EffectInstance::RenderingFunctorRetEnum
 EffectInstance::Implementation::renderHandler(const EffectTLSDataPtr& tls,
                                               const unsigned int mipMapLevel,
@@ -2592,11 +2804,13 @@ EffectInstance::Implementation::renderHandler(const EffectTLSDataPtr& tls,
         }  //  if (!identityInput) {
     } // if (identity) {
 
+    // The bytes that were not copied from a temporary image, reported once the render succeeded
+    U64 copyAvoidedBytes = 0;
     tls->currentRenderArgs.outputPlanes = planes.planes;
     for (std::map<ImagePlaneDesc, EffectInstance::PlaneToRender>::iterator it = tls->currentRenderArgs.outputPlanes.begin(); it != tls->currentRenderArgs.outputPlanes.end(); ++it) {
         /*
          * When using the cache, allocate a local temporary buffer onto which the plug-in will render, and then safely
-         * copy this buffer to the shared (among threads) image.
+         * copy this buffer to the shared (among threads) image, unless the plug-in can render directly in it (@see canRenderInCachedImage).
          * This is also needed if the plug-in does not support the number of components of the renderMappedImage
          */
         ImagePlaneDesc prefComp;
@@ -2607,8 +2821,19 @@ EffectInstance::Implementation::renderHandler(const EffectTLSDataPtr& tls,
         }
 
         // OpenGL render never use the cache and bitmaps, all images are local to a render.
-        if ( ( it->second.renderMappedImage->usesBitMap() || ( prefComp != it->second.renderMappedImage->getComponents() ) ||
-               ( outputClipPrefDepth != it->second.renderMappedImage->getBitDepth() ) ) && !_publicInterface->isPaintingOverItselfEnabled() && !planes.useOpenGL ) {
+        bool needsTmpImage;
+        if ( _publicInterface->isPaintingOverItselfEnabled() || planes.useOpenGL ) {
+            needsTmpImage = false;
+        } else if ( it->second.renderMappedImage->usesBitMap() ) {
+            needsTmpImage = !canRenderInCachedImage(it->second.renderMappedImage, actionArgs.roi, prefComp, outputClipPrefDepth, planes.ownsCachedImages);
+            if (!needsTmpImage) {
+                copyAvoidedBytes += (U64)actionArgs.roi.area() * it->second.renderMappedImage->getComponentsCount() * getSizeOfForBitDepth(outputClipPrefDepth);
+            }
+        } else {
+            needsTmpImage = ( prefComp != it->second.renderMappedImage->getComponents() ) ||
+                            ( outputClipPrefDepth != it->second.renderMappedImage->getBitDepth() );
+        }
+        if (needsTmpImage) {
             it->second.tmpImage = boost::make_shared<Image>(prefComp,
                                                             it->second.renderMappedImage->getRoD(),
                                                             actionArgs.roi,
@@ -2748,6 +2973,10 @@ EffectInstance::Implementation::renderHandler(const EffectTLSDataPtr& tls,
 
     assert(!renderAborted);
 
+    if ( copyAvoidedBytes && frameArgs->stats && frameArgs->stats->isInDepthProfilingEnabled() ) {
+        frameArgs->stats->addCopyAvoidedForNode(_publicInterface->getNode(), copyAvoidedBytes);
+    }
+
     bool unPremultIfNeeded = planes.outputPremult == eImagePremultiplicationPremultiplied;
     bool useMaskMix = _publicInterface->isHostMaskingEnabled() || _publicInterface->isHostMixingEnabled();
     double mix = useMaskMix ? _publicInterface->getNode()->getHostMixingValue(time, view) : 1.;
@@ -5201,6 +5430,116 @@ EffectInstance::getCurrentTime() const
     return app->getTimeLine()->currentFrame();
 }
 
+// Render threads only read the knobs of a few effects between two changes of their TLS, beyond that the cache is emptied
+#define NATRON_EFFECT_TLS_CACHE_MAX_ENTRIES 32
+
+/**
+ * @brief The TLS of the effects whose knobs were read by a thread. Knobs look up the values snapshot of the frame being
+ * rendered on each read: going through TLSHolder::getTLSData() every time takes the locks of AppTLS and of the holder.
+ * The entries are only valid as long as the TLS generation of the thread does not change, @see AppTLS::getCurrentThreadGeneration().
+ **/
+struct EffectTLSCacheEntry
+{
+    // Only compared, never dereferenced
+    const TLSHolder<EffectInstance::EffectTLSData>* holder;
+
+    // Weak so that the TLS of the thread is not kept alive after it is cleaned up
+    boost::weak_ptr<EffectInstance::EffectTLSData> data;
+    bool hasData;
+};
+
+struct EffectTLSCache
+{
+    unsigned int generation;
+    std::vector<EffectTLSCacheEntry> entries;
+
+    EffectTLSCache()
+        : generation(0)
+        , entries()
+    {
+    }
+
+    void refresh()
+    {
+        unsigned int current = AppTLS::getCurrentThreadGeneration();
+
+        if (current != generation) {
+            entries.clear();
+            generation = current;
+        }
+    }
+};
+
+// QThreadStorage takes ownership of the pointer and deletes it when the thread exits
+static QThreadStorage<EffectTLSCache*> g_effectTLSCache;
+
+static EffectInstance::EffectTLSDataPtr
+getTLSDataCached(const TLSHolder<EffectInstance::EffectTLSData>& holder)
+{
+    if ( !g_effectTLSCache.hasLocalData() ) {
+        g_effectTLSCache.setLocalData( new EffectTLSCache() );
+    }
+    EffectTLSCache* cache = g_effectTLSCache.localData();
+    cache->refresh();
+    for (std::vector<EffectTLSCacheEntry>::const_iterator it = cache->entries.begin(); it != cache->entries.end(); ++it) {
+        if (it->holder == &holder) {
+            if (!it->hasData) {
+                return EffectInstance::EffectTLSDataPtr();
+            }
+            EffectInstance::EffectTLSDataPtr ret = it->data.lock();
+            if (ret) {
+                return ret;
+            }
+            break;
+        }
+    }
+
+    EffectInstance::EffectTLSDataPtr ret = holder.getTLSData();
+
+    // getTLSData() may have copied the TLS from the thread that spawned this one
+    cache->refresh();
+    for (std::vector<EffectTLSCacheEntry>::iterator it = cache->entries.begin(); it != cache->entries.end(); ++it) {
+        if (it->holder == &holder) {
+            cache->entries.erase(it);
+            break;
+        }
+    }
+    if (cache->entries.size() >= NATRON_EFFECT_TLS_CACHE_MAX_ENTRIES) {
+        cache->entries.clear();
+    }
+    EffectTLSCacheEntry entry;
+    entry.holder = &holder;
+    entry.data = ret;
+    entry.hasData = bool(ret);
+    cache->entries.push_back(entry);
+
+    return ret;
+}
+
+const KnobValuesSnapshot*
+EffectInstance::getKnobValuesSnapshotTLS(double* currentTime) const
+{
+    // Called on every knob read: do not lock
+    EffectTLSDataPtr tls = getTLSDataCached(*_imp->tlsData);
+
+    if ( !tls || tls->frameArgs.empty() ) {
+        return 0;
+    }
+
+    // The snapshot is held by the frame args of this thread until the end of the render,
+    // do not copy the shared pointer: its reference count would be shared by all render threads.
+    const ParallelRenderArgs& args = *tls->frameArgs.back();
+    if (!args.knobValues) {
+        return 0;
+    }
+    if (currentTime) {
+        // Same as getCurrentTime()
+        *currentTime = tls->currentRenderArgs.validArgs ? tls->currentRenderArgs.time : args.time;
+    }
+
+    return args.knobValues.get();
+}
+
 ViewIdx
 EffectInstance::getCurrentView() const
 {
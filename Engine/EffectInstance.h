@@ -68,6 +68,7 @@
 #define PLUGINID_OFX_COLORLOOKUP  "net.sf.openfx.ColorLookupPlugin"
 #define PLUGINID_OFX_BLURCIMG     "net.sf.cimg.CImgBlur"
 #define PLUGINID_OFX_CORNERPIN    "net.sf.openfx.CornerPinPlugin"
+#define PLUGINID_OFX_CROP         "net.sf.openfx.CropPlugin"
 #define PLUGINID_OFX_CONSTANT     "net.sf.openfx.ConstantPlugin"
 #define PLUGINID_OFX_TIMEOFFSET   "net.sf.openfx.timeOffset"
 #define PLUGINID_OFX_FRAMEHOLD    "net.sf.openfx.FrameHold"
@@ -609,6 +610,13 @@ public:
      **/
     ImagePtr convertRAMImageToOpenGLTexture(const ImagePtr& image);
 
+    /**
+     * @brief Halves the given roi of the full scale image level by level and stores each level in the cache
+     * under the key of the image, so that renders at a lower scale (e.g: when zooming out the viewer)
+     * find their image in the cache instead of rendering or downscaling it again.
+     **/
+    void cacheMipMapPyramid(const ImagePtr& fullScaleImage, const RectI& roi);
+
 
     /**
      * @brief This function is to be called by getImage() when the plug-ins renders more planes than the ones suggested
@@ -860,6 +868,7 @@ public:
     virtual void abortAnyEvaluation(bool keepOldestRender = true) OVERRIDE FINAL;
     virtual double getCurrentTime() const OVERRIDE WARN_UNUSED_RETURN;
     virtual ViewIdx getCurrentView() const OVERRIDE WARN_UNUSED_RETURN;
+    virtual const KnobValuesSnapshot* getKnobValuesSnapshotTLS(double* currentTime) const OVERRIDE FINAL WARN_UNUSED_RETURN;
     virtual bool getCanTransform() const
     {
         return false;
@@ -1432,6 +1441,10 @@ public:
         bool useOpenGL;
         EffectInstance::OpenGLContextEffectDataPtr glContextData;
 
+        // True if this render marked all the pixels of the cached images as being rendered by itself:
+        // no other thread renders in them, so the plug-in may render directly in them.
+        bool ownsCachedImages;
+
         ImagePlanesToRender()
             : rectsToRender()
             , planes()
@@ -1439,6 +1452,7 @@ public:
             , outputPremult(eImagePremultiplicationPremultiplied)
             , useOpenGL(false)
             , glContextData()
+            , ownsCachedImages(false)
         {
         }
     };
@@ -430,6 +430,9 @@ EffectInstance::Implementation::Implementation(EffectInstance* publicInterface)
     , renderClonesMutex()
     , renderClonesPool()
     , mustSyncPrivateData(false)
+    , knobValuesSnapshotMutex()
+    , knobValuesSnapshot()
+    , knobValuesSnapshotHash(0)
 {
     tlsData = boost::make_shared<TLSHolder<EffectTLSData> >();
     actionsCache = boost::make_shared<ActionsCache>(appPTR->getHardwareIdealThreadCount() * 2);
@@ -459,6 +462,9 @@ EffectInstance::Implementation::Implementation(const Implementation& other)
 , isDoingInstanceSafeRender(false)
 , renderClonesMutex()
 , renderClonesPool()
+, knobValuesSnapshotMutex()
+, knobValuesSnapshot()
+, knobValuesSnapshotHash(0)
 {
 
 }
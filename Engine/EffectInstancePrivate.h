@@ -33,6 +33,7 @@
 #include <map>
 #include <list>
 #include <string>
+#include <vector>
 
 #include <QtCore/QCoreApplication>
 #include <QtCore/QWaitCondition>
@@ -42,6 +43,7 @@
 
 #include "Engine/Image.h"
 #include "Engine/TLSHolder.h"
+#include "Engine/TileScheduler.h"
 #include "Engine/NodeMetadata.h"
 #include "Engine/OSGLContext.h"
 #include "Engine/ViewIdx.h"
@@ -239,6 +241,12 @@ public:
     bool mustSyncPrivateData; //!< true if the effect's knobs were changed but instanceChanged could not be called (e.g. when loading a PyPlug), so that syncPrivateData should be called in getPreferredMetadata_public before calling getPreferredMetadata
     mutable QMutex mustSyncPrivateDataMutex; //!< protects mustSyncPrivateData
 
+    // The knob values captured for the last frame, shared by the next renders of the same node hash and time
+    // instead of capturing all knobs again
+    QMutex knobValuesSnapshotMutex; //!< protects knobValuesSnapshot and knobValuesSnapshotHash
+    KnobValuesSnapshotConstPtr knobValuesSnapshot;
+    U64 knobValuesSnapshotHash;
+
 public:
     void runChangedParamCallback(KnobI* k, bool userEdited, const std::string & callback);
 
@@ -337,8 +345,48 @@ public:
         ImagePlanesToRenderPtr planes;
     };
 
+    /**
+     * @brief Renders a rectangle in eRenderSafetyFullySafeFrame mode. When called from another thread than callingThread,
+     * the TLS of that thread is first copied from callerTLS, which must be a snapshot of the TLS of callingThread.
+     **/
     RenderingFunctorRetEnum tiledRenderingFunctor(TiledRenderingFunctorArgs & args,  const RectToRender & specificData,
-                                                  QThread* callingThread);
+                                                  QThread* callingThread, const TLSSnapshot* callerTLS);
+
+    /**
+     * @brief The rectangles of a renderRoI call in eRenderSafetyFullySafeFrame mode, executed by the TileScheduler.
+     * The rectangles are sorted in scan-line order so that consecutive tasks share most of their input tiles.
+     * The job must be created by the calling thread: it takes a snapshot of its TLS that the workers copy, since the
+     * calling thread modifies its own TLS while it renders its share of the rectangles.
+     **/
+    class TiledRenderingJob
+        : public TileSchedulerJob
+    {
+public:
+
+        TiledRenderingJob(Implementation* imp,
+                          const TiledRenderingFunctorArgs& args,
+                          const std::list<RectToRender>& rectsToRender,
+                          QThread* callingThread);
+
+        virtual ~TiledRenderingJob() {}
+
+        virtual int getTasksCount() const OVERRIDE FINAL;
+        virtual bool runTask(int taskIndex) OVERRIDE FINAL;
+
+        const std::vector<RenderingFunctorRetEnum>& getResults() const
+        {
+            return _results;
+        }
+
+private:
+
+        Implementation* _imp;
+        TiledRenderingFunctorArgs _args;
+        std::vector<RectToRender> _rects;
+        QThread* _callingThread;
+        TLSSnapshot _callerTLS;
+        std::vector<RenderingFunctorRetEnum> _results;
+    };
 
     RenderingFunctorRetEnum tiledRenderingFunctor(const RectToRender & rectToRender,
                                                   const bool renderFullScaleThenDownscale,
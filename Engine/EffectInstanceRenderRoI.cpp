@@ -39,7 +39,6 @@
 #include <QtCore/QThreadPool>
 #include <QtCore/QReadWriteLock>
 #include <QtCore/QCoreApplication>
-#include <QtConcurrentMap> // QtCore on Qt4, QtConcurrent on Qt5
 #include <QtConcurrentRun> // QtCore on Qt4, QtConcurrent on Qt5
 
 #if !defined(SBK_RUN) && !defined(Q_MOC_RUN)
@@ -77,6 +76,7 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 #include "Engine/Timer.h"
 #include "Engine/Transform.h"
 #include "Engine/ThreadPool.h"
+#include "Engine/TileScheduler.h"
 #include "Engine/ViewIdx.h"
 #include "Engine/ViewerInstance.h"
 
@@ -243,6 +243,7 @@ class ImageBitMapMarker_RAII
     bool _isBeingRenderedElseWhere;
     bool _isValid;
     bool _renderFullScale;
+    bool _ownsWholeImages;
 
 public:
 
@@ -257,6 +258,7 @@ public:
     , _isBeingRenderedElseWhere(false)
     , _isValid(true)
     , _renderFullScale(renderFullScale)
+    , _ownsWholeImages( !image.empty() )
     {
         for (std::map<ImagePlaneDesc,EffectInstance::PlaneToRender>::const_iterator it = _image.begin(); it != _image.end(); ++it) {
             ImagePtr cacheImage;
@@ -266,7 +268,18 @@ public:
                 cacheImage = it->second.fullscaleImage;
             }
             if (cacheImage && cacheImage->usesBitMap()) {
-                _effect->_imp->markImageAsBeingRendered(cacheImage, roi, &_rectsToRender, &_isBeingRenderedElseWhere);
+                std::list<RectI> rects;
+                bool isBeingRenderedElseWhere = false;
+                _effect->_imp->markImageAsBeingRendered(cacheImage, roi, &rects, &isBeingRenderedElseWhere);
+
+                // If a single rectangle covering the image is left to render, none of its pixels was marked before
+                if ( isBeingRenderedElseWhere || (rects.size() != 1) || !rects.front().contains( cacheImage->getBounds() ) ) {
+                    _ownsWholeImages = false;
+                }
+                _isBeingRenderedElseWhere |= isBeingRenderedElseWhere;
+                _rectsToRender.insert( _rectsToRender.end(), rects.begin(), rects.end() );
+            } else {
+                _ownsWholeImages = false;
             }
         }
 
@@ -277,6 +290,15 @@ public:
         return _rectsToRender;
     }
 
+    /**
+     * @brief Returns true if all the pixels of the images were marked as being rendered by this object:
+     * no other thread may render in the images until it is destroyed.
+     **/
+    bool ownsWholeImages() const
+    {
+        return _ownsWholeImages && !_isBeingRenderedElseWhere;
+    }
+
     void invalidate()
     {
         _isValid = false;
@@ -1267,9 +1289,11 @@ EffectInstance::renderRoI(const RenderRoIArgs & args,
         // If the plug-in is eRenderSafetyFullySafeFrame that means it wants the host to perform SMP aka slice up the RoI into chunks
         // but if the effect doesn't support tiles it won't work.
         // Also check that the number of threads indicating by the settings are appropriate for this render mode.
+        // If the TileScheduler workers already have more tiles queued than they can start, the calling thread would
+        // render most of its tiles alone anyway: do not pay for the TLS copies.
         if ( !frameArgs->tilesSupported || (nbThreads == -1) || (nbThreads == 1) ||
             ( (nbThreads == 0) && (appPTR->getHardwareIdealThreadCount() == 1) ) ||
-            ( QThreadPool::globalInstance()->activeThreadCount() >= QThreadPool::globalInstance()->maxThreadCount() )) {
+            appPTR->getTileScheduler()->isSaturated() ) {
             safety = eRenderSafetyFullySafe;
         }
     }
@@ -1513,6 +1537,7 @@ EffectInstance::renderRoI(const RenderRoIArgs & args,
             // scoped_ptr
             guard.reset(new ImageBitMapMarker_RAII(planesToRender->planes, renderFullScaleThenDownscale, roi, this));
         }
+        planesToRender->ownsCachedImages = guard->ownsWholeImages();
 #endif // NATRON_ENABLE_TRIMAP
     } // hasSomethingToRender
       ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1740,6 +1765,7 @@ EffectInstance::renderRoI(const RenderRoIArgs & args,
     //bool callerIsMultiplanar = args.caller ? args.caller->isMultiPlanar() : false;
 
     //bool multiplanar = isMultiPlanar();
+    const bool keepMipMapPyramid = createInCache && (storage == eStorageModeRAM) && !isDuringPaintStroke && appPTR->isMipMapPyramidCacheEnabled();
     for (std::map<ImagePlaneDesc, EffectInstance::PlaneToRender>::iterator it = planesToRender->planes.begin(); it != planesToRender->planes.end(); ++it) {
         //If we have worked on a local swapped image, swap it in the cache
         if (it->second.cacheSwapImage) {
@@ -1752,6 +1778,13 @@ EffectInstance::renderRoI(const RenderRoIArgs & args,
             }
         }
 
+        // Keep the lower scales of what was just rendered at full scale in the cache: zooming out the viewer
+        // then finds them instead of rendering again
+        if ( keepMipMapPyramid && (renderRetCode == eRenderRoIStatusImageRendered) &&
+             (it->second.fullscaleImage->getMipMapLevel() == 0) ) {
+            cacheMipMapPyramid(it->second.fullscaleImage, roi);
+        }
+
         //We have to return the downscale image, so make sure it has been computed
         if ( (renderRetCode != eRenderRoIStatusRenderFailed) &&
              renderFullScaleThenDownscale &&
@@ -1965,6 +1998,7 @@ EffectInstance::renderRoIInternal(EffectInstance* self,
             QThread* currentThread = QThread::currentThread();
             boost::scoped_ptr<Implementation::TiledRenderingFunctorArgs> tiledArgs(new Implementation::TiledRenderingFunctorArgs);
             tiledArgs->renderFullScaleThenDownscale = renderFullScaleThenDownscale;
+            tiledArgs->isSequentialRender = isSequentialRender;
             tiledArgs->isRenderResponseToUserInteraction = isRenderMadeInResponseToUserInteraction;
             tiledArgs->firstFrame = firstFrame;
             tiledArgs->lastFrame = lastFrame;
@@ -1989,21 +2023,18 @@ EffectInstance::renderRoIInternal(EffectInstance* self,
             for (std::list<RectToRender>::const_iterator it = planesToRender->rectsToRender.begin(); it != planesToRender->rectsToRender.end(); ++it, ++i) {
                 ret[i] = self->_imp->tiledRenderingFunctor(tiledArgs,
                                                *it,
-                                               currentThread);
+                                               currentThread,
+                                               0);
             }
             std::vector<EffectInstance::RenderingFunctorRetEnum>::const_iterator it2;
 
 #else
 
 
-            QFuture<RenderingFunctorRetEnum> ret = QtConcurrent::mapped( planesToRender->rectsToRender,
-                                                                         boost::bind(&EffectInstance::Implementation::tiledRenderingFunctor,
-                                                                                     self->_imp.get(),
-                                                                                     *tiledArgs,
-                                                                                     _1,
-                                                                                     currentThread) );
-            ret.waitForFinished();
-            QFuture<EffectInstance::RenderingFunctorRetEnum>::const_iterator it2;
+            Implementation::TiledRenderingJob job(self->_imp.get(), *tiledArgs, planesToRender->rectsToRender, currentThread);
+            appPTR->getTileScheduler()->runJob(&job);
+            const std::vector<EffectInstance::RenderingFunctorRetEnum>& ret = job.getResults();
+            std::vector<EffectInstance::RenderingFunctorRetEnum>::const_iterator it2;
 
 #endif
             for (it2 = ret.begin(); it2 != ret.end(); ++it2) {
@@ -77,6 +77,7 @@ SOURCES += \
     BlockingBackgroundRender.cpp \
     CLArgs.cpp \
     Cache.cpp \
+    CacheIndex.cpp \
     CoonsRegularization.cpp \
     CreateNodeArgs.cpp \
     Curve.cpp \
@@ -110,6 +111,7 @@ SOURCES += \
     ImageMaskMix.cpp \
     ImageParamsSerialization.cpp \
     ImagePlaneDesc.cpp \
+    ImageStatistics.cpp \
     Interpolation.cpp \
     JoinViewsNode.cpp \
     Knob.cpp \
@@ -117,12 +119,14 @@ SOURCES += \
     KnobFile.cpp \
     KnobSerialization.cpp \
     KnobTypes.cpp \
+    KnobValuesSnapshot.cpp \
     LibraryBinary.cpp \
     Log.cpp \
     Lut.cpp \
     Markdown.cpp \
     MemoryFile.cpp \
     MemoryInfo.cpp \
+    NativeExpression.cpp \
     NoOpBase.cpp \
     Node.cpp \
     NodeDocumentation.cpp \
@@ -148,15 +152,21 @@ SOURCES += \
     OfxMemory.cpp \
     OfxOverlayInteract.cpp \
     OfxParamInstance.cpp \
+    OfxThreadPool.cpp \
     OneViewNode.cpp \
     OutputEffectInstance.cpp \
     OutputSchedulerThread.cpp \
     ParallelRenderArgs.cpp \
+    PixelBufferRing.cpp \
+    PixelConvert.cpp \
+    PlaybackPrefetcher.cpp \
     Plugin.cpp \
     PluginMemory.cpp \
     PrecompNode.cpp \
     ProcessHandler.cpp \
     Project.cpp \
+    ProjectAutoSaveJournal.cpp \
+    ProjectBinarySerialization.cpp \
     ProjectPrivate.cpp \
     ProjectSerialization.cpp \
     PyAppInstance.cpp \
@@ -167,6 +177,7 @@ SOURCES += \
     PyRoto.cpp \
     PySideCompat.cpp \
     PyTracker.cpp \
+    RamBufferPool.cpp \
     ReadNode.cpp \
     RectD.cpp \
     RectI.cpp \
@@ -177,6 +188,7 @@ SOURCES += \
     RotoLayer.cpp \
     RotoPaint.cpp \
     RotoPaintInteract.cpp \
+    RotoShapeRasterizer.cpp \
     RotoSmear.cpp \
     RotoStrokeItem.cpp \
     RotoUndoCommand.cpp \
@@ -189,6 +201,7 @@ SOURCES += \
     Texture.cpp \
     TextureRect.cpp \
     ThreadPool.cpp \
+    TileScheduler.cpp \
     TimeLine.cpp \
     Timer.cpp \
     TrackMarker.cpp \
@@ -275,6 +288,7 @@ HEADERS += \
     Cache.h \
     CacheEntry.h \
     CacheEntryHolder.h \
+    CacheIndex.h \
     CacheSerialization.h \
     ChoiceOption.h \
     CoonsRegularization.h \
@@ -316,6 +330,7 @@ HEADERS += \
     ImageParams.h \
     ImageParamsSerialization.h \
     ImagePlaneDesc.h \
+    ImageStatistics.h \
     ImageSerialization.h \
     Interpolation.h \
     JoinViewsNode.h \
@@ -327,6 +342,7 @@ HEADERS += \
     KnobImpl.h \
     KnobSerialization.h \
     KnobTypes.h \
+    KnobValuesSnapshot.h \
     LRUHashTable.h \
     LibraryBinary.h \
     Log.h \
@@ -336,6 +352,7 @@ HEADERS += \
     MemoryFile.h \
     MemoryInfo.h \
     MergingEnum.h \
+    NativeExpression.h \
     NoOpBase.h \
     Node.h \
     NodeGraphI.h \
@@ -360,18 +377,24 @@ HEADERS += \
     OfxMemory.h \
     OfxOverlayInteract.h \
     OfxParamInstance.h \
+    OfxThreadPool.h \
     OneViewNode.h \
     OpenGLViewerI.h \
     OutputEffectInstance.h \
     OutputSchedulerThread.h \
     OverlaySupport.h \
     ParallelRenderArgs.h \
+    PixelBufferRing.h \
+    PixelConvert.h \
+    PlaybackPrefetcher.h \
     Plugin.h \
     PluginActionShortcut.h \
     PluginMemory.h \
     PrecompNode.h \
     ProcessHandler.h \
     Project.h \
+    ProjectAutoSaveJournal.h \
+    ProjectBinarySerialization.h \
     ProjectPrivate.h \
     ProjectSerialization.h \
     PyAppInstance.h \
@@ -382,6 +405,7 @@ HEADERS += \
     PyParameter.h \
     PyRoto.h \
     PyTracker.h \
+    RamBufferPool.h \
     Pyside_Engine_Python.h \
     ReadNode.h \
     RectD.h \
@@ -401,6 +425,7 @@ HEADERS += \
     RotoPaint.h \
     RotoPaintInteract.h \
     RotoPoint.h \
+    RotoShapeRasterizer.h \
     RotoSmear.h \
     RotoStrokeItem.h \
     RotoStrokeItemSerialization.h \
@@ -418,6 +443,7 @@ HEADERS += \
     TextureRectSerialization.h \
     ThreadPool.h \
     ThreadStorage.h \
+    TileScheduler.h \
     TimeLine.h \
     TimeLineKeyFrames.h \
     Timer.h \
@@ -165,6 +165,7 @@ class Image;
 class ImageKey;
 class ImageParams;
 class ImagePlaneDesc;
+class ImageStatistics;
 class KeyFrame;
 class KnobBool;
 class KnobButton;
@@ -191,9 +192,13 @@ class KnobSignalSlotHandler;
 class KnobString;
 class KnobTLSData;
 class KnobTable;
+class KnobValuesSnapshot;
 class LibraryBinary;
 class LogEntry;
 class MemoryFile;
+class NativeExpression;
+class NativeExpressionContext;
+class NativeExpressionParam;
 class Node;
 class NodeCollection;
 class NodeFrameRequest;
@@ -222,6 +227,7 @@ class OutputSchedulerThreadStartArgs;
 class OverlaySupport;
 class ParallelRenderArgs;
 class ParallelRenderArgsSetter;
+class PixelBufferRing;
 class Plugin;
 class PluginGroupNode;
 class PluginMemory;
@@ -230,6 +236,7 @@ class ProcessHandler;
 class ProcessInputChannel;
 class Project;
 class ProjectBeingLoadedInfo;
+class ProjectBinaryReader;
 class ProjectSerialization;
 class RectD;
 class RectI;
@@ -245,14 +252,17 @@ class RotoLayerSerialization;
 class RotoPaint;
 class RotoPaintInteract;
 class RotoPoint;
+class RotoShapeRasterizer;
 class RotoStrokeItem;
 class RotoStrokeItemSerialization;
 class Settings;
 class StringAnimationManager;
 class TLSHolderBase;
+class TLSSnapshot;
 class Texture;
 class TextureRect;
 class TileCacheFile;
+class TileScheduler;
 class TimeLapse;
 class TimeLine;
 class TrackArgs;
@@ -352,6 +362,7 @@ typedef boost::shared_ptr<Image> ImagePtr;
 typedef boost::shared_ptr<Image const> ImageConstPtr;
 typedef boost::shared_ptr<ImageParams> ImageParamsPtr;
 typedef boost::shared_ptr<ImagePlaneDesc> ImagePlaneDescPtr;
+typedef boost::shared_ptr<ImageStatistics const> ImageStatisticsConstPtr;
 typedef boost::shared_ptr<KnobBool> KnobBoolPtr;
 typedef boost::shared_ptr<KnobButton> KnobButtonPtr;
 typedef boost::shared_ptr<KnobChoice> KnobChoicePtr;
@@ -378,7 +389,10 @@ typedef boost::shared_ptr<KnobSignalSlotHandler> KnobSignalSlotHandlerPtr;
 typedef boost::shared_ptr<KnobString> KnobStringPtr;
 typedef boost::shared_ptr<KnobTLSData> KnobTLSDataPtr;
 typedef boost::shared_ptr<KnobTable> KnobTablePtr;
+typedef boost::shared_ptr<KnobValuesSnapshot const> KnobValuesSnapshotConstPtr;
 typedef boost::shared_ptr<MemoryFile> MemoryFilePtr;
+typedef boost::shared_ptr<NativeExpression> NativeExpressionPtr;
+typedef boost::shared_ptr<NativeExpressionParam> NativeExpressionParamPtr;
 typedef boost::shared_ptr<Node> NodePtr;
 typedef boost::shared_ptr<NodeCollection> NodeCollectionPtr;
 typedef boost::shared_ptr<NodeFrameRequest> NodeFrameRequestPtr;
@@ -394,11 +408,13 @@ typedef boost::shared_ptr<OutputEffectInstance> OutputEffectInstancePtr;
 typedef boost::shared_ptr<OutputSchedulerThreadStartArgs> OutputSchedulerThreadStartArgsPtr;
 typedef boost::shared_ptr<ParallelRenderArgs> ParallelRenderArgsPtr;
 typedef boost::shared_ptr<ParallelRenderArgsSetter> ParallelRenderArgsSetterPtr;
+typedef boost::shared_ptr<PixelBufferRing> PixelBufferRingPtr;
 typedef boost::shared_ptr<PluginGroupNode> PluginGroupNodePtr;
 typedef boost::shared_ptr<PluginMemory> PluginMemoryPtr;
 typedef boost::shared_ptr<PrecompNode> PrecompNodePtr;
 typedef boost::shared_ptr<ProcessHandler> ProcessHandlerPtr;
 typedef boost::shared_ptr<Project> ProjectPtr;
+typedef boost::shared_ptr<ProjectBinaryReader> ProjectBinaryReaderPtr;
 typedef boost::shared_ptr<RenderEngine> RenderEnginePtr;
 typedef boost::shared_ptr<RenderStats> RenderStatsPtr;
 typedef boost::shared_ptr<RenderingFlagSetter> RenderingFlagSetterPtr;
@@ -28,11 +28,63 @@
 #include <cassert>
 #include <cstring> // for std::memcpy, std::memset
 #include <stdexcept>
+#include <vector>
+
+#include <QtCore/QByteArray>
 
 #include "Engine/RectI.h"
 
+// The zlib compression level used for the viewer cache: the byte-plane shuffle and delta do most of the work,
+// higher levels cost much more CPU for a few percents
+#define NATRON_FRAME_ENTRY_COMPRESSION_LEVEL 1
+
 NATRON_NAMESPACE_ENTER
 
+/*
+   The pixels are compressed with a byte-plane shuffle followed by a delta of each plane: the n-th byte of every pixel
+   is stored contiguously, as the difference with the n-th byte of the previous pixel. The slowly varying bytes of
+   neighbouring pixels (the high bytes of floats, the channels of 8-bit pixels) become long runs of small values that
+   deflate compresses well, and the whole transform is lossless.
+ */
+static void
+shuffleAndDelta(const U8* src,
+                std::size_t nPixels,
+                std::size_t pixelSize,
+                U8* dst)
+{
+    for (std::size_t b = 0; b < pixelSize; ++b) {
+        const U8* srcPix = src + b;
+        U8 prev = 0;
+        for (std::size_t i = 0; i < nPixels; ++i, srcPix += pixelSize, ++dst) {
+            *dst = (U8)(*srcPix - prev);
+            prev = *srcPix;
+        }
+    }
+}
+
+static void
+unshuffleAndIntegrate(const U8* src,
+                      std::size_t nPixels,
+                      std::size_t pixelSize,
+                      U8* dst)
+{
+    for (std::size_t b = 0; b < pixelSize; ++b) {
+        U8* dstPix = dst + b;
+        U8 prev = 0;
+        for (std::size_t i = 0; i < nPixels; ++i, dstPix += pixelSize, ++src) {
+            prev = (U8)(prev + *src);
+            *dstPix = prev;
+        }
+    }
+}
+
+static std::size_t
+getFramePixelSize(int bitDepth)
+{
+    // Viewer textures are always RGBA
+    return (ImageBitDepthEnum)bitDepth == eImageBitDepthFloat ? 4 * sizeof(float) : 4;
+}
+
 
 const U8*
 FrameEntry::pixelAt(int x,
@@ -112,4 +164,79 @@ FrameEntry::copy(const FrameEntry& other)
     }
 } // FrameEntry::copy
 
+std::size_t
+FrameEntry::compress()
+{
+    QWriteLocker k(&_entryLock);
+
+    if ( (_cache && _cache->isTileCache()) || !_data.isAllocated() ) {
+        return 0;
+    }
+    const std::size_t rawSize = getSizeInBytesFromParams();
+    if ( (_data.size() != rawSize) || (rawSize == 0) ) {
+        // Already compressed
+        return 0;
+    }
+    const std::size_t pixelSize = getFramePixelSize( _key.getBitDepth() );
+    assert(rawSize % pixelSize == 0);
+
+    std::vector<U8> shuffled(rawSize);
+    shuffleAndDelta(_data.readable(), rawSize / pixelSize, pixelSize, &shuffled.front());
+
+    QByteArray compressed = qCompress(&shuffled.front(), (int)rawSize, NATRON_FRAME_ENTRY_COMPRESSION_LEVEL);
+    const std::size_t compressedSize = (std::size_t)compressed.size();
+    if ( compressed.isEmpty() || (compressedSize >= rawSize) ) {
+        return 0;
+    }
+
+    try {
+        resizeBuffer(compressedSize);
+    } catch (const std::exception& e) {
+        qDebug() << "Failed to resize a viewer cache entry:" << e.what();
+
+        return 0;
+    }
+    std::memcpy( _data.writable(), compressed.constData(), compressedSize );
+
+    return compressedSize;
+}
+
+bool
+FrameEntry::isCompressed() const
+{
+    QReadLocker k(&_entryLock);
+
+    if ( (_cache && _cache->isTileCache()) || !_data.isAllocated() ) {
+        return false;
+    }
+    std::size_t size = _data.size();
+
+    return size > 0 && size < getSizeInBytesFromParams();
+}
+
+bool
+FrameEntry::decompress(U8* dst,
+                       std::size_t dstSize) const
+{
+    QReadLocker k(&_entryLock);
+
+    const std::size_t rawSize = getSizeInBytesFromParams();
+    if ( !_data.isAllocated() || (dstSize < rawSize) ) {
+        return false;
+    }
+    const std::size_t size = _data.size();
+    if ( (size == 0) || (size >= rawSize) ) {
+        return false;
+    }
+
+    QByteArray shuffled = qUncompress(_data.readable(), (int)size);
+    if ( (std::size_t)shuffled.size() != rawSize ) {
+        return false;
+    }
+    const std::size_t pixelSize = getFramePixelSize( _key.getBitDepth() );
+    unshuffleAndIntegrate( (const U8*)shuffled.constData(), rawSize / pixelSize, pixelSize, dst );
+
+    return true;
+}
+
 NATRON_NAMESPACE_EXIT
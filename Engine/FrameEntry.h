@@ -78,6 +78,26 @@ public:
 
     void copy(const FrameEntry& other);
 
+    /**
+     * @brief Replaces the pixels of the entry by a lossless compressed version of them, so that the entry
+     * takes less room in the cache. Once compressed, data() no longer returns pixels: use decompress() to read them.
+     * Returns the compressed size in bytes, or 0 if the entry was left untouched (it was not allocated, it is already
+     * compressed or the pixels did not compress).
+     **/
+    std::size_t compress();
+
+    /**
+     * @brief Returns true if the entry holds compressed pixels. Since the compressed data is always smaller than
+     * the pixels, this also works for entries restored from the disk cache of a previous session.
+     **/
+    bool isCompressed() const;
+
+    /**
+     * @brief Decompresses the pixels of a compressed entry into dst, which must hold at least getSizeInBytesFromParams()
+     * bytes. Returns false if the entry is not compressed or the data is corrupted.
+     **/
+    bool decompress(U8* dst, std::size_t dstSize) const;
+
 
     ImagePtr getInternalImage() const
     {
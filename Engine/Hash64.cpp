@@ -25,13 +25,6 @@
 
 #include "Hash64.h"
 
-#include <algorithm>  // for std::for_each
-#include <cassert>
-#include <stdexcept>
-
-#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
-#include <boost/crc.hpp>
-#endif
 #include <QtCore/QString>
 
 #include "Engine/Node.h"
@@ -41,29 +34,66 @@ NATRON_NAMESPACE_ENTER
 void
 Hash64::computeHash()
 {
-    if ( node_values.empty() ) {
+    if (count == 0) {
         return;
     }
 
-    const unsigned char* data = reinterpret_cast<const unsigned char*>( &node_values.front() );
-    boost::crc_optimal<64, 0x42F0E1EBA9EA3693ULL, 0, 0, false, false> crc_64;
-    crc_64 = std::for_each( data, data + node_values.size() * sizeof(node_values[0]), crc_64 );
-    hash = crc_64();
+    U64 h;
+    if (count >= 4) {
+        h = rotl(lanes[0], 1) + rotl(lanes[1], 7) + rotl(lanes[2], 12) + rotl(lanes[3], 18);
+        for (int i = 0; i < 4; ++i) {
+            h ^= round(0, lanes[i]);
+            h = h * kPrime1 + kPrime4;
+        }
+    } else {
+        h = kPrime5;
+    }
+    h += count * sizeof(U64);
+
+    // Words that were not folded into the lanes yet
+    int remaining = (int)(count & 3);
+    for (int i = 0; i < remaining; ++i) {
+        h ^= round(0, pending[i]);
+        h = rotl(h, 27) * kPrime1 + kPrime4;
+    }
+
+    // Final avalanche
+    h ^= h >> 33;
+    h *= kPrime2;
+    h ^= h >> 29;
+    h *= kPrime3;
+    h ^= h >> 32;
+
+    hash = h;
 }
 
 void
 Hash64::reset()
 {
-    node_values.clear();
     hash = 0;
+    count = 0;
+    // Initial lanes of xxHash64 with a seed of 0
+    lanes[0] = kPrime1 + kPrime2;
+    lanes[1] = kPrime2;
+    lanes[2] = 0;
+    lanes[3] = 0 - kPrime1;
 }
 
 void
 Hash64_appendQString(Hash64* hash,
                      const QString & str)
 {
-    Q_FOREACH (QChar ch, str) {
-        hash->append<unsigned short>( ch.unicode() );
+    // Pack 4 UTF-16 code units per appended word, the length disambiguates the zero padding
+    const ushort* data = str.utf16();
+    int size = str.size();
+
+    hash->append<int>(size);
+    for (int i = 0; i < size; i += 4) {
+        U64 word = 0;
+        for (int j = 0; j < 4 && i + j < size; ++j) {
+            word |= (U64)data[i + j] << (16 * j);
+        }
+        hash->append(word);
     }
 }
 
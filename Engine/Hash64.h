@@ -28,7 +28,6 @@
 
 #include "Global/Macros.h"
 
-#include <vector>
 #if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
 #include <boost/static_assert.hpp>
 #endif
@@ -39,22 +38,30 @@
 
 NATRON_NAMESPACE_ENTER
 
-/*The hash of a Node is the checksum of the vector of data containing:
+/*The hash of a Node is the checksum of the stream of data containing:
     - the values of the current knob for this node + the name of the node
     - the hash values for the  tree upstream
  */
 
+/**
+ * @brief A streaming 64-bit hash over a sequence of 64-bit words.
+ * The mixing follows xxHash64: each appended value is folded into one of 4 accumulator
+ * lanes as soon as 4 words are available, so that append() costs a couple of multiplies
+ * and nothing is stored. computeHash() finalizes a copy of the state, hence more values may
+ * still be appended afterwards to extend the stream, and a partially filled Hash64 may be
+ * copied to cache the contribution of a common prefix.
+ * On a little-endian host the result is identical to XXH64 (seed 0) over the appended words.
+ **/
 class Hash64
 {
 public:
     Hash64()
     {
-        hash = 0;
+        reset();
     }
 
     ~Hash64()
     {
-        node_values.clear();
     }
 
     U64 value() const
@@ -87,7 +94,15 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
     template<typename T>
     void append(T value)
     {
-        node_values.push_back( toU64(value) );
+        appendWord( toU64(value) );
+    }
+
+    /**
+     * @brief Returns the number of values appended since the last reset()
+     **/
+    U64 size() const
+    {
+        return count;
     }
 
     bool operator== (const Hash64 & h) const
@@ -100,6 +115,12 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
         return this->hash != h.value();
     }
 
+    static const U64 kPrime1 = 11400714785074694791ULL;
+    static const U64 kPrime2 = 14029467366897019727ULL;
+    static const U64 kPrime3 = 1609587929392839161ULL;
+    static const U64 kPrime4 = 9650029242287828579ULL;
+    static const U64 kPrime5 = 2870177450012600261ULL;
+
 private:
     template<typename T>
     struct alias_cast_t
@@ -116,8 +137,37 @@ private:
         };
     };
 
+    static U64 rotl(U64 x,
+                    int r)
+    {
+        return (x << r) | (x >> (64 - r));
+    }
+
+    static U64 round(U64 acc,
+                     U64 input)
+    {
+        acc += input * kPrime2;
+        acc = rotl(acc, 31);
+
+        return acc * kPrime1;
+    }
+
+    void appendWord(U64 word)
+    {
+        pending[count & 3] = word;
+        ++count;
+        if ( (count & 3) == 0 ) {
+            lanes[0] = round(lanes[0], pending[0]);
+            lanes[1] = round(lanes[1], pending[1]);
+            lanes[2] = round(lanes[2], pending[2]);
+            lanes[3] = round(lanes[3], pending[3]);
+        }
+    }
+
     U64 hash;
-    std::vector<U64> node_values;
+    U64 lanes[4];
+    U64 pending[4]; //< words not yet folded into the lanes
+    U64 count; //< number of words appended
 };
 
 void Hash64_appendQString(Hash64* hash, const QString & str);
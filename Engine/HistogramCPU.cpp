@@ -30,12 +30,14 @@
 #include <stdexcept>
 
 #include <QtCore/QMutex>
+#include <QtCore/QThreadPool>
 #include <QtCore/QWaitCondition>
 
 #ifdef DEBUG
 #include "Global/FloatingPointExceptions.h"
 #endif
 #include "Engine/Image.h"
+#include "Engine/ImageStatistics.h"
 #include "Engine/Smooth1D.h"
 
 NATRON_NAMESPACE_ENTER
@@ -224,86 +226,13 @@ HistogramCPU::getMostRecentlyProducedHistogram(std::vector<float>* histogram1,
     return true;
 }
 
-///putting these in an anonymous namespace will yield this error on gcc 4.2:
-///"function has not external linkage"
-struct pix_red
-{
-    static float val(const float *pix)
-    {
-        return pix[0];
-    }
-};
-
-struct pix_green
-{
-    static float val(const float *pix)
-    {
-        return pix[1];
-    }
-};
-
-struct pix_blue
-{
-    static float val(const float *pix)
-    {
-        return pix[2];
-    }
-};
-
-struct pix_alpha
-{
-    static float val(const float *pix)
-    {
-        return pix[3];
-    }
-};
-
-struct pix_lum
-{
-    static float val(const float *pix)
-    {
-        return 0.299 * pix[0] + 0.587 * pix[1] + 0.114 * pix[2];
-    }
-};
-
-
-template <float pix_func(const float*)>
-void
-computeHisto(const HistogramRequest & request,
-             int upscale,
-             std::vector<float> *histo)
-{
-    assert(histo);
-    histo->resize(request.binsCount * upscale);
-    std::fill(histo->begin(), histo->end(), 0.f);
-    double binSize = (request.vmax - request.vmin) / histo->size();
-
-    ///Images come from the viewer which is in float.
-    assert(request.image->getBitDepth() == eImageBitDepthFloat);
-
-    Image::ReadAccess acc = request.image->getReadRights();
-
-    for (int y = request.rect.bottom(); y < request.rect.top(); ++y) {
-        for (int x = request.rect.left(); x < request.rect.right(); ++x) {
-            const float *pix = (const float*)acc.pixelAt(x, y);
-            float v = pix_func(pix);
-            if ( (request.vmin <= v) && (v < request.vmax) ) {
-                int index = (int)( (v - request.vmin) / binSize );
-                assert( 0 <= index && index < (int)histo->size() );
-                (*histo)[index] += 1.f;
-            }
-        }
-    }
-}
-
-
-
 static void
 computeHistogramStatic(const HistogramRequest & request,
+                       const ImageStatistics & stats,
+                       int upscale,
                        FinishedHistogramPtr ret,
                        int histogramIndex)
 {
-    const int upscale = 5;
     std::vector<float> *histo = 0;
 
     switch (histogramIndex) {
@@ -335,28 +264,32 @@ computeHistogramStatic(const HistogramRequest & request,
 
     ret->pixelsCount = request.rect.area();
     // a histogram with upscale more bins
-    std::vector<float> histo_upscaled;
+    ImageStatistics::ChannelEnum channel;
     switch (mode) {
     case 1:     //< A
-        computeHisto<&pix_alpha::val>(request, upscale, &histo_upscaled);
+        channel = ImageStatistics::eChannelA;
         break;
     case 2:     //<Y
-        computeHisto<&pix_lum::val>(request, upscale, &histo_upscaled);
+        channel = ImageStatistics::eChannelY;
         break;
     case 3:     //< R
-        computeHisto<&pix_red::val>(request, upscale, &histo_upscaled);
+        channel = ImageStatistics::eChannelR;
         break;
     case 4:     //< G
-        computeHisto<&pix_green::val>(request, upscale, &histo_upscaled);
+        channel = ImageStatistics::eChannelG;
         break;
     case 5:     //< B
-        computeHisto<&pix_blue::val>(request, upscale, &histo_upscaled);
+        channel = ImageStatistics::eChannelB;
         break;
 
     default:
         assert(false);
+        channel = ImageStatistics::eChannelR;
         break;
     }
+    std::vector<unsigned int> counts = stats.getHistogram(channel);
+    assert( (int)counts.size() == request.binsCount * upscale );
+    std::vector<float> histo_upscaled( counts.begin(), counts.end() );
     double sigma = upscale;
     if (request.smoothingKernelSize > 1) {
         sigma *= request.smoothingKernelSize;
@@ -420,18 +353,24 @@ HistogramCPU::run()
         ret->mipMapLevel = request.image->getMipMapLevel();
 
 
+        // All the channels are binned in a single pass over the image, which is shared with the viewer auto-contrast.
+        // Images come from the viewer which is in float.
+        const int upscale = 5;
+        bool multiThreaded = QThreadPool::globalInstance()->activeThreadCount() < QThreadPool::globalInstance()->maxThreadCount();
+        ImageStatisticsConstPtr stats = ImageStatistics::compute(request.image, request.rect, request.binsCount * upscale, request.vmin, request.vmax, multiThreaded);
+
         switch (request.mode) {
         case 0:     //< RGB
-            computeHistogramStatic(request, ret, 1);
-            computeHistogramStatic(request, ret, 2);
-            computeHistogramStatic(request, ret, 3);
+            computeHistogramStatic(request, *stats, upscale, ret, 1);
+            computeHistogramStatic(request, *stats, upscale, ret, 2);
+            computeHistogramStatic(request, *stats, upscale, ret, 3);
             break;
         case 1:
         case 2:
         case 3:
         case 4:
         case 5:
-            computeHistogramStatic(request, ret, 1);
+            computeHistogramStatic(request, *stats, upscale, ret, 1);
             break;
         default:
             assert(false);     //< unknown case.
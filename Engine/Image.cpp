@@ -43,167 +43,299 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 #include "Engine/GPUContextPool.h"
 #include "Engine/OSGLContext.h"
 #include "Engine/GLShader.h"
+#include "Engine/PixelConvert.h"
 
-NATRON_NAMESPACE_ENTER
+#ifdef NATRON_PIXEL_CONVERT_X86_SIMD
+#include <immintrin.h>
+#define NATRON_TARGET_SSE41 __attribute__( ( target("sse4.1") ) )
+#define NATRON_TARGET_AVX2 __attribute__( ( target("avx2") ) )
+#endif
 
-#define BM_GET(i, j) (&_map[( i - _bounds.bottom() ) * _bounds.width() + ( j - _bounds.left() )])
+NATRON_NAMESPACE_ENTER
 
 #define PIXEL_UNAVAILABLE 2
 
-template <int trimap>
+// The tiles of the Bitmap are squares of NATRON_BITMAP_TILE_SIZE pixels starting at the bottom-left corner of its bounds
+#define NATRON_BITMAP_TILE_SIZE 64
+
+#define BITMAP_TILE_MIXED -1
+
+void
+Bitmap::initialize(const RectI & bounds)
+{
+    _bounds = bounds;
+    if ( _bounds.isNull() ) {
+        _tilesPerRow = 0;
+        _tileStates.clear();
+    } else {
+        _tilesPerRow = (_bounds.width() + NATRON_BITMAP_TILE_SIZE - 1) / NATRON_BITMAP_TILE_SIZE;
+        int tilesPerColumn = (_bounds.height() + NATRON_BITMAP_TILE_SIZE - 1) / NATRON_BITMAP_TILE_SIZE;
+        _tileStates.assign(_tilesPerRow * tilesPerColumn, 0);
+    }
+    std::vector<std::vector<char> >( _tileStates.size() ).swap(_tilePixels);
+    _mixedTilesCount = 0;
+}
+
 RectI
-minimalNonMarkedBbox_internal(const RectI& roi,
-                              const RectI& _bounds,
-                              const std::vector<char>& _map,
-                              bool* isBeingRenderedElsewhere)
+Bitmap::getTileRect(int tx,
+                    int ty) const
 {
-    RectI bbox;
+    int x1 = _bounds.x1 + tx * NATRON_BITMAP_TILE_SIZE;
+    int y1 = _bounds.y1 + ty * NATRON_BITMAP_TILE_SIZE;
 
-    assert( _bounds.contains(roi) );
-    bbox = roi;
+    return RectI( x1, y1, std::min(x1 + NATRON_BITMAP_TILE_SIZE, _bounds.x2), std::min(y1 + NATRON_BITMAP_TILE_SIZE, _bounds.y2) );
+}
 
-    //find bottom
-    for (int i = bbox.bottom(); i < bbox.top(); ++i) {
-        const char* buf = BM_GET( i, bbox.left() );
-
-        if (trimap) {
-            const char* lineEnd = buf + bbox.width();
-            bool metUnavailablePixel = false;
-            while (buf < lineEnd) {
-                if (!*buf) {
-                    buf = 0;
-                    break;
-                } else if (*buf == PIXEL_UNAVAILABLE) {
-                    metUnavailablePixel = true;
-                }
-                ++buf;
-            }
-            if (!buf) {
-                break;
-            } else if (metUnavailablePixel) {
-                *isBeingRenderedElsewhere = true; //< only flag if the whole row is not 0
-                ++bbox.y1;
-            } else {
-                ++bbox.y1;
-            }
-        } else {
-            const char* lineEnd = buf + bbox.width();
-            while (buf < lineEnd) {
-                if ( !*buf || (*buf == PIXEL_UNAVAILABLE) ) {
-                    buf = 0;
-                    break;
-                }
-                ++buf;
-            }
-            if (!buf) {
-                break;
-            } else {
-                ++bbox.y1;
+char*
+Bitmap::getMixedTilePixels(int tileIndex)
+{
+    char& state = _tileStates[tileIndex];
+    std::vector<char>& pixels = _tilePixels[tileIndex];
+
+    if (state != BITMAP_TILE_MIXED) {
+        pixels.assign(NATRON_BITMAP_TILE_SIZE * NATRON_BITMAP_TILE_SIZE, state);
+        state = BITMAP_TILE_MIXED;
+        ++_mixedTilesCount;
+    }
+
+    return &pixels.front();
+}
+
+void
+Bitmap::collapseTileIfUniform(int tileIndex,
+                              const RectI& tileRect)
+{
+    assert(_tileStates[tileIndex] == BITMAP_TILE_MIXED);
+    std::vector<char>& pixels = _tilePixels[tileIndex];
+    const char* row = &pixels.front();
+    const char value = *row;
+    for (int y = tileRect.y1; y < tileRect.y2; ++y, row += NATRON_BITMAP_TILE_SIZE) {
+        for (int x = 0; x < tileRect.width(); ++x) {
+            if (row[x] != value) {
+                return;
             }
         }
     }
+    _tileStates[tileIndex] = value;
+    std::vector<char>().swap(pixels);
+    --_mixedTilesCount;
+}
 
-    //find top (will do zero iteration if the bbox is already empty)
-    for (int i = bbox.top() - 1; i >= bbox.bottom(); --i) {
-        const char* buf = BM_GET( i, bbox.left() );
+void
+Bitmap::markTileFor(int tileIndex,
+                    const RectI& tileRect,
+                    const RectI& roi,
+                    char value)
+{
+    if (_tileStates[tileIndex] == value) {
+        return;
+    }
+    if (roi == tileRect) {
+        if (_tileStates[tileIndex] == BITMAP_TILE_MIXED) {
+            std::vector<char>().swap(_tilePixels[tileIndex]);
+            --_mixedTilesCount;
+        }
+        _tileStates[tileIndex] = value;
 
-        if (trimap) {
-            const char* lineEnd = buf + bbox.width();
-            bool metUnavailablePixel = false;
-            while (buf < lineEnd) {
-                if (!*buf) {
-                    buf = 0;
-                    break;
-                } else if (*buf == PIXEL_UNAVAILABLE) {
-                    metUnavailablePixel = true;
-                }
-                ++buf;
-            }
-            if (!buf) {
-                break;
-            } else if (metUnavailablePixel) {
-                *isBeingRenderedElsewhere = true; //< only flag if the whole row is not 0
-                --bbox.y2;
+        return;
+    }
+
+    char* row = getMixedTilePixels(tileIndex) + (roi.y1 - tileRect.y1) * NATRON_BITMAP_TILE_SIZE + (roi.x1 - tileRect.x1);
+    for (int y = roi.y1; y < roi.y2; ++y, row += NATRON_BITMAP_TILE_SIZE) {
+        std::memset( row, value, roi.width() );
+    }
+    collapseTileIfUniform(tileIndex, tileRect);
+}
+
+void
+Bitmap::markFor(const RectI & roi,
+                char value)
+{
+    RectI rect;
+
+    if ( !roi.intersect(_bounds, &rect) ) {
+        return;
+    }
+    const int tx1 = (rect.x1 - _bounds.x1) / NATRON_BITMAP_TILE_SIZE;
+    const int tx2 = (rect.x2 - 1 - _bounds.x1) / NATRON_BITMAP_TILE_SIZE;
+    const int ty1 = (rect.y1 - _bounds.y1) / NATRON_BITMAP_TILE_SIZE;
+    const int ty2 = (rect.y2 - 1 - _bounds.y1) / NATRON_BITMAP_TILE_SIZE;
+    for (int ty = ty1; ty <= ty2; ++ty) {
+        for (int tx = tx1; tx <= tx2; ++tx) {
+            RectI tileRect = getTileRect(tx, ty);
+            RectI tileRoI;
+            rect.intersect(tileRect, &tileRoI);
+            markTileFor(ty * _tilesPerRow + tx, tileRect, tileRoI, value);
+        }
+    }
+}
+
+int
+Bitmap::getStates(const RectI& roi) const
+{
+    RectI rect;
+
+    if ( !roi.intersect(_bounds, &rect) ) {
+        return 0;
+    }
+    const int allStates = eBitmapStateFlagUnrendered | eBitmapStateFlagRendered | eBitmapStateFlagUnavailable;
+    int states = 0;
+    const int tx1 = (rect.x1 - _bounds.x1) / NATRON_BITMAP_TILE_SIZE;
+    const int tx2 = (rect.x2 - 1 - _bounds.x1) / NATRON_BITMAP_TILE_SIZE;
+    const int ty1 = (rect.y1 - _bounds.y1) / NATRON_BITMAP_TILE_SIZE;
+    const int ty2 = (rect.y2 - 1 - _bounds.y1) / NATRON_BITMAP_TILE_SIZE;
+    for (int ty = ty1; ty <= ty2; ++ty) {
+        for (int tx = tx1; tx <= tx2; ++tx) {
+            const int tileIndex = ty * _tilesPerRow + tx;
+            const char state = _tileStates[tileIndex];
+            if (state != BITMAP_TILE_MIXED) {
+                states |= (1 << state);
             } else {
-                --bbox.y2;
-            }
-        } else {
-            const char* lineEnd = buf + bbox.width();
-            while (buf < lineEnd) {
-                if ( !*buf || (*buf == PIXEL_UNAVAILABLE) ) {
-                    buf = 0;
-                    break;
+                RectI tileRect = getTileRect(tx, ty);
+                RectI tileRoI;
+                rect.intersect(tileRect, &tileRoI);
+                const char* row = &_tilePixels[tileIndex].front() + (tileRoI.y1 - tileRect.y1) * NATRON_BITMAP_TILE_SIZE + (tileRoI.x1 - tileRect.x1);
+                for (int y = tileRoI.y1; y < tileRoI.y2 && states != allStates; ++y, row += NATRON_BITMAP_TILE_SIZE) {
+                    for (int x = 0; x < tileRoI.width(); ++x) {
+                        states |= (1 << row[x]);
+                    }
                 }
-                ++buf;
             }
-            if (!buf) {
-                break;
-            } else {
-                --bbox.y2;
+            if (states == allStates) {
+                return states;
             }
         }
     }
 
-    // avoid making bbox.width() iterations for nothing
-    if ( bbox.isNull() ) {
-        return bbox;
+    return states;
+}
+
+char
+Bitmap::getStateAt(int x,
+                   int y) const
+{
+    assert( x >= _bounds.x1 && x < _bounds.x2 && y >= _bounds.y1 && y < _bounds.y2 );
+    const int tx = (x - _bounds.x1) / NATRON_BITMAP_TILE_SIZE;
+    const int ty = (y - _bounds.y1) / NATRON_BITMAP_TILE_SIZE;
+    const int tileIndex = ty * _tilesPerRow + tx;
+    const char state = _tileStates[tileIndex];
+    if (state != BITMAP_TILE_MIXED) {
+        return state;
     }
 
-    //find left
-    for (int j = bbox.left(); j < bbox.right(); ++j) {
-        const char* pix = BM_GET(bbox.bottom(), j);
-        bool metUnavailablePixel = false;
+    return _tilePixels[tileIndex][( y - _bounds.y1 - ty * NATRON_BITMAP_TILE_SIZE ) * NATRON_BITMAP_TILE_SIZE + ( x - _bounds.x1 - tx * NATRON_BITMAP_TILE_SIZE )];
+}
 
-        for ( int i = bbox.bottom(); i < bbox.top(); ++i, pix += _bounds.width() ) {
-            if (!*pix) {
-                pix = 0;
-                break;
-            } else if (*pix == PIXEL_UNAVAILABLE) {
-                if (trimap) {
-                    metUnavailablePixel = true;
-                } else {
-                    pix = 0;
-                    break;
-                }
-            }
-        }
-        if (pix) {
-            ++bbox.x1;
-            if (trimap && metUnavailablePixel) {
-                *isBeingRenderedElsewhere = true; //< only flag is the whole column is not 0
-            }
-        } else {
+std::size_t
+Bitmap::getMemorySize() const
+{
+    return _tileStates.size() + (std::size_t)_mixedTilesCount * NATRON_BITMAP_TILE_SIZE * NATRON_BITMAP_TILE_SIZE;
+}
+
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+enum BitmapSideEnum
+{
+    eBitmapSideBottom = 0,
+    eBitmapSideTop,
+    eBitmapSideLeft,
+    eBitmapSideRight
+};
+
+/*
+   Moves the given side of rect inwards while the line of pixels along that side contains none of the stopStates.
+   Lines are first tested by bands reaching the next tile boundary, so that a region made of uniform tiles costs O(tiles).
+   If flagUnavailableOnSkip is set, isBeingRenderedElsewhere is set when a skipped line contains pixels being rendered,
+   if flagUnavailableOnStop is set, it is set when the line that stopped the search contains pixels being rendered.
+ */
+void
+shrinkBitmapSide(const Bitmap& bm,
+                 BitmapSideEnum side,
+                 int stopStates,
+                 bool flagUnavailableOnSkip,
+                 bool flagUnavailableOnStop,
+                 RectI* rect,
+                 bool* isBeingRenderedElsewhere)
+{
+    const RectI& bounds = bm.getBounds();
+
+    while ( !rect->isNull() ) {
+        RectI band = *rect;
+        RectI line = *rect;
+        switch (side) {
+        case eBitmapSideBottom:
+            band.y2 = std::min(rect->y2, bounds.y1 + ( (rect->y1 - bounds.y1) / NATRON_BITMAP_TILE_SIZE + 1 ) * NATRON_BITMAP_TILE_SIZE);
+            line.y2 = rect->y1 + 1;
+            break;
+        case eBitmapSideTop:
+            band.y1 = std::max(rect->y1, bounds.y1 + ( (rect->y2 - 1 - bounds.y1) / NATRON_BITMAP_TILE_SIZE ) * NATRON_BITMAP_TILE_SIZE);
+            line.y1 = rect->y2 - 1;
+            break;
+        case eBitmapSideLeft:
+            band.x2 = std::min(rect->x2, bounds.x1 + ( (rect->x1 - bounds.x1) / NATRON_BITMAP_TILE_SIZE + 1 ) * NATRON_BITMAP_TILE_SIZE);
+            line.x2 = rect->x1 + 1;
+            break;
+        case eBitmapSideRight:
+            band.x1 = std::max(rect->x1, bounds.x1 + ( (rect->x2 - 1 - bounds.x1) / NATRON_BITMAP_TILE_SIZE ) * NATRON_BITMAP_TILE_SIZE);
+            line.x1 = rect->x2 - 1;
             break;
         }
-    }
-
-    //find right
-    for (int j = bbox.right() - 1; j >= bbox.left(); --j) {
-        const char* pix = BM_GET(bbox.bottom(), j);
-        bool metUnavailablePixel = false;
 
-        for ( int i = bbox.bottom(); i < bbox.top(); ++i, pix += _bounds.width() ) {
-            if (!*pix) {
-                pix = 0;
-                break;
-            } else if (*pix == PIXEL_UNAVAILABLE) {
-                if (trimap) {
-                    metUnavailablePixel = true;
-                } else {
-                    pix = 0;
-                    break;
+        // Skip the whole band if possible, otherwise the first line
+        RectI skipped = band;
+        int states = bm.getStates(band);
+        if (states & stopStates) {
+            skipped = line;
+            states = bm.getStates(line);
+            if (states & stopStates) {
+                if ( flagUnavailableOnStop && (states & Bitmap::eBitmapStateFlagUnavailable) ) {
+                    *isBeingRenderedElsewhere = true;
                 }
+
+                return;
             }
         }
-        if (pix) {
-            --bbox.x2;
-            if (trimap && metUnavailablePixel) {
-                *isBeingRenderedElsewhere = true; //< only flag is the whole column is not 0
-            }
-        } else {
+        if ( flagUnavailableOnSkip && (states & Bitmap::eBitmapStateFlagUnavailable) ) {
+            *isBeingRenderedElsewhere = true;
+        }
+        switch (side) {
+        case eBitmapSideBottom:
+            rect->y1 = skipped.y2;
+            break;
+        case eBitmapSideTop:
+            rect->y2 = skipped.y1;
+            break;
+        case eBitmapSideLeft:
+            rect->x1 = skipped.x2;
+            break;
+        case eBitmapSideRight:
+            rect->x2 = skipped.x1;
             break;
         }
     }
+} // shrinkBitmapSide
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+template <int trimap>
+RectI
+minimalNonMarkedBbox_internal(const RectI& roi,
+                              const Bitmap& bm,
+                              bool* isBeingRenderedElsewhere)
+{
+    RectI bbox;
+
+    assert( bm.getBounds().contains(roi) );
+    bbox = roi;
+
+    // Remove the lines that have nothing to render. With the trimap, pixels being rendered by another thread are not
+    // rendered again, but the caller is notified that it has to wait for them.
+    const int stopStates = trimap ? Bitmap::eBitmapStateFlagUnrendered : ( Bitmap::eBitmapStateFlagUnrendered | Bitmap::eBitmapStateFlagUnavailable );
+
+    shrinkBitmapSide(bm, eBitmapSideBottom, stopStates, trimap, false, &bbox, isBeingRenderedElsewhere);
+    shrinkBitmapSide(bm, eBitmapSideTop, stopStates, trimap, false, &bbox, isBeingRenderedElsewhere);
+    shrinkBitmapSide(bm, eBitmapSideLeft, stopStates, trimap, false, &bbox, isBeingRenderedElsewhere);
+    shrinkBitmapSide(bm, eBitmapSideRight, stopStates, trimap, false, &bbox, isBeingRenderedElsewhere);
 
     return bbox;
 } // minimalNonMarkedBbox_internal
@@ -212,12 +344,12 @@ minimalNonMarkedBbox_internal(const RectI& roi,
 template <int trimap>
 void
 minimalNonMarkedRects_internal(const RectI & roi,
-                               const RectI& _bounds,
-                               const std::vector<char>& _map,
+                               const Bitmap& bm,
                                std::list<RectI>& ret,
                                bool* isBeingRenderedElsewhere)
 {
     assert(ret.empty());
+    const RectI& _bounds = bm.getBounds();
     ///Any out of bounds portion is pushed to the rectangles to render
     RectI intersection;
 
@@ -251,7 +383,7 @@ minimalNonMarkedRects_internal(const RectI & roi,
         return;
     }
 
-    RectI bboxM = minimalNonMarkedBbox_internal<trimap>(intersection, _bounds, _map, isBeingRenderedElsewhere);
+    RectI bboxM = minimalNonMarkedBbox_internal<trimap>(intersection, bm, isBeingRenderedElsewhere);
     assert( (trimap && isBeingRenderedElsewhere) || (!trimap && !isBeingRenderedElsewhere) );
 
     //#define NATRON_BITMAP_DISABLE_OPTIMIZATION
@@ -285,45 +417,15 @@ minimalNonMarkedRects_internal(const RectI & roi,
     // CXXXXXXXXXXDDD
     // AAAAAAAAAAAAAA
 
+    // A line belongs to A, B, C or D if it has no rendered pixel (and no pixel being rendered with the trimap)
+    const int stopStates = trimap ? ( Bitmap::eBitmapStateFlagRendered | Bitmap::eBitmapStateFlagUnavailable ) : Bitmap::eBitmapStateFlagRendered;
+
     // First, find if there's an "A" rectangle, and push it to the result
     //find bottom
     RectI bboxX = bboxM;
     RectI bboxA = bboxX;
+    shrinkBitmapSide(bm, eBitmapSideBottom, stopStates, false, trimap, &bboxX, isBeingRenderedElsewhere);
     bboxA.set_top( bboxX.bottom() );
-    for (int i = bboxX.bottom(); i < bboxX.top(); ++i) {
-        const char* buf = BM_GET( i, bboxX.left() );
-        if (trimap) {
-            const char* lineEnd = buf + bboxX.width();
-            bool metUnavailablePixel = false;
-            while (buf < lineEnd) {
-                if (*buf == 1) {
-                    buf = 0;
-                    break;
-                } else if ( (*buf == PIXEL_UNAVAILABLE) && trimap ) {
-                    buf = 0;
-                    metUnavailablePixel = true;
-                    break;
-                }
-                ++buf;
-            }
-            if (buf) {
-                ++bboxX.y1;
-                bboxA.y2 = bboxX.y1;
-            } else {
-                if (metUnavailablePixel) {
-                    *isBeingRenderedElsewhere = true;
-                }
-                break;
-            }
-        } else {
-            if ( !memchr( buf, 1, bboxX.width() ) ) {
-                ++bboxX.y1;
-                bboxA.y2 = bboxX.y1;
-            } else {
-                break;
-            }
-        }
-    }
     if ( !bboxA.isNull() ) { // empty boxes should not be pushed
         ret.push_back(bboxA);
     }
@@ -331,108 +433,28 @@ minimalNonMarkedRects_internal(const RectI & roi,
     // Now, find the "B" rectangle
     //find top
     RectI bboxB = bboxX;
+    shrinkBitmapSide(bm, eBitmapSideTop, stopStates, false, trimap, &bboxX, isBeingRenderedElsewhere);
     bboxB.set_bottom( bboxX.top() );
-    for (int i = bboxX.top() - 1; i >= bboxX.bottom(); --i) {
-        const char* buf = BM_GET( i, bboxX.left() );
-
-        if (trimap) {
-            const char* lineEnd = buf + bboxX.width();
-            bool metUnavailablePixel = false;
-            while (buf < lineEnd) {
-                if (*buf == 1) {
-                    buf = 0;
-                    break;
-                } else if ( (*buf == PIXEL_UNAVAILABLE) && trimap ) {
-                    buf = 0;
-                    metUnavailablePixel = true;
-                    break;
-                }
-                ++buf;
-            }
-            if (buf) {
-                --bboxX.y2;
-                bboxB.y1 = bboxX.y2;
-            } else {
-                if (metUnavailablePixel) {
-                    *isBeingRenderedElsewhere = true;
-                }
-                break;
-            }
-        } else {
-            if ( !memchr( buf, 1, bboxX.width() ) ) {
-                --bboxX.y2;
-                bboxB.y1 = bboxX.y2;
-            } else {
-                break;
-            }
-        }
-    }
     if ( !bboxB.isNull() ) { // empty boxes should not be pushed
         ret.push_back(bboxB);
     }
 
     //find left
     RectI bboxC = bboxX;
-    bboxC.set_right( bboxX.left() );
     if ( bboxX.bottom() < bboxX.top() ) {
-        for (int j = bboxX.left(); j < bboxX.right(); ++j) {
-            const char* pix = BM_GET(bboxX.bottom(), j);
-            bool metUnavailablePixel = false;
-
-            for ( int i = bboxX.bottom(); i < bboxX.top(); ++i, pix += _bounds.width() ) {
-                if (*pix == 1) {
-                    pix = 0;
-                    break;
-                } else if ( trimap && (*pix == PIXEL_UNAVAILABLE) ) {
-                    pix = 0;
-                    metUnavailablePixel = true;
-                    break;
-                }
-            }
-            if (pix) {
-                ++bboxX.x1;
-                bboxC.x2 = bboxX.x1;
-            } else {
-                if (metUnavailablePixel) {
-                    *isBeingRenderedElsewhere = true;
-                }
-                break;
-            }
-        }
+        shrinkBitmapSide(bm, eBitmapSideLeft, stopStates, false, trimap, &bboxX, isBeingRenderedElsewhere);
     }
+    bboxC.set_right( bboxX.left() );
     if ( !bboxC.isNull() ) { // empty boxes should not be pushed
         ret.push_back(bboxC);
     }
 
     //find right
     RectI bboxD = bboxX;
-    bboxD.set_left( bboxX.right() );
     if ( bboxX.bottom() < bboxX.top() ) {
-        for (int j = bboxX.right() - 1; j >= bboxX.left(); --j) {
-            const char* pix = BM_GET(bboxX.bottom(), j);
-            bool metUnavailablePixel = false;
-
-            for ( int i = bboxX.bottom(); i < bboxX.top(); ++i, pix += _bounds.width() ) {
-                if (*pix == 1) {
-                    pix = 0;
-                    break;
-                } else if ( trimap && (*pix == PIXEL_UNAVAILABLE) ) {
-                    pix = 0;
-                    metUnavailablePixel = true;
-                    break;
-                }
-            }
-            if (pix) {
-                --bboxX.x2;
-                bboxD.x1 = bboxX.x2;
-            } else {
-                if (metUnavailablePixel) {
-                    *isBeingRenderedElsewhere = true;
-                }
-                break;
-            }
-        }
+        shrinkBitmapSide(bm, eBitmapSideRight, stopStates, false, trimap, &bboxX, isBeingRenderedElsewhere);
     }
+    bboxD.set_left( bboxX.right() );
     if ( !bboxD.isNull() ) { // empty boxes should not be pushed
         ret.push_back(bboxD);
     }
@@ -458,7 +480,7 @@ minimalNonMarkedRects_internal(const RectI & roi,
     assert( bboxD.bottom() == bboxX.bottom() );
 
     // get the bounding box of what's left (the X rectangle in the drawing above)
-    bboxX = minimalNonMarkedBbox_internal<trimap>(bboxX, _bounds, _map, isBeingRenderedElsewhere);
+    bboxX = minimalNonMarkedBbox_internal<trimap>(bboxX, bm, isBeingRenderedElsewhere);
 
     if ( !bboxX.isNull() ) { // empty boxes should not be pushed
         ret.push_back(bboxX);
@@ -476,9 +498,9 @@ Bitmap::minimalNonMarkedBbox(const RectI & roi) const
             return RectI();
         }
 
-        return minimalNonMarkedBbox_internal<0>(realRoi, _bounds, _map, NULL);
+        return minimalNonMarkedBbox_internal<0>(realRoi, *this, NULL);
     } else {
-        return minimalNonMarkedBbox_internal<0>(roi, _bounds, _map, NULL);
+        return minimalNonMarkedBbox_internal<0>(roi, *this, NULL);
     }
 }
 
@@ -491,9 +513,9 @@ Bitmap::minimalNonMarkedRects(const RectI & roi,
         if ( !roi.intersect(_dirtyZone, &realRoi) ) {
             return;
         }
-        minimalNonMarkedRects_internal<0>(realRoi, _bounds, _map, ret, NULL);
+        minimalNonMarkedRects_internal<0>(realRoi, *this, ret, NULL);
     } else {
-        minimalNonMarkedRects_internal<0>(roi, _bounds, _map, ret, NULL);
+        minimalNonMarkedRects_internal<0>(roi, *this, ret, NULL);
     }
 }
 
@@ -510,9 +532,9 @@ Bitmap::minimalNonMarkedBbox_trimap(const RectI & roi,
             return RectI();
         }
 
-        return minimalNonMarkedBbox_internal<1>(realRoi, _bounds, _map, isBeingRenderedElsewhere);
+        return minimalNonMarkedBbox_internal<1>(realRoi, *this, isBeingRenderedElsewhere);
     } else {
-        return minimalNonMarkedBbox_internal<1>(roi, _bounds, _map, isBeingRenderedElsewhere);
+        return minimalNonMarkedBbox_internal<1>(roi, *this, isBeingRenderedElsewhere);
     }
 }
 
@@ -528,51 +550,18 @@ Bitmap::minimalNonMarkedRects_trimap(const RectI & roi,
 
             return;
         }
-        minimalNonMarkedRects_internal<1>(realRoi, _bounds, _map, ret, isBeingRenderedElsewhere);
+        minimalNonMarkedRects_internal<1>(realRoi, *this, ret, isBeingRenderedElsewhere);
     } else {
-        minimalNonMarkedRects_internal<1>(roi, _bounds, _map, ret, isBeingRenderedElsewhere);
+        minimalNonMarkedRects_internal<1>(roi, *this, ret, isBeingRenderedElsewhere);
     }
 }
 
 #endif
 
-void
-Bitmap::markFor(const RectI & roi, char value)
-{
-    int x1 = std::max(roi.x1, _bounds.x1);
-    int y1 = std::max(roi.y1, _bounds.y1);
-    int x2 = std::min(roi.x2, _bounds.x2);
-    int y2 = std::min(roi.y2, _bounds.y2);
-
-    char* buf = BM_GET(y1, x1);
-    int w = _bounds.width();
-    int roiw = x2 - x1;
-
-    for (int i = y1; i < y2; ++i, buf += w) {
-        std::memset( buf, value, roiw);
-    }
-}
-
 bool
 Bitmap::isNonMarked(const RectI & roi) const
 {
-    int x1 = std::max(roi.x1, _bounds.x1);
-    int y1 = std::max(roi.y1, _bounds.y1);
-    int x2 = std::min(roi.x2, _bounds.x2);
-    int y2 = std::min(roi.y2, _bounds.y2);
-
-    const char* buf = BM_GET(y1, x1);
-    int w = _bounds.width();
-    int roiw = x2 - x1;
-
-    for (int i = y1; i < y2; ++i, buf += w) {
-        for (int j = 0; j < roiw; ++j) {
-            if (buf[j]) {
-                return false;
-            }
-        }
-    }
-    return true;
+    return !( getStates(roi) & (eBitmapStateFlagRendered | eBitmapStateFlagUnavailable) );
 }
 
 #if NATRON_ENABLE_TRIMAP
@@ -587,33 +576,119 @@ Bitmap::markForRendering(const RectI & roi)
 void
 Bitmap::swap(Bitmap& other)
 {
-    _map.swap(other._map);
+    _tileStates.swap(other._tileStates);
+    _tilePixels.swap(other._tilePixels);
+    std::swap(_mixedTilesCount, other._mixedTilesCount);
     _bounds = other._bounds;
+    _tilesPerRow = other._tilesPerRow;
     _dirtyZone.clear(); //merge(other._dirtyZone);
     _dirtyZoneSet = false;
 }
 
-const char*
-Bitmap::getBitmapAt(int x,
-                    int y) const
+void
+Bitmap::copyBitmapPortion(const RectI& roi,
+                          const Bitmap& other)
 {
-    if ( ( x >= _bounds.left() ) && ( x < _bounds.right() ) && ( y >= _bounds.bottom() ) && ( y < _bounds.top() ) ) {
-        return BM_GET(y, x);
-    } else {
-        return NULL;
+    assert(roi.x1 >= _bounds.x1 && roi.x2 <= _bounds.x2 && roi.y1 >= _bounds.y1 && roi.y2 <= _bounds.y2);
+    assert(roi.x1 >= other._bounds.x1 && roi.x2 <= other._bounds.x2 && roi.y1 >= other._bounds.y1 && roi.y2 <= other._bounds.y2);
+
+    if ( roi.isNull() ) {
+        return;
     }
-}
+    const int tx1 = (roi.x1 - _bounds.x1) / NATRON_BITMAP_TILE_SIZE;
+    const int tx2 = (roi.x2 - 1 - _bounds.x1) / NATRON_BITMAP_TILE_SIZE;
+    const int ty1 = (roi.y1 - _bounds.y1) / NATRON_BITMAP_TILE_SIZE;
+    const int ty2 = (roi.y2 - 1 - _bounds.y1) / NATRON_BITMAP_TILE_SIZE;
+    for (int ty = ty1; ty <= ty2; ++ty) {
+        for (int tx = tx1; tx <= tx2; ++tx) {
+            const int tileIndex = ty * _tilesPerRow + tx;
+            RectI tileRect = getTileRect(tx, ty);
+            RectI tileRoI;
+            roi.intersect(tileRect, &tileRoI);
+            int states = other.getStates(tileRoI);
+            switch (states) {
+            case eBitmapStateFlagUnrendered:
+                markTileFor(tileIndex, tileRect, tileRoI, 0);
+                break;
+            case eBitmapStateFlagRendered:
+                markTileFor(tileIndex, tileRect, tileRoI, 1);
+                break;
+            case eBitmapStateFlagUnavailable:
+                markTileFor(tileIndex, tileRect, tileRoI, PIXEL_UNAVAILABLE);
+                break;
+            default: {
+                char* row = getMixedTilePixels(tileIndex) + (tileRoI.y1 - tileRect.y1) * NATRON_BITMAP_TILE_SIZE + (tileRoI.x1 - tileRect.x1);
+                for (int y = tileRoI.y1; y < tileRoI.y2; ++y, row += NATRON_BITMAP_TILE_SIZE) {
+                    for (int x = tileRoI.x1; x < tileRoI.x2; ++x) {
+                        row[x - tileRoI.x1] = /*other.getStateAt(x, y) == PIXEL_UNAVAILABLE ? 0 : */ other.getStateAt(x, y);
+                    }
+                }
+                collapseTileIfUniform(tileIndex, tileRect);
+                break;
+            }
+            }
+        }
+    }
+} // Bitmap::copyBitmapPortion
 
-char*
-Bitmap::getBitmapAt(int x,
-                    int y)
+void
+Bitmap::halveRoI(const RectI& dstRoI,
+                 const Bitmap& src)
 {
-    if ( ( x >= _bounds.left() ) && ( x < _bounds.right() ) && ( y >= _bounds.bottom() ) && ( y < _bounds.top() ) ) {
-        return BM_GET(y, x);
-    } else {
-        return NULL;
+    RectI roi;
+
+    if ( !dstRoI.intersect(_bounds, &roi) ) {
+        return;
     }
-}
+    const RectI& srcBounds = src._bounds;
+    const int tx1 = (roi.x1 - _bounds.x1) / NATRON_BITMAP_TILE_SIZE;
+    const int tx2 = (roi.x2 - 1 - _bounds.x1) / NATRON_BITMAP_TILE_SIZE;
+    const int ty1 = (roi.y1 - _bounds.y1) / NATRON_BITMAP_TILE_SIZE;
+    const int ty2 = (roi.y2 - 1 - _bounds.y1) / NATRON_BITMAP_TILE_SIZE;
+    for (int ty = ty1; ty <= ty2; ++ty) {
+        for (int tx = tx1; tx <= tx2; ++tx) {
+            const int tileIndex = ty * _tilesPerRow + tx;
+            RectI tileRect = getTileRect(tx, ty);
+            RectI tileRoI;
+            roi.intersect(tileRect, &tileRoI);
+
+            // Each pixel covers the pixels (2x, 2y) to (2x+1, 2y+1) of src
+            RectI srcRect(tileRoI.x1 * 2, tileRoI.y1 * 2, tileRoI.x2 * 2, tileRoI.y2 * 2);
+            int states = src.getStates(srcRect);
+
+            /*
+               The only correct solution is to convert pixels being rendered to 0 otherwise the caller
+               would have to wait for the original fullscale image render to be finished and then re-downscale again.
+               Pixels outside of src are considered rendered: if srcRect is entirely outside, states is 0.
+               When srcRect is only partly inside, a destination pixel whose source pixels are all outside
+               is rendered even though the others are not, so it goes through the per-pixel path.
+             */
+            if ( (states == eBitmapStateFlagRendered) || (states == 0) ) {
+                markTileFor(tileIndex, tileRect, tileRoI, 1);
+            } else if ( !(states & eBitmapStateFlagRendered) && srcBounds.contains(srcRect) ) {
+                markTileFor(tileIndex, tileRect, tileRoI, 0);
+            } else {
+                char* row = getMixedTilePixels(tileIndex) + (tileRoI.y1 - tileRect.y1) * NATRON_BITMAP_TILE_SIZE + (tileRoI.x1 - tileRect.x1);
+                for (int y = tileRoI.y1; y < tileRoI.y2; ++y, row += NATRON_BITMAP_TILE_SIZE) {
+                    for (int x = tileRoI.x1; x < tileRoI.x2; ++x) {
+                        char rendered = 1;
+                        for (int sy = y * 2; sy < y * 2 + 2 && rendered; ++sy) {
+                            for (int sx = x * 2; sx < x * 2 + 2; ++sx) {
+                                if ( (srcBounds.x1 <= sx) && (sx < srcBounds.x2) && (srcBounds.y1 <= sy) && (sy < srcBounds.y2) &&
+                                     (src.getStateAt(sx, sy) != 1) ) {
+                                    rendered = 0;
+                                    break;
+                                }
+                            }
+                        }
+                        row[x - tileRoI.x1] = rendered;
+                    }
+                }
+                collapseTileIfUniform(tileIndex, tileRect);
+            }
+        }
+    }
+} // Bitmap::halveRoI
 
 #ifdef DEBUG
 void
@@ -623,9 +698,6 @@ Image::printUnrenderedPixels(const RectI& roi) const
         return;
     }
     QReadLocker k(&_entryLock);
-    const char* bm = _bitmap.getBitmapAt(roi.x1, roi.y1);
-    int roiw = roi.x2 - roi.x1;
-    int boundsW = _bitmap.getBounds().width();
     RectD bboxUnrendered;
     bboxUnrendered.setupInfinity();
     RectD bboxUnavailable;
@@ -634,10 +706,10 @@ Image::printUnrenderedPixels(const RectI& roi) const
     bool hasUnrendered = false;
     bool hasUnavailable = false;
 
-    for ( int y = roi.y1; y < roi.y2; ++y,
-          bm += (boundsW - roiw) ) {
-        for (int x = roi.x1; x < roi.x2; ++x, ++bm) {
-            if (*bm == 0) {
+    for (int y = roi.y1; y < roi.y2; ++y) {
+        for (int x = roi.x1; x < roi.x2; ++x) {
+            const char bm = _bitmap.getStateAt(x, y);
+            if (bm == 0) {
                 if (x < bboxUnrendered.x1) {
                     bboxUnrendered.x1 = x;
                 }
@@ -651,7 +723,7 @@ Image::printUnrenderedPixels(const RectI& roi) const
                     bboxUnrendered.y2 = y;
                 }
                 hasUnrendered = true;
-            } else if (*bm == PIXEL_UNAVAILABLE) {
+            } else if (bm == PIXEL_UNAVAILABLE) {
                 if (x < bboxUnavailable.x1) {
                     bboxUnavailable.x1 = x;
                 }
@@ -1051,9 +1123,7 @@ Image::resizeInternal(const Image* srcImg,
             std::size_t memsize = a * pixelSize;
             std::memset(pix, 0, memsize);
             if ( setBitmapTo1 && (*outputImage)->usesBitMap() ) {
-                char* bm = wacc.bitmapAt(aRect.x1, aRect.y1);
-                assert(bm);
-                std::memset(bm, 1, a);
+                (*outputImage)->_bitmap.markForRendered(aRect);
             }
         }
         if ( !cRect.isNull() ) {
@@ -1063,9 +1133,7 @@ Image::resizeInternal(const Image* srcImg,
             std::size_t memsize = a * pixelSize;
             std::memset(pix, 0, memsize);
             if ( setBitmapTo1 && (*outputImage)->usesBitMap() ) {
-                char* bm = (char*)wacc.bitmapAt(cRect.x1, cRect.y1);
-                assert(bm);
-                std::memset(bm, 1, a);
+                (*outputImage)->_bitmap.markForRendered(cRect);
             }
         }
         if ( !bRect.isNull() ) {
@@ -1073,15 +1141,12 @@ Image::resizeInternal(const Image* srcImg,
             assert(pix);
             int mw = merge.width();
             std::size_t rowsize = mw * pixelSize;
-            int bw = bRect.width();
-            std::size_t rectRowSize = bw * pixelSize;
-            char* bm = ( setBitmapTo1 && (*outputImage)->usesBitMap() ) ? wacc.bitmapAt(bRect.x1, bRect.y1) : 0;
+            std::size_t rectRowSize = bRect.width() * pixelSize;
             for (int y = bRect.y1; y < bRect.y2; ++y, pix += rowsize) {
                 std::memset(pix, 0, rectRowSize);
-                if (bm) {
-                    std::memset(bm, 1, bw);
-                    bm += mw;
-                }
+            }
+            if ( setBitmapTo1 && (*outputImage)->usesBitMap() ) {
+                (*outputImage)->_bitmap.markForRendered(bRect);
             }
         }
         if ( !dRect.isNull() ) {
@@ -1089,15 +1154,12 @@ Image::resizeInternal(const Image* srcImg,
             assert(pix);
             int mw = merge.width();
             std::size_t rowsize = mw * pixelSize;
-            int dw = dRect.width();
-            std::size_t rectRowSize = dw * pixelSize;
-            char* bm = ( setBitmapTo1 && (*outputImage)->usesBitMap() ) ? wacc.bitmapAt(dRect.x1, dRect.y1) : 0;
+            std::size_t rectRowSize = dRect.width() * pixelSize;
             for (int y = dRect.y1; y < dRect.y2; ++y, pix += rowsize) {
                 std::memset(pix, 0, rectRowSize);
-                if (bm) {
-                    std::memset(bm, 1, dw);
-                    bm += mw;
-                }
+            }
+            if ( setBitmapTo1 && (*outputImage)->usesBitMap() ) {
+                (*outputImage)->_bitmap.markForRendered(dRect);
             }
         }
     } // fillWithBlackAndTransparent
@@ -1808,6 +1870,144 @@ Image::getRowElements() const
     return getComponentsCount() * _bounds.width();
 }
 
+///////////////////////
+/////////////////////////////////////////// MIPMAP ROW KERNELS //////////////////////////////////////////////
+///////////////////////
+
+// Each dst pixel x is the mean of the 2x2 src pixels it covers: thisRow[2x], thisRow[2x+1], nextRow[2x], nextRow[2x+1].
+// The sum is computed in that order by all kernels, and since dividing by 4 is exact, they all give the same result.
+template <typename PIX>
+static void
+halveRowScalar(const PIX* thisRow,
+               const PIX* nextRow,
+               PIX* dst,
+               int nComps,
+               int width)
+{
+    for (int x = 0; x < width; ++x, thisRow += 2 * nComps, nextRow += 2 * nComps, dst += nComps) {
+        for (int k = 0; k < nComps; ++k) {
+            dst[k] = (PIX)( (thisRow[k] + thisRow[k + nComps] + nextRow[k] + nextRow[k + nComps]) / 4 );
+        }
+    }
+}
+
+#ifdef NATRON_PIXEL_CONVERT_X86_SIMD
+
+NATRON_TARGET_SSE41
+static void
+halveRowRGBAFloatSSE41(const float* thisRow,
+                       const float* nextRow,
+                       float* dst,
+                       int width)
+{
+    const __m128 quarter = _mm_set1_ps(0.25f);
+
+    for (int x = 0; x < width; ++x, thisRow += 8, nextRow += 8, dst += 4) {
+        __m128 sum = _mm_add_ps( _mm_loadu_ps(thisRow), _mm_loadu_ps(thisRow + 4) );
+        sum = _mm_add_ps( sum, _mm_loadu_ps(nextRow) );
+        sum = _mm_add_ps( sum, _mm_loadu_ps(nextRow + 4) );
+        _mm_storeu_ps( dst, _mm_mul_ps(sum, quarter) );
+    }
+}
+
+NATRON_TARGET_SSE41
+static void
+halveRowAlphaFloatSSE41(const float* thisRow,
+                        const float* nextRow,
+                        float* dst,
+                        int width)
+{
+    const __m128 quarter = _mm_set1_ps(0.25f);
+    int x = 0;
+
+    for (; x + 4 <= width; x += 4, thisRow += 8, nextRow += 8, dst += 4) {
+        // de-interleave the left and right src pixels of 4 consecutive dst pixels
+        __m128 thisLo = _mm_loadu_ps(thisRow);
+        __m128 thisHi = _mm_loadu_ps(thisRow + 4);
+        __m128 nextLo = _mm_loadu_ps(nextRow);
+        __m128 nextHi = _mm_loadu_ps(nextRow + 4);
+        __m128 sum = _mm_add_ps( _mm_shuffle_ps( thisLo, thisHi, _MM_SHUFFLE(2, 0, 2, 0) ), _mm_shuffle_ps( thisLo, thisHi, _MM_SHUFFLE(3, 1, 3, 1) ) );
+        sum = _mm_add_ps( sum, _mm_shuffle_ps( nextLo, nextHi, _MM_SHUFFLE(2, 0, 2, 0) ) );
+        sum = _mm_add_ps( sum, _mm_shuffle_ps( nextLo, nextHi, _MM_SHUFFLE(3, 1, 3, 1) ) );
+        _mm_storeu_ps( dst, _mm_mul_ps(sum, quarter) );
+    }
+    halveRowScalar<float>(thisRow, nextRow, dst, 1, width - x);
+}
+
+NATRON_TARGET_AVX2
+static void
+halveRowRGBAFloatAVX2(const float* thisRow,
+                      const float* nextRow,
+                      float* dst,
+                      int width)
+{
+    const __m256 quarter = _mm256_set1_ps(0.25f);
+    int x = 0;
+
+    for (; x + 2 <= width; x += 2, thisRow += 16, nextRow += 16, dst += 8) {
+        // src pixels 0 1 and 2 3 of each row, regrouped as 0 2 (left of each pair) and 1 3 (right of each pair)
+        __m256 this01 = _mm256_loadu_ps(thisRow);
+        __m256 this23 = _mm256_loadu_ps(thisRow + 8);
+        __m256 next01 = _mm256_loadu_ps(nextRow);
+        __m256 next23 = _mm256_loadu_ps(nextRow + 8);
+        __m256 sum = _mm256_add_ps( _mm256_permute2f128_ps(this01, this23, 0x20), _mm256_permute2f128_ps(this01, this23, 0x31) );
+        sum = _mm256_add_ps( sum, _mm256_permute2f128_ps(next01, next23, 0x20) );
+        sum = _mm256_add_ps( sum, _mm256_permute2f128_ps(next01, next23, 0x31) );
+        _mm256_storeu_ps( dst, _mm256_mul_ps(sum, quarter) );
+    }
+    halveRowScalar<float>(thisRow, nextRow, dst, 4, width - x);
+}
+
+#endif // NATRON_PIXEL_CONVERT_X86_SIMD
+
+// 8 and 16 bits rows are left to the compiler: the scalar loop has no branch and vectorizes
+template <typename PIX>
+static void
+halveRow(PixelConvert::InstructionSetEnum /*set*/,
+         const PIX* thisRow,
+         const PIX* nextRow,
+         PIX* dst,
+         int nComps,
+         int width)
+{
+    halveRowScalar<PIX>(thisRow, nextRow, dst, nComps, width);
+}
+
+static void
+halveRow(PixelConvert::InstructionSetEnum set,
+         const float* thisRow,
+         const float* nextRow,
+         float* dst,
+         int nComps,
+         int width)
+{
+    switch (set) {
+#ifdef NATRON_PIXEL_CONVERT_X86_SIMD
+    case PixelConvert::eInstructionSetAVX2:
+        if (nComps == 4) {
+            halveRowRGBAFloatAVX2(thisRow, nextRow, dst, width);
+
+            return;
+        }
+    // fall through
+    case PixelConvert::eInstructionSetSSE41:
+        if (nComps == 4) {
+            halveRowRGBAFloatSSE41(thisRow, nextRow, dst, width);
+
+            return;
+        } else if (nComps == 1) {
+            halveRowAlphaFloatSSE41(thisRow, nextRow, dst, width);
+
+            return;
+        }
+        break;
+#endif
+    default:
+        break;
+    }
+    halveRowScalar<float>(thisRow, nextRow, dst, nComps, width);
+}
+
 // code proofread and fixed by @devernay on 4/12/2014
 template <typename PIX, int maxValue>
 void
@@ -1834,10 +2034,8 @@ Image::halveRoIForDepth(const RectI & roi,
     ///The source rectangle, intersected to this image region of definition in pixels
     const RectI &srcBounds = _bounds;
     const RectI &dstBounds = output->_bounds;
-    const RectI &srcBmBounds = _bitmap.getBounds();
-    const RectI &dstBmBounds = output->_bitmap.getBounds();
     assert( !copyBitMap || usesBitMap() );
-    assert( !usesBitMap() || (srcBmBounds == srcBounds && dstBmBounds == dstBounds) );
+    assert( !usesBitMap() || (_bitmap.getBounds() == srcBounds && output->_bitmap.getBounds() == dstBounds) );
 
     // the srcRoD of the output should be enclosed in half the roi.
     // It does not have to be exactly half of the input.
@@ -1849,36 +2047,42 @@ Image::halveRoIForDepth(const RectI & roi,
     //           dstRoD.height()*2 <= roi.height());
     assert( getComponents() == output->getComponents() );
 
-    RectI dstRoI;
-    RectI srcRoI = roi;
-    srcRoI.intersect(srcBounds, &srcRoI); // intersect srcRoI with the region of definition
-
-    dstRoI.x1 = (srcRoI.x1 + 1) / 2; // equivalent to ceil(srcRoI.x1/2.0)
-    dstRoI.y1 = (srcRoI.y1 + 1) / 2; // equivalent to ceil(srcRoI.y1/2.0)
-    dstRoI.x2 = srcRoI.x2 / 2; // equivalent to floor(srcRoI.x2/2.0)
-    dstRoI.y2 = srcRoI.y2 / 2; // equivalent to floor(srcRoI.y2/2.0)
+    RectI srcRoI;
+    if ( !roi.intersect(srcBounds, &srcRoI) ) { // intersect srcRoI with the region of definition
+        return;
+    }
 
+    // Every dst pixel covering a part of srcRoI is computed. In the interior, the 2x2 src pixels covered by a dst pixel
+    // are all within srcBounds and rows are halved without any bounds check. On the edges, only the src pixels within
+    // srcBounds are averaged.
+    RectI dstRoI;
+    if ( !srcRoI.downscalePowerOfTwoSmallestEnclosing(1).intersect(dstBounds, &dstRoI) ) {
+        return;
+    }
+    RectI interiorRoI;
+    if ( !srcBounds.downscalePowerOfTwoLargestEnclosed(1).intersect(dstRoI, &interiorRoI) ) {
+        interiorRoI.clear();
+    }
 
     const PIX* const srcPixels      = (const PIX*)pixelAt(srcBounds.x1,   srcBounds.y1);
-    const char* const srcBmPixels   = _bitmap.getBitmapAt(srcBmBounds.x1, srcBmBounds.y1);
     PIX* const dstPixels          = (PIX*)output->pixelAt(dstBounds.x1,   dstBounds.y1);
-    char* const dstBmPixels = output->_bitmap.getBitmapAt(dstBmBounds.x1, dstBmBounds.y1);
     int srcRowSize = srcBounds.width() * _nbComponents;
     int dstRowSize = dstBounds.width() * _nbComponents;
 
     // offset pointers so that srcData and dstData correspond to pixel (0,0)
     const PIX* const srcData = srcPixels - (srcBounds.x1 * _nbComponents + srcRowSize * srcBounds.y1);
     PIX* const dstData       = dstPixels - (dstBounds.x1 * _nbComponents + dstRowSize * dstBounds.y1);
-    const int srcBmRowSize = srcBmBounds.width();
-    const int dstBmRowSize = dstBmBounds.width();
-    const char* const srcBmData = srcBmPixels - (srcBmBounds.x1 + srcBmRowSize * srcBmBounds.y1);
-    char* const dstBmData       = dstBmPixels - (dstBmBounds.x1 + dstBmRowSize * dstBmBounds.y1);
 
+    const PixelConvert::InstructionSetEnum set = PixelConvert::getInstructionSet();
     for (int y = dstRoI.y1; y < dstRoI.y2; ++y) {
         const PIX* const srcLineStart    = srcData + y * 2 * srcRowSize;
         PIX* const dstLineStart          = dstData + y     * dstRowSize;
-        const char* const srcBmLineStart = srcBmData + y * 2 * srcBmRowSize;
-        char* const dstBmLineStart       = dstBmData + y     * dstBmRowSize;
+        bool isInteriorRow = interiorRoI.y1 <= y && y < interiorRoI.y2;
+
+        if (isInteriorRow) {
+            halveRow(set, srcLineStart + interiorRoI.x1 * 2 * _nbComponents, srcLineStart + srcRowSize + interiorRoI.x1 * 2 * _nbComponents,
+                     dstLineStart + interiorRoI.x1 * _nbComponents, _nbComponents, interiorRoI.width());
+        }
 
         // The current dst row, at y, covers the src rows y*2 (thisRow) and y*2+1 (nextRow).
         // Check that if are within srcBounds.
@@ -1889,10 +2093,13 @@ Image::halveRoIForDepth(const RectI & roi,
         assert(sumH == 1 || sumH == 2);
 
         for (int x = dstRoI.x1; x < dstRoI.x2; ++x) {
+            if ( isInteriorRow && (x == interiorRoI.x1) ) {
+                // skip the pixels halved above
+                x = interiorRoI.x2 - 1;
+                continue;
+            }
             const PIX* const srcPixStart    = srcLineStart   + x * 2 * _nbComponents;
-            const char* const srcBmPixStart = srcBmLineStart + x * 2;
             PIX* const dstPixStart          = dstLineStart   + x * _nbComponents;
-            char* const dstBmPixStart       = dstBmLineStart + x;
 
             // The current dst col, at y, covers the src cols x*2 (thisCol) and x*2+1 (nextCol).
             // Check that if are within srcBounds.
@@ -1904,16 +2111,6 @@ Image::halveRoIForDepth(const RectI & roi,
             const int sum = sumW * sumH;
             assert(0 < sum && sum <= 4);
 
-            if (sum == 0) { // never happens
-                for (int k = 0; k < _nbComponents; ++k) {
-                    dstPixStart[k] = 0;
-                }
-                if (copyBitMap) {
-                    dstBmPixStart[0] = 0;
-                }
-                continue;
-            }
-
             for (int k = 0; k < _nbComponents; ++k) {
                 ///a b
                 ///c d
@@ -1923,46 +2120,15 @@ Image::halveRoIForDepth(const RectI & roi,
                 const PIX c = (pickThisCol && pickNextRow) ? *(srcPixStart + k + srcRowSize) : 0;
                 const PIX d = (pickNextCol && pickNextRow) ? *(srcPixStart + k + srcRowSize  + _nbComponents)  : 0;
 
-                assert( sumW == 2 || ( sumW == 1 && ( (a == 0 && c == 0) || (b == 0 && d == 0) ) ) );
-                assert( sumH == 2 || ( sumH == 1 && ( (a == 0 && b == 0) || (c == 0 && d == 0) ) ) );
                 dstPixStart[k] = (a + b + c + d) / sum;
             }
-
-            if (copyBitMap) {
-                ///a b
-                ///c d
-
-                char a = (pickThisCol && pickThisRow) ? *(srcBmPixStart) : 0;
-                char b = (pickNextCol && pickThisRow) ? *(srcBmPixStart + 1) : 0;
-                char c = (pickThisCol && pickNextRow) ? *(srcBmPixStart + srcBmRowSize) : 0;
-                char d = (pickNextCol && pickNextRow) ? *(srcBmPixStart + srcBmRowSize  + 1)  : 0;
-#if NATRON_ENABLE_TRIMAP
-                /*
-                   The only correct solution is to convert pixels being rendered to 0 otherwise the caller
-                   would have to wait for the original fullscale image render to be finished and then re-downscale again.
-                 */
-                if (a == PIXEL_UNAVAILABLE) {
-                    a = 0;
-                }
-                if (b == PIXEL_UNAVAILABLE) {
-                    b = 0;
-                }
-                if (c == PIXEL_UNAVAILABLE) {
-                    c = 0;
-                }
-                if (d == PIXEL_UNAVAILABLE) {
-                    d = 0;
-                }
-#endif
-                assert( sumW == 2 || ( sumW == 1 && ( (a == 0 && c == 0) || (b == 0 && d == 0) ) ) );
-                assert( sumH == 2 || ( sumH == 1 && ( (a == 0 && b == 0) || (c == 0 && d == 0) ) ) );
-                assert(a + b + c + d <= sum); // bitmaps are 0 or 1
-                // the following is an integer division, the result can be 0 or 1
-                dstBmPixStart[0] = (a + b + c + d) / sum;
-                assert(dstBmPixStart[0] == 0 || dstBmPixStart[0] == 1);
-            }
         }
     }
+
+    if (copyBitMap) {
+        // a pixel is rendered if all the pixels it covers are rendered
+        output->_bitmap.halveRoI(dstRoI, _bitmap);
+    }
 } // halveRoIForDepth
 
 // code proofread and fixed by @devernay on 8/8/2014
@@ -2088,7 +2254,7 @@ Image::downscaleMipMap(const RectD& dstRod,
 //    roiCanonical.toPixelEnclosing(toLevel, par , &dstRoI);
     unsigned int downscaleLvls = toLevel - fromLevel;
 
-    assert( !copyBitMap || _bitmap.getBitmap() );
+    assert( !copyBitMap || usesBitMap() );
 
     RectI dstRoI  = roi.downscalePowerOfTwoSmallestEnclosing(downscaleLvls);
     ImagePtr tmpImg = boost::make_shared<Image>( getComponents(), dstRod, dstRoI, toLevel, par, getBitDepth(), getPremultiplication(), getFieldingOrder(), true);
@@ -2105,6 +2271,25 @@ Image::downscaleMipMap(const RectD& dstRod,
     output->pasteFrom(*tmpImg, dstRoI, copyBitMap);
 }
 
+void
+Image::halveToNextMipMapLevel(const RectI & roi,
+                              Image* output) const
+{
+    assert(getStorageMode() != eStorageModeGLTex && output->getStorageMode() != eStorageModeGLTex);
+    assert( output->getMipMapLevel() == getMipMapLevel() + 1 );
+    assert( usesBitMap() && output->usesBitMap() );
+
+    RectI srcRoI;
+    if ( !roi.intersect(_bounds, &srcRoI) ) {
+        return;
+    }
+    // halve1DImage does not update the bitmap
+    if ( (srcRoI.width() < 2) || (srcRoI.height() < 2) ) {
+        return;
+    }
+    halveRoI(srcRoI, true, output);
+}
+
 bool
 Image::checkForNaNs(const RectI& roi)
 {
@@ -2324,32 +2509,6 @@ Image::getLevelFromScale(double s)
     return retval;
 }
 
-void
-Image::copyBitmapRowPortion(int x1,
-                            int x2,
-                            int y,
-                            const Image& other)
-{
-    _bitmap.copyRowPortion(x1, x2, y, other._bitmap);
-}
-
-void
-Bitmap::copyRowPortion(int x1,
-                       int x2,
-                       int y,
-                       const Bitmap& other)
-{
-    const char* srcBitmap = other.getBitmapAt(x1, y);
-    char* dstBitmap = getBitmapAt(x1, y);
-    const char* end = dstBitmap + (x2 - x1);
-
-    while (dstBitmap < end) {
-        *dstBitmap = /**srcBitmap == PIXEL_UNAVAILABLE ? 0 : */ *srcBitmap;
-        ++dstBitmap;
-        ++srcBitmap;
-    }
-}
-
 void
 Image::copyBitmapPortion(const RectI& roi,
                          const Image& other)
@@ -2357,32 +2516,6 @@ Image::copyBitmapPortion(const RectI& roi,
     _bitmap.copyBitmapPortion(roi, other._bitmap);
 }
 
-void
-Bitmap::copyBitmapPortion(const RectI& roi,
-                          const Bitmap& other)
-{
-    assert(roi.x1 >= _bounds.x1 && roi.x2 <= _bounds.x2 && roi.y1 >= _bounds.y1 && roi.y2 <= _bounds.y2);
-    assert(roi.x1 >= other._bounds.x1 && roi.x2 <= other._bounds.x2 && roi.y1 >= other._bounds.y1 && roi.y2 <= other._bounds.y2);
-
-    int srcRowSize = other._bounds.width();
-    int dstRowSize = _bounds.width();
-    const char* srcBitmap = other.getBitmapAt(roi.x1, roi.y1);
-    char* dstBitmap = getBitmapAt(roi.x1, roi.y1);
-
-    for (int y = roi.y1; y < roi.y2; ++y,
-         srcBitmap += srcRowSize,
-         dstBitmap += dstRowSize) {
-        const char* srcCur = srcBitmap;
-        const char* srcEnd = srcBitmap + roi.width();
-        char* dstCur = dstBitmap;
-        while (srcCur < srcEnd) {
-            *dstCur = /**srcCur == PIXEL_UNAVAILABLE ? 0 : */ *srcCur;
-            ++srcCur;
-            ++dstCur;
-        }
-    }
-}
-
 template <typename PIX, bool doPremult>
 void
 Image::premultInternal(const RectI& roi)
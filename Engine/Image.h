@@ -64,12 +64,35 @@ public:
     }
 };
 
+/**
+ * @brief The render state of each pixel of an image: 0 (not rendered), 1 (rendered) or 2 (being rendered by another thread,
+ * only with the trimap).
+ *
+ * The states are stored per tile of NATRON_BITMAP_TILE_SIZE x NATRON_BITMAP_TILE_SIZE pixels: a tile whose pixels all share
+ * the same state only stores that state, and the per-pixel states are only allocated for the tiles that are partially rendered,
+ * which are usually the ones on the border of the rendered rectangles. Marking and querying a region thus cost
+ * O(tiles) plus the area of the region that falls in mixed tiles, instead of O(pixels).
+ **/
 class Bitmap
 {
 public:
+
+    /**
+     * @brief Flags of the states returned by getStates()
+     **/
+    enum BitmapStateFlagEnum
+    {
+        eBitmapStateFlagUnrendered = 0x1,
+        eBitmapStateFlagRendered = 0x2,
+        eBitmapStateFlagUnavailable = 0x4
+    };
+
     Bitmap(const RectI & bounds)
-        : _bounds(bounds)
-        , _map( bounds.area() )
+        : _bounds()
+        , _tilesPerRow(0)
+        , _tileStates()
+        , _tilePixels()
+        , _mixedTilesCount(0)
         , _dirtyZone()
         , _dirtyZoneSet(false)
     {
@@ -77,24 +100,21 @@ public:
         // "identities" images (i.e: images that are just a link to another image). See EffectInstance :
         // "!!!Note that if isIdentity is true it will allocate an empty image object with 0 bytes of data."
         //assert(!rod.isNull());
-        std::fill(_map.begin(), _map.end(), 0);
+        initialize(bounds);
     }
 
     Bitmap()
         : _bounds()
-        , _map()
+        , _tilesPerRow(0)
+        , _tileStates()
+        , _tilePixels()
+        , _mixedTilesCount(0)
         , _dirtyZone()
         , _dirtyZoneSet(false)
     {
     }
 
-    void initialize(const RectI & bounds)
-    {
-        _bounds = bounds;
-        _map.resize( _bounds.area() );
-
-        std::fill(_map.begin(), _map.end(), 0);
-    }
+    void initialize(const RectI & bounds);
 
     ~Bitmap()
     {
@@ -102,7 +122,7 @@ public:
 
     void setTo1()
     {
-        std::fill(_map.begin(), _map.end(), 1);
+        markFor(_bounds, 1);
     }
 
     const RectI & getBounds() const
@@ -133,22 +153,28 @@ public:
 
     void swap(Bitmap& other);
 
-    const char* getBitmap() const
-    {
-        return &_map.front();
-    }
+    /**
+     * @brief Returns the union of the BitmapStateFlagEnum of the pixels in roi. Returns 0 if roi does not intersect the bounds.
+     **/
+    int getStates(const RectI& roi) const;
 
-    char* getBitmap()
-    {
-        return &_map.front();
-    }
+    /**
+     * @brief Returns the state of the pixel (x, y), which must be in the bounds.
+     **/
+    char getStateAt(int x, int y) const;
 
-    const char* getBitmapAt(int x, int y) const;
-    char* getBitmapAt(int x, int y);
+    void copyBitmapPortion(const RectI& roi, const Bitmap& other);
 
-    void copyRowPortion(int x1, int x2, int y, const Bitmap& other);
+    /**
+     * @brief Marks the pixels of dstRoI as rendered if all the pixels of src they cover at twice their scale are rendered,
+     * or as not rendered otherwise (pixels being rendered in src are considered not rendered).
+     **/
+    void halveRoI(const RectI& dstRoI, const Bitmap& src);
 
-    void copyBitmapPortion(const RectI& roi, const Bitmap& other);
+    /**
+     * @brief The number of bytes used to store the states
+     **/
+    std::size_t getMemorySize() const;
 
     void setDirtyZone(const RectI& zone)
     {
@@ -159,9 +185,24 @@ public:
 private:
     void markFor(const RectI & roi, char value);
 
+    RectI getTileRect(int tx, int ty) const;
+
+    void markTileFor(int tileIndex, const RectI& tileRect, const RectI& roi, char value);
+
+    char* getMixedTilePixels(int tileIndex);
+
+    void collapseTileIfUniform(int tileIndex, const RectI& tileRect);
+
 private:
     RectI _bounds;
-    std::vector<char> _map;
+    int _tilesPerRow;
+
+    // For each tile, the state of all its pixels, or -1 if the pixels do not all have the same state
+    std::vector<char> _tileStates;
+
+    // For each tile whose pixels do not all have the same state, the state of each of its pixels (empty for the other tiles)
+    std::vector<std::vector<char> > _tilePixels;
+    int _mixedTilesCount;
 
     /**
      * This represents the zone that has potentially something to render. In minimalNonMarkedRects
@@ -303,7 +344,7 @@ public:
         std::size_t dt = dataSize();
         bool got = _entryLock.tryLockForRead();
 
-        dt += _bitmap.getBounds().area();
+        dt += _bitmap.getMemorySize();
         if (got) {
             _entryLock.unlock();
         }
@@ -410,14 +451,6 @@ public:
 
             return img->pixelAt(x, y);
         }
-
-        const char* bitmapAt(int x,
-                             int y) const
-        {
-            assert(img);
-
-            return img->getBitmapAt(x, y);
-        }
     };
 
     typedef boost::shared_ptr<ReadAccess> ReadAccessPtr;
@@ -462,14 +495,6 @@ public:
         {
             return img->pixelAt(x, y);
         }
-
-        char* bitmapAt(int x,
-                       int y) const
-        {
-            assert(img);
-
-            return img->getBitmapAt(x, y);
-        }
     };
 
     typedef boost::shared_ptr<WriteAccess> WriteAccessPtr;
@@ -496,18 +521,6 @@ private:
      * of an image.
      **/
 
-    const char* getBitmapAt(int x,
-                            int y) const
-    {
-        return this->_bitmap.getBitmapAt(x, y);
-    }
-
-    char* getBitmapAt(int x,
-                      int y)
-    {
-        return this->_bitmap.getBitmapAt(x, y);
-    }
-
     /**
      * @brief Access pixels. The pointer must be cast to the appropriate type afterwards.
      **/
@@ -762,6 +775,14 @@ public:
                          bool copyBitMap,
                          Image* output) const;
 
+    /**
+     * @brief Halves the given portion of this image into output, which must be at the next mipmap level
+     * and use a bitmap. This is used to build the mipmap pyramid of a rendered image level by level.
+     * The bitmap of output is updated too: a pixel is marked rendered if all the pixels it covers are rendered.
+     * Portions narrower than 2 pixels are left untouched.
+     **/
+    void halveToNextMipMapLevel(const RectI & roi, Image* output) const;
+
     /**
      * @brief Upscales a portion of this image into output.
      * If the upscaled roi does not fit into output's bounds, it is cropped first.
@@ -881,8 +902,6 @@ public:
      */
     bool checkForNaNs(const RectI& roi) WARN_UNUSED_RETURN;
 
-    void copyBitmapRowPortion(int x1, int x2, int y, const Image& other);
-
     void copyBitmapPortion(const RectI& roi, const Image& other);
 
     template <typename PIX>
@@ -27,6 +27,7 @@
 
 #include <algorithm> // min, max
 #include <cassert>
+#include <cstring> // for std::memcpy
 #include <stdexcept>
 
 #ifndef Q_MOC_RUN
@@ -39,6 +40,7 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 
 #include "Engine/AppManager.h"
 #include "Engine/Lut.h"
+#include "Engine/PixelConvert.h"
 
 NATRON_NAMESPACE_ENTER
 
@@ -133,6 +135,84 @@ lutFromColorspace(ViewerColorSpaceEnum cs)
     return lut;
 }
 
+///Converts a row of n samples between bit depths without colorspace conversion.
+///This computes exactly what convertPixelDepth does, using the SIMD kernels when possible.
+static void
+convertRowDepth(const unsigned char* src,
+                unsigned char* dst,
+                int n)
+{
+    std::memcpy( dst, src, n * sizeof(unsigned char) );
+}
+
+static void
+convertRowDepth(const unsigned char* src,
+                unsigned short* dst,
+                int n)
+{
+    for (int i = 0; i < n; ++i) {
+        dst[i] = Color::charToUint16(src[i]);
+    }
+}
+
+static void
+convertRowDepth(const unsigned char* src,
+                float* dst,
+                int n)
+{
+    PixelConvert::convertByteToFloat(src, dst, n);
+}
+
+static void
+convertRowDepth(const unsigned short* src,
+                unsigned char* dst,
+                int n)
+{
+    for (int i = 0; i < n; ++i) {
+        dst[i] = Color::uint16ToChar(src[i]);
+    }
+}
+
+static void
+convertRowDepth(const unsigned short* src,
+                unsigned short* dst,
+                int n)
+{
+    std::memcpy( dst, src, n * sizeof(unsigned short) );
+}
+
+static void
+convertRowDepth(const unsigned short* src,
+                float* dst,
+                int n)
+{
+    PixelConvert::convertShortToFloat(src, dst, n);
+}
+
+static void
+convertRowDepth(const float* src,
+                unsigned char* dst,
+                int n)
+{
+    PixelConvert::convertFloatToByte(src, dst, n);
+}
+
+static void
+convertRowDepth(const float* src,
+                unsigned short* dst,
+                int n)
+{
+    PixelConvert::convertFloatToShort(src, dst, n);
+}
+
+static void
+convertRowDepth(const float* src,
+                float* dst,
+                int n)
+{
+    std::memcpy( dst, src, n * sizeof(float) );
+}
+
 ///Fast version when components are the same
 template <typename SRCPIX, typename DSTPIX, int srcMaxValue, int dstMaxValue>
 void
@@ -163,6 +243,25 @@ Image::convertToFormatInternal_sameComps(const RectI & renderWindow,
     if ( intersection.isNull() ) {
         return;
     }
+    if (copyBitmap) {
+        dstImg.copyBitmapPortion(intersection, srcImg);
+    }
+    if (!srcLut && !dstLut) {
+        ///No colorspace conversion and no error diffusion: this is a plain bit depth conversion of each row
+        const int rowElements = intersection.width() * nComp;
+        for (int y = intersection.y1; y < intersection.y2; ++y) {
+            const SRCPIX* srcPixels = (const SRCPIX*)srcImg.pixelAt(intersection.x1, y);
+            DSTPIX* dstPixels = (DSTPIX*)dstImg.pixelAt(intersection.x1, y);
+            convertRowDepth(srcPixels, dstPixels, rowElements);
+#         ifdef DEBUG
+            for (int i = 0; i < rowElements; ++i) {
+                assert( !(boost::math::isnan)(srcPixels[i]) ); // check for NaN
+            }
+#         endif
+        }
+
+        return;
+    }
     for (int y = 0; y < intersection.height(); ++y) {
         // coverity[dont_call]
         int start = rand() % intersection.width();
@@ -236,9 +335,6 @@ Image::convertToFormatInternal_sameComps(const RectI & renderWindow,
             dstPixels = dstStart - nComp;
         }
 
-        if (copyBitmap) {
-            dstImg.copyBitmapRowPortion(intersection.x1, intersection.x2, intersection.y1 + y, srcImg);
-        }
     }
 } // convertToFormatInternal_sameComps
 
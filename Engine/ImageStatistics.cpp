@@ -0,0 +1,681 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ * Copyright (C) 2018-2020 The Natron developers
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "ImageStatistics.h"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <list>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+#endif
+
+#include <QtCore/QMutex>
+#include <QtConcurrentMap> // QtCore on Qt4, QtConcurrent on Qt5
+
+#include "Global/GlobalDefines.h"
+
+#include "Engine/AppManager.h"
+#include "Engine/Image.h"
+#include "Engine/PixelConvert.h"
+
+#ifdef NATRON_PIXEL_CONVERT_X86_SIMD
+#include <immintrin.h>
+#define NATRON_TARGET_SSE41 __attribute__( ( target("sse4.1") ) )
+#define NATRON_TARGET_AVX2 __attribute__( ( target("avx2") ) )
+#endif
+
+// Number of statistics kept in the cache: the viewer has at most 2 inputs displayed, and the Histogram panel
+// usually looks at the same images.
+#define NATRON_IMAGE_STATISTICS_CACHE_SIZE 8
+
+NATRON_NAMESPACE_ENTER
+
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+/**
+ * @brief The state of the reduction passed to the row kernels.
+ * All kernels compute exactly the same minimums, maximums and histograms, only the sums may differ
+ * because they are not added in the same order.
+ **/
+struct RowAccumulator
+{
+    float min[ImageStatistics::eChannelCount];
+    float max[ImageStatistics::eChannelCount];
+    double sum[ImageStatistics::eChannelA + 1];
+    int binsCount;
+    float histogramMin, histogramMax, binSize;
+    unsigned int* histograms; // NULL if there are no histograms
+};
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+///////////////////////
+/////////////////////////////////////////// SCALAR //////////////////////////////////////////////
+///////////////////////
+
+// Computed in float and without fused multiply-add, as the SIMD kernels do
+static inline float
+luminance(float r,
+          float g,
+          float b)
+{
+    return 0.299f * r + 0.587f * g + 0.114f * b;
+}
+
+static inline void
+binValue(RowAccumulator* acc,
+         int channel,
+         float v)
+{
+    if ( (acc->histogramMin <= v) && (v < acc->histogramMax) ) {
+        int index = (int)( (v - acc->histogramMin) / acc->binSize );
+        // rounding may give binsCount for values right below histogramMax
+        if (index > acc->binsCount - 1) {
+            index = acc->binsCount - 1;
+        }
+        ++acc->histograms[channel * acc->binsCount + index];
+    }
+}
+
+static inline void
+accumulatePixel(RowAccumulator* acc,
+                float r,
+                float g,
+                float b,
+                float a)
+{
+    const float values[ImageStatistics::eChannelCount] = { r, g, b, a, luminance(r, g, b) };
+
+    // same as _mm_min_ps(v, min) and _mm_max_ps(v, max): NaNs are ignored
+    for (int c = 0; c < ImageStatistics::eChannelCount; ++c) {
+        acc->min[c] = values[c] < acc->min[c] ? values[c] : acc->min[c];
+        acc->max[c] = values[c] > acc->max[c] ? values[c] : acc->max[c];
+    }
+    for (int c = 0; c <= ImageStatistics::eChannelA; ++c) {
+        acc->sum[c] += values[c];
+    }
+    if (acc->histograms) {
+        for (int c = 0; c < ImageStatistics::eChannelCount; ++c) {
+            binValue(acc, c, values[c]);
+        }
+    }
+}
+
+static void
+accumulateRowScalar(RowAccumulator* acc,
+                    const float* src,
+                    int nComps,
+                    int width)
+{
+    for (int x = 0; x < width; ++x, src += nComps) {
+        switch (nComps) {
+        case 4:
+            accumulatePixel(acc, src[0], src[1], src[2], src[3]);
+            break;
+        case 3:
+            accumulatePixel(acc, src[0], src[1], src[2], 1.f);
+            break;
+        case 2:
+            accumulatePixel(acc, src[0], src[1], 0.f, 1.f);
+            break;
+        case 1:
+            accumulatePixel(acc, 0.f, 0.f, 0.f, src[0]);
+            break;
+        default:
+            accumulatePixel(acc, 0.f, 0.f, 0.f, 0.f);
+            break;
+        }
+    }
+}
+
+#ifdef NATRON_PIXEL_CONVERT_X86_SIMD
+
+///////////////////////
+/////////////////////////////////////////// SSE4.1 //////////////////////////////////////////////
+///////////////////////
+
+// Bins the 4 lanes of v, the bin of each lane being offset by the lane offset (i.e. the first bin of its channel)
+NATRON_TARGET_SSE41 static inline void
+binSSE41(RowAccumulator* acc,
+         __m128 v,
+         __m128 histogramMin,
+         __m128 histogramMax,
+         __m128 binSize,
+         __m128i lastBin,
+         __m128i laneOffsets)
+{
+    int inRange = _mm_movemask_ps( _mm_and_ps( _mm_cmple_ps(histogramMin, v), _mm_cmplt_ps(v, histogramMax) ) );
+
+    if (!inRange) {
+        return;
+    }
+    __m128i index = _mm_min_epi32( _mm_cvttps_epi32( _mm_div_ps(_mm_sub_ps(v, histogramMin), binSize) ), lastBin );
+    int indices[4];
+    _mm_storeu_si128( (__m128i*)indices, _mm_add_epi32(index, laneOffsets) );
+    for (int i = 0; i < 4; ++i) {
+        if ( inRange & (1 << i) ) {
+            ++acc->histograms[indices[i]];
+        }
+    }
+}
+
+// 4 RGBA pixels per iteration: the RGBA minimums, maximums and sums are reduced on the pixels themselves,
+// the pixels are transposed to compute the luminance of 4 pixels at once.
+NATRON_TARGET_SSE41 static void
+accumulateRowRGBASSE41(RowAccumulator* acc,
+                       const float* src,
+                       int width)
+{
+    const __m128 kr = _mm_set1_ps(0.299f);
+    const __m128 kg = _mm_set1_ps(0.587f);
+    const __m128 kb = _mm_set1_ps(0.114f);
+    const __m128 histogramMin = _mm_set1_ps(acc->histogramMin);
+    const __m128 histogramMax = _mm_set1_ps(acc->histogramMax);
+    const __m128 binSize = _mm_set1_ps(acc->binSize);
+    const __m128i lastBin = _mm_set1_epi32(acc->binsCount - 1);
+    const __m128i pixelOffsets = _mm_setr_epi32(0, acc->binsCount, acc->binsCount * 2, acc->binsCount * 3);
+    const __m128i lumOffsets = _mm_set1_epi32(acc->binsCount * ImageStatistics::eChannelY);
+    __m128 vmin = _mm_loadu_ps(acc->min);
+    __m128 vmax = _mm_loadu_ps(acc->max);
+    __m128 ymin = _mm_set1_ps(acc->min[ImageStatistics::eChannelY]);
+    __m128 ymax = _mm_set1_ps(acc->max[ImageStatistics::eChannelY]);
+    __m128d sumRG = _mm_setzero_pd();
+    __m128d sumBA = _mm_setzero_pd();
+    int x = 0;
+
+    for (; x + 4 <= width; x += 4, src += 16) {
+        __m128 p[4];
+        for (int i = 0; i < 4; ++i) {
+            p[i] = _mm_loadu_ps(src + i * 4);
+            vmin = _mm_min_ps(p[i], vmin);
+            vmax = _mm_max_ps(p[i], vmax);
+            sumRG = _mm_add_pd( sumRG, _mm_cvtps_pd(p[i]) );
+            sumBA = _mm_add_pd( sumBA, _mm_cvtps_pd( _mm_movehl_ps(p[i], p[i]) ) );
+        }
+        __m128 r = p[0], g = p[1], b = p[2], a = p[3];
+        _MM_TRANSPOSE4_PS(r, g, b, a);
+        __m128 y = _mm_add_ps( _mm_add_ps( _mm_mul_ps(kr, r), _mm_mul_ps(kg, g) ), _mm_mul_ps(kb, b) );
+        ymin = _mm_min_ps(y, ymin);
+        ymax = _mm_max_ps(y, ymax);
+        if (acc->histograms) {
+            for (int i = 0; i < 4; ++i) {
+                binSSE41(acc, p[i], histogramMin, histogramMax, binSize, lastBin, pixelOffsets);
+            }
+            binSSE41(acc, y, histogramMin, histogramMax, binSize, lastBin, lumOffsets);
+        }
+    }
+
+    _mm_storeu_ps(acc->min, vmin);
+    _mm_storeu_ps(acc->max, vmax);
+    float ymins[4], ymaxs[4];
+    _mm_storeu_ps(ymins, ymin);
+    _mm_storeu_ps(ymaxs, ymax);
+    float& yminAcc = acc->min[ImageStatistics::eChannelY];
+    float& ymaxAcc = acc->max[ImageStatistics::eChannelY];
+    for (int i = 0; i < 4; ++i) {
+        yminAcc = ymins[i] < yminAcc ? ymins[i] : yminAcc;
+        ymaxAcc = ymaxs[i] > ymaxAcc ? ymaxs[i] : ymaxAcc;
+    }
+    double sums[4];
+    _mm_storeu_pd(sums, sumRG);
+    _mm_storeu_pd(sums + 2, sumBA);
+    for (int c = 0; c < 4; ++c) {
+        acc->sum[c] += sums[c];
+    }
+
+    accumulateRowScalar(acc, src, 4, width - x);
+} // accumulateRowRGBASSE41
+
+///////////////////////
+/////////////////////////////////////////// AVX2 //////////////////////////////////////////////
+///////////////////////
+
+NATRON_TARGET_AVX2 static inline void
+binAVX2(RowAccumulator* acc,
+        __m256 v,
+        __m256 histogramMin,
+        __m256 histogramMax,
+        __m256 binSize,
+        __m256i lastBin,
+        __m256i laneOffsets)
+{
+    int inRange = _mm256_movemask_ps( _mm256_and_ps( _mm256_cmp_ps(histogramMin, v, _CMP_LE_OQ), _mm256_cmp_ps(v, histogramMax, _CMP_LT_OQ) ) );
+
+    if (!inRange) {
+        return;
+    }
+    __m256i index = _mm256_min_epi32( _mm256_cvttps_epi32( _mm256_div_ps(_mm256_sub_ps(v, histogramMin), binSize) ), lastBin );
+    int indices[8];
+    _mm256_storeu_si256( (__m256i*)indices, _mm256_add_epi32(index, laneOffsets) );
+    for (int i = 0; i < 8; ++i) {
+        if ( inRange & (1 << i) ) {
+            ++acc->histograms[indices[i]];
+        }
+    }
+}
+
+// Same as accumulateRowRGBASSE41 on 8 pixels per iteration, each 256-bit register holding 2 pixels.
+// The transposition is done within each 128-bit lane, so the luminance lanes are not in the pixels order,
+// which does not matter for a reduction.
+NATRON_TARGET_AVX2 static void
+accumulateRowRGBAAVX2(RowAccumulator* acc,
+                      const float* src,
+                      int width)
+{
+    const __m256 kr = _mm256_set1_ps(0.299f);
+    const __m256 kg = _mm256_set1_ps(0.587f);
+    const __m256 kb = _mm256_set1_ps(0.114f);
+    const __m256 histogramMin = _mm256_set1_ps(acc->histogramMin);
+    const __m256 histogramMax = _mm256_set1_ps(acc->histogramMax);
+    const __m256 binSize = _mm256_set1_ps(acc->binSize);
+    const __m256i lastBin = _mm256_set1_epi32(acc->binsCount - 1);
+    const int n = acc->binsCount;
+    const __m256i pixelOffsets = _mm256_setr_epi32(0, n, n * 2, n * 3, 0, n, n * 2, n * 3);
+    const __m256i lumOffsets = _mm256_set1_epi32(n * ImageStatistics::eChannelY);
+    const __m128 rgbaMin = _mm_loadu_ps(acc->min);
+    const __m128 rgbaMax = _mm_loadu_ps(acc->max);
+    __m256 vmin = _mm256_insertf128_ps(_mm256_castps128_ps256(rgbaMin), rgbaMin, 1);
+    __m256 vmax = _mm256_insertf128_ps(_mm256_castps128_ps256(rgbaMax), rgbaMax, 1);
+    __m256 ymin = _mm256_set1_ps(acc->min[ImageStatistics::eChannelY]);
+    __m256 ymax = _mm256_set1_ps(acc->max[ImageStatistics::eChannelY]);
+    __m256d sum = _mm256_setzero_pd();
+    int x = 0;
+
+    for (; x + 8 <= width; x += 8, src += 32) {
+        __m256 p[4];
+        for (int i = 0; i < 4; ++i) {
+            p[i] = _mm256_loadu_ps(src + i * 8);
+            vmin = _mm256_min_ps(p[i], vmin);
+            vmax = _mm256_max_ps(p[i], vmax);
+            sum = _mm256_add_pd( sum, _mm256_cvtps_pd( _mm256_castps256_ps128(p[i]) ) );
+            sum = _mm256_add_pd( sum, _mm256_cvtps_pd( _mm256_extractf128_ps(p[i], 1) ) );
+        }
+        __m256 t0 = _mm256_unpacklo_ps(p[0], p[1]);
+        __m256 t1 = _mm256_unpackhi_ps(p[0], p[1]);
+        __m256 t2 = _mm256_unpacklo_ps(p[2], p[3]);
+        __m256 t3 = _mm256_unpackhi_ps(p[2], p[3]);
+        __m256 r = _mm256_shuffle_ps( t0, t2, _MM_SHUFFLE(1, 0, 1, 0) );
+        __m256 g = _mm256_shuffle_ps( t0, t2, _MM_SHUFFLE(3, 2, 3, 2) );
+        __m256 b = _mm256_shuffle_ps( t1, t3, _MM_SHUFFLE(1, 0, 1, 0) );
+        __m256 y = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps(kr, r), _mm256_mul_ps(kg, g) ), _mm256_mul_ps(kb, b) );
+        ymin = _mm256_min_ps(y, ymin);
+        ymax = _mm256_max_ps(y, ymax);
+        if (acc->histograms) {
+            for (int i = 0; i < 4; ++i) {
+                binAVX2(acc, p[i], histogramMin, histogramMax, binSize, lastBin, pixelOffsets);
+            }
+            binAVX2(acc, y, histogramMin, histogramMax, binSize, lastBin, lumOffsets);
+        }
+    }
+
+    _mm_storeu_ps( acc->min, _mm_min_ps( _mm256_extractf128_ps(vmin, 1), _mm256_castps256_ps128(vmin) ) );
+    _mm_storeu_ps( acc->max, _mm_max_ps( _mm256_extractf128_ps(vmax, 1), _mm256_castps256_ps128(vmax) ) );
+    float ymins[8], ymaxs[8];
+    _mm256_storeu_ps(ymins, ymin);
+    _mm256_storeu_ps(ymaxs, ymax);
+    float& yminAcc = acc->min[ImageStatistics::eChannelY];
+    float& ymaxAcc = acc->max[ImageStatistics::eChannelY];
+    for (int i = 0; i < 8; ++i) {
+        yminAcc = ymins[i] < yminAcc ? ymins[i] : yminAcc;
+        ymaxAcc = ymaxs[i] > ymaxAcc ? ymaxs[i] : ymaxAcc;
+    }
+    double sums[4];
+    _mm256_storeu_pd(sums, sum);
+    for (int c = 0; c < 4; ++c) {
+        acc->sum[c] += sums[c];
+    }
+
+    accumulateRowScalar(acc, src, 4, width - x);
+} // accumulateRowRGBAAVX2
+
+#endif // NATRON_PIXEL_CONVERT_X86_SIMD
+
+///////////////////////
+/////////////////////////////////////////// ImageStatistics //////////////////////////////////////////////
+///////////////////////
+
+ImageStatistics::ImageStatistics(int binsCount,
+                                 double histogramMin,
+                                 double histogramMax)
+    : _pixelsCount(0)
+    , _binsCount(binsCount > 0 ? binsCount : 0)
+    , _histogramMin(histogramMin)
+    , _histogramMax(histogramMax)
+    , _histograms()
+{
+    assert(binsCount <= 0 || histogramMin < histogramMax);
+    for (int c = 0; c < eChannelCount; ++c) {
+        _min[c] = std::numeric_limits<float>::infinity();
+        _max[c] = -std::numeric_limits<float>::infinity();
+    }
+    for (int c = 0; c <= eChannelA; ++c) {
+        _sum[c] = 0.;
+    }
+    if (_binsCount > 0) {
+        _histograms.resize(_binsCount * eChannelCount, 0);
+    }
+}
+
+void
+ImageStatistics::accumulateRow(const float* pixels,
+                               int nComps,
+                               int width)
+{
+    if (width <= 0) {
+        return;
+    }
+    assert(pixels);
+
+    RowAccumulator acc;
+    std::copy(_min, _min + eChannelCount, acc.min);
+    std::copy(_max, _max + eChannelCount, acc.max);
+    std::copy(_sum, _sum + eChannelA + 1, acc.sum);
+    acc.binsCount = _binsCount;
+    acc.histogramMin = (float)_histogramMin;
+    acc.histogramMax = (float)_histogramMax;
+    acc.binSize = _binsCount > 0 ? (float)( (_histogramMax - _histogramMin) / _binsCount ) : 1.f;
+    acc.histograms = _binsCount > 0 ? &_histograms[0] : 0;
+
+    // only RGBA pixels, which is what the viewer renders, have SIMD kernels
+    PixelConvert::InstructionSetEnum set = nComps == 4 ? PixelConvert::getInstructionSet() : PixelConvert::eInstructionSetScalar;
+    switch (set) {
+#ifdef NATRON_PIXEL_CONVERT_X86_SIMD
+    case PixelConvert::eInstructionSetAVX2:
+        accumulateRowRGBAAVX2(&acc, pixels, width);
+        break;
+    case PixelConvert::eInstructionSetSSE41:
+        accumulateRowRGBASSE41(&acc, pixels, width);
+        break;
+#endif
+    default:
+        accumulateRowScalar(&acc, pixels, nComps, width);
+        break;
+    }
+
+    std::copy(acc.min, acc.min + eChannelCount, _min);
+    std::copy(acc.max, acc.max + eChannelCount, _max);
+    std::copy(acc.sum, acc.sum + eChannelA + 1, _sum);
+    _pixelsCount += width;
+}
+
+void
+ImageStatistics::merge(const ImageStatistics& other)
+{
+    assert(other._binsCount == _binsCount && other._histogramMin == _histogramMin && other._histogramMax == _histogramMax);
+    for (int c = 0; c < eChannelCount; ++c) {
+        _min[c] = other._min[c] < _min[c] ? other._min[c] : _min[c];
+        _max[c] = other._max[c] > _max[c] ? other._max[c] : _max[c];
+    }
+    for (int c = 0; c <= eChannelA; ++c) {
+        _sum[c] += other._sum[c];
+    }
+    if ( _histograms.size() == other._histograms.size() ) {
+        for (std::size_t i = 0; i < _histograms.size(); ++i) {
+            _histograms[i] += other._histograms[i];
+        }
+    }
+    _pixelsCount += other._pixelsCount;
+}
+
+double
+ImageStatistics::getMin(ChannelEnum channel) const
+{
+    assert(0 <= channel && channel < eChannelCount);
+
+    return _min[channel];
+}
+
+double
+ImageStatistics::getMax(ChannelEnum channel) const
+{
+    assert(0 <= channel && channel < eChannelCount);
+
+    return _max[channel];
+}
+
+double
+ImageStatistics::getMean(ChannelEnum channel) const
+{
+    assert(0 <= channel && channel < eChannelCount);
+    if (_pixelsCount == 0) {
+        return 0.;
+    }
+    if (channel == eChannelY) {
+        // the luminance is linear in R, G and B
+        return ( 0.299 * _sum[eChannelR] + 0.587 * _sum[eChannelG] + 0.114 * _sum[eChannelB] ) / _pixelsCount;
+    }
+
+    return _sum[channel] / _pixelsCount;
+}
+
+void
+ImageStatistics::getDisplayRange(DisplayChannelsEnum channels,
+                                 double* vmin,
+                                 double* vmax) const
+{
+    assert(vmin && vmax);
+    switch (channels) {
+    case eDisplayChannelsRGB:
+        *vmin = std::min( std::min(_min[eChannelR], _min[eChannelG]), _min[eChannelB] );
+        *vmax = std::max( std::max(_max[eChannelR], _max[eChannelG]), _max[eChannelB] );
+        break;
+    case eDisplayChannelsY:
+        *vmin = _min[eChannelY];
+        *vmax = _max[eChannelY];
+        break;
+    case eDisplayChannelsR:
+        *vmin = _min[eChannelR];
+        *vmax = _max[eChannelR];
+        break;
+    case eDisplayChannelsG:
+        *vmin = _min[eChannelG];
+        *vmax = _max[eChannelG];
+        break;
+    case eDisplayChannelsB:
+        *vmin = _min[eChannelB];
+        *vmax = _max[eChannelB];
+        break;
+    case eDisplayChannelsA:
+        *vmin = _min[eChannelA];
+        *vmax = _max[eChannelA];
+        break;
+    default:
+        *vmin = 0.;
+        *vmax = 0.;
+        break;
+    }
+}
+
+std::vector<unsigned int>
+ImageStatistics::getHistogram(ChannelEnum channel) const
+{
+    assert(0 <= channel && channel < eChannelCount);
+    if (_binsCount == 0) {
+        return std::vector<unsigned int>();
+    }
+    std::vector<unsigned int>::const_iterator first = _histograms.begin() + channel * _binsCount;
+
+    return std::vector<unsigned int>(first, first + _binsCount);
+}
+
+///////////////////////
+/////////////////////////////////////////// CACHE //////////////////////////////////////////////
+///////////////////////
+
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+/**
+ * @brief Identifies the pixels the statistics were computed on. The hash key of an image does not depend on
+ * its layer, mipmap level and bit depth, which must be compared as well.
+ **/
+struct ImageStatisticsKey
+{
+    U64 hash;
+    ImagePlaneDesc components;
+    unsigned int mipMapLevel;
+    ImageBitDepthEnum bitDepth;
+    RectI rect;
+
+    ImageStatisticsKey(const ImagePtr& image,
+                       const RectI& rect)
+        : hash( image->getHashKey() )
+        , components( image->getComponents() )
+        , mipMapLevel( image->getMipMapLevel() )
+        , bitDepth( image->getBitDepth() )
+        , rect(rect)
+    {
+    }
+
+    bool operator==(const ImageStatisticsKey& other) const
+    {
+        return hash == other.hash && components == other.components && mipMapLevel == other.mipMapLevel &&
+               bitDepth == other.bitDepth && rect == other.rect;
+    }
+};
+
+struct CachedImageStatistics
+{
+    ImageStatisticsKey key;
+    ImageStatisticsConstPtr stats;
+
+    CachedImageStatistics(const ImageStatisticsKey& key,
+                          const ImageStatisticsConstPtr& stats)
+        : key(key)
+        , stats(stats)
+    {
+    }
+};
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+static QMutex g_cacheMutex;
+// most recently used first
+static std::list<CachedImageStatistics> g_cache;
+
+static ImageStatistics
+computeRectStatistics(const ImagePtr& image,
+                      const RectI& rect,
+                      int binsCount,
+                      double histogramMin,
+                      double histogramMax)
+{
+    ImageStatistics ret(binsCount, histogramMin, histogramMax);
+    int nComps = (int)image->getComponentsCount();
+    Image::ReadAccess acc = image->getReadRights();
+
+    for (int y = rect.bottom(); y < rect.top(); ++y) {
+        ret.accumulateRow( (const float*)acc.pixelAt(rect.left(), y), nComps, rect.width() );
+    }
+
+    return ret;
+}
+
+ImageStatisticsConstPtr
+ImageStatistics::compute(const ImagePtr& image,
+                         const RectI& rect,
+                         int binsCount,
+                         double histogramMin,
+                         double histogramMax,
+                         bool multiThreaded)
+{
+    assert(image);
+    ///Images come from the viewer which is in float.
+    assert(image->getBitDepth() == eImageBitDepthFloat);
+
+    RectI roi;
+    if ( !rect.intersect(image->getBounds(), &roi) ) {
+        return boost::make_shared<ImageStatistics>(binsCount, histogramMin, histogramMax);
+    }
+
+    const ImageStatisticsKey key(image, roi);
+    {
+        QMutexLocker k(&g_cacheMutex);
+        for (std::list<CachedImageStatistics>::iterator it = g_cache.begin(); it != g_cache.end(); ++it) {
+            if ( !(it->key == key) ) {
+                continue;
+            }
+            // statistics with histograms can answer a request without histograms, but not the converse
+            const ImageStatistics& cached = *it->stats;
+            if ( (binsCount <= 0) ||
+                 ( ( cached.getHistogramBinsCount() == binsCount) && ( cached.getHistogramMin() == histogramMin) && ( cached.getHistogramMax() == histogramMax) ) ) {
+                g_cache.splice(g_cache.begin(), g_cache, it);
+
+                return g_cache.front().stats;
+            }
+        }
+    }
+
+    boost::shared_ptr<ImageStatistics> stats;
+    if (multiThreaded) {
+        std::vector<RectI> splitRects = roi.splitIntoSmallerRects( appPTR->getMaxThreadCount() );
+        QFuture<ImageStatistics> future = QtConcurrent::mapped( splitRects,
+                                                                boost::bind(computeRectStatistics,
+                                                                            image,
+                                                                            _1,
+                                                                            binsCount,
+                                                                            histogramMin,
+                                                                            histogramMax) );
+        future.waitForFinished();
+        stats = boost::make_shared<ImageStatistics>(binsCount, histogramMin, histogramMax);
+        QList<ImageStatistics> results = future.results();
+        Q_FOREACH(const ImageStatistics &partial, results) {
+            stats->merge(partial);
+        }
+    } else {
+        stats = boost::make_shared<ImageStatistics>( computeRectStatistics(image, roi, binsCount, histogramMin, histogramMax) );
+    }
+
+    {
+        QMutexLocker k(&g_cacheMutex);
+        // the new statistics replace the ones of the same pixels, which had no or other histograms
+        for (std::list<CachedImageStatistics>::iterator it = g_cache.begin(); it != g_cache.end(); ) {
+            if (it->key == key) {
+                it = g_cache.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        g_cache.push_front( CachedImageStatistics(key, stats) );
+        while (g_cache.size() > NATRON_IMAGE_STATISTICS_CACHE_SIZE) {
+            g_cache.pop_back();
+        }
+    }
+
+    return stats;
+} // compute
+
+void
+ImageStatistics::clearCache()
+{
+    QMutexLocker k(&g_cacheMutex);
+
+    g_cache.clear();
+}
+
+NATRON_NAMESPACE_EXIT
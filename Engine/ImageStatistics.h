@@ -0,0 +1,158 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ * Copyright (C) 2018-2020 The Natron developers
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_IMAGESTATISTICS_H
+#define NATRON_ENGINE_IMAGESTATISTICS_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <cstddef>
+#include <vector>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/shared_ptr.hpp>
+#endif
+
+#include "Global/Enums.h"
+
+#include "Engine/RectI.h"
+#include "Engine/EngineFwd.h"
+
+NATRON_NAMESPACE_ENTER
+
+/**
+ * @brief Per-channel statistics of a float image: minimum, maximum, mean and optionally a histogram
+ * of each of the R, G, B, A and luminance channels, all computed in a single pass over the pixels.
+ * This is shared by the viewer auto-contrast and the Histogram panel, which used to read the same image twice.
+ * The row kernel has SSE4.1 and AVX2 implementations selected like the PixelConvert kernels.
+ **/
+class ImageStatistics
+{
+public:
+
+    enum ChannelEnum
+    {
+        eChannelR = 0,
+        eChannelG,
+        eChannelB,
+        eChannelA,
+        eChannelY,
+        eChannelCount
+    };
+
+    /**
+     * @brief Empty statistics. If binsCount is greater than 0, the histogram of each channel has binsCount bins
+     * of equal size covering [histogramMin, histogramMax[. Values outside of this range are not counted.
+     **/
+    ImageStatistics(int binsCount = 0,
+                    double histogramMin = 0.,
+                    double histogramMax = 0.);
+
+    /**
+     * @brief Accumulates width pixels of nComps float components. Pixels with 1 component are alpha,
+     * pixels with 2 components are red and green, and pixels with 3 components are opaque.
+     **/
+    void accumulateRow(const float* pixels, int nComps, int width);
+
+    /**
+     * @brief Accumulates the statistics of other, which must have been computed on other pixels with the same histogram bins.
+     **/
+    void merge(const ImageStatistics& other);
+
+    std::size_t getPixelsCount() const
+    {
+        return _pixelsCount;
+    }
+
+    /// Minimum of the channel, ignoring NaNs. This is +infinity if there are no pixels.
+    double getMin(ChannelEnum channel) const;
+
+    /// Maximum of the channel, ignoring NaNs. This is -infinity if there are no pixels.
+    double getMax(ChannelEnum channel) const;
+
+    double getMean(ChannelEnum channel) const;
+
+    /**
+     * @brief The range of the values displayed by the viewer for the given channels, as used by the auto-contrast.
+     **/
+    void getDisplayRange(DisplayChannelsEnum channels, double* vmin, double* vmax) const;
+
+    bool hasHistograms() const
+    {
+        return _binsCount > 0;
+    }
+
+    int getHistogramBinsCount() const
+    {
+        return _binsCount;
+    }
+
+    double getHistogramMin() const
+    {
+        return _histogramMin;
+    }
+
+    double getHistogramMax() const
+    {
+        return _histogramMax;
+    }
+
+    /// The binsCount bins of the histogram of the channel, or an empty vector if there are no histograms
+    std::vector<unsigned int> getHistogram(ChannelEnum channel) const;
+
+    /**
+     * @brief Computes the statistics of the float image on rect. If multiThreaded is true, rect is split and
+     * the parts are reduced in parallel in the global thread pool.
+     * The result is cached per image hash and rect: asking again for the statistics of the same image
+     * (with either no histograms or the same histogram bins) does not read the image again.
+     **/
+    static ImageStatisticsConstPtr compute(const ImagePtr& image,
+                                           const RectI& rect,
+                                           int binsCount,
+                                           double histogramMin,
+                                           double histogramMax,
+                                           bool multiThreaded);
+
+    /**
+     * @brief Removes all statistics from the cache.
+     **/
+    static void clearCache();
+
+private:
+
+    std::size_t _pixelsCount;
+    float _min[eChannelCount];
+    float _max[eChannelCount];
+    // sums of R, G, B and A, the mean of the luminance is derived from them
+    double _sum[eChannelA + 1];
+    int _binsCount;
+    double _histogramMin, _histogramMax;
+    // eChannelCount histograms of _binsCount bins, one after the other
+    std::vector<unsigned int> _histograms;
+};
+
+NATRON_NAMESPACE_EXIT
+
+#endif // NATRON_ENGINE_IMAGESTATISTICS_H
@@ -39,6 +39,14 @@ GCC_DIAG_OFF(unused-parameter)
 GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 GCC_DIAG_ON(unused-parameter)
 
+#include "Engine/PixelConvert.h"
+
+#ifdef NATRON_PIXEL_CONVERT_X86_SIMD
+#include <immintrin.h>
+#define NATRON_TARGET_SSE41 __attribute__( ( target("sse4.1") ) )
+#define NATRON_TARGET_AVX2 __attribute__( ( target("avx2") ) )
+#endif
+
 #ifndef M_PI
 #define M_PI        3.14159265358979323846264338327950288   /* pi             */
 #endif
@@ -409,25 +417,23 @@ Interpolation::solveQuartic(double c0,
     return num;
 } // solveQuartic
 
-/**
- * @brief Interpolates using the control points P0(t0,v0) , P3(t3,v3)
- * and the derivatives P1(t1,v1) (being the derivative at P0 with respect to
- * t \in [t1,t2]) and P2(t2,v2) (being the derivative at P3 with respect to
- * t \in [t1,t2]) the value at 'currentTime' using the
- * interpolation method "interp".
- * Note that for CATMULL-ROM you must use the function interpolate_catmullRom
- * which will compute the derivatives for you.
- **/
-double
-Interpolation::interpolate(double tcur,
-                           const double vcur,              //start control point
-                           const double vcurDerivRight, //being the derivative dv/dt at tcur
-                           const double vnextDerivLeft, //being the derivative dv/dt at tnext
-                           double tnext,
-                           const double vnext,               //end control point
-                           double currentTime,
-                           KeyframeTypeEnum interp,
-                           KeyframeTypeEnum interpNext)
+/// compute the cubic coefficients of the segment as used by interpolate(), and
+/// the (possibly virtual) segment bounds the parameter t is normalized against
+static void
+segmentCubicCoeffs(double tcur,
+                   const double vcur,
+                   const double vcurDerivRight,
+                   const double vnextDerivLeft,
+                   double tnext,
+                   const double vnext,
+                   KeyframeTypeEnum interp,
+                   KeyframeTypeEnum interpNext,
+                   double *c0,
+                   double *c1,
+                   double *c2,
+                   double *c3,
+                   double *t0,
+                   double *t1)
 {
     double P0 = vcur;
     double P3 = vnext;
@@ -455,8 +461,34 @@ Interpolation::interpolate(double tcur,
         P3 = P0 + P0pr;
         tnext = tcur + 1;
     }
+    hermiteToCubicCoeffs(P0, P0pr, P3pl, P3, c0, c1, c2, c3);
+    *t0 = tcur;
+    *t1 = tnext;
+}
+
+/**
+ * @brief Interpolates using the control points P0(t0,v0) , P3(t3,v3)
+ * and the derivatives P1(t1,v1) (being the derivative at P0 with respect to
+ * t \in [t1,t2]) and P2(t2,v2) (being the derivative at P3 with respect to
+ * t \in [t1,t2]) the value at 'currentTime' using the
+ * interpolation method "interp".
+ * Note that for CATMULL-ROM you must use the function interpolate_catmullRom
+ * which will compute the derivatives for you.
+ **/
+double
+Interpolation::interpolate(double tcur,
+                           const double vcur,              //start control point
+                           const double vcurDerivRight, //being the derivative dv/dt at tcur
+                           const double vnextDerivLeft, //being the derivative dv/dt at tnext
+                           double tnext,
+                           const double vnext,               //end control point
+                           double currentTime,
+                           KeyframeTypeEnum interp,
+                           KeyframeTypeEnum interpNext)
+{
     double c0, c1, c2, c3;
-    hermiteToCubicCoeffs(P0, P0pr, P3pl, P3, &c0, &c1, &c2, &c3);
+    segmentCubicCoeffs(tcur, vcur, vcurDerivRight, vnextDerivLeft, tnext, vnext, interp, interpNext,
+                       &c0, &c1, &c2, &c3, &tcur, &tnext);
 
     const double t = (currentTime - tcur) / (tnext - tcur);
     double ret = cubicEval(c0, c1, c2, c3, t);
@@ -467,6 +499,136 @@ Interpolation::interpolate(double tcur,
     return ret;
 }
 
+static void
+cubicEvalNScalar(double c0,
+                 double c1,
+                 double c2,
+                 double c3,
+                 double tcur,
+                 double dt,
+                 const double* times,
+                 int n,
+                 double* values)
+{
+    for (int i = 0; i < n; ++i) {
+        values[i] = cubicEval(c0, c1, c2, c3, (times[i] - tcur) / dt);
+    }
+}
+
+#ifdef NATRON_PIXEL_CONVERT_X86_SIMD
+// The vector kernels evaluate the same expression as cubicEval, in the same order and
+// without FMA contraction, so that they are bit-exact with the scalar path. A zero
+// coefficient contributes +0. whatever t is, which the all-zero mask reproduces.
+NATRON_TARGET_SSE41
+static void
+cubicEvalNSSE41(double c0,
+                double c1,
+                double c2,
+                double c3,
+                double tcur,
+                double dt,
+                const double* times,
+                int n,
+                double* values)
+{
+    const __m128d vc0 = _mm_set1_pd(c0);
+    const __m128d vc1 = _mm_set1_pd(c1);
+    const __m128d vc2 = _mm_set1_pd(c2);
+    const __m128d vc3 = _mm_set1_pd(c3);
+    const __m128d m1 = _mm_castsi128_pd( _mm_set1_epi64x(c1 ? -1 : 0) );
+    const __m128d m2 = _mm_castsi128_pd( _mm_set1_epi64x(c2 ? -1 : 0) );
+    const __m128d m3 = _mm_castsi128_pd( _mm_set1_epi64x(c3 ? -1 : 0) );
+    const __m128d vtcur = _mm_set1_pd(tcur);
+    const __m128d vdt = _mm_set1_pd(dt);
+    int i = 0;
+
+    for (; i + 2 <= n; i += 2) {
+        const __m128d t = _mm_div_pd(_mm_sub_pd(_mm_loadu_pd(times + i), vtcur), vdt);
+        const __m128d t2 = _mm_mul_pd(t, t);
+        const __m128d t3 = _mm_mul_pd(t2, t);
+        __m128d r = _mm_add_pd( vc0, _mm_and_pd( m1, _mm_mul_pd(vc1, t) ) );
+        r = _mm_add_pd( r, _mm_and_pd( m2, _mm_mul_pd(vc2, t2) ) );
+        r = _mm_add_pd( r, _mm_and_pd( m3, _mm_mul_pd(vc3, t3) ) );
+        _mm_storeu_pd(values + i, r);
+    }
+    cubicEvalNScalar(c0, c1, c2, c3, tcur, dt, times + i, n - i, values + i);
+}
+
+NATRON_TARGET_AVX2
+static void
+cubicEvalNAVX2(double c0,
+               double c1,
+               double c2,
+               double c3,
+               double tcur,
+               double dt,
+               const double* times,
+               int n,
+               double* values)
+{
+    const __m256d vc0 = _mm256_set1_pd(c0);
+    const __m256d vc1 = _mm256_set1_pd(c1);
+    const __m256d vc2 = _mm256_set1_pd(c2);
+    const __m256d vc3 = _mm256_set1_pd(c3);
+    const __m256d m1 = _mm256_castsi256_pd( _mm256_set1_epi64x(c1 ? -1 : 0) );
+    const __m256d m2 = _mm256_castsi256_pd( _mm256_set1_epi64x(c2 ? -1 : 0) );
+    const __m256d m3 = _mm256_castsi256_pd( _mm256_set1_epi64x(c3 ? -1 : 0) );
+    const __m256d vtcur = _mm256_set1_pd(tcur);
+    const __m256d vdt = _mm256_set1_pd(dt);
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        const __m256d t = _mm256_div_pd(_mm256_sub_pd(_mm256_loadu_pd(times + i), vtcur), vdt);
+        const __m256d t2 = _mm256_mul_pd(t, t);
+        const __m256d t3 = _mm256_mul_pd(t2, t);
+        __m256d r = _mm256_add_pd( vc0, _mm256_and_pd( m1, _mm256_mul_pd(vc1, t) ) );
+        r = _mm256_add_pd( r, _mm256_and_pd( m2, _mm256_mul_pd(vc2, t2) ) );
+        r = _mm256_add_pd( r, _mm256_and_pd( m3, _mm256_mul_pd(vc3, t3) ) );
+        _mm256_storeu_pd(values + i, r);
+    }
+    cubicEvalNScalar(c0, c1, c2, c3, tcur, dt, times + i, n - i, values + i);
+}
+
+#endif // NATRON_PIXEL_CONVERT_X86_SIMD
+
+void
+Interpolation::interpolateN(double tcur,
+                            const double vcur,
+                            const double vcurDerivRight,
+                            const double vnextDerivLeft,
+                            double tnext,
+                            const double vnext,
+                            const double* times,
+                            int n,
+                            KeyframeTypeEnum interp,
+                            KeyframeTypeEnum interpNext,
+                            double* values)
+{
+    if (n <= 0) {
+        return;
+    }
+    double c0, c1, c2, c3;
+    segmentCubicCoeffs(tcur, vcur, vcurDerivRight, vnextDerivLeft, tnext, vnext, interp, interpNext,
+                       &c0, &c1, &c2, &c3, &tcur, &tnext);
+    const double dt = tnext - tcur;
+
+#ifdef NATRON_PIXEL_CONVERT_X86_SIMD
+    switch ( PixelConvert::getInstructionSet() ) {
+    case PixelConvert::eInstructionSetAVX2:
+        cubicEvalNAVX2(c0, c1, c2, c3, tcur, dt, times, n, values);
+
+        return;
+    case PixelConvert::eInstructionSetSSE41:
+        cubicEvalNSSE41(c0, c1, c2, c3, tcur, dt, times, n, values);
+
+        return;
+    default:
+        break;
+    }
+#endif
+    cubicEvalNScalar(c0, c1, c2, c3, tcur, dt, times, n, values);
+}
+
 /// derive at currentTime. The derivative is with respect to currentTime
 double
 Interpolation::derive(double tcur,
@@ -50,6 +50,21 @@ double interpolate(double tcur, const double vcur, //start control point
                    KeyframeTypeEnum interp,
                    KeyframeTypeEnum interpNext) WARN_UNUSED_RETURN;
 
+/**
+ * @brief Same as interpolate() for the n times in 'times', which must all lie on the
+ * segment. The segment coefficients are computed once and the cubic is evaluated with
+ * SIMD when available. The results are bit-exact with calling interpolate() for each time.
+ **/
+void interpolateN(double tcur, const double vcur, //start control point
+                  const double vcurDerivRight, //being the derivative dv/dt at tcur
+                  const double vnextDerivLeft, //being the derivative dv/dt at tnext
+                  double tnext, const double vnext, //end control point
+                  const double* times,
+                  int n,
+                  KeyframeTypeEnum interp,
+                  KeyframeTypeEnum interpNext,
+                  double* values);
+
 /// derive at currentTime. The derivative is with respect to currentTime
 double derive(double tcur, const double vcur, //start control point
               const double vcurDerivRight, //being the derivative dv/dt at tcur
@@ -51,6 +51,7 @@
 #include "Engine/KnobSerialization.h"
 #include "Engine/KnobTypes.h"
 #include "Engine/LibraryBinary.h"
+#include "Engine/NativeExpression.h"
 #include "Engine/Node.h"
 #include "Engine/Project.h"
 #include "Engine/StringAnimationManager.h"
@@ -229,8 +230,11 @@ struct Expr
 
     //PyObject* code;
 
+    ///The expression compiled to be evaluated without Python, or NULL if it is not supported natively
+    NativeExpressionPtr native;
+
     Expr()
-        : expression(), originalExpression(), exprInvalid(), hasRet(false) /*, code(0)*/ {}
+        : expression(), originalExpression(), exprInvalid(), hasRet(false), native() /*, code(0)*/ {}
 };
 
 struct KnobHelperPrivate
@@ -326,6 +330,9 @@ struct KnobHelperPrivate
     int listenersNotificationBlocked; // protected by valueChangedBlockedMutex
     bool isClipPreferenceSlave;
 
+    ///Index of the knob in its holder, used to look it up in the render snapshots, @see KnobValuesSnapshot
+    int indexInHolder;
+
     KnobHelperPrivate(KnobHelper* publicInterface_,
                       KnobHolder*  holder_,
                       int dimension_,
@@ -391,6 +398,7 @@ struct KnobHelperPrivate
         , valueChangedBlocked(0)
         , listenersNotificationBlocked(0)
         , isClipPreferenceSlave(false)
+        , indexInHolder(-1)
     {
         tlsData = boost::make_shared<TLSHolder<KnobHelper::KnobTLSData> >();
         if ( holder && !holder->canKnobsAnimate() ) {
@@ -415,6 +423,8 @@ struct KnobHelperPrivate
 
     std::string declarePythonVariables(bool addTab, int dimension);
 
+    NativeExpressionPtr compileNativeExpression(int dimension, const std::string& expression);
+
     bool shouldUseGuiCurve() const
     {
         if (!holder) {
@@ -2357,6 +2367,254 @@ KnobHelperPrivate::declarePythonVariables(bool addTab,
     return ss.str();
 } // KnobHelperPrivate::declarePythonVariables
 
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+// Reads a numeric knob referenced by a native expression, with the same calls as the Param classes of the Python API
+class KnobExpressionParam
+    : public NativeExpressionParam
+{
+    NodeWPtr _node;
+    KnobIWPtr _knob;
+    KnobDoubleBaseWPtr _doubleKnob;
+    KnobIntBaseWPtr _intKnob;
+    KnobBoolBaseWPtr _boolKnob;
+    int _nDims;
+    bool _isIntegral;
+    bool _isColor;
+    bool _hasDimensionArgument;
+
+    KnobExpressionParam()
+        : _node()
+        , _knob()
+        , _doubleKnob()
+        , _intKnob()
+        , _boolKnob()
+        , _nDims(0)
+        , _isIntegral(true)
+        , _isColor(false)
+        , _hasDimensionArgument(true)
+    {
+    }
+
+public:
+
+    static NativeExpressionParamPtr create(const NodePtr& node,
+                                           const KnobIPtr& knob)
+    {
+        if (!knob) {
+            return NativeExpressionParamPtr();
+        }
+        boost::shared_ptr<KnobExpressionParam> ret( new KnobExpressionParam() );
+        ret->_node = node;
+        ret->_knob = knob;
+        ret->_nDims = knob->getDimension();
+        if ( dynamic_cast<KnobDouble*>( knob.get() ) ) {
+            ret->_doubleKnob = boost::dynamic_pointer_cast<KnobDoubleBase>(knob);
+            ret->_isIntegral = false;
+        } else if ( dynamic_cast<KnobColor*>( knob.get() ) ) {
+            ret->_doubleKnob = boost::dynamic_pointer_cast<KnobDoubleBase>(knob);
+            ret->_isIntegral = false;
+            ret->_isColor = true;
+        } else if ( dynamic_cast<KnobInt*>( knob.get() ) ) {
+            ret->_intKnob = boost::dynamic_pointer_cast<KnobIntBase>(knob);
+        } else if ( dynamic_cast<KnobChoice*>( knob.get() ) ) {
+            ret->_intKnob = boost::dynamic_pointer_cast<KnobIntBase>(knob);
+            ret->_hasDimensionArgument = false;
+        } else if ( dynamic_cast<KnobBool*>( knob.get() ) ) {
+            ret->_boolKnob = boost::dynamic_pointer_cast<KnobBoolBase>(knob);
+            ret->_hasDimensionArgument = false;
+        } else {
+            // Buttons, strings, parametric parameters...
+            return NativeExpressionParamPtr();
+        }
+
+        return ret;
+    }
+
+    virtual int getDimension() const OVERRIDE FINAL
+    {
+        return _nDims;
+    }
+
+    virtual bool isIntegral() const OVERRIDE FINAL
+    {
+        return _isIntegral;
+    }
+
+    virtual bool isColor() const OVERRIDE FINAL
+    {
+        return _isColor;
+    }
+
+    virtual bool hasDimensionArgument() const OVERRIDE FINAL
+    {
+        return _hasDimensionArgument;
+    }
+
+    virtual bool getValue(int dimension,
+                          double* value) const OVERRIDE FINAL
+    {
+        if ( !isNodeAlive() ) {
+            return false;
+        }
+        if ( KnobDoubleBasePtr knob = _doubleKnob.lock() ) {
+            *value = knob->getValue(dimension);
+        } else if ( KnobIntBasePtr knob = _intKnob.lock() ) {
+            *value = knob->getValue(dimension);
+        } else if ( KnobBoolBasePtr knob = _boolKnob.lock() ) {
+            *value = knob->getValue(dimension) ? 1. : 0.;
+        } else {
+            return false;
+        }
+
+        return true;
+    }
+
+    virtual bool getValueAtTime(double time,
+                                int dimension,
+                                double* value) const OVERRIDE FINAL
+    {
+        if ( !isNodeAlive() ) {
+            return false;
+        }
+        if ( KnobDoubleBasePtr knob = _doubleKnob.lock() ) {
+            *value = knob->getValueAtTime(time, dimension);
+        } else if ( KnobIntBasePtr knob = _intKnob.lock() ) {
+            *value = knob->getValueAtTime(time, dimension);
+        } else if ( KnobBoolBasePtr knob = _boolKnob.lock() ) {
+            *value = knob->getValueAtTime(time, dimension) ? 1. : 0.;
+        } else {
+            return false;
+        }
+
+        return true;
+    }
+
+    virtual bool getCurveValue(double time,
+                               int dimension,
+                               double* value) const OVERRIDE FINAL
+    {
+        KnobIPtr knob = _knob.lock();
+
+        if ( !knob || !isNodeAlive() ) {
+            return false;
+        }
+        *value = knob->getRawCurveValueAt(time, ViewSpec::current(), dimension);
+
+        return true;
+    }
+
+private:
+
+    // Deleted nodes are kept deactivated for undo, but they are no longer defined in Python
+    bool isNodeAlive() const
+    {
+        NodePtr node = _node.lock();
+
+        return node && node->isActivated();
+    }
+};
+
+// Resolves the names of an expression to the nodes and knobs declared by KnobHelperPrivate::declarePythonVariables
+class KnobExpressionContext
+    : public NativeExpressionContext
+{
+    KnobIPtr _knob;
+    int _dimension;
+    NodePtr _node;
+    NodeCollectionPtr _collection;
+    NodeGroup* _parentGroup;
+    std::string _appID;
+
+public:
+
+    KnobExpressionContext(const KnobIPtr& knob,
+                          int dimension,
+                          const NodePtr& node)
+        : _knob(knob)
+        , _dimension(dimension)
+        , _node(node)
+        , _collection( node->getGroup() )
+        , _parentGroup( dynamic_cast<NodeGroup*>( _collection.get() ) )
+        , _appID( node->getApp()->getAppIDString() )
+    {
+    }
+
+    virtual int getDimension() const OVERRIDE FINAL
+    {
+        return _dimension;
+    }
+
+    virtual NativeExpressionParamPtr getParam(const std::vector<std::string>& path) const OVERRIDE FINAL
+    {
+        if ( (path.size() == 1) && (path[0] == "thisParam") ) {
+            return KnobExpressionParam::create(_node, _knob);
+        }
+        NodePtr node;
+        if ( (path.size() == 2) && (path[0] == "thisNode") ) {
+            node = _node;
+        } else if ( (path.size() == 2) && (path[0] == "thisGroup") ) {
+            // A parameter of the parent group, unless a node of the group has the same name
+            if ( !_parentGroup || getSibling(path[1]) ) {
+                return NativeExpressionParamPtr();
+            }
+            node = _parentGroup->getNode();
+        } else if ( (path.size() == 3) && (path[0] == "thisGroup") ) {
+            node = getSibling(path[1]);
+        } else if (path.size() == 2) {
+            node = getSibling(path[0]);
+        }
+        if (!node) {
+            return NativeExpressionParamPtr();
+        }
+
+        return KnobExpressionParam::create( node, node->getKnobByName( path.back() ) );
+    }
+
+    virtual bool isScopeName(const std::string& name) const OVERRIDE FINAL
+    {
+        return name == "app" || name == _appID || getSibling(name);
+    }
+
+private:
+
+    NodePtr getSibling(const std::string& name) const
+    {
+        NodesList siblings = _collection->getNodes();
+
+        for (NodesList::iterator it = siblings.begin(); it != siblings.end(); ++it) {
+            if ( (*it)->isActivated() && !(*it)->getParentMultiInstance() && ( (*it)->getScriptName_mt_safe() == name ) ) {
+                return *it;
+            }
+        }
+
+        return NodePtr();
+    }
+};
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+NativeExpressionPtr
+KnobHelperPrivate::compileNativeExpression(int dimension,
+                                           const std::string& expression)
+{
+    // The result of string expressions is not a number
+    if ( dynamic_cast<KnobStringBase*>(publicInterface) ) {
+        return NativeExpressionPtr();
+    }
+    EffectInstance* effect = dynamic_cast<EffectInstance*>(holder);
+    if (!effect) {
+        return NativeExpressionPtr();
+    }
+    NodePtr node = effect->getNode();
+    if ( !node || !node->getGroup() ) {
+        return NativeExpressionPtr();
+    }
+    KnobExpressionContext context(publicInterface->shared_from_this(), dimension, node);
+
+    return NativeExpression::compile(expression, context);
+}
+
 void
 KnobHelperPrivate::parseListenersFromExpression(int dimension)
 {
@@ -2701,10 +2959,17 @@ KnobHelper::setExpressionInternal(int dimension,
         }
     }
 
+    //Compile the expression to evaluate it without Python, if possible
+    NativeExpressionPtr native;
+    if ( exprInvalid.empty() && !hasRetVariable ) {
+        native = _imp->compileNativeExpression(dimension, expression);
+    }
+
     //Set internal fields
 
     {
         QMutexLocker k(&_imp->expressionMutex);
+        _imp->expressions[dimension].native = native;
         _imp->expressions[dimension].hasRet = hasRetVariable;
         _imp->expressions[dimension].expression = exprCpy;
         _imp->expressions[dimension].originalExpression = expression;
@@ -2801,6 +3066,7 @@ KnobHelper::clearExpression(int dimension,
         _imp->expressions[dimension].expression.clear();
         _imp->expressions[dimension].originalExpression.clear();
         _imp->expressions[dimension].exprInvalid.clear();
+        _imp->expressions[dimension].native.reset();
         //Py_XDECREF(_imp->expressions[dimension].code); //< new ref
         //_imp->expressions[dimension].code = 0;
     }
@@ -2931,6 +3197,21 @@ KnobHelper::executeExpression(double time,
     return executeExpression(ss.str(), ret, error);
 }
 
+bool
+KnobHelper::evaluateNativeExpression(double time,
+                                     ViewIdx view,
+                                     int dimension,
+                                     double* ret,
+                                     bool* isInt) const
+{
+    NativeExpressionPtr native;
+    {
+        QMutexLocker k(&_imp->expressionMutex);
+        native = _imp->expressions[dimension].native;
+    }
+
+    return native && native->evaluate(time, view, ret, isInt);
+}
 
 bool
 KnobHelper::executeExpression(const std::string& expr,
@@ -4188,6 +4469,12 @@ KnobHelper::getListeners(KnobI::ListenerDimsMap & listeners) const
     listeners = _imp->listeners;
 }
 
+int
+KnobHelper::getIndexInHolder() const
+{
+    return _imp->indexInHolder;
+}
+
 double
 KnobHelper::getCurrentTime() const
 {
@@ -4729,6 +5016,9 @@ struct KnobHolder::KnobHolderPrivate
     bool hasAnimation;
     DockablePanelI* settingsPanel;
 
+    ///The index given to the next knob added, never reused so that indices stay stable when knobs are removed
+    int nextKnobIndex;
+
     KnobHolderPrivate(const AppInstancePtr& appInstance_)
         : app(appInstance_)
         , knobsMutex()
@@ -4753,6 +5043,7 @@ struct KnobHolder::KnobHolderPrivate
         , hasAnimationMutex()
         , hasAnimation(false)
         , settingsPanel(0)
+        , nextKnobIndex(0)
 
     {
     }
@@ -4781,6 +5072,7 @@ struct KnobHolder::KnobHolderPrivate
     , hasAnimationMutex()
     , hasAnimation(other.hasAnimation)
     , settingsPanel(other.settingsPanel)
+    , nextKnobIndex(other.nextKnobIndex)
     {
 
     }
@@ -4880,6 +5172,18 @@ KnobHolder::addKnob(const KnobIPtr& k)
         }
     }
     _imp->knobs.push_back(k);
+    setKnobIndexInHolder(k);
+}
+
+void
+KnobHolder::setKnobIndexInHolder(const KnobIPtr& k)
+{
+    // PRIVATE - knobsMutex must be locked
+    KnobHelper* helper = dynamic_cast<KnobHelper*>( k.get() );
+
+    if ( helper && (helper->_imp->indexInHolder < 0) ) {
+        helper->_imp->indexInHolder = _imp->nextKnobIndex++;
+    }
 }
 
 void
@@ -4902,6 +5206,7 @@ KnobHolder::insertKnob(int index,
         std::advance(it, index);
         _imp->knobs.insert(it, k);
     }
+    setKnobIndexInHolder(k);
 }
 
 void
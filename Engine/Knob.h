@@ -1455,6 +1455,13 @@ protected:
     template <typename T>
     static T pyObjectToType(PyObject* o);
 
+    /**
+     * @brief Converts the result of a NativeExpression the same way pyObjectToType converts the result of the Python expression.
+     * Returns false if the conversion would differ, in which case the expression is evaluated by Python.
+     **/
+    template <typename T>
+    static bool nativeExpressionResultToType(double value, bool isInt, T* ret);
+
     virtual void refreshListenersAfterValueChange(ViewSpec view, ValueChangedReasonEnum reason, int dimension) OVERRIDE FINAL;
 
 public:
@@ -1551,6 +1558,12 @@ public:
     virtual void copyAnimationToClipboard() const OVERRIDE FINAL;
     virtual double getCurrentTime() const OVERRIDE FINAL WARN_UNUSED_RETURN;
     virtual ViewIdx getCurrentView() const OVERRIDE FINAL WARN_UNUSED_RETURN;
+
+    /**
+     * @brief The index of this knob in its holder, or -1 if it was never added to the holder.
+     * It does not change when other knobs are removed.
+     **/
+    int getIndexInHolder() const;
     virtual std::string getDimensionName(int dimension) const OVERRIDE FINAL WARN_UNUSED_RETURN;
     virtual void setDimensionName(int dim, const std::string & name) OVERRIDE FINAL;
     virtual bool hasModifications() const OVERRIDE FINAL WARN_UNUSED_RETURN;
@@ -1589,6 +1602,12 @@ protected:
     ///The return value must be Py_DECRREF
     bool executeExpression(double time, ViewIdx view, int dimension, PyObject** ret, std::string* error) const;
 
+    /**
+     * @brief Evaluates the expression of the given dimension without the Python interpreter if it could be compiled natively
+     * (see NativeExpression). Returns false if it must be evaluated by executeExpression.
+     **/
+    bool evaluateNativeExpression(double time, ViewIdx view, int dimension, double* ret, bool* isInt) const;
+
 public:
 
     /// The return value must be Py_DECRREF
@@ -2066,6 +2085,8 @@ public:
 
     bool getValueFromCurve(double time, ViewSpec view, int dimension, bool useGuiCurve, bool byPassMaster, bool clamp, T* ret);
 
+    bool getValueFromRenderSnapshot(bool useCurrentTime, double time, int dimension, T* ret) const;
+
 protected:
 
     virtual void resetExtraToDefaultValue(int /*dimension*/) {}
@@ -2621,6 +2642,12 @@ public:
     void insertKnob(int idx, const KnobIPtr& k);
     void removeKnobFromList(const KnobI* knob);
 
+private:
+
+    void setKnobIndexInHolder(const KnobIPtr& k);
+
+public:
+
 
     void initializeKnobsPublic();
 
@@ -2644,6 +2671,16 @@ public:
         return ViewIdx(0);
     }
 
+    /**
+     * @brief Returns the knob values captured for the frame being rendered by this thread, if any.
+     * The snapshot stays valid as long as the render of the frame on this thread.
+     * If a snapshot is returned, currentTime is set to the same value as getCurrentTime().
+     **/
+    virtual const KnobValuesSnapshot* getKnobValuesSnapshotTLS(double* /*currentTime*/) const
+    {
+        return 0;
+    }
+
     int getPageIndex(const KnobPage* page) const;
 
 
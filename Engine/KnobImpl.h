@@ -31,6 +31,7 @@
 #include "Knob.h"
 
 #include <cfloat>
+#include <climits>
 #include <stdexcept>
 #include <string>
 #include <algorithm> // min, max
@@ -57,6 +58,7 @@ GCC_DIAG_ON(unused-parameter)
 #include "Engine/Project.h"
 #include "Engine/EffectInstance.h"
 #include "Engine/KnobTypes.h"
+#include "Engine/KnobValuesSnapshot.h"
 #include "Engine/ViewIdx.h"
 #include "Engine/EngineFwd.h"
 
@@ -388,6 +390,53 @@ KnobHelper::pyObjectToType(PyObject* o)
     return s != NULL ? std::string(s) : std::string();
 }
 
+template <>
+bool
+KnobHelper::nativeExpressionResultToType(double value,
+                                         bool isInt,
+                                         int* ret)
+{
+    // PyInt_AsLong fails on floats
+    if ( !isInt || (value < INT_MIN) || (value > INT_MAX) ) {
+        return false;
+    }
+    *ret = (int)value;
+
+    return true;
+}
+
+template <>
+bool
+KnobHelper::nativeExpressionResultToType(double value,
+                                         bool /*isInt*/,
+                                         bool* ret)
+{
+    *ret = value != 0.;
+
+    return true;
+}
+
+template <>
+bool
+KnobHelper::nativeExpressionResultToType(double value,
+                                         bool /*isInt*/,
+                                         double* ret)
+{
+    *ret = value;
+
+    return true;
+}
+
+template <>
+bool
+KnobHelper::nativeExpressionResultToType(double /*value*/,
+                                         bool /*isInt*/,
+                                         std::string* /*ret*/)
+{
+    // String expressions are never compiled natively
+    return false;
+}
+
 inline unsigned int
 hashFunction(unsigned int a)
 {
@@ -428,6 +477,15 @@ Knob<T>::evaluateExpression(double time,
                             T* value,
                             std::string* error)
 {
+    {
+        double nativeValue;
+        bool nativeIsInt;
+        if ( evaluateNativeExpression(time, view, dimension, &nativeValue, &nativeIsInt) &&
+             nativeExpressionResultToType<T>(nativeValue, nativeIsInt, value) ) {
+            return true;
+        }
+    }
+
     PythonGILLocker pgl;
     PyObject *ret;
 
@@ -450,6 +508,15 @@ Knob<T>::evaluateExpression_pod(double time,
                                 double* value,
                                 std::string* error)
 {
+    {
+        // Ints are converted with PyInt_AsLong to an int
+        bool nativeIsInt;
+        if ( evaluateNativeExpression(time, view, dimension, value, &nativeIsInt) &&
+             ( !nativeIsInt || ( (*value >= INT_MIN) && (*value <= INT_MAX) ) ) ) {
+            return true;
+        }
+    }
+
     PythonGILLocker pgl;
     PyObject *ret;
 
@@ -694,6 +761,44 @@ Knob<T>::getValueFromMaster(ViewSpec view,
     return T();
 }
 
+/**
+ * @brief Reads the value from the knob values snapshot of the frame being rendered by this thread.
+ * This does not lock the knob. If useCurrentTime is true, the value at the current render time is returned.
+ **/
+template <typename T>
+bool
+Knob<T>::getValueFromRenderSnapshot(bool useCurrentTime,
+                                    double time,
+                                    int dimension,
+                                    T* ret) const
+{
+    KnobHolder* holder = getHolder();
+    double currentTime = time;
+    const KnobValuesSnapshot* snapshot = holder ? holder->getKnobValuesSnapshotTLS(&currentTime) : 0;
+
+    if (!snapshot) {
+        return false;
+    }
+    double value;
+    if ( !snapshot->getValue(this, getIndexInHolder(), useCurrentTime ? currentTime : time, dimension, &value) ) {
+        return false;
+    }
+    *ret = (T)value;
+
+    return true;
+}
+
+template <>
+bool
+KnobStringBase::getValueFromRenderSnapshot(bool /*useCurrentTime*/,
+                                              double /*time*/,
+                                              int /*dimension*/,
+                                              std::string* /*ret*/) const
+{
+    // string knobs are not captured in the snapshots
+    return false;
+}
+
 template <typename T>
 T
 Knob<T>::getValue(int dimension,
@@ -713,6 +818,12 @@ Knob<T>::getValue(int dimension,
     if ( ( dimension >= (int)_values.size() ) || (dimension < 0) ) {
         return T();
     }
+    if (clamp && !useGuiValues) {
+        T ret;
+        if ( getValueFromRenderSnapshot(true, 0., dimension, &ret) ) {
+            return ret;
+        }
+    }
     std::string hasExpr = getExpression(dimension);
     if ( !hasExpr.empty() ) {
         T ret;
@@ -833,6 +944,12 @@ Knob<T>::getValueAtTime(double time,
     }
 
     bool useGuiValues = QThread::currentThread() == qApp->thread();
+    if (clamp && !byPassMaster && !useGuiValues) {
+        T ret;
+        if ( getValueFromRenderSnapshot(false, time, dimension, &ret) ) {
+            return ret;
+        }
+    }
     std::string hasExpr = getExpression(dimension);
     if ( !hasExpr.empty() ) {
         T ret;
@@ -0,0 +1,89 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ * Copyright (C) 2018-2020 The Natron developers
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "KnobValuesSnapshot.h"
+
+#include <cassert>
+
+#include "Engine/Knob.h"
+#include "Engine/ViewIdx.h"
+
+NATRON_NAMESPACE_ENTER
+
+KnobValuesSnapshot::KnobValuesSnapshot(const KnobHolder* holder,
+                                       double time)
+    : _time(time)
+    , _knobs()
+    , _values()
+    , _captured()
+{
+    assert(holder);
+    const KnobsVec knobs = holder->getKnobs_mt_safe();
+
+    for (KnobsVec::const_iterator it = knobs.begin(); it != knobs.end(); ++it) {
+        KnobHelper* helper = dynamic_cast<KnobHelper*>( it->get() );
+        if (!helper) {
+            continue;
+        }
+        const int index = helper->getIndexInHolder();
+        if (index < 0) {
+            continue;
+        }
+        KnobIntBase* isInt = dynamic_cast<KnobIntBase*>(helper);
+        KnobDoubleBase* isDouble = dynamic_cast<KnobDoubleBase*>(helper);
+        KnobBoolBase* isBool = dynamic_cast<KnobBoolBase*>(helper);
+        if (!isInt && !isDouble && !isBool) {
+            continue;
+        }
+
+        if ( index >= (int)_knobs.size() ) {
+            _knobs.resize(index + 1);
+        }
+        KnobEntry& entry = _knobs[index];
+        entry.knob = helper;
+        entry.firstValue = _values.size();
+        entry.nDims = helper->getDimension();
+
+        for (int i = 0; i < entry.nDims; ++i) {
+            if ( !helper->getExpression(i).empty() || helper->getMaster(i).second ) {
+                _values.push_back(0.);
+                _captured.push_back(0);
+                continue;
+            }
+            double v;
+            if (isInt) {
+                v = isInt->getValueAtTime(time, i, ViewIdx(0), true);
+            } else if (isDouble) {
+                v = isDouble->getValueAtTime(time, i, ViewIdx(0), true);
+            } else {
+                v = isBool->getValueAtTime(time, i, ViewIdx(0), true);
+            }
+            _values.push_back(v);
+            _captured.push_back(1);
+        }
+    }
+}
+
+NATRON_NAMESPACE_EXIT
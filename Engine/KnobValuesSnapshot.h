@@ -0,0 +1,110 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ * Copyright (C) 2018-2020 The Natron developers
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_KNOBVALUESSNAPSHOT_H
+#define NATRON_ENGINE_KNOBVALUESSNAPSHOT_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <vector>
+
+#include "Engine/EngineFwd.h"
+
+NATRON_NAMESPACE_ENTER
+
+/**
+ * @brief The values of the int, double and boolean knobs of a holder at the time of a frame render.
+ * It is built when the ParallelRenderArgsSetter is set up and never modified afterwards, so that render
+ * threads can read it concurrently without locking the knobs.
+ * Dimensions that have an expression or are slaved to another knob are not captured: they are
+ * evaluated through the knob as before.
+ **/
+class KnobValuesSnapshot
+{
+public:
+
+    KnobValuesSnapshot(const KnobHolder* holder,
+                       double time);
+
+    double getTime() const
+    {
+        return _time;
+    }
+
+    /**
+     * @brief Returns true and sets value if the given dimension of the knob was captured at the given time.
+     * knobIndex is the index of the knob in its holder, @see KnobHelper::getIndexInHolder().
+     **/
+    bool getValue(const KnobI* knob,
+                  int knobIndex,
+                  double time,
+                  int dimension,
+                  double* value) const
+    {
+        if ( (time != _time) || (knobIndex < 0) || ( knobIndex >= (int)_knobs.size() ) ) {
+            return false;
+        }
+        const KnobEntry& entry = _knobs[knobIndex];
+        if ( (entry.knob != knob) || (dimension < 0) || (dimension >= entry.nDims) ) {
+            return false;
+        }
+        const std::size_t i = entry.firstValue + dimension;
+        if (!_captured[i]) {
+            return false;
+        }
+        *value = _values[i];
+
+        return true;
+    }
+
+private:
+
+    struct KnobEntry
+    {
+        const KnobI* knob; // only used to check the entry, never dereferenced
+        std::size_t firstValue;
+        int nDims;
+
+        KnobEntry()
+            : knob(0)
+            , firstValue(0)
+            , nDims(0)
+        {
+        }
+    };
+
+    double _time;
+
+    // Indexed by the index of the knob in the holder
+    std::vector<KnobEntry> _knobs;
+
+    // The values of all dimensions of all knobs, one after the other
+    std::vector<double> _values;
+    std::vector<char> _captured;
+};
+
+NATRON_NAMESPACE_EXIT
+
+#endif // NATRON_ENGINE_KNOBVALUESSNAPSHOT_H
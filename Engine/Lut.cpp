@@ -29,7 +29,9 @@
 #include <algorithm> // min, max
 #include <cassert>
 #include <stdexcept>
+#include <vector>
 
+#include "Engine/PixelConvert.h"
 #include "Engine/RectI.h"
 
 /*
@@ -465,6 +467,12 @@ Lut::to_byte_packed(unsigned char* to,
 
     validate();
 
+    // The Lut indices of a whole row are computed first with the SIMD kernels,
+    // only the error diffusion itself has to be sequential.
+    const int rowWidth = rect.x2 - rect.x1;
+    const bool premultInput = inputHasAlpha && premult;
+    std::vector<unsigned short> rowIndices(rowWidth * inPackingSize);
+
     for (int y = rect.y1; y < rect.y2; ++y) {
         // coverity[dont_call]
         int start = rand() % (rect.x2 - rect.x1) + rect.x1;
@@ -479,14 +487,20 @@ Lut::to_byte_packed(unsigned char* to,
         int dstY = dstBounds.y2 - y - 1;
         const float *src_pixels = from + (srcY * (srcBounds.x2 - srcBounds.x1) * inPackingSize);
         unsigned char *dst_pixels = to + (dstY * (dstBounds.x2 - dstBounds.x1) * outPackingSize);
+        if (premultInput) {
+            PixelConvert::computeLutIndicesPremult4(src_pixels + rect.x1 * inPackingSize, &rowIndices[0], rowWidth);
+        } else {
+            PixelConvert::computeLutIndices(src_pixels + rect.x1 * inPackingSize, &rowIndices[0], rowWidth * inPackingSize);
+        }
         /* go forwards from starting point to end of line: */
         for (int x = start; x < rect.x2; ++x) {
             int inCol = x * inPackingSize;
             int outCol = x * outPackingSize;
-            float a = (inputHasAlpha && premult) ? src_pixels[inCol + inAOffset] : 1.f;
-            error_r = (error_r & 0xff) + toFunc_hipart_to_uint8xx[hipart(src_pixels[inCol + inROffset] * a)];
-            error_g = (error_g & 0xff) + toFunc_hipart_to_uint8xx[hipart(src_pixels[inCol + inGOffset] * a)];
-            error_b = (error_b & 0xff) + toFunc_hipart_to_uint8xx[hipart(src_pixels[inCol + inBOffset] * a)];
+            const unsigned short *indices = &rowIndices[(x - rect.x1) * inPackingSize];
+            float a = premultInput ? src_pixels[inCol + inAOffset] : 1.f;
+            error_r = (error_r & 0xff) + toFunc_hipart_to_uint8xx[indices[inROffset]];
+            error_g = (error_g & 0xff) + toFunc_hipart_to_uint8xx[indices[inGOffset]];
+            error_b = (error_b & 0xff) + toFunc_hipart_to_uint8xx[indices[inBOffset]];
             assert(error_r < 0x10000 && error_g < 0x10000 && error_b < 0x10000);
             dst_pixels[outCol + outROffset] = (unsigned char)(error_r >> 8);
             dst_pixels[outCol + outGOffset] = (unsigned char)(error_g >> 8);
@@ -501,10 +515,11 @@ Lut::to_byte_packed(unsigned char* to,
         for (int x = start - 1; x >= rect.x1; --x) {
             int inCol = x * inPackingSize;
             int outCol = x * outPackingSize;
-            float a = (inputHasAlpha && premult) ? src_pixels[inCol + inAOffset] : 1.f;
-            error_r = (error_r & 0xff) + toFunc_hipart_to_uint8xx[hipart(src_pixels[inCol + inROffset] * a)];
-            error_g = (error_g & 0xff) + toFunc_hipart_to_uint8xx[hipart(src_pixels[inCol + inGOffset] * a)];
-            error_b = (error_b & 0xff) + toFunc_hipart_to_uint8xx[hipart(src_pixels[inCol + inBOffset] * a)];
+            const unsigned short *indices = &rowIndices[(x - rect.x1) * inPackingSize];
+            float a = premultInput ? src_pixels[inCol + inAOffset] : 1.f;
+            error_r = (error_r & 0xff) + toFunc_hipart_to_uint8xx[indices[inROffset]];
+            error_g = (error_g & 0xff) + toFunc_hipart_to_uint8xx[indices[inGOffset]];
+            error_b = (error_b & 0xff) + toFunc_hipart_to_uint8xx[indices[inBOffset]];
             assert(error_r < 0x10000 && error_g < 0x10000 && error_b < 0x10000);
             dst_pixels[outCol + outROffset] = (unsigned char)(error_r >> 8);
             dst_pixels[outCol + outGOffset] = (unsigned char)(error_g >> 8);
@@ -0,0 +1,1660 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ * Copyright (C) 2018-2020 The Natron developers
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "NativeExpression.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <locale>
+#include <sstream>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_OFF
+#include <boost/math/special_functions/asinh.hpp>
+#include <boost/math/special_functions/acosh.hpp>
+#include <boost/math/special_functions/atanh.hpp>
+#include <boost/math/special_functions/expm1.hpp>
+#include <boost/math/special_functions/fpclassify.hpp>
+#include <boost/math/special_functions/hypot.hpp>
+#include <boost/math/special_functions/log1p.hpp>
+#include <boost/math/special_functions/sign.hpp>
+GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
+#endif
+
+// Python ints are represented exactly by the evaluator as long as they are below this value (2^53). Expressions producing larger ints
+// are left to Python.
+#define NATRON_NATIVE_EXPRESSION_MAX_INT 9007199254740992.
+
+// Stack size of the expressions evaluated without allocating
+#define NATRON_NATIVE_EXPRESSION_LOCAL_STACK_SIZE 32
+
+NATRON_NAMESPACE_ENTER
+
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+// A Python number: an int (or a bool) if isInt is true, a float otherwise
+struct Value
+{
+    double v;
+    bool isInt;
+};
+
+enum OpEnum
+{
+    eOpConstant = 0,
+    eOpFrame,
+    eOpView,
+    eOpPositive,
+    eOpNegate,
+    eOpNot,
+    eOpAdd,
+    eOpSubtract,
+    eOpMultiply,
+    eOpDivide,
+    eOpFloorDivide,
+    eOpModulo,
+    eOpPower,
+    eOpLess,
+    eOpLessEqual,
+    eOpGreater,
+    eOpGreaterEqual,
+    eOpEqual,
+    eOpNotEqual,
+    eOpJump,
+    eOpJumpIfFalse,
+    eOpJumpIfFalseOrPop,
+    eOpJumpIfTrueOrPop,
+    eOpCall,
+    eOpParamValue,
+    eOpParamValueAtTime,
+    eOpParamCurve
+};
+
+enum FunctionEnum
+{
+    eFunctionAbs = 0,
+    eFunctionMin,
+    eFunctionMax,
+    eFunctionInt,
+    eFunctionFloat,
+    eFunctionSin,
+    eFunctionCos,
+    eFunctionTan,
+    eFunctionAsin,
+    eFunctionAcos,
+    eFunctionAtan,
+    eFunctionSinh,
+    eFunctionCosh,
+    eFunctionTanh,
+    eFunctionAsinh,
+    eFunctionAcosh,
+    eFunctionAtanh,
+    eFunctionExp,
+    eFunctionExpm1,
+    eFunctionLog,
+    eFunctionLog10,
+    eFunctionLog1p,
+    eFunctionLog2,
+    eFunctionSqrt,
+    eFunctionFabs,
+    eFunctionFloor,
+    eFunctionCeil,
+    eFunctionTrunc,
+    eFunctionDegrees,
+    eFunctionRadians,
+    eFunctionAtan2,
+    eFunctionPow,
+    eFunctionFmod,
+    eFunctionHypot,
+    eFunctionCopysign
+};
+
+struct FunctionDesc
+{
+    const char* name;
+    FunctionEnum function;
+    int minArgs;
+    int maxArgs; // -1: variadic
+};
+
+// The builtins and the functions of the math module (imported with "from math import *" in the main module)
+const FunctionDesc kFunctions[] = {
+    { "abs", eFunctionAbs, 1, 1 },
+    { "min", eFunctionMin, 2, -1 },
+    { "max", eFunctionMax, 2, -1 },
+    { "int", eFunctionInt, 1, 1 },
+    { "float", eFunctionFloat, 1, 1 },
+    { "sin", eFunctionSin, 1, 1 },
+    { "cos", eFunctionCos, 1, 1 },
+    { "tan", eFunctionTan, 1, 1 },
+    { "asin", eFunctionAsin, 1, 1 },
+    { "acos", eFunctionAcos, 1, 1 },
+    { "atan", eFunctionAtan, 1, 1 },
+    { "sinh", eFunctionSinh, 1, 1 },
+    { "cosh", eFunctionCosh, 1, 1 },
+    { "tanh", eFunctionTanh, 1, 1 },
+    { "asinh", eFunctionAsinh, 1, 1 },
+    { "acosh", eFunctionAcosh, 1, 1 },
+    { "atanh", eFunctionAtanh, 1, 1 },
+    { "exp", eFunctionExp, 1, 1 },
+    { "expm1", eFunctionExpm1, 1, 1 },
+    { "log", eFunctionLog, 1, 2 },
+    { "log10", eFunctionLog10, 1, 1 },
+    { "log1p", eFunctionLog1p, 1, 1 },
+#if PY_MAJOR_VERSION >= 3
+    { "log2", eFunctionLog2, 1, 1 },
+#endif
+    { "sqrt", eFunctionSqrt, 1, 1 },
+    { "fabs", eFunctionFabs, 1, 1 },
+    { "floor", eFunctionFloor, 1, 1 },
+    { "ceil", eFunctionCeil, 1, 1 },
+    { "trunc", eFunctionTrunc, 1, 1 },
+    { "degrees", eFunctionDegrees, 1, 1 },
+    { "radians", eFunctionRadians, 1, 1 },
+    { "atan2", eFunctionAtan2, 2, 2 },
+    { "pow", eFunctionPow, 2, 2 },
+    { "fmod", eFunctionFmod, 2, 2 },
+    { "hypot", eFunctionHypot, 2, 2 },
+    { "copysign", eFunctionCopysign, 2, 2 },
+};
+
+// The variables defined by KnobHelperPrivate::declarePythonVariables after the nodes, which hide them
+const char* const kExpressionVariables[] = {
+    "thisGroup", "thisNode", "thisParam", "random", "randomInt", "curve", "dimension"
+};
+
+inline bool
+isTrue(const Value& a)
+{
+    return a.v != 0.;
+}
+
+inline Value
+makeFloat(double v)
+{
+    Value ret = { v, false };
+
+    return ret;
+}
+
+inline bool
+makeInt(double v,
+        Value* ret)
+{
+    if (std::fabs(v) >= NATRON_NATIVE_EXPRESSION_MAX_INT) {
+        return false;
+    }
+    ret->v = v == 0. ? 0. : v;
+    ret->isInt = true;
+
+    return true;
+}
+
+inline Value
+makeBool(bool b)
+{
+    Value ret = { b ? 1. : 0., true };
+
+    return ret;
+}
+
+// Python's float floor division and modulo (see float_divmod in floatobject.c)
+void
+floatDivMod(double a,
+            double b,
+            double* div,
+            double* mod)
+{
+    double m = std::fmod(a, b);
+    double d = (a - m) / b;
+
+    if (m != 0.) {
+        if ( (b < 0.) != (m < 0.) ) {
+            m += b;
+            d -= 1.;
+        }
+    } else {
+        m = b < 0. ? -0. : 0.;
+    }
+    if (d != 0.) {
+        double floorDiv = std::floor(d);
+        if (d - floorDiv > 0.5) {
+            floorDiv += 1.;
+        }
+        d = floorDiv;
+    } else {
+        d = (a / b) < 0. ? -0. : 0.;
+    }
+    *div = d;
+    *mod = m;
+}
+
+bool
+applyUnary(OpEnum op,
+           const Value& a,
+           Value* ret)
+{
+    switch (op) {
+    case eOpPositive:
+        *ret = a;
+
+        return true;
+    case eOpNegate:
+        if (a.isInt) {
+            return makeInt(-a.v, ret);
+        }
+        *ret = makeFloat(-a.v);
+
+        return true;
+    case eOpNot:
+        *ret = makeBool( !isTrue(a) );
+
+        return true;
+    default:
+        break;
+    }
+    assert(false);
+
+    return false;
+}
+
+bool
+applyPower(const Value& a,
+           const Value& b,
+           Value* ret)
+{
+    if (a.isInt && b.isInt && b.v >= 0.) {
+        // Exponentiation by squaring, exact as long as the intermediate results are below 2^53
+        double r = 1.;
+        double base = a.v;
+        double e = b.v;
+        for (;;) {
+            if (std::fmod(e, 2.) != 0.) {
+                r *= base;
+                if (std::fabs(r) >= NATRON_NATIVE_EXPRESSION_MAX_INT) {
+                    return false;
+                }
+            }
+            e = std::floor(e / 2.);
+            if (e == 0.) {
+                break;
+            }
+            base *= base;
+            if (std::fabs(base) >= NATRON_NATIVE_EXPRESSION_MAX_INT) {
+                return false;
+            }
+        }
+
+        return makeInt(r, ret);
+    }
+    if (a.v == 0. && b.v < 0.) {
+        // ZeroDivisionError
+        return false;
+    }
+    if ( (a.v < 0.) && (std::floor(b.v) != b.v) ) {
+        // complex result with Python 3, ValueError with Python 2
+        return false;
+    }
+    double r = std::pow(a.v, b.v);
+    if ( !(boost::math::isfinite)(r) && (boost::math::isfinite)(a.v) && (boost::math::isfinite)(b.v) ) {
+        // OverflowError
+        return false;
+    }
+    *ret = makeFloat(r);
+
+    return true;
+}
+
+bool
+applyBinary(OpEnum op,
+            const Value& a,
+            const Value& b,
+            Value* ret)
+{
+    bool isInt = a.isInt && b.isInt;
+
+    switch (op) {
+    case eOpAdd:
+        if (isInt) {
+            return makeInt(a.v + b.v, ret);
+        }
+        *ret = makeFloat(a.v + b.v);
+
+        return true;
+    case eOpSubtract:
+        if (isInt) {
+            return makeInt(a.v - b.v, ret);
+        }
+        *ret = makeFloat(a.v - b.v);
+
+        return true;
+    case eOpMultiply:
+        if (isInt) {
+            return makeInt(a.v * b.v, ret);
+        }
+        *ret = makeFloat(a.v * b.v);
+
+        return true;
+    case eOpDivide:
+    case eOpFloorDivide:
+    case eOpModulo: {
+        if (b.v == 0.) {
+            // ZeroDivisionError
+            return false;
+        }
+#if PY_MAJOR_VERSION >= 3
+        if (op == eOpDivide) {
+            *ret = makeFloat(a.v / b.v);
+
+            return true;
+        }
+#else
+        if ( (op == eOpDivide) && !isInt ) {
+            *ret = makeFloat(a.v / b.v);
+
+            return true;
+        }
+#endif
+        if (isInt) {
+            long long x = (long long)a.v;
+            long long y = (long long)b.v;
+            long long q = x / y;
+            long long r = x % y;
+            if ( (r != 0) && ( (r < 0) != (y < 0) ) ) {
+                r += y;
+                --q;
+            }
+
+            return makeInt( (double)(op == eOpModulo ? r : q), ret );
+        }
+        double div, mod;
+        floatDivMod(a.v, b.v, &div, &mod);
+        *ret = makeFloat(op == eOpModulo ? mod : div);
+
+        return true;
+    }
+    case eOpPower:
+
+        return applyPower(a, b, ret);
+    case eOpLess:
+        *ret = makeBool(a.v < b.v);
+
+        return true;
+    case eOpLessEqual:
+        *ret = makeBool(a.v <= b.v);
+
+        return true;
+    case eOpGreater:
+        *ret = makeBool(a.v > b.v);
+
+        return true;
+    case eOpGreaterEqual:
+        *ret = makeBool(a.v >= b.v);
+
+        return true;
+    case eOpEqual:
+        *ret = makeBool(a.v == b.v);
+
+        return true;
+    case eOpNotEqual:
+        *ret = makeBool(a.v != b.v);
+
+        return true;
+    default:
+        break;
+    }
+    assert(false);
+
+    return false;
+}
+
+bool
+applyFunction(FunctionEnum function,
+              const Value* args,
+              int nArgs,
+              Value* ret)
+{
+    // Builtins
+    switch (function) {
+    case eFunctionAbs:
+        ret->v = std::fabs(args[0].v);
+        ret->isInt = args[0].isInt;
+
+        return true;
+    case eFunctionMin:
+    case eFunctionMax: {
+        // Like Python, return the first of the smallest (largest) arguments, with its type
+        int best = 0;
+        for (int i = 1; i < nArgs; ++i) {
+            if ( (function == eFunctionMin) ? (args[i].v < args[best].v) : (args[i].v > args[best].v) ) {
+                best = i;
+            }
+        }
+        *ret = args[best];
+
+        return true;
+    }
+    case eFunctionInt:
+        if ( !(boost::math::isfinite)(args[0].v) ) {
+            return false;
+        }
+
+        return makeInt( args[0].v < 0. ? std::ceil(args[0].v) : std::floor(args[0].v), ret );
+    case eFunctionFloat:
+        *ret = makeFloat(args[0].v);
+
+        return true;
+    default:
+        break;
+    }
+
+    // The math module raises ValueError or OverflowError instead of returning infinities and NaNs
+    for (int i = 0; i < nArgs; ++i) {
+        if ( !(boost::math::isfinite)(args[i].v) ) {
+            return false;
+        }
+    }
+    double x = args[0].v;
+    double y = nArgs > 1 ? args[1].v : 0.;
+    double r = 0.;
+    bool isInt = false;
+    switch (function) {
+    case eFunctionSin:
+        r = std::sin(x);
+        break;
+    case eFunctionCos:
+        r = std::cos(x);
+        break;
+    case eFunctionTan:
+        r = std::tan(x);
+        break;
+    case eFunctionAsin:
+        r = std::asin(x);
+        break;
+    case eFunctionAcos:
+        r = std::acos(x);
+        break;
+    case eFunctionAtan:
+        r = std::atan(x);
+        break;
+    case eFunctionSinh:
+        r = std::sinh(x);
+        break;
+    case eFunctionCosh:
+        r = std::cosh(x);
+        break;
+    case eFunctionTanh:
+        r = std::tanh(x);
+        break;
+    case eFunctionAsinh:
+        r = boost::math::asinh(x);
+        break;
+    case eFunctionAcosh:
+        r = x < 1. ? NAN : boost::math::acosh(x);
+        break;
+    case eFunctionAtanh:
+        r = std::fabs(x) >= 1. ? NAN : boost::math::atanh(x);
+        break;
+    case eFunctionExp:
+        r = std::exp(x);
+        break;
+    case eFunctionExpm1:
+        r = boost::math::expm1(x);
+        break;
+    case eFunctionLog:
+        if ( (x <= 0.) || ( (nArgs > 1) && (y <= 0.) ) ) {
+            return false;
+        }
+        r = std::log(x);
+        if (nArgs > 1) {
+            double logBase = std::log(y);
+            if (logBase == 0.) {
+                // ZeroDivisionError
+                return false;
+            }
+            r /= logBase;
+        }
+        break;
+    case eFunctionLog10:
+        if (x <= 0.) {
+            return false;
+        }
+        r = std::log10(x);
+        break;
+    case eFunctionLog1p:
+        if (x <= -1.) {
+            return false;
+        }
+        r = boost::math::log1p(x);
+        break;
+    case eFunctionLog2:
+        if (x <= 0.) {
+            return false;
+        }
+        r = std::log(x) / M_LN2;
+        break;
+    case eFunctionSqrt:
+        r = std::sqrt(x);
+        break;
+    case eFunctionFabs:
+        r = std::fabs(x);
+        break;
+    case eFunctionFloor:
+        r = std::floor(x);
+#if PY_MAJOR_VERSION >= 3
+        isInt = true;
+#endif
+        break;
+    case eFunctionCeil:
+        r = std::ceil(x);
+#if PY_MAJOR_VERSION >= 3
+        isInt = true;
+#endif
+        break;
+    case eFunctionTrunc:
+        r = x < 0. ? std::ceil(x) : std::floor(x);
+        isInt = true;
+        break;
+    case eFunctionDegrees:
+        r = x * (180. / M_PI);
+        break;
+    case eFunctionRadians:
+        r = x * (M_PI / 180.);
+        break;
+    case eFunctionAtan2:
+        r = std::atan2(x, y);
+        break;
+    case eFunctionPow:
+        if ( (x == 0.) && (y < 0.) ) {
+            return false;
+        }
+        r = std::pow(x, y);
+        break;
+    case eFunctionFmod:
+        if (y == 0.) {
+            return false;
+        }
+        r = std::fmod(x, y);
+        break;
+    case eFunctionHypot:
+        r = boost::math::hypot(x, y);
+        break;
+    case eFunctionCopysign:
+        r = boost::math::copysign(x, y);
+        break;
+    default:
+        assert(false);
+
+        return false;
+    }
+    if ( !(boost::math::isfinite)(r) ) {
+        return false;
+    }
+    if (isInt) {
+        return makeInt(r, ret);
+    }
+    *ret = makeFloat(r);
+
+    return true;
+} // applyFunction
+
+//////////////////////////////// Tokenizer
+
+enum TokenTypeEnum
+{
+    eTokenEnd = 0,
+    eTokenNumber,
+    eTokenName,
+    eTokenOperator
+};
+
+struct Token
+{
+    TokenTypeEnum type;
+    std::string text;
+    Value number;
+};
+
+inline bool
+isNameStart(char c)
+{
+    return std::isalpha( (unsigned char)c ) || c == '_';
+}
+
+inline bool
+isNameChar(char c)
+{
+    return std::isalnum( (unsigned char)c ) || c == '_';
+}
+
+bool
+tokenizeNumber(const std::string& expr,
+               std::size_t* pos,
+               Token* token)
+{
+    std::size_t start = *pos;
+    std::size_t i = start;
+    std::size_t n = expr.size();
+    bool isFloat = false;
+
+    while ( i < n && std::isdigit( (unsigned char)expr[i] ) ) {
+        ++i;
+    }
+    if ( (i < n) && (expr[i] == '.') ) {
+        isFloat = true;
+        ++i;
+        while ( i < n && std::isdigit( (unsigned char)expr[i] ) ) {
+            ++i;
+        }
+    }
+    if ( (i < n) && ( (expr[i] == 'e') || (expr[i] == 'E') ) ) {
+        isFloat = true;
+        ++i;
+        if ( (i < n) && ( (expr[i] == '+') || (expr[i] == '-') ) ) {
+            ++i;
+        }
+        if ( (i >= n) || !std::isdigit( (unsigned char)expr[i] ) ) {
+            return false;
+        }
+        while ( i < n && std::isdigit( (unsigned char)expr[i] ) ) {
+            ++i;
+        }
+    }
+    // Hexadecimal, octal, imaginary and long literals, digit separators...
+    if ( (i < n) && ( isNameChar(expr[i]) || (expr[i] == '.') ) ) {
+        return false;
+    }
+    std::string text = expr.substr(start, i - start);
+    if ( (text == ".") ) {
+        return false;
+    }
+    if ( !isFloat && (text.size() > 1) && (text[0] == '0') && ( text.find_first_not_of('0') != std::string::npos ) ) {
+        // Leading zeros are octal literals with Python 2 and a syntax error with Python 3
+        return false;
+    }
+
+    std::istringstream ss(text);
+    ss.imbue( std::locale::classic() );
+    double v;
+    ss >> v;
+    if ( ss.fail() ) {
+        return false;
+    }
+    token->type = eTokenNumber;
+    token->text = text;
+    if (isFloat) {
+        token->number = makeFloat(v);
+    } else if ( !makeInt(v, &token->number) ) {
+        return false;
+    }
+    *pos = i;
+
+    return true;
+} // tokenizeNumber
+
+bool
+tokenize(const std::string& expr,
+         std::vector<Token>* tokens)
+{
+    // Longest operators first
+    static const char* const operators[] = {
+        "**", "//", "<=", ">=", "==", "!=", "+", "-", "*", "/", "%", "<", ">", "(", ")", ",", "."
+    };
+    std::size_t pos = 0;
+    std::size_t n = expr.size();
+
+    while (pos < n) {
+        char c = expr[pos];
+        if ( (c == ' ') || (c == '\t') ) {
+            ++pos;
+            continue;
+        }
+        Token token;
+        token.number = makeFloat(0.);
+        if ( std::isdigit( (unsigned char)c ) || ( (c == '.') && (pos + 1 < n) && std::isdigit( (unsigned char)expr[pos + 1] ) ) ) {
+            if ( !tokenizeNumber(expr, &pos, &token) ) {
+                return false;
+            }
+        } else if ( isNameStart(c) ) {
+            std::size_t start = pos;
+            while ( pos < n && isNameChar(expr[pos]) ) {
+                ++pos;
+            }
+            token.type = eTokenName;
+            token.text = expr.substr(start, pos - start);
+        } else {
+            bool found = false;
+            for (std::size_t i = 0; i < sizeof(operators) / sizeof(operators[0]); ++i) {
+                std::size_t len = std::strlen(operators[i]);
+                if (expr.compare(pos, len, operators[i]) == 0) {
+                    token.type = eTokenOperator;
+                    token.text = operators[i];
+                    pos += len;
+                    found = true;
+                    break;
+                }
+            }
+            if (!found) {
+                // Strings, subscripts, assignments, comments...
+                return false;
+            }
+        }
+        tokens->push_back(token);
+    }
+    Token end;
+    end.type = eTokenEnd;
+    end.number = makeFloat(0.);
+    tokens->push_back(end);
+
+    return true;
+} // tokenize
+
+//////////////////////////////// Syntax tree
+
+enum NodeTypeEnum
+{
+    eNodeConstant = 0,
+    eNodeFrame,
+    eNodeView,
+    eNodeUnary,
+    eNodeBinary,
+    eNodeAnd,
+    eNodeOr,
+    eNodeConditional, // children: condition, value if true, value if false
+    eNodeCall,
+    eNodeParamValue, // at the current time
+    eNodeParamValueAtTime, // child: time
+    eNodeParamCurve // child: time
+};
+
+struct ExprNode;
+typedef boost::shared_ptr<ExprNode> ExprNodePtr;
+
+struct ExprNode
+{
+    NodeTypeEnum type;
+    Value value; // eNodeConstant
+    OpEnum op; // eNodeUnary, eNodeBinary
+    FunctionEnum function; // eNodeCall
+    int param, dimension; // eNodeParam*
+    bool isInt; // eNodeParam*
+    std::vector<ExprNodePtr> children;
+
+    explicit ExprNode(NodeTypeEnum type)
+        : type(type)
+        , value( makeFloat(0.) )
+        , op(eOpConstant)
+        , function(eFunctionAbs)
+        , param(-1)
+        , dimension(0)
+        , isInt(false)
+        , children()
+    {
+    }
+};
+
+ExprNodePtr
+makeConstant(const Value& value)
+{
+    ExprNodePtr ret( new ExprNode(eNodeConstant) );
+
+    ret->value = value;
+
+    return ret;
+}
+
+// Recursive descent parser of the Python expression grammar, restricted to the supported subset. Constant sub-expressions are folded.
+class ExpressionParser
+{
+    const std::vector<Token>& _tokens;
+    std::size_t _pos;
+    const NativeExpressionContext& _context;
+    std::vector<NativeExpressionParamPtr>* _params;
+
+public:
+
+    ExpressionParser(const std::vector<Token>& tokens,
+                     const NativeExpressionContext& context,
+                     std::vector<NativeExpressionParamPtr>* params)
+        : _tokens(tokens)
+        , _pos(0)
+        , _context(context)
+        , _params(params)
+    {
+    }
+
+    // Returns NULL if the expression is not supported
+    ExprNodePtr parse()
+    {
+        ExprNodePtr ret = parseTest();
+
+        if ( !ret || (peek().type != eTokenEnd) ) {
+            return ExprNodePtr();
+        }
+
+        return ret;
+    }
+
+private:
+
+    const Token& peek(std::size_t offset = 0) const
+    {
+        std::size_t i = std::min(_pos + offset, _tokens.size() - 1);
+
+        return _tokens[i];
+    }
+
+    bool isToken(TokenTypeEnum type,
+                 const char* text,
+                 std::size_t offset = 0) const
+    {
+        const Token& t = peek(offset);
+
+        return t.type == type && t.text == text;
+    }
+
+    bool accept(TokenTypeEnum type,
+                const char* text)
+    {
+        if ( isToken(type, text) ) {
+            ++_pos;
+
+            return true;
+        }
+
+        return false;
+    }
+
+    static ExprNodePtr makeUnary(OpEnum op,
+                                 const ExprNodePtr& a)
+    {
+        if (a->type == eNodeConstant) {
+            Value v;
+            if ( applyUnary(op, a->value, &v) ) {
+                return makeConstant(v);
+            }
+        }
+        ExprNodePtr ret( new ExprNode(eNodeUnary) );
+        ret->op = op;
+        ret->children.push_back(a);
+
+        return ret;
+    }
+
+    static ExprNodePtr makeBinary(OpEnum op,
+                                  const ExprNodePtr& a,
+                                  const ExprNodePtr& b)
+    {
+        if ( (a->type == eNodeConstant) && (b->type == eNodeConstant) ) {
+            Value v;
+            // Operations raising an exception are not folded, they fail at evaluation
+            if ( applyBinary(op, a->value, b->value, &v) ) {
+                return makeConstant(v);
+            }
+        }
+        ExprNodePtr ret( new ExprNode(eNodeBinary) );
+        ret->op = op;
+        ret->children.push_back(a);
+        ret->children.push_back(b);
+
+        return ret;
+    }
+
+    // test: or_test ['if' or_test 'else' test]
+    ExprNodePtr parseTest()
+    {
+        ExprNodePtr body = parseOrTest();
+
+        if ( !body || !accept(eTokenName, "if") ) {
+            return body;
+        }
+        ExprNodePtr condition = parseOrTest();
+        if ( !condition || !accept(eTokenName, "else") ) {
+            return ExprNodePtr();
+        }
+        ExprNodePtr orElse = parseTest();
+        if (!orElse) {
+            return ExprNodePtr();
+        }
+        if (condition->type == eNodeConstant) {
+            return isTrue(condition->value) ? body : orElse;
+        }
+        ExprNodePtr ret( new ExprNode(eNodeConditional) );
+        ret->children.push_back(condition);
+        ret->children.push_back(body);
+        ret->children.push_back(orElse);
+
+        return ret;
+    }
+
+    // or_test: and_test ('or' and_test)*, and_test: not_test ('and' not_test)*
+    ExprNodePtr parseBoolean(bool isOr)
+    {
+        ExprNodePtr a = isOr ? parseBoolean(false) : parseNotTest();
+
+        while ( a && accept(eTokenName, isOr ? "or" : "and") ) {
+            ExprNodePtr b = isOr ? parseBoolean(false) : parseNotTest();
+            if (!b) {
+                return ExprNodePtr();
+            }
+            if (a->type == eNodeConstant) {
+                // Like Python, return the first operand deciding of the result
+                if (isTrue(a->value) != isOr) {
+                    a = b;
+                }
+                continue;
+            }
+            ExprNodePtr node( new ExprNode(isOr ? eNodeOr : eNodeAnd) );
+            node->children.push_back(a);
+            node->children.push_back(b);
+            a = node;
+        }
+
+        return a;
+    }
+
+    ExprNodePtr parseOrTest()
+    {
+        return parseBoolean(true);
+    }
+
+    // not_test: 'not' not_test | comparison
+    ExprNodePtr parseNotTest()
+    {
+        if ( accept(eTokenName, "not") ) {
+            ExprNodePtr a = parseNotTest();
+
+            return a ? makeUnary(eOpNot, a) : a;
+        }
+
+        return parseComparison();
+    }
+
+    bool acceptComparison(OpEnum* op)
+    {
+        static const struct
+        {
+            const char* text;
+            OpEnum op;
+        } comparisons[] = {
+            { "<", eOpLess }, { "<=", eOpLessEqual }, { ">", eOpGreater }, { ">=", eOpGreaterEqual }, { "==", eOpEqual }, { "!=", eOpNotEqual }
+        };
+
+        for (std::size_t i = 0; i < sizeof(comparisons) / sizeof(comparisons[0]); ++i) {
+            if ( accept(eTokenOperator, comparisons[i].text) ) {
+                *op = comparisons[i].op;
+
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // comparison: arith_expr (comp_op arith_expr)*, only a single comparison is supported
+    ExprNodePtr parseComparison()
+    {
+        ExprNodePtr a = parseArith();
+        OpEnum op;
+
+        if ( !a || !acceptComparison(&op) ) {
+            return a;
+        }
+        ExprNodePtr b = parseArith();
+        if ( !b || acceptComparison(&op) ) {
+            // Chained comparisons are left to Python
+            return ExprNodePtr();
+        }
+
+        return makeBinary(op, a, b);
+    }
+
+    // arith_expr: term (('+'|'-') term)*
+    ExprNodePtr parseArith()
+    {
+        ExprNodePtr a = parseTerm();
+
+        while (a) {
+            OpEnum op;
+            if ( accept(eTokenOperator, "+") ) {
+                op = eOpAdd;
+            } else if ( accept(eTokenOperator, "-") ) {
+                op = eOpSubtract;
+            } else {
+                break;
+            }
+            ExprNodePtr b = parseTerm();
+            if (!b) {
+                return ExprNodePtr();
+            }
+            a = makeBinary(op, a, b);
+        }
+
+        return a;
+    }
+
+    // term: factor (('*'|'/'|'%'|'//') factor)*
+    ExprNodePtr parseTerm()
+    {
+        ExprNodePtr a = parseFactor();
+
+        while (a) {
+            OpEnum op;
+            if ( accept(eTokenOperator, "*") ) {
+                op = eOpMultiply;
+            } else if ( accept(eTokenOperator, "/") ) {
+                op = eOpDivide;
+            } else if ( accept(eTokenOperator, "//") ) {
+                op = eOpFloorDivide;
+            } else if ( accept(eTokenOperator, "%") ) {
+                op = eOpModulo;
+            } else {
+                break;
+            }
+            ExprNodePtr b = parseFactor();
+            if (!b) {
+                return ExprNodePtr();
+            }
+            a = makeBinary(op, a, b);
+        }
+
+        return a;
+    }
+
+    // factor: ('+'|'-') factor | power
+    ExprNodePtr parseFactor()
+    {
+        OpEnum op;
+
+        if ( accept(eTokenOperator, "-") ) {
+            op = eOpNegate;
+        } else if ( accept(eTokenOperator, "+") ) {
+            op = eOpPositive;
+        } else {
+            return parsePower();
+        }
+        ExprNodePtr a = parseFactor();
+
+        return a ? makeUnary(op, a) : a;
+    }
+
+    // power: atom trailer* ['**' factor]
+    ExprNodePtr parsePower()
+    {
+        ExprNodePtr a = parseAtom();
+
+        if ( !a || !accept(eTokenOperator, "**") ) {
+            return a;
+        }
+        ExprNodePtr b = parseFactor();
+        if (!b) {
+            return ExprNodePtr();
+        }
+
+        return makeBinary(eOpPower, a, b);
+    }
+
+    ExprNodePtr parseAtom()
+    {
+        const Token& t = peek();
+
+        if (t.type == eTokenNumber) {
+            ++_pos;
+
+            return makeConstant(t.number);
+        }
+        if ( accept(eTokenOperator, "(") ) {
+            ExprNodePtr a = parseTest();
+            if ( !a || !accept(eTokenOperator, ")") ) {
+                // Tuples are not supported
+                return ExprNodePtr();
+            }
+
+            return a;
+        }
+        if (t.type != eTokenName) {
+            return ExprNodePtr();
+        }
+
+        // A dotted name, e.g. Blur1.size.getValue
+        std::vector<std::string> path;
+        path.push_back(t.text);
+        ++_pos;
+        while ( isToken(eTokenOperator, ".") && (peek(1).type == eTokenName) ) {
+            path.push_back(peek(1).text);
+            _pos += 2;
+        }
+        if ( !accept(eTokenOperator, "(") ) {
+            return parseVariable(path);
+        }
+        std::vector<ExprNodePtr> args;
+        if ( !accept(eTokenOperator, ")") ) {
+            for (;;) {
+                ExprNodePtr arg = parseTest();
+                if (!arg) {
+                    return ExprNodePtr();
+                }
+                args.push_back(arg);
+                if ( accept(eTokenOperator, ")") ) {
+                    break;
+                }
+                if ( !accept(eTokenOperator, ",") ) {
+                    return ExprNodePtr();
+                }
+            }
+        }
+
+        return parseCall(path, args);
+    } // parseAtom
+
+    static bool isExpressionVariable(const std::string& name)
+    {
+        for (std::size_t i = 0; i < sizeof(kExpressionVariables) / sizeof(kExpressionVariables[0]); ++i) {
+            if (name == kExpressionVariables[i]) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    ExprNodePtr parseVariable(const std::vector<std::string>& path)
+    {
+        if (path.size() != 1) {
+            // Attributes of parameters and nodes
+            return ExprNodePtr();
+        }
+        const std::string& name = path[0];
+        if (name == "dimension") {
+            Value v;
+            makeInt(_context.getDimension(), &v);
+
+            return makeConstant(v);
+        }
+        if ( isExpressionVariable(name) || _context.isScopeName(name) ) {
+            return ExprNodePtr();
+        }
+        if (name == "frame") {
+            return ExprNodePtr( new ExprNode(eNodeFrame) );
+        }
+        if (name == "view") {
+            return ExprNodePtr( new ExprNode(eNodeView) );
+        }
+        if ( (name == "True") || (name == "False") ) {
+            return makeConstant( makeBool(name == "True") );
+        }
+        if (name == "pi") {
+            return makeConstant( makeFloat(M_PI) );
+        }
+        if (name == "e") {
+            return makeConstant( makeFloat(M_E) );
+        }
+#if PY_MAJOR_VERSION >= 3
+        if (name == "tau") {
+            return makeConstant( makeFloat(2. * M_PI) );
+        }
+#endif
+
+        return ExprNodePtr();
+    }
+
+    // Returns the dimension given by a constant argument, or -1 if it is not valid
+    static int getDimensionArgument(const ExprNodePtr& arg,
+                                    const NativeExpressionParam& param)
+    {
+        if ( (arg->type != eNodeConstant) || !arg->value.isInt || (arg->value.v < 0.) || ( arg->value.v >= param.getDimension() ) ) {
+            return -1;
+        }
+
+        return (int)arg->value.v;
+    }
+
+    ExprNodePtr makeParamNode(NodeTypeEnum type,
+                              int paramIndex,
+                              int dimension,
+                              bool isInt,
+                              const ExprNodePtr& time)
+    {
+        ExprNodePtr ret( new ExprNode(type) );
+
+        ret->param = paramIndex;
+        ret->dimension = dimension;
+        ret->isInt = isInt;
+        if (time) {
+            ret->children.push_back(time);
+        }
+
+        return ret;
+    }
+
+    int addParam(const NativeExpressionParamPtr& param)
+    {
+        std::vector<NativeExpressionParamPtr>::iterator found = std::find(_params->begin(), _params->end(), param);
+
+        if ( found != _params->end() ) {
+            return (int)( found - _params->begin() );
+        }
+        _params->push_back(param);
+
+        return (int)_params->size() - 1;
+    }
+
+    // param.curve(time, dimension = 0)
+    ExprNodePtr parseCurve(const NativeExpressionParamPtr& param,
+                           const std::vector<ExprNodePtr>& args)
+    {
+        if ( !param || args.empty() || (args.size() > 2) ) {
+            return ExprNodePtr();
+        }
+        int dimension = args.size() > 1 ? getDimensionArgument(args[1], *param) : 0;
+        if (dimension < 0) {
+            return ExprNodePtr();
+        }
+
+        return makeParamNode(eNodeParamCurve, addParam(param), dimension, false, args[0]);
+    }
+
+    // param.get([time]), followed by an attribute of the tuple for multi-dimensional parameters
+    ExprNodePtr parseGet(const NativeExpressionParamPtr& param,
+                         const std::vector<ExprNodePtr>& args)
+    {
+        if (args.size() > 1) {
+            return ExprNodePtr();
+        }
+        ExprNodePtr time = args.empty() ? ExprNodePtr() : args[0];
+        int nDims = param->getDimension();
+        int dimension = 0;
+        if (nDims > 1) {
+            if ( !isToken(eTokenOperator, ".") || (peek(1).type != eTokenName) ) {
+                // Tuples are not supported
+                return ExprNodePtr();
+            }
+            const std::string& attr = peek(1).text;
+            _pos += 2;
+            const char* attrs = param->isColor() ? "rgba" : "xyz";
+            const char* found = attr.size() == 1 ? std::strchr(attrs, attr[0]) : NULL;
+            if (!found) {
+                return ExprNodePtr();
+            }
+            dimension = (int)(found - attrs);
+            if (dimension >= nDims) {
+                if ( param->isColor() && (dimension == 3) && ( !time || (time->type == eNodeConstant) ) ) {
+                    // ColorTuple.a is 1 for RGB parameters
+                    return makeConstant( makeFloat(1.) );
+                }
+
+                return ExprNodePtr();
+            }
+        }
+
+        return makeParamNode(time ? eNodeParamValueAtTime : eNodeParamValue, addParam(param), dimension, param->isIntegral(), time);
+    }
+
+    ExprNodePtr parseCall(std::vector<std::string> path,
+                          const std::vector<ExprNodePtr>& args)
+    {
+        if (path.size() == 1) {
+            const std::string& name = path[0];
+            if (name == "curve") {
+                return parseCurve(_context.getParam( std::vector<std::string>( 1, std::string("thisParam") ) ), args);
+            }
+            if ( isExpressionVariable(name) || _context.isScopeName(name) || (name == "frame") || (name == "view") ) {
+                return ExprNodePtr();
+            }
+            for (std::size_t i = 0; i < sizeof(kFunctions) / sizeof(kFunctions[0]); ++i) {
+                const FunctionDesc& desc = kFunctions[i];
+                if (name != desc.name) {
+                    continue;
+                }
+                if ( ( (int)args.size() < desc.minArgs ) || ( (desc.maxArgs >= 0) && ( (int)args.size() > desc.maxArgs ) ) ) {
+                    return ExprNodePtr();
+                }
+                bool allConstant = true;
+                std::vector<Value> values;
+                for (std::size_t j = 0; j < args.size(); ++j) {
+                    allConstant &= args[j]->type == eNodeConstant;
+                    values.push_back(args[j]->value);
+                }
+                Value v;
+                if ( allConstant && applyFunction(desc.function, &values[0], (int)values.size(), &v) ) {
+                    return makeConstant(v);
+                }
+                ExprNodePtr ret( new ExprNode(eNodeCall) );
+                ret->function = desc.function;
+                ret->children = args;
+
+                return ret;
+            }
+
+            return ExprNodePtr();
+        }
+
+        std::string method = path.back();
+        path.pop_back();
+        NativeExpressionParamPtr param = _context.getParam(path);
+        if (!param) {
+            return ExprNodePtr();
+        }
+        if (method == "get") {
+            return parseGet(param, args);
+        }
+        if (method == "curve") {
+            return parseCurve(param, args);
+        }
+        if ( (method != "getValue") && (method != "getValueAtTime") ) {
+            return ExprNodePtr();
+        }
+        bool atTime = method == "getValueAtTime";
+        std::size_t nTimeArgs = atTime ? 1 : 0;
+        if ( (args.size() < nTimeArgs) || (args.size() > nTimeArgs + 1) ) {
+            return ExprNodePtr();
+        }
+        int dimension = 0;
+        if (args.size() > nTimeArgs) {
+            if ( !param->hasDimensionArgument() ) {
+                return ExprNodePtr();
+            }
+            dimension = getDimensionArgument(args[nTimeArgs], *param);
+            if (dimension < 0) {
+                return ExprNodePtr();
+            }
+        }
+
+        return makeParamNode(atTime ? eNodeParamValueAtTime : eNodeParamValue, addParam(param), dimension, param->isIntegral(),
+                             atTime ? args[0] : ExprNodePtr());
+    } // parseCall
+};
+
+struct Instruction
+{
+    OpEnum op;
+    int index; // jump target, function or parameter
+    int count; // number of arguments of a function, dimension of a parameter
+    Value value; // eOpConstant, and whether parameter values are ints
+};
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+struct NativeExpressionPrivate
+{
+    std::vector<Instruction> code;
+    std::vector<NativeExpressionParamPtr> params;
+    int stackSize;
+
+    NativeExpressionPrivate()
+        : code()
+        , params()
+        , stackSize(0)
+    {
+    }
+
+    int emit(OpEnum op,
+             int index = 0,
+             int count = 0)
+    {
+        Instruction i;
+
+        i.op = op;
+        i.index = index;
+        i.count = count;
+        i.value = makeFloat(0.);
+        code.push_back(i);
+
+        return (int)code.size() - 1;
+    }
+
+    // Generates the code of node, which pushes a single value. depth is the stack size before the node is evaluated.
+    void generate(const ExprNode& node,
+                  int depth)
+    {
+        stackSize = std::max(stackSize, depth + 1);
+        switch (node.type) {
+        case eNodeConstant:
+            code[emit(eOpConstant)].value = node.value;
+            break;
+        case eNodeFrame:
+            emit(eOpFrame);
+            break;
+        case eNodeView:
+            emit(eOpView);
+            break;
+        case eNodeUnary:
+            generate(*node.children[0], depth);
+            emit(node.op);
+            break;
+        case eNodeBinary:
+            generate(*node.children[0], depth);
+            generate(*node.children[1], depth + 1);
+            emit(node.op);
+            break;
+        case eNodeAnd:
+        case eNodeOr: {
+            generate(*node.children[0], depth);
+            int jump = emit(node.type == eNodeAnd ? eOpJumpIfFalseOrPop : eOpJumpIfTrueOrPop);
+            generate(*node.children[1], depth);
+            code[jump].index = (int)code.size();
+            break;
+        }
+        case eNodeConditional: {
+            generate(*node.children[0], depth);
+            int jumpToElse = emit(eOpJumpIfFalse);
+            generate(*node.children[1], depth);
+            int jumpToEnd = emit(eOpJump);
+            code[jumpToElse].index = (int)code.size();
+            generate(*node.children[2], depth);
+            code[jumpToEnd].index = (int)code.size();
+            break;
+        }
+        case eNodeCall:
+            for (std::size_t i = 0; i < node.children.size(); ++i) {
+                generate(*node.children[i], depth + (int)i);
+            }
+            emit(eOpCall, node.function, (int)node.children.size());
+            break;
+        case eNodeParamValue:
+        case eNodeParamValueAtTime:
+        case eNodeParamCurve: {
+            if ( !node.children.empty() ) {
+                generate(*node.children[0], depth);
+            }
+            OpEnum op = node.type == eNodeParamValue ? eOpParamValue : (node.type == eNodeParamValueAtTime ? eOpParamValueAtTime : eOpParamCurve);
+            code[emit(op, node.param, node.dimension)].value.isInt = node.isInt;
+            break;
+        }
+        } // switch
+    } // generate
+
+    bool run(double time, ViewIdx view, Value* stack, Value* result) const;
+};
+
+bool
+NativeExpressionPrivate::run(double time,
+                             ViewIdx view,
+                             Value* stack,
+                             Value* result) const
+{
+    int sp = 0; // number of values on the stack
+    int pc = 0;
+    int nInstructions = (int)code.size();
+
+    while (pc < nInstructions) {
+        const Instruction& ins = code[pc];
+        ++pc;
+        switch (ins.op) {
+        case eOpConstant:
+            stack[sp++] = ins.value;
+            break;
+        case eOpFrame:
+            // The frame is passed to Python as an int if it is integral
+            stack[sp].v = time;
+            stack[sp].isInt = std::floor(time) == time && std::fabs(time) < NATRON_NATIVE_EXPRESSION_MAX_INT;
+            ++sp;
+            break;
+        case eOpView:
+            stack[sp].v = (double)(int)view;
+            stack[sp].isInt = true;
+            ++sp;
+            break;
+        case eOpPositive:
+        case eOpNegate:
+        case eOpNot:
+            if ( !applyUnary(ins.op, stack[sp - 1], &stack[sp - 1]) ) {
+                return false;
+            }
+            break;
+        case eOpAdd:
+        case eOpSubtract:
+        case eOpMultiply:
+        case eOpDivide:
+        case eOpFloorDivide:
+        case eOpModulo:
+        case eOpPower:
+        case eOpLess:
+        case eOpLessEqual:
+        case eOpGreater:
+        case eOpGreaterEqual:
+        case eOpEqual:
+        case eOpNotEqual:
+            --sp;
+            if ( !applyBinary(ins.op, stack[sp - 1], stack[sp], &stack[sp - 1]) ) {
+                return false;
+            }
+            break;
+        case eOpJump:
+            pc = ins.index;
+            break;
+        case eOpJumpIfFalse:
+            --sp;
+            if ( !isTrue(stack[sp]) ) {
+                pc = ins.index;
+            }
+            break;
+        case eOpJumpIfFalseOrPop:
+            if ( !isTrue(stack[sp - 1]) ) {
+                pc = ins.index;
+            } else {
+                --sp;
+            }
+            break;
+        case eOpJumpIfTrueOrPop:
+            if ( isTrue(stack[sp - 1]) ) {
+                pc = ins.index;
+            } else {
+                --sp;
+            }
+            break;
+        case eOpCall:
+            sp -= ins.count;
+            if ( !applyFunction( (FunctionEnum)ins.index, &stack[sp], ins.count, &stack[sp] ) ) {
+                return false;
+            }
+            ++sp;
+            break;
+        case eOpParamValue:
+        case eOpParamValueAtTime:
+        case eOpParamCurve: {
+            const NativeExpressionParam& param = *params[ins.index];
+            bool ok;
+            double v;
+            if (ins.op == eOpParamValue) {
+                ok = param.getValue(ins.count, &v);
+                ++sp;
+            } else if (ins.op == eOpParamValueAtTime) {
+                ok = param.getValueAtTime(stack[sp - 1].v, ins.count, &v);
+            } else {
+                ok = param.getCurveValue(stack[sp - 1].v, ins.count, &v);
+            }
+            if (!ok) {
+                return false;
+            }
+            stack[sp - 1].v = v;
+            stack[sp - 1].isInt = ins.value.isInt;
+            break;
+        }
+        } // switch
+    }
+    assert(sp == 1);
+    *result = stack[0];
+
+    return true;
+} // NativeExpressionPrivate::run
+
+NativeExpression::NativeExpression()
+    : _imp( new NativeExpressionPrivate() )
+{
+}
+
+NativeExpression::~NativeExpression()
+{
+}
+
+NativeExpressionPtr
+NativeExpression::compile(const std::string& expression,
+                          const NativeExpressionContext& context)
+{
+    std::vector<Token> tokens;
+
+    if ( !tokenize(expression, &tokens) ) {
+        return NativeExpressionPtr();
+    }
+    NativeExpressionPtr ret( new NativeExpression() );
+    ExpressionParser parser(tokens, context, &ret->_imp->params);
+    ExprNodePtr root = parser.parse();
+    if (!root) {
+        return NativeExpressionPtr();
+    }
+    ret->_imp->generate(*root, 0);
+
+    return ret;
+}
+
+bool
+NativeExpression::evaluate(double time,
+                           ViewIdx view,
+                           double* result,
+                           bool* isInt) const
+{
+    Value localStack[NATRON_NATIVE_EXPRESSION_LOCAL_STACK_SIZE];
+    std::vector<Value> heapStack;
+    Value* stack = localStack;
+
+    if (_imp->stackSize > NATRON_NATIVE_EXPRESSION_LOCAL_STACK_SIZE) {
+        heapStack.resize(_imp->stackSize);
+        stack = &heapStack[0];
+    }
+    Value ret;
+    if ( !_imp->run(time, view, stack, &ret) ) {
+        return false;
+    }
+    *result = ret.v;
+    *isInt = ret.isInt;
+
+    return true;
+}
+
+NATRON_NAMESPACE_EXIT
@@ -0,0 +1,145 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ * Copyright (C) 2018-2020 The Natron developers
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_NATIVEEXPRESSION_H
+#define NATRON_ENGINE_NATIVEEXPRESSION_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <string>
+#include <vector>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#endif
+
+#include "Global/GlobalDefines.h"
+
+#include "Engine/ViewIdx.h"
+#include "Engine/EngineFwd.h"
+
+NATRON_NAMESPACE_ENTER
+
+/**
+ * @brief Read access to a parameter referenced by a NativeExpression, mirroring the Param class of the Python API.
+ **/
+class NativeExpressionParam
+{
+public:
+
+    virtual ~NativeExpressionParam() {}
+
+    virtual int getDimension() const = 0;
+
+    /**
+     * @brief True if the values of the parameter are a Python int (IntParam, BooleanParam, ChoiceParam) rather than a float.
+     **/
+    virtual bool isIntegral() const = 0;
+
+    /**
+     * @brief True if get() returns a ColorTuple (r, g, b, a) rather than a 2D/3D tuple (x, y, z).
+     **/
+    virtual bool isColor() const = 0;
+
+    /**
+     * @brief True if getValue() and getValueAtTime() take a dimension argument.
+     **/
+    virtual bool hasDimensionArgument() const = 0;
+
+    /**
+     * @brief Same as Param.getValue(dimension), getValueAtTime(time, dimension) and curve(time, dimension).
+     * Returns false if the parameter no longer exists.
+     **/
+    virtual bool getValue(int dimension, double* value) const = 0;
+    virtual bool getValueAtTime(double time, int dimension, double* value) const = 0;
+    virtual bool getCurveValue(double time, int dimension, double* value) const = 0;
+};
+
+/**
+ * @brief Resolves the names used by an expression when it is compiled.
+ **/
+class NativeExpressionContext
+{
+public:
+
+    virtual ~NativeExpressionContext() {}
+
+    /**
+     * @brief The dimension of the parameter holding the expression, bound to the "dimension" variable.
+     **/
+    virtual int getDimension() const = 0;
+
+    /**
+     * @brief Returns the parameter designated by an attribute path such as {thisParam}, {thisNode, size}, {Blur1, size} or
+     * {thisGroup, Blur1, size}, or NULL if it cannot be read natively.
+     **/
+    virtual NativeExpressionParamPtr getParam(const std::vector<std::string>& path) const = 0;
+
+    /**
+     * @brief True if name is defined in the scope of the expression by Natron (e.g. app or the name of a node), in which case
+     * it hides the variables of the math module.
+     **/
+    virtual bool isScopeName(const std::string& name) const = 0;
+};
+
+/**
+ * @brief A single line knob expression compiled to bytecode, that is evaluated without the Python interpreter, hence without
+ * holding the GIL, so that render threads evaluating expressions concurrently do not serialize.
+ *
+ * Only a subset of the language is supported: numbers, frame, view, dimension, the arithmetic, comparison and boolean operators,
+ * conditional expressions, the functions and constants of the math module, abs/min/max/int/float, and reading the numeric parameters
+ * with get(), getValue(), getValueAtTime() and curve(). The results follow the Python semantics, including the int/float distinction.
+ * Any other expression is not compiled and must be evaluated by Python.
+ **/
+struct NativeExpressionPrivate;
+class NativeExpression
+{
+    NativeExpression();
+
+public:
+
+    ~NativeExpression();
+
+    /**
+     * @brief Compiles the body of a single line expression. Returns NULL if the expression uses features that are not supported natively.
+     **/
+    static NativeExpressionPtr compile(const std::string& expression, const NativeExpressionContext& context);
+
+    /**
+     * @brief Evaluates the expression at the given time and view. isInt is set to true if the result is a Python int (or bool), and false
+     * if it is a float. Returns false if Python would have raised an exception (e.g. a division by zero or a math domain error) or if a
+     * parameter no longer exists: the expression must then be evaluated by Python, which reports the error.
+     **/
+    bool evaluate(double time, ViewIdx view, double* result, bool* isInt) const;
+
+private:
+
+    boost::scoped_ptr<NativeExpressionPrivate> _imp;
+};
+
+NATRON_NAMESPACE_EXIT
+
+#endif // NATRON_ENGINE_NATIVEEXPRESSION_H
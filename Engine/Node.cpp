@@ -802,8 +802,20 @@ Node::computeHashInternal()
 
         oldHash = _imp->hash.value();
 
-        ///reset the hash value
-        _imp->hash.reset();
+        ///Append the effect's label to distinguish 2 instances with the same parameters
+        ///and the project's creation time because 2 projects opened concurrently
+        ///could reproduce the same (especially simple graphs like Viewer-Reader).
+        ///These rarely change: their contribution is kept in hashPrefix and the hash restarts from it.
+        const std::string & scriptName = getScriptName();
+        qint64 creationTime =  getApp()->getProject()->getProjectCreationTime();
+        if ( !_imp->hashPrefix.size() || (_imp->hashPrefixScriptName != scriptName) || (_imp->hashPrefixCreationTime != creationTime) ) {
+            _imp->hashPrefix.reset();
+            Hash64_appendQString( &_imp->hashPrefix, QString::fromUtf8( scriptName.c_str() ) );
+            _imp->hashPrefix.append(creationTime);
+            _imp->hashPrefixScriptName = scriptName;
+            _imp->hashPrefixCreationTime = creationTime;
+        }
+        _imp->hash = _imp->hashPrefix;
 
         ///append the effect's own age
         _imp->hash.append(_imp->knobsAge);
@@ -854,14 +866,6 @@ Node::computeHashInternal()
         //            _imp->hash.append(rotoAge);
         //        }
 
-        ///Also append the effect's label to distinguish 2 instances with the same parameters
-        Hash64_appendQString( &_imp->hash, QString::fromUtf8( getScriptName().c_str() ) );
-
-        ///Also append the project's creation time in the hash because 2 projects opened concurrently
-        ///could reproduce the same (especially simple graphs like Viewer-Reader)
-        qint64 creationTime =  getApp()->getProject()->getProjectCreationTime();
-        _imp->hash.append(creationTime);
-
         _imp->hash.computeHash();
 
         newHash = _imp->hash.value();
@@ -1309,6 +1313,22 @@ Node::getKnobsAge() const
     return _imp->knobsAge;
 }
 
+U64
+Node::getSerializationAge() const
+{
+    QMutexLocker l(&_imp->serializationAgeMutex);
+
+    return _imp->serializationAge;
+}
+
+void
+Node::incrementSerializationAge()
+{
+    QMutexLocker l(&_imp->serializationAgeMutex);
+
+    ++_imp->serializationAge;
+}
+
 bool
 Node::isRenderingPreview() const
 {
@@ -3254,6 +3274,96 @@ renderPreviewForDepth(const Image & srcImg,
     }
 }     // renderPreviewForDepth
 
+///Fills the preview buffer from an image of any resolution
+void
+renderPreviewFromImage(const AppInstancePtr& app,
+                       const Image& img,
+                       int *width,
+                       int *height,
+                       unsigned int* buf)
+{
+    int elemCount = img.getComponents().getNumComponents();
+
+    ///we convert only when input is Linear.
+    //Rec709 and srGB is acceptable for preview
+    bool convertToSrgb = app->getDefaultColorSpaceForBitDepth( img.getBitDepth() ) == eViewerColorSpaceLinear;
+
+    switch ( img.getBitDepth() ) {
+    case eImageBitDepthByte: {
+        renderPreviewForDepth<unsigned char, 255>(img, elemCount, width, height, convertToSrgb, buf);
+        break;
+    }
+    case eImageBitDepthShort: {
+        renderPreviewForDepth<unsigned short, 65535>(img, elemCount, width, height, convertToSrgb, buf);
+        break;
+    }
+    case eImageBitDepthHalf:
+        break;
+    case eImageBitDepthFloat: {
+        renderPreviewForDepth<float, 1>(img, elemCount, width, height, convertToSrgb, buf);
+        break;
+    }
+    case eImageBitDepthNone:
+        break;
+    }
+}
+
+/**
+ * @brief Returns an image of the effect at the given time already in the cache, e.g. rendered for a viewer, that covers the whole
+ * rod and has a resolution at least as high as mipMapLevel, so that the preview can be sampled from it instead of being rendered.
+ * The coarsest such image is returned, or NULL if there is none.
+ **/
+ImagePtr
+getCachedPreviewSource(EffectInstance* effect,
+                       double time,
+                       const RectD& rod,
+                       unsigned int mipMapLevel)
+{
+    U64 nodeHash = effect->getHash();
+    bool isFrameVaryingOrAnimated = effect->isFrameVaryingOrAnimated_Recursive();
+    double par = effect->getAspectRatio(-1);
+    ImagePtr ret;
+
+    // The viewer may have rendered in draft mode, and at scale 1 with inputs at a lower scale
+    for (int draftMode = 0; draftMode < 2; ++draftMode) {
+        for (int fullScaleWithDownscaleInputs = 0; fullScaleWithDownscaleInputs < 2; ++fullScaleWithDownscaleInputs) {
+            ImageKey key(effect->getNode().get(),
+                         nodeHash,
+                         isFrameVaryingOrAnimated,
+                         time,
+                         ViewIdx(0),
+                         1.,
+                         draftMode == 1,
+                         fullScaleWithDownscaleInputs == 1);
+            ImageList images;
+            if ( !appPTR->getImage(key, &images) ) {
+                continue;
+            }
+            for (ImageList::iterator it = images.begin(); it != images.end(); ++it) {
+                unsigned int imgMipMapLevel = (*it)->getMipMapLevel();
+                if ( ( (*it)->getStorageMode() != eStorageModeRAM ) || (imgMipMapLevel > mipMapLevel) ||
+                     ( ret && ( ret->getMipMapLevel() >= imgMipMapLevel ) ) ||
+                     !(*it)->getComponents().isColorPlane() || ( (*it)->getBitDepth() == eImageBitDepthHalf ) ) {
+                    continue;
+                }
+                RectI pixelRoD;
+                rod.toPixelEnclosing(imgMipMapLevel, par, &pixelRoD);
+                if ( !(*it)->getBounds().contains(pixelRoD) ) {
+                    continue;
+                }
+                std::list<RectI> restToRender;
+                (*it)->getRestToRender(pixelRoD, restToRender);
+                if ( !restToRender.empty() ) {
+                    continue;
+                }
+                ret = *it;
+            }
+        }
+    }
+
+    return ret;
+} // getCachedPreviewSource
+
 NATRON_NAMESPACE_ANONYMOUS_EXIT
 
 
@@ -3332,6 +3442,17 @@ Node::makePreviewImage(SequenceTime time,
     scale.x = Image::getScaleFromMipMapLevel(mipMapLevel);
     scale.y = scale.x;
 
+    // Do not render anything if the viewer already rendered this node
+    {
+        ImagePtr cachedImage = getCachedPreviewSource(effect, time, rod, mipMapLevel);
+        if (cachedImage) {
+            renderPreviewFromImage(getApp(), *cachedImage, width, height, buf);
+            appPTR->getAppTLS()->cleanupTLSForThread();
+
+            return true;
+        }
+    }
+
     const double par = effect->getAspectRatio(-1);
     RectI renderWindow;
     rod.toPixelEnclosing(mipMapLevel, par, &renderWindow);
@@ -3407,32 +3528,7 @@ Node::makePreviewImage(SequenceTime time,
             return false;
         }
 
-        const ImagePtr& img = planes.begin()->second;
-        const ImagePlaneDesc& components = img->getComponents();
-        int elemCount = components.getNumComponents();
-
-        ///we convert only when input is Linear.
-        //Rec709 and srGB is acceptable for preview
-        bool convertToSrgb = getApp()->getDefaultColorSpaceForBitDepth( img->getBitDepth() ) == eViewerColorSpaceLinear;
-
-        switch ( img->getBitDepth() ) {
-        case eImageBitDepthByte: {
-            renderPreviewForDepth<unsigned char, 255>(*img, elemCount, width, height, convertToSrgb, buf);
-            break;
-        }
-        case eImageBitDepthShort: {
-            renderPreviewForDepth<unsigned short, 65535>(*img, elemCount, width, height, convertToSrgb, buf);
-            break;
-        }
-        case eImageBitDepthHalf:
-            break;
-        case eImageBitDepthFloat: {
-            renderPreviewForDepth<float, 1>(*img, elemCount, width, height, convertToSrgb, buf);
-            break;
-        }
-        case eImageBitDepthNone:
-            break;
-        }
+        renderPreviewFromImage(getApp(), *planes.begin()->second, width, height, buf);
     } // ParallelRenderArgsSetter
 
     ///Exit of the thread
@@ -4882,6 +4978,9 @@ Node::onEffectKnobValueChanged(KnobI* what,
     if (!what) {
         return false;
     }
+    if (reason != eValueChangedReasonTimeChanged) {
+        incrementSerializationAge();
+    }
     for (std::map<int, MaskSelector >::iterator it = _imp->maskSelectors.begin(); it != _imp->maskSelectors.end(); ++it) {
         if (it->second.channel.lock().get() == what) {
             _imp->onMaskSelectorChanged(it->first, it->second);
@@ -878,6 +878,15 @@ public:
 
     U64 getKnobsAge() const;
 
+    /**
+     * @brief Incremented every time a knob, an input or the label of the node changes, i.e: every time
+     * the NodeSerialization of the node would change. Unlike the knobs age, this also accounts for changes
+     * that do not trigger a render. Used by the auto-save journal to find the nodes to save again.
+     **/
+    U64 getSerializationAge() const;
+
+    void incrementSerializationAge();
+
     void onAllKnobsSlaved(bool isSlave, KnobHolder* master);
 
     void onKnobSlaved(const KnobIPtr& slave, const KnobIPtr& master, int dimension, bool isSlave);
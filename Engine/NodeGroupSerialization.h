@@ -90,6 +90,12 @@ public:
         _serializedNodes.push_back(s);
     }
 
+    void takeNodesSerialization(std::list<NodeSerializationPtr>* nodes)
+    {
+        nodes->clear();
+        _serializedNodes.swap(*nodes);
+    }
+
     static bool restoreFromSerialization(const std::list<NodeSerializationPtr> & serializedNodes,
                                          const NodeCollectionPtr& group,
                                          bool createNodes,
@@ -1603,6 +1603,8 @@ Node::onInputChanged(int inputNb,
     }
     assert( QThread::currentThread() == qApp->thread() );
 
+    incrementSerializationAge();
+
     bool mustCallEndInputEdition = _imp->inputModifiedRecursion == 0;
     if (mustCallEndInputEdition) {
         beginInputEdition();
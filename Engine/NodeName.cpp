@@ -191,6 +191,7 @@ Node::setLabel(const std::string& label)
         }
         _imp->label = label;
     }
+    incrementSerializationAge();
     NodeCollectionPtr collection = getGroup();
     if (collection) {
         collection->notifyNodeNameChanged( shared_from_this() );
@@ -176,6 +176,12 @@ public:
         , renderInstancesSharedMutex(QMutex::Recursive)
         , knobsAge(0)
         , knobsAgeMutex()
+        , hash()
+        , hashPrefix()
+        , hashPrefixScriptName()
+        , hashPrefixCreationTime(0)
+        , serializationAge(0)
+        , serializationAgeMutex()
         , masterNodeMutex()
         , masterNode()
         , nodeLinks()
@@ -360,6 +366,11 @@ public:
     U64 knobsAge; //< the age of the knobs in this effect. It gets incremented every times the effect has its evaluate() function called.
     mutable QReadWriteLock knobsAgeMutex; //< protects knobsAge and hash
     Hash64 hash; //< recomputed every time knobsAge is changed.
+    Hash64 hashPrefix; //< the script name and project creation time part of the hash, only re-appended when they change
+    std::string hashPrefixScriptName; //< the script name hashed in hashPrefix
+    qint64 hashPrefixCreationTime; //< the project creation time hashed in hashPrefix
+    U64 serializationAge; //< incremented every time something saved in the NodeSerialization changes, used by incremental auto-saves
+    mutable QMutex serializationAgeMutex; //< protects serializationAge
     mutable QMutex masterNodeMutex; //< protects masterNode and nodeLinks
     NodeWPtr masterNode; //< this points to the master when the node is a clone
     KnobLinkList nodeLinks; //< these point to the parents of the params links
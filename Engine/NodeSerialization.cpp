@@ -39,7 +39,8 @@
 NATRON_NAMESPACE_ENTER
 
 NodeSerialization::NodeSerialization(const NodePtr & n,
-                                     bool serializeInputs)
+                                     bool serializeInputs,
+                                     bool serializeChildren)
     : _isNull(true)
     , _nbKnobs(0)
     , _knobsValues()
@@ -166,7 +167,7 @@ NodeSerialization::NodeSerialization(const NodePtr & n,
 
 
         NodeGroup* isGrp = n->isEffectGroup();
-        if (isGrp) {
+        if (isGrp && serializeChildren) {
             NodesList nodes;
             isGrp->getActiveNodes(&nodes);
 
@@ -183,7 +184,9 @@ NodeSerialization::NodeSerialization(const NodePtr & n,
         _multiInstanceParentName = n->getParentMultiInstanceName();
 
         NodesList childrenMultiInstance;
-        _node->getChildrenMultiInstance(&childrenMultiInstance);
+        if (serializeChildren) {
+            _node->getChildrenMultiInstance(&childrenMultiInstance);
+        }
         if ( !childrenMultiInstance.empty() ) {
             assert(!isGrp);
             for (NodesList::iterator it = childrenMultiInstance.begin(); it != childrenMultiInstance.end(); ++it) {
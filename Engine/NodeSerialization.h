@@ -79,8 +79,10 @@ public:
     typedef std::list<KnobSerializationPtr> KnobValues;
 
     ///Used to serialize
+    ///If serializeChildren is false, the nodes of a group or the children of a multi-instance are not serialized.
     explicit NodeSerialization(const NodePtr & n,
-                      bool serializeInputs = true);
+                      bool serializeInputs = true,
+                      bool serializeChildren = true);
 
     ////Used to deserialize
     NodeSerialization()
@@ -231,6 +233,25 @@ public:
         return _children;
     }
 
+    /**
+     * @brief Moves the children of this node to children, used by the binary project format to save them
+     * in their own chunks.
+     **/
+    void takeNodesCollection(std::list<NodeSerializationPtr>* children)
+    {
+        children->clear();
+        _children.swap(*children);
+    }
+
+    /**
+     * @brief Replaces the children of this node, used by the binary project format when it reads them from
+     * their own chunks and by the auto-save journal when it replays its records.
+     **/
+    void setNodesCollection(const std::list<NodeSerializationPtr>& children)
+    {
+        _children = children;
+    }
+
     const std::list<ImagePlaneDesc>& getUserCreatedComponents() const
     {
         return _userComponents;
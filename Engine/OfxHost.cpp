@@ -50,11 +50,7 @@ CLANG_DIAG_ON(deprecated-register)
 #ifdef OFX_SUPPORTS_MULTITHREAD
 #include <QtCore/QThread>
 #include <QtCore/QThreadStorage>
-#include <QtConcurrentMap> // QtCore on Qt4, QtConcurrent on Qt5
-GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_OFF
-// /usr/local/include/boost/bind/arg.hpp:37:9: warning: unused typedef 'boost_static_assert_typedef_37' [-Wunused-local-typedef]
-#include <boost/bind.hpp>
-GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
+#include <QtCore/QVector>
 #endif
 CLANG_DIAG_ON(deprecated)
 CLANG_DIAG_ON(uninitialized)
@@ -104,6 +100,7 @@ CLANG_DIAG_ON(unknown-pragmas)
 #include "Engine/OfxImageEffectInstance.h"
 #include "Engine/OutputSchedulerThread.h"
 #include "Engine/OfxMemory.h"
+#include "Engine/OfxThreadPool.h"
 #include "Engine/Plugin.h"
 #include "Engine/Project.h"
 #include "Engine/Settings.h"
@@ -152,6 +149,9 @@ struct OfxHostPrivate
     OFX::Host::ImageEffect::PluginCachePtr imageEffectPluginCache;
     boost::shared_ptr<TLSHolder<OfxHost::OfxHostTLSData> > tlsData;
 
+    // The workers of the multi-thread suite
+    boost::scoped_ptr<OfxThreadPool> threadPool;
+
 #ifdef MULTI_THREAD_SUITE_USES_THREAD_SAFE_MUTEX_ALLOCATION
     std::list<QMutex*> pluginsMutexes;
     QMutex* pluginsMutexesLock; //<protects _pluginsMutexes
@@ -163,6 +163,7 @@ struct OfxHostPrivate
     OfxHostPrivate()
         : imageEffectPluginCache()
         , tlsData( new TLSHolder<OfxHost::OfxHostTLSData>() )
+        , threadPool( new OfxThreadPool() )
 #ifdef MULTI_THREAD_SUITE_USES_THREAD_SAFE_MUTEX_ALLOCATION
         , pluginsMutexes()
         , pluginsMutexesLock(0)
@@ -1194,60 +1195,33 @@ OfxHost::setThreadAsActionCaller(OfxImageEffectInstance* instance,
     OfxHostDataTLSPtr tls = _imp->tlsData->getOrCreateTLSData();
 
     tls->lastEffectCallingMainEntry = instance;
-    if (actionCaller) {
-        tls->threadIndexes.push_back(-1);
+
+    // On the workers of the multi-thread suite, the thread indexes are held by the worker
+    std::vector<int>* workerThreadIndexes = OfxThreadPool::getCurrentWorkerThreadIndexes();
+    if (workerThreadIndexes) {
+        if (actionCaller) {
+            workerThreadIndexes->push_back(-1);
+        } else {
+            assert( !workerThreadIndexes->empty() );
+            workerThreadIndexes->pop_back();
+        }
     } else {
-        assert( !tls->threadIndexes.empty() );
-        tls->threadIndexes.pop_back();
+        if (actionCaller) {
+            tls->threadIndexes.push_back(-1);
+        } else {
+            assert( !tls->threadIndexes.empty() );
+            tls->threadIndexes.pop_back();
+        }
     }
 }
 
 NATRON_NAMESPACE_ANONYMOUS_ENTER
 
-///Using QtConcurrent doesn't work with The Foundry Furnace plug-ins because they expect fresh threads
-///to be created. As QtConcurrent's thread-pool recycles thread, it seems to make Furnace crash.
+///The thread-pool of the multi-thread suite doesn't work with The Foundry Furnace plug-ins because they expect fresh threads
+///to be created. As the thread-pool recycles threads, it seems to make Furnace crash.
 ///We think this is because Furnace must keep an internal thread-local state that becomes then dirty
-///if we re-use the same thread.
-
-static OfxStatus
-threadFunctionWrapper(OfxThreadFunctionV1 func,
-                      unsigned int threadIndex,
-                      unsigned int threadMax,
-                      QThread* spawnerThread,
-                      void *customArg)
-{
-#ifdef DEBUG
-    boost_adaptbx::floating_point::exception_trapping trap(boost_adaptbx::floating_point::exception_trapping::division_by_zero |
-                                                           boost_adaptbx::floating_point::exception_trapping::invalid |
-                                                           boost_adaptbx::floating_point::exception_trapping::overflow);
-#endif
-    assert(threadIndex < threadMax);
-    OfxHost::OfxHostDataTLSPtr tls = appPTR->getOFXHost()->getTLSData();
-    tls->threadIndexes.push_back( (int)threadIndex );
-
-    QThread* spawnedThread = QThread::currentThread();
-    if (spawnedThread != spawnerThread) {
-        appPTR->getAppTLS()->softCopy(spawnerThread, spawnedThread);
-    }
-
-    OfxStatus ret = kOfxStatOK;
-    try {
-        func(threadIndex, threadMax, customArg);
-    } catch (const std::bad_alloc & ba) {
-        ret =  kOfxStatErrMemory;
-    } catch (...) {
-        ret =  kOfxStatFailed;
-    }
-
-    ///reset back the index otherwise it could mess up the indexes if the same thread is re-used
-    tls->threadIndexes.pop_back();
-
-    if (spawnedThread != spawnerThread) {
-        appPTR->getAppTLS()->cleanupTLSForThread();
-    }
-
-    return ret;
-}
+///if we re-use the same thread: the host can only clean-up its own thread-local storage.
+///When the thread-pool is disabled in the settings, a new thread is launched for each index.
 
 class OfxThread
     : public QThread
@@ -1351,29 +1325,19 @@ OfxHost::multiThread(OfxThreadFunctionV1 func,
         }
     }
 
-    QThread* spawnerThread = QThread::currentThread();
-    bool useThreadPool = appPTR->getUseThreadPool();
-
-    if (useThreadPool) {
-        std::vector<unsigned int> threadIndexes(nThreads);
-        for (unsigned int i = 0; i < nThreads; ++i) {
-            threadIndexes[i] = i;
+    if ( appPTR->getUseThreadPool() ) {
+        // The workers are not taken from the global thread-pool: it runs the renders that func may depend on
+        // If the pool has no worker left, the indexes are processed by this thread
+        std::vector<int>* callerThreadIndexes = OfxThreadPool::getCurrentWorkerThreadIndexes();
+        OfxHostDataTLSPtr tls;
+        if (!callerThreadIndexes) {
+            tls = _imp->tlsData->getOrCreateTLSData();
+            callerThreadIndexes = &tls->threadIndexes;
         }
 
-        /// DON'T set the maximum thread count, this is a global application setting, and see the documentation excerpt above
-        //QThreadPool::globalInstance()->setMaxThreadCount(nThreads);
-        QFuture<OfxStatus> future = QtConcurrent::mapped( threadIndexes, boost::bind(threadFunctionWrapper, func, _1, nThreads, spawnerThread, customArg) );
-        future.waitForFinished();
-        ///DON'T reset back to the original value the maximum thread count
-        //QThreadPool::globalInstance()->setMaxThreadCount(QThread::idealThreadCount());
-
-        for (QFuture<OfxStatus>::const_iterator it = future.begin(); it != future.end(); ++it) {
-            OfxStatus stat = *it;
-            if (stat != kOfxStatOK) {
-                return stat;
-            }
-        }
+        return _imp->threadPool->run(func, nThreads, maxConcurrentThread, customArg, callerThreadIndexes);
     } else {
+        QThread* spawnerThread = QThread::currentThread();
         QVector<OfxStatus> status(nThreads); // vector for the return status of each thread
         status.fill(kOfxStatFailed); // by default, a thread fails
         {
@@ -1492,6 +1456,19 @@ OfxHost::multiThreadIndex(unsigned int *threadIndex) const
     if (!threadIndex) {
         return kOfxStatFailed;
     }
+
+    // This is called a lot by the plug-ins from the spawned threads: on the workers of the thread-pool, do not look-up the TLS
+    std::vector<int>* workerThreadIndexes = OfxThreadPool::getCurrentWorkerThreadIndexes();
+    if (workerThreadIndexes) {
+        if ( !workerThreadIndexes->empty() && (workerThreadIndexes->back() != -1) ) {
+            *threadIndex = workerThreadIndexes->back();
+        } else {
+            *threadIndex = 0;
+        }
+
+        return kOfxStatOK;
+    }
+
     OfxHostDataTLSPtr tls = _imp->tlsData->getOrCreateTLSData();
 
     if ( !tls->threadIndexes.empty() && (tls->threadIndexes.back() != -1) ) {
@@ -1509,6 +1486,12 @@ OfxHost::multiThreadIndex(unsigned int *threadIndex) const
 int
 OfxHost::multiThreadIsSpawnedThread() const
 {
+    std::vector<int>* workerThreadIndexes = OfxThreadPool::getCurrentWorkerThreadIndexes();
+
+    if (workerThreadIndexes) {
+        return !workerThreadIndexes->empty() && workerThreadIndexes->back() != -1;
+    }
+
     OfxHostDataTLSPtr tls = _imp->tlsData->getOrCreateTLSData();
 
     return !tls->threadIndexes.empty() && tls->threadIndexes.back() != -1;
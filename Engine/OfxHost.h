@@ -176,7 +176,8 @@ public:
     {
         OfxImageEffectInstance* lastEffectCallingMainEntry;
 
-        ///Stored as int, because we need -1; list because we need it recursive for the multiThread func
+        ///Stored as int, because we need -1; list because we need it recursive for the multiThread func.
+        ///Not used on the workers of the multi-thread suite, @see OfxThreadPool::getCurrentWorkerThreadIndexes()
         std::list<int> threadIndexes;
 
         OfxHostTLSData()
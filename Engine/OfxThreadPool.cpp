@@ -0,0 +1,471 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ * Copyright (C) 2018-2020 The Natron developers
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "OfxThreadPool.h"
+
+#include <algorithm> // min, max
+#include <cassert>
+#include <new> // std::bad_alloc
+
+#include <QtCore/QMutex>
+#include <QtCore/QThread>
+#include <QtCore/QWaitCondition>
+
+#include "Global/FloatingPointExceptions.h"
+
+#include "Engine/AppManager.h"
+#include "Engine/TLSHolder.h"
+#include "Engine/ThreadPool.h"
+
+NATRON_NAMESPACE_ENTER
+
+/**
+ * @brief The state of a call to OfxThreadPool::run(), shared by the workers assigned to it.
+ **/
+struct OfxThreadPoolCall
+{
+    OfxThreadFunctionV1* func;
+    unsigned int nThreads;
+    void* customArg;
+    QThread* spawnerThread;
+
+    // Protects all fields below
+    QMutex lock;
+
+    // Signaled when the last worker is done with the call
+    QWaitCondition finishedCond;
+
+    // The next index to process
+    unsigned int nextIndex;
+
+    // The number of workers still processing indexes of this call
+    unsigned int nRunningWorkers;
+
+    // The first error returned by a worker
+    OfxStatus status;
+
+    OfxThreadPoolCall(OfxThreadFunctionV1* func,
+                      unsigned int nThreads,
+                      void* customArg,
+                      QThread* spawnerThread,
+                      unsigned int nWorkers)
+        : func(func)
+        , nThreads(nThreads)
+        , customArg(customArg)
+        , spawnerThread(spawnerThread)
+        , lock()
+        , finishedCond()
+        , nextIndex(0)
+        , nRunningWorkers(nWorkers)
+        , status(kOfxStatOK)
+    {
+    }
+};
+
+class OfxThreadPoolWorker
+    : public QThread
+      , public AbortableThread
+{
+public:
+
+    OfxThreadPoolWorker(OfxThreadPoolPrivate* pool)
+        : QThread()
+        , AbortableThread(this)
+        , threadIndexes()
+        , _pool(pool)
+        , _lock()
+        , _cond()
+        , _call(0)
+        , _mustQuit(false)
+    {
+        setThreadName("Multi-thread suite");
+    }
+
+    virtual ~OfxThreadPoolWorker()
+    {
+    }
+
+    /**
+     * @brief Makes the worker process the indexes of call, the worker must be idle.
+     **/
+    void assignCall(OfxThreadPoolCall* call)
+    {
+        QMutexLocker k(&_lock);
+
+        assert(!_call);
+        _call = call;
+        _cond.wakeOne();
+    }
+
+    /**
+     * @brief Makes the worker exit once idle, use wait() to join it.
+     **/
+    void requestQuit()
+    {
+        QMutexLocker k(&_lock);
+
+        _mustQuit = true;
+        _cond.wakeOne();
+    }
+
+    ///Only accessed by this thread, @see OfxThreadPool::getCurrentWorkerThreadIndexes()
+    std::vector<int> threadIndexes;
+
+private:
+
+    virtual void run() OVERRIDE FINAL;
+
+    void processCall(OfxThreadPoolCall* call);
+
+    OfxStatus processIndex(OfxThreadPoolCall* call, unsigned int threadIndex);
+
+    OfxThreadPoolPrivate* _pool;
+
+    // Protects _call and _mustQuit
+    QMutex _lock;
+    QWaitCondition _cond;
+    OfxThreadPoolCall* _call;
+    bool _mustQuit;
+};
+
+struct OfxThreadPoolPrivate
+{
+    // If 0, the maximum number of workers depends on the hardware, see getMaxWorkers()
+    const int maxWorkers;
+
+    // Protects the fields below
+    mutable QMutex lock;
+
+    // All workers alive
+    std::vector<OfxThreadPoolWorker*> workers;
+
+    // The workers waiting for a call. The most recently used worker is at the back so that it is re-used first.
+    std::vector<OfxThreadPoolWorker*> idleWorkers;
+
+    // The workers that exited after being idle for too long. A thread cannot delete itself:
+    // they are joined and deleted by the next call to acquireWorkers() or by the pool destructor.
+    std::vector<OfxThreadPoolWorker*> retiredWorkers;
+
+    OfxThreadPoolPrivate(int maxWorkers)
+        : maxWorkers(maxWorkers)
+        , lock()
+        , workers()
+        , idleWorkers()
+        , retiredWorkers()
+    {
+    }
+
+    int getMaxWorkers() const
+    {
+        if (maxWorkers > 0) {
+            return maxWorkers;
+        }
+
+        // Leave room for a nested call from each worker of a call using all the CPUs
+        return std::max( 1, 2 * appPTR->getHardwareIdealThreadCount() );
+    }
+
+    // Must be called with lock held
+    void deleteRetiredWorkers()
+    {
+        for (std::vector<OfxThreadPoolWorker*>::iterator it = retiredWorkers.begin(); it != retiredWorkers.end(); ++it) {
+            // The worker does not take any lock once retired, this does not block for long
+            (*it)->wait();
+            delete *it;
+        }
+        retiredWorkers.clear();
+    }
+
+    /**
+     * @brief Takes at most nWorkers idle workers, creating new ones as long as the maximum number of workers is not reached.
+     **/
+    void acquireWorkers(unsigned int nWorkers,
+                        std::vector<OfxThreadPoolWorker*>* acquired)
+    {
+        QMutexLocker k(&lock);
+
+        deleteRetiredWorkers();
+
+        const int maxWorkersCount = getMaxWorkers();
+        for (unsigned int i = 0; i < nWorkers; ++i) {
+            OfxThreadPoolWorker* worker;
+            if ( !idleWorkers.empty() ) {
+                worker = idleWorkers.back();
+                idleWorkers.pop_back();
+            } else if ( (int)workers.size() < maxWorkersCount ) {
+                worker = new OfxThreadPoolWorker(this);
+                workers.push_back(worker);
+                worker->start();
+            } else {
+                break;
+            }
+            acquired->push_back(worker);
+        }
+    }
+
+    /**
+     * @brief Called by a worker that has been idle for too long. Returns false if the worker
+     * was acquired for a call in the meantime, in which case it must not exit.
+     **/
+    bool retireWorker(OfxThreadPoolWorker* worker)
+    {
+        QMutexLocker k(&lock);
+        std::vector<OfxThreadPoolWorker*>::iterator found = std::find(idleWorkers.begin(), idleWorkers.end(), worker);
+
+        if ( found == idleWorkers.end() ) {
+            return false;
+        }
+        idleWorkers.erase(found);
+        found = std::find(workers.begin(), workers.end(), worker);
+        assert( found != workers.end() );
+        if ( found != workers.end() ) {
+            workers.erase(found);
+        }
+        retiredWorkers.push_back(worker);
+
+        return true;
+    }
+
+    void releaseWorker(OfxThreadPoolWorker* worker,
+                       OfxThreadPoolCall* call)
+    {
+        {
+            QMutexLocker k(&lock);
+            idleWorkers.push_back(worker);
+        }
+
+        ///The worker is no longer running
+        appPTR->fetchAndAddNRunningThreads(-1);
+
+        // Do not access call once the spawner thread is woken up: it is destroyed when run() returns
+        QMutexLocker k(&call->lock);
+        assert(call->nRunningWorkers > 0);
+        --call->nRunningWorkers;
+        if (call->nRunningWorkers == 0) {
+            call->finishedCond.wakeAll();
+        }
+    }
+};
+
+void
+OfxThreadPoolWorker::run()
+{
+    for (;;) {
+        OfxThreadPoolCall* call;
+        {
+            QMutexLocker k(&_lock);
+            while (!_call && !_mustQuit) {
+                if ( !_cond.wait(&_lock, NATRON_OFX_THREAD_POOL_IDLE_TIMEOUT_MS) && !_call && !_mustQuit ) {
+                    // Do not hold our lock while taking the pool lock: the pool takes them in the other order
+                    k.unlock();
+                    if ( _pool->retireWorker(this) ) {
+                        return;
+                    }
+                    k.relock();
+                }
+            }
+            if (!_call) {
+                return;
+            }
+            call = _call;
+        }
+
+        processCall(call);
+
+        {
+            QMutexLocker k(&_lock);
+            _call = 0;
+        }
+        _pool->releaseWorker(this, call);
+    }
+}
+
+void
+OfxThreadPoolWorker::processCall(OfxThreadPoolCall* call)
+{
+    for (;;) {
+        unsigned int threadIndex;
+        {
+            QMutexLocker k(&call->lock);
+            if (call->nextIndex >= call->nThreads) {
+                return;
+            }
+            threadIndex = call->nextIndex;
+            ++call->nextIndex;
+        }
+
+        OfxStatus stat = processIndex(call, threadIndex);
+        if (stat != kOfxStatOK) {
+            QMutexLocker k(&call->lock);
+            if (call->status == kOfxStatOK) {
+                call->status = stat;
+            }
+        }
+    }
+}
+
+OfxStatus
+OfxThreadPoolWorker::processIndex(OfxThreadPoolCall* call,
+                                  unsigned int threadIndex)
+{
+#ifdef DEBUG
+    boost_adaptbx::floating_point::exception_trapping trap(boost_adaptbx::floating_point::exception_trapping::division_by_zero |
+                                                           boost_adaptbx::floating_point::exception_trapping::invalid |
+                                                           boost_adaptbx::floating_point::exception_trapping::overflow);
+#endif
+    assert(threadIndex < call->nThreads);
+    assert( threadIndexes.empty() );
+    threadIndexes.push_back( (int)threadIndex );
+
+    appPTR->getAppTLS()->softCopy(call->spawnerThread, this);
+
+    OfxStatus ret = kOfxStatOK;
+    try {
+        call->func(threadIndex, call->nThreads, call->customArg);
+    } catch (const std::bad_alloc & ba) {
+        ret = kOfxStatErrMemory;
+    } catch (...) {
+        ret = kOfxStatFailed;
+    }
+
+    threadIndexes.pop_back();
+
+    ///The next index may be processed for another call: drop the TLS and the abort info of the spawner thread
+    appPTR->getAppTLS()->cleanupTLSForThread();
+
+    return ret;
+}
+
+/**
+ * @brief Processes all indexes on the calling thread, when the pool has no worker left.
+ **/
+static OfxStatus
+runInCallingThread(OfxThreadFunctionV1* func,
+                   unsigned int nThreads,
+                   void* customArg,
+                   std::vector<int>* threadIndexes)
+{
+    OfxStatus ret = kOfxStatOK;
+
+    for (unsigned int i = 0; i < nThreads; ++i) {
+        if (threadIndexes) {
+            threadIndexes->push_back( (int)i );
+        }
+        try {
+            func(i, nThreads, customArg);
+        } catch (const std::bad_alloc & ba) {
+            if (ret == kOfxStatOK) {
+                ret = kOfxStatErrMemory;
+            }
+        } catch (...) {
+            if (ret == kOfxStatOK) {
+                ret = kOfxStatFailed;
+            }
+        }
+        if (threadIndexes) {
+            threadIndexes->pop_back();
+        }
+    }
+
+    return ret;
+}
+
+OfxThreadPool::OfxThreadPool(int maxWorkers)
+    : _imp( new OfxThreadPoolPrivate(maxWorkers) )
+{
+}
+
+OfxThreadPool::~OfxThreadPool()
+{
+    std::vector<OfxThreadPoolWorker*> workers;
+    {
+        QMutexLocker k(&_imp->lock);
+        assert( _imp->idleWorkers.size() == _imp->workers.size() );
+        workers.swap(_imp->workers);
+        _imp->idleWorkers.clear();
+        _imp->deleteRetiredWorkers();
+    }
+    for (std::vector<OfxThreadPoolWorker*>::iterator it = workers.begin(); it != workers.end(); ++it) {
+        (*it)->requestQuit();
+    }
+    for (std::vector<OfxThreadPoolWorker*>::iterator it = workers.begin(); it != workers.end(); ++it) {
+        (*it)->wait();
+        delete *it;
+    }
+}
+
+OfxStatus
+OfxThreadPool::run(OfxThreadFunctionV1 func,
+                   unsigned int nThreads,
+                   unsigned int maxConcurrentThreads,
+                   void* customArg,
+                   std::vector<int>* callerThreadIndexes)
+{
+    if (nThreads == 0) {
+        return kOfxStatOK;
+    }
+
+    std::vector<OfxThreadPoolWorker*> workers;
+    _imp->acquireWorkers(std::max( 1u, std::min(nThreads, maxConcurrentThreads) ), &workers);
+    if ( workers.empty() ) {
+        // The maximum number of workers is reached: do not add more threads competing for the CPUs
+        return runInCallingThread(func, nThreads, customArg, callerThreadIndexes);
+    }
+
+    const unsigned int nWorkers = (unsigned int)workers.size();
+    OfxThreadPoolCall call(func, nThreads, customArg, QThread::currentThread(), nWorkers);
+
+    ///We just started nWorkers threads
+    appPTR->fetchAndAddNRunningThreads( (int)nWorkers );
+
+    for (std::vector<OfxThreadPoolWorker*>::iterator it = workers.begin(); it != workers.end(); ++it) {
+        (*it)->assignCall(&call);
+    }
+
+    QMutexLocker k(&call.lock);
+    while (call.nRunningWorkers > 0) {
+        call.finishedCond.wait(&call.lock);
+    }
+
+    return call.status;
+}
+
+int
+OfxThreadPool::getWorkersCount() const
+{
+    QMutexLocker k(&_imp->lock);
+
+    return (int)_imp->workers.size();
+}
+
+std::vector<int>*
+OfxThreadPool::getCurrentWorkerThreadIndexes()
+{
+    OfxThreadPoolWorker* worker = dynamic_cast<OfxThreadPoolWorker*>( QThread::currentThread() );
+
+    return worker ? &worker->threadIndexes : 0;
+}
+
+NATRON_NAMESPACE_EXIT
@@ -0,0 +1,108 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ * Copyright (C) 2018-2020 The Natron developers
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_OFXTHREADPOOL_H
+#define NATRON_ENGINE_OFXTHREADPOOL_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <vector>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/scoped_ptr.hpp>
+#endif
+
+#include <ofxCore.h>
+#include <ofxMultiThread.h>
+
+#include "Engine/EngineFwd.h"
+
+// The time after which a worker that did not get any call exits
+#define NATRON_OFX_THREAD_POOL_IDLE_TIMEOUT_MS 30000
+
+NATRON_NAMESPACE_ENTER
+
+struct OfxThreadPoolPrivate;
+
+/**
+ * @brief The threads used to implement the multiThread function of the OFX multi-thread suite.
+ *
+ * The workers are long-lived and are not part of the global thread-pool, so that a plug-in spawning threads
+ * cannot take the threads of the renders it depends on. Each call to run() gets its own workers, which only
+ * process the indexes of that call before going back to the pool: a nested call from a worker gets other workers.
+ * The total number of workers is capped: when no worker is left, the calling thread processes the indexes itself.
+ * Workers that stay idle for NATRON_OFX_THREAD_POOL_IDLE_TIMEOUT_MS exit.
+ *
+ * After each index the worker cleans-up the thread-local storage of the host and the abort info copied from the
+ * spawner thread, so that from the host point of view it starts every job as a fresh thread.
+ **/
+class OfxThreadPool
+{
+public:
+
+    /**
+     * @brief maxWorkers is the maximum number of workers alive at the same time, across all calls to run().
+     * If 0, this is twice the ideal thread count of the hardware, which leaves room for one level of nested calls.
+     **/
+    explicit OfxThreadPool(int maxWorkers = 0);
+
+    /**
+     * @brief Stops and joins all workers, no call to run() should be in progress.
+     **/
+    ~OfxThreadPool();
+
+    /**
+     * @brief Calls func for each index in [0, nThreads[ on at most maxConcurrentThreads workers and returns
+     * once they are all processed. Returns the first error returned by a worker, kOfxStatOK otherwise.
+     * If no worker is available, the calling thread processes all indexes itself, pushing each index on
+     * callerThreadIndexes while it is processed (the stack used by multiThreadIndex() for the calling thread).
+     **/
+    OfxStatus run(OfxThreadFunctionV1 func,
+                  unsigned int nThreads,
+                  unsigned int maxConcurrentThreads,
+                  void* customArg,
+                  std::vector<int>* callerThreadIndexes);
+
+    /**
+     * @brief Returns the number of workers alive, for debugging purposes.
+     **/
+    int getWorkersCount() const;
+
+    /**
+     * @brief If the calling thread is a worker of an OfxThreadPool, returns its stack of thread indexes
+     * (-1 meaning that the worker is calling an action of an effect), NULL otherwise.
+     * This does not look-up the thread-local storage: this is what makes multiThreadIndex() cheap on the workers.
+     * The stack must only be accessed from the calling thread.
+     **/
+    static std::vector<int>* getCurrentWorkerThreadIndexes();
+
+private:
+
+    boost::scoped_ptr<OfxThreadPoolPrivate> _imp;
+};
+
+NATRON_NAMESPACE_EXIT
+
+#endif // NATRON_ENGINE_OFXTHREADPOOL_H
@@ -102,12 +102,21 @@ public:
      **/
     virtual void clearPartialUpdateTextures()  = 0;
 
+    /**
+     * @brief Returns the ring of mapped pixel buffers that render threads may convert their pixels into
+     * to avoid a copy in transferBufferFromRAMtoGPU, or NULL if the viewer does not provide one.
+     * MT-safe
+     **/
+    virtual PixelBufferRingPtr getPixelBufferRing() const = 0;
+
     /**
      * @brief This function must do the following:
      * 1) glMapBuffer to map a GPU buffer to the RAM
      * 2) memcpy to copy the ramBuffer to previously mapped buffer.
      * 3) glUnmapBuffer to unmap the GPU buffer
      * 4) glTexSubImage2D or glTexImage2D depending whether yo need to resize the texture or not.
+     * If pixelBufferIndex is not -1, ramBuffer is the memory of that buffer of the getPixelBufferRing() ring:
+     * steps 1 to 3 are replaced by unmapping that buffer.
      **/
     virtual void transferBufferFromRAMtoGPU(const unsigned char* ramBuffer,
                                             size_t bytesCount,
@@ -117,6 +126,7 @@ public:
                                             int textureIndex,
                                             bool isPartialRect,
                                             bool isFirstTile,
+                                            int pixelBufferIndex,
                                             TexturePtr* texture) = 0;
     virtual void endTransferBufferFromRAMToGPU(int textureIndex,
                                                const TexturePtr& texture,
@@ -60,6 +60,7 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 #include "Engine/KnobFile.h"
 #include "Engine/KnobTypes.h"
 #include "Engine/Log.h"
+#include "Engine/MemoryInfo.h" // printAsRAM
 #include "Engine/Node.h"
 #include "Engine/OfxEffectInstance.h"
 #include "Engine/OfxEffectInstance.h"
@@ -404,6 +405,7 @@ void
 OutputEffectInstance::reportStats(int time,
                                   ViewIdx view,
                                   double wallTime,
+                                  const RamBufferPoolStats& bufferPoolStats,
                                   const std::map<NodePtr, NodeRenderStats > & stats)
 {
     std::string filename;
@@ -439,6 +441,9 @@ OutputEffectInstance::reportStats(int time,
     }
 
     ofile << "Time spent to render frame (wall clock time): " << Timer::printAsTime(wallTime, false).toStdString() << std::endl;
+    ofile << "RAM buffer pool: " << bufferPoolStats.nHits << " hit(s), " << bufferPoolStats.nMisses << " miss(es) (hit rate: "
+          << (int)(bufferPoolStats.getHitRate() * 100.) << "%), " << bufferPoolStats.nRecycled << " buffer(s) recycled, "
+          << bufferPoolStats.nDropped << " dropped, " << printAsRAM(bufferPoolStats.bytesPooled).toStdString() << " pooled" << std::endl;
     for (std::map<NodePtr, NodeRenderStats >::const_iterator it = stats.begin(); it != stats.end(); ++it) {
         ofile << "------------------------------- " << it->first->getScriptName_mt_safe() << "------------------------------- " << std::endl;
         ofile << "Time spent rendering: " << Timer::printAsTime(it->second.getTotalTimeSpentRendering(), false).toStdString() << std::endl;
@@ -506,6 +511,10 @@ OutputEffectInstance::reportStats(int time,
         ofile << "Nb cache hit: " << nbCacheMiss << std::endl;
         ofile << "Nb cache miss: " << nbCacheMiss << std::endl;
         ofile << "Nb cache hit requiring mipmap downscaling: " << nbCacheHitButDownscaled << std::endl;
+        int nbCopiesAvoided;
+        U64 nbBytesNotCopied;
+        it->second.getCopiesAvoided(&nbCopiesAvoided, &nbBytesNotCopied);
+        ofile << "Nb copies avoided by rendering in the cached image: " << nbCopiesAvoided << " (" << printAsRAM(nbBytesNotCopied).toStdString() << ")" << std::endl;
 
         const std::set<std::string> & planes = it->second.getPlanesRendered();
         ofile << "Plane(s) rendered: ";
@@ -115,7 +115,7 @@ public:
 
 
     virtual void initializeData() OVERRIDE FINAL;
-    virtual void reportStats(int time, ViewIdx view, double wallTime, const std::map<NodePtr, NodeRenderStats > & stats);
+    virtual void reportStats(int time, ViewIdx view, double wallTime, const RamBufferPoolStats& bufferPoolStats, const std::map<NodePtr, NodeRenderStats > & stats);
 
 protected:
 
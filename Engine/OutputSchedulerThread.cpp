@@ -57,6 +57,7 @@
 #include "Engine/KnobFile.h"
 #include "Engine/Node.h"
 #include "Engine/OpenGLViewerI.h"
+#include "Engine/PlaybackPrefetcher.h"
 #include "Engine/GenericSchedulerThreadWatcher.h"
 #include "Engine/Project.h"
 #include "Engine/RenderStats.h"
@@ -243,6 +244,9 @@ struct OutputSchedulerThreadPrivate
     QMutex bufferedOutputMutex;
     int lastBufferedOutputSize;
 
+    ///Decodes the frames of the readers ahead of the render threads
+    boost::scoped_ptr<PlaybackPrefetcher> prefetcher;
+
 
     OutputSchedulerThreadPrivate(RenderEngine* engine,
                                  const OutputEffectInstancePtr& effect,
@@ -282,6 +286,7 @@ struct OutputSchedulerThreadPrivate
 #endif
         , bufferedOutputMutex()
         , lastBufferedOutputSize(0)
+        , prefetcher( new PlaybackPrefetcher() )
     {
     }
 
@@ -427,6 +432,17 @@ struct OutputSchedulerThreadPrivate
                                        unsigned int frameStep,
                                        int* nextFrame,
                                        RenderDirectionEnum* newDirection);
+
+#ifndef NATRON_PLAYBACK_USES_THREAD_POOL
+    /**
+     * @brief Returns the frames the render threads will need after the frames already queued, in the order they will be needed.
+     * framesToRenderMutex must be locked.
+     **/
+    void getFramesToPrefetch(int pickedFrame,
+                             SchedulingPolicyEnum policy,
+                             std::list<int>* frames) const;
+#endif
+
     static void getNearestInSequence(RenderDirectionEnum direction,
                                      int frame,
                                      int firstFrame,
@@ -646,6 +662,34 @@ OutputSchedulerThreadPrivate::getNextFrameInSequence(PlaybackModeEnum pMode,
     return true;
 } // OutputSchedulerThreadPrivate::getNextFrameInSequence
 
+#ifndef NATRON_PLAYBACK_USES_THREAD_POOL
+void
+OutputSchedulerThreadPrivate::getFramesToPrefetch(int pickedFrame,
+                                                  SchedulingPolicyEnum policy,
+                                                  std::list<int>* frames) const
+{
+    assert( !framesToRenderMutex.tryLock() );
+
+    OutputSchedulerThreadStartArgsPtr args = runArgs.lock();
+    if ( !args || (args->firstFrame == args->lastFrame) ) {
+        return;
+    }
+
+    ///With the FFA policy all frames are queued at once: start from the frame being rendered.
+    ///Otherwise start after the last queued frame, the render threads will decode the frames in-between themselves.
+    int frame = policy == eSchedulingPolicyFFA ? pickedFrame : lastFramePushedIndex;
+    RenderDirectionEnum direction = args->pushTimelineDirection;
+    PlaybackModeEnum pMode = engine->getPlaybackMode();
+    for (int i = 0; i < NATRON_PLAYBACK_PREFETCH_N_FRAMES; ++i) {
+        if ( !getNextFrameInSequence(pMode, direction, frame, args->firstFrame, args->lastFrame, args->frameStep, &frame, &direction) ) {
+            break;
+        }
+        frames->push_back(frame);
+    }
+}
+
+#endif
+
 void
 OutputSchedulerThreadPrivate::getNearestInSequence(RenderDirectionEnum direction,
                                                    int frame,
@@ -823,6 +867,8 @@ OutputSchedulerThread::pickFrameToRender(RenderThreadTask* thread,
 
     bool gotFrame = false;
     int frame = -1;
+    std::list<int> framesToPrefetch;
+    SchedulingPolicyEnum policy = getSchedulingPolicy();
     {
         QMutexLocker l(&_imp->framesToRenderMutex);
         while ( _imp->framesToRender.empty() && !thread->mustQuit() ) {
@@ -841,9 +887,15 @@ OutputSchedulerThread::pickFrameToRender(RenderThreadTask* thread,
             _imp->framesToRender.pop_front();
 
             gotFrame = true;
+
+            _imp->getFramesToPrefetch(frame, policy, &framesToPrefetch);
         }
     }
 
+    if ( !framesToPrefetch.empty() ) {
+        _imp->prefetcher->prefetchFrames(framesToPrefetch);
+    }
+
     // thread is quitting, make sure we notified the application it is no longer running
     if (!gotFrame) {
         thread->notifyIsRunning(false);
@@ -1054,6 +1106,14 @@ OutputSchedulerThread::startRender()
 
     aboutToStartRender();
 
+    ///Decode the frames of the readers ahead of the render threads
+    {
+        NodesList readers;
+        unsigned int mipMapLevel = 0;
+        getReadersToPrefetch(&readers, &mipMapLevel);
+        _imp->prefetcher->start(readers, args->viewsToRender, mipMapLevel);
+    }
+
     ///Notify everyone that the render is started
     _imp->engine->s_renderStarted(forward);
 
@@ -1155,6 +1215,9 @@ OutputSchedulerThread::stopRender()
     }
 #endif
 
+    ///The frames prefetched so far may not be the ones needed by the next render (e.g: after a seek)
+    _imp->prefetcher->cancel();
+
     ///Remove all current threads so the new render doesn't have many threads concurrently trying to do the same thing at the same time
 #ifndef NATRON_PLAYBACK_USES_THREAD_POOL
     stopRenderThreads(0);
@@ -1483,6 +1546,9 @@ OutputSchedulerThread::onAbortRequested(bool /*keepOldestRender*/)
         }
     }
 
+    ///Do not decode frames that will not be rendered
+    _imp->prefetcher->cancel();
+
     ///If the scheduler is asleep waiting for the buffer to be filling up, we post a fake request
     ///that will not be processed anyway because the first thing it does is checking for abort
     {
@@ -1568,7 +1634,9 @@ OutputSchedulerThread::notifyFrameRendered(int frame,
         double timeSpentForFrame;
         std::map<NodePtr, NodeRenderStats > statResults = stats->getStats(&timeSpentForFrame);
         if ( !statResults.empty() ) {
-            effect->reportStats(frame, viewIndex, timeSpentForFrame, statResults);
+            RamBufferPoolStats bufferPoolStats;
+            stats->getRamBufferPoolStats(&bufferPoolStats);
+            effect->reportStats(frame, viewIndex, timeSpentForFrame, bufferPoolStats, statResults);
         }
     }
 
@@ -1947,6 +2015,18 @@ OutputSchedulerThread::getEngine() const
     return _imp->engine;
 }
 
+void
+OutputSchedulerThread::getReadersToPrefetch(NodesList* readers,
+                                            unsigned int* mipMapLevel) const
+{
+    EffectInstancePtr effect = _imp->outputEffect.lock();
+
+    if (effect) {
+        PlaybackPrefetcher::getReadersUpstream(effect->getNode(), readers);
+    }
+    *mipMapLevel = 0;
+}
+
 void
 OutputSchedulerThread::runCallbackWithVariables(const QString& callback)
 {
@@ -2932,6 +3012,30 @@ ViewerDisplayScheduler::getLastRenderedTime() const
     return _viewer.lock()->getLastRenderedTime();
 }
 
+void
+ViewerDisplayScheduler::getReadersToPrefetch(NodesList* readers,
+                                             unsigned int* mipMapLevel) const
+{
+    ViewerInstancePtr viewer = _viewer.lock();
+
+    ///Only the inputs displayed by the viewer are rendered
+    int activeInputs[2] = {-1, -1};
+    viewer->getActiveInputs(activeInputs[0], activeInputs[1]);
+    NodePtr viewerNode = viewer->getNode();
+    for (int i = 0; i < 2; ++i) {
+        if ( (activeInputs[i] == -1) || ( (i == 1) && (activeInputs[1] == activeInputs[0]) ) ) {
+            continue;
+        }
+        NodePtr input = viewerNode->getInput(activeInputs[i]);
+        if (input) {
+            PlaybackPrefetcher::getReadersUpstream(input, readers);
+        }
+    }
+
+    ///The proxy level is the lowest level the viewer renders at, images at this level can be used at any zoom factor
+    *mipMapLevel = (unsigned int)viewer->getMipMapLevel();
+}
+
 ////////////////////////// RenderEngine
 
 struct RenderEnginePrivate
@@ -3594,7 +3698,7 @@ public:
                 assert(isParams);
                 assert( !isParams->tiles.empty() );
                 for (std::list<UpdateViewerParams::CachedTile>::iterator it2 = isParams->tiles.begin(); it2 != isParams->tiles.end(); ++it2) {
-                    assert(it2->ramBuffer);
+                    assert(it2->ramBuffer || it2->compressed);
                 }
             }
 #endif
@@ -3767,7 +3871,9 @@ ViewerCurrentFrameRequestSchedulerPrivate::processProducedFrame(const RenderStat
             if (stats) {
                 double timeSpent;
                 std::map<NodePtr, NodeRenderStats > ret = stats->getStats(&timeSpent);
-                viewer->reportStats(0, ViewIdx(0), timeSpent, ret);
+                RamBufferPoolStats bufferPoolStats;
+                stats->getRamBufferPoolStats(&bufferPoolStats);
+                viewer->reportStats(0, ViewIdx(0), timeSpent, bufferPoolStats, ret);
             }
 
             viewer->updateViewer(params);
@@ -3919,7 +4025,9 @@ ViewerCurrentFrameRequestScheduler::renderCurrentFrame(bool enableRenderStats,
                 if ( stats && (i == 0) ) {
                     double timeSpent;
                     std::map<NodePtr, NodeRenderStats > statResults = stats->getStats(&timeSpent);
-                    _imp->viewer->reportStats(frame, view, timeSpent, statResults);
+                    RamBufferPoolStats bufferPoolStats;
+                    stats->getRamBufferPoolStats(&bufferPoolStats);
+                    _imp->viewer->reportStats(frame, view, timeSpent, bufferPoolStats, statResults);
                 }
                 _imp->viewer->updateViewer(args[i]->params);
                 args[i].reset();
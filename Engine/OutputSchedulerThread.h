@@ -408,6 +408,12 @@ protected:
      **/
     virtual void onRenderStopped(bool /*aborted*/) {}
 
+    /**
+     * @brief Returns the Read nodes whose frames should be decoded ahead of the render threads and the mipmap level to decode them at.
+     * By default these are all the readers upstream of the output effect, decoded at full resolution.
+     **/
+    virtual void getReadersToPrefetch(NodesList* readers, unsigned int* mipMapLevel) const;
+
     RenderEngine* getEngine() const;
 
 private:
@@ -540,6 +546,7 @@ private:
 
     virtual int getLastRenderedTime() const OVERRIDE FINAL WARN_UNUSED_RETURN;
     virtual void onRenderStopped(bool aborted) OVERRIDE FINAL;
+    virtual void getReadersToPrefetch(NodesList* readers, unsigned int* mipMapLevel) const OVERRIDE FINAL;
     ViewerInstanceWPtr _viewer;
 };
 
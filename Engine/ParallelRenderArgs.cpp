@@ -884,6 +884,7 @@ ParallelRenderArgs::ParallelRenderArgs()
     , visitsCount(0)
     , rotoPaintNodes()
     , stats()
+    , knobValues()
     , openGLContext()
     , textureIndex(0)
     , currentThreadSafety(eRenderSafetyInstanceSafe)
@@ -118,6 +118,9 @@ public:
     ///Various stats local to the render of a frame
     RenderStatsPtr stats;
 
+    ///The values of the node's knobs at the time of the frame, read without locking by the render threads
+    KnobValuesSnapshotConstPtr knobValues;
+
     ///The OpenGL context to use for the render of this frame
     OSGLContextWPtr openGLContext;
 
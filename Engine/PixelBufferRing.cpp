@@ -0,0 +1,328 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ * Copyright (C) 2018-2020 The Natron developers
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "PixelBufferRing.h"
+
+#include <vector>
+#include <cassert>
+
+#include <QtCore/QMutex>
+#include <QtCore/QWaitCondition>
+#include <QtCore/QDebug>
+
+#include "Global/GLIncludes.h"
+
+// A buffer never grows beyond this size: a 4K RGBA float texture is ~132MiB
+#define NATRON_PIXEL_BUFFER_RING_MAX_BUFFER_SIZE (256 * 1024 * 1024)
+
+// Every this many calls to mapBuffers(), the buffers shrink if no request needed more than half of their size
+#define NATRON_PIXEL_BUFFER_RING_SHRINK_PERIOD 100
+
+NATRON_NAMESPACE_ENTER
+
+enum PixelBufferStateEnum
+{
+    ePixelBufferStateUnmapped = 0, // not mapped, waiting for mapBuffers()
+    ePixelBufferStateMapping, // being (re)mapped by mapBuffers()
+    ePixelBufferStateAvailable, // mapped and free
+    ePixelBufferStateAcquired // mapped and written by a render thread
+};
+
+struct PixelBuffer
+{
+    GLuint pboID;
+    std::size_t capacity;
+    unsigned char* data;
+    PixelBufferStateEnum state;
+
+    // True while a render thread may write in data, from acquireBuffer() to finishWriting()
+    bool isBeingWritten;
+
+    PixelBuffer()
+        : pboID(0)
+        , capacity(0)
+        , data(0)
+        , state(ePixelBufferStateUnmapped)
+        , isBeingWritten(false)
+    {
+    }
+};
+
+struct PixelBufferRingPrivate
+{
+    // Protects everything but the OpenGL calls, which are only made on the OpenGL thread
+    QMutex lock;
+
+    // Signaled when a buffer is not written anymore
+    QWaitCondition writeFinishedCond;
+
+    std::vector<PixelBuffer> buffers;
+
+    // The size the buffers are (re)allocated with
+    std::size_t capacity;
+
+    // The largest size requested that no buffer could hold
+    std::size_t largestRequest;
+
+    // The largest size requested since the last shrink check, and the number of calls to mapBuffers() since then
+    std::size_t recentLargestRequest;
+    int mapsSinceShrinkCheck;
+
+    // Set by destroyBuffers(): no buffer is handed anymore
+    bool destroyed;
+
+    PixelBufferRingPrivate(int buffersCount)
+        : lock()
+        , writeFinishedCond()
+        , buffers(buffersCount)
+        , capacity(0)
+        , largestRequest(0)
+        , recentLargestRequest(0)
+        , mapsSinceShrinkCheck(0)
+        , destroyed(false)
+    {
+    }
+};
+
+PixelBufferRing::PixelBufferRing(int buffersCount)
+    : _imp( new PixelBufferRingPrivate(buffersCount) )
+{
+}
+
+PixelBufferRing::~PixelBufferRing()
+{
+    // destroyBuffers() must have been called while the context was current
+    assert( _imp->buffers.empty() || !_imp->buffers.front().pboID );
+}
+
+unsigned char*
+PixelBufferRing::acquireBuffer(std::size_t bytesCount,
+                               int* index)
+{
+    *index = -1;
+    if (bytesCount > NATRON_PIXEL_BUFFER_RING_MAX_BUFFER_SIZE) {
+        return 0;
+    }
+
+    QMutexLocker k(&_imp->lock);
+
+    if (_imp->destroyed) {
+        return 0;
+    }
+    if (bytesCount > _imp->recentLargestRequest) {
+        _imp->recentLargestRequest = bytesCount;
+    }
+
+    // Pick the smallest available buffer that fits
+    int found = -1;
+    for (std::size_t i = 0; i < _imp->buffers.size(); ++i) {
+        const PixelBuffer& b = _imp->buffers[i];
+        if (b.state != ePixelBufferStateAvailable) {
+            continue;
+        }
+        if ( (b.capacity >= bytesCount) && ( (found == -1) || (b.capacity < _imp->buffers[found].capacity) ) ) {
+            found = (int)i;
+        }
+    }
+    if (found == -1) {
+        // Let the next mapBuffers() call grow the buffers
+        if (bytesCount > _imp->largestRequest) {
+            _imp->largestRequest = bytesCount;
+        }
+
+        return 0;
+    }
+
+    PixelBuffer& b = _imp->buffers[found];
+    b.state = ePixelBufferStateAcquired;
+    b.isBeingWritten = true;
+    *index = found;
+
+    return b.data;
+}
+
+void
+PixelBufferRing::finishWriting(int index)
+{
+    QMutexLocker k(&_imp->lock);
+
+    assert( index >= 0 && index < (int)_imp->buffers.size() );
+    if ( (index < 0) || ( index >= (int)_imp->buffers.size() ) ) {
+        return;
+    }
+    _imp->buffers[index].isBeingWritten = false;
+    _imp->writeFinishedCond.wakeAll();
+}
+
+void
+PixelBufferRing::releaseBuffer(int index)
+{
+    QMutexLocker k(&_imp->lock);
+
+    assert( index >= 0 && index < (int)_imp->buffers.size() );
+    if ( (index < 0) || ( index >= (int)_imp->buffers.size() ) ) {
+        return;
+    }
+    PixelBuffer& b = _imp->buffers[index];
+    if (b.state == ePixelBufferStateAcquired) {
+        b.state = ePixelBufferStateAvailable;
+    }
+    b.isBeingWritten = false;
+    _imp->writeFinishedCond.wakeAll();
+}
+
+void
+PixelBufferRing::bindForUpload(int index)
+{
+    GLuint pboID;
+    {
+        QMutexLocker k(&_imp->lock);
+        assert( index >= 0 && index < (int)_imp->buffers.size() );
+        PixelBuffer& b = _imp->buffers[index];
+        assert(b.state == ePixelBufferStateAcquired);
+        assert(!b.isBeingWritten);
+        b.state = ePixelBufferStateUnmapped;
+        b.data = 0;
+        pboID = b.pboID;
+    }
+
+    glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, pboID);
+    GLboolean result = glUnmapBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB);
+    if (result != GL_TRUE) {
+        // The content was lost (e.g: screen mode change), the upload will show garbage for a frame
+        qDebug() << "PixelBufferRing: the content of a pixel buffer was lost";
+    }
+    glCheckError();
+}
+
+void
+PixelBufferRing::mapBuffers()
+{
+    // Collect the buffers to (re)map and prevent render threads from acquiring them meanwhile
+    std::vector<int> toMap;
+    std::size_t capacity;
+    {
+        QMutexLocker k(&_imp->lock);
+        if (_imp->destroyed) {
+            return;
+        }
+        if (_imp->largestRequest > _imp->capacity) {
+            _imp->capacity = _imp->largestRequest;
+        }
+        if (++_imp->mapsSinceShrinkCheck >= NATRON_PIXEL_BUFFER_RING_SHRINK_PERIOD) {
+            // Give back the memory of a larger viewer or texture that is not displayed anymore
+            if ( _imp->recentLargestRequest && (_imp->recentLargestRequest * 2 <= _imp->capacity) ) {
+                _imp->capacity = _imp->recentLargestRequest;
+            }
+            _imp->mapsSinceShrinkCheck = 0;
+            _imp->recentLargestRequest = 0;
+        }
+        capacity = _imp->capacity;
+        if (capacity == 0) {
+            // Nothing was ever requested
+            return;
+        }
+        for (std::size_t i = 0; i < _imp->buffers.size(); ++i) {
+            PixelBuffer& b = _imp->buffers[i];
+            bool mustResize = b.capacity != capacity;
+            if ( (b.state == ePixelBufferStateUnmapped) || ( (b.state == ePixelBufferStateAvailable) && mustResize ) ) {
+                b.state = ePixelBufferStateMapping;
+                toMap.push_back( (int)i );
+            }
+        }
+        _imp->largestRequest = 0;
+    }
+    if ( toMap.empty() ) {
+        return;
+    }
+
+    GLint currentBoundPBO = 0;
+    glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING_ARB, &currentBoundPBO);
+
+    for (std::size_t i = 0; i < toMap.size(); ++i) {
+        // Only the OpenGL thread touches these fields while the state is ePixelBufferStateMapping
+        PixelBuffer& b = _imp->buffers[toMap[i]];
+        if (!b.pboID) {
+            glGenBuffersARB(1, &b.pboID);
+        }
+        glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, b.pboID);
+        if (b.data) {
+            // An available buffer that must be resized
+            glUnmapBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB);
+            b.data = 0;
+        }
+        b.capacity = capacity;
+        // Orphan the previous storage, which may still be in use by a pending glTexSubImage2D:
+        // the driver gives us new memory immediately instead of stalling in glMapBuffer.
+        glBufferDataARB(GL_PIXEL_UNPACK_BUFFER_ARB, b.capacity, NULL, GL_STREAM_DRAW_ARB);
+        b.data = (unsigned char*)glMapBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, GL_WRITE_ONLY_ARB);
+        glCheckError();
+    }
+
+    glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, currentBoundPBO);
+
+    QMutexLocker k(&_imp->lock);
+    for (std::size_t i = 0; i < toMap.size(); ++i) {
+        PixelBuffer& b = _imp->buffers[toMap[i]];
+        // If mapping failed (out of memory), leave it unmapped: it will be retried on next call
+        b.state = b.data ? ePixelBufferStateAvailable : ePixelBufferStateUnmapped;
+        if (!b.data) {
+            b.capacity = 0;
+        }
+    }
+} // PixelBufferRing::mapBuffers
+
+void
+PixelBufferRing::destroyBuffers()
+{
+    QMutexLocker k(&_imp->lock);
+
+    _imp->destroyed = true;
+
+    // A render thread may still be writing in a mapped buffer: deleting it would unmap the memory under its feet.
+    // Writing does not depend on the OpenGL thread, this does not block for long.
+    for (;;) {
+        bool isBeingWritten = false;
+        for (std::size_t i = 0; i < _imp->buffers.size(); ++i) {
+            isBeingWritten |= _imp->buffers[i].isBeingWritten;
+        }
+        if (!isBeingWritten) {
+            break;
+        }
+        _imp->writeFinishedCond.wait(&_imp->lock);
+    }
+
+    for (std::size_t i = 0; i < _imp->buffers.size(); ++i) {
+        PixelBuffer& b = _imp->buffers[i];
+        if (b.pboID) {
+            // Deleting a mapped buffer unmaps it
+            glDeleteBuffersARB(1, &b.pboID);
+        }
+        b = PixelBuffer();
+    }
+    glCheckError();
+}
+
+NATRON_NAMESPACE_EXIT
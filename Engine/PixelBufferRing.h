@@ -0,0 +1,118 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ * Copyright (C) 2018-2020 The Natron developers
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_PIXELBUFFERRING_H
+#define NATRON_ENGINE_PIXELBUFFERRING_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <cstddef>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/scoped_ptr.hpp>
+#endif
+
+#include "Engine/EngineFwd.h"
+
+NATRON_NAMESPACE_ENTER
+
+struct PixelBufferRingPrivate;
+
+/**
+ * @brief A ring of OpenGL pixel buffer objects kept mapped between uploads, so that render threads
+ * may convert pixels directly into the memory the texture is uploaded from, instead of converting into a
+ * RAM buffer that the OpenGL thread then has to copy into a PBO.
+ *
+ * The life-cycle of a buffer is:
+ * - mapBuffers() (OpenGL thread) orphans and maps the buffer: it becomes available
+ * - acquireBuffer() (any thread) hands the mapped memory to a render thread, which calls finishWriting()
+ * once the pixels are written
+ * - bindForUpload() (OpenGL thread) unmaps the buffer and binds it to GL_PIXEL_UNPACK_BUFFER so that
+ * glTexSubImage2D reads from it, after which mapBuffers() maps it again.
+ * - releaseBuffer() (any thread) gives back a buffer that was acquired but will never be uploaded.
+ *
+ * Orphaning the storage with glBufferData before mapping again means the driver never has to wait
+ * for a pending transfer to complete, and only requires ARB_pixel_buffer_object.
+ * The buffers grow to the largest size that was requested (up to a limit): the first frame
+ * after a resize of the viewer goes through the regular RAM path. They shrink back when the requests
+ * stay below half of their size for a while.
+ **/
+class PixelBufferRing
+{
+public:
+
+    PixelBufferRing(int buffersCount);
+
+    ~PixelBufferRing();
+
+    /**
+     * @brief Returns a pointer to mapped memory of at least bytesCount bytes and its index in the ring,
+     * or NULL if no buffer is currently available.
+     * MT-safe
+     **/
+    unsigned char* acquireBuffer(std::size_t bytesCount, int* index);
+
+    /**
+     * @brief Called by the render thread once it is done writing in a buffer returned by acquireBuffer().
+     * MT-safe
+     **/
+    void finishWriting(int index);
+
+    /**
+     * @brief Gives back a buffer returned by acquireBuffer() that is not going to be uploaded.
+     * This also ends writing in it.
+     * MT-safe
+     **/
+    void releaseBuffer(int index);
+
+    /**
+     * @brief Unmaps the acquired buffer at the given index and binds it to GL_PIXEL_UNPACK_BUFFER.
+     * The caller is responsible for restoring the previous binding.
+     * Must be called on the thread owning the OpenGL context.
+     **/
+    void bindForUpload(int index);
+
+    /**
+     * @brief Allocates and maps the buffers that are not mapped, growing them if a render thread
+     * requested more memory than they hold. Cheap when there is nothing to do.
+     * Must be called on the thread owning the OpenGL context.
+     **/
+    void mapBuffers();
+
+    /**
+     * @brief Waits for the render threads to finish writing in the buffers they acquired, then deletes all buffers.
+     * No buffer is handed anymore afterwards.
+     * Must be called on the thread owning the OpenGL context.
+     **/
+    void destroyBuffers();
+
+private:
+
+    boost::scoped_ptr<PixelBufferRingPrivate> _imp;
+};
+
+NATRON_NAMESPACE_EXIT
+
+#endif // NATRON_ENGINE_PIXELBUFFERRING_H
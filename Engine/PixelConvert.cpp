@@ -0,0 +1,562 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ * Copyright (C) 2018-2020 The Natron developers
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "PixelConvert.h"
+
+#include <cstring> // for std::memcpy
+
+#ifdef NATRON_PIXEL_CONVERT_X86_SIMD
+#include <immintrin.h>
+#define NATRON_TARGET_SSE41 __attribute__( ( target("sse4.1") ) )
+#define NATRON_TARGET_AVX2 __attribute__( ( target("avx2") ) )
+#endif
+
+#include "Global/GlobalDefines.h"
+
+#include "Engine/Lut.h"
+
+NATRON_NAMESPACE_ENTER
+
+namespace PixelConvert {
+
+///////////////////////
+/////////////////////////////////////////// SCALAR //////////////////////////////////////////////
+///////////////////////
+
+// This is the same as hipart() in Lut.cpp, independently of the endianness
+static inline unsigned short
+floatHiPart(float f)
+{
+    U32 bits;
+
+    std::memcpy( &bits, &f, sizeof(float) );
+
+    return (unsigned short)(bits >> 16);
+}
+
+template <int numvals, typename DSTPIX>
+static void
+floatToIntScalar(const float* src,
+                 DSTPIX* dst,
+                 int n)
+{
+    for (int i = 0; i < n; ++i) {
+        dst[i] = (DSTPIX)Color::floatToInt<numvals>(src[i]);
+    }
+}
+
+template <int numvals, typename SRCPIX>
+static void
+intToFloatScalar(const SRCPIX* src,
+                 float* dst,
+                 int n)
+{
+    for (int i = 0; i < n; ++i) {
+        dst[i] = Color::intToFloat<numvals>(src[i]);
+    }
+}
+
+static void
+computeLutIndicesScalar(const float* src,
+                        unsigned short* dst,
+                        int n)
+{
+    for (int i = 0; i < n; ++i) {
+        dst[i] = floatHiPart(src[i]);
+    }
+}
+
+static void
+computeLutIndicesPremult4Scalar(const float* src,
+                                unsigned short* dst,
+                                int nPixels)
+{
+    for (int i = 0; i < nPixels; ++i, src += 4, dst += 4) {
+        const float a = src[3];
+        dst[0] = floatHiPart(src[0] * a);
+        dst[1] = floatHiPart(src[1] * a);
+        dst[2] = floatHiPart(src[2] * a);
+        dst[3] = floatHiPart(a);
+    }
+}
+
+#ifdef NATRON_PIXEL_CONVERT_X86_SIMD
+
+///////////////////////
+/////////////////////////////////////////// SSE4.1 //////////////////////////////////////////////
+///////////////////////
+
+// Same as Color::floatToInt<numvals>: values <= 0 give 0, values >= 1 give numvals - 1,
+// otherwise int(v * (numvals - 1) + 0.5f). The multiply and add are not fused, as in the scalar code.
+template <int numvals>
+NATRON_TARGET_SSE41 static inline __m128i
+floatToIntSSE41(__m128 v)
+{
+    __m128 scaled = _mm_add_ps( _mm_mul_ps( v, _mm_set1_ps( (float)(numvals - 1) ) ), _mm_set1_ps(0.5f) );
+    __m128i i = _mm_cvttps_epi32(scaled);
+    __m128i isNegative = _mm_castps_si128( _mm_cmple_ps( v, _mm_setzero_ps() ) );
+    __m128i isOverOne = _mm_castps_si128( _mm_cmpge_ps( v, _mm_set1_ps(1.f) ) );
+
+    i = _mm_andnot_si128(isNegative, i);
+
+    return _mm_blendv_epi8(i, _mm_set1_epi32(numvals - 1), isOverOne);
+}
+
+template <int numvals>
+NATRON_TARGET_SSE41 static void
+floatToShortSSE41(const float* src,
+                  unsigned short* dst,
+                  int n)
+{
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m128i lo = floatToIntSSE41<numvals>( _mm_loadu_ps(src + i) );
+        __m128i hi = floatToIntSSE41<numvals>( _mm_loadu_ps(src + i + 4) );
+        _mm_storeu_si128( (__m128i*)(dst + i), _mm_packus_epi32(lo, hi) );
+    }
+    floatToIntScalar<numvals, unsigned short>(src + i, dst + i, n - i);
+}
+
+NATRON_TARGET_SSE41 static void
+floatToByteSSE41(const float* src,
+                 unsigned char* dst,
+                 int n)
+{
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m128i lo = floatToIntSSE41<256>( _mm_loadu_ps(src + i) );
+        __m128i hi = floatToIntSSE41<256>( _mm_loadu_ps(src + i + 4) );
+        __m128i shorts = _mm_packus_epi32(lo, hi);
+        _mm_storel_epi64( (__m128i*)(dst + i), _mm_packus_epi16(shorts, shorts) );
+    }
+    floatToIntScalar<256, unsigned char>(src + i, dst + i, n - i);
+}
+
+NATRON_TARGET_SSE41 static void
+byteToFloatSSE41(const unsigned char* src,
+                 float* dst,
+                 int n)
+{
+    const __m128 scale = _mm_set1_ps(255.f);
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        int packed;
+        std::memcpy( &packed, src + i, sizeof(int) );
+        __m128i v = _mm_cvtepu8_epi32( _mm_cvtsi32_si128(packed) );
+        _mm_storeu_ps( dst + i, _mm_div_ps(_mm_cvtepi32_ps(v), scale) );
+    }
+    intToFloatScalar<256, unsigned char>(src + i, dst + i, n - i);
+}
+
+NATRON_TARGET_SSE41 static void
+shortToFloatSSE41(const unsigned short* src,
+                  float* dst,
+                  int n)
+{
+    const __m128 scale = _mm_set1_ps(65535.f);
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __m128i v = _mm_cvtepu16_epi32( _mm_loadl_epi64( (const __m128i*)(src + i) ) );
+        _mm_storeu_ps( dst + i, _mm_div_ps(_mm_cvtepi32_ps(v), scale) );
+    }
+    intToFloatScalar<65536, unsigned short>(src + i, dst + i, n - i);
+}
+
+NATRON_TARGET_SSE41 static void
+computeLutIndicesSSE41(const float* src,
+                       unsigned short* dst,
+                       int n)
+{
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m128i lo = _mm_srli_epi32(_mm_castps_si128( _mm_loadu_ps(src + i) ), 16);
+        __m128i hi = _mm_srli_epi32(_mm_castps_si128( _mm_loadu_ps(src + i + 4) ), 16);
+        _mm_storeu_si128( (__m128i*)(dst + i), _mm_packus_epi32(lo, hi) );
+    }
+    computeLutIndicesScalar(src + i, dst + i, n - i);
+}
+
+NATRON_TARGET_SSE41 static inline __m128i
+premult4IndicesSSE41(__m128 p)
+{
+    __m128 a = _mm_shuffle_ps( p, p, _MM_SHUFFLE(3, 3, 3, 3) );
+    // keep the alpha itself in the 4th component
+    __m128 premult = _mm_blend_ps(_mm_mul_ps(p, a), p, 0x8);
+
+    return _mm_srli_epi32(_mm_castps_si128(premult), 16);
+}
+
+NATRON_TARGET_SSE41 static void
+computeLutIndicesPremult4SSE41(const float* src,
+                               unsigned short* dst,
+                               int nPixels)
+{
+    int i = 0;
+
+    for (; i + 2 <= nPixels; i += 2) {
+        __m128i p0 = premult4IndicesSSE41( _mm_loadu_ps(src + i * 4) );
+        __m128i p1 = premult4IndicesSSE41( _mm_loadu_ps(src + i * 4 + 4) );
+        _mm_storeu_si128( (__m128i*)(dst + i * 4), _mm_packus_epi32(p0, p1) );
+    }
+    computeLutIndicesPremult4Scalar(src + i * 4, dst + i * 4, nPixels - i);
+}
+
+///////////////////////
+/////////////////////////////////////////// AVX2 //////////////////////////////////////////////
+///////////////////////
+
+template <int numvals>
+NATRON_TARGET_AVX2 static inline __m256i
+floatToIntAVX2(__m256 v)
+{
+    __m256 scaled = _mm256_add_ps( _mm256_mul_ps( v, _mm256_set1_ps( (float)(numvals - 1) ) ), _mm256_set1_ps(0.5f) );
+    __m256i i = _mm256_cvttps_epi32(scaled);
+    __m256i isNegative = _mm256_castps_si256( _mm256_cmp_ps(v, _mm256_setzero_ps(), _CMP_LE_OQ) );
+    __m256i isOverOne = _mm256_castps_si256( _mm256_cmp_ps(v, _mm256_set1_ps(1.f), _CMP_GE_OQ) );
+
+    i = _mm256_andnot_si256(isNegative, i);
+
+    return _mm256_blendv_epi8(i, _mm256_set1_epi32(numvals - 1), isOverOne);
+}
+
+// Packs 2x8 32-bit integers in [0, 65535] to 16 ordered unsigned shorts:
+// _mm256_packus_epi32 works on each 128-bit lane separately, so the 64-bit blocks have to be reordered.
+NATRON_TARGET_AVX2 static inline __m256i
+packUnsignedShortsAVX2(__m256i lo,
+                       __m256i hi)
+{
+    return _mm256_permute4x64_epi64( _mm256_packus_epi32(lo, hi), _MM_SHUFFLE(3, 1, 2, 0) );
+}
+
+template <int numvals>
+NATRON_TARGET_AVX2 static void
+floatToShortAVX2(const float* src,
+                 unsigned short* dst,
+                 int n)
+{
+    int i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        __m256i lo = floatToIntAVX2<numvals>( _mm256_loadu_ps(src + i) );
+        __m256i hi = floatToIntAVX2<numvals>( _mm256_loadu_ps(src + i + 8) );
+        _mm256_storeu_si256( (__m256i*)(dst + i), packUnsignedShortsAVX2(lo, hi) );
+    }
+    floatToIntScalar<numvals, unsigned short>(src + i, dst + i, n - i);
+}
+
+NATRON_TARGET_AVX2 static void
+floatToByteAVX2(const float* src,
+                unsigned char* dst,
+                int n)
+{
+    int i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        __m256i lo = floatToIntAVX2<256>( _mm256_loadu_ps(src + i) );
+        __m256i hi = floatToIntAVX2<256>( _mm256_loadu_ps(src + i + 8) );
+        __m256i shorts = packUnsignedShortsAVX2(lo, hi);
+        __m128i bytes = _mm_packus_epi16( _mm256_castsi256_si128(shorts), _mm256_extracti128_si256(shorts, 1) );
+        _mm_storeu_si128( (__m128i*)(dst + i), bytes );
+    }
+    floatToIntScalar<256, unsigned char>(src + i, dst + i, n - i);
+}
+
+NATRON_TARGET_AVX2 static void
+byteToFloatAVX2(const unsigned char* src,
+                float* dst,
+                int n)
+{
+    const __m256 scale = _mm256_set1_ps(255.f);
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_cvtepu8_epi32( _mm_loadl_epi64( (const __m128i*)(src + i) ) );
+        _mm256_storeu_ps( dst + i, _mm256_div_ps(_mm256_cvtepi32_ps(v), scale) );
+    }
+    intToFloatScalar<256, unsigned char>(src + i, dst + i, n - i);
+}
+
+NATRON_TARGET_AVX2 static void
+shortToFloatAVX2(const unsigned short* src,
+                 float* dst,
+                 int n)
+{
+    const __m256 scale = _mm256_set1_ps(65535.f);
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_cvtepu16_epi32( _mm_loadu_si128( (const __m128i*)(src + i) ) );
+        _mm256_storeu_ps( dst + i, _mm256_div_ps(_mm256_cvtepi32_ps(v), scale) );
+    }
+    intToFloatScalar<65536, unsigned short>(src + i, dst + i, n - i);
+}
+
+NATRON_TARGET_AVX2 static void
+computeLutIndicesAVX2(const float* src,
+                      unsigned short* dst,
+                      int n)
+{
+    int i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        __m256i lo = _mm256_srli_epi32(_mm256_castps_si256( _mm256_loadu_ps(src + i) ), 16);
+        __m256i hi = _mm256_srli_epi32(_mm256_castps_si256( _mm256_loadu_ps(src + i + 8) ), 16);
+        _mm256_storeu_si256( (__m256i*)(dst + i), packUnsignedShortsAVX2(lo, hi) );
+    }
+    computeLutIndicesScalar(src + i, dst + i, n - i);
+}
+
+NATRON_TARGET_AVX2 static inline __m256i
+premult4IndicesAVX2(__m256 p)
+{
+    __m256 a = _mm256_permute_ps( p, _MM_SHUFFLE(3, 3, 3, 3) );
+    __m256 premult = _mm256_blend_ps(_mm256_mul_ps(p, a), p, 0x88);
+
+    return _mm256_srli_epi32(_mm256_castps_si256(premult), 16);
+}
+
+NATRON_TARGET_AVX2 static void
+computeLutIndicesPremult4AVX2(const float* src,
+                              unsigned short* dst,
+                              int nPixels)
+{
+    int i = 0;
+
+    for (; i + 4 <= nPixels; i += 4) {
+        __m256i p0 = premult4IndicesAVX2( _mm256_loadu_ps(src + i * 4) );
+        __m256i p1 = premult4IndicesAVX2( _mm256_loadu_ps(src + i * 4 + 8) );
+        _mm256_storeu_si256( (__m256i*)(dst + i * 4), packUnsignedShortsAVX2(p0, p1) );
+    }
+    computeLutIndicesPremult4Scalar(src + i * 4, dst + i * 4, nPixels - i);
+}
+
+#endif // NATRON_PIXEL_CONVERT_X86_SIMD
+
+///////////////////////
+/////////////////////////////////////////// DISPATCH //////////////////////////////////////////////
+///////////////////////
+
+static InstructionSetEnum
+detectHostInstructionSet()
+{
+#ifdef NATRON_PIXEL_CONVERT_X86_SIMD
+    // we may be called before the constructors run, see the gcc documentation of __builtin_cpu_supports
+    __builtin_cpu_init();
+    if ( __builtin_cpu_supports("avx2") ) {
+        return eInstructionSetAVX2;
+    }
+    if ( __builtin_cpu_supports("sse4.1") ) {
+        return eInstructionSetSSE41;
+    }
+#endif
+
+    return eInstructionSetScalar;
+}
+
+static const InstructionSetEnum g_hostInstructionSet = detectHostInstructionSet();
+static InstructionSetEnum g_maxInstructionSet = eInstructionSetAVX2;
+
+InstructionSetEnum
+getHostInstructionSet()
+{
+    return g_hostInstructionSet;
+}
+
+InstructionSetEnum
+getInstructionSet()
+{
+    return g_maxInstructionSet < g_hostInstructionSet ? g_maxInstructionSet : g_hostInstructionSet;
+}
+
+void
+setMaxInstructionSet(InstructionSetEnum set)
+{
+    g_maxInstructionSet = set;
+}
+
+const char*
+getInstructionSetName(InstructionSetEnum set)
+{
+    switch (set) {
+    case eInstructionSetAVX2:
+
+        return "AVX2";
+    case eInstructionSetSSE41:
+
+        return "SSE4.1";
+    case eInstructionSetScalar:
+    default:
+
+        return "Scalar";
+    }
+}
+
+void
+convertByteToFloat(const unsigned char* src,
+                   float* dst,
+                   int n)
+{
+    switch ( getInstructionSet() ) {
+#ifdef NATRON_PIXEL_CONVERT_X86_SIMD
+    case eInstructionSetAVX2:
+        byteToFloatAVX2(src, dst, n);
+        break;
+    case eInstructionSetSSE41:
+        byteToFloatSSE41(src, dst, n);
+        break;
+#endif
+    default:
+        intToFloatScalar<256, unsigned char>(src, dst, n);
+        break;
+    }
+}
+
+void
+convertShortToFloat(const unsigned short* src,
+                    float* dst,
+                    int n)
+{
+    switch ( getInstructionSet() ) {
+#ifdef NATRON_PIXEL_CONVERT_X86_SIMD
+    case eInstructionSetAVX2:
+        shortToFloatAVX2(src, dst, n);
+        break;
+    case eInstructionSetSSE41:
+        shortToFloatSSE41(src, dst, n);
+        break;
+#endif
+    default:
+        intToFloatScalar<65536, unsigned short>(src, dst, n);
+        break;
+    }
+}
+
+void
+convertFloatToByte(const float* src,
+                   unsigned char* dst,
+                   int n)
+{
+    switch ( getInstructionSet() ) {
+#ifdef NATRON_PIXEL_CONVERT_X86_SIMD
+    case eInstructionSetAVX2:
+        floatToByteAVX2(src, dst, n);
+        break;
+    case eInstructionSetSSE41:
+        floatToByteSSE41(src, dst, n);
+        break;
+#endif
+    default:
+        floatToIntScalar<256, unsigned char>(src, dst, n);
+        break;
+    }
+}
+
+void
+convertFloatToShort(const float* src,
+                    unsigned short* dst,
+                    int n)
+{
+    switch ( getInstructionSet() ) {
+#ifdef NATRON_PIXEL_CONVERT_X86_SIMD
+    case eInstructionSetAVX2:
+        floatToShortAVX2<65536>(src, dst, n);
+        break;
+    case eInstructionSetSSE41:
+        floatToShortSSE41<65536>(src, dst, n);
+        break;
+#endif
+    default:
+        floatToIntScalar<65536, unsigned short>(src, dst, n);
+        break;
+    }
+}
+
+void
+convertFloatToUint8xx(const float* src,
+                      unsigned short* dst,
+                      int n)
+{
+    switch ( getInstructionSet() ) {
+#ifdef NATRON_PIXEL_CONVERT_X86_SIMD
+    case eInstructionSetAVX2:
+        floatToShortAVX2<0xff01>(src, dst, n);
+        break;
+    case eInstructionSetSSE41:
+        floatToShortSSE41<0xff01>(src, dst, n);
+        break;
+#endif
+    default:
+        floatToIntScalar<0xff01, unsigned short>(src, dst, n);
+        break;
+    }
+}
+
+void
+computeLutIndices(const float* src,
+                  unsigned short* dst,
+                  int n)
+{
+    switch ( getInstructionSet() ) {
+#ifdef NATRON_PIXEL_CONVERT_X86_SIMD
+    case eInstructionSetAVX2:
+        computeLutIndicesAVX2(src, dst, n);
+        break;
+    case eInstructionSetSSE41:
+        computeLutIndicesSSE41(src, dst, n);
+        break;
+#endif
+    default:
+        computeLutIndicesScalar(src, dst, n);
+        break;
+    }
+}
+
+void
+computeLutIndicesPremult4(const float* src,
+                          unsigned short* dst,
+                          int nPixels)
+{
+    switch ( getInstructionSet() ) {
+#ifdef NATRON_PIXEL_CONVERT_X86_SIMD
+    case eInstructionSetAVX2:
+        computeLutIndicesPremult4AVX2(src, dst, nPixels);
+        break;
+    case eInstructionSetSSE41:
+        computeLutIndicesPremult4SSE41(src, dst, nPixels);
+        break;
+#endif
+    default:
+        computeLutIndicesPremult4Scalar(src, dst, nPixels);
+        break;
+    }
+}
+} // namespace PixelConvert
+
+NATRON_NAMESPACE_EXIT
@@ -0,0 +1,103 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ * Copyright (C) 2018-2020 The Natron developers
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_PIXELCONVERT_H
+#define NATRON_ENGINE_PIXELCONVERT_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include "Engine/EngineFwd.h"
+
+// SSE4.1/AVX2 code paths are only compiled with compilers supporting the target attribute on x86.
+// Other platforms always use the scalar code.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define NATRON_PIXEL_CONVERT_X86_SIMD
+#endif
+
+NATRON_NAMESPACE_ENTER
+
+/**
+ * @brief Row conversion kernels used by Image::convertToFormat* and Color::Lut.
+ * Each kernel has a scalar implementation and, on x86, SSE4.1 and AVX2 implementations selected at runtime
+ * depending on what the CPU supports. All implementations produce bit-exact results: they compute exactly
+ * what the scalar Color::floatToInt / Color::intToFloat functions compute, one element at a time.
+ **/
+namespace PixelConvert {
+enum InstructionSetEnum
+{
+    eInstructionSetScalar = 0,
+    eInstructionSetSSE41,
+    eInstructionSetAVX2
+};
+
+/**
+ * @brief Returns the best instruction set supported by the CPU and compiled in.
+ **/
+InstructionSetEnum getHostInstructionSet();
+
+/**
+ * @brief Returns the instruction set actually used by the kernels, that is the host instruction set
+ * clamped by setMaxInstructionSet().
+ **/
+InstructionSetEnum getInstructionSet();
+
+/**
+ * @brief Limit the instruction set used by the kernels. This is mainly useful to compare
+ * the SIMD code paths against the scalar code in the unit tests.
+ **/
+void setMaxInstructionSet(InstructionSetEnum set);
+
+const char* getInstructionSetName(InstructionSetEnum set);
+
+/// Color::intToFloat<256>() on n elements
+void convertByteToFloat(const unsigned char* src, float* dst, int n);
+
+/// Color::intToFloat<65536>() on n elements
+void convertShortToFloat(const unsigned short* src, float* dst, int n);
+
+/// Color::floatToInt<256>() on n elements
+void convertFloatToByte(const float* src, unsigned char* dst, int n);
+
+/// Color::floatToInt<65536>() on n elements
+void convertFloatToShort(const float* src, unsigned short* dst, int n);
+
+/// Color::floatToInt<0xff01>() on n elements: this is the input of the error diffusion when converting to 8-bit
+void convertFloatToUint8xx(const float* src, unsigned short* dst, int n);
+
+/**
+ * @brief Computes the index in the Lut 16-bit tables (the high 16 bits of the float) of n elements.
+ **/
+void computeLutIndices(const float* src, unsigned short* dst, int n);
+
+/**
+ * @brief Same as computeLutIndices on nPixels 4-components pixels whose alpha is the 4th component,
+ * but the 3 first components are multiplied by the alpha before. The 4th index is the index of the alpha itself.
+ **/
+void computeLutIndicesPremult4(const float* src, unsigned short* dst, int nPixels);
+} // namespace PixelConvert
+
+NATRON_NAMESPACE_EXIT
+
+#endif // NATRON_ENGINE_PIXELCONVERT_H
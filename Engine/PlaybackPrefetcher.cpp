@@ -0,0 +1,403 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ * Copyright (C) 2018-2020 The Natron developers
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "PlaybackPrefetcher.h"
+
+#include <algorithm> // find
+#include <cassert>
+#include <map>
+#include <set>
+#include <stdexcept>
+
+#include <QtCore/QDebug>
+#include <QtCore/QMutex>
+#include <QtCore/QThread>
+#include <QtCore/QWaitCondition>
+
+#include "Engine/AbortableRenderInfo.h"
+#include "Engine/AppInstance.h"
+#include "Engine/AppManager.h"
+#include "Engine/EffectInstance.h"
+#include "Engine/Image.h"
+#include "Engine/ImagePlaneDesc.h"
+#include "Engine/Node.h"
+#include "Engine/ParallelRenderArgs.h"
+#include "Engine/RectD.h"
+#include "Engine/RectI.h"
+#include "Engine/ThreadPool.h"
+#include "Engine/TimeLine.h"
+#include "Engine/TLSHolder.h"
+
+NATRON_NAMESPACE_ENTER
+
+class PlaybackPrefetcherThread
+    : public QThread
+      , public AbortableThread
+{
+public:
+
+    PlaybackPrefetcherThread(PlaybackPrefetcherPrivate* prefetcher)
+        : QThread()
+        , AbortableThread(this)
+        , _prefetcher(prefetcher)
+    {
+        setThreadName("Playback prefetcher");
+    }
+
+    virtual ~PlaybackPrefetcherThread()
+    {
+    }
+
+private:
+
+    virtual void run() OVERRIDE FINAL;
+
+    PlaybackPrefetcherPrivate* _prefetcher;
+};
+
+struct PlaybackPrefetcherPrivate
+{
+    // Protects all fields below
+    QMutex lock;
+
+    // Signaled when frames are queued or when the threads must quit
+    QWaitCondition framesQueuedCond;
+
+    // What to prefetch, set in start()
+    NodesWList readers;
+    std::vector<ViewIdx> views;
+    unsigned int mipMapLevel;
+
+    // The frames waiting for a thread, the first one is the most urgent
+    std::list<int> queuedFrames;
+
+    // All frames queued since the last call to start(), to not decode a frame twice
+    std::set<int> requestedFrames;
+
+    // The abort info of the frames being decoded
+    std::list<AbortableRenderInfoPtr> inProgress;
+
+    // Incremented by start() and cancel(): a frame decoded for an older generation must not be marked as requested
+    U64 generation;
+
+    bool active;
+    bool mustQuit;
+
+    std::vector<PlaybackPrefetcherThread*> threads;
+
+    PlaybackPrefetcherPrivate()
+        : lock()
+        , framesQueuedCond()
+        , readers()
+        , views()
+        , mipMapLevel(0)
+        , queuedFrames()
+        , requestedFrames()
+        , inProgress()
+        , generation(0)
+        , active(false)
+        , mustQuit(false)
+        , threads()
+    {
+    }
+
+    /**
+     * @brief Drops the queued frames and aborts the frames being decoded, lock must be taken.
+     **/
+    void cancelInternal()
+    {
+        assert( !lock.tryLock() );
+        ++generation;
+        queuedFrames.clear();
+        requestedFrames.clear();
+        for (std::list<AbortableRenderInfoPtr>::iterator it = inProgress.begin(); it != inProgress.end(); ++it) {
+            (*it)->setAborted();
+        }
+    }
+
+    /**
+     * @brief Called by a thread once a frame has been decoded or skipped.
+     **/
+    void onFrameDone(int frame,
+                     U64 frameGeneration,
+                     const AbortableRenderInfoPtr& abortInfo,
+                     bool prefetched)
+    {
+        QMutexLocker k(&lock);
+        std::list<AbortableRenderInfoPtr>::iterator found = std::find(inProgress.begin(), inProgress.end(), abortInfo);
+
+        assert( found != inProgress.end() );
+        if ( found != inProgress.end() ) {
+            inProgress.erase(found);
+        }
+
+        // A frame that was not prefetched may be queued again once the cache has some room
+        if ( !prefetched && (frameGeneration == generation) ) {
+            requestedFrames.erase(frame);
+        }
+    }
+
+    static void prefetchReaderFrame(const NodePtr& node,
+                                    int frame,
+                                    ViewIdx view,
+                                    unsigned int mipMapLevel,
+                                    const AbortableRenderInfoPtr& abortInfo);
+};
+
+void
+PlaybackPrefetcherPrivate::prefetchReaderFrame(const NodePtr& node,
+                                               int frame,
+                                               ViewIdx view,
+                                               unsigned int mipMapLevel,
+                                               const AbortableRenderInfoPtr& abortInfo)
+{
+    if ( !node->isActivated() || node->isNodeDisabled() ) {
+        return;
+    }
+    EffectInstancePtr effect = node->getEffectInstance();
+    if (!effect) {
+        return;
+    }
+
+    const bool isRenderUserInteraction = false;
+    const bool isSequentialRender = true;
+    AbortableThread* isAbortable = dynamic_cast<AbortableThread*>( QThread::currentThread() );
+    if (isAbortable) {
+        isAbortable->setAbortInfo(isRenderUserInteraction, abortInfo, effect);
+    }
+    ParallelRenderArgsSetter frameRenderArgs( frame,
+                                              view,
+                                              isRenderUserInteraction,
+                                              isSequentialRender,
+                                              abortInfo,
+                                              node, // requester
+                                              0, //texture index
+                                              node->getApp()->getTimeLine().get(),
+                                              NodePtr(), // rotoPaintNode
+                                              false, //isAnalysis
+                                              false, //draftMode
+                                              RenderStatsPtr() );
+    RenderScale scale( Image::getScaleFromMipMapLevel(mipMapLevel) );
+    RectD rod;
+    bool isProjectFormat;
+    StatusEnum stat = effect->getRegionOfDefinition_public(node->getHashValue(), frame, scale, view, &rod, &isProjectFormat);
+    if ( (stat == eStatusFailed) || rod.isNull() ) {
+        return;
+    }
+    RectI roi;
+    rod.toPixelEnclosing( mipMapLevel, effect->getAspectRatio(-1), &roi );
+
+    // Decode the plane the reader produces, that is what the renders downstream fetch from the cache
+    ImagePlaneDesc plane, pairedPlane;
+    effect->getMetadataComponents(-1, &plane, &pairedPlane);
+    std::list<ImagePlaneDesc> components;
+    components.push_back(plane);
+
+    EffectInstance::RenderRoIArgs args( frame,
+                                        scale,
+                                        mipMapLevel,
+                                        view,
+                                        false, // byPassCache
+                                        roi,
+                                        rod,
+                                        components,
+                                        effect->getBitDepth(-1),
+                                        false, // calledFromGetImage
+                                        effect.get(),
+                                        eStorageModeRAM,
+                                        frame );
+    std::map<ImagePlaneDesc, ImagePtr> planes;
+    ignore_result( effect->renderRoI(args, &planes) );
+} // PlaybackPrefetcherPrivate::prefetchReaderFrame
+
+void
+PlaybackPrefetcherThread::run()
+{
+    for (;;) {
+        int frame;
+        U64 frameGeneration;
+        NodesList readers;
+        std::vector<ViewIdx> views;
+        unsigned int mipMapLevel;
+        AbortableRenderInfoPtr abortInfo = AbortableRenderInfo::create(true, 0);
+        {
+            QMutexLocker k(&_prefetcher->lock);
+            while ( _prefetcher->queuedFrames.empty() && !_prefetcher->mustQuit ) {
+                _prefetcher->framesQueuedCond.wait(&_prefetcher->lock);
+            }
+            if (_prefetcher->mustQuit) {
+                return;
+            }
+            frame = _prefetcher->queuedFrames.front();
+            _prefetcher->queuedFrames.pop_front();
+            frameGeneration = _prefetcher->generation;
+            for (NodesWList::const_iterator it = _prefetcher->readers.begin(); it != _prefetcher->readers.end(); ++it) {
+                NodePtr reader = it->lock();
+                if (reader) {
+                    readers.push_back(reader);
+                }
+            }
+            views = _prefetcher->views;
+            mipMapLevel = _prefetcher->mipMapLevel;
+            _prefetcher->inProgress.push_back(abortInfo);
+        }
+
+        // Do not make room in the cache for frames that are further away than the ones the renders need
+        bool prefetched = !appPTR->isNodeCacheAlmostFull();
+        for (NodesList::iterator it = readers.begin(); prefetched && it != readers.end(); ++it) {
+            for (std::vector<ViewIdx>::iterator it2 = views.begin(); it2 != views.end(); ++it2) {
+                if ( abortInfo->isAborted() ) {
+                    prefetched = false;
+                    break;
+                }
+                try {
+                    PlaybackPrefetcherPrivate::prefetchReaderFrame(*it, frame, *it2, mipMapLevel, abortInfo);
+                } catch (const std::exception& e) {
+                    // The render that needs the frame will report the error
+                    qDebug() << "Playback prefetcher: failed to decode frame" << frame << "of" << QString::fromUtf8( (*it)->getScriptName_mt_safe().c_str() ) << ":" << e.what();
+                }
+            }
+        }
+
+        clearAbortInfo();
+        appPTR->getAppTLS()->cleanupTLSForThread();
+
+        _prefetcher->onFrameDone(frame, frameGeneration, abortInfo, prefetched);
+    }
+}
+
+PlaybackPrefetcher::PlaybackPrefetcher()
+    : _imp( new PlaybackPrefetcherPrivate() )
+{
+}
+
+PlaybackPrefetcher::~PlaybackPrefetcher()
+{
+    {
+        QMutexLocker k(&_imp->lock);
+        _imp->cancelInternal();
+        _imp->mustQuit = true;
+        _imp->framesQueuedCond.wakeAll();
+    }
+    for (std::vector<PlaybackPrefetcherThread*>::iterator it = _imp->threads.begin(); it != _imp->threads.end(); ++it) {
+        (*it)->wait();
+        delete *it;
+    }
+}
+
+static void
+getReadersUpstreamRecursive(const NodePtr& node,
+                            std::set<NodePtr>* visited,
+                            NodesList* readers)
+{
+    if ( !visited->insert(node).second ) {
+        return;
+    }
+    EffectInstancePtr effect = node->getEffectInstance();
+    if ( effect && effect->isReader() ) {
+        // Readers that must decode frames in order cannot be decoded ahead of time from another thread
+        if ( (effect->getSequentialPreference() != eSequentialPreferenceOnlySequential) &&
+             ( std::find(readers->begin(), readers->end(), node) == readers->end() ) ) {
+            readers->push_back(node);
+        }
+
+        return;
+    }
+    int nInputs = node->getNInputs();
+    for (int i = 0; i < nInputs; ++i) {
+        NodePtr input = node->getInput(i);
+        if (input) {
+            getReadersUpstreamRecursive(input, visited, readers);
+        }
+    }
+}
+
+void
+PlaybackPrefetcher::getReadersUpstream(const NodePtr& node,
+                                       NodesList* readers)
+{
+    if (!node) {
+        return;
+    }
+    std::set<NodePtr> visited;
+    getReadersUpstreamRecursive(node, &visited, readers);
+}
+
+void
+PlaybackPrefetcher::start(const NodesList& readers,
+                          const std::vector<ViewIdx>& views,
+                          unsigned int mipMapLevel)
+{
+    QMutexLocker k(&_imp->lock);
+
+    _imp->cancelInternal();
+    _imp->readers.clear();
+    for (NodesList::const_iterator it = readers.begin(); it != readers.end(); ++it) {
+        _imp->readers.push_back(*it);
+    }
+    _imp->views = views;
+    _imp->mipMapLevel = mipMapLevel;
+    _imp->active = !readers.empty() && !views.empty();
+}
+
+void
+PlaybackPrefetcher::prefetchFrames(const std::list<int>& frames)
+{
+    QMutexLocker k(&_imp->lock);
+
+    if (!_imp->active) {
+        return;
+    }
+    bool queued = false;
+    for (std::list<int>::const_iterator it = frames.begin(); it != frames.end(); ++it) {
+        if ( _imp->requestedFrames.insert(*it).second ) {
+            _imp->queuedFrames.push_back(*it);
+            queued = true;
+        }
+    }
+    if (!queued) {
+        return;
+    }
+
+    // Threads are only created once there is something to prefetch
+    while ( (int)_imp->threads.size() < NATRON_PLAYBACK_PREFETCH_N_THREADS ) {
+        PlaybackPrefetcherThread* thread = new PlaybackPrefetcherThread( _imp.get() );
+        _imp->threads.push_back(thread);
+        thread->start();
+    }
+    _imp->framesQueuedCond.wakeAll();
+}
+
+void
+PlaybackPrefetcher::cancel()
+{
+    QMutexLocker k(&_imp->lock);
+
+    _imp->cancelInternal();
+    _imp->readers.clear();
+    _imp->active = false;
+}
+
+NATRON_NAMESPACE_EXIT
@@ -0,0 +1,105 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ * Copyright (C) 2018-2020 The Natron developers
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_PLAYBACKPREFETCHER_H
+#define NATRON_ENGINE_PLAYBACKPREFETCHER_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <list>
+#include <vector>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/scoped_ptr.hpp>
+#endif
+
+#include "Engine/ViewIdx.h"
+#include "Engine/EngineFwd.h"
+
+// The number of frames past the frame being rendered that are decoded ahead of time during playback
+#define NATRON_PLAYBACK_PREFETCH_N_FRAMES 8
+
+// The number of threads decoding frames ahead of time for a scheduler
+#define NATRON_PLAYBACK_PREFETCH_N_THREADS 2
+
+NATRON_NAMESPACE_ENTER
+
+struct PlaybackPrefetcherPrivate;
+
+/**
+ * @brief Decodes the frames of the Read nodes of a tree into the node cache before the render threads of the
+ * scheduler need them, so that the file I/O is not on the critical path of the playback.
+ *
+ * Frames are decoded by a small set of dedicated threads, one frame at a time for all readers and views.
+ * The renders pick up the prefetched images from the cache as they would for any other cached image: the images
+ * are not rendered in draft mode so that they can be used by draft and non-draft renders, and an image rendered
+ * at a given mipmap level can be used by renders at this level or any lower resolution.
+ * No frame is prefetched while the node cache is almost full, to avoid evicting images the playback still needs.
+ **/
+class PlaybackPrefetcher
+{
+public:
+
+    PlaybackPrefetcher();
+
+    /**
+     * @brief Cancels all prefetches and joins the threads.
+     **/
+    ~PlaybackPrefetcher();
+
+    /**
+     * @brief Collects the Read nodes upstream of the given node (following the group redirections)
+     * that can be decoded in any order.
+     **/
+    static void getReadersUpstream(const NodePtr& node, NodesList* readers);
+
+    /**
+     * @brief Sets the readers to prefetch and how to render them, and forgets about the frames prefetched so far.
+     * Any prefetch in progress is cancelled.
+     **/
+    void start(const NodesList& readers,
+               const std::vector<ViewIdx>& views,
+               unsigned int mipMapLevel);
+
+    /**
+     * @brief Queues the given frames, in order of priority, for decoding. Frames already prefetched since the
+     * last call to start() are ignored.
+     **/
+    void prefetchFrames(const std::list<int>& frames);
+
+    /**
+     * @brief Drops the queued frames and aborts the prefetches in progress, without waiting for them.
+     * The prefetcher does nothing until the next call to start().
+     **/
+    void cancel();
+
+private:
+
+    boost::scoped_ptr<PlaybackPrefetcherPrivate> _imp;
+};
+
+NATRON_NAMESPACE_EXIT
+
+#endif // NATRON_ENGINE_PLAYBACKPREFETCHER_H
@@ -25,7 +25,9 @@
 
 #include "ProcessHandler.h"
 
+#include <algorithm> // std::max
 #include <cassert>
+#include <iostream>
 #include <stdexcept>
 
 #include <QtCore/QtGlobal> // for Q_OS_*
@@ -49,20 +51,12 @@
 
 NATRON_NAMESPACE_ENTER
 
-ProcessHandler::ProcessHandler(const QString & projectPath,
-                               OutputEffectInstance* writer)
-    : _process(new QProcess)
-    , _writer(writer)
-    , _ipcServer(0)
-    , _bgProcessOutputSocket(0)
-    , _bgProcessInputSocket(0)
-    , _earlyCancel(false)
-    , _processLog()
-    , _processArgs()
+/**
+ * @brief Returns a unique name to listen to with a QLocalServer
+ **/
+static QString
+makeLocalServerName()
 {
-    ///setup the server used to listen the output of the background process
-    _ipcServer = new QLocalServer();
-    QObject::connect( _ipcServer, SIGNAL(newConnection()), this, SLOT(onNewConnectionPending()) );
     QString tmpFileName;
 #if defined(Q_OS_WIN)
     tmpFileName += QString::fromUtf8("//./pipe");
@@ -92,6 +86,25 @@ ProcessHandler::ProcessHandler(const QString & projectPath,
         tmpf.remove();
 #endif
     }
+
+    return tmpFileName;
+}
+
+ProcessHandler::ProcessHandler(const QString & projectPath,
+                               OutputEffectInstance* writer)
+    : _process(new QProcess)
+    , _writer(writer)
+    , _ipcServer(0)
+    , _bgProcessOutputSocket(0)
+    , _bgProcessInputSocket(0)
+    , _earlyCancel(false)
+    , _processLog()
+    , _processArgs()
+{
+    ///setup the server used to listen the output of the background process
+    _ipcServer = new QLocalServer();
+    QObject::connect( _ipcServer, SIGNAL(newConnection()), this, SLOT(onNewConnectionPending()) );
+    QString tmpFileName = makeLocalServerName();
     _ipcServer->listen(tmpFileName);
 
 
@@ -382,35 +395,7 @@ ProcessInputChannel::initialize()
 
     _backgroundIPCServer = new QLocalServer();
     QObject::connect( _backgroundIPCServer, SIGNAL(newConnection()), this, SLOT(onNewConnectionPending()) );
-    QString tmpFileName;
-#if defined(Q_OS_WIN)
-    tmpFileName += QString::fromUtf8("//./pipe");
-    tmpFileName += QLatin1Char('/');
-    tmpFileName += QString::fromUtf8(NATRON_APPLICATION_NAME);
-    tmpFileName += QString::fromUtf8("_INPUT_SOCKET");
-#endif
-
-    {
-#if defined(Q_OS_UNIX)
-        QTemporaryFile tmpf(tmpFileName);
-        tmpf.open();
-        tmpFileName = tmpf.fileName();
-        tmpf.remove();
-#else
-        QTemporaryFile tmpf;
-        tmpf.open();
-        QString tmpFilePath = tmpf.fileName();
-        QString baseName;
-        int lastSlash = tmpFilePath.lastIndexOf( QLatin1Char('/') );
-        if ( (lastSlash != -1) && (lastSlash < tmpFilePath.size() - 1) ) {
-            baseName = tmpFilePath.mid(lastSlash + 1);
-        } else {
-            baseName = tmpFilePath;
-        }
-        tmpFileName += baseName;
-        tmpf.remove();
-#endif
-    }
+    QString tmpFileName = makeLocalServerName();
     _backgroundIPCServer->listen(tmpFileName);
 
     if ( !_backgroundOutputPipe->waitForConnected(5000) ) { //< blocking, we wait for the server to respond
@@ -438,6 +423,386 @@ ProcessInputChannel::onOutputPipeConnectionMade()
     qDebug() << "The output channel was successfully created and connected.";
 }
 
+// A chunk of a single frame failing this many times is given up: it most likely crashes the process every time
+#define NATRON_RENDER_FARM_MAX_FRAME_ATTEMPTS 2
+
+RenderFarmCoordinator::RenderFarmCoordinator(const QStringList& workerArgs,
+                                             int workersCount)
+    : QObject()
+    , _workerArgs(workerArgs)
+    , _workersCount( std::max(1, workersCount) )
+    , _restartsLeft( std::max(1, workersCount) )
+    , _server(0)
+    , _processes()
+    , _queue()
+    , _inFlight()
+    , _framesCount(0)
+    , _framesDone(0)
+    , _framesFailed(0)
+    , _loop(0)
+{
+}
+
+RenderFarmCoordinator::~RenderFarmCoordinator()
+{
+    // Workers exit by themselves once they are told there is no more work, give them some time to do so
+    for (std::list<QProcess*>::iterator it = _processes.begin(); it != _processes.end(); ++it) {
+        QObject::disconnect(*it, 0, this, 0);
+        if ( !(*it)->waitForFinished(30000) ) {
+            (*it)->kill();
+            (*it)->waitForFinished();
+        }
+        delete *it;
+    }
+    if (_server) {
+        // Sockets are children of the server, do not get notified when they are destroyed
+        QList<QLocalSocket*> sockets = _server->findChildren<QLocalSocket*>();
+        for (QList<QLocalSocket*>::iterator it = sockets.begin(); it != sockets.end(); ++it) {
+            QObject::disconnect(*it, 0, this, 0);
+        }
+        _server->close();
+        delete _server;
+    }
+}
+
+void
+RenderFarmCoordinator::addWork(const QString& writerName,
+                               int firstFrame,
+                               int lastFrame,
+                               int frameStep,
+                               bool canSplit)
+{
+    Chunk c;
+
+    c.writerName = writerName;
+    c.firstFrame = firstFrame;
+    c.frameStep = std::max(1, frameStep);
+    // Make the last frame an actual frame of the sequence
+    c.lastFrame = firstFrame + ( (lastFrame - firstFrame) / c.frameStep ) * c.frameStep;
+    c.canSplit = canSplit;
+    if (c.lastFrame < c.firstFrame) {
+        return;
+    }
+    _framesCount += c.getFramesCount();
+    _queue.push_back(c);
+}
+
+int
+RenderFarmCoordinator::exec()
+{
+    if ( _queue.empty() ) {
+        return 0;
+    }
+
+    _server = new QLocalServer();
+    QObject::connect( _server, SIGNAL(newConnection()), this, SLOT(onNewConnectionPending()) );
+    QString serverName = makeLocalServerName();
+    if ( !_server->listen(serverName) ) {
+        throw std::runtime_error( tr("Could not create the local server for the render workers: %1").arg( _server->errorString() ).toStdString() );
+    }
+    _workerArgs << QString::fromUtf8("--render-worker") << serverName;
+
+    std::cout << tr("Rendering %1 frames with %2 processes").arg(_framesCount).arg(_workersCount).toStdString() << std::endl;
+    for (int i = 0; i < _workersCount; ++i) {
+        startWorker();
+    }
+
+    QEventLoop loop;
+    _loop = &loop;
+    loop.exec();
+    _loop = 0;
+
+    return _framesFailed;
+}
+
+void
+RenderFarmCoordinator::startWorker()
+{
+    QProcess* process = new QProcess;
+
+    QObject::connect( process, SIGNAL(readyReadStandardOutput()), this, SLOT(onWorkerStandardOutputBytesWritten()) );
+    QObject::connect( process, SIGNAL(finished(int,QProcess::ExitStatus)), this, SLOT(onWorkerProcessFinished(int,QProcess::ExitStatus)) );
+    QObject::connect( process, SIGNAL(error(QProcess::ProcessError)), this, SLOT(onWorkerProcessError(QProcess::ProcessError)) );
+    // The output of the workers is forwarded by onWorkerStandardOutputBytesWritten so that lines do not get mixed
+    process->setProcessChannelMode(QProcess::MergedChannels);
+    _processes.push_back(process);
+    process->start(QCoreApplication::applicationFilePath(), _workerArgs);
+}
+
+void
+RenderFarmCoordinator::onWorkerStandardOutputBytesWritten()
+{
+    QProcess* process = qobject_cast<QProcess*>( sender() );
+
+    if (!process) {
+        return;
+    }
+    while ( process->canReadLine() ) {
+        std::cout << QString::fromUtf8( process->readLine() ).toStdString() << std::flush;
+    }
+}
+
+void
+RenderFarmCoordinator::onNewConnectionPending()
+{
+    while ( _server->hasPendingConnections() ) {
+        QLocalSocket* socket = _server->nextPendingConnection();
+        QObject::connect( socket, SIGNAL(readyRead()), this, SLOT(onWorkerMessageReceived()) );
+        QObject::connect( socket, SIGNAL(disconnected()), this, SLOT(onWorkerDisconnected()) );
+    }
+}
+
+bool
+RenderFarmCoordinator::takeNextChunk(Chunk* chunk)
+{
+    if ( _queue.empty() ) {
+        return false;
+    }
+
+    Chunk& front = _queue.front();
+    if (!front.canSplit) {
+        *chunk = front;
+        _queue.pop_front();
+
+        return true;
+    }
+
+    // Guided scheduling: hand out a fraction of what is left so that the last chunks are small
+    // and no worker is left alone rendering a big chunk at the end
+    int framesLeft = 0;
+    for (std::list<Chunk>::const_iterator it = _queue.begin(); it != _queue.end(); ++it) {
+        framesLeft += it->getFramesCount();
+    }
+    int chunkSize = std::max( 1, framesLeft / (2 * _workersCount) );
+    if ( chunkSize >= front.getFramesCount() ) {
+        *chunk = front;
+        _queue.pop_front();
+    } else {
+        *chunk = front;
+        chunk->lastFrame = front.firstFrame + (chunkSize - 1) * front.frameStep;
+        front.firstFrame = chunk->lastFrame + front.frameStep;
+    }
+
+    return true;
+}
+
+void
+RenderFarmCoordinator::onChunkFailed(const Chunk& chunk)
+{
+    int framesCount = chunk.getFramesCount();
+
+    if ( chunk.canSplit && (framesCount > 1) ) {
+        // Retry frame by frame so that a single bad frame does not fail its neighbours again
+        std::list<Chunk> frames;
+        for (int i = 0; i < framesCount; ++i) {
+            Chunk c = chunk;
+            c.firstFrame = c.lastFrame = chunk.firstFrame + i * chunk.frameStep;
+            c.failuresCount = 0;
+            frames.push_back(c);
+        }
+        _queue.splice(_queue.begin(), frames);
+    } else if (chunk.failuresCount + 1 < NATRON_RENDER_FARM_MAX_FRAME_ATTEMPTS) {
+        Chunk c = chunk;
+        ++c.failuresCount;
+        _queue.push_front(c);
+    } else {
+        _framesFailed += framesCount;
+        std::cout << tr("%1: Failed to render frames %2 to %3").arg(chunk.writerName).arg(chunk.firstFrame).arg(chunk.lastFrame).toStdString() << std::endl;
+    }
+}
+
+void
+RenderFarmCoordinator::onWorkerMessageReceived()
+{
+    QLocalSocket* socket = qobject_cast<QLocalSocket*>( sender() );
+
+    if (!socket) {
+        return;
+    }
+    while ( socket->canReadLine() ) {
+        QString str = QString::fromUtf8( socket->readLine() );
+        while ( str.endsWith( QLatin1Char('\n') ) ) {
+            str.chop(1);
+        }
+
+        if ( str.startsWith( QString::fromUtf8(kRenderWorkerChunkDoneShort) ) ) {
+            std::map<QLocalSocket*, Chunk>::iterator found = _inFlight.find(socket);
+            if ( found != _inFlight.end() ) {
+                _framesDone += found->second.getFramesCount();
+                _inFlight.erase(found);
+                std::cout << tr("%1 of %2 frames rendered").arg(_framesDone).arg(_framesCount).toStdString() << std::endl;
+            }
+        } else if ( str.startsWith( QString::fromUtf8(kRenderWorkerChunkFailedShort) ) ) {
+            std::map<QLocalSocket*, Chunk>::iterator found = _inFlight.find(socket);
+            if ( found != _inFlight.end() ) {
+                Chunk chunk = found->second;
+                _inFlight.erase(found);
+                onChunkFailed(chunk);
+            }
+        } else if ( str.startsWith( QString::fromUtf8(kRenderWorkerNextChunkShort) ) ) {
+            Chunk chunk;
+            QString reply;
+            if ( takeNextChunk(&chunk) ) {
+                _inFlight[socket] = chunk;
+                reply = QString::fromUtf8(kRenderWorkerChunkShort) + QString::fromUtf8("%1 %2 %3 %4").arg(chunk.firstFrame).arg(chunk.lastFrame).arg(chunk.frameStep).arg(chunk.writerName);
+            } else {
+                reply = QString::fromUtf8(kRenderWorkerNoMoreWorkShort);
+            }
+            socket->write( ( reply + QLatin1Char('\n') ).toUtf8() );
+            socket->flush();
+        } else {
+            std::cout << tr("Error: Unable to interpret message from render worker: %1").arg(str).toStdString() << std::endl;
+        }
+    }
+    checkProgress();
+} // RenderFarmCoordinator::onWorkerMessageReceived
+
+void
+RenderFarmCoordinator::onWorkerDisconnected()
+{
+    QLocalSocket* socket = qobject_cast<QLocalSocket*>( sender() );
+
+    if (!socket) {
+        return;
+    }
+    std::map<QLocalSocket*, Chunk>::iterator found = _inFlight.find(socket);
+    if ( found != _inFlight.end() ) {
+        // The worker died while rendering
+        Chunk chunk = found->second;
+        _inFlight.erase(found);
+        onChunkFailed(chunk);
+    }
+    socket->deleteLater();
+    checkProgress();
+}
+
+void
+RenderFarmCoordinator::onWorkerProcessFinished(int exitCode,
+                                               QProcess::ExitStatus stat)
+{
+    QProcess* process = qobject_cast<QProcess*>( sender() );
+
+    if (!process) {
+        return;
+    }
+    // Flush what is left of its output
+    std::cout << QString::fromUtf8( process->readAll() ).toStdString() << std::flush;
+    if ( (stat == QProcess::CrashExit) || (exitCode != 0) ) {
+        std::cout << tr("A render worker process exited unexpectedly").toStdString() << std::endl;
+    }
+    _processes.remove(process);
+    process->deleteLater();
+    checkProgress();
+}
+
+void
+RenderFarmCoordinator::onWorkerProcessError(QProcess::ProcessError err)
+{
+    QProcess* process = qobject_cast<QProcess*>( sender() );
+
+    // finished() is not emitted when the process could not start at all
+    if ( !process || (err != QProcess::FailedToStart) ) {
+        return;
+    }
+    std::cout << tr("A render worker process could not be started: %1").arg( process->errorString() ).toStdString() << std::endl;
+    _processes.remove(process);
+    process->deleteLater();
+    checkProgress();
+}
+
+void
+RenderFarmCoordinator::checkProgress()
+{
+    if ( _queue.empty() && _inFlight.empty() ) {
+        if (_loop) {
+            _loop->quit();
+        }
+
+        return;
+    }
+    if ( _queue.empty() ) {
+        return;
+    }
+
+    // Replace the workers that died while there is work left
+    while ( (int)_processes.size() < _workersCount && _restartsLeft > 0 ) {
+        --_restartsLeft;
+        startWorker();
+    }
+    if ( _processes.empty() ) {
+        // Nobody is left to render the remaining frames
+        for (std::list<Chunk>::const_iterator it = _queue.begin(); it != _queue.end(); ++it) {
+            _framesFailed += it->getFramesCount();
+        }
+        _queue.clear();
+        std::cout << tr("All render worker processes exited, %1 frames were not rendered").arg(_framesFailed).toStdString() << std::endl;
+        if ( _inFlight.empty() && _loop ) {
+            _loop->quit();
+        }
+    }
+}
+
+RenderFarmWorkerChannel::RenderFarmWorkerChannel(const QString & coordinatorServerName)
+    : _socket( new QLocalSocket() )
+{
+    _socket->connectToServer(coordinatorServerName, QLocalSocket::ReadWrite);
+    if ( !_socket->waitForConnected(30000) ) {
+        QString err = _socket->errorString();
+        delete _socket;
+        throw std::runtime_error( tr("Could not connect to the render coordinator: %1").arg(err).toStdString() );
+    }
+}
+
+RenderFarmWorkerChannel::~RenderFarmWorkerChannel()
+{
+    _socket->disconnectFromServer();
+    delete _socket;
+}
+
+void
+RenderFarmWorkerChannel::writeMessage(const QString& message)
+{
+    _socket->write( ( message + QLatin1Char('\n') ).toUtf8() );
+    _socket->flush();
+}
+
+bool
+RenderFarmWorkerChannel::requestNextChunk(QString* writerName,
+                                          int* firstFrame,
+                                          int* lastFrame,
+                                          int* frameStep)
+{
+    writeMessage( QString::fromUtf8(kRenderWorkerNextChunkShort) );
+
+    while ( !_socket->canReadLine() ) {
+        if ( !_socket->waitForReadyRead(-1) ) {
+            // The coordinator is gone
+            return false;
+        }
+    }
+    QString str = QString::fromUtf8( _socket->readLine() ).trimmed();
+    if ( !str.startsWith( QString::fromUtf8(kRenderWorkerChunkShort) ) ) {
+        return false;
+    }
+    str.remove( 0, QString::fromUtf8(kRenderWorkerChunkShort).size() );
+    QStringList fields = str.split( QLatin1Char(' ') );
+    if (fields.size() != 4) {
+        throw std::runtime_error("RenderFarmWorkerChannel::requestNextChunk() received erroneous message");
+    }
+    *firstFrame = fields[0].toInt();
+    *lastFrame = fields[1].toInt();
+    *frameStep = fields[2].toInt();
+    *writerName = fields[3];
+
+    return true;
+}
+
+void
+RenderFarmWorkerChannel::notifyChunkFinished(bool success)
+{
+    writeMessage( QString::fromUtf8(success ? kRenderWorkerChunkDoneShort : kRenderWorkerChunkFailedShort) );
+}
+
 NATRON_NAMESPACE_EXIT
 
 NATRON_NAMESPACE_USING
@@ -28,6 +28,9 @@
 
 #include "Global/Macros.h"
 
+#include <list>
+#include <map>
+
 CLANG_DIAG_OFF(deprecated)
 #include <QtCore/QProcess>
 #include <QtCore/QThread>
@@ -35,6 +38,8 @@ CLANG_DIAG_OFF(deprecated)
 #include <QtCore/QString>
 #include <QtCore/QMutex>
 #include <QtCore/QWaitCondition>
+#include <QtCore/QEventLoop>
+#include <QtCore/QCoreApplication>
 CLANG_DIAG_ON(deprecated)
 
 #include "Global/GlobalDefines.h"
@@ -257,6 +262,145 @@ private:
     bool _mustQuit;
 };
 
+/**
+ * @brief Splits a background render across several render processes (the --workers option).
+ * The frames to render are kept in a work queue. Each worker process is a copy of this process started with
+ * the --render-worker option: it loads the same project and then connects to the local server of the coordinator
+ * to pull chunks of frames, one after another, until there is no more work.
+ * The chunks get smaller as the queue drains so that all workers finish at about the same time.
+ * If a worker crashes, the chunk it was rendering goes back to the queue frame by frame, so that only
+ * the frames that make a process crash every time are lost, and a new worker is started instead.
+ *
+ * Messages exchanged on the socket follow the ProcessHandler convention: exactly 1 line per message.
+ * - worker: kRenderWorkerNextChunkShort
+ * - coordinator: kRenderWorkerChunkShort<first> <last> <step> <writer> or kRenderWorkerNoMoreWorkShort
+ * - worker: kRenderWorkerChunkDoneShort or kRenderWorkerChunkFailedShort once the chunk is rendered
+ **/
+class RenderFarmCoordinator
+    : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    /**
+     * @brief The worker processes are started with workerArgs, to which the server option is appended.
+     **/
+    RenderFarmCoordinator(const QStringList& workerArgs,
+                          int workersCount);
+
+    virtual ~RenderFarmCoordinator();
+
+    /**
+     * @brief Add frames to render with the given writer. If canSplit is false (e.g: video files),
+     * the range is given as a whole to a single worker.
+     **/
+    void addWork(const QString& writerName,
+                 int firstFrame,
+                 int lastFrame,
+                 int frameStep,
+                 bool canSplit);
+
+    /**
+     * @brief Starts the workers and processes events until all frames are rendered.
+     * @returns The number of frames that could not be rendered.
+     **/
+    int exec();
+
+public Q_SLOTS:
+
+    void onNewConnectionPending();
+
+    void onWorkerMessageReceived();
+
+    void onWorkerDisconnected();
+
+    void onWorkerProcessFinished(int exitCode, QProcess::ExitStatus stat);
+
+    void onWorkerProcessError(QProcess::ProcessError err);
+
+    void onWorkerStandardOutputBytesWritten();
+
+private:
+
+    struct Chunk
+    {
+        QString writerName;
+        int firstFrame;
+        int lastFrame;
+        int frameStep;
+        bool canSplit;
+        int failuresCount;
+
+        Chunk()
+            : writerName()
+            , firstFrame(0)
+            , lastFrame(0)
+            , frameStep(1)
+            , canSplit(true)
+            , failuresCount(0)
+        {
+        }
+
+        int getFramesCount() const
+        {
+            return (lastFrame - firstFrame) / frameStep + 1;
+        }
+    };
+
+    void startWorker();
+
+    bool takeNextChunk(Chunk* chunk);
+
+    void onChunkFailed(const Chunk& chunk);
+
+    void checkProgress();
+
+    QStringList _workerArgs;
+    int _workersCount;
+    int _restartsLeft; //< how many workers may still be started to replace crashed ones
+    QLocalServer* _server;
+    std::list<QProcess*> _processes; //< running worker processes
+    std::list<Chunk> _queue; //< frames not rendered yet
+    std::map<QLocalSocket*, Chunk> _inFlight; //< chunk currently rendered by each worker
+    int _framesCount, _framesDone, _framesFailed;
+    QEventLoop* _loop;
+};
+
+/**
+ * @brief The worker side of a RenderFarmCoordinator. All calls are blocking.
+ **/
+class RenderFarmWorkerChannel
+{
+    Q_DECLARE_TR_FUNCTIONS(RenderFarmWorkerChannel)
+
+public:
+
+    /**
+     * @brief Connects to the server of the coordinator, throws if it does not answer.
+     **/
+    RenderFarmWorkerChannel(const QString & coordinatorServerName);
+
+    ~RenderFarmWorkerChannel();
+
+    /**
+     * @brief Asks the coordinator for the next frames to render.
+     * @returns False if there is nothing left to render.
+     **/
+    bool requestNextChunk(QString* writerName, int* firstFrame, int* lastFrame, int* frameStep);
+
+    /**
+     * @brief Must be called once the frames returned by requestNextChunk() are rendered.
+     **/
+    void notifyChunkFinished(bool success);
+
+private:
+
+    void writeMessage(const QString& message);
+
+    QLocalSocket* _socket;
+};
+
 NATRON_NAMESPACE_EXIT
 
 #endif // PROCESSHANDLER_H
@@ -26,6 +26,7 @@
 #include "Project.h"
 
 #include <fstream>
+#include <sstream>
 #include <algorithm> // min, max
 #include <ios>
 #include <cstdlib> // strtoul
@@ -78,6 +79,8 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 #include "Engine/KnobFile.h"
 #include "Engine/Node.h"
 #include "Engine/OutputSchedulerThread.h"
+#include "Engine/ProjectAutoSaveJournal.h"
+#include "Engine/ProjectBinarySerialization.h"
 #include "Engine/ProjectPrivate.h"
 #include "Engine/ProjectSerialization.h"
 #include "Engine/RectDSerialization.h"
@@ -291,10 +294,14 @@ Project::loadProjectInternal(const QString & path,
     }
 
     bool ret = false;
+    // Binary projects are recognized by their header, whatever their extension (e.g: auto-saves)
+    const bool isBinary = ProjectBinarySerialization::isBinaryProjectFile( filePath.toStdString() );
     FStreamsSupport::ifstream ifile;
-    FStreamsSupport::open( &ifile, filePath.toStdString() );
-    if (!ifile) {
-        throw std::runtime_error( tr("Failed to open %1").arg(filePath).toStdString() );
+    if (!isBinary) {
+        FStreamsSupport::open( &ifile, filePath.toStdString() );
+        if (!ifile) {
+            throw std::runtime_error( tr("Failed to open %1").arg(filePath).toStdString() );
+        }
     }
 
     if ( (NATRON_VERSION_MAJOR == 1) && (NATRON_VERSION_MINOR == 0) && (NATRON_VERSION_REVISION == 0) ) {
@@ -322,18 +329,51 @@ Project::loadProjectInternal(const QString & path,
 
     try {
         bool bgProject;
-        boost::archive::xml_iarchive iArchive(ifile);
-        {
-            FlagSetter __raii_loadingProjectInternal__(true, &_imp->isLoadingProjectInternal, &_imp->isLoadingProjectMutex);
+        // The GUI layout recorded by the journal of an auto-save, if any
+        std::string journalGuiData;
+        if (isBinary) {
+            // All nodes are decoded up front: groups restore their nodes as soon as they are created
+            ProjectBinaryReaderPtr reader = boost::make_shared<ProjectBinaryReader>( filePath.toStdString() );
+            bgProject = reader->isBackgroundProject();
+            {
+                FlagSetter __raii_loadingProjectInternal__(true, &_imp->isLoadingProjectInternal, &_imp->isLoadingProjectMutex);
+
+                ProjectSerialization projectSerializationObj( getApp() );
+                reader->readProject(&projectSerializationObj);
+                if (isAutoSave) {
+                    ProjectAutoSaveJournal::replay(filePath.toStdString(), getApp(), &projectSerializationObj, &journalGuiData);
+                }
+                ret = load(projectSerializationObj, name, path, mustSave);
+            } // __raii_loadingProjectInternal__
 
-            iArchive >> boost::serialization::make_nvp("Background_project", bgProject);
-            ProjectSerialization projectSerializationObj( getApp() );
-            iArchive >> boost::serialization::make_nvp("Project", projectSerializationObj);
-            ret = load(projectSerializationObj, name, path, mustSave);
-        } // __raii_loadingProjectInternal__
+            if (!bgProject) {
+                std::istringstream guiStream( journalGuiData.empty() ? reader->readGuiData() : journalGuiData );
+                boost::archive::xml_iarchive guiArchive(guiStream);
+                getApp()->loadProjectGui(isAutoSave, guiArchive);
+            }
+        } else {
+            boost::archive::xml_iarchive iArchive(ifile);
+            {
+                FlagSetter __raii_loadingProjectInternal__(true, &_imp->isLoadingProjectInternal, &_imp->isLoadingProjectMutex);
+
+                iArchive >> boost::serialization::make_nvp("Background_project", bgProject);
+                ProjectSerialization projectSerializationObj( getApp() );
+                iArchive >> boost::serialization::make_nvp("Project", projectSerializationObj);
+                if (isAutoSave) {
+                    ProjectAutoSaveJournal::replay(filePath.toStdString(), getApp(), &projectSerializationObj, &journalGuiData);
+                }
+                ret = load(projectSerializationObj, name, path, mustSave);
+            } // __raii_loadingProjectInternal__
 
-        if (!bgProject) {
-            getApp()->loadProjectGui(isAutoSave, iArchive);
+            if (!bgProject) {
+                if ( journalGuiData.empty() ) {
+                    getApp()->loadProjectGui(isAutoSave, iArchive);
+                } else {
+                    std::istringstream guiStream(journalGuiData);
+                    boost::archive::xml_iarchive guiArchive(guiStream);
+                    getApp()->loadProjectGui(isAutoSave, guiArchive);
+                }
+            }
         }
     } catch (...) {
         const ProjectBeingLoadedInfo& pInfo = getApp()->getProjectBeingLoadedInfo();
@@ -443,6 +483,13 @@ Project::saveProject_imp(const QString & path,
             removeLastAutosave();
 
             //}
+        } else if ( updateProjectProperties && _imp->autoSaveJournal.append(this) ) {
+            ///Only the changes made since the last full auto-save were appended to its journal
+            ret = getLastAutoSaveFilePath();
+            _imp->lastAutoSave = QDateTime::currentDateTime();
+            QString projectPath = QString::fromUtf8( _imp->getProjectPath().c_str() );
+            QString projectFilename = QString::fromUtf8( _imp->getProjectFilename().c_str() );
+            Q_EMIT projectNameChanged(projectPath + projectFilename, true);
         } else {
             if (updateProjectProperties) {
                 ///Replace the last auto-save with a more recent one
@@ -547,9 +594,11 @@ Project::saveProjectInternal(const QString & path,
     StrUtils::ensureLastPathSeparator(tmpFilename);
     tmpFilename.append( QString::number( time.toMSecsSinceEpoch() ) );
 
+    // The format is chosen from the extension of the project, auto-saves of a binary project are binary too
+    const bool binary = name.endsWith( QString::fromUtf8("." NATRON_PROJECT_BINARY_FILE_EXT) );
     {
         FStreamsSupport::ofstream ofile;
-        FStreamsSupport::open( &ofile, tmpFilename.toStdString() );
+        FStreamsSupport::open( &ofile, tmpFilename.toStdString(), binary ? (std::ios_base::out | std::ios_base::binary) : std::ios_base::out );
         if (!ofile) {
             throw std::runtime_error( tr("Failed to open file ").toStdString() + tmpFilename.toStdString() );
         }
@@ -565,16 +614,34 @@ Project::saveProjectInternal(const QString & path,
         }
 
         try {
-            boost::archive::xml_oarchive oArchive(ofile);
             bool bgProject = getApp()->isBackground();
-            oArchive << boost::serialization::make_nvp("Background_project", bgProject);
+            if (autoSave && updateProjectProperties) {
+                _imp->autoSaveJournal.captureNodes(this);
+            }
             ProjectSerialization projectSerializationObj( getApp() );
             save(&projectSerializationObj);
-            oArchive << boost::serialization::make_nvp("Project", projectSerializationObj);
-            if (!bgProject) {
+            if (binary) {
+                std::string guiData;
                 AppInstancePtr app = getApp();
-                if (app) {
-                    app->saveProjectGui(oArchive);
+                if (!bgProject && app) {
+                    std::ostringstream guiStream;
+                    {
+                        // xml_oarchive must be destroyed before obtaining guiStream.str(), or the </boost_serialization> tag is missing
+                        boost::archive::xml_oarchive guiArchive(guiStream);
+                        app->saveProjectGui(guiArchive);
+                    }
+                    guiData = guiStream.str();
+                }
+                ProjectBinarySerialization::write(ofile, bgProject, &projectSerializationObj, guiData);
+            } else {
+                boost::archive::xml_oarchive oArchive(ofile);
+                oArchive << boost::serialization::make_nvp("Background_project", bgProject);
+                oArchive << boost::serialization::make_nvp("Project", projectSerializationObj);
+                if (!bgProject) {
+                    AppInstancePtr app = getApp();
+                    if (app) {
+                        app->saveProjectGui(oArchive);
+                    }
                 }
             }
         } catch (...) {
@@ -589,6 +656,10 @@ Project::saveProjectInternal(const QString & path,
     if ( QFile::exists(filePath) ) {
         QFile::remove(filePath);
     }
+    if (autoSave) {
+        ///A journal left by a previous auto-save at the same location does not apply to this one
+        QFile::remove( QString::fromUtf8( ProjectAutoSaveJournal::getJournalFilePath( filePath.toStdString() ).c_str() ) );
+    }
     int nAttemps = 0;
 
     while ( nAttemps < 10 && !fileCopy(tmpFilename, filePath) ) {
@@ -627,6 +698,10 @@ Project::saveProjectInternal(const QString & path,
     }
     if (updateProjectProperties) {
         _imp->lastAutoSave = time;
+        if (autoSave) {
+            ///The next auto-saves will only append the changes to the journal of this one
+            _imp->autoSaveJournal.reset( filePath.toStdString() );
+        }
     }
 
     return filePath;
@@ -720,12 +795,16 @@ Project::findAutoSaveForProject(const QString& projectPath,
     Q_FOREACH(const QString &entry, entries) {
         QString ntpExt( QLatin1Char('.') );
 
-        ntpExt.append( QString::fromUtf8(NATRON_PROJECT_FILE_EXT) );
+        if ( projectName.endsWith( QString::fromUtf8("." NATRON_PROJECT_BINARY_FILE_EXT) ) ) {
+            ntpExt.append( QString::fromUtf8(NATRON_PROJECT_BINARY_FILE_EXT) );
+        } else {
+            ntpExt.append( QString::fromUtf8(NATRON_PROJECT_FILE_EXT) );
+        }
         QString searchStr(ntpExt);
         QString autosaveSuffix( QString::fromUtf8(".autosave") );
         searchStr.append(autosaveSuffix);
         int suffixPos = entry.indexOf(searchStr);
-        if ( (suffixPos == -1) || entry.contains( QString::fromUtf8("RENDER_SAVE") ) ) {
+        if ( (suffixPos == -1) || entry.contains( QString::fromUtf8("RENDER_SAVE") ) || ProjectAutoSaveJournal::isJournalFilePath( entry.toStdString() ) ) {
             continue;
         }
         QString filename = projectPath + entry.left( suffixPos + ntpExt.size() );
@@ -1789,7 +1868,9 @@ Project::removeLastAutosave()
 
     if ( !filepath.isEmpty() ) {
         QFile::remove(filepath);
+        QFile::remove( QString::fromUtf8( ProjectAutoSaveJournal::getJournalFilePath( filepath.toStdString() ).c_str() ) );
     }
+    _imp->autoSaveJournal.clear();
 
     /*
      * Since we may have saved the project to an old project, overwriting the existing file, there might be
@@ -1801,6 +1882,7 @@ Project::removeLastAutosave()
     QString autoSaveFilePath = projectPath + projectFilename + QString::fromUtf8(".autosave");
     if ( QFile::exists(autoSaveFilePath) ) {
         QFile::remove(autoSaveFilePath);
+        QFile::remove( QString::fromUtf8( ProjectAutoSaveJournal::getJournalFilePath( autoSaveFilePath.toStdString() ).c_str() ) );
     }
 }
 
@@ -1821,8 +1903,10 @@ Project::clearAutoSavesDir()
         QString searchStr( QLatin1Char('.') );
         searchStr.append( QString::fromUtf8(NATRON_PROJECT_FILE_EXT) );
         searchStr.append( QLatin1Char('.') );
-        int suffixPos = entry.indexOf(searchStr);
-        if (suffixPos != -1) {
+        QString binarySearchStr( QLatin1Char('.') );
+        binarySearchStr.append( QString::fromUtf8(NATRON_PROJECT_BINARY_FILE_EXT) );
+        binarySearchStr.append( QLatin1Char('.') );
+        if ( entry.contains(searchStr) || entry.contains(binarySearchStr) ) {
             QString dirToRemove = savesDir.path();
             if ( !dirToRemove.endsWith( QLatin1Char('/') ) ) {
                 dirToRemove += QLatin1Char('/');
@@ -1957,6 +2041,7 @@ Project::doResetEnd(bool aboutToQuit)
             _imp->autoSaveTimer->stop();
             _imp->additionalFormats.clear();
         }
+        _imp->autoSaveJournal.clear();
         getApp()->removeAllKeyframesIndicators();
 
         Q_EMIT projectNameChanged(QString::fromUtf8(NATRON_PROJECT_UNTITLED), false);
@@ -0,0 +1,590 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ * Copyright (C) 2018-2020 The Natron developers
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "ProjectAutoSaveJournal.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <list>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include <QtCore/QDebug>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QMutex>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_OFF
+GCC_DIAG_OFF(unused-parameter)
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/archive/xml_oarchive.hpp>
+#include <boost/make_shared.hpp>
+GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
+GCC_DIAG_ON(unused-parameter)
+#endif
+
+#include "Global/FStreamsSupport.h"
+
+#include "Engine/AppInstance.h"
+#include "Engine/Hash64.h"
+#include "Engine/Node.h"
+#include "Engine/NodeGroup.h"
+#include "Engine/NodeGroupSerialization.h"
+#include "Engine/NodeSerialization.h"
+#include "Engine/Project.h"
+#include "Engine/ProjectSerialization.h"
+
+// The journal starts with this magic number (without the terminating null character) and the version of the format,
+// then come the records: a U32 type, a U64 size and the payload.
+#define NATRON_AUTOSAVE_JOURNAL_MAGIC "NatronJournal"
+#define NATRON_AUTOSAVE_JOURNAL_MAGIC_SIZE 13
+#define NATRON_AUTOSAVE_JOURNAL_VERSION 1
+
+// Appended to the file path of the auto-save
+#define NATRON_AUTOSAVE_JOURNAL_EXT ".journal"
+
+// The journal is compacted into a full auto-save once it gets larger than the full auto-save, or than this size
+#define NATRON_AUTOSAVE_JOURNAL_MIN_COMPACTION_SIZE (1024 * 1024)
+
+// Separates the script names of a node and of its parents in the record keys, script names may not contain it
+#define NATRON_AUTOSAVE_JOURNAL_KEY_SEPARATOR '.'
+
+NATRON_NAMESPACE_ENTER
+
+enum JournalRecordTypeEnum
+{
+    eJournalRecordTypeNode = 0, // the key of the node then its NodeSerialization, without its children
+    eJournalRecordTypeRemoveNode, // the key of the removed node
+    eJournalRecordTypeProject, // the ProjectSerialization, without its nodes
+    eJournalRecordTypeGui // the GUI layout, as written by AppInstance::saveProjectGui() in a XML archive
+};
+
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+struct JournaledNode
+{
+    NodeWPtr node;
+    U64 age;
+
+    JournaledNode()
+        : node()
+        , age(0)
+    {
+    }
+};
+
+// Keyed by the script names of the node and of its parents, joined by NATRON_AUTOSAVE_JOURNAL_KEY_SEPARATOR
+typedef std::map<std::string, JournaledNode> JournaledNodes;
+
+struct NodeToJournal
+{
+    NodePtr node;
+    std::string key;
+};
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+struct ProjectAutoSaveJournalPrivate
+{
+    QMutex lock; //< protects all members
+
+    // The last full auto-save, empty if the next auto-save must be a full one
+    std::string autoSaveFilePath;
+    U64 autoSaveSize;
+    U64 journalSize;
+
+    // The state of the nodes at the last auto-save
+    JournaledNodes nodes;
+    U64 guiHash;
+
+    // The state of the nodes captured before the full auto-save in progress
+    JournaledNodes capturedNodes;
+    U64 capturedGuiHash;
+
+    ProjectAutoSaveJournalPrivate()
+        : lock()
+        , autoSaveFilePath()
+        , autoSaveSize(0)
+        , journalSize(0)
+        , nodes()
+        , guiHash(0)
+        , capturedNodes()
+        , capturedGuiHash(0)
+    {
+    }
+};
+
+static void collectNode(const NodePtr& node, const std::string& key, std::vector<NodeToJournal>* nodes);
+
+// Same nodes as the ones saved by NodeSerialization and NodeCollectionSerialization
+static void
+collectChildren(const NodePtr& node,
+                const std::string& key,
+                std::vector<NodeToJournal>* nodes)
+{
+    NodesList children;
+    NodeGroup* isGrp = node->isEffectGroup();
+
+    if (isGrp) {
+        NodesList groupNodes;
+        isGrp->getActiveNodes(&groupNodes);
+        for (NodesList::iterator it = groupNodes.begin(); it != groupNodes.end(); ++it) {
+            if ( (*it)->isPartOfProject() ) {
+                children.push_back(*it);
+            }
+        }
+    } else {
+        NodesList multiInstanceChildren;
+        node->getChildrenMultiInstance(&multiInstanceChildren);
+        for (NodesList::iterator it = multiInstanceChildren.begin(); it != multiInstanceChildren.end(); ++it) {
+            if ( (*it)->isActivated() ) {
+                children.push_back(*it);
+            }
+        }
+    }
+
+    for (NodesList::iterator it = children.begin(); it != children.end(); ++it) {
+        collectNode(*it, key + NATRON_AUTOSAVE_JOURNAL_KEY_SEPARATOR + (*it)->getScriptName_mt_safe(), nodes);
+    }
+}
+
+static void
+collectNode(const NodePtr& node,
+            const std::string& key,
+            std::vector<NodeToJournal>* nodes)
+{
+    NodeToJournal n;
+
+    n.node = node;
+    n.key = key;
+    // A group comes before its nodes
+    nodes->push_back(n);
+    collectChildren(node, key, nodes);
+}
+
+static void
+collectNodes(const Project* project,
+             std::vector<NodeToJournal>* nodes)
+{
+    NodesList topLevelNodes;
+
+    project->getActiveNodes(&topLevelNodes);
+    for (NodesList::iterator it = topLevelNodes.begin(); it != topLevelNodes.end(); ++it) {
+        if ( !(*it)->getParentMultiInstance() && (*it)->isPartOfProject() ) {
+            collectNode(*it, (*it)->getScriptName_mt_safe(), nodes);
+        }
+    }
+}
+
+static void
+getNodesState(const std::vector<NodeToJournal>& nodes,
+              JournaledNodes* state)
+{
+    for (std::vector<NodeToJournal>::const_iterator it = nodes.begin(); it != nodes.end(); ++it) {
+        JournaledNode& n = (*state)[it->key];
+        n.node = it->node;
+        n.age = it->node->getSerializationAge();
+    }
+}
+
+// The part of the GUI layout that depends on the nodes: the GUI layout is recorded again when it changes
+static U64
+computeGuiHash(const std::vector<NodeToJournal>& nodes)
+{
+    Hash64 hash;
+
+    for (std::vector<NodeToJournal>::const_iterator it = nodes.begin(); it != nodes.end(); ++it) {
+        for (std::size_t i = 0; i < it->key.size(); ++i) {
+            hash.append<char>(it->key[i]);
+        }
+        double x, y, w, h, r, g, b;
+        it->node->getPosition(&x, &y);
+        it->node->getSize(&w, &h);
+        it->node->getColor(&r, &g, &b);
+        hash.append(x);
+        hash.append(y);
+        hash.append(w);
+        hash.append(h);
+        hash.append(r);
+        hash.append(g);
+        hash.append(b);
+    }
+    hash.computeHash();
+
+    return hash.value();
+}
+
+// The shapes of roto nodes and the tracks of tracker nodes are not edited through knobs
+static bool
+isNodeAlwaysJournaled(const NodePtr& node)
+{
+    return node->getRotoContext() || node->getTrackerContext();
+}
+
+static void
+writeRecord(std::ostream& stream,
+            JournalRecordTypeEnum type,
+            const std::string& payload)
+{
+    U32 recordType = (U32)type;
+    U64 size = payload.size();
+
+    stream.write( (const char*)&recordType, sizeof(recordType) );
+    stream.write( (const char*)&size, sizeof(size) );
+    stream.write( payload.data(), payload.size() );
+}
+
+static std::vector<std::string>
+splitKey(const std::string& key)
+{
+    std::vector<std::string> ret;
+    std::size_t start = 0;
+
+    for (;;) {
+        std::size_t found = key.find(NATRON_AUTOSAVE_JOURNAL_KEY_SEPARATOR, start);
+        if (found == std::string::npos) {
+            ret.push_back( key.substr(start) );
+            break;
+        }
+        ret.push_back( key.substr(start, found - start) );
+        start = found + 1;
+    }
+
+    return ret;
+}
+
+// Replaces, adds or removes (if node is NULL) the node at the given path
+static void
+applyNodeRecord(std::list<NodeSerializationPtr>* nodes,
+                const std::vector<std::string>& path,
+                std::size_t depth,
+                const NodeSerializationPtr& node)
+{
+    std::list<NodeSerializationPtr>::iterator found = nodes->end();
+
+    for (std::list<NodeSerializationPtr>::iterator it = nodes->begin(); it != nodes->end(); ++it) {
+        if ( (*it)->getNodeScriptName() == path[depth] ) {
+            found = it;
+            break;
+        }
+    }
+
+    if (depth + 1 < path.size()) {
+        // The group of the node was removed afterwards
+        if ( found == nodes->end() ) {
+            return;
+        }
+        std::list<NodeSerializationPtr> children;
+        (*found)->takeNodesCollection(&children);
+        applyNodeRecord(&children, path, depth + 1, node);
+        (*found)->setNodesCollection(children);
+
+        return;
+    }
+
+    if (!node) {
+        if ( found != nodes->end() ) {
+            nodes->erase(found);
+        }
+    } else if ( found != nodes->end() ) {
+        // The children have their own records: keep the ones of the previous serialization
+        std::list<NodeSerializationPtr> children;
+        (*found)->takeNodesCollection(&children);
+        node->setNodesCollection(children);
+        *found = node;
+    } else {
+        nodes->push_back(node);
+    }
+}
+
+ProjectAutoSaveJournal::ProjectAutoSaveJournal()
+    : _imp( new ProjectAutoSaveJournalPrivate() )
+{
+}
+
+ProjectAutoSaveJournal::~ProjectAutoSaveJournal()
+{
+}
+
+std::string
+ProjectAutoSaveJournal::getJournalFilePath(const std::string& autoSaveFilePath)
+{
+    return autoSaveFilePath + NATRON_AUTOSAVE_JOURNAL_EXT;
+}
+
+bool
+ProjectAutoSaveJournal::isJournalFilePath(const std::string& filePath)
+{
+    const std::size_t extSize = std::strlen(NATRON_AUTOSAVE_JOURNAL_EXT);
+
+    return (filePath.size() >= extSize) && (filePath.compare(filePath.size() - extSize, extSize, NATRON_AUTOSAVE_JOURNAL_EXT) == 0);
+}
+
+void
+ProjectAutoSaveJournal::captureNodes(const Project* project)
+{
+    assert(project);
+    std::vector<NodeToJournal> nodes;
+    collectNodes(project, &nodes);
+
+    JournaledNodes state;
+    getNodesState(nodes, &state);
+    U64 guiHash = computeGuiHash(nodes);
+
+    QMutexLocker k(&_imp->lock);
+    _imp->capturedNodes.swap(state);
+    _imp->capturedGuiHash = guiHash;
+}
+
+void
+ProjectAutoSaveJournal::reset(const std::string& autoSaveFilePath)
+{
+    QMutexLocker k(&_imp->lock);
+
+    _imp->autoSaveFilePath = autoSaveFilePath;
+    _imp->autoSaveSize = QFileInfo( QString::fromUtf8( autoSaveFilePath.c_str() ) ).size();
+    _imp->journalSize = 0;
+    _imp->nodes.swap(_imp->capturedNodes);
+    _imp->capturedNodes.clear();
+    _imp->guiHash = _imp->capturedGuiHash;
+    QFile::remove( QString::fromUtf8( getJournalFilePath(autoSaveFilePath).c_str() ) );
+}
+
+void
+ProjectAutoSaveJournal::clear()
+{
+    QMutexLocker k(&_imp->lock);
+
+    _imp->autoSaveFilePath.clear();
+    _imp->autoSaveSize = 0;
+    _imp->journalSize = 0;
+    _imp->nodes.clear();
+    _imp->capturedNodes.clear();
+}
+
+bool
+ProjectAutoSaveJournal::append(const Project* project)
+{
+    assert(project);
+    QMutexLocker k(&_imp->lock);
+
+    if ( _imp->autoSaveFilePath.empty() ) {
+        return false;
+    }
+    if ( _imp->journalSize > std::max( _imp->autoSaveSize, (U64)NATRON_AUTOSAVE_JOURNAL_MIN_COMPACTION_SIZE ) ) {
+        return false;
+    }
+    // The auto-save may have been removed in the meantime
+    if ( !QFile::exists( QString::fromUtf8( _imp->autoSaveFilePath.c_str() ) ) ) {
+        return false;
+    }
+
+    std::vector<NodeToJournal> nodes;
+    collectNodes(project, &nodes);
+
+    // The ages are read before the nodes are serialized: a change made in the meantime will be saved again by the next append
+    JournaledNodes state;
+    getNodesState(nodes, &state);
+    const U64 guiHash = computeGuiHash(nodes);
+
+    std::ostringstream records(std::ios_base::out | std::ios_base::binary);
+    if (_imp->journalSize == 0) {
+        U32 version = NATRON_AUTOSAVE_JOURNAL_VERSION;
+        records.write(NATRON_AUTOSAVE_JOURNAL_MAGIC, NATRON_AUTOSAVE_JOURNAL_MAGIC_SIZE);
+        records.write( (const char*)&version, sizeof(version) );
+    }
+
+    try {
+        for (JournaledNodes::const_iterator it = _imp->nodes.begin(); it != _imp->nodes.end(); ++it) {
+            if ( state.find(it->first) == state.end() ) {
+                std::ostringstream payload(std::ios_base::out | std::ios_base::binary);
+                {
+                    boost::archive::binary_oarchive oArchive(payload);
+                    oArchive << it->first;
+                }
+                writeRecord(records, eJournalRecordTypeRemoveNode, payload.str());
+            }
+        }
+
+        for (std::vector<NodeToJournal>::const_iterator it = nodes.begin(); it != nodes.end(); ++it) {
+            JournaledNodes::const_iterator found = _imp->nodes.find(it->key);
+            const JournaledNode& current = state[it->key];
+            if ( ( found != _imp->nodes.end() ) && (found->second.node.lock() == it->node) && (found->second.age == current.age) &&
+                 !isNodeAlwaysJournaled(it->node) ) {
+                continue;
+            }
+            NodeSerialization serialization(it->node, true, false);
+            std::ostringstream payload(std::ios_base::out | std::ios_base::binary);
+            {
+                boost::archive::binary_oarchive oArchive(payload);
+                oArchive << it->key;
+                oArchive << serialization;
+            }
+            writeRecord(records, eJournalRecordTypeNode, payload.str());
+        }
+
+        // The project settings are small, they are always recorded
+        AppInstancePtr app = project->getApp();
+        {
+            ProjectSerialization settings(app);
+            settings.initialize(project, false);
+            std::ostringstream payload(std::ios_base::out | std::ios_base::binary);
+            {
+                boost::archive::binary_oarchive oArchive(payload);
+                oArchive << settings;
+            }
+            writeRecord(records, eJournalRecordTypeProject, payload.str());
+        }
+
+        if ( (guiHash != _imp->guiHash) && app && !app->isBackground() ) {
+            std::ostringstream guiStream;
+            {
+                // xml_oarchive must be destroyed before obtaining guiStream.str(), or the </boost_serialization> tag is missing
+                boost::archive::xml_oarchive guiArchive(guiStream);
+                app->saveProjectGui(guiArchive);
+            }
+            writeRecord(records, eJournalRecordTypeGui, guiStream.str());
+        }
+    } catch (const std::exception& e) {
+        qDebug() << "Failed to append to the auto-save journal: " << e.what();
+
+        return false;
+    }
+
+    const std::string data = records.str();
+    {
+        FStreamsSupport::ofstream ofile;
+        FStreamsSupport::open( &ofile, getJournalFilePath(_imp->autoSaveFilePath), std::ios_base::out | std::ios_base::binary | std::ios_base::app );
+        if (!ofile) {
+            return false;
+        }
+        ofile.write( data.data(), data.size() );
+        ofile.flush();
+        if (!ofile) {
+            // The journal may end with a partial record: write a full auto-save, which removes it
+            return false;
+        }
+    }
+
+    _imp->journalSize += data.size();
+    _imp->nodes.swap(state);
+    _imp->guiHash = guiHash;
+
+    return true;
+} // ProjectAutoSaveJournal::append
+
+void
+ProjectAutoSaveJournal::replay(const std::string& autoSaveFilePath,
+                               const AppInstancePtr& app,
+                               ProjectSerialization* project,
+                               std::string* guiData)
+{
+    assert(project && guiData);
+    FStreamsSupport::ifstream ifile;
+    const std::string journalFilePath = getJournalFilePath(autoSaveFilePath);
+
+    FStreamsSupport::open(&ifile, journalFilePath, std::ios_base::in | std::ios_base::binary);
+    if (!ifile) {
+        // No change since the auto-save
+        return;
+    }
+    ifile.seekg(0, std::ios_base::end);
+    const U64 fileSize = ifile.tellg();
+    ifile.seekg(0);
+
+    char magic[NATRON_AUTOSAVE_JOURNAL_MAGIC_SIZE];
+    U32 version = 0;
+    ifile.read(magic, NATRON_AUTOSAVE_JOURNAL_MAGIC_SIZE);
+    ifile.read( (char*)&version, sizeof(version) );
+    if ( !ifile || (std::memcmp(magic, NATRON_AUTOSAVE_JOURNAL_MAGIC, NATRON_AUTOSAVE_JOURNAL_MAGIC_SIZE) != 0) ) {
+        throw std::runtime_error(journalFilePath + " is not an auto-save journal");
+    }
+    if (version > NATRON_AUTOSAVE_JOURNAL_VERSION) {
+        throw std::invalid_argument("The given auto-save was produced with a more recent and incompatible version of Natron.");
+    }
+
+    std::list<NodeSerializationPtr> nodes;
+    project->getNodesSerialization().takeNodesSerialization(&nodes);
+
+    for (;;) {
+        U32 type;
+        U64 size;
+        ifile.read( (char*)&type, sizeof(type) );
+        ifile.read( (char*)&size, sizeof(size) );
+        // The last record may be incomplete if Natron crashed while writing it
+        if ( !ifile || ( size > fileSize - (U64)ifile.tellg() ) ) {
+            break;
+        }
+        std::string payload;
+        payload.resize(size);
+        if ( size && !ifile.read(&payload[0], size) ) {
+            break;
+        }
+
+        if (type == eJournalRecordTypeGui) {
+            guiData->swap(payload);
+            continue;
+        }
+
+        std::istringstream ss(payload, std::ios_base::in | std::ios_base::binary);
+        boost::archive::binary_iarchive iArchive(ss);
+        switch ( (JournalRecordTypeEnum)type ) {
+        case eJournalRecordTypeNode: {
+            std::string key;
+            NodeSerializationPtr node = boost::make_shared<NodeSerialization>();
+            iArchive >> key;
+            iArchive >> *node;
+            applyNodeRecord(&nodes, splitKey(key), 0, node);
+            break;
+        }
+        case eJournalRecordTypeRemoveNode: {
+            std::string key;
+            iArchive >> key;
+            applyNodeRecord(&nodes, splitKey(key), 0, NodeSerializationPtr());
+            break;
+        }
+        case eJournalRecordTypeProject: {
+            ProjectSerialization settings(app);
+            iArchive >> settings;
+            *project = settings;
+            break;
+        }
+        default:
+            // Unknown record from a more recent version of the format, ignore it
+            break;
+        }
+    }
+
+    for (std::list<NodeSerializationPtr>::const_iterator it = nodes.begin(); it != nodes.end(); ++it) {
+        project->getNodesSerialization().addNodeSerialization(*it);
+    }
+} // ProjectAutoSaveJournal::replay
+
+NATRON_NAMESPACE_EXIT
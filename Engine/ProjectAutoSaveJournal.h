@@ -0,0 +1,111 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ * Copyright (C) 2018-2020 The Natron developers
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_PROJECTAUTOSAVEJOURNAL_H
+#define NATRON_ENGINE_PROJECTAUTOSAVEJOURNAL_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <string>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/scoped_ptr.hpp>
+#endif
+
+#include "Engine/EngineFwd.h"
+
+NATRON_NAMESPACE_ENTER
+
+struct ProjectAutoSaveJournalPrivate;
+
+/**
+ * @brief Makes auto-saves incremental: after a full auto-save, the following auto-saves only append the nodes
+ * that changed since the previous one to a journal next to the auto-save file, so that their cost depends on
+ * the size of the edit rather than on the size of the project.
+ *
+ * A node is saved again when its serialization age changed (@see Node::getSerializationAge()), the nodes of a
+ * group and the children of a multi-instance have their own records. Each append also records the project settings
+ * and, when the nodes were moved, resized or recolored, the GUI layout.
+ * Once the journal gets larger than the full auto-save, the next auto-save is a full one again, which compacts the journal.
+ *
+ * When an auto-save is loaded, replay() applies its journal to the project serialization before the project is restored.
+ **/
+class ProjectAutoSaveJournal
+{
+public:
+
+    ProjectAutoSaveJournal();
+
+    ~ProjectAutoSaveJournal();
+
+    static std::string getJournalFilePath(const std::string& autoSaveFilePath);
+
+    /**
+     * @brief Returns true if the file is the journal of an auto-save, so that it is not mistaken for an auto-save.
+     **/
+    static bool isJournalFilePath(const std::string& filePath);
+
+    /**
+     * @brief Records the state of the nodes of the project, to be called before a full auto-save is serialized.
+     **/
+    void captureNodes(const Project* project);
+
+    /**
+     * @brief Called once the full auto-save is written to autoSaveFilePath: the state captured by captureNodes()
+     * becomes the reference of the next append() and the journal of the auto-save is emptied.
+     **/
+    void reset(const std::string& autoSaveFilePath);
+
+    /**
+     * @brief Forgets the last full auto-save: the next auto-save will be a full one.
+     **/
+    void clear();
+
+    /**
+     * @brief Appends the changes made since the last auto-save to the journal of the last full auto-save.
+     * Returns false if a full auto-save must be written instead: if there was none yet, if the journal
+     * must be compacted or if it could not be written.
+     **/
+    bool append(const Project* project);
+
+    /**
+     * @brief Applies the journal of the given auto-save, if any, to project.
+     * guiData is set to the last GUI layout recorded by the journal, it is left empty if the journal has none:
+     * the GUI layout of the auto-save should then be used.
+     * This function may throw exceptions in case of failure.
+     **/
+    static void replay(const std::string& autoSaveFilePath,
+                       const AppInstancePtr& app,
+                       ProjectSerialization* project,
+                       std::string* guiData);
+
+private:
+
+    boost::scoped_ptr<ProjectAutoSaveJournalPrivate> _imp;
+};
+
+NATRON_NAMESPACE_EXIT
+
+#endif // NATRON_ENGINE_PROJECTAUTOSAVEJOURNAL_H
@@ -0,0 +1,410 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ * Copyright (C) 2018-2020 The Natron developers
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "ProjectBinarySerialization.h"
+
+#include <cassert>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_OFF
+GCC_DIAG_OFF(unused-parameter)
+#include <boost/archive/text_iarchive.hpp>
+#include <boost/archive/text_oarchive.hpp>
+#include <boost/make_shared.hpp>
+GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
+GCC_DIAG_ON(unused-parameter)
+#endif
+
+#include "Global/FStreamsSupport.h"
+
+#include "Engine/NodeGroupSerialization.h"
+#include "Engine/NodeSerialization.h"
+#include "Engine/ProjectSerialization.h"
+
+// The file starts with this magic number (without the terminating null character), the version of the format
+// and the offset of the index.
+#define NATRON_PROJECT_BINARY_MAGIC "NatronBinProject"
+#define NATRON_PROJECT_BINARY_MAGIC_SIZE 16
+// Version 1 used native boost binary archives, which depend on the endianness of the machine and on the version of boost
+#define NATRON_PROJECT_BINARY_VERSION_PORTABLE 2
+#define NATRON_PROJECT_BINARY_VERSION NATRON_PROJECT_BINARY_VERSION_PORTABLE
+#define NATRON_PROJECT_BINARY_HEADER_SIZE (NATRON_PROJECT_BINARY_MAGIC_SIZE + sizeof(U32) + sizeof(U64))
+
+NATRON_NAMESPACE_ENTER
+
+typedef ProjectBinaryReader::NodeEntry NodeEntry;
+
+/*
+ * The header and the index are made of fixed-size little-endian integers, whatever the machine.
+ */
+static void writeInt(std::ostream& stream, U64 value, int nBytes);
+static U64 readInt(std::istream& stream, int nBytes);
+static void writeString(std::ostream& stream, const std::string& str);
+static std::string readString(std::istream& stream);
+
+void
+writeInt(std::ostream& stream,
+         U64 value,
+         int nBytes)
+{
+    char bytes[8];
+
+    assert(nBytes <= 8);
+    for (int i = 0; i < nBytes; ++i) {
+        bytes[i] = (char)( (value >> (8 * i)) & 0xff );
+    }
+    stream.write(bytes, nBytes);
+}
+
+U64
+readInt(std::istream& stream,
+        int nBytes)
+{
+    unsigned char bytes[8];
+
+    assert(nBytes <= 8);
+    if ( !stream.read( (char*)bytes, nBytes ) ) {
+        throw std::runtime_error("Failed to read binary project");
+    }
+    U64 ret = 0;
+    for (int i = 0; i < nBytes; ++i) {
+        ret |= (U64)bytes[i] << (8 * i);
+    }
+
+    return ret;
+}
+
+void
+writeString(std::ostream& stream,
+            const std::string& str)
+{
+    writeInt(stream, str.size(), sizeof(U32));
+    stream.write( str.data(), str.size() );
+}
+
+std::string
+readString(std::istream& stream)
+{
+    U64 size = readInt(stream, sizeof(U32));
+    std::string ret(size, '\0');
+
+    if ( size && !stream.read(&ret[0], size) ) {
+        throw std::runtime_error("Failed to read binary project");
+    }
+
+    return ret;
+}
+
+/*
+ * Chunks are boost text archives: unlike binary archives they do not depend on the endianness of the machine
+ * nor on the version of boost, and they can be read back by newer versions just like the XML archives.
+ */
+template <typename T>
+static void
+writeChunk(std::ostream& stream,
+           const T& obj,
+           U64* offset,
+           U64* size)
+{
+    *offset = stream.tellp();
+    {
+        boost::archive::text_oarchive oArchive(stream);
+        oArchive << obj;
+    }
+    *size = (U64)stream.tellp() - *offset;
+}
+
+static void
+writeNodes(std::ostream& stream,
+           const std::list<NodeSerializationPtr>& nodes,
+           int parent,
+           std::vector<NodeEntry>* entries)
+{
+    for (std::list<NodeSerializationPtr>::const_iterator it = nodes.begin(); it != nodes.end(); ++it) {
+        // The children get their own chunks, after their group
+        std::list<NodeSerializationPtr> children;
+        (*it)->takeNodesCollection(&children);
+
+        NodeEntry entry;
+        entry.scriptName = (*it)->getNodeScriptName();
+        entry.pluginID = (*it)->getPluginID();
+        entry.parent = parent;
+        writeChunk(stream, **it, &entry.offset, &entry.size);
+        entries->push_back(entry);
+
+        writeNodes(stream, children, (int)entries->size() - 1, entries);
+    }
+}
+
+bool
+ProjectBinarySerialization::isBinaryProjectFile(const std::string& filePath)
+{
+    FStreamsSupport::ifstream ifile;
+
+    FStreamsSupport::open(&ifile, filePath, std::ios_base::in | std::ios_base::binary);
+    if (!ifile) {
+        return false;
+    }
+    char magic[NATRON_PROJECT_BINARY_MAGIC_SIZE];
+    ifile.read(magic, NATRON_PROJECT_BINARY_MAGIC_SIZE);
+
+    return ifile && std::memcmp(magic, NATRON_PROJECT_BINARY_MAGIC, NATRON_PROJECT_BINARY_MAGIC_SIZE) == 0;
+}
+
+void
+ProjectBinarySerialization::write(std::ostream& stream,
+                                  bool bgProject,
+                                  ProjectSerialization* project,
+                                  const std::string& guiData)
+{
+    assert(project);
+    const std::streampos start = stream.tellp();
+    stream.write(NATRON_PROJECT_BINARY_MAGIC, NATRON_PROJECT_BINARY_MAGIC_SIZE);
+    writeInt(stream, NATRON_PROJECT_BINARY_VERSION, sizeof(U32));
+    // The index offset is written once known
+    writeInt(stream, 0, sizeof(U64));
+
+    std::vector<NodeEntry> entries;
+    {
+        std::list<NodeSerializationPtr> nodes;
+        project->getNodesSerialization().takeNodesSerialization(&nodes);
+        writeNodes(stream, nodes, -1, &entries);
+    }
+
+    U64 projectOffset, projectSize;
+    writeChunk(stream, *project, &projectOffset, &projectSize);
+
+    U64 guiOffset = stream.tellp();
+    U64 guiSize = guiData.size();
+    stream.write( guiData.data(), guiData.size() );
+
+    U64 indexOffset = stream.tellp();
+    writeInt(stream, bgProject ? 1 : 0, 1);
+    writeInt(stream, projectOffset, sizeof(U64));
+    writeInt(stream, projectSize, sizeof(U64));
+    writeInt(stream, guiOffset, sizeof(U64));
+    writeInt(stream, guiSize, sizeof(U64));
+    writeInt(stream, entries.size(), sizeof(U32));
+    for (std::vector<NodeEntry>::const_iterator it = entries.begin(); it != entries.end(); ++it) {
+        writeString(stream, it->scriptName);
+        writeString(stream, it->pluginID);
+        // -1 for top-level nodes, stored as the parent index + 1
+        writeInt(stream, it->parent + 1, sizeof(U32));
+        writeInt(stream, it->offset, sizeof(U64));
+        writeInt(stream, it->size, sizeof(U64));
+    }
+
+    stream.seekp(start + (std::streamoff)(NATRON_PROJECT_BINARY_MAGIC_SIZE + sizeof(U32)));
+    writeInt(stream, indexOffset, sizeof(U64));
+    stream.seekp(0, std::ios_base::end);
+    if (!stream) {
+        throw std::runtime_error("Failed to write the binary project");
+    }
+} // ProjectBinarySerialization::write
+
+struct ProjectBinaryReaderPrivate
+{
+    FStreamsSupport::ifstream file;
+    U64 fileSize;
+    bool bgProject;
+    U64 projectOffset, projectSize;
+    U64 guiOffset, guiSize;
+    std::vector<NodeEntry> nodes;
+
+    // The children of each node, and the top-level nodes
+    std::vector<std::vector<int> > children;
+    std::vector<int> topLevelNodes;
+
+    ProjectBinaryReaderPrivate()
+        : file()
+        , fileSize(0)
+        , bgProject(false)
+        , projectOffset(0)
+        , projectSize(0)
+        , guiOffset(0)
+        , guiSize(0)
+        , nodes()
+        , children()
+        , topLevelNodes()
+    {
+    }
+
+    void readChunk(U64 offset,
+                   U64 size,
+                   std::string* buffer)
+    {
+        if ( (offset < NATRON_PROJECT_BINARY_HEADER_SIZE) || (offset > fileSize) || (size > fileSize - offset) ) {
+            throw std::runtime_error("Invalid chunk in binary project");
+        }
+        buffer->resize(size);
+        file.clear();
+        file.seekg(offset);
+        if ( size && !file.read(&(*buffer)[0], size) ) {
+            throw std::runtime_error("Failed to read binary project");
+        }
+    }
+
+    template <typename T>
+    void decodeChunk(U64 offset,
+                     U64 size,
+                     T* obj)
+    {
+        std::string buffer;
+
+        readChunk(offset, size, &buffer);
+        std::istringstream ss(buffer, std::ios_base::in | std::ios_base::binary);
+        boost::archive::text_iarchive iArchive(ss);
+        iArchive >> *obj;
+    }
+};
+
+ProjectBinaryReader::ProjectBinaryReader(const std::string& filePath)
+    : _imp( new ProjectBinaryReaderPrivate() )
+{
+    FStreamsSupport::open(&_imp->file, filePath, std::ios_base::in | std::ios_base::binary);
+    if (!_imp->file) {
+        throw std::runtime_error("Failed to open " + filePath);
+    }
+    _imp->file.seekg(0, std::ios_base::end);
+    _imp->fileSize = _imp->file.tellg();
+    _imp->file.seekg(0);
+
+    char magic[NATRON_PROJECT_BINARY_MAGIC_SIZE];
+    if ( !_imp->file.read(magic, NATRON_PROJECT_BINARY_MAGIC_SIZE) ||
+         (std::memcmp(magic, NATRON_PROJECT_BINARY_MAGIC, NATRON_PROJECT_BINARY_MAGIC_SIZE) != 0) ) {
+        throw std::runtime_error(filePath + " is not a binary project");
+    }
+    U64 version = readInt(_imp->file, sizeof(U32));
+    U64 indexOffset = readInt(_imp->file, sizeof(U64));
+    if (version > NATRON_PROJECT_BINARY_VERSION) {
+        throw std::invalid_argument("The given project was produced with a more recent and incompatible version of Natron.");
+    }
+    if (version < NATRON_PROJECT_BINARY_VERSION_PORTABLE) {
+        throw std::invalid_argument("The given project was produced with an older version of the binary project format "
+                                    "which depends on the machine that saved it. Re-save it from the machine that produced it.");
+    }
+
+    if (indexOffset > _imp->fileSize) {
+        throw std::runtime_error("Invalid index in binary project");
+    }
+
+    std::string buffer;
+    _imp->readChunk(indexOffset, _imp->fileSize - indexOffset, &buffer);
+    std::istringstream ss(buffer, std::ios_base::in | std::ios_base::binary);
+    _imp->bgProject = readInt(ss, 1) != 0;
+    _imp->projectOffset = readInt(ss, sizeof(U64));
+    _imp->projectSize = readInt(ss, sizeof(U64));
+    _imp->guiOffset = readInt(ss, sizeof(U64));
+    _imp->guiSize = readInt(ss, sizeof(U64));
+    U64 nodesCount = readInt(ss, sizeof(U32));
+    // Each entry takes at least 28 bytes: do not trust a corrupted count
+    if (nodesCount > buffer.size() / 28) {
+        throw std::runtime_error("Invalid index in binary project");
+    }
+    _imp->nodes.resize(nodesCount);
+    _imp->children.resize(nodesCount);
+    for (int i = 0; i < (int)nodesCount; ++i) {
+        NodeEntry& entry = _imp->nodes[i];
+        entry.scriptName = readString(ss);
+        entry.pluginID = readString(ss);
+        entry.parent = (int)readInt(ss, sizeof(U32)) - 1;
+        entry.offset = readInt(ss, sizeof(U64));
+        entry.size = readInt(ss, sizeof(U64));
+        // A group is always saved before its nodes
+        if ( (entry.parent < -1) || (entry.parent >= i) ) {
+            throw std::runtime_error("Invalid index in binary project");
+        }
+        if (entry.parent < 0) {
+            _imp->topLevelNodes.push_back(i);
+        } else {
+            _imp->children[entry.parent].push_back(i);
+        }
+    }
+} // ProjectBinaryReader::ProjectBinaryReader
+
+ProjectBinaryReader::~ProjectBinaryReader()
+{
+}
+
+bool
+ProjectBinaryReader::isBackgroundProject() const
+{
+    return _imp->bgProject;
+}
+
+const std::vector<NodeEntry>&
+ProjectBinaryReader::getNodeEntries() const
+{
+    return _imp->nodes;
+}
+
+void
+ProjectBinaryReader::readProject(ProjectSerialization* project)
+{
+    assert(project);
+    _imp->decodeChunk(_imp->projectOffset, _imp->projectSize, project);
+
+    for (std::vector<int>::const_iterator it = _imp->topLevelNodes.begin(); it != _imp->topLevelNodes.end(); ++it) {
+        project->getNodesSerialization().addNodeSerialization( readNode(*it) );
+    }
+}
+
+NodeSerializationPtr
+ProjectBinaryReader::readNode(int index)
+{
+    if ( (index < 0) || ( index >= (int)_imp->nodes.size() ) ) {
+        throw std::runtime_error("Invalid node in binary project");
+    }
+    const NodeEntry& entry = _imp->nodes[index];
+    NodeSerializationPtr ret = boost::make_shared<NodeSerialization>();
+    _imp->decodeChunk(entry.offset, entry.size, ret.get());
+
+    // Groups restore their nodes as soon as they are created, decode them now
+    const std::vector<int>& childrenIndices = _imp->children[index];
+    if ( !childrenIndices.empty() ) {
+        std::list<NodeSerializationPtr> children;
+        for (std::vector<int>::const_iterator it = childrenIndices.begin(); it != childrenIndices.end(); ++it) {
+            children.push_back( readNode(*it) );
+        }
+        ret->setNodesCollection(children);
+    }
+
+    return ret;
+}
+
+std::string
+ProjectBinaryReader::readGuiData()
+{
+    std::string ret;
+
+    _imp->readChunk(_imp->guiOffset, _imp->guiSize, &ret);
+
+    return ret;
+}
+
+NATRON_NAMESPACE_EXIT
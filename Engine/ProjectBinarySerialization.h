@@ -0,0 +1,152 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ * Copyright (C) 2018-2020 The Natron developers
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_PROJECTBINARYSERIALIZATION_H
+#define NATRON_ENGINE_PROJECTBINARYSERIALIZATION_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <iosfwd>
+#include <list>
+#include <string>
+#include <vector>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/scoped_ptr.hpp>
+#endif
+
+#include "Global/GlobalDefines.h"
+#include "Engine/EngineFwd.h"
+
+NATRON_NAMESPACE_ENTER
+
+/**
+ * @brief The binary project format (.ntpb), an alternative to the XML format (.ntp) for large projects.
+ *
+ * The file is made of a header, then of chunks, then of an index of the chunks:
+ * - one chunk for the project settings (the ProjectSerialization without its nodes),
+ * - one chunk per node, holding the NodeSerialization of the node without its children: the nodes of a group
+ * have their own chunks,
+ * - one chunk for the GUI layout, which is kept as the XML archive written by AppInstance::saveProjectGui().
+ *
+ * The index holds the script name, plug-in ID and parent of each node along with the location of its chunk,
+ * so that the structure of the graph is known without decoding any node.
+ * The header and the index are little-endian whatever the machine, and the chunks are boost text archives:
+ * the file can be moved between machines and read by newer versions of Natron just like a .ntp file, while
+ * being much faster to decode than the XML archives since it has no tags to parse.
+ *
+ * Loading a .ntp project and saving it with the .ntpb extension converts it, and the other way around.
+ **/
+class ProjectBinarySerialization
+{
+public:
+
+    /**
+     * @brief Returns true if the file starts with the header of a binary project.
+     **/
+    static bool isBinaryProjectFile(const std::string& filePath);
+
+    /**
+     * @brief Writes the project to the stream, which must be opened in binary mode.
+     * The nodes of the serialization are moved to their own chunks, hence it is left without nodes.
+     * guiData is the GUI layout, empty for background projects.
+     * This function may throw exceptions in case of failure.
+     **/
+    static void write(std::ostream& stream,
+                      bool bgProject,
+                      ProjectSerialization* project,
+                      const std::string& guiData);
+};
+
+struct ProjectBinaryReaderPrivate;
+
+/**
+ * @brief Reads a binary project, see ProjectBinarySerialization.
+ * Opening the file only reads its index. The project settings and all nodes are decoded by readProject(),
+ * a single node and the nodes of its group can be decoded with readNode().
+ **/
+class ProjectBinaryReader
+{
+public:
+
+    struct NodeEntry
+    {
+        std::string scriptName;
+        std::string pluginID;
+        int parent; //< index of the group of the node in the entries, or -1 for top-level nodes
+        U64 offset;
+        U64 size;
+
+        NodeEntry()
+            : scriptName()
+            , pluginID()
+            , parent(-1)
+            , offset(0)
+            , size(0)
+        {
+        }
+    };
+
+    /**
+     * @brief Opens the file and reads its index.
+     * This function may throw exceptions in case of failure.
+     **/
+    explicit ProjectBinaryReader(const std::string& filePath);
+
+    ~ProjectBinaryReader();
+
+    bool isBackgroundProject() const;
+
+    /**
+     * @brief The nodes of the project, in the order they were saved: a group always comes before its nodes.
+     **/
+    const std::vector<NodeEntry>& getNodeEntries() const;
+
+    /**
+     * @brief Decodes the project settings and all nodes into project.
+     * This function may throw exceptions in case of failure.
+     **/
+    void readProject(ProjectSerialization* project);
+
+    /**
+     * @brief Decodes the node at the given index in getNodeEntries(), along with its children.
+     * This function may throw exceptions in case of failure.
+     **/
+    NodeSerializationPtr readNode(int index);
+
+    /**
+     * @brief Returns the GUI layout, empty for background projects.
+     * This function may throw exceptions in case of failure.
+     **/
+    std::string readGuiData();
+
+private:
+
+    boost::scoped_ptr<ProjectBinaryReaderPrivate> _imp;
+};
+
+NATRON_NAMESPACE_EXIT
+
+#endif // NATRON_ENGINE_PROJECTBINARYSERIALIZATION_H
@@ -90,6 +90,7 @@ ProjectPrivate::ProjectPrivate(Project* project)
     , isSavingProjectMutex()
     , isSavingProject(false)
     , autoSaveTimer( new QTimer() )
+    , autoSaveJournal()
     , projectClosing(false)
     , tlsData( new TLSHolder<Project::ProjectTLSData>() )
 
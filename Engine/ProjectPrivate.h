@@ -49,6 +49,7 @@ CLANG_DIAG_ON(uninitialized)
 #include "Engine/TLSHolder.h"
 #include "Engine/EngineFwd.h"
 #include "Engine/Project.h"
+#include "Engine/ProjectAutoSaveJournal.h"
 #include "Engine/GenericSchedulerThreadWatcher.h"
 
 
@@ -106,6 +107,7 @@ public:
     bool isSavingProject; //< true when the project is saving
     boost::shared_ptr<QTimer> autoSaveTimer;
     std::list<boost::shared_ptr<QFutureWatcher<void> > > autoSaveFutures;
+    ProjectAutoSaveJournal autoSaveJournal; //< the changes made since the last full auto-save
     mutable QMutex projectClosingMutex;
     bool projectClosing;
     boost::shared_ptr<TLSHolder<Project::ProjectTLSData> > tlsData;
@@ -36,11 +36,14 @@
 NATRON_NAMESPACE_ENTER
 
 void
-ProjectSerialization::initialize(const Project* project)
+ProjectSerialization::initialize(const Project* project,
+                                 bool serializeNodes)
 {
     ///All the code in this function is MT-safe
 
-    _nodes.initialize(*project);
+    if (serializeNodes) {
+        _nodes.initialize(*project);
+    }
 
     project->getAdditionalFormats(&_additionalFormats);
 
@@ -128,7 +128,9 @@ public:
         return _projectLoadedInfo;
     }
 
-    void initialize(const Project* project);
+    ///If serializeNodes is false, only the settings of the project are serialized.
+    void initialize(const Project* project,
+                    bool serializeNodes = true);
 
     SequenceTime getCurrentTime() const
     {
@@ -150,6 +152,11 @@ public:
         return _nodes;
     }
 
+    NodeCollectionSerialization & getNodesSerialization()
+    {
+        return _nodes;
+    }
+
     qint64 getCreationDate() const
     {
         return _creationDate;
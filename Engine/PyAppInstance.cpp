@@ -32,6 +32,7 @@
 #include <QtCore/QDebug>
 
 #include "Engine/AppInstance.h"
+#include "Engine/AppManager.h"
 #include "Engine/CreateNodeArgs.h"
 #include "Engine/Project.h"
 #include "Engine/Node.h"
@@ -166,7 +167,11 @@ App::createNode(const QString& pluginID,
     CreateNodeArgs args;
     makeCreateNodeArgs(getInternalApp(), pluginID, majorVersion, collection, props, &args);
 
-    NodePtr node = getInternalApp()->createNode(args);
+    NodePtr node;
+    {
+        PythonGILUnlocker pgu;
+        node = getInternalApp()->createNode(args);
+    }
     if (node) {
         return new Effect(node);
     } else {
@@ -186,7 +191,11 @@ App::createReader(const QString& filename,
     CreateNodeArgs args;
     makeCreateNodeArgs(getInternalApp(),  QString::fromUtf8(PLUGINID_NATRON_READ), -1, collection, props, &args);
 
-    NodePtr node = getInternalApp()->createReader(filename.toStdString(), args);
+    NodePtr node;
+    {
+        PythonGILUnlocker pgu;
+        node = getInternalApp()->createReader(filename.toStdString(), args);
+    }
     if (node) {
         return new Effect(node);
     } else {
@@ -204,7 +213,11 @@ App::createWriter(const QString& filename,
     assert(collection);
     CreateNodeArgs args;
     makeCreateNodeArgs(getInternalApp(), QString::fromUtf8(PLUGINID_NATRON_WRITE), -1, collection, props, &args);
-    NodePtr node = getInternalApp()->createWriter(filename.toStdString(), args);
+    NodePtr node;
+    {
+        PythonGILUnlocker pgu;
+        node = getInternalApp()->createWriter(filename.toStdString(), args);
+    }
     if (node) {
         return new Effect(node);
     } else {
@@ -334,6 +347,8 @@ App::renderInternal(bool forceBlocking,
 
     std::list<AppInstance::RenderWork> l;
     l.push_back(w);
+    // Let other Python threads run while rendering, this may block until the render is finished
+    PythonGILUnlocker pgu;
     getInternalApp()->startWritersRendering(forceBlocking, l);
 }
 
@@ -378,6 +393,8 @@ App::renderInternal(bool forceBlocking,
 
         l.push_back(w);
     }
+    // Let other Python threads run while rendering, this may block until the render is finished
+    PythonGILUnlocker pgu;
     getInternalApp()->startWritersRendering(forceBlocking, l);
 }
 
@@ -410,25 +427,35 @@ App::addFormat(const QString& formatSpec)
 bool
 App::saveTempProject(const QString& filename)
 {
+    PythonGILUnlocker pgu;
+
     return getInternalApp()->saveTemp( filename.toStdString() );
 }
 
 bool
 App::saveProject(const QString& filename)
 {
+    PythonGILUnlocker pgu;
+
     return getInternalApp()->save( filename.toStdString() );
 }
 
 bool
 App::saveProjectAs(const QString& filename)
 {
+    PythonGILUnlocker pgu;
+
     return getInternalApp()->saveAs( filename.toStdString() );
 }
 
 App*
 App::loadProject(const QString& filename)
 {
-    AppInstancePtr app  = getInternalApp()->loadProject( filename.toStdString() );
+    AppInstancePtr app;
+    {
+        PythonGILUnlocker pgu;
+        app = getInternalApp()->loadProject( filename.toStdString() );
+    }
 
     if (!app) {
         return 0;
@@ -441,6 +468,8 @@ App::loadProject(const QString& filename)
 bool
 App::resetProject()
 {
+    PythonGILUnlocker pgu;
+
     return getInternalApp()->resetProject();
 }
 
@@ -448,6 +477,8 @@ App::resetProject()
 bool
 App::closeProject()
 {
+    PythonGILUnlocker pgu;
+
     return getInternalApp()->closeProject();
 }
 
@@ -455,7 +486,11 @@ App::closeProject()
 App*
 App::newProject()
 {
-    AppInstancePtr app  = getInternalApp()->newProject();
+    AppInstancePtr app;
+    {
+        PythonGILUnlocker pgu;
+        app = getInternalApp()->newProject();
+    }
 
     if (!app) {
         return 0;
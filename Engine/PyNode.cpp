@@ -32,6 +32,7 @@
 #include "Engine/KnobTypes.h"
 #include "Engine/KnobFile.h"
 #include "Engine/AppInstance.h"
+#include "Engine/AppManager.h"
 #include "Engine/EffectInstance.h"
 #include "Engine/NodeGroup.h"
 #include "Engine/PyRoto.h"
@@ -969,7 +970,12 @@ Effect::getRegionOfDefinition(double time,
     U64 hash = getInternalNode()->getHashValue();
     RenderScale s(1.);
     bool isProject;
-    StatusEnum stat = getInternalNode()->getEffectInstance()->getRegionOfDefinition_public(hash, time, s, ViewIdx(view), &rod, &isProject);
+    StatusEnum stat;
+    {
+        // This may call the getRegionOfDefinition action of the node and of its inputs
+        PythonGILUnlocker pgu;
+        stat = getInternalNode()->getEffectInstance()->getRegionOfDefinition_public(hash, time, s, ViewIdx(view), &rod, &isProject);
+    }
     if (stat != eStatusOK) {
         return RectD();
     }
@@ -1022,7 +1028,10 @@ Effect::getAvailableLayers(int inputNb) const
     double time(getInternalNode()->getApp()->getTimeLine()->currentFrame());
 
     std::list<ImagePlaneDesc> availComps;
-    getInternalNode()->getEffectInstance()->getAvailableLayers(time, ViewIdx(0), inputNb, &availComps);
+    {
+        PythonGILUnlocker pgu;
+        getInternalNode()->getEffectInstance()->getAvailableLayers(time, ViewIdx(0), inputNb, &availComps);
+    }
     for (std::list<ImagePlaneDesc>::iterator it = availComps.begin(); it != availComps.end(); ++it) {
         ret.push_back(ImageLayer(*it));
     }
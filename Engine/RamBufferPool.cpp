@@ -0,0 +1,332 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ * Copyright (C) 2018-2020 The Natron developers
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "RamBufferPool.h"
+
+#include <cassert>
+#include <cstdlib> // malloc, free
+#include <list>
+#include <map>
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QMutex>
+#include <QtCore/QThreadStorage>
+
+NATRON_NAMESPACE_ENTER
+
+typedef std::map<std::size_t, std::list<void*> > FreeListsMap;
+
+struct RamBufferPoolThreadData;
+
+static void freeAll(FreeListsMap& lists);
+
+/**
+ * @brief The pool accounts memory in KiB so that the total fits in a QAtomicInt.
+ **/
+static int
+toKiB(std::size_t nBytes)
+{
+    return (int)( (nBytes + 1023) / 1024 );
+}
+
+struct RamBufferPoolGlobalData
+{
+    // The memory held by all free lists, the global one and those of the threads, in KiB.
+    // A buffer is charged before it is put in a free list and uncharged once it is taken out of it.
+    QAtomicInt pooledKiB;
+
+    // Counters reported by getStats(), only ever incremented
+    QAtomicInt nHits, nMisses, nRecycled, nDropped;
+
+    // Protects the fields below
+    QMutex lock;
+
+    // The global spill list
+    FreeListsMap freeLists;
+
+    // The free lists of all threads, so that clear() can empty them
+    std::list<RamBufferPoolThreadData*> threads;
+
+    RamBufferPoolGlobalData()
+        : pooledKiB()
+        , nHits()
+        , nMisses()
+        , nRecycled()
+        , nDropped()
+        , lock()
+        , freeLists()
+        , threads()
+    {
+    }
+
+    ~RamBufferPoolGlobalData()
+    {
+        freeAll(freeLists);
+    }
+
+    /**
+     * @brief Accounts for nBytes more in the pool. Returns false if the pool is full.
+     **/
+    bool charge(std::size_t nBytes)
+    {
+        const int kib = toKiB(nBytes);
+
+        if ( pooledKiB.fetchAndAddRelaxed(kib) + kib <= toKiB(NATRON_RAM_BUFFER_POOL_MAX_BYTES) ) {
+            return true;
+        }
+        pooledKiB.fetchAndAddRelaxed(-kib);
+
+        return false;
+    }
+
+    void uncharge(std::size_t nBytes)
+    {
+        pooledKiB.fetchAndAddRelaxed( -toKiB(nBytes) );
+    }
+
+    /**
+     * @brief Takes a buffer of exactly nBytes from the spill list, or returns NULL.
+     **/
+    void* take(std::size_t nBytes)
+    {
+        void* ret;
+        {
+            QMutexLocker k(&lock);
+            FreeListsMap::iterator found = freeLists.find(nBytes);
+
+            if ( ( found == freeLists.end() ) || found->second.empty() ) {
+                return 0;
+            }
+            ret = found->second.front();
+            found->second.pop_front();
+            if ( found->second.empty() ) {
+                freeLists.erase(found);
+            }
+        }
+        uncharge(nBytes);
+
+        return ret;
+    }
+
+    /**
+     * @brief Puts back a buffer, already charged, in the spill list.
+     **/
+    void put(void* data,
+             std::size_t nBytes)
+    {
+        QMutexLocker k(&lock);
+
+        freeLists[nBytes].push_back(data);
+    }
+};
+
+static RamBufferPoolGlobalData g_pool;
+
+void
+freeAll(FreeListsMap& lists)
+{
+    for (FreeListsMap::iterator it = lists.begin(); it != lists.end(); ++it) {
+        for (std::list<void*>::iterator it2 = it->second.begin(); it2 != it->second.end(); ++it2) {
+            std::free(*it2);
+            g_pool.uncharge(it->first);
+        }
+    }
+    lists.clear();
+}
+
+/**
+ * @brief The free lists owned by a thread. When the thread exits, its buffers are
+ * given back to the global spill list so that other threads can use them.
+ **/
+struct RamBufferPoolThreadData
+{
+    // Protects the fields below. It is only contended when another thread clears the pool.
+    QMutex lock;
+
+    FreeListsMap freeLists;
+
+    // Total number of bytes in freeLists
+    std::size_t bytes;
+
+    RamBufferPoolThreadData()
+        : lock()
+        , freeLists()
+        , bytes(0)
+    {
+        QMutexLocker k(&g_pool.lock);
+
+        g_pool.threads.push_back(this);
+    }
+
+    ~RamBufferPoolThreadData()
+    {
+        {
+            QMutexLocker k(&g_pool.lock);
+            g_pool.threads.remove(this);
+        }
+
+        // No other thread can access freeLists anymore
+        for (FreeListsMap::iterator it = freeLists.begin(); it != freeLists.end(); ++it) {
+            for (std::list<void*>::iterator it2 = it->second.begin(); it2 != it->second.end(); ++it2) {
+                g_pool.put(*it2, it->first);
+            }
+        }
+    }
+};
+
+// QThreadStorage takes ownership of the pointer and deletes it when the thread exits
+static QThreadStorage<RamBufferPoolThreadData*> g_threadPool;
+
+static RamBufferPoolThreadData*
+getThreadData()
+{
+    if ( !g_threadPool.hasLocalData() ) {
+        g_threadPool.setLocalData( new RamBufferPoolThreadData() );
+    }
+
+    return g_threadPool.localData();
+}
+
+void*
+RamBufferPool::allocate(std::size_t nBytes)
+{
+    if (nBytes < NATRON_RAM_BUFFER_POOL_MIN_BYTES) {
+        return std::malloc(nBytes);
+    }
+
+    // First look-up the calling thread free list
+    RamBufferPoolThreadData* tls = getThreadData();
+    void* ret = 0;
+    {
+        QMutexLocker k(&tls->lock);
+        FreeListsMap::iterator found = tls->freeLists.find(nBytes);
+        if ( ( found != tls->freeLists.end() ) && !found->second.empty() ) {
+            ret = found->second.back();
+            found->second.pop_back();
+            if ( found->second.empty() ) {
+                tls->freeLists.erase(found);
+            }
+            tls->bytes -= nBytes;
+        }
+    }
+    if (ret) {
+        g_pool.uncharge(nBytes);
+        g_pool.nHits.fetchAndAddRelaxed(1);
+
+        return ret;
+    }
+
+    // Then the global spill list
+    ret = g_pool.take(nBytes);
+    if (ret) {
+        g_pool.nHits.fetchAndAddRelaxed(1);
+
+        return ret;
+    }
+
+    g_pool.nMisses.fetchAndAddRelaxed(1);
+
+    return std::malloc(nBytes);
+}
+
+void
+RamBufferPool::release(void* data,
+                       std::size_t nBytes)
+{
+    if (!data) {
+        return;
+    }
+    if (nBytes < NATRON_RAM_BUFFER_POOL_MIN_BYTES) {
+        // Too small to be recycled
+        std::free(data);
+
+        return;
+    }
+    if ( !g_pool.charge(nBytes) ) {
+        // The pool is full
+        g_pool.nDropped.fetchAndAddRelaxed(1);
+        std::free(data);
+
+        return;
+    }
+    g_pool.nRecycled.fetchAndAddRelaxed(1);
+
+    RamBufferPoolThreadData* tls = getThreadData();
+    {
+        QMutexLocker k(&tls->lock);
+        if (tls->bytes + nBytes <= NATRON_RAM_BUFFER_POOL_THREAD_MAX_BYTES) {
+            tls->freeLists[nBytes].push_back(data);
+            tls->bytes += nBytes;
+
+            return;
+        }
+    }
+
+    // The thread free list is full, spill to the global list
+    g_pool.put(data, nBytes);
+}
+
+void
+RamBufferPool::clear()
+{
+    std::list<FreeListsMap> toFree;
+    {
+        QMutexLocker k(&g_pool.lock);
+        for (std::list<RamBufferPoolThreadData*>::iterator it = g_pool.threads.begin(); it != g_pool.threads.end(); ++it) {
+            QMutexLocker k2(&(*it)->lock);
+            toFree.push_back( FreeListsMap() );
+            toFree.back().swap( (*it)->freeLists );
+            (*it)->bytes = 0;
+        }
+        toFree.push_back( FreeListsMap() );
+        toFree.back().swap(g_pool.freeLists);
+    }
+
+    // Free outside of the locks
+    for (std::list<FreeListsMap>::iterator it = toFree.begin(); it != toFree.end(); ++it) {
+        freeAll(*it);
+    }
+}
+
+std::size_t
+RamBufferPool::getSize()
+{
+    return (std::size_t)g_pool.pooledKiB.fetchAndAddRelaxed(0) * 1024;
+}
+
+void
+RamBufferPool::getStats(RamBufferPoolStats* stats)
+{
+    assert(stats);
+    // The counters are 32-bit: read them as unsigned so that they wrap around instead of going negative,
+    // RenderStats subtracts them modulo 2^32
+    stats->nHits = (unsigned int)g_pool.nHits.fetchAndAddRelaxed(0);
+    stats->nMisses = (unsigned int)g_pool.nMisses.fetchAndAddRelaxed(0);
+    stats->nRecycled = (unsigned int)g_pool.nRecycled.fetchAndAddRelaxed(0);
+    stats->nDropped = (unsigned int)g_pool.nDropped.fetchAndAddRelaxed(0);
+    stats->bytesPooled = getSize();
+}
+
+NATRON_NAMESPACE_EXIT
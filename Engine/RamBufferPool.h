@@ -0,0 +1,130 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ * Copyright (C) 2018-2020 The Natron developers
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_RAMBUFFERPOOL_H
+#define NATRON_ENGINE_RAMBUFFERPOOL_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <cstddef>
+
+#include "Global/GlobalDefines.h"
+
+#include "Engine/EngineFwd.h"
+
+// Buffers smaller than this are not worth recycling: malloc is already fast for them.
+#define NATRON_RAM_BUFFER_POOL_MIN_BYTES (64 * 1024)
+
+// Maximum amount of freed memory kept around in the pool for recycling, across all threads.
+#define NATRON_RAM_BUFFER_POOL_MAX_BYTES (512ULL * 1024ULL * 1024ULL)
+
+// Maximum amount of memory a thread keeps in its own free lists before spilling to the global list
+#define NATRON_RAM_BUFFER_POOL_THREAD_MAX_BYTES (64ULL * 1024ULL * 1024ULL)
+
+NATRON_NAMESPACE_ENTER
+
+/**
+ * @brief Counters of the RamBufferPool. They are accumulated since the start of the application,
+ * RenderStats reports the difference over a frame.
+ **/
+struct RamBufferPoolStats
+{
+    // Number of allocations served by a recycled buffer
+    U64 nHits;
+
+    // Number of allocations that had to call malloc
+    U64 nMisses;
+
+    // Number of buffers given back to the pool
+    U64 nRecycled;
+
+    // Number of buffers freed because the pool was full
+    U64 nDropped;
+
+    // Bytes currently held by the free lists of all threads and the global spill list
+    U64 bytesPooled;
+
+    RamBufferPoolStats()
+        : nHits(0)
+        , nMisses(0)
+        , nRecycled(0)
+        , nDropped(0)
+        , bytesPooled(0)
+    {
+    }
+
+    double getHitRate() const
+    {
+        U64 total = nHits + nMisses;
+
+        return total == 0 ? 0. : (double)nHits / total;
+    }
+};
+
+/**
+ * @brief A size-classed pool recycling the memory of RamBuffer objects.
+ * Images of the same ImageParams footprint are allocated and freed over and over during playback:
+ * instead of going back to malloc/free, freed buffers are kept in a free list indexed by their exact
+ * byte size and handed back to the next allocation of the same size.
+ * Each thread first looks in its own free lists, then in the global spill list.
+ * Buffers freed by a thread go to its own free lists until they hold NATRON_RAM_BUFFER_POOL_THREAD_MAX_BYTES,
+ * then to the global list. All lists together hold at most NATRON_RAM_BUFFER_POOL_MAX_BYTES.
+ * All functions are thread-safe.
+ **/
+class RamBufferPool
+{
+public:
+
+    /**
+     * @brief Returns a buffer of at least nBytes, either recycled or freshly allocated.
+     * Returns NULL if the allocation failed.
+     **/
+    static void* allocate(std::size_t nBytes);
+
+    /**
+     * @brief Gives back a buffer obtained by allocate(nBytes) with the same nBytes.
+     **/
+    static void release(void* data, std::size_t nBytes);
+
+    /**
+     * @brief Frees all buffers held by the pool, including the free lists of all threads.
+     * Called when the system is running low on memory or when the caches are cleared.
+     **/
+    static void clear();
+
+    /**
+     * @brief Returns the amount of memory held by the pool, rounded up to the KiB for each buffer.
+     **/
+    static std::size_t getSize();
+
+    /**
+     * @brief Returns the counters of the pool since the start of the application.
+     **/
+    static void getStats(RamBufferPoolStats* stats);
+};
+
+NATRON_NAMESPACE_EXIT
+
+#endif // NATRON_ENGINE_RAMBUFFERPOOL_H
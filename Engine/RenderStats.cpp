@@ -66,6 +66,10 @@ struct NodeRenderStatsPrivate
     int nbCacheHit;
     int nbCacheHitButDownscaledImages;
 
+    //Copies from a temporary image to the cached image avoided by rendering directly in the cached image
+    int nbCopiesAvoided;
+    U64 nbBytesNotCopied;
+
     //Is tile support enabled for this render
     bool tileSupportEnabled;
 
@@ -89,6 +93,8 @@ struct NodeRenderStatsPrivate
         , nbCacheMisses(0)
         , nbCacheHit(0)
         , nbCacheHitButDownscaledImages(0)
+        , nbCopiesAvoided(0)
+        , nbBytesNotCopied(0)
         , tileSupportEnabled(false)
         , renderScaleSupportEnabled(false)
         , channelsEnabled()
@@ -128,6 +134,8 @@ NodeRenderStats::operator=(const NodeRenderStats& other)
     _imp->nbCacheMisses = other._imp->nbCacheMisses;
     _imp->nbCacheHit = other._imp->nbCacheHit;
     _imp->nbCacheHitButDownscaledImages = other._imp->nbCacheHitButDownscaledImages;
+    _imp->nbCopiesAvoided = other._imp->nbCopiesAvoided;
+    _imp->nbBytesNotCopied = other._imp->nbBytesNotCopied;
     _imp->tileSupportEnabled = other._imp->tileSupportEnabled;
     _imp->renderScaleSupportEnabled = other._imp->renderScaleSupportEnabled;
     for (int i = 0; i < 4; ++i) {
@@ -254,6 +262,21 @@ NodeRenderStats::getCacheAccessInfos(int* nbCacheMisses,
     *nbCacheHitButDownscaledImages = _imp->nbCacheHitButDownscaledImages;
 }
 
+void
+NodeRenderStats::addCopyAvoided(U64 nbBytes)
+{
+    ++_imp->nbCopiesAvoided;
+    _imp->nbBytesNotCopied += nbBytes;
+}
+
+void
+NodeRenderStats::getCopiesAvoided(int* nbCopiesAvoided,
+                                  U64* nbBytesNotCopied) const
+{
+    *nbCopiesAvoided = _imp->nbCopiesAvoided;
+    *nbBytesNotCopied = _imp->nbBytesNotCopied;
+}
+
 void
 NodeRenderStats::setTilesSupported(bool tilesSupported)
 {
@@ -315,13 +338,18 @@ struct RenderStatsPrivate
     typedef std::map<NodeWPtr, NodeRenderStats > NodeInfosMap;
     NodeInfosMap nodeInfos;
 
+    //The RamBufferPool counters when the frame started
+    RamBufferPoolStats bufferPoolStatsAtStart;
+
 
     RenderStatsPrivate()
         : lock()
         , totalTimeSpentForFrameTimer()
         , doNodesProfiling(false)
         , nodeInfos()
+        , bufferPoolStatsAtStart()
     {
+        RamBufferPool::getStats(&bufferPoolStatsAtStart);
     }
 
     NodeInfosMap::iterator findNode(const NodePtr& node)
@@ -415,6 +443,18 @@ RenderStats::addCacheInfosForNode(const NodePtr& node,
     stats.addCacheAccessInfo(isCacheMiss, hasDownscaled);
 }
 
+void
+RenderStats::addCopyAvoidedForNode(const NodePtr& node,
+                                   U64 nbBytes)
+{
+    QMutexLocker k(&_imp->lock);
+
+    assert(_imp->doNodesProfiling);
+
+    NodeRenderStats& stats = _imp->findOrCreateNodeStats(node);
+    stats.addCopyAvoided(nbBytes);
+}
+
 void
 RenderStats::addRenderInfosForNode(const NodePtr& node,
                                    const NodePtr& identity,
@@ -454,4 +494,18 @@ RenderStats::getStats(double *totalTimeSpent) const
     return ret;
 }
 
+void
+RenderStats::getRamBufferPoolStats(RamBufferPoolStats* stats) const
+{
+    RamBufferPool::getStats(stats);
+
+    // The counters are 32-bit and may have wrapped around since the start: subtract modulo 2^32.
+    // bytesPooled is not a counter, leave it as is
+    const RamBufferPoolStats& start = _imp->bufferPoolStatsAtStart;
+    stats->nHits = (unsigned int)(stats->nHits - start.nHits);
+    stats->nMisses = (unsigned int)(stats->nMisses - start.nMisses);
+    stats->nRecycled = (unsigned int)(stats->nRecycled - start.nRecycled);
+    stats->nDropped = (unsigned int)(stats->nDropped - start.nDropped);
+}
+
 NATRON_NAMESPACE_EXIT
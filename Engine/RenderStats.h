@@ -44,6 +44,7 @@
 
 #include "Engine/RectI.h"
 #include "Engine/RectD.h"
+#include "Engine/RamBufferPool.h"
 #include "Engine/EngineFwd.h"
 
 NATRON_NAMESPACE_ENTER
@@ -88,6 +89,9 @@ public:
     void addCacheAccessInfo(bool isCacheMiss, bool hasDownscaled);
     void getCacheAccessInfos(int* nbCacheMisses, int* nbCacheHits, int* nbCacheHitButDownscaledImages) const;
 
+    void addCopyAvoided(U64 nbBytes);
+    void getCopiesAvoided(int* nbCopiesAvoided, U64* nbBytesNotCopied) const;
+
     void setTilesSupported(bool tilesSupported);
     bool isTilesSupportEnabled() const;
 
@@ -137,6 +141,13 @@ public:
                               bool isCacheMiss,
                               bool hasDownscaled);
 
+    /**
+     * @brief Called when the node rendered directly in its cached image instead of rendering in a temporary
+     * image and copying nbBytes to the cached image.
+     **/
+    void addCopyAvoidedForNode(const NodePtr& node,
+                               U64 nbBytes);
+
     void addRenderInfosForNode(const NodePtr& node,
                                const NodePtr& identity,
                                const std::string& plane,
@@ -145,6 +156,13 @@ public:
 
     std::map<NodePtr, NodeRenderStats > getStats(double *totalTimeSpent) const;
 
+    /**
+     * @brief Returns the activity of the RamBufferPool since this object was created,
+     * i.e: how many image buffers were recycled instead of being allocated while rendering the frame.
+     * Note that the pool is shared by all renders, so concurrent renders are accounted too.
+     **/
+    void getRamBufferPoolStats(RamBufferPoolStats* stats) const;
+
 private:
 
     boost::scoped_ptr<RenderStatsPrivate> _imp;
@@ -31,6 +31,7 @@
 #include <limits>
 #include <cassert>
 #include <stdexcept>
+#include <vector>
 #include <cstring> // for std::memcpy, std::memset
 #include <sstream> // stringstream
 
@@ -68,8 +69,10 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 #include "Engine/RotoContextSerialization.h"
 #include "Engine/RotoDrawableItem.h"
 #include "Engine/RotoLayer.h"
+#include "Engine/RotoShapeRasterizer.h"
 #include "Engine/RotoStrokeItem.h"
 #include "Engine/Settings.h"
+#include "Engine/TileScheduler.h"
 #include "Engine/TimeLine.h"
 #include "Engine/Transform.h"
 #include "Engine/ViewerInstance.h"
@@ -2710,16 +2713,238 @@ RotoStrokeItem::renderSingleStroke(const RectD& pointsBbox,
     return distToNext;
 } // RotoStrokeItem::renderSingleStroke
 
+template <typename PIX, int maxValue>
+static inline PIX
+rotoCoverageToPixel(float v)
+{
+    return (maxValue == 1) ? PIX(v) : PIX(v * maxValue + 0.5f);
+}
+
+template <typename PIX, int maxValue, int dstNComps>
+static void
+writeRotoCoverageForComponents(const float* coverage,
+                               std::size_t coverageStride,
+                               const RectI& rect,
+                               Image::WriteAccess* acc,
+                               const double shapeColor[3],
+                               double opacity,
+                               bool inverted)
+{
+    // Same conversion as convertCairoImageToNatronImage_noColor with useOpacity = true
+    const float r = (float)(shapeColor[0] * opacity);
+    const float g = (float)(shapeColor[1] * opacity);
+    const float b = (float)(shapeColor[2] * opacity);
+    const float a = (float)opacity;
+    const int width = rect.width();
+
+    for (int y = 0; y < rect.height(); ++y) {
+        const float* srcPix = coverage + y * coverageStride;
+        PIX* dstPix = (PIX*)acc->pixelAt(rect.x1, rect.y1 + y);
+        assert(dstPix);
+
+        for (int x = 0; x < width; ++x, dstPix += dstNComps) {
+            const float v = inverted ? 1.f - srcPix[x] : srcPix[x];
+            switch (dstNComps) {
+            case 4:
+                dstPix[0] = rotoCoverageToPixel<PIX, maxValue>(v * r);
+                dstPix[1] = rotoCoverageToPixel<PIX, maxValue>(v * g);
+                dstPix[2] = rotoCoverageToPixel<PIX, maxValue>(v * b);
+                dstPix[3] = rotoCoverageToPixel<PIX, maxValue>(v * a);
+                break;
+            case 1:
+                dstPix[0] = rotoCoverageToPixel<PIX, maxValue>(v * a);
+                break;
+            case 3:
+                dstPix[0] = rotoCoverageToPixel<PIX, maxValue>(v * r);
+                dstPix[1] = rotoCoverageToPixel<PIX, maxValue>(v * g);
+                dstPix[2] = rotoCoverageToPixel<PIX, maxValue>(v * b);
+                break;
+            case 2:
+                dstPix[0] = rotoCoverageToPixel<PIX, maxValue>(v * r);
+                dstPix[1] = rotoCoverageToPixel<PIX, maxValue>(v * g);
+                break;
+            default:
+                break;
+            }
+        }
+    }
+}
+
+template <typename PIX, int maxValue>
+static void
+writeRotoCoverage(const float* coverage,
+                  std::size_t coverageStride,
+                  const RectI& rect,
+                  int nComps,
+                  Image::WriteAccess* acc,
+                  const double shapeColor[3],
+                  double opacity,
+                  bool inverted)
+{
+    switch (nComps) {
+    case 1:
+        writeRotoCoverageForComponents<PIX, maxValue, 1>(coverage, coverageStride, rect, acc, shapeColor, opacity, inverted);
+        break;
+    case 2:
+        writeRotoCoverageForComponents<PIX, maxValue, 2>(coverage, coverageStride, rect, acc, shapeColor, opacity, inverted);
+        break;
+    case 3:
+        writeRotoCoverageForComponents<PIX, maxValue, 3>(coverage, coverageStride, rect, acc, shapeColor, opacity, inverted);
+        break;
+    case 4:
+        writeRotoCoverageForComponents<PIX, maxValue, 4>(coverage, coverageStride, rect, acc, shapeColor, opacity, inverted);
+        break;
+    default:
+        break;
+    }
+}
+
+#define NATRON_ROTO_RASTERIZE_TILE_SIZE 256
+
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+/**
+ * @brief Rasterizes a Bezier mask tile by tile with the TileScheduler. The caller holds the write access to the image
+ * for the whole job, the tiles being disjoint the tasks may write to it concurrently.
+ **/
+class RotoMaskRasterizeJob
+    : public TileSchedulerJob
+{
+public:
+
+    RotoMaskRasterizeJob(const RotoShapeRasterizer& rasterizer,
+                         const std::list<RectI>& rects,
+                         Image::WriteAccess* acc,
+                         ImageBitDepthEnum depth,
+                         int nComps,
+                         const double shapeColor[3],
+                         double opacity,
+                         bool inverted)
+        : TileSchedulerJob()
+        , _rasterizer(rasterizer)
+        , _tiles()
+        , _acc(acc)
+        , _depth(depth)
+        , _nComps(nComps)
+        , _opacity(opacity)
+        , _inverted(inverted)
+    {
+        for (int i = 0; i < 3; ++i) {
+            _shapeColor[i] = shapeColor[i];
+        }
+        for (std::list<RectI>::const_iterator it = rects.begin(); it != rects.end(); ++it) {
+            for (int y = it->y1; y < it->y2; y += NATRON_ROTO_RASTERIZE_TILE_SIZE) {
+                for (int x = it->x1; x < it->x2; x += NATRON_ROTO_RASTERIZE_TILE_SIZE) {
+                    _tiles.push_back( RectI( x, y,
+                                             std::min(x + NATRON_ROTO_RASTERIZE_TILE_SIZE, it->x2),
+                                             std::min(y + NATRON_ROTO_RASTERIZE_TILE_SIZE, it->y2) ) );
+                }
+            }
+        }
+    }
+
+    virtual ~RotoMaskRasterizeJob() {}
+
+    virtual int getTasksCount() const OVERRIDE FINAL
+    {
+        return (int)_tiles.size();
+    }
+
+    virtual bool runTask(int taskIndex) OVERRIDE FINAL
+    {
+        const RectI& tile = _tiles[taskIndex];
+        std::vector<float> coverage( (std::size_t)tile.area() );
+
+        _rasterizer.rasterize(tile, &coverage[0], tile.width());
+
+        switch (_depth) {
+        case eImageBitDepthFloat:
+            writeRotoCoverage<float, 1>(&coverage[0], tile.width(), tile, _nComps, _acc, _shapeColor, _opacity, _inverted);
+            break;
+        case eImageBitDepthByte:
+            writeRotoCoverage<unsigned char, 255>(&coverage[0], tile.width(), tile, _nComps, _acc, _shapeColor, _opacity, _inverted);
+            break;
+        case eImageBitDepthShort:
+            writeRotoCoverage<unsigned short, 65535>(&coverage[0], tile.width(), tile, _nComps, _acc, _shapeColor, _opacity, _inverted);
+            break;
+        case eImageBitDepthHalf:
+        case eImageBitDepthNone:
+            assert(false);
+            break;
+        }
+
+        return true;
+    }
+
+private:
+
+    const RotoShapeRasterizer& _rasterizer;
+    std::vector<RectI> _tiles;
+    Image::WriteAccess* _acc;
+    ImageBitDepthEnum _depth;
+    int _nComps;
+    double _shapeColor[3];
+    double _opacity;
+    bool _inverted;
+};
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+void
+RotoDrawableItem::rasterizeBezierMask(const std::list<RectI>& rects,
+                                      const double startTime,
+                                      const double endTime,
+                                      const double timeStep,
+                                      const double time,
+                                      const bool inverted,
+                                      const unsigned int mipmapLevel,
+                                      const ImagePtr &image)
+{
+    Bezier* isBezier = dynamic_cast<Bezier*>(this);
+
+    assert(isBezier);
+    if (!isBezier) {
+        return;
+    }
+
+    RotoShapeRasterizer rasterizer;
+    RotoContextPrivate::rasterizeBezier(isBezier, time, startTime, endTime, timeStep, mipmapLevel, &rasterizer);
+
+    double shapeColor[3];
+    getColor(time, shapeColor);
+
+    double opacity = getOpacity(time);
+
+    {
+        Image::WriteAccess acc = image->getWriteRights();
+        RotoMaskRasterizeJob job(rasterizer, rects, &acc, image->getBitDepth(), (int)image->getComponentsCount(), shapeColor, opacity, inverted);
+        appPTR->getTileScheduler()->runJob(&job);
+    }
+
+    for (std::list<RectI>::const_iterator it = rects.begin(); it != rects.end(); ++it) {
+        image->markForRendered(*it);
+    }
+} // RotoDrawableItem::rasterizeBezierMask
+
 ImagePtr
 RotoDrawableItem::renderMaskFromStroke(const ImagePlaneDesc& components,
                                        const double time,
                                        const ViewIdx view,
                                        const ImageBitDepthEnum depth,
                                        const unsigned int mipmapLevel,
-                                       const RectD& rotoNodeSrcRod)
+                                       const RectD& rotoNodeSrcRod,
+                                       const RectD& roi)
 {
     NodePtr node = getContext()->getNode();
     ImagePtr image; // = stroke->getStrokeTimePreview();
+    RotoStrokeItem* isStroke = dynamic_cast<RotoStrokeItem*>(this);
+    Bezier* isBezier = dynamic_cast<Bezier*>(this);
+
+    ///Closed beziers are rasterized by RotoShapeRasterizer, only on the region of interest: the cached mask
+    ///may be partially rendered and its bitmap tells what is left to render.
+    const bool rasterizeBezier = isBezier && !isBezier->isOpenBezier();
+    RectI pixelRoI;
+    roi.toPixelEnclosing(mipmapLevel, 1., &pixelRoI);
 
     ///compute an enhanced hash different from the one of the merge node of the item in order to differentiate within the cache
     ///the output image of the node and the mask image.
@@ -2744,6 +2969,16 @@ RotoDrawableItem::renderMaskFromStroke(const ImagePlaneDesc& components,
     {
         QReadLocker k(&_imp->cacheAccessMutex);
         node->getEffectInstance()->getImageFromCacheAndConvertIfNeeded(true, eStorageModeRAM, eStorageModeRAM, *key, mipmapLevel, NULL, NULL, RectI(), depth, components, EffectInstance::InputImagesMap(), RenderStatsPtr(), OSGLContextAttacherPtr(), &image);
+        if ( image && rasterizeBezier && image->usesBitMap() ) {
+            std::list<RectI> restToRender;
+            RectI roiInImage;
+            if ( pixelRoI.intersect(image->getBounds(), &roiInImage) ) {
+                image->getRestToRender(roiInImage, restToRender);
+            }
+            if ( !restToRender.empty() ) {
+                image.reset();
+            }
+        }
     }
 
     if (image) {
@@ -2751,8 +2986,6 @@ RotoDrawableItem::renderMaskFromStroke(const ImagePlaneDesc& components,
     }
 
 
-    RotoStrokeItem* isStroke = dynamic_cast<RotoStrokeItem*>(this);
-    Bezier* isBezier = dynamic_cast<Bezier*>(this);
     double startTime = time, mbFrameStep = 1., endTime = time;
 #ifdef NATRON_ROTO_ENABLE_MOTION_BLUR
     if (isBezier) {
@@ -2842,6 +3075,20 @@ RotoDrawableItem::renderMaskFromStroke(const ImagePlaneDesc& components,
     ///Does nothing if image is already alloc
     image->allocateMemory();
 
+    if (rasterizeBezier) {
+        std::list<RectI> rectsToRender;
+        RectI roiInImage;
+        if ( !image->usesBitMap() ) {
+            rectsToRender.push_back( image->getBounds() );
+        } else if ( pixelRoI.intersect(image->getBounds(), &roiInImage) ) {
+            image->getRestToRender(roiInImage, rectsToRender);
+        }
+        if ( !rectsToRender.empty() ) {
+            rasterizeBezierMask(rectsToRender, startTime, endTime, mbFrameStep, time, inverted, mipmapLevel, image);
+        }
+
+        return image;
+    }
 
     image = renderMaskInternal(pixelRod, components, startTime, endTime, mbFrameStep, time, inverted, depth, mipmapLevel, strokes, image);
 
@@ -3308,6 +3555,63 @@ RotoContextPrivate::renderBezier(cairo_t* cr,
     }
 } // RotoContextPrivate::renderBezier
 
+void
+RotoContextPrivate::rasterizeBezier(const Bezier* bezier,
+                                    double time,
+                                    double startTime, double endTime, double mbFrameStep,
+                                    unsigned int mipmapLevel,
+                                    RotoShapeRasterizer* rasterizer)
+{
+    ///render the bezier only if finished (closed) and activated
+    if ( !bezier->isCurveFinished() || !bezier->isActivated(time) || ( bezier->getControlPointsCount() <= 1 ) ) {
+        return;
+    }
+
+    for (double t = startTime; t <= endTime; t+=mbFrameStep) {
+        double featherDist = bezier->getFeatherDistance(t);
+
+        ///Adjust the feather distance so it takes the mipmap level into account
+        if (mipmapLevel != 0) {
+            featherDist /= (1 << mipmapLevel);
+        }
+
+        std::list<RotoFeatherVertex> featherMesh;
+        std::list<std::list<ParametricPoint> > bezierPolygon;
+        computeFeatherTriangles(bezier, t, mipmapLevel, featherDist, &featherMesh, &bezierPolygon);
+
+        rasterizer->beginSample( bezier->getFeatherFallOff(t) );
+
+        std::vector<Point> contour;
+        for (std::list<std::list<ParametricPoint> >::const_iterator it = bezierPolygon.begin(); it != bezierPolygon.end(); ++it) {
+            for (std::list<ParametricPoint>::const_iterator it2 = it->begin(); it2 != it->end(); ++it2) {
+                Point p = {it2->x, it2->y};
+                contour.push_back(p);
+            }
+        }
+        rasterizer->addContour(contour);
+
+        // The feather mesh is a list of triangles
+        assert(featherMesh.size() % 3 == 0);
+        std::list<RotoFeatherVertex>::const_iterator it = featherMesh.begin();
+        while (it != featherMesh.end()) {
+            const RotoFeatherVertex& v0 = *it;
+            if (++it == featherMesh.end()) {
+                break;
+            }
+            const RotoFeatherVertex& v1 = *it;
+            if (++it == featherMesh.end()) {
+                break;
+            }
+            const RotoFeatherVertex& v2 = *it;
+            ++it;
+            Point p0 = {v0.x, v0.y};
+            Point p1 = {v1.x, v1.y};
+            Point p2 = {v2.x, v2.y};
+            rasterizer->addFeatherTriangle(p0, v0.isInner, p1, v1.isInner, p2, v2.isInner);
+        }
+    }
+} // RotoContextPrivate::rasterizeBezier
+
 void
 RotoContextPrivate::renderFeather(const Bezier* bezier,
                                   double time,
@@ -3813,21 +4117,16 @@ static void tess_intersection_combine_callback(double coords[3], void */*data*/[
 }
 
 void
-RotoContextPrivate::computeTriangles(const Bezier * bezier, double time, unsigned int mipmapLevel, double featherDist,
-                                     std::list<RotoFeatherVertex>* featherMesh,
-                                     std::list<RotoTriangleFans>* internalFans,
-                                     std::list<RotoTriangles>* internalTriangles,
-                                     std::list<RotoTriangleStrips>* internalStrips)
+RotoContextPrivate::computeFeatherTriangles(const Bezier * bezier, double time, unsigned int mipmapLevel, double featherDist,
+                                            std::list<RotoFeatherVertex>* featherMesh,
+                                            std::list<std::list<ParametricPoint> >* bezierPolygonOut)
 {
-    ///Note that we do not use the opacity when rendering the bezier, it is rendered with correct floating point opacity/color when converting
-    ///to the Natron image.
-
     bool clockWise = bezier->isFeatherPolygonClockwiseOriented(false, time);
 
     const double absFeatherDist = std::abs(featherDist);
 
     std::list<std::list<ParametricPoint> > featherPolygon;
-    std::list<std::list<ParametricPoint> > bezierPolygon;
+    std::list<std::list<ParametricPoint> >& bezierPolygon = *bezierPolygonOut;
 
     RectD featherPolyBBox;
     featherPolyBBox.setupInfinity();
@@ -3990,6 +4289,20 @@ RotoContextPrivate::computeTriangles(const Bezier * bezier, double time, unsigne
 
 
     } // for all points in polygon
+} // RotoContextPrivate::computeFeatherTriangles
+
+void
+RotoContextPrivate::computeTriangles(const Bezier * bezier, double time, unsigned int mipmapLevel, double featherDist,
+                                     std::list<RotoFeatherVertex>* featherMesh,
+                                     std::list<RotoTriangleFans>* internalFans,
+                                     std::list<RotoTriangles>* internalTriangles,
+                                     std::list<RotoTriangleStrips>* internalStrips)
+{
+    ///Note that we do not use the opacity when rendering the bezier, it is rendered with correct floating point opacity/color when converting
+    ///to the Natron image.
+
+    std::list<std::list<ParametricPoint> > bezierPolygon;
+    computeFeatherTriangles(bezier, time, mipmapLevel, featherDist, featherMesh, &bezierPolygon);
 
     // Now tessellate the internal bezier using glu
     tessPolygonData tessData;
@@ -4026,7 +4339,7 @@ RotoContextPrivate::computeTriangles(const Bezier * bezier, double time, unsigne
     // check for errors
     assert(tessData.error == 0);
 
-} // RotoContextPrivate::computeFeatherTriangles
+} // RotoContextPrivate::computeTriangles
 
 void
 RotoContextPrivate::renderInternalShape_cairo(const std::list<RotoTriangles>& triangles,
@@ -543,6 +543,7 @@ struct BezierPrivate
 };
 
 class RotoLayer;
+struct ParametricPoint;
 struct RotoItemPrivate
 {
     RotoContextWPtr context;
@@ -2235,6 +2236,8 @@ public:
                                           const std::list<RotoTriangleFans>& fans,
                                           const std::list<RotoTriangleStrips>& strips,
                                           double shapeColor[3],  cairo_pattern_t * mesh);
+    static void rasterizeBezier(const Bezier* bezier, double time, double startTime, double endTime, double mbFrameStep, unsigned int mipmapLevel, RotoShapeRasterizer* rasterizer);
+    static void computeFeatherTriangles(const Bezier * bezier, double time, unsigned int mipmapLevel, double featherDist, std::list<RotoFeatherVertex>* featherMesh, std::list<std::list<ParametricPoint> >* bezierPolygon);
     static void computeTriangles(const Bezier * bezier, double time, unsigned int mipmapLevel,  double featherDist, std::list<RotoFeatherVertex>* featherMesh, std::list<RotoTriangleFans>* internalFans, std::list<RotoTriangles>* internalTriangles,std::list<RotoTriangleStrips>* internalStrips);
     static void renderInternalShape(double time, unsigned int mipmapLevel, double shapeColor[3], double opacity, const Transform::Matrix3x3 & transform, cairo_t * cr, cairo_pattern_t * mesh, const BezierCPs &cps);
     static void bezulate(double time, const BezierCPs& cps, std::list<BezierCPs>* patches);
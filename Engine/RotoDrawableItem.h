@@ -207,7 +207,8 @@ public:
                                                   const ViewIdx view,
                                                   const ImageBitDepthEnum depth,
                                                   const unsigned int mipmapLevel,
-                                                  const RectD& rotoNodeSrcRod);
+                                                  const RectD& rotoNodeSrcRod,
+                                                  const RectD& roi);
 
 private:
 
@@ -223,6 +224,15 @@ private:
                                                 const std::list<std::list<std::pair<Point, double> > >& strokes,
                                                 const ImagePtr &image);
 
+    void rasterizeBezierMask(const std::list<RectI>& rects,
+                             const double startTime,
+                             const double endTime,
+                             const double timeStep,
+                             const double time,
+                             const bool inverted,
+                             const unsigned int mipmapLevel,
+                             const ImagePtr &image);
+
 Q_SIGNALS:
 
     void invertedStateChanged();
@@ -0,0 +1,393 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ * Copyright (C) 2018-2020 The Natron developers
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "RotoShapeRasterizer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <utility>
+
+// Number of intervals of the feather fall-off lookup table
+#define NATRON_ROTO_FALLOFF_LUT_SIZE 1024
+
+NATRON_NAMESPACE_ENTER
+
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+// An edge of a contour, oriented so that y0 < y1. winding is the direction of the original edge.
+struct RotoShapeEdge
+{
+    double x0, y0, x1, y1;
+    double xmin;
+    int winding;
+};
+
+// s is 0 on the shape and 1 on the feather contour
+struct RotoFeatherTriangle
+{
+    double x[3], y[3];
+    double s[3];
+    double xmin, xmax, ymin, ymax;
+};
+
+struct RotoShapeSample
+{
+    std::vector<RotoShapeEdge> edges;
+    std::vector<RotoFeatherTriangle> triangles;
+    std::vector<float> fallOffLut;
+};
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+struct RotoShapeRasterizerPrivate
+{
+    std::vector<RotoShapeSample> samples;
+
+    RotoShapeRasterizerPrivate()
+        : samples()
+    {
+    }
+
+    RotoShapeSample& currentSample()
+    {
+        assert( !samples.empty() );
+
+        return samples.back();
+    }
+
+    static void rasterizeSample(const RotoShapeSample& sample,
+                                const RectI& rect,
+                                float* dst,
+                                std::size_t rowStride);
+};
+
+RotoShapeRasterizer::RotoShapeRasterizer()
+    : _imp( new RotoShapeRasterizerPrivate() )
+{
+}
+
+RotoShapeRasterizer::~RotoShapeRasterizer()
+{
+}
+
+double
+RotoShapeRasterizer::evaluateFallOff(double fallOff,
+                                     double s)
+{
+    if (s <= 0.) {
+        return 1.;
+    } else if (s >= 1.) {
+        return 0.;
+    }
+    if (fallOff <= 0.) {
+        fallOff = 1e-6;
+    }
+    // The Cairo renderer drew each feather quad as a Coons patch whose sides from the shape to the feather contour
+    // are cubic curves with their control points at these fractions of the side (see RotoContextPrivate::renderFeather).
+    // The color is interpolated linearly along the curve parameter u, so the position s along the side is x(u).
+    const double c1 = 1. / (2. * fallOff * fallOff + 1.);
+    const double c2 = 2. / (fallOff * fallOff + 2.);
+    // x(u) is increasing on [0, 1]: bisect
+    double u0 = 0.;
+    double u1 = 1.;
+    for (int i = 0; i < 40; ++i) {
+        double u = (u0 + u1) / 2.;
+        double v = 1. - u;
+        double x = 3. * v * v * u * c1 + 3. * v * u * u * c2 + u * u * u;
+        if (x < s) {
+            u0 = u;
+        } else {
+            u1 = u;
+        }
+    }
+    double alpha = 1. - (u0 + u1) / 2.;
+
+    // The mesh was both the source and the mask of cairo_mask(), which squares its alpha
+    return alpha * alpha;
+}
+
+void
+RotoShapeRasterizer::beginSample(double fallOff)
+{
+    _imp->samples.push_back( RotoShapeSample() );
+    std::vector<float>& lut = _imp->currentSample().fallOffLut;
+    lut.resize(NATRON_ROTO_FALLOFF_LUT_SIZE + 1);
+    for (int i = 0; i <= NATRON_ROTO_FALLOFF_LUT_SIZE; ++i) {
+        lut[i] = (float)evaluateFallOff(fallOff, (double)i / NATRON_ROTO_FALLOFF_LUT_SIZE);
+    }
+}
+
+void
+RotoShapeRasterizer::addContour(const std::vector<Point>& contour)
+{
+    std::vector<RotoShapeEdge>& edges = _imp->currentSample().edges;
+    const std::size_t n = contour.size();
+
+    for (std::size_t i = 0; i < n; ++i) {
+        const Point& a = contour[i];
+        const Point& b = contour[(i + 1) % n];
+        if (a.y == b.y) {
+            // horizontal edges never cross a scan-line
+            continue;
+        }
+        RotoShapeEdge e;
+        if (a.y < b.y) {
+            e.x0 = a.x;
+            e.y0 = a.y;
+            e.x1 = b.x;
+            e.y1 = b.y;
+            e.winding = 1;
+        } else {
+            e.x0 = b.x;
+            e.y0 = b.y;
+            e.x1 = a.x;
+            e.y1 = a.y;
+            e.winding = -1;
+        }
+        e.xmin = std::min(e.x0, e.x1);
+        edges.push_back(e);
+    }
+}
+
+void
+RotoShapeRasterizer::addFeatherTriangle(const Point& p0,
+                                        bool inner0,
+                                        const Point& p1,
+                                        bool inner1,
+                                        const Point& p2,
+                                        bool inner2)
+{
+    RotoFeatherTriangle t;
+
+    t.x[0] = p0.x;
+    t.y[0] = p0.y;
+    t.s[0] = inner0 ? 0. : 1.;
+    t.x[1] = p1.x;
+    t.y[1] = p1.y;
+    t.s[1] = inner1 ? 0. : 1.;
+    t.x[2] = p2.x;
+    t.y[2] = p2.y;
+    t.s[2] = inner2 ? 0. : 1.;
+    t.xmin = std::min( p0.x, std::min(p1.x, p2.x) );
+    t.xmax = std::max( p0.x, std::max(p1.x, p2.x) );
+    t.ymin = std::min( p0.y, std::min(p1.y, p2.y) );
+    t.ymax = std::max( p0.y, std::max(p1.y, p2.y) );
+    _imp->currentSample().triangles.push_back(t);
+}
+
+bool
+RotoShapeRasterizer::isEmpty() const
+{
+    for (std::size_t i = 0; i < _imp->samples.size(); ++i) {
+        if ( !_imp->samples[i].edges.empty() || !_imp->samples[i].triangles.empty() ) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool
+crossingLess(const std::pair<double, int>& a,
+             const std::pair<double, int>& b)
+{
+    return a.first < b.first;
+}
+
+// Index of the first pixel whose center is at or after x
+static inline int
+firstPixelAfter(double x)
+{
+    return (int)std::ceil(x - 0.5);
+}
+
+void
+RotoShapeRasterizerPrivate::rasterizeSample(const RotoShapeSample& sample,
+                                            const RectI& rect,
+                                            float* dst,
+                                            std::size_t rowStride)
+{
+    const int width = rect.width();
+    const int height = rect.height();
+    // centers of the first and last rows and columns
+    const double yFirst = rect.y1 + 0.5;
+    const double yLast = rect.y2 - 0.5;
+    const double xLast = rect.x2 - 0.5;
+
+    for (int y = 0; y < height; ++y) {
+        std::fill(dst + y * rowStride, dst + y * rowStride + width, 0.f);
+    }
+
+    // The shape: crossings of the row center with the edges, filled with the non-zero winding rule.
+    // Edges entirely on the right of the rectangle do not change the winding of its pixels.
+    std::vector<const RotoShapeEdge*> edges;
+    for (std::vector<RotoShapeEdge>::const_iterator it = sample.edges.begin(); it != sample.edges.end(); ++it) {
+        if ( (it->y1 > yFirst) && (it->y0 <= yLast) && (it->xmin <= xLast) ) {
+            edges.push_back( &(*it) );
+        }
+    }
+    if ( !edges.empty() ) {
+        std::vector<std::pair<double, int> > crossings;
+        for (int y = 0; y < height; ++y) {
+            const double yc = rect.y1 + y + 0.5;
+            crossings.clear();
+            for (std::vector<const RotoShapeEdge*>::const_iterator it = edges.begin(); it != edges.end(); ++it) {
+                const RotoShapeEdge& e = **it;
+                if ( (e.y0 <= yc) && (yc < e.y1) ) {
+                    double x = e.x0 + (yc - e.y0) * (e.x1 - e.x0) / (e.y1 - e.y0);
+                    crossings.push_back( std::make_pair(x, e.winding) );
+                }
+            }
+            if ( crossings.empty() ) {
+                continue;
+            }
+            std::sort(crossings.begin(), crossings.end(), crossingLess);
+            float* row = dst + y * rowStride;
+            int winding = 0;
+            for (std::size_t i = 0; i < crossings.size(); ++i) {
+                winding += crossings[i].second;
+                if (winding == 0) {
+                    continue;
+                }
+                // the span ends at the next crossing, or at the end of the rectangle if it was culled
+                int x1 = std::max(firstPixelAfter(crossings[i].first), rect.x1);
+                int x2 = i + 1 < crossings.size() ? std::min(firstPixelAfter(crossings[i + 1].first), rect.x2) : rect.x2;
+                for (int x = x1; x < x2; ++x) {
+                    row[x - rect.x1] = 1.f;
+                }
+            }
+        }
+    }
+
+    // The feather: the smallest distance to the shape of all triangles covering a pixel, which gives the most opaque pixel.
+    std::vector<float> minS;
+    for (std::vector<RotoFeatherTriangle>::const_iterator it = sample.triangles.begin(); it != sample.triangles.end(); ++it) {
+        const RotoFeatherTriangle& t = *it;
+        int tx1 = std::max(firstPixelAfter(t.xmin), rect.x1);
+        int tx2 = std::min(firstPixelAfter(t.xmax + 1.), rect.x2);
+        int ty1 = std::max(firstPixelAfter(t.ymin), rect.y1);
+        int ty2 = std::min(firstPixelAfter(t.ymax + 1.), rect.y2);
+        if ( (tx1 >= tx2) || (ty1 >= ty2) ) {
+            continue;
+        }
+        // edge functions: w[i] is the signed area of the triangle made of the pixel and the edge opposite to vertex i
+        double area = (t.x[1] - t.x[0]) * (t.y[2] - t.y[0]) - (t.y[1] - t.y[0]) * (t.x[2] - t.x[0]);
+        if (area == 0.) {
+            continue;
+        }
+        const double sign = area > 0. ? 1. : -1.;
+        area *= sign;
+        if ( minS.empty() ) {
+            minS.resize(width * height, 2.f);
+        }
+        // The edge functions are evaluated at each pixel rather than incrementally, so that the result does not depend
+        // on the rectangle being rasterized: tiles must match exactly at their borders.
+        for (int y = ty1; y < ty2; ++y) {
+            const double yc = y + 0.5;
+            double rowTerm[3];
+            for (int i = 0; i < 3; ++i) {
+                const int a = (i + 1) % 3;
+                const int b = (i + 2) % 3;
+                rowTerm[i] = (t.x[b] - t.x[a]) * (yc - t.y[a]);
+            }
+            float* row = &minS[(y - rect.y1) * width];
+            for (int x = tx1; x < tx2; ++x) {
+                const double xc = x + 0.5;
+                double w[3];
+                for (int i = 0; i < 3; ++i) {
+                    const int a = (i + 1) % 3;
+                    const int b = (i + 2) % 3;
+                    w[i] = sign * ( rowTerm[i] - (t.y[b] - t.y[a]) * (xc - t.x[a]) );
+                }
+                if ( (w[0] >= 0.) && (w[1] >= 0.) && (w[2] >= 0.) ) {
+                    float s = (float)( (w[0] * t.s[0] + w[1] * t.s[1] + w[2] * t.s[2]) / area );
+                    float& pix = row[x - rect.x1];
+                    pix = std::min(pix, s);
+                }
+            }
+        }
+    }
+    if ( minS.empty() ) {
+        return;
+    }
+
+    // The feather is composited over the shape, i.e. it only shows outside of the shape
+    const float* lut = &sample.fallOffLut[0];
+    for (int y = 0; y < height; ++y) {
+        float* row = dst + y * rowStride;
+        const float* sRow = &minS[y * width];
+        for (int x = 0; x < width; ++x) {
+            if ( (row[x] == 1.f) || (sRow[x] > 1.f) ) {
+                continue;
+            }
+            float index = std::max(sRow[x], 0.f) * NATRON_ROTO_FALLOFF_LUT_SIZE;
+            int i = std::min( (int)index, NATRON_ROTO_FALLOFF_LUT_SIZE - 1 );
+            float frac = index - i;
+            row[x] = lut[i] + (lut[i + 1] - lut[i]) * frac;
+        }
+    }
+} // RotoShapeRasterizerPrivate::rasterizeSample
+
+void
+RotoShapeRasterizer::rasterize(const RectI& rect,
+                               float* coverage,
+                               std::size_t rowStride) const
+{
+    const int width = rect.width();
+    const int height = rect.height();
+
+    if ( (width <= 0) || (height <= 0) ) {
+        return;
+    }
+    assert(coverage && rowStride >= (std::size_t)width);
+    if ( _imp->samples.empty() ) {
+        for (int y = 0; y < height; ++y) {
+            std::fill(coverage + y * rowStride, coverage + y * rowStride + width, 0.f);
+        }
+
+        return;
+    }
+
+    RotoShapeRasterizerPrivate::rasterizeSample(_imp->samples[0], rect, coverage, rowStride);
+    if (_imp->samples.size() == 1) {
+        return;
+    }
+
+    // motion blur: the other samples are composited over the first one
+    std::vector<float> sampleCoverage(width * height);
+    for (std::size_t i = 1; i < _imp->samples.size(); ++i) {
+        RotoShapeRasterizerPrivate::rasterizeSample(_imp->samples[i], rect, &sampleCoverage[0], width);
+        for (int y = 0; y < height; ++y) {
+            float* dst = coverage + y * rowStride;
+            const float* src = &sampleCoverage[y * width];
+            for (int x = 0; x < width; ++x) {
+                dst[x] = src[x] + dst[x] * (1.f - src[x]);
+            }
+        }
+    }
+}
+
+NATRON_NAMESPACE_EXIT
@@ -0,0 +1,109 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ * Copyright (C) 2018-2020 The Natron developers
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_ROTOSHAPERASTERIZER_H
+#define NATRON_ENGINE_ROTOSHAPERASTERIZER_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <cstddef>
+#include <vector>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/scoped_ptr.hpp>
+#endif
+
+#include "Global/GlobalDefines.h"
+
+#include "Engine/RectI.h"
+#include "Engine/EngineFwd.h"
+
+NATRON_NAMESPACE_ENTER
+
+/**
+ * @brief A scanline rasterizer for closed Roto shapes and their feather, used instead of Cairo to render the Bezier masks.
+ *
+ * The shape is given as polygons (the discretized Bezier) filled with the non-zero winding rule, and the feather as a mesh
+ * of triangles whose vertices are either on the shape (opacity 1) or on the feather contour (opacity 0). The opacity
+ * across the feather follows the same fall-off curve as the Cairo mesh patches did.
+ *
+ * Once the geometry is added, rasterize() may be called concurrently on disjoint rectangles: only the edges and triangles
+ * intersecting a rectangle are visited, so that a mask can be rendered tile by tile, and only on the region of interest.
+ **/
+struct RotoShapeRasterizerPrivate;
+class RotoShapeRasterizer
+{
+public:
+
+    RotoShapeRasterizer();
+
+    ~RotoShapeRasterizer();
+
+    /**
+     * @brief Starts a new sample of the shape, e.g. one per motion blur step. All contours and triangles added afterwards
+     * belong to this sample. The samples are composited with the over operator.
+     **/
+    void beginSample(double fallOff);
+
+    /**
+     * @brief Adds a closed contour of the shape to the current sample. The last point is joined to the first one.
+     **/
+    void addContour(const std::vector<Point>& contour);
+
+    /**
+     * @brief Adds a triangle of the feather mesh to the current sample. Where feather triangles overlap, the most opaque one wins.
+     **/
+    void addFeatherTriangle(const Point& p0,
+                            bool inner0,
+                            const Point& p1,
+                            bool inner1,
+                            const Point& p2,
+                            bool inner2);
+
+    bool isEmpty() const;
+
+    /**
+     * @brief Computes the opacity in [0, 1] of the pixels of rect:
+     * coverage[(y - rect.y1) * rowStride + (x - rect.x1)] is the opacity of the pixel (x, y).
+     * Pixels are sampled at their center, as Cairo does without antialiasing, so that the shape and the feather do not overlap
+     * or leave gaps between them.
+     **/
+    void rasterize(const RectI& rect,
+                   float* coverage,
+                   std::size_t rowStride) const;
+
+    /**
+     * @brief The opacity of the feather at the normalized distance s from the shape (0) to the feather contour (1).
+     **/
+    static double evaluateFallOff(double fallOff, double s);
+
+private:
+
+    boost::scoped_ptr<RotoShapeRasterizerPrivate> _imp;
+};
+
+NATRON_NAMESPACE_EXIT
+
+#endif // NATRON_ENGINE_ROTOSHAPERASTERIZER_H
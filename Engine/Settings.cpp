@@ -26,6 +26,7 @@
 #include "Settings.h"
 
 #include <cassert>
+#include <algorithm> // max
 #include <stdexcept>
 
 #include <QtCore/QDebug>
@@ -54,6 +55,7 @@
 #include "Engine/Plugin.h"
 #include "Engine/Project.h"
 #include "Engine/StandardPaths.h"
+#include "Engine/TileScheduler.h"
 #include "Engine/Utils.h"
 #include "Engine/ViewIdx.h"
 #include "Engine/ViewerInstance.h"
@@ -305,8 +307,8 @@ Settings::initializeKnobsThreading()
 
     _useThreadPool = AppManager::createKnob<KnobBool>( this, tr("Effects use the thread-pool") );
     _useThreadPool->setName("useThreadPool");
-    _useThreadPool->setHintToolTip( tr("When checked, all effects will use a global thread-pool to do their processing instead of launching "
-                                       "their own threads. "
+    _useThreadPool->setHintToolTip( tr("When checked, all effects will use a thread-pool to do their processing instead of launching "
+                                       "their own threads. The threads of this pool are kept alive between renders and are not shared with the renders. "
                                        "This suppresses the overhead created by the operating system creating new threads on demand for "
                                        "each rendering of a special effect. As a result of this, the rendering might be faster on systems "
                                        "with a lot of cores (>= 8). \n"
@@ -1205,6 +1207,14 @@ Settings::initializeKnobsCaching()
                                            "output has its settings panel opened.").arg( QString::fromUtf8(NATRON_APPLICATION_NAME) ) );
     _cachingTab->addKnob(_aggressiveCaching);
 
+    _mipMapPyramidCache = AppManager::createKnob<KnobBool>( this, tr("Cache all scales of full resolution images") );
+    _mipMapPyramidCache->setName("mipMapPyramidCache");
+    _mipMapPyramidCache->setHintToolTip( tr("When checked, each time a cached image is rendered at full resolution, "
+                                            "%1 also caches it at 1/2, 1/4 and down to 1/32 of its resolution, so that "
+                                            "zooming out the viewer does not render the image again. "
+                                            "This uses up to a third more memory for these images.").arg( QString::fromUtf8(NATRON_APPLICATION_NAME) ) );
+    _cachingTab->addKnob(_mipMapPyramidCache);
+
     _maxRAMPercent = AppManager::createKnob<KnobInt>( this, tr("Maximum amount of RAM memory used for caching (% of total RAM)") );
     _maxRAMPercent->setName("maxRAMPercent");
     _maxRAMPercent->disableSlider();
@@ -1259,6 +1269,14 @@ Settings::initializeKnobsCaching()
     _maxViewerDiskCacheGB->setHintToolTip( tr("The maximum size that may be used by the playback cache on disk (in GiB)") );
     _cachingTab->addKnob(_maxViewerDiskCacheGB);
 
+    _compressViewerCache = AppManager::createKnob<KnobBool>( this, tr("Compress the playback cache") );
+    _compressViewerCache->setName("compressViewerCache");
+    _compressViewerCache->setHintToolTip( tr("When checked, the images displayed by the viewer are stored losslessly compressed "
+                                             "in the playback cache, so that about 2 to 4 times more frames fit in it. "
+                                             "Cached frames are then decompressed each time they are displayed, which takes some CPU time. "
+                                             "The compression ratio and the decompression time are displayed with the cache size in the node graph.") );
+    _cachingTab->addKnob(_compressViewerCache);
+
     _maxDiskCacheNodeGB = AppManager::createKnob<KnobInt>( this, tr("Maximum DiskCache node disk usage (GiB)") );
     _maxDiskCacheNodeGB->setName("maxDiskCacheNode");
     _maxDiskCacheNodeGB->disableSlider();
@@ -1267,6 +1285,19 @@ Settings::initializeKnobsCaching()
     _maxDiskCacheNodeGB->setHintToolTip( tr("The maximum size that may be used by the DiskCache node on disk (in GiB)") );
     _cachingTab->addKnob(_maxDiskCacheNodeGB);
 
+    _cacheShardsCount = AppManager::createKnob<KnobInt>( this, tr("Number of cache shards") );
+    _cacheShardsCount->setName("cacheShardsCount");
+    _cacheShardsCount->disableSlider();
+    _cacheShardsCount->setMinimum(0);
+    _cacheShardsCount->setMaximum(256);
+    _cacheShardsCount->setHintToolTip( tr("WARNING: Changing this parameter requires a restart of the application. \n"
+                                          "The image and playback caches are split in this number of independent partitions, "
+                                          "each with its own lock, so that render threads looking up different images do not "
+                                          "wait on each other. "
+                                          "When set to 0, the number of partitions is the number of hardware threads of the system. "
+                                          "When set to 1, the caches use a single global partition.") );
+    _cachingTab->addKnob(_cacheShardsCount);
+
 
     _diskCachePath = AppManager::createKnob<KnobPath>( this, tr("Disk cache path") );
     _diskCachePath->setName("diskCachePath");
@@ -1500,10 +1531,13 @@ Settings::setDefaultValues()
 
     // Caching
     _aggressiveCaching->setDefaultValue(false);
+    _mipMapPyramidCache->setDefaultValue(true);
     _maxRAMPercent->setDefaultValue(50, 0);
     _unreachableRAMPercent->setDefaultValue(5);
     _maxViewerDiskCacheGB->setDefaultValue(5, 0);
+    _compressViewerCache->setDefaultValue(false);
     _maxDiskCacheNodeGB->setDefaultValue(10, 0);
+    _cacheShardsCount->setDefaultValue(0);
     //_diskCachePath
     setCachingLabels();
 
@@ -2267,11 +2301,14 @@ Settings::onKnobValueChanged(KnobI* k,
         appPTR->setNThreadsToRender(nbThreads);
         if (nbThreads == -1) {
             QThreadPool::globalInstance()->setMaxThreadCount(1);
+            appPTR->getTileScheduler()->setWorkersCount(1);
             appPTR->abortAnyProcessing();
         } else if (nbThreads == 0) {
             QThreadPool::globalInstance()->setMaxThreadCount( QThread::idealThreadCount() );
+            appPTR->getTileScheduler()->setWorkersCount( QThread::idealThreadCount() );
         } else {
             QThreadPool::globalInstance()->setMaxThreadCount(nbThreads);
+            appPTR->getTileScheduler()->setWorkersCount(nbThreads);
         }
     } else if ( k == _nThreadsPerEffect.get() ) {
         appPTR->setNThreadsPerEffect( getNumberOfThreadsPerEffect() );
@@ -2480,6 +2517,12 @@ Settings::isAggressiveCachingEnabled() const
     return _aggressiveCaching->getValue();
 }
 
+bool
+Settings::isMipMapPyramidCacheEnabled() const
+{
+    return _mipMapPyramidCache->getValue();
+}
+
 double
 Settings::getRamMaximumPercent() const
 {
@@ -2492,12 +2535,30 @@ Settings::getMaximumViewerDiskCacheSize() const
     return (U64)( _maxViewerDiskCacheGB->getValue() ) * 1024 * 1024 * 1024;
 }
 
+bool
+Settings::isViewerCacheCompressionEnabled() const
+{
+    return _compressViewerCache->getValue();
+}
+
 U64
 Settings::getMaximumDiskCacheNodeSize() const
 {
     return (U64)( _maxDiskCacheNodeGB->getValue() ) * 1024 * 1024 * 1024;
 }
 
+int
+Settings::getCacheShardsCount() const
+{
+    int nShards = _cacheShardsCount->getValue();
+
+    if (nShards <= 0) {
+        nShards = appPTR->getHardwareIdealThreadCount();
+    }
+
+    return std::max(1, nShards);
+}
+
 ///////////////////////////////////////////////////
 
 double
@@ -109,8 +109,12 @@ public:
 
     U64 getMaximumViewerDiskCacheSize() const;
 
+    bool isViewerCacheCompressionEnabled() const;
+
     U64 getMaximumDiskCacheNodeSize() const;
 
+    int getCacheShardsCount() const;
+
     double getUnreachableRamPercent() const;
 
     bool getColorPickerLinear() const;
@@ -274,6 +278,8 @@ public:
 
     bool isAggressiveCachingEnabled() const;
 
+    bool isMipMapPyramidCacheEnabled() const;
+
     bool isAutoTurboEnabled() const;
 
     void setAutoTurboModeEnabled(bool e);
@@ -493,6 +499,7 @@ private:
     // Caching
     KnobPagePtr _cachingTab;
     KnobBoolPtr _aggressiveCaching;
+    KnobBoolPtr _mipMapPyramidCache;
     ///The percentage of the value held by _maxRAMPercent to dedicate to playback cache (viewer cache's in-RAM portion) only
     KnobStringPtr _maxPlaybackLabel;
 
@@ -512,7 +519,11 @@ private:
 
     ///The total disk space allowed for all Natron's caches
     KnobIntPtr _maxViewerDiskCacheGB;
+    KnobBoolPtr _compressViewerCache;
     KnobIntPtr _maxDiskCacheNodeGB;
+
+    ///The number of hash-partitions of the image and viewer caches
+    KnobIntPtr _cacheShardsCount;
     KnobPathPtr _diskCachePath;
     KnobButtonPtr _wipeDiskCache;
 
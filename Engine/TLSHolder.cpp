@@ -29,6 +29,7 @@
 #include <cassert>
 #include <stdexcept>
 
+#include "Engine/AppManager.h"
 #include "Engine/OfxClipInstance.h"
 #include "Engine/OfxHost.h"
 #include "Engine/OfxParamInstance.h"
@@ -37,10 +38,36 @@
 
 #include <QtCore/QWaitCondition>
 #include <QtCore/QThread>
+#include <QtCore/QThreadStorage>
 #include <QtCore/QDebug>
 
 NATRON_NAMESPACE_ENTER
 
+// QThreadStorage takes ownership of the pointer and deletes it when the thread exits
+static QThreadStorage<unsigned int*> g_threadGeneration;
+
+static unsigned int*
+getThreadGeneration()
+{
+    if ( !g_threadGeneration.hasLocalData() ) {
+        g_threadGeneration.setLocalData( new unsigned int(0) );
+    }
+
+    return g_threadGeneration.localData();
+}
+
+unsigned int
+AppTLS::getCurrentThreadGeneration()
+{
+    return *getThreadGeneration();
+}
+
+void
+AppTLS::incrementCurrentThreadGeneration()
+{
+    ++*getThreadGeneration();
+}
+
 
 AppTLS::AppTLS()
     : _objectMutex()
@@ -91,6 +118,16 @@ AppTLS::copyTLS(QThread* fromThread,
     }
 
     copyAbortInfo(fromThread, toThread);
+    copyTLSInternal(fromThread, toThread);
+}
+
+void
+AppTLS::copyTLSInternal(const QThread* fromThread,
+                        const QThread* toThread)
+{
+    if ( toThread == QThread::currentThread() ) {
+        incrementCurrentThreadGeneration();
+    }
 
     QReadLocker k(&_objectMutex);
     const TLSObjects& objectsCRef = _object->objects; // take a const ref, since it's a read lock
@@ -113,6 +150,10 @@ AppTLS::softCopy(QThread* fromThread,
 
     copyAbortInfo(fromThread, toThread);
 
+    if ( toThread == QThread::currentThread() ) {
+        incrementCurrentThreadGeneration();
+    }
+
     QWriteLocker k(&_spawnsMutex);
     _spawns[toThread] = fromThread;
 }
@@ -127,6 +168,16 @@ AppTLS::cleanupTLSForThread()
         isAbortableThread->clearAbortInfo();
     }
 
+    cleanupTLSForThreadInternal(curThread);
+}
+
+void
+AppTLS::cleanupTLSForThreadInternal(const QThread* curThread)
+{
+    if ( curThread == QThread::currentThread() ) {
+        incrementCurrentThreadGeneration();
+    }
+
     //Cleanup any cached data on the TLSHolder
     {
         QWriteLocker l(&_spawnsMutex);
@@ -187,7 +238,39 @@ AppTLS::cleanupTLSForThread()
         _object->objects = newObjects;
 #endif
     }
-} // AppTLS::cleanupTLSForThread
+} // AppTLS::cleanupTLSForThreadInternal
+
+TLSSnapshot::TLSSnapshot(QThread* fromThread)
+    : _hasAbortInfo(false)
+    , _isRenderResponseToUserInteraction(false)
+    , _abortInfo()
+    , _treeRoot()
+{
+    AbortableThread* fromAbortable = dynamic_cast<AbortableThread*>(fromThread);
+
+    if (fromAbortable) {
+        _hasAbortInfo = true;
+        fromAbortable->getAbortInfo(&_isRenderResponseToUserInteraction, &_abortInfo, &_treeRoot);
+    }
+    appPTR->getAppTLS()->copyTLSInternal( fromThread, getKey() );
+}
+
+TLSSnapshot::~TLSSnapshot()
+{
+    appPTR->getAppTLS()->cleanupTLSForThreadInternal( getKey() );
+}
+
+void
+TLSSnapshot::copyTo(QThread* toThread) const
+{
+    if (_hasAbortInfo) {
+        AbortableThread* toAbortable = dynamic_cast<AbortableThread*>(toThread);
+        if (toAbortable) {
+            toAbortable->setAbortInfo(_isRenderResponseToUserInteraction, _abortInfo, _treeRoot);
+        }
+    }
+    appPTR->getAppTLS()->copyTLSInternal(getKey(), toThread);
+}
 
 template class TLSHolder<EffectInstance::EffectTLSData>;
 template class TLSHolder<NATRON_NAMESPACE::OfxHost::OfxHostTLSData>;
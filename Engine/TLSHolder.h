@@ -40,6 +40,7 @@
 #include <boost/shared_ptr.hpp>
 #include <boost/weak_ptr.hpp>
 #include <boost/enable_shared_from_this.hpp>
+#include <boost/noncopyable.hpp>
 #endif
 
 #include <QtCore/QReadWriteLock>
@@ -93,6 +94,9 @@ protected:
  **/
 class AppTLS
 {
+    friend class TLSSnapshot;
+    template <typename T> friend class TLSHolder;
+
     //This is the object in the QThreadStorage, it is duplicated on every thread
 
     typedef std::set<TLSHolderBaseConstWPtr> TLSObjects;
@@ -150,8 +154,27 @@ public:
      **/
     void cleanupTLSForThread();
 
+    /**
+     * @brief Returns a number that changes whenever TLS is created for the calling thread, copied to it or cleaned up,
+     * i.e: whenever the TLS objects previously returned to this thread may have been replaced.
+     * This does not take any lock, so that hot paths can cache the TLS objects of the thread and only look them up again
+     * when the generation changes. The TLS of a thread is only ever copied or cleaned up by the thread itself
+     * (snapshots copy to a key that is never a running thread), which is what makes the generation reliable.
+     **/
+    static unsigned int getCurrentThreadGeneration();
+
 private:
 
+    static void incrementCurrentThreadGeneration();
+
+    /**
+     * @brief Copy the TLS held by the holders from fromThread to toThread. The threads are only used as keys
+     * and are never dereferenced, so a key that is not a thread may be used (see TLSSnapshot).
+     **/
+    void copyTLSInternal(const QThread* fromThread, const QThread* toThread);
+
+    void cleanupTLSForThreadInternal(const QThread* curThread);
+
     template <typename T>
     boost::shared_ptr<T> copyTLSFromSpawnerThreadInternal(const TLSHolderBase* holder,
                                                           const QThread* curThread,
@@ -169,6 +192,39 @@ private:
 };
 
 
+/**
+ * @brief A frozen copy of the TLS and abort info of a thread. Other threads can copy it with copyTo() while the
+ * original thread keeps running and modifying its own TLS, which copying from the live thread would race with.
+ * The snapshot must be made by the original thread itself, or while it is not modifying its TLS.
+ **/
+class TLSSnapshot
+    : public boost::noncopyable
+{
+public:
+
+    explicit TLSSnapshot(QThread* fromThread);
+
+    ~TLSSnapshot();
+
+    /**
+     * @brief Copy the TLS and abort info of the snapshot to toThread. May be called concurrently.
+     **/
+    void copyTo(QThread* toThread) const;
+
+private:
+
+    // The key under which the copy of the TLS is stored: the address of the snapshot, which is never that of a thread
+    const QThread* getKey() const
+    {
+        return reinterpret_cast<const QThread*>(this);
+    }
+
+    bool _hasAbortInfo;
+    bool _isRenderResponseToUserInteraction;
+    AbortableRenderInfoPtr _abortInfo;
+    EffectInstancePtr _treeRoot;
+};
+
 /**
  * @brief Use this class if you need to hold TLS data on an object.
  * @param T is the data type held in the thread-local storage.
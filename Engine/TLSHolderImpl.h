@@ -189,6 +189,7 @@ TLSHolder<T>::getOrCreateTLSData() const
         QWriteLocker k(&perThreadDataMutex);
         perThreadData.insert( std::make_pair(curThread, data) );
     }
+    AppTLS::incrementCurrentThreadGeneration();
     assert(data.value);
 
     return data.value;
@@ -243,6 +244,8 @@ AppTLS::copyTLSFromSpawnerThread(const TLSHolderBase* holder,
         QWriteLocker k(&_objectMutex);
         boost::shared_ptr<T> retval = copyTLSFromSpawnerThreadInternal<T>(holder, curThread, foundThread);
 
+        incrementCurrentThreadGeneration();
+
 
         return retval;
     }
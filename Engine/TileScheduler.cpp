@@ -0,0 +1,403 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ * Copyright (C) 2018-2020 The Natron developers
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "TileScheduler.h"
+
+#include <algorithm> // min, max
+#include <cassert>
+#include <deque>
+#include <vector>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/scoped_array.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/make_shared.hpp>
+#endif
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QMutex>
+#include <QtCore/QReadWriteLock>
+#include <QtCore/QThread>
+#include <QtCore/QWaitCondition>
+
+#include "Engine/ThreadPool.h"
+
+NATRON_NAMESPACE_ENTER
+
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+// The state of a job while it is running
+struct TileSchedulerJobState
+{
+    TileSchedulerJob* job;
+
+    // 1 when a thread took the task. A task is run by the first thread claiming it, other copies of it are skipped.
+    boost::scoped_array<QAtomicInt> claimed;
+
+    // 1 when a task returned false: the tasks not claimed yet are skipped
+    QAtomicInt cancelled;
+
+    // Protects nRemaining
+    QMutex doneMutex;
+    QWaitCondition doneCond;
+    int nRemaining;
+
+    TileSchedulerJobState(TileSchedulerJob* job)
+        : job(job)
+        , claimed( new QAtomicInt[job->getTasksCount()] )
+        , cancelled()
+        , doneMutex()
+        , doneCond()
+        , nRemaining( job->getTasksCount() )
+    {
+    }
+
+    /**
+     * @brief Run the task if no other thread took it yet. Returns false if it was already taken.
+     **/
+    bool claimAndRun(int taskIndex)
+    {
+        if ( !claimed[taskIndex].testAndSetAcquire(0, 1) ) {
+            return false;
+        }
+        if (cancelled.fetchAndAddRelaxed(0) == 0) {
+            if ( !job->runTask(taskIndex) ) {
+                cancelled.fetchAndStoreRelease(1);
+            }
+        }
+
+        QMutexLocker k(&doneMutex);
+        --nRemaining;
+        assert(nRemaining >= 0);
+        if (nRemaining == 0) {
+            doneCond.wakeAll();
+        }
+
+        return true;
+    }
+};
+
+typedef boost::shared_ptr<TileSchedulerJobState> TileSchedulerJobStatePtr;
+
+struct TileSchedulerTask
+{
+    TileSchedulerJobStatePtr state;
+    int taskIndex;
+
+    TileSchedulerTask()
+        : state()
+        , taskIndex(-1)
+    {
+    }
+
+    TileSchedulerTask(const TileSchedulerJobStatePtr& state,
+                      int taskIndex)
+        : state(state)
+        , taskIndex(taskIndex)
+    {
+    }
+};
+
+struct TileSchedulerQueue
+{
+    QMutex lock;
+    std::deque<TileSchedulerTask> tasks;
+};
+
+typedef boost::shared_ptr<TileSchedulerQueue> TileSchedulerQueuePtr;
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+class TileSchedulerWorker;
+
+struct TileSchedulerPrivate
+{
+    // Protects queues and workers against the creation of new workers
+    mutable QReadWriteLock queuesLock;
+    std::vector<TileSchedulerQueuePtr> queues;
+    std::vector<TileSchedulerWorker*> workers;
+
+    // Number of tasks in all queues. Incremented with workMutex held so that workers cannot miss a wake-up.
+    QAtomicInt nQueuedTasks;
+
+    // Protects nActiveWorkers and mustQuit, workCond is signaled when tasks are queued
+    mutable QMutex workMutex;
+    QWaitCondition workCond;
+    int nActiveWorkers;
+    bool mustQuit;
+
+    TileSchedulerPrivate()
+        : queuesLock()
+        , queues()
+        , workers()
+        , nQueuedTasks()
+        , workMutex()
+        , workCond()
+        , nActiveWorkers(1)
+        , mustQuit(false)
+    {
+    }
+
+    void ensureWorkersStarted(int nWorkers);
+
+    bool popTask(int workerIndex, TileSchedulerTask* task);
+
+    void workerLoop(int workerIndex);
+};
+
+class TileSchedulerWorker
+    : public QThread
+      , public AbortableThread
+{
+    TileSchedulerPrivate* _scheduler;
+    int _workerIndex;
+
+public:
+
+    TileSchedulerWorker(TileSchedulerPrivate* scheduler,
+                        int workerIndex)
+        : QThread()
+        , AbortableThread(this)
+        , _scheduler(scheduler)
+        , _workerIndex(workerIndex)
+    {
+        setThreadName("Tile Scheduler Worker");
+    }
+
+    virtual ~TileSchedulerWorker() {}
+
+private:
+
+    virtual void run() OVERRIDE FINAL
+    {
+        _scheduler->workerLoop(_workerIndex);
+    }
+};
+
+void
+TileSchedulerPrivate::ensureWorkersStarted(int nWorkers)
+{
+    {
+        QReadLocker k(&queuesLock);
+        if ( (int)workers.size() >= nWorkers ) {
+            return;
+        }
+    }
+    QWriteLocker k(&queuesLock);
+    {
+        QMutexLocker l(&workMutex);
+        if (mustQuit) {
+            return;
+        }
+    }
+    while ( (int)workers.size() < nWorkers ) {
+        queues.push_back( boost::make_shared<TileSchedulerQueue>() );
+        TileSchedulerWorker* worker = new TileSchedulerWorker(this, (int)workers.size());
+        workers.push_back(worker);
+        worker->start();
+    }
+}
+
+bool
+TileSchedulerPrivate::popTask(int workerIndex,
+                              TileSchedulerTask* task)
+{
+    QReadLocker k(&queuesLock);
+    const int nQueues = (int)queues.size();
+
+    // Own queue first, from the front: this is where the neighbouring tiles are
+    {
+        TileSchedulerQueue& own = *queues[workerIndex];
+        QMutexLocker l(&own.lock);
+        if ( !own.tasks.empty() ) {
+            *task = own.tasks.front();
+            own.tasks.pop_front();
+            nQueuedTasks.fetchAndAddRelaxed(-1);
+
+            return true;
+        }
+    }
+
+    // Steal from the back of the other queues, the tiles that their owner would have processed last
+    for (int i = 1; i < nQueues; ++i) {
+        TileSchedulerQueue& victim = *queues[(workerIndex + i) % nQueues];
+        QMutexLocker l(&victim.lock);
+        if ( !victim.tasks.empty() ) {
+            *task = victim.tasks.back();
+            victim.tasks.pop_back();
+            nQueuedTasks.fetchAndAddRelaxed(-1);
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void
+TileSchedulerPrivate::workerLoop(int workerIndex)
+{
+    for (;;) {
+        {
+            QMutexLocker k(&workMutex);
+            while ( !mustQuit && ( (workerIndex >= nActiveWorkers) || (nQueuedTasks.fetchAndAddRelaxed(0) <= 0) ) ) {
+                workCond.wait(&workMutex);
+            }
+            if (mustQuit) {
+                return;
+            }
+        }
+
+        TileSchedulerTask task;
+        while ( popTask(workerIndex, &task) ) {
+            // The task may already have been run by the thread that submitted the job
+            task.state->claimAndRun(task.taskIndex);
+            task = TileSchedulerTask();
+        }
+    }
+}
+
+TileScheduler::TileScheduler()
+    : _imp( new TileSchedulerPrivate() )
+{
+}
+
+TileScheduler::~TileScheduler()
+{
+    quitWorkers();
+}
+
+void
+TileScheduler::setWorkersCount(int nWorkers)
+{
+    QMutexLocker k(&_imp->workMutex);
+
+    _imp->nActiveWorkers = std::max(1, nWorkers);
+    _imp->workCond.wakeAll();
+}
+
+int
+TileScheduler::getWorkersCount() const
+{
+    QMutexLocker k(&_imp->workMutex);
+
+    return _imp->nActiveWorkers;
+}
+
+bool
+TileScheduler::isSaturated() const
+{
+    QMutexLocker k(&_imp->workMutex);
+
+    return _imp->nQueuedTasks.fetchAndAddRelaxed(0) >= _imp->nActiveWorkers;
+}
+
+void
+TileScheduler::runJob(TileSchedulerJob* job)
+{
+    const int nTasks = job->getTasksCount();
+
+    if (nTasks <= 0) {
+        return;
+    }
+
+    int nWorkers;
+    {
+        QMutexLocker k(&_imp->workMutex);
+        if (_imp->mustQuit) {
+            nWorkers = 0;
+        } else {
+            nWorkers = _imp->nActiveWorkers;
+        }
+    }
+
+    TileSchedulerJobStatePtr state = boost::make_shared<TileSchedulerJobState>(job);
+
+    // The calling thread takes its share of the tasks, so there is no point in handing out a single task
+    if ( (nWorkers > 0) && (nTasks > 1) ) {
+        _imp->ensureWorkersStarted(nWorkers);
+
+        // Spread the tasks in contiguous chunks: the job gives them in an order where consecutive tasks are close to each other
+        const int nChunks = std::min(nWorkers, nTasks);
+        {
+            QReadLocker k(&_imp->queuesLock);
+            for (int c = 0; c < nChunks; ++c) {
+                const int first = (int)( (long long)nTasks * c / nChunks );
+                const int last = (int)( (long long)nTasks * (c + 1) / nChunks );
+                TileSchedulerQueue& queue = *_imp->queues[c];
+                QMutexLocker l(&queue.lock);
+                for (int i = first; i < last; ++i) {
+                    queue.tasks.push_back( TileSchedulerTask(state, i) );
+                }
+            }
+        }
+        {
+            QMutexLocker k(&_imp->workMutex);
+            _imp->nQueuedTasks.fetchAndAddRelaxed(nTasks);
+            _imp->workCond.wakeAll();
+        }
+    }
+
+    // Help with our own job instead of blocking. Start from the end so that we take the tasks the workers would reach last.
+    for (int i = nTasks - 1; i >= 0; --i) {
+        state->claimAndRun(i);
+    }
+
+    // Wait for the tasks still running on the workers
+    QMutexLocker k(&state->doneMutex);
+    while (state->nRemaining > 0) {
+        state->doneCond.wait(&state->doneMutex);
+    }
+}
+
+void
+TileScheduler::quitWorkers()
+{
+    {
+        QMutexLocker k(&_imp->workMutex);
+        _imp->mustQuit = true;
+        _imp->workCond.wakeAll();
+    }
+
+    // Do not hold queuesLock while waiting: the workers need it to finish their current loop.
+    // No worker can be started anymore once mustQuit is set.
+    std::vector<TileSchedulerWorker*> workers;
+    {
+        QReadLocker k(&_imp->queuesLock);
+        workers = _imp->workers;
+    }
+    for (std::size_t i = 0; i < workers.size(); ++i) {
+        workers[i]->wait();
+    }
+
+    QWriteLocker k(&_imp->queuesLock);
+    for (std::size_t i = 0; i < _imp->workers.size(); ++i) {
+        delete _imp->workers[i];
+    }
+    _imp->workers.clear();
+    _imp->queues.clear();
+}
+
+NATRON_NAMESPACE_EXIT
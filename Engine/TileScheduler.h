@@ -0,0 +1,117 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ * Copyright (C) 2018-2020 The Natron developers
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_TILESCHEDULER_H
+#define NATRON_ENGINE_TILESCHEDULER_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/scoped_ptr.hpp>
+#endif
+
+#include "Engine/EngineFwd.h"
+
+NATRON_NAMESPACE_ENTER
+
+/**
+ * @brief A set of independent tasks, e.g: the tiles of a render, executed by the TileScheduler.
+ * runTask() is called concurrently from the scheduler workers and from the thread that submitted the job.
+ **/
+class TileSchedulerJob
+{
+public:
+
+    TileSchedulerJob() {}
+
+    virtual ~TileSchedulerJob() {}
+
+    virtual int getTasksCount() const = 0;
+
+    /**
+     * @brief Run the task at the given index. If this returns false, the tasks of the job that
+     * were not started yet are skipped (e.g: the render failed or was aborted).
+     **/
+    virtual bool runTask(int taskIndex) = 0;
+};
+
+/**
+ * @brief A work-stealing executor dedicated to the tiles of renderRoI.
+ *
+ * Each worker owns a deque of tasks: it pops tasks from the front of its own deque and steals from the back
+ * of the other deques when it runs out of work. A job's tasks are spread in contiguous chunks over the deques,
+ * so that neighbouring tiles (which share most of their input tiles) stay on the same worker.
+ *
+ * Unlike QtConcurrent, the thread that submits a job does not block while the job is running: it runs the tasks
+ * of its job that were not started yet and only waits for the tasks currently running on other threads. Nested renders
+ * launched from a worker thus never starve the executor.
+ * A thread only ever runs tasks of the jobs it submitted itself, so that its thread-local storage (render args, abort info)
+ * is never mixed with the one of another render.
+ *
+ * Workers derive AbortableThread: the abort info of the submitting thread is copied on the worker along with the
+ * rest of the TLS by the task itself, from a snapshot taken before the job is submitted
+ * (see EffectInstance::Implementation::TiledRenderingJob).
+ **/
+struct TileSchedulerPrivate;
+class TileScheduler
+{
+public:
+
+    TileScheduler();
+
+    ~TileScheduler();
+
+    /**
+     * @brief Set the number of workers that may run tasks. Workers are started lazily, and are never
+     * stopped before the scheduler is destroyed: lowering this just parks the extra workers.
+     **/
+    void setWorkersCount(int nWorkers);
+
+    int getWorkersCount() const;
+
+    /**
+     * @brief Returns true if the tasks already queued are enough to keep all workers busy.
+     **/
+    bool isSaturated() const;
+
+    /**
+     * @brief Runs all the tasks of the job, and returns when they are all done.
+     * The calling thread executes tasks of the job while waiting.
+     **/
+    void runJob(TileSchedulerJob* job);
+
+    /**
+     * @brief Stop all workers. Jobs must not be running anymore.
+     **/
+    void quitWorkers();
+
+private:
+
+    boost::scoped_ptr<TileSchedulerPrivate> _imp;
+};
+
+NATRON_NAMESPACE_EXIT
+
+#endif // NATRON_ENGINE_TILESCHEDULER_H
@@ -1679,6 +1679,40 @@ TrackArgs::getEnabledChannels(bool* r,
     _imp->fa->getEnabledChannels(r, g, b);
 }
 
+TrackerFrameAccessorPtr
+TrackArgs::getFrameAccessor() const
+{
+    return _imp->fa;
+}
+
+static void
+getSearchWindowAtTime(const TrackMarker& marker,
+                      int time,
+                      RectD* rect)
+{
+    KnobDoublePtr searchBtmLeft = marker.getSearchWindowBottomLeftKnob();
+    KnobDoublePtr searchTopRight = marker.getSearchWindowTopRightKnob();
+    KnobDoublePtr centerKnob = marker.getCenterKnob();
+    KnobDoublePtr offsetKnob = marker.getOffsetKnob();
+    Point offset, center, btmLeft, topRight;
+    offset.x = offsetKnob->getValueAtTime(time, 0);
+    offset.y = offsetKnob->getValueAtTime(time, 1);
+
+    center.x = centerKnob->getValueAtTime(time, 0);
+    center.y = centerKnob->getValueAtTime(time, 1);
+
+    btmLeft.x = searchBtmLeft->getValueAtTime(time, 0) + center.x + offset.x;
+    btmLeft.y = searchBtmLeft->getValueAtTime(time, 1) + center.y + offset.y;
+
+    topRight.x = searchTopRight->getValueAtTime(time, 0) + center.x + offset.x;
+    topRight.y = searchTopRight->getValueAtTime(time, 1) + center.y + offset.y;
+
+    rect->x1 = btmLeft.x;
+    rect->y1 = btmLeft.y;
+    rect->x2 = topRight.x;
+    rect->y2 = topRight.y;
+}
+
 void
 TrackArgs::getRedrawAreasNeeded(int time,
                                 std::list<RectD>* canonicalRects) const
@@ -1687,30 +1721,48 @@ TrackArgs::getRedrawAreasNeeded(int time,
         if ( !(*it)->natronMarker->isEnabled(time) ) {
             continue;
         }
-        KnobDoublePtr searchBtmLeft = (*it)->natronMarker->getSearchWindowBottomLeftKnob();
-        KnobDoublePtr searchTopRight = (*it)->natronMarker->getSearchWindowTopRightKnob();
-        KnobDoublePtr centerKnob = (*it)->natronMarker->getCenterKnob();
-        KnobDoublePtr offsetKnob = (*it)->natronMarker->getOffsetKnob();
-        Point offset, center, btmLeft, topRight;
-        offset.x = offsetKnob->getValueAtTime(time, 0);
-        offset.y = offsetKnob->getValueAtTime(time, 1);
-
-        center.x = centerKnob->getValueAtTime(time, 0);
-        center.y = centerKnob->getValueAtTime(time, 1);
-
-        btmLeft.x = searchBtmLeft->getValueAtTime(time, 0) + center.x + offset.x;
-        btmLeft.y = searchBtmLeft->getValueAtTime(time, 1) + center.y + offset.y;
+        RectD rect;
+        getSearchWindowAtTime(*(*it)->natronMarker, time, &rect);
+        canonicalRects->push_back(rect);
+    }
+}
 
-        topRight.x = searchTopRight->getValueAtTime(time, 0) + center.x + offset.x;
-        topRight.y = searchTopRight->getValueAtTime(time, 1) + center.y + offset.y;
+bool
+TrackArgs::getLibMVSearchArea(int time,
+                              RectI* roi) const
+{
+    RectD area;
+    bool hasArea = false;
 
+    for (std::vector<TrackMarkerAndOptionsPtr>::const_iterator it = _imp->tracks.begin(); it != _imp->tracks.end(); ++it) {
+        if ( dynamic_cast<TrackMarkerPM*>( (*it)->natronMarker.get() ) || !(*it)->natronMarker->isEnabled(time) ) {
+            continue;
+        }
         RectD rect;
-        rect.x1 = btmLeft.x;
-        rect.y1 = btmLeft.y;
-        rect.x2 = topRight.x;
-        rect.y2 = topRight.y;
-        canonicalRects->push_back(rect);
+        getSearchWindowAtTime(*(*it)->natronMarker, time, &rect);
+        if ( rect.isNull() ) {
+            continue;
+        }
+        double w = rect.width();
+        double h = rect.height();
+        rect.x1 -= w;
+        rect.x2 += w;
+        rect.y1 -= h;
+        rect.y2 += h;
+        if (hasArea) {
+            area.merge(rect);
+        } else {
+            area = rect;
+            hasArea = true;
+        }
+    }
+    if (!hasArea) {
+        return false;
     }
+    // LibMV regions are in canonical coordinates, see TrackerFrameAccessor::convertLibMVRegionToRectI
+    area.toPixelEnclosing(0, 1., roi);
+
+    return true;
 }
 
 struct TrackSchedulerPrivate
@@ -1883,6 +1935,13 @@ TrackScheduler::threadLoopOnce(const GenericThreadStartArgsPtr& inArgs)
         }
 
 
+        // LibMV tracks look their frames up in the frame accessor: render and convert each frame once for all tracks
+        TrackerFrameAccessorPtr frameAccessor = args->getFrameAccessor();
+        RectI searchArea;
+        if ( frameAccessor && (cur != end) && args->getLibMVSearchArea(cur, &searchArea) ) {
+            frameAccessor->cacheSharedFrame(cur, searchArea);
+        }
+
         while (cur != end) {
             ///Launch parallel thread for each track using the global thread pool
             QFuture<bool> future = QtConcurrent::mapped( trackIndexes,
@@ -1890,8 +1949,26 @@ TrackScheduler::threadLoopOnce(const GenericThreadStartArgsPtr& inArgs)
                                                                      _1,
                                                                      *args,
                                                                      cur) );
+
+            // Meanwhile, render and convert the next frame in this thread. This is not a thread of the global pool,
+            // so the tracks never wait for a task queued behind them.
+            const int next = cur + frameStep;
+            if ( frameAccessor && (next != end) && args->getLibMVSearchArea(cur, &searchArea) ) {
+                frameAccessor->cacheSharedFrame(next, searchArea);
+            }
+
             future.waitForFinished();
 
+            // The next step tracks the next frame with either the current frame or a user keyframe as reference:
+            // keep the current frame and the start frame, which is always a keyframe
+            if (frameAccessor) {
+                std::set<int> framesToKeep;
+                framesToKeep.insert(start);
+                framesToKeep.insert(cur);
+                framesToKeep.insert(next);
+                frameAccessor->releaseSharedFramesExcept(framesToKeep);
+            }
+
             allTrackFailed = true;
             for (QFuture<bool>::const_iterator it = future.begin(); it != future.end(); ++it) {
                 if ( (*it) ) {
@@ -476,11 +476,19 @@ public:
     int getNumTracks() const;
     const std::vector<TrackMarkerAndOptionsPtr>& getTracks() const;
     mv::AutoTrackPtr getLibMVAutoTrack() const;
+    TrackerFrameAccessorPtr getFrameAccessor() const;
 
     void getEnabledChannels(bool* r, bool* g, bool* b) const;
 
     void getRedrawAreasNeeded(int time, std::list<RectD>* canonicalRects) const;
 
+    /**
+     * @brief Returns in roi the bounding box, in pixels at full scale, of the search windows of the LibMV tracks
+     * enabled at the given time, each grown by its own size on every side so that it still encloses the
+     * search window after the track moved on the next frame. Returns false if no LibMV track is enabled.
+     **/
+    bool getLibMVSearchArea(int time, RectI* roi) const;
+
 private:
 
     boost::scoped_ptr<TrackArgsPrivate> _imp;
@@ -25,6 +25,8 @@
 
 #include "TrackerFrameAccessor.h"
 
+#include <cstring> // for std::memcpy
+
 #include <boost/utility.hpp>
 
 GCC_DIAG_OFF(unused-function)
@@ -169,7 +171,7 @@ natronImageToLibMvFloatImageForChannels(const Image* source,
 }
 
 static void
-natronImageToLibMvFloatImage(bool enabledChannels[3],
+natronImageToLibMvFloatImage(const bool enabledChannels[3],
                              const Image* source,
                              const RectI& roi,
                              MvFloatImage& mvImg)
@@ -204,6 +206,35 @@ natronImageToLibMvFloatImage(bool enabledChannels[3],
         }
     }
 }
+
+// LibMV expects the image returned by GetImage to start exactly at the requested region: copy the region out of a larger image
+static MvFloatImagePtr
+cropLibMvFloatImage(const MvFloatImage& source,
+                    const RectI& sourceBounds,
+                    const RectI& roi)
+{
+    assert( sourceBounds.contains(roi) );
+    MvFloatImagePtr ret = boost::make_shared<MvFloatImage>( roi.height(), roi.width() );
+    const int srcRowElements = sourceBounds.width();
+    const float* src_pixels = source.Data() + (roi.y1 - sourceBounds.y1) * srcRowElements + (roi.x1 - sourceBounds.x1);
+    float* dst_pixels = ret->Data();
+    for (int y = roi.y1; y < roi.y2; ++y, src_pixels += srcRowElements, dst_pixels += roi.width()) {
+        std::memcpy( dst_pixels, src_pixels, roi.width() * sizeof(float) );
+    }
+
+    return ret;
+}
+
+/**
+ * @brief A frame converted once for all tracks, see TrackerFrameAccessor::cacheSharedFrame
+ **/
+struct SharedFrame
+{
+    MvFloatImagePtr image;
+    RectI bounds;
+};
+
+typedef std::map<int, SharedFrame> SharedFramesMap;
 } // anon namespace
 
 
@@ -213,6 +244,9 @@ struct TrackerFrameAccessorPrivate
     NodePtr trackerInput;
     mutable QMutex cacheMutex;
     FrameAccessorCache cache;
+
+    // protected by cacheMutex
+    SharedFramesMap sharedFrames;
     bool enabledChannels[3];
     int formatHeight;
 
@@ -223,6 +257,7 @@ struct TrackerFrameAccessorPrivate
         , trackerInput()
         , cacheMutex()
         , cache()
+        , sharedFrames()
         , enabledChannels()
         , formatHeight(formatHeight)
     {
@@ -232,6 +267,8 @@ struct TrackerFrameAccessorPrivate
             this->enabledChannels[i] = enabledChannels[i];
         }
     }
+
+    MvFloatImagePtr renderFrame(int frame, int downscale, const RectI* roiParam, RectI* imageBounds) const;
 };
 
 TrackerFrameAccessor::TrackerFrameAccessor(const TrackerContext* context,
@@ -277,74 +314,35 @@ TrackerFrameAccessor::convertLibMVRegionToRectI(const mv::Region& region,
 }
 
 /*
- * @brief This is called by LibMV to retrieve an image either for reference or as search frame.
+ * @brief Renders the input at the given frame in roiParam (or its RoD if NULL) and converts it to a LibMV grayscale image.
  */
-mv::FrameAccessor::Key
-TrackerFrameAccessor::GetImage(int /*clip*/,
-                               int frame,
-                               mv::FrameAccessor::InputMode input_mode,
-                               int downscale,            // Downscale by 2^downscale.
-                               const mv::Region* region,     // Get full image if NULL.
-                               const mv::FrameAccessor::Transform* /*transform*/, // May be NULL.
-                               mv::FloatImage** destination)
+MvFloatImagePtr
+TrackerFrameAccessorPrivate::renderFrame(int frame,
+                                         int downscale,
+                                         const RectI* roiParam,
+                                         RectI* imageBounds) const
 {
-    // Since libmv only uses MONO images for now we have only optimized for this case, remove and handle properly
-    // other case(s) when they get integrated into libmv.
-    assert(input_mode == mv::FrameAccessor::MONO);
-
-
-    FrameAccessorCacheKey key;
-    key.frame = frame;
-    key.mipMapLevel = downscale;
-    key.mode = input_mode;
-
-    /*
-       Check if a frame exists in the cache with matching key and bounds enclosing the given region
-     */
-    RectI roi;
-    if (region) {
-        convertLibMVRegionToRectI(*region, _imp->formatHeight, &roi);
-
-        QMutexLocker k(&_imp->cacheMutex);
-        std::pair<FrameAccessorCache::iterator, FrameAccessorCache::iterator> range = _imp->cache.equal_range(key);
-        for (FrameAccessorCache::iterator it = range.first; it != range.second; ++it) {
-            if ( (roi.x1 >= it->second.bounds.x1) && (roi.x2 <= it->second.bounds.x2) &&
-                 ( roi.y1 >= it->second.bounds.y1) && ( roi.y2 <= it->second.bounds.y2) ) {
-#ifdef TRACE_LIB_MV
-                qDebug() << QThread::currentThread() << "FrameAccessor::GetImage():" << "Found cached image at frame" << frame << "with RoI x1="
-                         << region->min(0) << "y1=" << region->max(1) << "x2=" << region->max(0) << "y2=" << region->min(1);
-#endif
-                // LibMV is kinda dumb on this we must necessarily copy the data either via CopyFrom or the
-                // assignment constructor:
-                // EDIT: fixed libmv
-                *destination = it->second.image.get();
-                //destination->CopyFrom<float>(*it->second.image);
-                ++it->second.referenceCount;
-
-                return (mv::FrameAccessor::Key)it->second.image.get();
-            }
-        }
-    }
-
     EffectInstancePtr effect;
-    if (_imp->trackerInput) {
-        effect = _imp->trackerInput->getEffectInstance();
+    if (trackerInput) {
+        effect = trackerInput->getEffectInstance();
     }
     if (!effect) {
-        return (mv::FrameAccessor::Key)0;
+        return MvFloatImagePtr();
     }
 
-    // Not in accessor cache, call renderRoI
     RenderScale scale;
     scale.y = scale.x = Image::getScaleFromMipMapLevel( (unsigned int)downscale );
 
 
+    RectI roi;
     RectD precomputedRoD;
-    if (!region) {
+    if (roiParam) {
+        roi = *roiParam;
+    } else {
         bool isProjectFormat;
-        StatusEnum stat = effect->getRegionOfDefinition_public(_imp->trackerInput->getHashValue(), frame, scale, ViewIdx(0), &precomputedRoD, &isProjectFormat);
+        StatusEnum stat = effect->getRegionOfDefinition_public(trackerInput->getHashValue(), frame, scale, ViewIdx(0), &precomputedRoD, &isProjectFormat);
         if (stat == eStatusFailed) {
-            return (mv::FrameAccessor::Key)0;
+            return MvFloatImagePtr();
         }
         double par = effect->getAspectRatio(-1);
         precomputedRoD.toPixelEnclosing( (unsigned int)downscale, par, &roi );
@@ -353,7 +351,7 @@ TrackerFrameAccessor::GetImage(int /*clip*/,
     std::list<ImagePlaneDesc> components;
     components.push_back( ImagePlaneDesc::getRGBComponents() );
 
-    NodePtr node = _imp->context->getNode();
+    NodePtr node = context->getNode();
     const bool isRenderUserInteraction = true;
     const bool isSequentialRender = false;
     AbortableRenderInfoPtr abortInfo = AbortableRenderInfo::create(false, 0);
@@ -383,7 +381,7 @@ TrackerFrameAccessor::GetImage(int /*clip*/,
                                         components,
                                         eImageBitDepthFloat,
                                         true,
-                                        _imp->context->getNode()->getEffectInstance().get(),
+                                        node->getEffectInstance().get(),
                                         eStorageModeRAM /*returnOpenGLTex*/,
                                         frame);
     std::map<ImagePlaneDesc, ImagePtr> planes;
@@ -394,7 +392,7 @@ TrackerFrameAccessor::GetImage(int /*clip*/,
                  << roi.x1 << "y1=" << roi.y1 << "x2=" << roi.x2 << "y2=" << roi.y2;
 #endif
 
-        return (mv::FrameAccessor::Key)0;
+        return MvFloatImagePtr();
     }
 
     assert( !planes.empty() );
@@ -407,7 +405,7 @@ TrackerFrameAccessor::GetImage(int /*clip*/,
                  << roi.x1 << "y1=" << roi.y1 << "x2=" << roi.x2 << "y2=" << roi.y2 << ")";
 #endif
 
-        return (mv::FrameAccessor::Key)0;
+        return MvFloatImagePtr();
     }
 
 #ifdef TRACE_LIB_MV
@@ -418,15 +416,140 @@ TrackerFrameAccessor::GetImage(int /*clip*/,
     /*
        Copy the Natron image to the LivMV float image
      */
-    FrameAccessorCacheEntry entry;
-    entry.image = boost::make_shared<MvFloatImage>( intersectedRoI.height(), intersectedRoI.width() );
-    entry.bounds = intersectedRoI;
-    entry.referenceCount = 1;
-    natronImageToLibMvFloatImage(_imp->enabledChannels,
+    MvFloatImagePtr ret = boost::make_shared<MvFloatImage>( intersectedRoI.height(), intersectedRoI.width() );
+    natronImageToLibMvFloatImage(enabledChannels,
                                  sourceImage.get(),
                                  intersectedRoI,
-                                 *entry.image);
+                                 *ret);
     // we ignore the transform parameter and do it in natronImageToLibMvFloatImage instead
+    *imageBounds = intersectedRoI;
+
+    return ret;
+} // renderFrame
+
+bool
+TrackerFrameAccessor::cacheSharedFrame(int frame,
+                                       const RectI& roi)
+{
+    {
+        QMutexLocker k(&_imp->cacheMutex);
+        SharedFramesMap::const_iterator found = _imp->sharedFrames.find(frame);
+        if ( ( found != _imp->sharedFrames.end() ) && found->second.bounds.contains(roi) ) {
+            return true;
+        }
+    }
+
+    SharedFrame sharedFrame;
+    sharedFrame.image = _imp->renderFrame(frame, 0, &roi, &sharedFrame.bounds);
+    if (!sharedFrame.image) {
+        return false;
+    }
+
+    QMutexLocker k(&_imp->cacheMutex);
+    _imp->sharedFrames[frame] = sharedFrame;
+#ifdef TRACE_LIB_MV
+    qDebug() << QThread::currentThread() << "FrameAccessor::cacheSharedFrame():" << "Rendered frame" << frame << "with RoI x1="
+             << sharedFrame.bounds.x1 << "y1=" << sharedFrame.bounds.y1 << "x2=" << sharedFrame.bounds.x2 << "y2=" << sharedFrame.bounds.y2;
+#endif
+
+    return true;
+}
+
+void
+TrackerFrameAccessor::releaseSharedFramesExcept(const std::set<int>& framesToKeep)
+{
+    QMutexLocker k(&_imp->cacheMutex);
+
+    for (SharedFramesMap::iterator it = _imp->sharedFrames.begin(); it != _imp->sharedFrames.end();) {
+        if ( framesToKeep.find(it->first) == framesToKeep.end() ) {
+            _imp->sharedFrames.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+}
+
+/*
+ * @brief This is called by LibMV to retrieve an image either for reference or as search frame.
+ */
+mv::FrameAccessor::Key
+TrackerFrameAccessor::GetImage(int /*clip*/,
+                               int frame,
+                               mv::FrameAccessor::InputMode input_mode,
+                               int downscale,            // Downscale by 2^downscale.
+                               const mv::Region* region,     // Get full image if NULL.
+                               const mv::FrameAccessor::Transform* /*transform*/, // May be NULL.
+                               mv::FloatImage** destination)
+{
+    // Since libmv only uses MONO images for now we have only optimized for this case, remove and handle properly
+    // other case(s) when they get integrated into libmv.
+    assert(input_mode == mv::FrameAccessor::MONO);
+
+
+    FrameAccessorCacheKey key;
+    key.frame = frame;
+    key.mipMapLevel = downscale;
+    key.mode = input_mode;
+
+    FrameAccessorCacheEntry entry;
+    entry.referenceCount = 1;
+
+    /*
+       Check if a frame exists in the cache with matching key and bounds enclosing the given region
+     */
+    RectI roi;
+    if (region) {
+        convertLibMVRegionToRectI(*region, _imp->formatHeight, &roi);
+
+        MvFloatImagePtr enclosingImage;
+        RectI enclosingBounds;
+        {
+            QMutexLocker k(&_imp->cacheMutex);
+            std::pair<FrameAccessorCache::iterator, FrameAccessorCache::iterator> range = _imp->cache.equal_range(key);
+            for (FrameAccessorCache::iterator it = range.first; it != range.second; ++it) {
+                if ( it->second.bounds.contains(roi) ) {
+                    if (it->second.bounds == roi) {
+#ifdef TRACE_LIB_MV
+                        qDebug() << QThread::currentThread() << "FrameAccessor::GetImage():" << "Found cached image at frame" << frame << "with RoI x1="
+                                 << region->min(0) << "y1=" << region->max(1) << "x2=" << region->max(0) << "y2=" << region->min(1);
+#endif
+                        *destination = it->second.image.get();
+                        ++it->second.referenceCount;
+
+                        return (mv::FrameAccessor::Key)it->second.image.get();
+                    }
+                    enclosingImage = it->second.image;
+                    enclosingBounds = it->second.bounds;
+                }
+            }
+
+            // The frame may have been converted once for all tracks
+            if (!enclosingImage && downscale == 0) {
+                SharedFramesMap::const_iterator found = _imp->sharedFrames.find(frame);
+                if ( ( found != _imp->sharedFrames.end() ) && found->second.bounds.contains(roi) ) {
+                    enclosingImage = found->second.image;
+                    enclosingBounds = found->second.bounds;
+                }
+            }
+        }
+
+        if (enclosingImage) {
+            entry.image = cropLibMvFloatImage(*enclosingImage, enclosingBounds, roi);
+            entry.bounds = roi;
+        }
+    }
+
+    // Not in accessor cache, call renderRoI
+    if (!entry.image) {
+        entry.image = _imp->renderFrame(frame, downscale, region ? &roi : 0, &entry.bounds);
+        if (!entry.image) {
+            return (mv::FrameAccessor::Key)0;
+        }
+#ifdef TRACE_LIB_MV
+        qDebug() << QThread::currentThread() << "FrameAccessor::GetImage():" << "Rendered frame" << frame << "with RoI x1="
+                 << entry.bounds.x1 << "y1=" << entry.bounds.y1 << "x2=" << entry.bounds.x2 << "y2=" << entry.bounds.y2;
+#endif
+    }
 
     *destination = entry.image.get();
     //destination->CopyFrom<float>(*entry.image);
@@ -436,10 +559,6 @@ TrackerFrameAccessor::GetImage(int /*clip*/,
         QMutexLocker k(&_imp->cacheMutex);
         _imp->cache.insert( std::make_pair(key, entry) );
     }
-#ifdef TRACE_LIB_MV
-    qDebug() << QThread::currentThread() << "FrameAccessor::GetImage():" << "Rendered frame" << frame << "with RoI x1="
-             << intersectedRoI.x1 << "y1=" << intersectedRoI.y1 << "x2=" << intersectedRoI.x2 << "y2=" << intersectedRoI.y2;
-#endif
 
     return (mv::FrameAccessor::Key)entry.image.get();
 } // TrackerFrameAccessor::GetImage
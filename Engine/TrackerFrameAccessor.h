@@ -28,6 +28,8 @@
 
 #include "Global/Macros.h"
 
+#include <set>
+
 #if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
 #include <boost/scoped_ptr.hpp>
 #endif
@@ -54,6 +56,20 @@ public:
 
     void getEnabledChannels(bool* r, bool* g, bool* b) const;
 
+    /**
+     * @brief Renders the given region (in pixels at full scale) of the input at the given frame and converts it once
+     * to the grayscale image LibMV tracks on. GetImage() then copies the regions of this frame it contains
+     * out of this image, instead of rendering and converting the region of each track separately.
+     * The image is kept until releaseSharedFramesExcept() is called without this frame.
+     * Returns false if the input could not be rendered.
+     **/
+    bool cacheSharedFrame(int frame, const RectI& roi);
+
+    /**
+     * @brief Releases the images cached by cacheSharedFrame(), except those of the given frames.
+     **/
+    void releaseSharedFramesExcept(const std::set<int>& framesToKeep);
+
 
     // Get a possibly-filtered version of a frame of a video. Downscale will
     // cause the input image to get downscaled by 2^downscale for pyramid access.
@@ -32,11 +32,13 @@
 
 #include <string>
 #include <list>
+#include <vector>
 #include <cstddef>
 
 #include "Global/Enums.h"
 
 #include "Engine/BufferableObject.h"
+#include "Engine/PixelBufferRing.h"
 #include "Engine/RectD.h"
 #include "Engine/RectI.h"
 #include "Engine/TextureRect.h"
@@ -58,12 +60,17 @@ public:
         // use a shared_ptr here, so that the cache entry is never released before the end of updateViewer()
         FrameEntryPtr cachedData;
         bool isCached;
-        unsigned char* ramBuffer; // a pointer to the RAM buffer held either by the cached frame or allocated by malloc()
+        unsigned char* ramBuffer; // a pointer to the RAM buffer held either by the cached frame, a mapped pixel buffer or allocated by malloc()
         std::size_t bytesCount; // number of bytes in the texture
+        int pixelBufferIndex; // if not -1, ramBuffer is the memory of this buffer of the UpdateViewerParams::pixelBuffers ring
+        // If true, cachedData holds compressed pixels: ramBuffer is NULL until updateViewer() decompresses them in ownedBuffer
+        bool compressed;
+        // If set, ramBuffer points to this buffer instead of the cached frame data, @see FrameEntry::compress()
+        boost::shared_ptr<std::vector<unsigned char> > ownedBuffer;
 
 
         CachedTile()
-            : rect(), rectRounded(), cachedData(), isCached(false), ramBuffer(0), bytesCount(0) {}
+            : rect(), rectRounded(), cachedData(), isCached(false), ramBuffer(0), bytesCount(0), pixelBufferIndex(-1), compressed(false), ownedBuffer() {}
     };
 
     UpdateViewerParams()
@@ -82,6 +89,7 @@ public:
         , alphaLayer()
         , alphaChannelName()
         , tiles()
+        , pixelBuffers()
         , tileSize(0)
         , nbCachedTile(0)
         , colorImage()
@@ -100,7 +108,14 @@ public:
     {
         if (mustFreeRamBuffer) {
             assert(tiles.size() == 1);
-            free(tiles.front().ramBuffer);
+            CachedTile& tile = tiles.front();
+            if (tile.pixelBufferIndex != -1) {
+                // Never uploaded (e.g: the render was aborted), give the buffer back to the ring
+                assert(pixelBuffers);
+                pixelBuffers->releaseBuffer(tile.pixelBufferIndex);
+            } else {
+                free(tile.ramBuffer);
+            }
         }
     }
 
@@ -130,6 +145,7 @@ public:
     ImagePlaneDesc alphaLayer; // the alpha layer
     std::string alphaChannelName; // the alpha channel name
     std::list<CachedTile> tiles;
+    PixelBufferRingPtr pixelBuffers; // the ring holding the buffer of a tile with a pixelBufferIndex
     int tileSize;
     int nbCachedTile;
 
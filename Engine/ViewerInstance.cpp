@@ -30,7 +30,6 @@
 #include <stdexcept>
 #include <cassert>
 #include <cstring> // for std::memcpy
-#include <cfloat> // DBL_MAX
 
 #include <boost/shared_ptr.hpp>
 #include <boost/scoped_ptr.hpp>
@@ -47,6 +46,7 @@ CLANG_DIAG_OFF(deprecated)
 #include <QtCore/QMutex>
 #include <QtCore/QWaitCondition>
 #include <QtCore/QCoreApplication>
+#include <QtCore/QDebug>
 #include <QtCore/QThreadPool>
 CLANG_DIAG_ON(deprecated)
 
@@ -54,6 +54,7 @@ CLANG_DIAG_ON(deprecated)
 #include "Engine/AppManager.h"
 #include "Engine/Cache.h"
 #include "Engine/Image.h"
+#include "Engine/ImageStatistics.h"
 #include "Engine/Log.h"
 #include "Engine/Lut.h"
 #include "Engine/MemoryFile.h"
@@ -62,6 +63,7 @@ CLANG_DIAG_ON(deprecated)
 #include "Engine/OfxEffectInstance.h"
 #include "Engine/OpenGLViewerI.h"
 #include "Engine/OutputSchedulerThread.h"
+#include "Engine/PixelBufferRing.h"
 #include "Engine/Project.h"
 #include "Engine/RenderStats.h"
 #include "Engine/RotoContext.h"
@@ -86,26 +88,6 @@ NATRON_NAMESPACE_ENTER
 using std::make_pair;
 using boost::shared_ptr;
 
-NATRON_NAMESPACE_ANONYMOUS_ENTER
-
-struct MinMaxVal {
-    MinMaxVal(double min_, double max_)
-    : min(min_)
-    , max(max_)
-    {
-    }
-    MinMaxVal()
-    : min(DBL_MAX)
-    , max(-DBL_MAX)
-    {
-    }
-
-    double min;
-    double max;
-};
-
-NATRON_NAMESPACE_ANONYMOUS_EXIT
-
 static void scaleToTexture8bits(const RectI& roi,
                                 const RenderViewerArgs & args,
                                 ViewerInstance* viewer,
@@ -115,13 +97,12 @@ static void scaleToTexture32bits(const RectI& roi,
                                  const RenderViewerArgs & args,
                                  const UpdateViewerParams::CachedTile& tile,
                                  float *output);
-static MinMaxVal findAutoContrastVminVmax(const ImagePtr inputImage,
-                                                         DisplayChannelsEnum channels,
-                                                         const RectI & rect);
 static void renderFunctor(const RectI& roi,
                           const RenderViewerArgs & args,
                           ViewerInstance* viewer,
                           UpdateViewerParams::CachedTile tile);
+static void compressTileFunctor(UpdateViewerParams::CachedTile& tile);
+static void decompressTileFunctor(UpdateViewerParams::CachedTile& tile);
 
 /**
  *@brief Actually converting to ARGB... but it is called BGRA by
@@ -1144,8 +1125,13 @@ ViewerInstance::getViewerRoIAndTexture(const RectD& rod,
                 // The data will be valid as long as the cachedFrame shared pointer use_count is gt 1
                 it->cachedData = foundCachedEntry;
                 it->isCached = true;
-                it->ramBuffer = foundCachedEntry->data();
-                assert(it->ramBuffer);
+                if ( foundCachedEntry->isCompressed() ) {
+                    // The pixels are decompressed on the main thread right before the upload, @see ViewerInstancePrivate::updateViewer
+                    it->compressed = true;
+                } else {
+                    it->ramBuffer = foundCachedEntry->data();
+                    assert(it->ramBuffer);
+                }
                 ++outArgs->params->nbCachedTile;
             }
         }
@@ -1394,7 +1380,7 @@ ViewerInstance::renderViewer_internal(ViewIdx view,
         RectI tilesBbox;
         bool tilesBboxSet = false;
         for (std::list<UpdateViewerParams::CachedTile>::const_iterator it = inArgs.params->tiles.begin(); it != inArgs.params->tiles.end(); ++it) {
-            if (it->ramBuffer) {
+            if (it->ramBuffer || it->compressed) {
                 continue;
             }
             if (!tilesBboxSet) {
@@ -1749,7 +1735,19 @@ ViewerInstance::renderViewer_internal(ViewIdx view,
                 assert(updateParams->tiles.size() == 1);
 
                 updateParams->mustFreeRamBuffer = true;
-                tile.ramBuffer =  (unsigned char*)malloc(tile.bytesCount);
+
+                // Prefer rendering directly in a mapped pixel buffer of the viewer, which saves a copy
+                // on the main thread when uploading the texture
+                PixelBufferRingPtr pixelBuffers = _imp->uiContext->getPixelBufferRing();
+                if (pixelBuffers) {
+                    tile.ramBuffer = pixelBuffers->acquireBuffer(tile.bytesCount, &tile.pixelBufferIndex);
+                    if (tile.ramBuffer) {
+                        updateParams->pixelBuffers = pixelBuffers;
+                    }
+                }
+                if (!tile.ramBuffer) {
+                    tile.ramBuffer =  (unsigned char*)malloc(tile.bytesCount);
+                }
                 unCachedTiles.push_back(tile);
             }
         } else { // useTextureCache
@@ -1775,7 +1773,7 @@ ViewerInstance::renderViewer_internal(ViewIdx view,
             std::string inputToRenderName = inArgs.activeInputToRender->getNode()->getScriptName_mt_safe();
             for (std::list<UpdateViewerParams::CachedTile>::iterator it = updateParams->tiles.begin(); it != updateParams->tiles.end(); ++it) {
                 if (it->isCached) {
-                    assert(it->ramBuffer);
+                    assert(it->ramBuffer || it->compressed);
                 } else {
                     assert(!it->ramBuffer);
 
@@ -1815,7 +1813,11 @@ ViewerInstance::renderViewer_internal(ViewIdx view,
                     } else {
                         // If the tile is cached and we got it that means rendering is done
                         entryLocker.lock(it->cachedData);
-                        it->ramBuffer = it->cachedData->data();
+                        if ( it->cachedData->isCompressed() ) {
+                            it->compressed = true;
+                        } else {
+                            it->ramBuffer = it->cachedData->data();
+                        }
                         it->isCached = true;
                         continue;
                     }
@@ -1863,9 +1865,8 @@ ViewerInstance::renderViewer_internal(ViewIdx view,
         if (singleThreaded) {
             if (inArgs.autoContrast && !inArgs.isDoingPartialUpdates) {
                 double vmin, vmax;
-                MinMaxVal vMinMax = findAutoContrastVminVmax(colorImage, inArgs.channels, viewerRenderRoI);
-                vmin = vMinMax.min;
-                vmax = vMinMax.max;
+                ImageStatisticsConstPtr imageStats = ImageStatistics::compute(colorImage, viewerRenderRoI, 0, 0., 0., false);
+                imageStats->getDisplayRange(inArgs.channels, &vmin, &vmax);
 
                 ///if vmax - vmin is greater than 1 the gain will be really small and we won't see
                 ///anything in the image
@@ -1905,31 +1906,10 @@ ViewerInstance::renderViewer_internal(ViewIdx view,
 
             ///if autoContrast is enabled, find out the vmin/vmax before rendering and mapping against new values
             if (inArgs.autoContrast && !inArgs.isDoingPartialUpdates) {
-                double vmin = std::numeric_limits<double>::infinity();
-                double vmax = -std::numeric_limits<double>::infinity();
-
-                if (runInCurrentThread) {
-                    MinMaxVal vMinMax = findAutoContrastVminVmax(colorImage, inArgs.channels, viewerRenderRoI);
-                    vmin = vMinMax.min;
-                    vmax = vMinMax.max;
-                } else {
-                    std::vector<RectI> splitRects = viewerRenderRoI.splitIntoSmallerRects( appPTR->getMaxThreadCount() );
-                    QFuture<MinMaxVal> future = QtConcurrent::mapped( splitRects,
-                                                                                       boost::bind(findAutoContrastVminVmax,
-                                                                                                   colorImage,
-                                                                                                   inArgs.channels,
-                                                                                                   _1) );
-                    future.waitForFinished();
-                    QList<MinMaxVal> results = future.results();
-                    Q_FOREACH (const MinMaxVal &vMinMax, results) {
-                        if (vMinMax.min < vmin) {
-                            vmin = vMinMax.min;
-                        }
-                        if (vMinMax.max > vmax) {
-                            vmax = vMinMax.max;
-                        }
-                    }
-                } // runInCurrentThread
+                // the statistics are shared with the Histogram panel and cached per image
+                double vmin, vmax;
+                ImageStatisticsConstPtr imageStats = ImageStatistics::compute(colorImage, viewerRenderRoI, 0, 0., 0., !runInCurrentThread);
+                imageStats->getDisplayRange(inArgs.channels, &vmin, &vmax);
 
                 if (vmax == vmin) {
                     vmin = vmax - 1.;
@@ -1979,6 +1959,27 @@ ViewerInstance::renderViewer_internal(ViewIdx view,
             }
         } // if (singleThreaded)
 
+        // The pixels are written, the pixel buffers may be destroyed from now on
+        if (updateParams->pixelBuffers) {
+            for (std::list<UpdateViewerParams::CachedTile>::iterator it = updateParams->tiles.begin(); it != updateParams->tiles.end(); ++it) {
+                if (it->pixelBufferIndex != -1) {
+                    updateParams->pixelBuffers->finishWriting(it->pixelBufferIndex);
+                }
+            }
+        }
+
+        // Now that the tiles are rendered, compress them in the cache while they are still locked
+        if ( useTextureCache && appPTR->getCurrentSettings()->isViewerCacheCompressionEnabled() ) {
+            bool runInCurrentThread = singleThreaded || QThreadPool::globalInstance()->activeThreadCount() >= QThreadPool::globalInstance()->maxThreadCount();
+            if (runInCurrentThread) {
+                for (std::list<UpdateViewerParams::CachedTile>::iterator it = updateParams->tiles.begin(); it != updateParams->tiles.end(); ++it) {
+                    compressTileFunctor(*it);
+                }
+            } else {
+                QtConcurrent::map(updateParams->tiles, &compressTileFunctor).waitForFinished();
+            }
+        }
+
 
         if ( colorImage && stats && stats->isInDepthProfilingEnabled() ) {
             stats->addRenderInfosForNode( getNode(), NodePtr(), colorImage->getComponents().getChannelsLabel(), viewerRenderRoI, viewerRenderTimeRecorder->getTimeSinceCreation() );
@@ -2029,6 +2030,45 @@ ViewerInstance::updateViewer(UpdateViewerParamsPtr & frame)
     _imp->updateViewer( boost::dynamic_pointer_cast<UpdateViewerParams>(frame) );
 }
 
+void
+compressTileFunctor(UpdateViewerParams::CachedTile& tile)
+{
+    if ( tile.isCached || tile.compressed || !tile.cachedData || !tile.ramBuffer ) {
+        return;
+    }
+    assert( tile.ramBuffer == tile.cachedData->data() );
+
+    // Once compressed the cached data can no longer be uploaded, keep a copy of the pixels for the upload of this frame
+    boost::shared_ptr<std::vector<unsigned char> > pixels = boost::make_shared<std::vector<unsigned char> >(tile.ramBuffer, tile.ramBuffer + tile.bytesCount);
+    std::size_t compressedSize = tile.cachedData->compress();
+    if (compressedSize == 0) {
+        return;
+    }
+    tile.ownedBuffer = pixels;
+    tile.ramBuffer = &pixels->front();
+    appPTR->reportViewerCacheTileCompressed(tile.cachedData->getSizeInBytesFromParams(), compressedSize);
+}
+
+void
+decompressTileFunctor(UpdateViewerParams::CachedTile& tile)
+{
+    if (!tile.compressed || tile.ramBuffer) {
+        return;
+    }
+    assert(tile.cachedData);
+    std::size_t rawSize = tile.cachedData->getSizeInBytesFromParams();
+    assert(tile.bytesCount <= rawSize);
+    boost::shared_ptr<std::vector<unsigned char> > pixels = boost::make_shared<std::vector<unsigned char> >(rawSize);
+    if ( !tile.cachedData->decompress(&pixels->front(), rawSize) ) {
+        // The tile is not uploaded
+        qDebug() << "Failed to decompress a viewer cache entry";
+
+        return;
+    }
+    tile.ownedBuffer = pixels;
+    tile.ramBuffer = &pixels->front();
+}
+
 void
 renderFunctor(const RectI& roi,
               const RenderViewerArgs & args,
@@ -2044,124 +2084,6 @@ renderFunctor(const RectI& roi,
     }
 }
 
-inline
-MinMaxVal
-findAutoContrastVminVmax_generic(const ImagePtr inputImage,
-                                 int nComps,
-                                 DisplayChannelsEnum channels,
-                                 const RectI & rect)
-{
-    double localVmin = std::numeric_limits<double>::infinity();
-    double localVmax = -std::numeric_limits<double>::infinity();
-    Image::ReadAccess acc = inputImage->getReadRights();
-
-    for (int y = rect.bottom(); y < rect.top(); ++y) {
-        const float* src_pixels = (const float*)acc.pixelAt(rect.left(), y);
-        ///we fill the scan-line with all the pixels of the input image
-        for (int x = rect.left(); x < rect.right(); ++x) {
-            double r = 0.;
-            double g = 0.;
-            double b = 0.;
-            double a = 0.;
-            switch (nComps) {
-            case 4:
-                r = src_pixels[0];
-                g = src_pixels[1];
-                b = src_pixels[2];
-                a = src_pixels[3];
-                break;
-            case 3:
-                r = src_pixels[0];
-                g = src_pixels[1];
-                b = src_pixels[2];
-                a = 1.;
-                break;
-            case 2:
-                r = src_pixels[0];
-                g = src_pixels[1];
-                b = 0.;
-                a = 1.;
-                break;
-            case 1:
-                a = src_pixels[0];
-                r = g = b = 0.;
-                break;
-            default:
-                r = g = b = a = 0.;
-            }
-
-            double mini, maxi;
-            switch (channels) {
-            case eDisplayChannelsRGB:
-                mini = std::min(std::min(r, g), b);
-                maxi = std::max(std::max(r, g), b);
-                break;
-            case eDisplayChannelsY:
-                mini = r = 0.299 * r + 0.587 * g + 0.114 * b;
-                maxi = mini;
-                break;
-            case eDisplayChannelsR:
-                mini = r;
-                maxi = mini;
-                break;
-            case eDisplayChannelsG:
-                mini = g;
-                maxi = mini;
-                break;
-            case eDisplayChannelsB:
-                mini = b;
-                maxi = mini;
-                break;
-            case eDisplayChannelsA:
-                mini = a;
-                maxi = mini;
-                break;
-            default:
-                mini = 0.;
-                maxi = 0.;
-                break;
-            }
-            if (mini < localVmin) {
-                localVmin = mini;
-            }
-            if (maxi > localVmax) {
-                localVmax = maxi;
-            }
-
-            src_pixels += nComps;
-        }
-    }
-
-    return MinMaxVal(localVmin, localVmax);
-} // findAutoContrastVminVmax_generic
-
-template <int nComps>
-MinMaxVal
-findAutoContrastVminVmax_internal(const ImagePtr inputImage,
-                                  DisplayChannelsEnum channels,
-                                  const RectI & rect)
-{
-    return findAutoContrastVminVmax_generic(inputImage, nComps, channels, rect);
-}
-
-MinMaxVal
-findAutoContrastVminVmax(const ImagePtr inputImage,
-                         DisplayChannelsEnum channels,
-                         const RectI & rect)
-{
-    int nComps = inputImage->getComponents().getNumComponents();
-
-    if (nComps == 4) {
-        return findAutoContrastVminVmax_internal<4>(inputImage, channels, rect);
-    } else if (nComps == 3) {
-        return findAutoContrastVminVmax_internal<3>(inputImage, channels, rect);
-    } else if (nComps == 1) {
-        return findAutoContrastVminVmax_internal<1>(inputImage, channels, rect);
-    } else {
-        return findAutoContrastVminVmax_generic(inputImage, nComps, channels, rect);
-    }
-} // findAutoContrastVminVmax
-
 template <typename PIX, int maxValue, bool opaque, bool applyMatte, int rOffset, int gOffset, int bOffset>
 void
 scaleToTexture8bits_generic(const RectI& roi,
@@ -2932,6 +2854,26 @@ ViewerInstance::ViewerInstancePrivate::updateViewer(UpdateViewerParamsPtr params
 
         assert( (params->isPartialRect && params->tiles.size() == 1) || !params->isPartialRect );
 
+        // Decompress the tiles stored compressed in the viewer cache, one tile per thread
+        int nCompressedTiles = 0;
+        for (std::list<UpdateViewerParams::CachedTile>::const_iterator it = params->tiles.begin(); it != params->tiles.end(); ++it) {
+            if (it->compressed && !it->ramBuffer) {
+                ++nCompressedTiles;
+            }
+        }
+        if (nCompressedTiles > 0) {
+            TimeLapse decompressionTimer;
+            bool runInCurrentThread = nCompressedTiles == 1 || QThreadPool::globalInstance()->activeThreadCount() >= QThreadPool::globalInstance()->maxThreadCount();
+            if (runInCurrentThread) {
+                for (std::list<UpdateViewerParams::CachedTile>::iterator it = params->tiles.begin(); it != params->tiles.end(); ++it) {
+                    decompressTileFunctor(*it);
+                }
+            } else {
+                QtConcurrent::map(params->tiles, &decompressTileFunctor).waitForFinished();
+            }
+            appPTR->reportViewerCacheTilesDecompressed( nCompressedTiles, decompressionTimer.getTimeSinceCreation() );
+        }
+
         TexturePtr texture;
         bool isFirstTile = true;
         for (std::list<UpdateViewerParams::CachedTile>::iterator it = params->tiles.begin(); it != params->tiles.end(); ++it) {
@@ -2948,8 +2890,13 @@ ViewerInstance::ViewerInstancePrivate::updateViewer(UpdateViewerParamsPtr params
             texRect.set(it->rectRounded);
     
             assert(params->roi.contains(texRect));
-            uiContext->transferBufferFromRAMtoGPU(it->ramBuffer, it->bytesCount, params->roi, params->roiNotRoundedToTileSize, texRect, params->textureIndex, params->isPartialRect, isFirstTile, &texture);
+            uiContext->transferBufferFromRAMtoGPU(it->ramBuffer, it->bytesCount, params->roi, params->roiNotRoundedToTileSize, texRect, params->textureIndex, params->isPartialRect, isFirstTile, it->pixelBufferIndex, &texture);
             isFirstTile = false;
+            if (it->pixelBufferIndex != -1) {
+                // The pixel buffer was handed back to the ring by the upload, its memory is no longer ours
+                it->pixelBufferIndex = -1;
+                it->ramBuffer = 0;
+            }
         }
 
 
@@ -3539,9 +3486,10 @@ void
 ViewerInstance::reportStats(int time,
                             ViewIdx view,
                             double wallTime,
+                            const RamBufferPoolStats& bufferPoolStats,
                             const RenderStatsMap& stats)
 {
-    Q_EMIT renderStatsAvailable(time, view, wallTime, stats);
+    Q_EMIT renderStatsAvailable(time, view, wallTime, bufferPoolStats, stats);
 }
 
 NATRON_NAMESPACE_EXIT
@@ -320,7 +320,7 @@ public:
     void setDoingPartialUpdates(bool doing);
     bool isDoingPartialUpdates() const;
 
-    virtual void reportStats(int time, ViewIdx view, double wallTime, const RenderStatsMap& stats) OVERRIDE FINAL;
+    virtual void reportStats(int time, ViewIdx view, double wallTime, const RamBufferPoolStats& bufferPoolStats, const RenderStatsMap& stats) OVERRIDE FINAL;
 
     ///Only callable on MT
     void setActivateInputChangeRequestedFromViewer(bool fromViewer);
@@ -352,7 +352,7 @@ public Q_SLOTS:
 
 Q_SIGNALS:
 
-    void renderStatsAvailable(int time, ViewIdx view, double wallTime, const RenderStatsMap& stats);
+    void renderStatsAvailable(int time, ViewIdx view, double wallTime, const RamBufferPoolStats& bufferPoolStats, const RenderStatsMap& stats);
 
     void s_callRedrawOnMainThread();
 
@@ -106,8 +106,19 @@ typedef OfxRangeD RangeD;
 
 #define kBgProcessServerCreatedShort "--bg_server_created"
 
+///these are used between the coordinator and the worker processes of a render split with --workers
+#define kRenderWorkerNextChunkShort "-n"
+
+#define kRenderWorkerChunkShort "-k"
+
+#define kRenderWorkerNoMoreWorkShort "-q"
+
+#define kRenderWorkerChunkDoneShort "-d"
+
+#define kRenderWorkerChunkFailedShort "-f"
+
 //Increment this to wipe all disk cache structure and ensure that the user has a clean cache when starting the next version of Natron
-#define NATRON_CACHE_VERSION 4
+#define NATRON_CACHE_VERSION 5
 #define kNatronCacheVersionSettingsKey "NatronCacheVersionSettingsKey"
 
 
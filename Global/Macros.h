@@ -84,12 +84,14 @@ namespace NATRON_PYTHON_NAMESPACE { }
 
 // The MIME types for Natron documents are:
 // *.ntp: application/vnd.natron.project
+// *.ntpb: application/vnd.natron.project (binary project, see ProjectBinarySerialization.h)
 // *.nps: application/vnd.natron.nodepresets
 // *.nl: application/vnd.natron.layout
 // these MIME types are also used in:
 // - NatronInfo.plist (for OSX)
 // - tools/linux/include/qs/natron.qs
 #define NATRON_PROJECT_FILE_EXT "ntp"
+#define NATRON_PROJECT_BINARY_FILE_EXT "ntpb"
 #define NATRON_PROJECT_FILE_MIME_TYPE "application/vnd.natron.project"
 #define NATRON_PROJECT_UNTITLED "Untitled." NATRON_PROJECT_FILE_EXT
 #define NATRON_CACHE_FILE_EXT "ntc"
@@ -235,6 +235,17 @@ CurveGui::nextPointForSegment(const double x, // < in curve coordinates
 
 } // nextPointForSegment
 
+void
+CurveGui::evaluateN(bool useExpr,
+                    const double* x,
+                    double* y,
+                    int n) const
+{
+    for (int i = 0; i < n; ++i) {
+        y[i] = evaluate(useExpr, x[i]);
+    }
+}
+
 Curve::YRange
 CurveGui::getCurveYRange() const
 {
@@ -344,27 +355,48 @@ CurveGui::drawCurve(int curveIndex,
             KeyFrame x1Key;
             KeyFrameSet::const_iterator lastUpperIt = keyframes.end();
 
+            // The abscissae do not depend on the curve values: collect them all first,
+            // then evaluate the points that are not keyframes in a single batch.
+            std::vector<double> xs, ys;
+            std::vector<char> isKey;
+
             while ( x1 < (widgetWidth - 1) ) {
-                double x, y;
+                double x, y = 0.;
                 if (!isX1AKey) {
                     x = _curveWidget->toZoomCoordinates(x1, 0).x();
-                    y = evaluate(false, x);
                 } else {
                     x = x1Key.getTime();
                     y = x1Key.getValue();
                 }
 
-                vertices.push_back( (float)x );
-                vertices.push_back( (float)y );
+                xs.push_back(x);
+                ys.push_back(y);
+                isKey.push_back(isX1AKey);
                 nextPointForSegment(x, keyframes, isPeriodic, parametricRange.first, parametricRange.second,  &lastUpperIt, &x2, &x1Key, &isX1AKey);
                 x1 = x2;
             }
             //also add the last point
-            {
-                double x = _curveWidget->toZoomCoordinates(x1, 0).x();
-                double y = evaluate(false, x);
-                vertices.push_back( (float)x );
-                vertices.push_back( (float)y );
+            xs.push_back( _curveWidget->toZoomCoordinates(x1, 0).x() );
+            ys.push_back(0.);
+            isKey.push_back(false);
+
+            std::vector<double> evalX, evalY;
+            evalX.reserve( xs.size() );
+            for (std::size_t i = 0; i < xs.size(); ++i) {
+                if (!isKey[i]) {
+                    evalX.push_back(xs[i]);
+                }
+            }
+            evalY.resize( evalX.size() );
+            if ( !evalX.empty() ) {
+                evaluateN(false, &evalX[0], &evalY[0], (int)evalX.size());
+            }
+
+            vertices.reserve(xs.size() * 2);
+            std::size_t evalIndex = 0;
+            for (std::size_t i = 0; i < xs.size(); ++i) {
+                vertices.push_back( (float)xs[i] );
+                vertices.push_back( (float)(isKey[i] ? ys[i] : evalY[evalIndex++]) );
             }
         } catch (...) {
         }
@@ -676,6 +708,26 @@ KnobCurveGui::evaluate(bool useExpr,
     }
 }
 
+void
+KnobCurveGui::evaluateN(bool useExpr,
+                        const double* x,
+                        double* y,
+                        int n) const
+{
+    KnobIPtr knob = getInternalKnob();
+
+    KnobParametric* isParametric = dynamic_cast<KnobParametric*>( knob.get() );
+    if (isParametric) {
+        isParametric->getParametricCurve(_dimension)->getValuesAt(x, y, n, false);
+    } else if (useExpr) {
+        CurveGui::evaluateN(useExpr, x, y, n);
+    } else {
+        assert(_internalCurve);
+
+        _internalCurve->getValuesAt(x, y, n, false);
+    }
+}
+
 CurvePtr
 KnobCurveGui::getInternalCurve() const
 {
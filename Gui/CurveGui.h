@@ -122,6 +122,11 @@ public:
      * The coordinates are those of the curve, not of the widget.
      **/
     virtual double evaluate(bool useExpr, double x) const = 0;
+
+    /**
+     * @brief Same as evaluate() for n abscissae at once.
+     **/
+    virtual void evaluateN(bool useExpr, const double* x, double* y, int n) const;
     virtual CurvePtr  getInternalCurve() const;
 
     void drawCurve(int curveIndex, int curvesCount);
@@ -201,6 +206,7 @@ public:
     }
 
     virtual double evaluate(bool useExpr, double x) const OVERRIDE FINAL WARN_UNUSED_RETURN;
+    virtual void evaluateN(bool useExpr, const double* x, double* y, int n) const OVERRIDE FINAL;
     RotoContextPtr getRotoContext() const { return _roto; }
 
     KnobIPtr getInternalKnob() const;
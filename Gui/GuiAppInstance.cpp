@@ -43,6 +43,7 @@
 #include "Engine/NodeSerialization.h"
 #include "Engine/Plugin.h"
 #include "Engine/ProcessHandler.h"
+#include "Engine/ProjectAutoSaveJournal.h"
 #include "Engine/Settings.h"
 #include "Engine/DiskCacheNode.h"
 #include "Engine/KnobFile.h"
@@ -388,7 +389,7 @@ GuiAppInstance::loadInternal(const CLArgs& cl,
             ///If this is a Python script, execute it
             loadPythonScript(info);
             execOnProjectCreatedCallback();
-        } else if ( info.suffix() == QString::fromUtf8(NATRON_PROJECT_FILE_EXT) ) {
+        } else if ( ( info.suffix() == QString::fromUtf8(NATRON_PROJECT_FILE_EXT) ) || ( info.suffix() == QString::fromUtf8(NATRON_PROJECT_BINARY_FILE_EXT) ) ) {
             ///Otherwise just load the project specified.
             QString name = info.fileName();
             QString path = info.path();
@@ -429,7 +430,8 @@ GuiAppInstance::findAndTryLoadUntitledAutoSave()
         searchStr.append( QString::fromUtf8(NATRON_PROJECT_FILE_EXT) );
         searchStr.append( QString::fromUtf8(".autosave") );
         int suffixPos = entry.indexOf(searchStr);
-        if ( (suffixPos == -1) || entry.contains( QString::fromUtf8("RENDER_SAVE") ) ) {
+        if ( (suffixPos == -1) || entry.contains( QString::fromUtf8("RENDER_SAVE") ) ||
+             ProjectAutoSaveJournal::isJournalFilePath( entry.toStdString() ) ) {
             continue;
         }
 
@@ -1241,7 +1243,7 @@ GuiAppInstance::handleFileOpenEvent(const std::string &filename)
 
     fileCopy.replace( QLatin1Char('\\'), QLatin1Char('/') );
     QString ext = QtCompat::removeFileExtension(fileCopy);
-    if ( ext == QString::fromUtf8(NATRON_PROJECT_FILE_EXT) ) {
+    if ( ( ext == QString::fromUtf8(NATRON_PROJECT_FILE_EXT) ) || ( ext == QString::fromUtf8(NATRON_PROJECT_BINARY_FILE_EXT) ) ) {
         AppInstancePtr app = getGui()->openProject(filename);
         if (!app) {
             Dialogs::errorDialog(tr("Project").toStdString(), tr("Failed to open project").toStdString() + ' ' + filename);
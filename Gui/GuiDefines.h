@@ -41,6 +41,10 @@
 
 #define NATRON_PREVIEW_WIDTH 64
 #define NATRON_PREVIEW_HEIGHT 38
+// Fraction of the time the preview thread may spend rendering, it sleeps the rest of the time
+#define NATRON_PREVIEW_CPU_BUDGET 0.25
+// Interval in milliseconds at which the preview thread checks whether the viewers are done rendering
+#define NATRON_PREVIEW_VIEWER_POLL_INTERVAL_MS 50
 
 #define NODE_WIDTH 80
 #define NODE_HEIGHT 30
@@ -264,6 +264,10 @@ NodeGraph::updateCacheSizeText()
     quint64 diskSize = appPTR->getCachesTotalDiskSize();
     QString diskCacheSizeStr = QDirModelPrivate_size(diskSize);
     QString newText = tr("Memory cache: %1 / Disk cache: %2").arg(cacheSizeStr).arg(diskCacheSizeStr);
+    double compressionRatio, decompressionTimePerTile;
+    if ( appPTR->getViewerCacheCompressionStats(&compressionRatio, &decompressionTimePerTile) ) {
+        newText += tr(" / Playback cache compression: %1:1 (%2 ms/tile)").arg(compressionRatio, 0, 'f', 1).arg(decompressionTimePerTile, 0, 'f', 2);
+    }
     if (newText != oldText) {
         _imp->_cacheSizeText->setText(newText);
     }
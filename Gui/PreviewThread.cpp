@@ -26,6 +26,7 @@
 #include "PreviewThread.h"
 
 #include <list>
+#include <map>
 #include <vector>
 #include <stdexcept>
 #include <cstring> // for std::memcpy, std::memset
@@ -36,7 +37,12 @@
 #include "Gui/GuiDefines.h"
 #include "Gui/NodeGui.h"
 
+#include "Engine/AppInstance.h"
 #include "Engine/Node.h"
+#include "Engine/OutputSchedulerThread.h"
+#include "Engine/Project.h"
+#include "Engine/Timer.h"
+#include "Engine/ViewerInstance.h"
 
 
 NATRON_NAMESPACE_ENTER
@@ -46,12 +52,10 @@ class ComputePreviewRequest
 {
 public:
 
-    double time;
     NodeGuiWPtr node;
 
     ComputePreviewRequest()
         : GenericThreadStartArgs()
-        , time(0)
         , node()
     {}
 
@@ -62,12 +66,19 @@ public:
 
 typedef boost::shared_ptr<ComputePreviewRequest> ComputePreviewRequestPtr;
 
+// The time of the preview to render for each node that has a request in the queue
+typedef std::map<NodeGuiWPtr, double> PendingPreviewsMap;
+
 struct PreviewThreadPrivate
 {
     std::vector<unsigned int> data;
+    mutable QMutex pendingPreviewsMutex;
+    PendingPreviewsMap pendingPreviews;
 
     PreviewThreadPrivate()
         : data( NATRON_PREVIEW_HEIGHT * NATRON_PREVIEW_WIDTH * sizeof(unsigned int) )
+        , pendingPreviewsMutex()
+        , pendingPreviews()
     {
     }
 };
@@ -89,11 +100,58 @@ void
 PreviewThread::appendToQueue(const NodeGuiPtr& node,
                              double time)
 {
-    ComputePreviewRequestPtr r = boost::make_shared<ComputePreviewRequest>();
+    {
+        QMutexLocker k(&_imp->pendingPreviewsMutex);
+        std::pair<PendingPreviewsMap::iterator, bool> inserted = _imp->pendingPreviews.insert( std::make_pair(NodeGuiWPtr(node), time) );
+        if (!inserted.second) {
+            // A preview of this node is already in the queue: it will be rendered at the latest time requested
+            inserted.first->second = time;
+
+            return;
+        }
+    }
 
+    ComputePreviewRequestPtr r = boost::make_shared<ComputePreviewRequest>();
     r->node = node;
-    r->time = time;
-    startTask(r);
+    if ( !startTask(r) ) {
+        QMutexLocker k(&_imp->pendingPreviewsMutex);
+        _imp->pendingPreviews.erase(node);
+    }
+}
+
+bool
+PreviewThread::isViewerRendering(const NodePtr& node)
+{
+    AppInstancePtr app = node->getApp();
+
+    if (!app) {
+        return false;
+    }
+    std::list<ViewerInstance*> viewers;
+    app->getProject()->getViewers(&viewers);
+    for (std::list<ViewerInstance*>::iterator it = viewers.begin(); it != viewers.end(); ++it) {
+        RenderEnginePtr engine = (*it)->getRenderEngine();
+        if ( engine && engine->hasThreadsWorking() ) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool
+PreviewThread::sleepUnlessQuit(double seconds)
+{
+    TimeLapse timer;
+
+    while ( timer.getTimeSinceCreation() < seconds ) {
+        if ( mustQuitThread() ) {
+            return false;
+        }
+        QThread::msleep(NATRON_PREVIEW_VIEWER_POLL_INTERVAL_MS);
+    }
+
+    return !mustQuitThread();
 }
 
 GenericSchedulerThread::ThreadStateEnum
@@ -105,10 +163,32 @@ PreviewThread::threadLoopOnce(const GenericThreadStartArgsPtr& inArgs)
 
 
     NodeGuiPtr node = args->node.lock();
+    NodePtr internalNode = node ? node->getNode() : NodePtr();
+
+    // The viewers have priority: wait until they are done rendering. Requests for this node keep being coalesced meanwhile.
+    while ( internalNode && isViewerRendering(internalNode) ) {
+        if ( !sleepUnlessQuit(NATRON_PREVIEW_VIEWER_POLL_INTERVAL_MS / 1000.) ) {
+            return resolveState();
+        }
+    }
+
+    double time;
+    {
+        QMutexLocker k(&_imp->pendingPreviewsMutex);
+        PendingPreviewsMap::iterator found = _imp->pendingPreviews.find(args->node);
+        if ( found == _imp->pendingPreviews.end() ) {
+            return eThreadStateActive;
+        }
+        time = found->second;
+        _imp->pendingPreviews.erase(found);
+    }
+
     if (node) {
         ///Mark this thread as running
         appPTR->fetchAndAddNRunningThreads(1);
 
+        TimeLapse timer;
+
         //process the request if valid
         int w = NATRON_PREVIEW_WIDTH;
         int h = NATRON_PREVIEW_HEIGHT;
@@ -121,19 +201,23 @@ PreviewThread::threadLoopOnce(const GenericThreadStartArgsPtr& inArgs)
             _imp->data[i] = qRgba(0, 0, 0, 255);
         }
 #endif
-        NodePtr internalNode = node->getNode();
         if (internalNode) {
-            bool ok = internalNode->makePreviewImage( args->time, &w, &h, &_imp->data.front() );
+            bool ok = internalNode->makePreviewImage( time, &w, &h, &_imp->data.front() );
             Q_UNUSED(ok);
             node->copyPreviewImageBuffer(_imp->data, w, h);
         }
 
         ///Unmark this thread as running
         appPTR->fetchAndAddNRunningThreads(-1);
+
+        // Stay within the CPU budget: a preview that took t seconds to render is followed by a pause of t * (1 - budget) / budget seconds
+        double renderTime = timer.getTimeSinceCreation();
+        if ( !sleepUnlessQuit(renderTime * (1. - NATRON_PREVIEW_CPU_BUDGET) / NATRON_PREVIEW_CPU_BUDGET) ) {
+            return resolveState();
+        }
     }
 
     return eThreadStateActive;
 } // PreviewThread::threadLoopOnce
 
 NATRON_NAMESPACE_EXIT
-
@@ -43,6 +43,13 @@
 NATRON_NAMESPACE_ENTER
 
 struct PreviewThreadPrivate;
+
+/**
+ * @brief Renders the node previews in the background.
+ * Requests are coalesced per node: a node already in the queue is rendered only once, at the latest time requested.
+ * Previews are not rendered while a viewer is rendering, and the thread pauses between previews so that it spends
+ * at most NATRON_PREVIEW_CPU_BUDGET of its time rendering.
+ **/
 class PreviewThread
     : public GenericSchedulerThread
 {
@@ -55,6 +62,13 @@ public:
 
 private:
 
+    static bool isViewerRendering(const NodePtr& node);
+
+    /**
+     * @brief Sleeps for the given duration, returns false if the thread must quit.
+     **/
+    bool sleepUnlessQuit(double seconds);
+
     virtual TaskQueueBehaviorEnum tasksQueueBehaviour() const OVERRIDE FINAL WARN_UNUSED_RETURN
     {
         return eTaskQueueBehaviorProcessInOrder;
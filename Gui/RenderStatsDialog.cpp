@@ -36,6 +36,7 @@
 #include <QItemSelectionModel>
 #include <QtCore/QRegExp>
 
+#include "Engine/MemoryInfo.h" // printAsRAM
 #include "Engine/Node.h"
 #include "Engine/Timer.h"
 #include "Engine/Utils.h" // convertFromPlainText
@@ -65,8 +66,9 @@
 #define COL_NB_CACHE_HIT 13
 #define COL_NB_CACHE_HIT_DOWNSCALED 14
 #define COL_NB_CACHE_MISS 15
+#define COL_NB_COPIES_AVOIDED 16
 
-#define NUM_COLS 16
+#define NUM_COLS 17
 
 NATRON_NAMESPACE_ENTER
 
@@ -646,6 +648,39 @@ public:
                 }
             }
         }
+        {
+            TableItem* item = 0;
+            int nb = 0;
+            if (exists) {
+                item = view->item(row, COL_NB_COPIES_AVOIDED);
+                if (item) {
+                    nb = item->text().toInt();
+                }
+            } else {
+                item = new TableItem;
+                QString tt = NATRON_NAMESPACE::convertFromPlainText(tr("The number of times the node rendered directly in the cached image "
+                                                               "instead of rendering in a temporary image copied afterwards."), NATRON_NAMESPACE::WhiteSpaceNormal);
+                item->setToolTip(tt);
+                item->setFlags(Qt::ItemIsSelectable | Qt::ItemIsEnabled);
+            }
+            assert(item);
+            if (item) {
+                int nbCopiesAvoided;
+                U64 nbBytesNotCopied;
+                stats.getCopiesAvoided(&nbCopiesAvoided, &nbBytesNotCopied);
+                nb += nbCopiesAvoided;
+
+                QString str = QString::number(nb);
+                if (nodeUi) {
+                    item->setTextColor(Qt::black);
+                    item->setBackgroundColor(c);
+                }
+                item->setText(str);
+                if (!exists) {
+                    view->setItem(row, COL_NB_COPIES_AVOIDED, item);
+                }
+            }
+        }
         if (!exists) {
             rows.push_back(node);
         }
@@ -704,6 +739,9 @@ struct RenderStatsDialogPrivate
     Label* totalTimeSpentDescLabel;
     Label* totalTimeSpentValueLabel;
     double totalSpentTime;
+    Label* bufferPoolDescLabel;
+    Label* bufferPoolValueLabel;
+    RamBufferPoolStats bufferPoolStats;
     Button* resetButton;
     QWidget* filterContainer;
     QHBoxLayout* filterLayout;
@@ -730,6 +768,9 @@ struct RenderStatsDialogPrivate
         , totalTimeSpentDescLabel(0)
         , totalTimeSpentValueLabel(0)
         , totalSpentTime(0)
+        , bufferPoolDescLabel(0)
+        , bufferPoolValueLabel(0)
+        , bufferPoolStats()
         , resetButton(0)
         , filterContainer(0)
         , filterLayout(0)
@@ -747,6 +788,8 @@ struct RenderStatsDialogPrivate
 
     void editNodeRow(const NodePtr& node, const NodeRenderStats& stats);
 
+    void refreshBufferPoolLabel();
+
     void updateVisibleRowsInternal(const QString& nameFilter, const QString& pluginIDFilter);
 };
 
@@ -811,6 +854,22 @@ RenderStatsDialog::RenderStatsDialog(Gui* gui)
     _imp->globalInfosLayout->addWidget(_imp->totalTimeSpentDescLabel);
     _imp->globalInfosLayout->addWidget(_imp->totalTimeSpentValueLabel);
 
+    _imp->globalInfosLayout->addSpacing(20);
+
+    QString bufferPooltt = NATRON_NAMESPACE::convertFromPlainText(tr("The number of image buffers that were recycled from the RAM buffer pool (hits) "
+                                                             "instead of being allocated (misses) while rendering.
+"
+                                                             "The pool is shared by all renders, so concurrent renders are accounted too."
+                                                             ), NATRON_NAMESPACE::WhiteSpaceNormal);
+    _imp->bufferPoolDescLabel = new Label(tr("RAM buffer pool:"), _imp->globalInfosContainer);
+    _imp->bufferPoolDescLabel->setToolTip(bufferPooltt);
+    _imp->bufferPoolValueLabel = new Label(_imp->globalInfosContainer);
+    _imp->bufferPoolValueLabel->setToolTip(bufferPooltt);
+    _imp->refreshBufferPoolLabel();
+
+    _imp->globalInfosLayout->addWidget(_imp->bufferPoolDescLabel);
+    _imp->globalInfosLayout->addWidget(_imp->bufferPoolValueLabel);
+
     _imp->resetButton = new Button(tr("Reset"), _imp->globalInfosContainer);
     _imp->resetButton->setToolTip( tr("Clears the statistics.") );
     QObject::connect( _imp->resetButton, SIGNAL(clicked(bool)), this, SLOT(resetStats()) );
@@ -891,7 +950,8 @@ RenderStatsDialog::RenderStatsDialog(Gui* gui)
         << tr("Rendered Planes")
         << tr("Cache Hits")
         << tr("Cache Hits Higher Scale")
-        << tr("Cache Misses");
+        << tr("Cache Misses")
+        << tr("Copies Avoided");
 
     _imp->view->setColumnCount( dimensionNames.size() );
     _imp->view->setHorizontalHeaderLabels(dimensionNames);
@@ -973,22 +1033,44 @@ RenderStatsDialog::resetStats()
     _imp->model->clearRows();
     _imp->totalTimeSpentValueLabel->setText( QString::fromUtf8("0.0 sec") );
     _imp->totalSpentTime = 0;
+    _imp->bufferPoolStats = RamBufferPoolStats();
+    _imp->refreshBufferPoolLabel();
+}
+
+void
+RenderStatsDialogPrivate::refreshBufferPoolLabel()
+{
+    bufferPoolValueLabel->setText( RenderStatsDialog::tr("%1 hit(s), %2 miss(es) (%3%), %4 pooled")
+                                   .arg( (qulonglong)bufferPoolStats.nHits )
+                                   .arg( (qulonglong)bufferPoolStats.nMisses )
+                                   .arg( (int)(bufferPoolStats.getHitRate() * 100.) )
+                                   .arg( printAsRAM(bufferPoolStats.bytesPooled) ) );
 }
 
 void
 RenderStatsDialog::addStats(int /*time*/,
                             ViewIdx /*view*/,
                             double wallTime,
+                            const RamBufferPoolStats& bufferPoolStats,
                             const std::map<NodePtr, NodeRenderStats >& stats)
 {
     if ( !_imp->accumulateCheckbox->isChecked() ) {
         _imp->model->clearRows();
         _imp->totalSpentTime = 0;
+        _imp->bufferPoolStats = RamBufferPoolStats();
     }
 
     _imp->totalSpentTime += wallTime;
     _imp->totalTimeSpentValueLabel->setText( Timer::printAsTime(_imp->totalSpentTime, false) );
 
+    _imp->bufferPoolStats.nHits += bufferPoolStats.nHits;
+    _imp->bufferPoolStats.nMisses += bufferPoolStats.nMisses;
+    _imp->bufferPoolStats.nRecycled += bufferPoolStats.nRecycled;
+    _imp->bufferPoolStats.nDropped += bufferPoolStats.nDropped;
+    // Not a counter: show the latest value
+    _imp->bufferPoolStats.bytesPooled = bufferPoolStats.bytesPooled;
+    _imp->refreshBufferPoolLabel();
+
     for (std::map<NodePtr, NodeRenderStats >::const_iterator it = stats.begin(); it != stats.end(); ++it) {
         _imp->model->editNodeRow(it->first, it->second);
     }
@@ -62,7 +62,7 @@ public:
 
     virtual ~RenderStatsDialog();
 
-    void addStats(int time, ViewIdx view, double wallTime, const std::map<NodePtr, NodeRenderStats >& stats);
+    void addStats(int time, ViewIdx view, double wallTime, const RamBufferPoolStats& bufferPoolStats, const std::map<NodePtr, NodeRenderStats >& stats);
 
 public Q_SLOTS:
 
@@ -57,6 +57,7 @@ GCC_DIAG_UNUSED_PRIVATE_FIELD_ON
 #include "Engine/NodeGuiI.h"
 #include "Engine/Project.h"
 #include "Engine/OfxOverlayInteract.h"
+#include "Engine/PixelBufferRing.h"
 #include "Engine/KnobTypes.h"
 #include "Engine/Settings.h"
 #include "Engine/Timer.h" // for gettimeofday
@@ -1559,6 +1560,12 @@ ViewerGL::endTransferBufferFromRAMToGPU(int textureIndex,
     }
 } // ViewerGL::endTransferBufferFromRAMToGPU
 
+PixelBufferRingPtr
+ViewerGL::getPixelBufferRing() const
+{
+    return _imp->pixelBuffers;
+}
+
 void
 ViewerGL::transferBufferFromRAMtoGPU(const unsigned char* ramBuffer,
                                      size_t bytesCount,
@@ -1568,6 +1575,7 @@ ViewerGL::transferBufferFromRAMtoGPU(const unsigned char* ramBuffer,
                                      int textureIndex,
                                      bool isPartialRect,
                                      bool isFirstTile,
+                                     int pixelBufferIndex,
                                      TexturePtr* texture)
 {
     // always running in the main thread
@@ -1584,7 +1592,7 @@ ViewerGL::transferBufferFromRAMtoGPU(const unsigned char* ramBuffer,
     }
 
     // We use 2 PBOs to make use of asynchronous data uploading
-    GLuint pboId = getPboID(_imp->updateViewerPboIndex);
+    GLuint pboId = pixelBufferIndex == -1 ? getPboID(_imp->updateViewerPboIndex) : 0;
 
     // The bitdepth of the texture
     ImageBitDepthEnum bd = getBitDepth();
@@ -1632,31 +1640,37 @@ ViewerGL::transferBufferFromRAMtoGPU(const unsigned char* ramBuffer,
         }
     }
 
-    // bind PBO to update texture source
-    glBindBufferARB( GL_PIXEL_UNPACK_BUFFER_ARB, pboId );
-
-    // Note that glMapBufferARB() causes sync issue.
-    // If GPU is working with this buffer, glMapBufferARB() will wait(stall)
-    // until GPU to finish its job. To avoid waiting (idle), you can call
-    // first glBufferDataARB() with NULL pointer before glMapBufferARB().
-    // If you do that, the previous data in PBO will be discarded and
-    // glMapBufferARB() returns a new allocated pointer immediately
-    // even if GPU is still working with the previous data.
-    glBufferDataARB(GL_PIXEL_UNPACK_BUFFER_ARB, bytesCount, NULL, GL_DYNAMIC_DRAW_ARB);
-
-    // map the buffer object into client's memory
-    GLvoid *ret = glMapBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, GL_WRITE_ONLY_ARB);
-    glCheckError();
-    assert(ret);
-    assert(ramBuffer);
-    if (ret && ramBuffer) {
-        // update data directly on the mapped buffer
-        std::memcpy(ret, (void*)ramBuffer, bytesCount);
-        GLboolean result = glUnmapBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB); // release the mapped buffer
-        assert(result == GL_TRUE);
-        Q_UNUSED(result);
+    if (pixelBufferIndex != -1) {
+        // The render thread converted the pixels directly in the mapped pixel buffer:
+        // unmapping it and binding it is all that is left to do
+        _imp->pixelBuffers->bindForUpload(pixelBufferIndex);
+    } else {
+        // bind PBO to update texture source
+        glBindBufferARB( GL_PIXEL_UNPACK_BUFFER_ARB, pboId );
+
+        // Note that glMapBufferARB() causes sync issue.
+        // If GPU is working with this buffer, glMapBufferARB() will wait(stall)
+        // until GPU to finish its job. To avoid waiting (idle), you can call
+        // first glBufferDataARB() with NULL pointer before glMapBufferARB().
+        // If you do that, the previous data in PBO will be discarded and
+        // glMapBufferARB() returns a new allocated pointer immediately
+        // even if GPU is still working with the previous data.
+        glBufferDataARB(GL_PIXEL_UNPACK_BUFFER_ARB, bytesCount, NULL, GL_DYNAMIC_DRAW_ARB);
+
+        // map the buffer object into client's memory
+        GLvoid *ret = glMapBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, GL_WRITE_ONLY_ARB);
+        glCheckError();
+        assert(ret);
+        assert(ramBuffer);
+        if (ret && ramBuffer) {
+            // update data directly on the mapped buffer
+            std::memcpy(ret, (void*)ramBuffer, bytesCount);
+            GLboolean result = glUnmapBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB); // release the mapped buffer
+            assert(result == GL_TRUE);
+            Q_UNUSED(result);
+        }
+        glCheckError();
     }
-    glCheckError();
 
     // copy pixels from PBO to texture object
     // using glBindTexture followed by glTexSubImage2D.
@@ -1670,7 +1684,13 @@ ViewerGL::transferBufferFromRAMtoGPU(const unsigned char* ramBuffer,
 
     *texture = tex;
 
-    _imp->updateViewerPboIndex = (_imp->updateViewerPboIndex + 1) % 2;
+    if (pixelBufferIndex == -1) {
+        _imp->updateViewerPboIndex = (_imp->updateViewerPboIndex + 1) % 2;
+    }
+
+    // Map again the pixel buffers that were uploaded or that render threads asked to grow, so that
+    // they are ready for the next frames
+    _imp->pixelBuffers->mapBuffers();
 } // ViewerGL::transferBufferFromRAMtoGPU
 
 void
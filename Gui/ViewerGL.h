@@ -160,6 +160,8 @@ public:
     virtual void clearPartialUpdateTextures() OVERRIDE FINAL;
     virtual bool isViewerUIVisible() const OVERRIDE FINAL WARN_UNUSED_RETURN;
 
+    virtual PixelBufferRingPtr getPixelBufferRing() const OVERRIDE FINAL WARN_UNUSED_RETURN;
+
     /**
      *@brief Copies the data stored in the  RAM buffer into the currently
      * used texture.
@@ -168,6 +170,7 @@ public:
      * 2) memcpy to copy data from RAM to GPU
      * 3) glUnmapBuffer
      * 4) glTexSubImage2D or glTexImage2D depending whether we resize the texture or not.
+     * If the buffer was rendered in a pixel buffer of getPixelBufferRing(), 1) to 3) are skipped.
      **/
     virtual void transferBufferFromRAMtoGPU(const unsigned char* ramBuffer,
                                             size_t bytesCount,
@@ -177,6 +180,7 @@ public:
                                             int textureIndex,
                                             bool isPartialRect,
                                             bool isFirstTile,
+                                            int pixelBufferIndex,
                                             TexturePtr* texture) OVERRIDE FINAL;
     virtual void endTransferBufferFromRAMToGPU(int textureIndex,
                                                const TexturePtr& texture,
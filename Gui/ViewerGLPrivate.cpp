@@ -35,7 +35,12 @@
 #include <QApplication> // qApp
 #include <QtOpenGL/QGLShaderProgram>
 
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/make_shared.hpp>
+#endif
+
 #include "Engine/Lut.h" // Color
+#include "Engine/PixelBufferRing.h"
 #include "Engine/Settings.h"
 #include "Engine/Texture.h"
 
@@ -54,6 +59,10 @@
 #define M_PI_4      0.785398163397448309615660845819875721  /* pi/4           */
 #endif
 
+// Number of mapped pixel buffers render threads may write into: one being displayed, one being
+// uploaded and one being rendered
+#define NATRON_VIEWER_PIXEL_BUFFERS_COUNT 3
+
 
 
 NATRON_NAMESPACE_ENTER
@@ -63,6 +72,7 @@ NATRON_NAMESPACE_ENTER
 ViewerGL::Implementation::Implementation(ViewerGL* this_,
                                          ViewerTab* parent)
     : _this(this_)
+    , pixelBuffers( boost::make_shared<PixelBufferRing>(NATRON_VIEWER_PIXEL_BUFFERS_COUNT) )
     , pboIds()
     , vboVerticesId(0)
     , vboTexturesId(0)
@@ -162,6 +172,7 @@ ViewerGL::Implementation::~Implementation()
         for (U32 i = 0; i < this->pboIds.size(); ++i) {
             glDeleteBuffers(1, &this->pboIds[i]);
         }
+        pixelBuffers->destroyBuffers();
         glCheckError();
         glDeleteBuffers(1, &this->vboVerticesId);
         glDeleteBuffers(1, &this->vboTexturesId);
@@ -150,6 +150,9 @@ struct ViewerGL::Implementation
 
     ViewerGL* _this; // link to parent, for access to public methods
 
+    // Set in the constructor and never changed: render threads acquire buffers from it
+    const PixelBufferRingPtr pixelBuffers;
+
     /////////////////////////////////////////////////////////
     // The following are only accessed from the main thread:
     std::vector<GLuint> pboIds; //!< PBO's id's used by the OpenGL context
@@ -25,11 +25,14 @@
 
 #include "Global/Macros.h"
 
+#include <cmath>
 #include <cstdlib>
+#include <stdexcept>
 
 #include "BaseTest.h"
 
 #include <QtCore/QFile>
+#include <QtCore/QMutex>
 #include <QtCore/QThreadPool>
 
 // ofxhPropertySuite.h:565:37: warning: 'this' pointer cannot be null in well-defined C++ code; comparison may be assumed to always evaluate to true [-Wtautological-undefined-compare]
@@ -44,16 +47,27 @@ CLANG_DIAG_OFF(tautological-undefined-compare) // appeared in clang 3.5
 CLANG_DIAG_ON(tautological-undefined-compare)
 CLANG_DIAG_ON(unknown-pragmas)
 
+#include "Global/StrUtils.h"
+
 #include "Engine/CreateNodeArgs.h"
 #include "Engine/Node.h"
+#include "Engine/NodeSerialization.h"
+#include "Engine/OfxThreadPool.h"
+#include "Engine/PlaybackPrefetcher.h"
 #include "Engine/Project.h"
+#include "Engine/ProjectAutoSaveJournal.h"
+#include "Engine/ProjectBinarySerialization.h"
+#include "Engine/ProjectSerialization.h"
 #include "Engine/AppManager.h"
 #include "Engine/AppInstance.h"
 #include "Engine/KnobTypes.h"
+#include "Engine/KnobValuesSnapshot.h"
 #include "Engine/EffectInstance.h"
+#include "Engine/FrameEntry.h"
 #include "Engine/Plugin.h"
 #include "Engine/Curve.h"
 #include "Engine/CLArgs.h"
+#include "Engine/Transform.h"
 #include "Engine/ViewIdx.h"
 
 NATRON_NAMESPACE_USING
@@ -82,6 +96,12 @@ BaseTest::registerTestPlugins()
     _writeOIIOPluginID = QString::fromUtf8(PLUGINID_OFX_WRITEOIIO);
     _allTestPluginIDs.push_back(_writeOIIOPluginID);
 
+    _transformPluginID = QString::fromUtf8(PLUGINID_OFX_TRANSFORM);
+    _allTestPluginIDs.push_back(_transformPluginID);
+
+    _cropPluginID = QString::fromUtf8(PLUGINID_OFX_CROP);
+    _allTestPluginIDs.push_back(_cropPluginID);
+
     for (unsigned int i = 0; i < _allTestPluginIDs.size(); ++i) {
         ///make sure the generic test plugin is present
         LibraryBinary* bin = NULL;
@@ -281,6 +301,72 @@ TEST_F(BaseTest, GenerateDot)
     QFile::remove(filePath);
 }
 
+static void
+setTranslate(const NodePtr& transform,
+             double x)
+{
+    KnobIPtr knob = transform->getKnobByName("translate");
+    KnobDouble* translate = dynamic_cast<KnobDouble*>( knob.get() );
+
+    ASSERT_TRUE(translate != 0);
+    translate->setValue(x, ViewSpec::all(), 0);
+}
+
+///A Dot does not modify its input: Transform -> Dot -> Transform concatenates into a single transform
+TEST_F(BaseTest, ConcatenateTransformsThroughDot)
+{
+    NodePtr generator = createNode(_generatorPluginID);
+    NodePtr upstream = createNode(_transformPluginID);
+    NodePtr dot = createNode( QString::fromUtf8(PLUGINID_NATRON_DOT) );
+    NodePtr downstream = createNode(_transformPluginID);
+
+    ASSERT_TRUE( bool(generator) && bool(upstream) && bool(dot) && bool(downstream) );
+    setTranslate(upstream, 10.);
+    setTranslate(downstream, 20.);
+    connectNodes(generator, upstream, 0, true);
+    connectNodes(upstream, dot, 0, true);
+    connectNodes(dot, downstream, 0, true);
+
+    InputMatrixMap inputTransforms;
+    downstream->getEffectInstance()->tryConcatenateTransforms(0., false, ViewIdx(0), RenderScale(1.), &inputTransforms);
+
+    ASSERT_EQ( (std::size_t)1, inputTransforms.size() );
+    const InputMatrix& im = inputTransforms.begin()->second;
+    EXPECT_TRUE( im.newInputEffect == upstream->getEffectInstance() );
+    ASSERT_TRUE( bool(im.cat) );
+    // Both translations are applied
+    EXPECT_DOUBLE_EQ( 30., std::fabs(im.cat->c) );
+}
+
+///A Crop smaller than its input is identity only inside its region of definition: it must not be skipped
+TEST_F(BaseTest, ConcatenateTransformsThroughCrop)
+{
+    NodePtr generator = createNode(_generatorPluginID);
+    NodePtr upstream = createNode(_transformPluginID);
+    NodePtr crop = createNode(_cropPluginID);
+    NodePtr downstream = createNode(_transformPluginID);
+
+    ASSERT_TRUE( bool(generator) && bool(upstream) && bool(crop) && bool(downstream) );
+    setTranslate(upstream, 10.);
+    setTranslate(downstream, 20.);
+
+    KnobIPtr knob = crop->getKnobByName("size");
+    KnobDouble* size = dynamic_cast<KnobDouble*>( knob.get() );
+    ASSERT_TRUE(size != 0);
+    size->setValue(10., ViewSpec::all(), 0);
+    size->setValue(10., ViewSpec::all(), 1);
+
+    connectNodes(generator, upstream, 0, true);
+    connectNodes(upstream, crop, 0, true);
+    connectNodes(crop, downstream, 0, true);
+
+    InputMatrixMap inputTransforms;
+    downstream->getEffectInstance()->tryConcatenateTransforms(0., false, ViewIdx(0), RenderScale(1.), &inputTransforms);
+
+    // The downstream transform must read the cropped image
+    EXPECT_TRUE( inputTransforms.empty() );
+}
+
 TEST_F(BaseTest, SetValues)
 {
     NodePtr generator = createNode(_generatorPluginID);
@@ -306,6 +392,379 @@ TEST_F(BaseTest, SetValues)
     }
 }
 
+TEST_F(BaseTest, KnobValuesSnapshot)
+{
+    NodePtr generator = createNode(_generatorPluginID);
+
+    assert(generator);
+    KnobIPtr knob = generator->getKnobByName("noiseZSlope");
+    KnobDouble* slope = dynamic_cast<KnobDouble*>( knob.get() );
+    EXPECT_TRUE(slope != 0);
+    if (!slope) {
+        return;
+    }
+    slope->setValueAtTime(0, 0., ViewSpec::all(), 0);
+    slope->setValueAtTime(100, 1., ViewSpec::all(), 0);
+    EXPECT_TRUE(slope->getIndexInHolder() >= 0);
+
+    KnobValuesSnapshot snapshot(generator->getEffectInstance().get(), 50.);
+    double v;
+    EXPECT_TRUE( snapshot.getValue(slope, slope->getIndexInHolder(), 50., 0, &v) );
+    EXPECT_EQ(slope->getValueAtTime(50.), v);
+
+    // values are only captured at the time of the snapshot, and never for another knob at the same index
+    EXPECT_FALSE( snapshot.getValue(slope, slope->getIndexInHolder(), 51., 0, &v) );
+    EXPECT_FALSE( snapshot.getValue(slope, slope->getIndexInHolder(), 50., 1, &v) );
+    EXPECT_FALSE( snapshot.getValue(0, slope->getIndexInHolder(), 50., 0, &v) );
+
+    // the snapshot is immutable
+    slope->setValueAtTime(50, 2., ViewSpec::all(), 0);
+    EXPECT_TRUE( snapshot.getValue(slope, slope->getIndexInHolder(), 50., 0, &v) );
+    EXPECT_NE(slope->getValueAtTime(50.), v);
+}
+
+struct OfxThreadPoolTestArgs
+{
+    OfxThreadPool* pool;
+    OfxThreadPoolTestArgs* nestedArgs;
+    // The indexes of the thread calling run(), used when the pool has no worker left
+    std::vector<int>* callerIndexes;
+    QMutex lock;
+    std::vector<int> nCalls;
+    bool indexesMatch;
+    OfxStatus nestedStatus;
+
+    OfxThreadPoolTestArgs(OfxThreadPool* pool,
+                          unsigned int nThreads,
+                          OfxThreadPoolTestArgs* nestedArgs,
+                          std::vector<int>* callerIndexes)
+        : pool(pool)
+        , nestedArgs(nestedArgs)
+        , callerIndexes(callerIndexes)
+        , lock()
+        , nCalls(nThreads, 0)
+        , indexesMatch(true)
+        , nestedStatus(kOfxStatOK)
+    {
+    }
+};
+
+static std::vector<int>*
+getCurrentThreadIndexes(OfxThreadPoolTestArgs* args)
+{
+    std::vector<int>* indexes = OfxThreadPool::getCurrentWorkerThreadIndexes();
+
+    return indexes ? indexes : args->callerIndexes;
+}
+
+static bool
+isCurrentThreadIndex(OfxThreadPoolTestArgs* args,
+                     unsigned int threadIndex)
+{
+    std::vector<int>* indexes = getCurrentThreadIndexes(args);
+
+    return indexes && !indexes->empty() && indexes->back() == (int)threadIndex;
+}
+
+static void
+ofxThreadPoolTestFunction(unsigned int threadIndex,
+                          unsigned int threadMax,
+                          void* customArg)
+{
+    OfxThreadPoolTestArgs* args = (OfxThreadPoolTestArgs*)customArg;
+    bool indexMatches = threadIndex < threadMax && isCurrentThreadIndex(args, threadIndex);
+    OfxStatus nestedStatus = kOfxStatOK;
+
+    if ( (threadIndex == 0) && args->nestedArgs ) {
+        // a nested call is processed by other workers, or by this thread if there are none left
+        nestedStatus = args->pool->run(ofxThreadPoolTestFunction, (unsigned int)args->nestedArgs->nCalls.size(), 2, args->nestedArgs,
+                                       getCurrentThreadIndexes(args) );
+        indexMatches = indexMatches && isCurrentThreadIndex(args, threadIndex);
+    }
+
+    QMutexLocker k(&args->lock);
+    ++args->nCalls[threadIndex];
+    args->indexesMatch = args->indexesMatch && indexMatches;
+    if (nestedStatus != kOfxStatOK) {
+        args->nestedStatus = nestedStatus;
+    }
+}
+
+static void
+ofxThreadPoolFailingFunction(unsigned int threadIndex,
+                             unsigned int /*threadMax*/,
+                             void* /*customArg*/)
+{
+    if (threadIndex == 3) {
+        throw std::runtime_error("failure");
+    }
+}
+
+TEST_F(BaseTest, OfxThreadPool)
+{
+    OfxThreadPool pool;
+    std::vector<int> callerIndexes;
+
+    EXPECT_TRUE(OfxThreadPool::getCurrentWorkerThreadIndexes() == 0);
+
+    // every index is processed once, with the index of the worker set
+    for (int i = 0; i < 3; ++i) {
+        OfxThreadPoolTestArgs nestedArgs(&pool, 5, 0, &callerIndexes);
+        OfxThreadPoolTestArgs args(&pool, 16, &nestedArgs, &callerIndexes);
+        EXPECT_EQ( kOfxStatOK, pool.run(ofxThreadPoolTestFunction, 16, 4, &args, &callerIndexes) );
+        EXPECT_EQ(kOfxStatOK, args.nestedStatus);
+        EXPECT_TRUE(args.indexesMatch);
+        EXPECT_TRUE(nestedArgs.indexesMatch);
+        for (std::size_t j = 0; j < args.nCalls.size(); ++j) {
+            EXPECT_EQ(1, args.nCalls[j]);
+        }
+        for (std::size_t j = 0; j < nestedArgs.nCalls.size(); ++j) {
+            EXPECT_EQ(1, nestedArgs.nCalls[j]);
+        }
+    }
+
+    // the workers recover from a failing call
+    EXPECT_EQ( kOfxStatFailed, pool.run(ofxThreadPoolFailingFunction, 8, 4, 0, &callerIndexes) );
+    OfxThreadPoolTestArgs args(&pool, 8, 0, &callerIndexes);
+    EXPECT_EQ( kOfxStatOK, pool.run(ofxThreadPoolTestFunction, 8, 4, &args, &callerIndexes) );
+    EXPECT_TRUE(args.indexesMatch);
+    EXPECT_TRUE( callerIndexes.empty() );
+}
+
+TEST_F(BaseTest, OfxThreadPoolMaxWorkers)
+{
+    std::vector<int> callerIndexes;
+
+    for (int maxWorkers = 1; maxWorkers <= 2; ++maxWorkers) {
+        OfxThreadPool pool(maxWorkers);
+
+        // the nested call cannot get a worker and is processed by the thread calling it
+        OfxThreadPoolTestArgs nestedArgs(&pool, 5, 0, &callerIndexes);
+        OfxThreadPoolTestArgs args(&pool, 16, &nestedArgs, &callerIndexes);
+        EXPECT_EQ( kOfxStatOK, pool.run(ofxThreadPoolTestFunction, 16, 4, &args, &callerIndexes) );
+        EXPECT_EQ(kOfxStatOK, args.nestedStatus);
+        EXPECT_TRUE(args.indexesMatch);
+        EXPECT_TRUE(nestedArgs.indexesMatch);
+        for (std::size_t j = 0; j < args.nCalls.size(); ++j) {
+            EXPECT_EQ(1, args.nCalls[j]);
+        }
+        for (std::size_t j = 0; j < nestedArgs.nCalls.size(); ++j) {
+            EXPECT_EQ(1, nestedArgs.nCalls[j]);
+        }
+        EXPECT_LE(pool.getWorkersCount(), maxWorkers);
+
+        EXPECT_TRUE( callerIndexes.empty() );
+    }
+}
+
+TEST_F(BaseTest, PlaybackPrefetcherReaders)
+{
+    NodePtr reader = createNode(_readOIIOPluginID);
+    NodePtr generator = createNode(_generatorPluginID);
+    NodePtr writer = createNode(_writeOIIOPluginID);
+
+    // no reader upstream
+    connectNodes(generator, writer, 0, true);
+    NodesList readers;
+    PlaybackPrefetcher::getReadersUpstream(writer, &readers);
+    EXPECT_TRUE( readers.empty() );
+
+    // the reader is found once
+    disconnectNodes(generator, writer, true);
+    connectNodes(reader, writer, 0, true);
+    PlaybackPrefetcher::getReadersUpstream(writer, &readers);
+    PlaybackPrefetcher::getReadersUpstream(writer, &readers);
+    ASSERT_EQ(1, (int)readers.size());
+    EXPECT_TRUE(readers.front() == reader);
+}
+
+TEST_F(BaseTest, FrameEntryCompression)
+{
+    const int tileSize = 64;
+    RectI tileBounds(0, 0, tileSize, tileSize);
+    TextureRect texRect(0, 0, tileSize, tileSize, 1, 1.);
+    FrameKey key(0, 0, 0, 1., 1., (int)eViewerColorSpaceSRGB, (int)eImageBitDepthFloat, (int)eDisplayChannelsRGB, ViewIdx(0),
+                 texRect, 0, std::string(), ImagePlaneDesc::getRGBAComponents(), std::string(), true, false);
+    FrameParamsPtr params = boost::make_shared<FrameParams>(tileBounds, (int)eImageBitDepthFloat, tileBounds, ImagePtr());
+    // Not managed by a cache: keep the entry in RAM
+    params->getStorageInfo().mode = eStorageModeRAM;
+    FrameEntry entry(key, params, 0);
+    entry.allocateMemory();
+    ASSERT_TRUE( entry.isAllocated() );
+
+    // a smooth gradient, as rendered by the viewer
+    const std::size_t rawSize = entry.getSizeInBytesFromParams();
+    ASSERT_EQ(tileSize * tileSize * 4 * sizeof(float), rawSize);
+    float* pixels = (float*)entry.data();
+    for (int y = 0; y < tileSize; ++y) {
+        for (int x = 0; x < tileSize; ++x, pixels += 4) {
+            pixels[0] = x / (float)tileSize;
+            pixels[1] = y / (float)tileSize;
+            pixels[2] = 0.5f;
+            pixels[3] = 1.f;
+        }
+    }
+    std::vector<unsigned char> original(entry.data(), entry.data() + rawSize);
+
+    EXPECT_FALSE( entry.isCompressed() );
+    std::size_t compressedSize = entry.compress();
+    EXPECT_TRUE(compressedSize > 0 && compressedSize < rawSize);
+    EXPECT_TRUE( entry.isCompressed() );
+    EXPECT_EQ( compressedSize, entry.dataSize() );
+
+    // compressing twice does nothing
+    EXPECT_EQ( (std::size_t)0, entry.compress() );
+
+    // the round-trip is lossless
+    std::vector<unsigned char> decompressed(rawSize);
+    ASSERT_TRUE( entry.decompress(&decompressed.front(), decompressed.size()) );
+    EXPECT_TRUE(decompressed == original);
+    EXPECT_FALSE( entry.decompress(&decompressed.front(), decompressed.size() - 1) );
+}
+
+TEST_F(BaseTest, BinaryProject)
+{
+    NodePtr generator = createNode(_generatorPluginID);
+
+    ASSERT_TRUE( bool(generator) );
+    KnobIPtr knob = generator->getKnobByName("noiseZSlope");
+    KnobDouble* slope = dynamic_cast<KnobDouble*>( knob.get() );
+    ASSERT_TRUE(slope != 0);
+    slope->setValueAtTime(0, 0., ViewSpec::all(), 0);
+    slope->setValueAtTime(100, 1., ViewSpec::all(), 0);
+
+    QString path = appPTR->getApplicationBinaryPath();
+    StrUtils::ensureLastPathSeparator(path);
+    QString name = QString::fromUtf8("test_binary_project." NATRON_PROJECT_BINARY_FILE_EXT);
+    ASSERT_TRUE( getApp()->getProject()->saveProject(path, name, 0) );
+    const std::string filePath = (path + name).toStdString();
+    EXPECT_TRUE( ProjectBinarySerialization::isBinaryProjectFile(filePath) );
+
+    // The version following the magic number is little-endian whatever the machine
+    {
+        QFile file( QString::fromUtf8( filePath.c_str() ) );
+        ASSERT_TRUE( file.open(QIODevice::ReadOnly) );
+        QByteArray header = file.read(20);
+        ASSERT_EQ( 20, header.size() );
+        EXPECT_EQ( QByteArray("\x02\x00\x00\x00", 4), header.mid(16) );
+    }
+
+    {
+        ProjectBinaryReaderPtr reader = boost::make_shared<ProjectBinaryReader>(filePath);
+        EXPECT_TRUE( reader->isBackgroundProject() );
+
+        // The graph structure is known before any node is decoded
+        const std::vector<ProjectBinaryReader::NodeEntry>& entries = reader->getNodeEntries();
+        int generatorIndex = -1;
+        std::size_t topLevelCount = 0;
+        for (std::size_t i = 0; i < entries.size(); ++i) {
+            if ( entries[i].scriptName == generator->getScriptName() ) {
+                generatorIndex = (int)i;
+            }
+            if (entries[i].parent == -1) {
+                ++topLevelCount;
+            }
+        }
+        ASSERT_TRUE(generatorIndex >= 0);
+        EXPECT_EQ( generator->getPluginID(), entries[generatorIndex].pluginID );
+        EXPECT_EQ(-1, entries[generatorIndex].parent);
+
+        NodeSerializationPtr serialization = reader->readNode(generatorIndex);
+        EXPECT_EQ( generator->getScriptName(), serialization->getNodeScriptName() );
+        KnobDouble* serializedSlope = 0;
+        const NodeSerialization::KnobValues& values = serialization->getKnobsValues();
+        for (NodeSerialization::KnobValues::const_iterator it = values.begin(); it != values.end(); ++it) {
+            if ( (*it)->getName() == slope->getName() ) {
+                serializedSlope = dynamic_cast<KnobDouble*>( (*it)->getKnob().get() );
+            }
+        }
+        ASSERT_TRUE(serializedSlope != 0);
+        EXPECT_EQ( slope->getValueAtTime(50.), serializedSlope->getValueAtTime(50.) );
+
+        ProjectSerialization project( getApp() );
+        reader->readProject(&project);
+        EXPECT_EQ( topLevelCount, project.getNodesSerialization().getNodesSerialization().size() );
+    }
+
+    getApp()->getProject()->removeLockFile();
+    QFile::remove( QString::fromUtf8( filePath.c_str() ) );
+}
+
+TEST_F(BaseTest, AutoSaveJournal)
+{
+    NodePtr generator = createNode(_generatorPluginID);
+
+    ASSERT_TRUE( bool(generator) );
+    KnobIPtr knob = generator->getKnobByName("noiseZSlope");
+    KnobDouble* slope = dynamic_cast<KnobDouble*>( knob.get() );
+    ASSERT_TRUE(slope != 0);
+
+    // The full auto-save the journal applies to
+    ProjectPtr project = getApp()->getProject();
+    QString path = appPTR->getApplicationBinaryPath();
+    StrUtils::ensureLastPathSeparator(path);
+    QString name = QString::fromUtf8("test_autosave_journal." NATRON_PROJECT_BINARY_FILE_EXT);
+    ProjectAutoSaveJournal journal;
+    journal.captureNodes( project.get() );
+    ASSERT_TRUE( project->saveProject(path, name, 0) );
+    const std::string filePath = (path + name).toStdString();
+    journal.reset(filePath);
+
+    // Edit a node and add another one
+    const U64 age = generator->getSerializationAge();
+    slope->setValue(0.5, ViewSpec::all(), 0);
+    EXPECT_NE( age, generator->getSerializationAge() );
+    NodePtr writer = createNode(_writeOIIOPluginID);
+    ASSERT_TRUE( bool(writer) );
+
+    ASSERT_TRUE( journal.append( project.get() ) );
+    const std::string journalFilePath = ProjectAutoSaveJournal::getJournalFilePath(filePath);
+    EXPECT_TRUE( QFile::exists( QString::fromUtf8( journalFilePath.c_str() ) ) );
+    EXPECT_TRUE( ProjectAutoSaveJournal::isJournalFilePath(journalFilePath) );
+    EXPECT_FALSE( ProjectAutoSaveJournal::isJournalFilePath(filePath) );
+
+    {
+        ProjectSerialization serialization( getApp() );
+        ProjectBinaryReaderPtr reader = boost::make_shared<ProjectBinaryReader>(filePath);
+        reader->readProject(&serialization);
+        const std::size_t nodesCount = serialization.getNodesSerialization().getNodesSerialization().size();
+
+        std::string guiData;
+        ProjectAutoSaveJournal::replay(filePath, getApp(), &serialization, &guiData);
+        const std::list<NodeSerializationPtr>& nodes = serialization.getNodesSerialization().getNodesSerialization();
+        EXPECT_EQ( nodesCount + 1, nodes.size() );
+        // No GUI layout in background mode
+        EXPECT_TRUE( guiData.empty() );
+
+        KnobDouble* serializedSlope = 0;
+        for (std::list<NodeSerializationPtr>::const_iterator it = nodes.begin(); it != nodes.end(); ++it) {
+            if ( (*it)->getNodeScriptName() != generator->getScriptName() ) {
+                continue;
+            }
+            const NodeSerialization::KnobValues& values = (*it)->getKnobsValues();
+            for (NodeSerialization::KnobValues::const_iterator it2 = values.begin(); it2 != values.end(); ++it2) {
+                if ( (*it2)->getName() == slope->getName() ) {
+                    serializedSlope = dynamic_cast<KnobDouble*>( (*it2)->getKnob().get() );
+                }
+            }
+        }
+        ASSERT_TRUE(serializedSlope != 0);
+        EXPECT_EQ( 0.5, serializedSlope->getValue() );
+    }
+
+    // Nothing changed since the last append: only the project settings are recorded
+    {
+        const qint64 journalSize = QFile( QString::fromUtf8( journalFilePath.c_str() ) ).size();
+        ASSERT_TRUE( journal.append( project.get() ) );
+        const qint64 newJournalSize = QFile( QString::fromUtf8( journalFilePath.c_str() ) ).size();
+        EXPECT_LT( newJournalSize - journalSize, journalSize );
+    }
+
+    project->removeLockFile();
+    QFile::remove( QString::fromUtf8( filePath.c_str() ) );
+    QFile::remove( QString::fromUtf8( journalFilePath.c_str() ) );
+}
+
 ///High level test: simple node connections test
 TEST_F(BaseTest, SimpleNodeConnections) {
     ///create the generator
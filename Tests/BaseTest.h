@@ -92,6 +92,8 @@ protected:
     QString _generatorPluginID;
     QString _readOIIOPluginID;
     QString _writeOIIOPluginID;
+    QString _transformPluginID;
+    QString _cropPluginID;
     std::vector<QString> _allTestPluginIDs;
     AppInstanceWPtr _app;
 };
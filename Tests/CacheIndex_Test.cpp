@@ -0,0 +1,184 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ * Copyright (C) 2018-2020 The Natron developers
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <list>
+#include <string>
+#include <gtest/gtest.h>
+
+#include <QtCore/QDir>
+
+#include "Engine/CacheIndex.h"
+
+NATRON_NAMESPACE_USING
+
+static std::string
+getIndexPath()
+{
+    return QDir::tempPath().toStdString() + "/CacheIndex_Test.ntc";
+}
+
+static CacheIndex::Record
+makeRecord(U64 hash,
+           std::size_t dataSize)
+{
+    CacheIndex::Record r;
+
+    r.hash = hash;
+    r.dataSize = dataSize;
+    r.dataOffset = hash * 16;
+    r.filePath = "CachePart0";
+    r.payload = std::string(hash % 50, (char)hash);
+
+    return r;
+}
+
+TEST(CacheIndex,
+     WriteAndRestore)
+{
+    const std::string path = getIndexPath();
+    const int nRecords = 5000;
+    {
+        CacheIndex index;
+        index.create(path, 1, 10);
+        for (int i = 1; i <= nRecords; ++i) {
+            index.append( makeRecord(i, 100) );
+        }
+        // Several entries may share the same hash
+        index.append( makeRecord(42, 7) );
+        index.close();
+    }
+
+    CacheIndex index;
+    ASSERT_FALSE( index.open(path, 2) ) << "An index of another cache version must not be opened";
+    ASSERT_TRUE( index.open(path, 1) );
+    EXPECT_EQ( (std::size_t)nRecords + 1, index.getRecordsCount() );
+    EXPECT_EQ( (std::size_t)nRecords * 100 + 7, index.getRecordsBytes() );
+
+    std::list<CacheIndex::Record> records;
+    index.takeRecords(42, &records);
+    ASSERT_EQ( (std::size_t)2, records.size() );
+    for (std::list<CacheIndex::Record>::iterator it = records.begin(); it != records.end(); ++it) {
+        CacheIndex::Record expected = makeRecord(42, it->dataSize);
+        EXPECT_EQ(expected.hash, it->hash);
+        EXPECT_EQ(expected.dataOffset, it->dataOffset);
+        EXPECT_EQ(expected.filePath, it->filePath);
+        EXPECT_EQ(expected.payload, it->payload);
+    }
+
+    // Taken records are removed
+    records.clear();
+    index.takeRecords(42, &records);
+    EXPECT_TRUE( records.empty() );
+    index.takeRecords(nRecords + 1, &records);
+    EXPECT_TRUE( records.empty() );
+    EXPECT_EQ( (std::size_t)nRecords - 1, index.getRecordsCount() );
+
+    // Oldest records come first
+    CacheIndex::Record oldest;
+    ASSERT_TRUE( index.takeOldestRecord(&oldest) );
+    EXPECT_EQ( (U64)1, oldest.hash );
+    index.removeRecord( makeRecord(2, 0).location ); // not a valid location, ignored
+    records.clear();
+    index.takeRecords(2, &records);
+    ASSERT_EQ( (std::size_t)1, records.size() );
+    ASSERT_TRUE( index.takeOldestRecord(&oldest) );
+    EXPECT_EQ( (U64)3, oldest.hash );
+
+    records.clear();
+    index.getRecords(&records);
+    EXPECT_EQ( (std::size_t)nRecords - 4, records.size() );
+    EXPECT_EQ( (U64)4, records.front().hash );
+
+    std::set<std::string> filePaths;
+    index.getFilePaths(&filePaths);
+    ASSERT_EQ( (std::size_t)1, filePaths.size() );
+    EXPECT_EQ( std::string("CachePart0"), *filePaths.begin() );
+
+    index.remove();
+}
+
+TEST(CacheIndex,
+     NotClosedIsInvalid)
+{
+    const std::string path = getIndexPath();
+    {
+        CacheIndex index;
+        index.create(path, 1, 0);
+        index.append( makeRecord(1, 100) );
+        index.close();
+    }
+    {
+        CacheIndex index;
+        ASSERT_TRUE( index.open(path, 1) );
+        // Not closed: as if the application crashed
+    }
+
+    CacheIndex index;
+    EXPECT_FALSE( index.open(path, 1) );
+    EXPECT_FALSE( index.isOpened() );
+    EXPECT_FALSE( index.open(path + ".missing", 1) );
+    index.create(path, 1, 0);
+    index.remove();
+}
+
+TEST(CacheIndex,
+     TileFiles)
+{
+    const std::string path = getIndexPath();
+    std::list<CacheIndex::TileFileUsage> files;
+
+    for (int f = 0; f < 3; ++f) {
+        CacheIndex::TileFileUsage usage;
+        usage.filePath = "CachePart" + std::string(1, (char)('0' + f));
+        usage.usedTiles.resize(1000 + f);
+        for (std::size_t i = 0; i < usage.usedTiles.size(); ++i) {
+            usage.usedTiles[i] = (i % (f + 2)) == 0;
+        }
+        files.push_back(usage);
+    }
+    {
+        CacheIndex index;
+        index.create(path, 1, 0);
+        index.append( makeRecord(1, 100) );
+        index.setTileFiles(files);
+        EXPECT_THROW( index.append( makeRecord(2, 100) ), std::logic_error );
+        index.close();
+    }
+
+    CacheIndex index;
+    ASSERT_TRUE( index.open(path, 1) );
+    std::list<CacheIndex::TileFileUsage> restored;
+    index.getTileFiles(&restored);
+    ASSERT_EQ( files.size(), restored.size() );
+    std::list<CacheIndex::TileFileUsage>::iterator it2 = restored.begin();
+    for (std::list<CacheIndex::TileFileUsage>::iterator it = files.begin(); it != files.end(); ++it, ++it2) {
+        EXPECT_EQ(it->filePath, it2->filePath);
+        EXPECT_TRUE(it->usedTiles == it2->usedTiles);
+    }
+    EXPECT_EQ( (std::size_t)1, index.getRecordsCount() );
+    index.remove();
+}
@@ -25,12 +25,16 @@
 
 #include "Global/Macros.h"
 
+#include <cstdlib>
+#include <vector>
+
 #include <gtest/gtest.h>
 
 #include <QtCore/QString>
 #include <QtCore/QDir>
 
 #include "Engine/Curve.h"
+#include "Engine/PixelConvert.h"
 
 NATRON_NAMESPACE_USING
 
@@ -125,3 +129,78 @@ TEST(Curve, Basic)
 }
 
 
+
+static void
+expectBatchMatchesSingle(const Curve& c,
+                         const std::vector<double>& times)
+{
+    const int n = (int)times.size();
+    PixelConvert::InstructionSetEnum hostSet = PixelConvert::getHostInstructionSet();
+
+    for (int set = PixelConvert::eInstructionSetScalar; set <= (int)hostSet; ++set) {
+        PixelConvert::setMaxInstructionSet( (PixelConvert::InstructionSetEnum)set );
+        for (int clamp = 0; clamp < 2; ++clamp) {
+            std::vector<double> values(n);
+            c.getValuesAt(&times[0], &values[0], n, clamp != 0);
+            for (int i = 0; i < n; ++i) {
+                // bit-exact with the single value evaluation
+                EXPECT_EQ( c.getValueAt(times[i], clamp != 0), values[i] );
+            }
+        }
+    }
+    PixelConvert::setMaxInstructionSet(PixelConvert::eInstructionSetAVX2);
+}
+
+TEST(Curve, GetValuesAt)
+{
+    Curve c;
+    std::vector<double> times;
+
+    // sorted, with a length that is not a multiple of the vector sizes, and hitting the keyframes
+    for (int i = 0; i < 1003; ++i) {
+        times.push_back(-20. + i * 0.0625);
+    }
+    // then unsorted
+    srand(2000);
+    for (int i = 0; i < 501; ++i) {
+        // coverity[dont_call]
+        times.push_back( rand() / (double)RAND_MAX * 60. - 20. );
+    }
+
+    // empty curve
+    {
+        std::vector<double> values( times.size(), 1. );
+        c.getValuesAt(&times[0], &values[0], (int)times.size());
+        EXPECT_EQ( 0., values[0] );
+        EXPECT_EQ( 0., values.back() );
+    }
+
+    // one keyframe with tangents
+    EXPECT_TRUE( c.addKeyFrame( KeyFrame(0., 5., 1., 2.) ) );
+    expectBatchMatchesSingle(c, times);
+
+    // all interpolation types, including segments where coefficients are zero
+    const KeyframeTypeEnum types[] = {
+        eKeyframeTypeLinear, eKeyframeTypeSmooth, eKeyframeTypeConstant, eKeyframeTypeCatmullRom,
+        eKeyframeTypeCubic, eKeyframeTypeHorizontal, eKeyframeTypeFree, eKeyframeTypeBroken,
+    };
+    const int nTypes = (int)( sizeof(types) / sizeof(types[0]) );
+    for (int i = 0; i < nTypes; ++i) {
+        KeyFrame k(3. * (i + 1), (i % 3) * 7. - 4., 1.5 * i - 2., 0.5 * i, types[i]);
+        c.addKeyFrame(k);
+    }
+    expectBatchMatchesSingle(c, times);
+
+    // clamped to a range
+    c.setYRange(-2., 3.);
+    expectBatchMatchesSingle(c, times);
+
+    // periodic
+    Curve periodic;
+    periodic.setPeriodic(true);
+    periodic.setXRange(0., 10.);
+    periodic.addKeyFrame( KeyFrame(1., 2., 0.5, 0.5, eKeyframeTypeSmooth) );
+    periodic.addKeyFrame( KeyFrame(4., -1., 0., 0., eKeyframeTypeLinear) );
+    periodic.addKeyFrame( KeyFrame(8., 3., 1., -1., eKeyframeTypeCubic) );
+    expectBatchMatchesSingle(periodic, times);
+}
@@ -26,6 +26,9 @@
 #include "Global/Macros.h"
 
 #include <cstdlib>
+#include <cstring>
+#include <set>
+#include <vector>
 #include <gtest/gtest.h>
 
 #include "Engine/Hash64.h"
@@ -91,3 +94,245 @@ TEST(Hash64,
     EXPECT_NE(hash1, hash2);
 } // TEST
 
+
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+// Straightforward byte-wise XXH64 (seed 0), used as a reference for the streaming implementation
+U64
+rotl64(U64 x,
+       int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+U64
+readU64(const unsigned char* p)
+{
+    U64 v = 0;
+
+    for (int i = 7; i >= 0; --i) {
+        v = (v << 8) | p[i];
+    }
+
+    return v;
+}
+
+U64
+xxh64Round(U64 acc,
+           U64 input)
+{
+    acc += input * Hash64::kPrime2;
+    acc = rotl64(acc, 31);
+
+    return acc * Hash64::kPrime1;
+}
+
+U64
+referenceXXH64(const unsigned char* p,
+               std::size_t len)
+{
+    const unsigned char* end = p + len;
+    U64 h;
+
+    if (len >= 32) {
+        U64 v1 = Hash64::kPrime1 + Hash64::kPrime2;
+        U64 v2 = Hash64::kPrime2;
+        U64 v3 = 0;
+        U64 v4 = 0 - Hash64::kPrime1;
+        for (; p + 32 <= end; p += 32) {
+            v1 = xxh64Round(v1, readU64(p));
+            v2 = xxh64Round(v2, readU64(p + 8));
+            v3 = xxh64Round(v3, readU64(p + 16));
+            v4 = xxh64Round(v4, readU64(p + 24));
+        }
+        h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        U64 v[4] = {v1, v2, v3, v4};
+        for (int i = 0; i < 4; ++i) {
+            h ^= xxh64Round(0, v[i]);
+            h = h * Hash64::kPrime1 + Hash64::kPrime4;
+        }
+    } else {
+        h = Hash64::kPrime5;
+    }
+    h += len;
+    for (; p + 8 <= end; p += 8) {
+        h ^= xxh64Round(0, readU64(p));
+        h = rotl64(h, 27) * Hash64::kPrime1 + Hash64::kPrime4;
+    }
+    if (p + 4 <= end) {
+        U64 k = (U64)p[0] | ( (U64)p[1] << 8 ) | ( (U64)p[2] << 16 ) | ( (U64)p[3] << 24 );
+        h ^= k * Hash64::kPrime1;
+        h = rotl64(h, 23) * Hash64::kPrime2 + Hash64::kPrime3;
+        p += 4;
+    }
+    for (; p < end; ++p) {
+        h ^= (*p) * Hash64::kPrime5;
+        h = rotl64(h, 11) * Hash64::kPrime1;
+    }
+    h ^= h >> 33;
+    h *= Hash64::kPrime2;
+    h ^= h >> 29;
+    h *= Hash64::kPrime3;
+    h ^= h >> 32;
+
+    return h;
+}
+
+U64
+referenceHashOfWords(const std::vector<U64>& words)
+{
+    std::vector<unsigned char> bytes( words.size() * 8 );
+
+    for (std::size_t i = 0; i < words.size(); ++i) {
+        for (int b = 0; b < 8; ++b) {
+            bytes[i * 8 + b] = (unsigned char)( words[i] >> (8 * b) );
+        }
+    }
+
+    return referenceXXH64(bytes.empty() ? 0 : &bytes[0], bytes.size());
+}
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+TEST(Hash64,
+     ReferenceXXH64)
+{
+    // Published test vectors, to make sure the reference itself is right
+    EXPECT_EQ( 0xEF46DB3751D8E999ULL, referenceXXH64(0, 0) );
+    const char* abc = "abc";
+    EXPECT_EQ( 0x44BC2CF5AD770999ULL, referenceXXH64(reinterpret_cast<const unsigned char*>(abc), 3) );
+}
+
+TEST(Hash64,
+     Stability)
+{
+    // The streaming hash must give the same result as XXH64 over the appended words,
+    // whatever the number of words (all remainders modulo the 4 lanes are covered).
+    srand(2001);
+    for (int n = 1; n < 70; ++n) {
+        std::vector<U64> words;
+        Hash64 hash;
+        for (int i = 0; i < n; ++i) {
+            // coverity[dont_call]
+            U64 w = ( (U64)rand() << 33 ) ^ ( (U64)rand() << 11 ) ^ (U64)rand();
+            words.push_back(w);
+            hash.append(w);
+        }
+        hash.computeHash();
+        EXPECT_EQ(referenceHashOfWords(words), hash.value()) << "n = " << n;
+        EXPECT_EQ( (U64)n, hash.size() );
+    }
+
+    // Pin a value: disk cache entries are keyed by these hashes, any change must bump NATRON_CACHE_VERSION
+    Hash64 pinned;
+    for (int i = 0; i < 10; ++i) {
+        pinned.append<int>(i);
+    }
+    pinned.append<double>(0.5);
+    pinned.computeHash();
+    std::vector<U64> words;
+    for (int i = 0; i < 10; ++i) {
+        words.push_back( (U64)i );
+    }
+    words.push_back( Hash64::toU64<double>(0.5) );
+    EXPECT_EQ( referenceHashOfWords(words), pinned.value() );
+}
+
+TEST(Hash64,
+     Incremental)
+{
+    // computeHash() does not consume the state: appending more values afterwards
+    // gives the same result as appending everything at once.
+    Hash64 incremental, oneShot;
+
+    for (int i = 0; i < 37; ++i) {
+        incremental.append<int>(i * 7);
+        oneShot.append<int>(i * 7);
+        incremental.computeHash();
+    }
+    oneShot.computeHash();
+    EXPECT_EQ( oneShot.value(), incremental.value() );
+
+    // A copied prefix continues exactly like the original
+    Hash64 prefix;
+    for (int i = 0; i < 5; ++i) {
+        prefix.append<int>(i);
+    }
+    Hash64 a = prefix, b = prefix, full;
+    for (int i = 0; i < 5; ++i) {
+        full.append<int>(i);
+    }
+    a.append<int>(42);
+    b.append<int>(42);
+    full.append<int>(42);
+    a.computeHash();
+    b.computeHash();
+    full.computeHash();
+    EXPECT_EQ( full.value(), a.value() );
+    EXPECT_EQ( a.value(), b.value() );
+}
+
+TEST(Hash64,
+     Collisions)
+{
+    std::set<U64> seen;
+
+    // Single values, including values that only differ in their high bits
+    for (int i = 0; i < 2000; ++i) {
+        Hash64 h;
+        h.append<int>(i);
+        h.computeHash();
+        ASSERT_TRUE( h.valid() );
+        EXPECT_TRUE( seen.insert( h.value() ).second ) << "i = " << i;
+
+        Hash64 high;
+        high.append<U64>( (U64)(i + 1) << 40 );
+        high.computeHash();
+        EXPECT_TRUE( seen.insert( high.value() ).second ) << "i << 40 = " << i;
+    }
+
+    // Trailing zeros must change the hash (a single zero was already inserted above)
+    for (int n = 2; n < 40; ++n) {
+        Hash64 h;
+        for (int i = 0; i < n; ++i) {
+            h.append<int>(0);
+        }
+        h.computeHash();
+        EXPECT_TRUE( seen.insert( h.value() ).second ) << "zeros = " << n;
+    }
+
+    // Order matters: swapping 2 inputs (e.g. node inputs) must change the hash
+    for (int i = 0; i < 50; ++i) {
+        Hash64 ab, ba;
+        ab.append<int>(i);
+        ab.append<int>(i + 1);
+        ba.append<int>(i + 1);
+        ba.append<int>(i);
+        ab.computeHash();
+        ba.computeHash();
+        EXPECT_NE( ab.value(), ba.value() );
+    }
+
+    // Flipping any single bit of any word of a 9-word stream changes the hash
+    std::vector<U64> base;
+    for (int i = 0; i < 9; ++i) {
+        base.push_back( (U64)i * 0x9E3779B97F4A7C15ULL );
+    }
+    Hash64 baseHash;
+    for (std::size_t i = 0; i < base.size(); ++i) {
+        baseHash.append(base[i]);
+    }
+    baseHash.computeHash();
+    std::set<U64> flipped;
+    flipped.insert( baseHash.value() );
+    for (std::size_t w = 0; w < base.size(); ++w) {
+        for (int bit = 0; bit < 64; ++bit) {
+            Hash64 h;
+            for (std::size_t i = 0; i < base.size(); ++i) {
+                h.append( i == w ? (base[i] ^ ( (U64)1 << bit ) ) : base[i] );
+            }
+            h.computeHash();
+            EXPECT_TRUE( flipped.insert( h.value() ).second ) << "word " << w << " bit " << bit;
+        }
+    }
+} // TEST
@@ -0,0 +1,175 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ * Copyright (C) 2018-2020 The Natron developers
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include <boost/make_shared.hpp>
+
+#include "Engine/Image.h"
+#include "Engine/ImageStatistics.h"
+#include "Engine/PixelConvert.h"
+
+NATRON_NAMESPACE_USING
+
+static void
+accumulateRows(const std::vector<float>& pixels,
+               int nComps,
+               int width,
+               ImageStatistics* stats)
+{
+    int height = (int)pixels.size() / (nComps * width);
+
+    for (int y = 0; y < height; ++y) {
+        stats->accumulateRow(&pixels[y * width * nComps], nComps, width);
+    }
+}
+
+TEST(ImageStatistics, Scalar) {
+    // 2 RGBA pixels, the second has a NaN red which must be ignored by the min/max
+    const float pixels[8] = {
+        0.5f, -1.f, 2.f, 1.f,
+        std::numeric_limits<float>::quiet_NaN(), 3.f, 0.f, 0.25f
+    };
+    PixelConvert::setMaxInstructionSet(PixelConvert::eInstructionSetScalar);
+    ImageStatistics stats(4, 0., 4.);
+    stats.accumulateRow(pixels, 4, 2);
+    PixelConvert::setMaxInstructionSet(PixelConvert::eInstructionSetAVX2);
+
+    EXPECT_EQ(2u, stats.getPixelsCount());
+    EXPECT_EQ(0.5, stats.getMin(ImageStatistics::eChannelR));
+    EXPECT_EQ(0.5, stats.getMax(ImageStatistics::eChannelR));
+    EXPECT_EQ(-1., stats.getMin(ImageStatistics::eChannelG));
+    EXPECT_EQ(3., stats.getMax(ImageStatistics::eChannelG));
+    EXPECT_EQ(0.25, stats.getMin(ImageStatistics::eChannelA));
+    EXPECT_DOUBLE_EQ(1., stats.getMean(ImageStatistics::eChannelG));
+    EXPECT_DOUBLE_EQ(0.625, stats.getMean(ImageStatistics::eChannelA));
+
+    double vmin, vmax;
+    stats.getDisplayRange(eDisplayChannelsRGB, &vmin, &vmax);
+    EXPECT_EQ(-1., vmin);
+    EXPECT_EQ(3., vmax);
+
+    // bins of size 1: the value 4 is out of [0, 4[ and -1 is not counted either
+    std::vector<unsigned int> green = stats.getHistogram(ImageStatistics::eChannelG);
+    ASSERT_EQ(4u, green.size());
+    EXPECT_EQ(0u, green[0]);
+    EXPECT_EQ(0u, green[1]);
+    EXPECT_EQ(0u, green[2]);
+    EXPECT_EQ(1u, green[3]);
+    std::vector<unsigned int> blue = stats.getHistogram(ImageStatistics::eChannelB);
+    EXPECT_EQ(1u, blue[0]);
+    EXPECT_EQ(1u, blue[2]);
+
+    // 1 component images are alpha
+    const float alpha[3] = { 0.2f, 0.8f, 0.5f };
+    ImageStatistics alphaStats;
+    alphaStats.accumulateRow(alpha, 1, 3);
+    EXPECT_FALSE( alphaStats.hasHistograms() );
+    EXPECT_FLOAT_EQ(0.2f, alphaStats.getMin(ImageStatistics::eChannelA));
+    EXPECT_FLOAT_EQ(0.8f, alphaStats.getMax(ImageStatistics::eChannelA));
+    EXPECT_EQ(0., alphaStats.getMax(ImageStatistics::eChannelR));
+}
+
+TEST(ImageStatistics, SIMD) {
+    const int width = 1027; // not a multiple of the vector sizes, to test the remainder loops
+    const int height = 5;
+    std::vector<float> pixels(width * height * 4);
+
+    srand(2000);
+    for (std::size_t i = 0; i < pixels.size(); ++i) {
+        // coverity[dont_call]
+        pixels[i] = rand() / (float)RAND_MAX * 1.4f - 0.2f;
+    }
+    pixels[5] = std::numeric_limits<float>::quiet_NaN();
+    pixels[42] = 1.2f; // exactly the histogram max, not counted
+
+    PixelConvert::setMaxInstructionSet(PixelConvert::eInstructionSetScalar);
+    ImageStatistics ref(100, -0.1, 1.2);
+    accumulateRows(pixels, 4, width, &ref);
+
+    PixelConvert::InstructionSetEnum hostSet = PixelConvert::getHostInstructionSet();
+    for (int set = PixelConvert::eInstructionSetSSE41; set <= (int)hostSet; ++set) {
+        PixelConvert::setMaxInstructionSet( (PixelConvert::InstructionSetEnum)set );
+        // split in 2 parts to test merge()
+        ImageStatistics simd(100, -0.1, 1.2);
+        ImageStatistics part(100, -0.1, 1.2);
+        accumulateRows( std::vector<float>(pixels.begin(), pixels.begin() + width * 4 * 2), 4, width, &simd );
+        accumulateRows( std::vector<float>(pixels.begin() + width * 4 * 2, pixels.end()), 4, width, &part );
+        simd.merge(part);
+
+        EXPECT_EQ( ref.getPixelsCount(), simd.getPixelsCount() );
+        for (int c = 0; c < ImageStatistics::eChannelCount; ++c) {
+            ImageStatistics::ChannelEnum channel = (ImageStatistics::ChannelEnum)c;
+            EXPECT_EQ( ref.getMin(channel), simd.getMin(channel) );
+            EXPECT_EQ( ref.getMax(channel), simd.getMax(channel) );
+            EXPECT_TRUE( ref.getHistogram(channel) == simd.getHistogram(channel) );
+            if ( (channel != ImageStatistics::eChannelG) && (channel != ImageStatistics::eChannelY) ) {
+                // the NaN green makes the mean of the green and of the luminance NaN
+                EXPECT_NEAR( ref.getMean(channel), simd.getMean(channel), 1e-9 );
+            }
+        }
+    }
+    PixelConvert::setMaxInstructionSet(PixelConvert::eInstructionSetAVX2);
+
+    EXPECT_TRUE( std::isnan( ref.getMean(ImageStatistics::eChannelG) ) );
+    std::size_t binned = 0;
+    std::vector<unsigned int> red = ref.getHistogram(ImageStatistics::eChannelR);
+    for (std::size_t i = 0; i < red.size(); ++i) {
+        binned += red[i];
+    }
+    // the red values are in [-0.2, 1.2[, the ones below -0.1 are not counted
+    EXPECT_LT( binned, ref.getPixelsCount() );
+    EXPECT_GT( binned, ref.getPixelsCount() * 9 / 10 );
+}
+
+// The cached statistics of an image are not returned for another layer or mipmap level with the same hash and bounds
+TEST(ImageStatistics, CacheKey) {
+    RectI bounds(0, 0, 16, 8);
+    RectD rod(0, 0, 16, 8);
+    ImagePtr rgba = boost::make_shared<Image>(ImagePlaneDesc::getRGBAComponents(), rod, bounds, 0, 1., eImageBitDepthFloat, eImagePremultiplicationPremultiplied, eImageFieldingOrderNone);
+    ImagePtr rgb = boost::make_shared<Image>(ImagePlaneDesc::getRGBComponents(), rod, bounds, 0, 1., eImageBitDepthFloat, eImagePremultiplicationPremultiplied, eImageFieldingOrderNone);
+    ImagePtr rgbaLevel1 = boost::make_shared<Image>(ImagePlaneDesc::getRGBAComponents(), rod, bounds, 1, 1., eImageBitDepthFloat, eImagePremultiplicationPremultiplied, eImageFieldingOrderNone);
+    rgba->fill(bounds, 1.f, 1.f, 1.f, 1.f);
+    rgb->fill(bounds, 0.25f, 0.25f, 0.25f, 1.f);
+    rgbaLevel1->fill(bounds, 0.5f, 0.5f, 0.5f, 1.f);
+    ASSERT_EQ( rgba->getHashKey(), rgb->getHashKey() );
+    ASSERT_EQ( rgba->getHashKey(), rgbaLevel1->getHashKey() );
+
+    ImageStatistics::clearCache();
+    EXPECT_EQ( 1., ImageStatistics::compute(rgba, bounds, 0, 0., 0., false)->getMax(ImageStatistics::eChannelR) );
+    EXPECT_EQ( 0.25, ImageStatistics::compute(rgb, bounds, 0, 0., 0., false)->getMax(ImageStatistics::eChannelR) );
+    EXPECT_EQ( 0.5, ImageStatistics::compute(rgbaLevel1, bounds, 0, 0., 0., false)->getMax(ImageStatistics::eChannelR) );
+
+    // the statistics of the same pixels are cached
+    ImageStatisticsConstPtr stats = ImageStatistics::compute(rgba, bounds, 0, 0., 0., false);
+    EXPECT_TRUE( stats == ImageStatistics::compute(rgba, bounds, 0, 0., 0., false) );
+    ImageStatistics::clearCache();
+}
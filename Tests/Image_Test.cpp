@@ -26,9 +26,16 @@
 #include "Global/Macros.h"
 
 #include <cstring>
+#include <vector>
 #include <gtest/gtest.h>
 
+#include <QtCore/QSemaphore>
+#include <QtCore/QThread>
+
 #include "Engine/Image.h"
+#include "Engine/Lut.h"
+#include "Engine/PixelConvert.h"
+#include "Engine/RamBufferPool.h"
 #include "Engine/ViewIdx.h"
 
 NATRON_NAMESPACE_USING
@@ -52,8 +59,7 @@ TEST(BitmapTest,
     ASSERT_TRUE(rod == nonRenderedRectsUnion);
 
     ///assert that the "underlying" bitmap is clean
-    const char* map = bm.getBitmap();
-    ASSERT_TRUE( !std::memchr( map, 1, rod.area() ) );
+    ASSERT_TRUE( bm.getStates(rod) == Bitmap::eBitmapStateFlagUnrendered );
     ASSERT_TRUE( bm.isNonMarked(rod) );
 
     RectI halfRoD(0, 0, 100, 50);
@@ -69,14 +75,12 @@ TEST(BitmapTest,
 
 
     ///assert that the underlying bitmap is marked as expected
-    const char* start = map;
 
     ///check that there are only ones in the rendered half
-    ASSERT_TRUE( !memchr( start, 0, halfRoD.area() ) );
+    ASSERT_TRUE( bm.getStates(halfRoD) == Bitmap::eBitmapStateFlagRendered );
 
     ///check that there are only 0s in the non rendered half
-    start = map + halfRoD.area();
-    ASSERT_TRUE( !memchr( start, 1, halfRoD.area() ) );
+    ASSERT_TRUE( bm.getStates(nonRenderedHalf) == Bitmap::eBitmapStateFlagUnrendered );
 
     ///mark for renderer the other half of the rod
     bm.markForRendered(nonRenderedHalf);
@@ -85,7 +89,7 @@ TEST(BitmapTest,
     nonRenderedRects.clear();
     bm.minimalNonMarkedRects(rod, nonRenderedRects);
     ASSERT_TRUE( nonRenderedRects.empty() );
-    ASSERT_TRUE( !memchr( map, 0, rod.area() ) );
+    ASSERT_TRUE( bm.getStates(rod) == Bitmap::eBitmapStateFlagRendered );
 
     ///More complex example where A,B,C,D are not rendered check that both trimap & bitmap yield the same result
     // BBBBBBBBBBBBBB
@@ -117,6 +121,115 @@ TEST(BitmapTest,
     EXPECT_TRUE(nonRenderedRects.size() == 3);
 } // TEST
 
+// The states are stored per tile: check them against a per-pixel reference when marking rectangles that do not
+// align with the tiles
+TEST(BitmapTest, UnalignedRects)
+{
+    RectI rod(-37, 11, 250, 190);
+    Bitmap bm(rod);
+    std::vector<char> ref(rod.area(), 0);
+
+    srand(2000);
+    for (int i = 0; i < 200; ++i) {
+        // coverity[dont_call]
+        int x1 = rod.x1 - 10 + rand() % (rod.width() + 20);
+        // coverity[dont_call]
+        int y1 = rod.y1 - 10 + rand() % (rod.height() + 20);
+        // coverity[dont_call]
+        RectI rect( x1, y1, x1 + 1 + rand() % 150, y1 + 1 + rand() % 150 );
+        // coverity[dont_call]
+        char value = (char)(rand() % 3);
+        if (value == 0) {
+            bm.clear(rect);
+        } else if (value == 1) {
+            bm.markForRendered(rect);
+        } else {
+            bm.markForRendering(rect);
+        }
+        RectI clipped;
+        if ( rect.intersect(rod, &clipped) ) {
+            for (int y = clipped.y1; y < clipped.y2; ++y) {
+                std::fill(&ref[(y - rod.y1) * rod.width() + clipped.x1 - rod.x1], &ref[(y - rod.y1) * rod.width() + clipped.x2 - rod.x1], value);
+            }
+        }
+
+        // coverity[dont_call]
+        int qx1 = rod.x1 + rand() % rod.width();
+        // coverity[dont_call]
+        int qy1 = rod.y1 + rand() % rod.height();
+        // coverity[dont_call]
+        RectI query( qx1, qy1, std::min(rod.x2, qx1 + 1 + rand() % 100), std::min(rod.y2, qy1 + 1 + rand() % 100) );
+        int states = 0;
+        for (int y = query.y1; y < query.y2; ++y) {
+            for (int x = query.x1; x < query.x2; ++x) {
+                states |= 1 << ref[(y - rod.y1) * rod.width() + x - rod.x1];
+            }
+        }
+        ASSERT_EQ( states, bm.getStates(query) );
+
+        // the rectangles to render cover all the pixels that are not rendered, and are inside the query
+        std::list<RectI> rects;
+        bm.minimalNonMarkedRects(query, rects);
+        for (int y = query.y1; y < query.y2; ++y) {
+            for (int x = query.x1; x < query.x2; ++x) {
+                char state = ref[(y - rod.y1) * rod.width() + x - rod.x1];
+                ASSERT_EQ( state, bm.getStateAt(x, y) );
+                if (state != 1) {
+                    bool covered = false;
+                    for (std::list<RectI>::iterator it = rects.begin(); it != rects.end() && !covered; ++it) {
+                        covered = it->contains(x, y);
+                    }
+                    ASSERT_TRUE(covered);
+                }
+            }
+        }
+        for (std::list<RectI>::iterator it = rects.begin(); it != rects.end(); ++it) {
+            ASSERT_TRUE( query.contains(*it) );
+        }
+    }
+
+    // copying and halving keep the per-pixel states
+    Bitmap copy(rod);
+    copy.copyBitmapPortion(rod, bm);
+    for (int y = rod.y1; y < rod.y2; ++y) {
+        for (int x = rod.x1; x < rod.x2; ++x) {
+            ASSERT_EQ( bm.getStateAt(x, y), copy.getStateAt(x, y) );
+        }
+    }
+
+    // pixels outside of the source bitmap are considered rendered, including whole tiles of the
+    // destination whose source is entirely outside
+    RectI halfRoD(rod.x1 / 2, (rod.y1 + 1) / 2, rod.x2 / 2, rod.y2 / 2);
+    // larger than the tiles of the bitmaps
+    const int margin = 200;
+    RectI outsideHalfRoD(halfRoD.x1 - margin, halfRoD.y1 - margin, halfRoD.x2 + margin, halfRoD.y2 + margin);
+    for (int i = 0; i < 2; ++i) {
+        const RectI& dstRoD = i == 0 ? halfRoD : outsideHalfRoD;
+        Bitmap half(dstRoD);
+        half.halveRoI(dstRoD, bm);
+        for (int y = dstRoD.y1; y < dstRoD.y2; ++y) {
+            for (int x = dstRoD.x1; x < dstRoD.x2; ++x) {
+                bool rendered = true;
+                for (int sy = y * 2; sy < y * 2 + 2; ++sy) {
+                    for (int sx = x * 2; sx < x * 2 + 2; ++sx) {
+                        if ( rod.contains(sx, sy) && (bm.getStateAt(sx, sy) != 1) ) {
+                            rendered = false;
+                        }
+                    }
+                }
+                ASSERT_EQ( (char)rendered, half.getStateAt(x, y) );
+            }
+        }
+    }
+
+    // once uniform again, the tiles do not store the state of each pixel anymore
+    std::size_t mixedSize = bm.getMemorySize();
+    bm.markForRendered(rod);
+    ASSERT_TRUE( bm.getMemorySize() < mixedSize );
+    ASSERT_TRUE( bm.getMemorySize() < (std::size_t)rod.area() / 100 );
+    ASSERT_TRUE( bm.getStates(rod) == Bitmap::eBitmapStateFlagRendered );
+} // TEST
+
 TEST(ImageKeyTest, Equality) {
     srand(2000);
     // coverity[dont_call]
@@ -160,3 +273,223 @@ TEST(ImageKeyTest, Difference) {
     ASSERT_TRUE(keyHash1 != keyHash2);
 }
 
+
+// Converting between bit depths without colorspace conversion goes through the SIMD row kernels:
+// check that every instruction set gives the result of the scalar Color functions
+TEST(ImageConvertTest, SameComponentsDepth) {
+    RectI bounds(0, 0, 61, 17);
+    RectD rod(0, 0, 61, 17);
+    const ImagePlaneDesc& rgba = ImagePlaneDesc::getRGBAComponents();
+    Image floatImg(rgba, rod, bounds, 0, 1., eImageBitDepthFloat, eImagePremultiplicationPremultiplied, eImageFieldingOrderNone);
+    Image byteImg(rgba, rod, bounds, 0, 1., eImageBitDepthByte, eImagePremultiplicationPremultiplied, eImageFieldingOrderNone);
+    Image shortImg(rgba, rod, bounds, 0, 1., eImageBitDepthShort, eImagePremultiplicationPremultiplied, eImageFieldingOrderNone);
+    const int nElements = bounds.area() * 4;
+
+    srand(2000);
+    {
+        Image::WriteAccess acc = floatImg.getWriteRights();
+        float* pix = (float*)acc.pixelAt(bounds.x1, bounds.y1);
+        for (int i = 0; i < nElements; ++i) {
+            // coverity[dont_call]
+            pix[i] = rand() / (float)RAND_MAX * 1.4f - 0.2f;
+        }
+    }
+
+    PixelConvert::InstructionSetEnum hostSet = PixelConvert::getHostInstructionSet();
+    for (int set = PixelConvert::eInstructionSetScalar; set <= (int)hostSet; ++set) {
+        PixelConvert::setMaxInstructionSet( (PixelConvert::InstructionSetEnum)set );
+        floatImg.convertToFormat(bounds, eViewerColorSpaceLinear, eViewerColorSpaceLinear, -1, false, false, &byteImg);
+        floatImg.convertToFormat(bounds, eViewerColorSpaceLinear, eViewerColorSpaceLinear, -1, false, false, &shortImg);
+
+        Image::ReadAccess floatAcc = floatImg.getReadRights();
+        Image::ReadAccess byteAcc = byteImg.getReadRights();
+        Image::ReadAccess shortAcc = shortImg.getReadRights();
+        const float* floatPix = (const float*)floatAcc.pixelAt(bounds.x1, bounds.y1);
+        const unsigned char* bytePix = byteAcc.pixelAt(bounds.x1, bounds.y1);
+        const unsigned short* shortPix = (const unsigned short*)shortAcc.pixelAt(bounds.x1, bounds.y1);
+        for (int i = 0; i < nElements; ++i) {
+            ASSERT_EQ( bytePix[i], Color::floatToInt<256>(floatPix[i]) );
+            ASSERT_EQ( shortPix[i], Color::floatToInt<65536>(floatPix[i]) );
+        }
+    }
+    PixelConvert::setMaxInstructionSet(PixelConvert::eInstructionSetAVX2);
+}
+
+// Halving goes through the SIMD row kernels in the interior and averages the pixels within the bounds on the edges:
+// check that every instruction set gives the mean of the covered pixels, computed in the same order
+TEST(ImageMipMapTest, HalveMatchesBoxFilter) {
+    RectI bounds(1, 0, 62, 17); // odd width and height, odd x1
+    RectD rod(1, 0, 62, 17);
+    const ImagePlaneDesc* comps[2] = { &ImagePlaneDesc::getRGBAComponents(), &ImagePlaneDesc::getAlphaComponents() };
+
+    srand(2000);
+    for (int c = 0; c < 2; ++c) {
+        const int nComps = comps[c]->getNumComponents();
+        Image src(*comps[c], rod, bounds, 0, 1., eImageBitDepthFloat, eImagePremultiplicationPremultiplied, eImageFieldingOrderNone);
+        {
+            Image::WriteAccess acc = src.getWriteRights();
+            float* pix = (float*)acc.pixelAt(bounds.x1, bounds.y1);
+            for (int i = 0; i < bounds.area() * nComps; ++i) {
+                // coverity[dont_call]
+                pix[i] = rand() / (float)RAND_MAX * 1.4f - 0.2f;
+            }
+        }
+
+        RectI dstBounds = bounds.downscalePowerOfTwoSmallestEnclosing(1);
+        Image dst(*comps[c], rod, dstBounds, 1, 1., eImageBitDepthFloat, eImagePremultiplicationPremultiplied, eImageFieldingOrderNone);
+
+        PixelConvert::InstructionSetEnum hostSet = PixelConvert::getHostInstructionSet();
+        for (int set = PixelConvert::eInstructionSetScalar; set <= (int)hostSet; ++set) {
+            PixelConvert::setMaxInstructionSet( (PixelConvert::InstructionSetEnum)set );
+            src.downscaleMipMap(rod, bounds, 0, 1, false, &dst);
+
+            Image::ReadAccess srcAcc = src.getReadRights();
+            Image::ReadAccess dstAcc = dst.getReadRights();
+            for (int y = dstBounds.y1; y < dstBounds.y2; ++y) {
+                for (int x = dstBounds.x1; x < dstBounds.x2; ++x) {
+                    const float* dstPix = (const float*)dstAcc.pixelAt(x, y);
+                    for (int k = 0; k < nComps; ++k) {
+                        float sum = 0.f;
+                        int count = 0;
+                        for (int sy = y * 2; sy < y * 2 + 2; ++sy) {
+                            for (int sx = x * 2; sx < x * 2 + 2; ++sx) {
+                                if ( (bounds.x1 <= sx) && (sx < bounds.x2) && (bounds.y1 <= sy) && (sy < bounds.y2) ) {
+                                    sum += ( (const float*)srcAcc.pixelAt(sx, sy) )[k];
+                                    ++count;
+                                }
+                            }
+                        }
+                        ASSERT_EQ(sum / count, dstPix[k]);
+                    }
+                }
+            }
+        }
+    }
+    PixelConvert::setMaxInstructionSet(PixelConvert::eInstructionSetAVX2);
+}
+
+// A pixel of the next mipmap level is rendered only once all the pixels it covers are rendered
+TEST(ImageMipMapTest, HalveToNextLevelBitmap) {
+    RectI bounds(0, 0, 64, 64);
+    RectD rod(0, 0, 64, 64);
+    const ImagePlaneDesc& rgba = ImagePlaneDesc::getRGBAComponents();
+    Image src(rgba, rod, bounds, 0, 1., eImageBitDepthFloat, eImagePremultiplicationPremultiplied, eImageFieldingOrderNone, true);
+    RectI halfBounds(0, 0, 32, 32);
+    Image half(rgba, rod, halfBounds, 1, 1., eImageBitDepthFloat, eImagePremultiplicationPremultiplied, eImageFieldingOrderNone, true);
+
+    // the left half is rendered, except its rightmost column
+    src.markForRendered( RectI(0, 0, 31, 64) );
+    src.halveToNextMipMapLevel(RectI(0, 0, 32, 64), &half);
+
+    std::list<RectI> rest;
+    half.getRestToRender(RectI(0, 0, 15, 32), rest);
+    EXPECT_TRUE( rest.empty() );
+    rest.clear();
+    half.getRestToRender(RectI(15, 0, 32, 32), rest);
+    RectI restUnion;
+    for (std::list<RectI>::iterator it = rest.begin(); it != rest.end(); ++it) {
+        restUnion.merge(*it);
+    }
+    EXPECT_TRUE( restUnion == RectI(15, 0, 32, 32) );
+
+    src.markForRendered(bounds);
+    src.halveToNextMipMapLevel(RectI(30, 0, 64, 64), &half);
+    rest.clear();
+    half.getRestToRender(halfBounds, rest);
+    EXPECT_TRUE( rest.empty() );
+}
+
+class RamBufferPoolReleaseThread
+    : public QThread
+{
+public:
+
+    // Released once the buffer is given back to the pool
+    QSemaphore released;
+
+    // Acquired before exiting, so that the buffer stays in the free list of the thread
+    QSemaphore mayExit;
+
+    RamBufferPoolReleaseThread(void* data,
+                               std::size_t nBytes)
+        : QThread()
+        , released()
+        , mayExit()
+        , _data(data)
+        , _nBytes(nBytes)
+    {
+    }
+
+private:
+
+    virtual void run() OVERRIDE FINAL
+    {
+        RamBufferPool::release(_data, _nBytes);
+        released.release();
+        mayExit.acquire();
+    }
+
+    void* _data;
+    std::size_t _nBytes;
+};
+
+TEST(RamBufferPoolTest, ClearFreesAllThreads) {
+    RamBufferPool::clear();
+    ASSERT_EQ( (std::size_t)0, RamBufferPool::getSize() );
+
+    const std::size_t nBytes = 1024 * 1024;
+    void* buffer = RamBufferPool::allocate(nBytes);
+    void* otherThreadBuffer = RamBufferPool::allocate(nBytes);
+    ASSERT_TRUE(buffer && otherThreadBuffer);
+
+    RamBufferPool::release(buffer, nBytes);
+    EXPECT_EQ( nBytes, RamBufferPool::getSize() );
+
+    // the buffer kept by another thread is accounted and freed too
+    RamBufferPoolReleaseThread thread(otherThreadBuffer, nBytes);
+    thread.start();
+    thread.released.acquire();
+    EXPECT_EQ( 2 * nBytes, RamBufferPool::getSize() );
+    RamBufferPool::clear();
+    EXPECT_EQ( (std::size_t)0, RamBufferPool::getSize() );
+
+    thread.mayExit.release();
+    thread.wait();
+    EXPECT_EQ( (std::size_t)0, RamBufferPool::getSize() );
+
+    // a recycled buffer is handed back to the next allocation of the same size
+    buffer = RamBufferPool::allocate(nBytes);
+    RamBufferPool::release(buffer, nBytes);
+    EXPECT_TRUE(RamBufferPool::allocate(nBytes) == buffer);
+    EXPECT_EQ( (std::size_t)0, RamBufferPool::getSize() );
+    RamBufferPool::release(buffer, nBytes);
+    RamBufferPool::clear();
+}
+
+TEST(RamBufferPoolTest, Stats) {
+    RamBufferPool::clear();
+
+    RamBufferPoolStats start;
+    RamBufferPool::getStats(&start);
+
+    const std::size_t nBytes = 1024 * 1024;
+    void* buffer = RamBufferPool::allocate(nBytes);
+    ASSERT_TRUE(buffer);
+    RamBufferPool::release(buffer, nBytes);
+    buffer = RamBufferPool::allocate(nBytes);
+    ASSERT_TRUE(buffer);
+    RamBufferPool::release(buffer, nBytes);
+
+    // small buffers are not accounted
+    RamBufferPool::release(RamBufferPool::allocate(16), 16);
+
+    RamBufferPoolStats stats;
+    RamBufferPool::getStats(&stats);
+    EXPECT_EQ( (U64)1, stats.nHits - start.nHits );
+    EXPECT_EQ( (U64)1, stats.nMisses - start.nMisses );
+    EXPECT_EQ( (U64)2, stats.nRecycled - start.nRecycled );
+    EXPECT_EQ( (U64)0, stats.nDropped - start.nDropped );
+    EXPECT_EQ( (U64)nBytes, stats.bytesPooled );
+
+    RamBufferPool::clear();
+}
@@ -26,8 +26,11 @@
 #include "Global/Macros.h"
 
 #include <cstdlib>
+#include <vector>
 #include <gtest/gtest.h>
 #include "Engine/Lut.h"
+#include "Engine/PixelConvert.h"
+#include "Engine/RectI.h"
 
 NATRON_NAMESPACE_USING
 using namespace NATRON_NAMESPACE::Color;
@@ -52,3 +55,116 @@ TEST(Lut, IntConversions) {
         EXPECT_EQ( i, uint8xxToChar( charToUint8xx(i) ) );
     }
 }
+
+// The SIMD code paths must give exactly the same results as the scalar code
+TEST(Lut, PixelConvertSIMD) {
+    const int n = 4099; // not a multiple of the vector sizes, to test the remainder loops
+    std::vector<float> floats(n * 4);
+    std::vector<unsigned char> bytes(n);
+    std::vector<unsigned short> shorts(n);
+
+    srand(2000);
+    for (std::size_t i = 0; i < floats.size(); ++i) {
+        // coverity[dont_call]
+        floats[i] = rand() / (float)RAND_MAX * 1.4f - 0.2f;
+    }
+    floats[0] = 0.f;
+    floats[1] = -0.f;
+    floats[2] = 1.f;
+    floats[3] = 0.99999994f;
+    for (int i = 0; i < n; ++i) {
+        bytes[i] = (unsigned char)i;
+        shorts[i] = (unsigned short)(i * 17);
+    }
+
+    PixelConvert::InstructionSetEnum hostSet = PixelConvert::getHostInstructionSet();
+    for (int set = PixelConvert::eInstructionSetSSE41; set <= (int)hostSet; ++set) {
+        std::vector<float> floatsRef(n), floatsSIMD(n);
+        std::vector<unsigned char> bytesRef(n), bytesSIMD(n);
+        std::vector<unsigned short> shortsRef(n * 4), shortsSIMD(n * 4);
+
+        PixelConvert::setMaxInstructionSet(PixelConvert::eInstructionSetScalar);
+        PixelConvert::convertByteToFloat(&bytes[0], &floatsRef[0], n);
+        PixelConvert::setMaxInstructionSet( (PixelConvert::InstructionSetEnum)set );
+        PixelConvert::convertByteToFloat(&bytes[0], &floatsSIMD[0], n);
+        EXPECT_TRUE(floatsRef == floatsSIMD);
+
+        PixelConvert::setMaxInstructionSet(PixelConvert::eInstructionSetScalar);
+        PixelConvert::convertShortToFloat(&shorts[0], &floatsRef[0], n);
+        PixelConvert::setMaxInstructionSet( (PixelConvert::InstructionSetEnum)set );
+        PixelConvert::convertShortToFloat(&shorts[0], &floatsSIMD[0], n);
+        EXPECT_TRUE(floatsRef == floatsSIMD);
+
+        PixelConvert::setMaxInstructionSet(PixelConvert::eInstructionSetScalar);
+        PixelConvert::convertFloatToByte(&floats[0], &bytesRef[0], n);
+        PixelConvert::setMaxInstructionSet( (PixelConvert::InstructionSetEnum)set );
+        PixelConvert::convertFloatToByte(&floats[0], &bytesSIMD[0], n);
+        EXPECT_TRUE(bytesRef == bytesSIMD);
+
+        PixelConvert::setMaxInstructionSet(PixelConvert::eInstructionSetScalar);
+        PixelConvert::convertFloatToShort(&floats[0], &shortsRef[0], n);
+        PixelConvert::setMaxInstructionSet( (PixelConvert::InstructionSetEnum)set );
+        PixelConvert::convertFloatToShort(&floats[0], &shortsSIMD[0], n);
+        EXPECT_TRUE(shortsRef == shortsSIMD);
+
+        PixelConvert::setMaxInstructionSet(PixelConvert::eInstructionSetScalar);
+        PixelConvert::convertFloatToUint8xx(&floats[0], &shortsRef[0], n);
+        PixelConvert::setMaxInstructionSet( (PixelConvert::InstructionSetEnum)set );
+        PixelConvert::convertFloatToUint8xx(&floats[0], &shortsSIMD[0], n);
+        EXPECT_TRUE(shortsRef == shortsSIMD);
+
+        PixelConvert::setMaxInstructionSet(PixelConvert::eInstructionSetScalar);
+        PixelConvert::computeLutIndices(&floats[0], &shortsRef[0], n * 4);
+        PixelConvert::setMaxInstructionSet( (PixelConvert::InstructionSetEnum)set );
+        PixelConvert::computeLutIndices(&floats[0], &shortsSIMD[0], n * 4);
+        EXPECT_TRUE(shortsRef == shortsSIMD);
+
+        PixelConvert::setMaxInstructionSet(PixelConvert::eInstructionSetScalar);
+        PixelConvert::computeLutIndicesPremult4(&floats[0], &shortsRef[0], n);
+        PixelConvert::setMaxInstructionSet( (PixelConvert::InstructionSetEnum)set );
+        PixelConvert::computeLutIndicesPremult4(&floats[0], &shortsSIMD[0], n);
+        EXPECT_TRUE(shortsRef == shortsSIMD);
+    }
+    PixelConvert::setMaxInstructionSet(PixelConvert::eInstructionSetAVX2);
+
+    // the scalar kernels are the Color functions
+    std::vector<unsigned short> uint8xx(n);
+    PixelConvert::setMaxInstructionSet(PixelConvert::eInstructionSetScalar);
+    PixelConvert::convertFloatToUint8xx(&floats[0], &uint8xx[0], n);
+    PixelConvert::setMaxInstructionSet(PixelConvert::eInstructionSetAVX2);
+    for (int i = 0; i < n; ++i) {
+        EXPECT_EQ( uint8xx[i], floatToInt<0xff01>(floats[i]) );
+    }
+}
+
+TEST(Lut, ToBytePackedSIMD) {
+    const Lut* lut = LutManager::sRGBLut();
+    RectI bounds(0, 0, 67, 31);
+    std::vector<float> from(bounds.area() * 4);
+
+    srand(2000);
+    for (std::size_t i = 0; i < from.size(); ++i) {
+        // coverity[dont_call]
+        from[i] = rand() / (float)RAND_MAX * 1.2f - 0.1f;
+    }
+
+    PixelConvert::InstructionSetEnum hostSet = PixelConvert::getHostInstructionSet();
+    for (int inputPacking = ePixelPackingRGBA; inputPacking <= ePixelPackingBGR; ++inputPacking) {
+        for (int premult = 0; premult < 2; ++premult) {
+            std::vector<unsigned char> ref(bounds.area() * 4);
+
+            // the error diffusion starts at a random position on each line, so reset the seed before each conversion
+            PixelConvert::setMaxInstructionSet(PixelConvert::eInstructionSetScalar);
+            srand(1);
+            lut->to_byte_packed(&ref[0], &from[0], bounds, bounds, bounds, (PixelPackingEnum)inputPacking, ePixelPackingBGRA, true, premult);
+            for (int set = PixelConvert::eInstructionSetSSE41; set <= (int)hostSet; ++set) {
+                std::vector<unsigned char> simd(bounds.area() * 4);
+                PixelConvert::setMaxInstructionSet( (PixelConvert::InstructionSetEnum)set );
+                srand(1);
+                lut->to_byte_packed(&simd[0], &from[0], bounds, bounds, bounds, (PixelPackingEnum)inputPacking, ePixelPackingBGRA, true, premult);
+                EXPECT_TRUE(ref == simd);
+            }
+        }
+    }
+    PixelConvert::setMaxInstructionSet(PixelConvert::eInstructionSetAVX2);
+}
@@ -0,0 +1,324 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ * Copyright (C) 2018-2020 The Natron developers
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include "Engine/NativeExpression.h"
+
+NATRON_NAMESPACE_USING
+
+// A parameter whose value in each dimension is (dimension + 1) * 10 + time, and whose curve is time * 2
+class TestParam
+    : public NativeExpressionParam
+{
+public:
+
+    TestParam(int nDims,
+              bool isInt,
+              bool isColor)
+        : nDims(nDims)
+        , isInt(isInt)
+        , color(isColor)
+        , currentTime(1.)
+        , deleted(false)
+    {
+    }
+
+    virtual int getDimension() const OVERRIDE FINAL { return nDims; }
+
+    virtual bool isIntegral() const OVERRIDE FINAL { return isInt; }
+
+    virtual bool isColor() const OVERRIDE FINAL { return color; }
+
+    virtual bool hasDimensionArgument() const OVERRIDE FINAL { return true; }
+
+    virtual bool getValue(int dimension,
+                          double* value) const OVERRIDE FINAL
+    {
+        return getValueAtTime(currentTime, dimension, value);
+    }
+
+    virtual bool getValueAtTime(double time,
+                                int dimension,
+                                double* value) const OVERRIDE FINAL
+    {
+        *value = (dimension + 1) * 10 + time;
+
+        return !deleted;
+    }
+
+    virtual bool getCurveValue(double time,
+                               int /*dimension*/,
+                               double* value) const OVERRIDE FINAL
+    {
+        *value = time * 2.;
+
+        return !deleted;
+    }
+
+    int nDims;
+    bool isInt;
+    bool color;
+    double currentTime;
+    bool deleted;
+};
+
+// thisParam is a 1-dimensional double, Transform1.translate a 2D double, Constant1.color an RGB color and Blur1.steps an int
+class TestContext
+    : public NativeExpressionContext
+{
+public:
+
+    TestContext()
+        : thisParam( new TestParam(1, false, false) )
+        , translate( new TestParam(2, false, false) )
+        , color( new TestParam(3, false, true) )
+        , steps( new TestParam(1, true, false) )
+    {
+    }
+
+    virtual int getDimension() const OVERRIDE FINAL { return 0; }
+
+    virtual NativeExpressionParamPtr getParam(const std::vector<std::string>& path) const OVERRIDE FINAL
+    {
+        std::string name;
+
+        for (std::size_t i = 0; i < path.size(); ++i) {
+            name += (i ? "." : "") + path[i];
+        }
+        if (name == "thisParam") {
+            return thisParam;
+        } else if (name == "Transform1.translate") {
+            return translate;
+        } else if (name == "thisGroup.Constant1.color") {
+            return color;
+        } else if (name == "Blur1.steps") {
+            return steps;
+        }
+
+        return NativeExpressionParamPtr();
+    }
+
+    virtual bool isScopeName(const std::string& name) const OVERRIDE FINAL
+    {
+        return name == "app" || name == "Transform1" || name == "Constant1" || name == "Blur1" || name == "e";
+    }
+
+    boost::shared_ptr<TestParam> thisParam, translate, color, steps;
+};
+
+static bool
+evaluate(const std::string& expr,
+         double time,
+         double* result,
+         bool* isInt)
+{
+    TestContext context;
+    NativeExpressionPtr compiled = NativeExpression::compile(expr, context);
+
+    if (!compiled) {
+        return false;
+    }
+
+    return compiled->evaluate(time, ViewIdx(0), result, isInt);
+}
+
+static void
+expectFloat(const std::string& expr,
+            double time,
+            double expected)
+{
+    double result = 0.;
+    bool isInt = true;
+
+    ASSERT_TRUE( evaluate(expr, time, &result, &isInt) ) << expr;
+    EXPECT_FALSE(isInt) << expr;
+    EXPECT_DOUBLE_EQ(expected, result) << expr;
+}
+
+static void
+expectInt(const std::string& expr,
+          double time,
+          double expected)
+{
+    double result = 0.;
+    bool isInt = false;
+
+    ASSERT_TRUE( evaluate(expr, time, &result, &isInt) ) << expr;
+    EXPECT_TRUE(isInt) << expr;
+    EXPECT_EQ(expected, result) << expr;
+}
+
+TEST(NativeExpressionTest, Arithmetic)
+{
+    expectInt("1 + 2 * 3", 0, 7);
+    expectInt("-2 ** 2", 0, -4);
+    expectInt("2 ** 3 ** 2", 0, 512);
+    expectFloat("2 ** -1", 0, 0.5);
+    expectInt("7 // 2", 0, 3);
+    expectInt("-7 // 2", 0, -4);
+    expectInt("-7 % 3", 0, 2);
+    expectInt("7 % -3", 0, -2);
+    expectFloat("-7.5 % 2", 0, 0.5);
+    expectFloat("1 // 0.1", 0, 9.);
+#if PY_MAJOR_VERSION >= 3
+    expectFloat("7 / 2", 0, 3.5);
+#else
+    expectInt("7 / 2", 0, 3);
+#endif
+    expectFloat("7.0 / 2", 0, 3.5);
+    expectFloat("1e3 + .5", 0, 1000.5);
+    expectInt("(1 + 2) * (3 - 4)", 0, -3);
+}
+
+TEST(NativeExpressionTest, Frame)
+{
+    expectInt("frame * 2", 10, 20);
+    expectFloat("frame * 2", 10.5, 21);
+    expectInt("frame % 4", 13, 1);
+    expectInt("dimension", 0, 0);
+    expectInt("view", 0, 0);
+}
+
+TEST(NativeExpressionTest, Logic)
+{
+    expectInt("frame > 10", 11, 1);
+    expectInt("frame > 10", 10, 0);
+    expectInt("not frame", 0, 1);
+    expectFloat("1.5 if frame > 10 else 2.5", 11, 1.5);
+    expectFloat("1.5 if frame > 10 else 2.5", 10, 2.5);
+    // and/or return their operands
+    expectFloat("frame and 2.5", 1, 2.5);
+    expectInt("frame and 2.5", 0, 0);
+    expectFloat("frame or 2.5", 0, 2.5);
+    expectInt("frame or 2.5", 3, 3);
+    expectInt("True + True", 0, 2);
+}
+
+TEST(NativeExpressionTest, Functions)
+{
+    expectFloat("sin(pi / 2)", 0, 1.);
+    expectFloat("sqrt(16)", 0, 4.);
+    expectFloat("pow(2, 3)", 0, 8.);
+    expectFloat("hypot(3, 4)", 0, 5.);
+    expectFloat("log(8, 2)", 0, 3.);
+    expectInt("abs(-3)", 0, 3);
+    expectFloat("abs(-3.5)", 0, 3.5);
+    expectInt("min(3, frame, 5)", 4, 3);
+    expectFloat("max(1, 2.5)", 0, 2.5);
+    expectInt("int(-2.7)", 0, -2);
+    expectFloat("float(frame)", 3, 3.);
+    expectInt("trunc(-2.7)", 0, -2);
+#if PY_MAJOR_VERSION >= 3
+    expectInt("floor(frame / 2)", 5, 2);
+#else
+    expectFloat("floor(frame / 2.)", 5, 2);
+#endif
+}
+
+TEST(NativeExpressionTest, Params)
+{
+    expectFloat("thisParam.curve(frame) * 2", 3, 12.);
+    expectFloat("curve(frame - 1)", 3, 4.);
+    expectFloat("thisParam.get()", 5, 11.);
+    expectFloat("thisParam.getValueAtTime(frame + 1)", 5, 16.);
+    expectFloat("Transform1.translate.get().y", 5, 21.);
+    expectFloat("Transform1.translate.get(frame).x", 5, 15.);
+    expectFloat("Transform1.translate.getValue(1)", 5, 21.);
+    expectFloat("Transform1.translate.getValueAtTime(frame, dimension + 1)", 5, 25.);
+    expectFloat("thisGroup.Constant1.color.get().b", 5, 31.);
+    expectFloat("thisGroup.Constant1.color.get().a", 5, 1.);
+    expectInt("Blur1.steps.get() * 2", 5, 22.);
+}
+
+TEST(NativeExpressionTest, DeletedParam)
+{
+    TestContext context;
+    NativeExpressionPtr compiled = NativeExpression::compile("Transform1.translate.get().x", context);
+
+    ASSERT_TRUE(compiled);
+    double result;
+    bool isInt;
+    EXPECT_TRUE( compiled->evaluate(0, ViewIdx(0), &result, &isInt) );
+    context.translate->deleted = true;
+    EXPECT_FALSE( compiled->evaluate(0, ViewIdx(0), &result, &isInt) );
+}
+
+// Expressions that are left to Python, either at compilation or at evaluation
+TEST(NativeExpressionTest, Unsupported)
+{
+    const char* notCompiled[] = {
+        "random()",
+        "thisParam.getDerivativeAtTime(frame)",
+        "Transform1.translate.get()",
+        "Transform1.translate.get().r",
+        "Transform1.translate.getValue(2)",
+        "Transform1.translate.getValue(dimension + frame)",
+        "Transform1.translate",
+        "Transform1",
+        "e",
+        "unknown",
+        "1 < frame < 3",
+        "'a'",
+        "[1, 2][0]",
+        "(1, 2)",
+        "x = 1",
+        "010",
+        "0x10",
+        "1j",
+        "frame.real",
+        "1 +",
+        "min(1)",
+        "1 # comment",
+    };
+
+    for (std::size_t i = 0; i < sizeof(notCompiled) / sizeof(notCompiled[0]); ++i) {
+        TestContext context;
+        EXPECT_FALSE( NativeExpression::compile(notCompiled[i], context) ) << notCompiled[i];
+    }
+
+    const char* raising[] = {
+        "1 / (frame - 1)",
+        "frame % 0",
+        "sqrt(frame - 2)",
+        "log(frame - 1)",
+        "(frame - 1) ** -1",
+        "(frame - 2) ** 0.5",
+        "10 ** (frame * 100)",
+        "2.0 ** (frame * 2000)",
+    };
+    for (std::size_t i = 0; i < sizeof(raising) / sizeof(raising[0]); ++i) {
+        TestContext context;
+        NativeExpressionPtr compiled = NativeExpression::compile(raising[i], context);
+        ASSERT_TRUE(compiled) << raising[i];
+        double result;
+        bool isInt;
+        EXPECT_FALSE( compiled->evaluate(1, ViewIdx(0), &result, &isInt) ) << raising[i];
+    }
+}
@@ -0,0 +1,147 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ * Copyright (C) 2018-2020 The Natron developers
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <vector>
+#include <gtest/gtest.h>
+#include "Engine/RotoShapeRasterizer.h"
+
+NATRON_NAMESPACE_USING
+
+static Point
+makePoint(double x,
+          double y)
+{
+    Point p;
+
+    p.x = x;
+    p.y = y;
+
+    return p;
+}
+
+// A 10x10 square at (10, 10) with a 4 pixels feather on its left side
+static void
+makeSquare(RotoShapeRasterizer* rasterizer)
+{
+    std::vector<Point> square;
+
+    square.push_back( makePoint(10, 10) );
+    square.push_back( makePoint(20, 10) );
+    square.push_back( makePoint(20, 20) );
+    square.push_back( makePoint(10, 20) );
+    rasterizer->beginSample(1.);
+    rasterizer->addContour(square);
+    rasterizer->addFeatherTriangle(makePoint(10, 10), true, makePoint(6, 10), false, makePoint(6, 20), false);
+    rasterizer->addFeatherTriangle(makePoint(10, 10), true, makePoint(6, 20), false, makePoint(10, 20), true);
+}
+
+TEST(RotoShapeRasterizer, Square) {
+    RotoShapeRasterizer rasterizer;
+
+    makeSquare(&rasterizer);
+    ASSERT_FALSE( rasterizer.isEmpty() );
+
+    RectI rect(0, 0, 32, 32);
+    std::vector<float> coverage( rect.area() );
+    rasterizer.rasterize(rect, &coverage[0], rect.width());
+
+    int covered = 0;
+    for (int y = 0; y < 32; ++y) {
+        for (int x = 10; x < 32; ++x) {
+            covered += coverage[y * 32 + x] == 1.f;
+        }
+    }
+    // exactly the pixels whose center is inside the square
+    EXPECT_EQ(100, covered);
+    EXPECT_EQ(1.f, coverage[10 * 32 + 10]);
+    EXPECT_EQ(1.f, coverage[19 * 32 + 19]);
+    EXPECT_EQ(0.f, coverage[9 * 32 + 10]);
+    EXPECT_EQ(0.f, coverage[10 * 32 + 20]);
+
+    // the feather decreases from the shape to the feather contour
+    for (int x = 6; x < 10; ++x) {
+        EXPECT_GT(coverage[15 * 32 + x], 0.f);
+        EXPECT_LT(coverage[15 * 32 + x], 1.f);
+        EXPECT_LT(coverage[15 * 32 + x - 1], coverage[15 * 32 + x]);
+    }
+    EXPECT_EQ(0.f, coverage[15 * 32 + 5]);
+    // with a fall-off of 1 the opacity is the square of the linear ramp, at the pixel center 9.5: s = 0.5 / 4
+    EXPECT_NEAR( (1. - 0.125) * (1. - 0.125), coverage[15 * 32 + 9], 1e-3 );
+}
+
+TEST(RotoShapeRasterizer, Tiles) {
+    RotoShapeRasterizer rasterizer;
+
+    makeSquare(&rasterizer);
+
+    RectI rect(0, 0, 32, 32);
+    std::vector<float> full( rect.area() );
+    rasterizer.rasterize(rect, &full[0], rect.width());
+
+    // rasterizing tile by tile gives the same result
+    std::vector<float> tiled( rect.area(), -1.f );
+    for (int y = 0; y < 32; y += 7) {
+        for (int x = 0; x < 32; x += 5) {
+            RectI tile( x, y, std::min(x + 5, 32), std::min(y + 7, 32) );
+            rasterizer.rasterize(tile, &tiled[y * 32 + x], 32);
+        }
+    }
+    EXPECT_TRUE(full == tiled);
+}
+
+TEST(RotoShapeRasterizer, WindingAndMotionBlur) {
+    RotoShapeRasterizer rasterizer;
+
+    // two overlapping squares with the same orientation: the overlap is filled with the non-zero winding rule
+    std::vector<Point> square;
+    square.push_back( makePoint(0, 0) );
+    square.push_back( makePoint(4, 0) );
+    square.push_back( makePoint(4, 4) );
+    square.push_back( makePoint(0, 4) );
+    std::vector<Point> square2;
+    square2.push_back( makePoint(2, 0) );
+    square2.push_back( makePoint(6, 0) );
+    square2.push_back( makePoint(6, 4) );
+    square2.push_back( makePoint(2, 4) );
+    rasterizer.beginSample(1.);
+    rasterizer.addContour(square);
+    rasterizer.addContour(square2);
+
+    RectI rect(0, 0, 8, 1);
+    std::vector<float> coverage( rect.area() );
+    rasterizer.rasterize(rect, &coverage[0], rect.width());
+    for (int x = 0; x < 6; ++x) {
+        EXPECT_EQ(1.f, coverage[x]);
+    }
+    EXPECT_EQ(0.f, coverage[6]);
+
+    // the fall-off curve goes from 1 to 0, and a larger fall-off makes the feather decrease faster
+    EXPECT_DOUBLE_EQ( 1., RotoShapeRasterizer::evaluateFallOff(2., 0.) );
+    EXPECT_DOUBLE_EQ( 0., RotoShapeRasterizer::evaluateFallOff(2., 1.) );
+    EXPECT_LT( RotoShapeRasterizer::evaluateFallOff(2., 0.5), RotoShapeRasterizer::evaluateFallOff(1., 0.5) );
+    EXPECT_GT( RotoShapeRasterizer::evaluateFallOff(0.5, 0.5), RotoShapeRasterizer::evaluateFallOff(1., 0.5) );
+}
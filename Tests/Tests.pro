@@ -44,11 +44,15 @@ SOURCES += \
     google-test/src/gtest-all.cc \
     google-mock/src/gmock-all.cc \
     BaseTest.cpp \
+    CacheIndex_Test.cpp \
     Hash64_Test.cpp \
     Image_Test.cpp \
+    ImageStatistics_Test.cpp \
     Lut_Test.cpp \
+    NativeExpression_Test.cpp \
     KnobFile_Test.cpp \
     Curve_Test.cpp \
+    RotoShapeRasterizer_Test.cpp \
     Tracker_Test.cpp \
     wmain.cpp
 
@@ -0,0 +1,95 @@
+# -*- coding: utf-8 -*-
+# Benchmark of concurrent App.render() calls made from Python threads.
+#
+# The blocking calls of the Python API (App.render, node creation, project loading...) release the
+# Python GIL while the engine works, so that several Python threads can drive renders at the same time.
+# This script renders the same number of frames, first from a single thread, one writer after the other,
+# then from one Python thread per writer, and prints the speedup of the concurrent run.
+#
+# Usage:
+#   NatronRenderer -t tools/utils/benchmarkThreadedRender.py
+#
+# Environment variables:
+#   NATRON_BENCH_THREADS  number of writers, and threads in the concurrent run (default: 4)
+#   NATRON_BENCH_FRAMES   number of frames rendered by each writer (default: 10)
+#   NATRON_BENCH_SIZE     blur size, increase it to make each frame more expensive (default: 50)
+#   NATRON_BENCH_OUTDIR   directory where the frames are written (default: a temporary directory)
+
+from __future__ import print_function
+
+import os
+import shutil
+import sys
+import tempfile
+import threading
+import time
+
+import NatronEngine
+
+numWriters = int(os.environ.get("NATRON_BENCH_THREADS", "4"))
+numFrames = int(os.environ.get("NATRON_BENCH_FRAMES", "10"))
+blurSize = float(os.environ.get("NATRON_BENCH_SIZE", "50"))
+outDir = os.environ.get("NATRON_BENCH_OUTDIR")
+removeOutDir = outDir is None
+if outDir is None:
+    outDir = tempfile.mkdtemp(prefix="natron_bench_")
+
+theApp = app if "app" in globals() else NatronEngine.natron.getInstance(0)
+
+
+def createGraph(index):
+    source = theApp.createNode("net.sf.openfx.CheckerBoardPlugin")
+    blur = theApp.createNode("net.sf.cimg.CImgBlur")
+    if source is None or blur is None:
+        print("CheckerBoard and CImgBlur plug-ins not found, openfx-misc is required")
+        sys.exit(1)
+    blur.connectInput(0, source)
+
+    # Animate the blur so that every frame is different and no render is served by the cache
+    size = blur.getParam("size")
+    for dim in range(2):
+        size.setValueAtTime(blurSize, 1, dim)
+        size.setValueAtTime(blurSize * 2, 2 * numFrames, dim)
+
+    writer = theApp.createWriter(os.path.join(outDir, "bench%d_###.exr" % index))
+    writer.connectInput(0, blur)
+
+    return writer
+
+
+# The serial run renders frames [1, numFrames] and the threaded run frames [numFrames + 1, 2 * numFrames]
+def renderSerial(writers):
+    start = time.time()
+    for w in writers:
+        theApp.render(w, 1, numFrames)
+
+    return time.time() - start
+
+
+def renderThreaded(writers):
+    threads = [threading.Thread(target=theApp.render, args=(w, numFrames + 1, 2 * numFrames)) for w in writers]
+    start = time.time()
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+
+    return time.time() - start
+
+
+writers = [createGraph(i) for i in range(numWriters)]
+
+# Load the plug-ins before timing anything
+theApp.render(writers[0], 0, 0)
+
+serial = renderSerial(writers)
+threaded = renderThreaded(writers)
+
+totalFrames = numWriters * numFrames
+print("%d writers x %d frames" % (numWriters, numFrames))
+print("serial:   %.2f s (%.2f frames/s)" % (serial, totalFrames / serial))
+print("threaded: %.2f s (%.2f frames/s)" % (threaded, totalFrames / threaded))
+print("speedup:  %.2fx" % (serial / threaded))
+
+if removeOutDir:
+    shutil.rmtree(outDir, ignore_errors=True)